@@ -6,19 +6,38 @@
 #  QHULL_INCLUDE_DIRS, where to find qhull/qhull_a.h.
 #  QHULL_LIBRARIES, the libraries to link against to use the qhull library
 #  QHULL_LIBRARY_DIRS, the directory where the qhull library is found.
+#
+# If QHULL_REENTRANT is set, the reentrant library (libqhull_r) and its
+# header (libqhull_r/qhull_ra.h) are searched for instead.
 
-find_path(
-  QHULL_INCLUDE_DIR
-  qhull/qhull_a.h libqhull/qhull_a.h
-  PATHS /usr/local/include /usr/include
-)
+if( QHULL_REENTRANT )
+  find_path(
+    QHULL_INCLUDE_DIR
+    libqhull_r/qhull_ra.h
+    PATHS /usr/local/include /usr/include
+  )
+else( QHULL_REENTRANT )
+  find_path(
+    QHULL_INCLUDE_DIR
+    qhull/qhull_a.h libqhull/qhull_a.h
+    PATHS /usr/local/include /usr/include
+  )
+endif( QHULL_REENTRANT )
 
 if( QHULL_INCLUDE_DIR )
-  find_library(
-    QHULL_LIBRARY
-    NAMES libqhullstatic libqhull qhullstatic qhull 
-    PATHS /usr/local/lib /usr/lib
-  )
+  if( QHULL_REENTRANT )
+    find_library(
+      QHULL_LIBRARY
+      NAMES libqhullstatic_r libqhull_r qhullstatic_r qhull_r
+      PATHS /usr/local/lib /usr/lib
+    )
+  else( QHULL_REENTRANT )
+    find_library(
+      QHULL_LIBRARY
+      NAMES libqhullstatic libqhull qhullstatic qhull
+      PATHS /usr/local/lib /usr/lib
+    )
+  endif( QHULL_REENTRANT )
   if( QHULL_LIBRARY )
     set(QHULL_LIBRARY_DIR "")
     get_filename_component(QHULL_LIBRARY_DIRS ${QHULL_LIBRARY} PATH)
@@ -30,7 +49,7 @@ if( QHULL_INCLUDE_DIR )
 else(QHULL_INCLUDE_DIR)
   message(FATAL_ERROR "FindQHull: Could not find qhull_a.h")
 endif(QHULL_INCLUDE_DIR)
-	    
+
 if(QHULL_FOUND)
   if(NOT QHULL_FIND_QUIETLY)
     message(STATUS "FindQHull: Found both qhull_a.h and libqhull.a")
@@ -0,0 +1,86 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _MOBY_ALIGNED_SLAB_POOL_H
+#define _MOBY_ALIGNED_SLAB_POOL_H
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <pthread.h>
+#include <boost/shared_array.hpp>
+
+namespace Moby {
+
+/// A 64-byte aligned, recycling allocator for hot numeric scratch buffers
+/**
+ * Vectorized BLAS kernels run fastest when their operands sit on cache-line
+ * (64 byte) boundaries; general heap allocations guarantee neither the
+ * alignment nor reuse, and per-step scratch allocation adds jitter to step
+ * latency. This pool hands out aligned double buffers and recycles them:
+ * a released buffer goes onto a capacity-bucketed free list and satisfies
+ * later acquires of the same or smaller size without touching the heap, so
+ * a steady-state step allocates nothing. Buffers are returned as
+ * shared_arrays whose deleter releases the storage back to the pool, so a
+ * call site that previously heap allocated a raw array changes only its
+ * allocation expression.
+ *
+ * Subsystems draw from named pools obtained with pool(); the per-pool reuse
+ * statistics identify subsystems that still hit the heap in steady state.
+ * Named pools are never destroyed, so buffers may safely outlive any scope.
+ */
+class AlignedSlabPool
+{
+  public:
+    boost::shared_array<double> acquire(unsigned n);
+    void clear();
+    static AlignedSlabPool& pool(const std::string& subsystem);
+
+    /// Gets the number of buffer acquisitions since construction
+    unsigned long get_acquires() const { return _acquires; }
+
+    /// Gets the number of acquisitions satisfied from the free list
+    unsigned long get_reuses() const { return _reuses; }
+
+    /// Gets the total bytes of slab storage allocated from the heap
+    unsigned long get_heap_bytes() const { return _heap_bytes; }
+
+    std::ostream& dump(std::ostream& out) const;
+    static std::ostream& dump_all(std::ostream& out);
+
+  private:
+    AlignedSlabPool(const std::string& name);
+    ~AlignedSlabPool();
+    AlignedSlabPool(const AlignedSlabPool&);
+    AlignedSlabPool& operator=(const AlignedSlabPool&);
+    void release(double* p, unsigned capacity);
+
+    /// Returns a buffer to its pool when the last shared_array reference dies
+    struct Deleter
+    {
+      Deleter(AlignedSlabPool* pool, unsigned capacity) : _pool(pool), _capacity(capacity) {}
+      void operator()(double* p) const { _pool->release(p, _capacity); }
+
+      AlignedSlabPool* _pool;
+      unsigned _capacity;
+    };
+
+    /// The name of this pool (for statistics reporting)
+    std::string _name;
+
+    /// Free buffers, keyed on capacity (in doubles)
+    std::multimap<unsigned, double*> _free;
+
+    /// Reuse statistics
+    unsigned long _acquires, _reuses, _heap_bytes;
+
+    /// Serializes access from concurrent solver workers
+    pthread_mutex_t _mutex;
+}; // end class
+
+} // end namespace
+
+#endif
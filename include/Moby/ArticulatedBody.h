@@ -29,6 +29,7 @@ class ArticulatedBody : public virtual Ravelin::ArticulatedBodyd, public virtual
     ArticulatedBody();
     virtual ~ArticulatedBody() {}
     virtual void update_visualization();
+    virtual void snapshot_visualization(std::vector<std::pair<OSGGroupWrapperPtr, Ravelin::Pose3d> >& poses);
     virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
     virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
     void update_joint_constraint_violations();
@@ -38,10 +39,17 @@ class ArticulatedBody : public virtual Ravelin::ArticulatedBodyd, public virtual
     virtual void ode(double t, double dt, void* data, Ravelin::SharedVectorNd& dx);
 //    virtual unsigned num_generalized_coordinates(Ravelin::DynamicBodyd::GeneralizedCoordinateType gctype) const;
 
-    /// Finds (joint) limit constraints 
+    /// Finds (joint) limit constraints
     template <class OutputIterator>
     OutputIterator find_limit_constraints(OutputIterator begin) const;
 
+    bool joint_limit_check_due(double t) const;
+    void schedule_next_joint_limit_check(double t);
+    void reset_joint_limit_check();
+
+    /// Safety multiplier applied to current joint accelerations when bounding time-to-limit (default 2.0)
+    double limit_estimation_accel_mult;
+
     /// Gets shared pointer to this object as type ArticulatedBody
     ArticulatedBodyPtr get_this() { return boost::dynamic_pointer_cast<ArticulatedBody>(Ravelin::ArticulatedBodyd::shared_from_this()); }
 
@@ -57,6 +65,12 @@ class ArticulatedBody : public virtual Ravelin::ArticulatedBodyd, public virtual
     // joint velocity tolerances (for joints at constraints)
     std::vector<double> _cvel_vio;
 
+    // time at which the time-to-limit bound was last computed
+    double _limit_check_computed_at;
+
+    // earliest time at which a joint DOF could reach a limit, per the bound
+    double _next_limit_check_time;
+
     // temporary variables
     Ravelin::VectorNd _dq;
 
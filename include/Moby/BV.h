@@ -38,6 +38,7 @@ class SSL;
 class BV : public boost::enable_shared_from_this<BV>
 {
   public:
+    BV() { visits = 0; cull_radius = -1.0f; }
     virtual ~BV() {}
 
     /// Virtual function for outputting the bounding volume to VRML
@@ -84,6 +85,7 @@ class BV : public boost::enable_shared_from_this<BV>
     BVPtr get_this() { return boost::dynamic_pointer_cast<BV>(shared_from_this()); }
     boost::shared_ptr<const BV> get_this() const { return boost::dynamic_pointer_cast<const BV>(shared_from_this()); }
     bool is_leaf() const { return children.empty(); }
+    void init_cull_sphere();
 
     template <class OutputIterator>
     OutputIterator get_all_BVs(OutputIterator begin) const;
@@ -97,6 +99,24 @@ class BV : public boost::enable_shared_from_this<BV>
     /// Userdata for the BV
     boost::shared_ptr<void> userdata;
 
+    /// Traversal profile counter (see TriangleMeshPrimitive::optimize_BVH_layout())
+    mutable unsigned visits;
+
+    /// Center of the single-precision culling mirror
+    /**
+     * The mirror is a bounding sphere over the volume, stored in single
+     * precision and initialized by init_cull_sphere() for volumes that do
+     * not change after construction (the triangle mesh hierarchies).  The
+     * intersects() dispatcher tests the mirrors before the exact volumes:
+     * most distant node pairs are rejected from these sixteen bytes alone,
+     * halving the memory traffic of tree traversal, and the exact
+     * double-precision tests run only on pairs the spheres cannot separate.
+     */
+    float cull_center[3];
+
+    /// Radius of the culling mirror; negative (the as-constructed state) if the mirror is uninitialized
+    float cull_radius;
+
     /// The collision geometry associated with this bounding volume
     CollisionGeometryPtr geom;
 
@@ -30,11 +30,34 @@ class Base : public Ravelin::virtual_enable_shared_from_this<Base>
     template <class T>
     static boost::shared_ptr<T> clone(boost::shared_ptr<T> x) { return (!x) ? x : boost::shared_ptr<T>(new T(*x)); }
 
+    /// Gets the modification stamp for this object
+    /**
+     * The stamp increases monotonically whenever the object's pose, velocity
+     * or topology is changed through a mutator (see bump_generation()), so a
+     * derived cache (warm starts, contact manifolds, BV fronts, etc.) can
+     * validate an entry against the stamp it was built from in O(1) rather
+     * than recomputing or deep-comparing state. The stamp is transient: it
+     * is neither serialized nor copied by cloning.
+     */
+    unsigned long get_generation() const { return _generation; }
+
+    /// Signals that derived caches of this object's state must revalidate
+    /**
+     * Mutators that change the object's pose, velocity or topology call this;
+     * external code that modifies an object through a back door (e.g., by
+     * writing through a shared pose) should call it as well.
+     */
+    void bump_generation() { _generation++; }
+
     /// Any relevant userdata
     boost::shared_ptr<void> userdata;
 
     /// The unique ID for this object
     std::string id;
+
+  private:
+    /// The modification stamp for this object (see get_generation())
+    unsigned long _generation;
 };
 
 } // end namespace Moby
@@ -95,6 +95,12 @@ class C2ACCD : public CollisionDetection
     // lock for the contact set 
     pthread_mutex_t _contact_mutex;
 
+    /// A cached traversal front: the BV node pairs at which the prior conservative advancement traversal for a geometry pair stopped
+    typedef std::vector<std::pair<boost::shared_ptr<SSR>, boost::shared_ptr<SSR> > > TraversalFront;
+
+    // cached traversal fronts, per geometry pair, for temporal coherence
+    std::map<std::pair<CollisionGeometryPtr, CollisionGeometryPtr>, TraversalFront> _CA_fronts;
+
     // mapping from CollisionGeometry pointers to root SSRs
     std::map<CollisionGeometryPtr, boost::shared_ptr<SSR> > _root_SSRs;
 
@@ -13,6 +13,8 @@
 #include <boost/shared_ptr.hpp>
 #include <Ravelin/sorted_pair>
 #include <Moby/Log.h>
+#include <Moby/SmallVector.h>
+#include <Moby/TransformCache.h>
 #include <Moby/SpherePrimitive.h>
 #include <Moby/TorusPrimitive.h>
 #include <Moby/PolyhedralPrimitive.h>
@@ -42,6 +44,7 @@ class CCD : public CollisionDetection
     virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
     virtual void broad_phase(double dt, const std::vector<ControlledBodyPtr>& bodies, std::vector<std::pair<CollisionGeometryPtr, CollisionGeometryPtr> >& to_check);
     virtual double calc_CA_Euler_step(const PairwiseDistInfo& pdi);
+    static double calc_sweep_toc(CollisionGeometryPtr cg, const std::vector<Ravelin::Pose3d>& path, const std::vector<CollisionGeometryPtr>& obstacles, double contact_dist = NEAR_ZERO);
     virtual void find_contacts(CollisionGeometryPtr cgA, CollisionGeometryPtr cgB, std::vector<UnilateralConstraint>& contacts, double TOL = NEAR_ZERO)
     {
       find_contacts(cgA, cgB, std::back_inserter(contacts), TOL);
@@ -49,6 +52,9 @@ class CCD : public CollisionDetection
     static unsigned constrain_unsigned(int ii, int maxi){
      return (unsigned) std::min(std::max(ii,0),maxi);
     }
+    virtual unsigned long calc_memory_usage() const;
+    virtual void release_transient_memory();
+    virtual void invalidate_pair_state(ControlledBodyPtr body);
 
     template <class OutputIterator>
     OutputIterator find_contacts(CollisionGeometryPtr cgA, CollisionGeometryPtr cgB, OutputIterator output_begin, double TOL = NEAR_ZERO);
@@ -61,16 +67,61 @@ class CCD : public CollisionDetection
      */
     std::set<Ravelin::sorted_pair<CollisionGeometryPtr> > disabled_pairs;
 
+    /// If true, each body enters the broad phase as a single compound proxy
+    /**
+     * Bodies built from convex decomposition carry one collision geometry
+     * per piece; entering every piece into the sweep-and-prune makes two
+     * nearby decomposed bodies generate candidate pairs quadratically in
+     * their piece counts.  With this enabled, each body contributes one
+     * broad-phase proxy covering all its pieces, and only overlapping body
+     * pairs descend per-body hierarchies over the piece bounds to produce
+     * piece pairs for the narrow phase (default = false).
+     */
+    bool compound_broad_phase;
+
+    /// Vertex budget per conservative-advancement query on polyhedra (0 = unlimited)
+    /**
+     * The polyhedral conservative-advancement routines examine every vertex
+     * of both polyhedra, so a single adversarial pair (dense scanned hulls)
+     * can dominate the cost of a step.  With a budget set, a query examines
+     * at most this many vertices: the step returned is the minimum over the
+     * examined vertices, clamped to the minimum-step fallback whenever some
+     * vertices went unexamined, so it is always safe (merely smaller than
+     * the converged step).  A per-pair cursor continues the scan where the
+     * last query stopped, so a pair that keeps governing the global step
+     * sweeps fresh vertices on each query instead of rescanning a prefix
+     * (default = 0, preserving the exhaustive scan).
+     */
+    unsigned ca_vertex_budget;
+
+    /// If true, all static geometry is baked into one world-space hierarchy
+    /**
+     * Scenes dense with fixed fixtures (walls, terrain pieces, mounting
+     * hardware) otherwise enter every static geometry into the sweep-and-
+     * prune, paying sorting and pair-management costs each step for bodies
+     * that never move.  With this enabled, the geometries of disabled bodies
+     * are baked once into a single world-space hierarchy with one leaf per
+     * geometry; they leave the sweep entirely and each dynamic geometry
+     * instead makes one traversal of the baked hierarchy per step.  The bake
+     * refreshes automatically when static bodies are added, removed, enabled
+     * or repositioned (setting a pose explicitly marks the geometry stale).
+     * Only the sweep-and-prune broad phase consults this flag
+     * (default = false).
+     */
+    bool bake_static_geometry;
+
   protected:
     virtual double calc_next_CA_Euler_step(const PairwiseDistInfo& pdi) { return calc_next_CA_Euler_step_generic(pdi); }
+    static BVPtr construct_bounding_sphere(CollisionGeometryPtr cg);
 
   private:
     // the 3 axes
     enum AxisType { eXAxis, eYAxis, eZAxis };
 
     static double sqr(double x) { return x*x; }
-    double calc_next_CA_Euler_step_polyhedron_plane(boost::shared_ptr<PolyhedralPrimitive> p, const Ravelin::SVelocityd& rv, boost::shared_ptr<const Ravelin::Pose3d> P, const Ravelin::Vector3d& normal, double offset);
-    double calc_next_CA_Euler_step_polyhedron_polyhedron(boost::shared_ptr<PolyhedralPrimitive> pA, boost::shared_ptr<PolyhedralPrimitive> pB, boost::shared_ptr<const Ravelin::Pose3d> poseA, boost::shared_ptr<const Ravelin::Pose3d> poseB, const Ravelin::SVelocityd& rvA, const Ravelin::SVelocityd& rvB, const Ravelin::Vector3d& n0, double offset);
+    void broad_phase_compound(double dt, const std::vector<RigidBodyPtr>& rbs, std::vector<std::pair<CollisionGeometryPtr, CollisionGeometryPtr> >& to_check);
+    double calc_next_CA_Euler_step_polyhedron_plane(CollisionGeometryPtr cgP, CollisionGeometryPtr cgPlane, boost::shared_ptr<PolyhedralPrimitive> p, const Ravelin::SVelocityd& rv, boost::shared_ptr<const Ravelin::Pose3d> P, const Ravelin::Vector3d& normal, double offset);
+    double calc_next_CA_Euler_step_polyhedron_polyhedron(CollisionGeometryPtr cgA, CollisionGeometryPtr cgB, boost::shared_ptr<PolyhedralPrimitive> pA, boost::shared_ptr<PolyhedralPrimitive> pB, boost::shared_ptr<const Ravelin::Pose3d> poseA, boost::shared_ptr<const Ravelin::Pose3d> poseB, const Ravelin::SVelocityd& rvA, const Ravelin::SVelocityd& rvB, const Ravelin::Vector3d& n0, double offset);
     virtual double calc_next_CA_Euler_step_generic(const PairwiseDistInfo& pdi);
     virtual double calc_CA_Euler_step_generic(const PairwiseDistInfo& pdi);
     virtual double calc_CA_Euler_step_sphere(const PairwiseDistInfo& pdi);
@@ -84,6 +135,7 @@ class CCD : public CollisionDetection
       bool end;                   // bounds is for start or end
       CollisionGeometryPtr geom;  // the geometry
       BVPtr bv;                   // the unexpanded bounding volume
+      unsigned idx;               // index into the packed swept-bounds array
       bool operator<(const BoundsStruct& bs) const { return (!end && bs.end); }
     };
 
@@ -105,17 +157,60 @@ class CCD : public CollisionDetection
     /// AABB bounds (z-axis)
     std::vector<std::pair<double, BoundsStruct> > _z_bounds;
 
+    /// Packed world-space swept bounds, six doubles per geometry (lower and upper bound per axis), refilled once per step
+    std::vector<double> _packed_bounds;
+
+    /// Number of packed swept-bounds slots (high-water mark until the next rebuild)
+    unsigned _n_packed_bounds;
+
+    // a node of the baked hierarchy over static geometry bounds
+    struct StaticNode
+    {
+      double lo[3], hi[3];        // world-space node bounds
+      int left, right;            // child node indices (-1 at leaves)
+      int geom;                   // index into _static_geoms at leaves (-1 otherwise)
+    };
+
+    /// Baked world-space hierarchy over all static geometry (see bake_static_geometry)
+    std::vector<StaticNode> _static_nodes;
+
+    /// Leaf geometries of the baked static hierarchy, indexed by StaticNode::geom
+    std::vector<CollisionGeometryPtr> _static_geoms;
+
+    /// Sorted snapshot of the static geometries covered by the current bake
+    std::vector<CollisionGeometryPtr> _static_baked;
+
+    /// Root node index of the baked static hierarchy (-1 when empty)
+    int _static_root;
+
     /// Swept BVs computed during last call to is_contact/update_contacts()
     std::map<CollisionGeometryPtr, BVPtr> _swept_BVs;
 
     /// Minimum observed distance between two bodies (to make conservative advancement faster in face of numerical error)
     std::map<Ravelin::sorted_pair<CollisionGeometryPtr>, double> _min_dist_observed;
 
-    static BVPtr construct_bounding_sphere(CollisionGeometryPtr cg);
+    /// Last separating axis found for a box-box pair (indexes the 15 SAT candidate axes); tested first on the next query
+    std::map<std::pair<CollisionGeometryPtr, CollisionGeometryPtr>, unsigned> _box_box_sep_axis;
+
+    /// Closest feature pairs from the last v-clip query, keyed on the geometry pair; used to warm-start temporally coherent polyhedron/polyhedron queries
+    std::map<std::pair<CollisionGeometryPtr, CollisionGeometryPtr>, std::pair<boost::shared_ptr<const Polyhedron::Feature>, boost::shared_ptr<const Polyhedron::Feature> > > _vclip_features;
+
+    /// Continuation cursors for budgeted polyhedral conservative-advancement scans, keyed on the geometry pair (see ca_vertex_budget)
+    std::map<std::pair<CollisionGeometryPtr, CollisionGeometryPtr>, std::pair<unsigned, unsigned> > _ca_cursors;
+
+    /// Relative transforms memoized for the current step (cleared each broad phase)
+    TransformCache _transform_cache;
+
+    void sweep_axis(const std::vector<std::pair<double, BoundsStruct> >& bounds, std::vector<Ravelin::sorted_pair<CollisionGeometryPtr> >& overlaps);
     void sort_AABBs(const std::vector<RigidBodyPtr>& rigid_bodies, double dt);
-    void update_bounds_vector(std::vector<std::pair<double, BoundsStruct> >& bounds, AxisType axis, double dt, bool recreate_bvs);
+    void add_bounds(CollisionGeometryPtr geom, BVPtr bv);
+    void remove_bounds(CollisionGeometryPtr geom);
+    void update_packed_bounds(double dt);
+    void update_bounds_vector(std::vector<std::pair<double, BoundsStruct> >& bounds, AxisType axis);
     void build_bv_vector(const std::vector<RigidBodyPtr>& rigid_bodies, std::vector<std::pair<double, BoundsStruct> >& bounds);
     BVPtr get_swept_BV(CollisionGeometryPtr geom, BVPtr bv, double dt);
+    void update_static_tree(double dt, const std::vector<RigidBodyPtr>& static_rbs);
+    void query_static_tree(int n, const double lo[3], const double hi[3], CollisionGeometryPtr geom, std::vector<std::pair<CollisionGeometryPtr, CollisionGeometryPtr> >& to_check) const;
 
     bool intersect_BV_trees(boost::shared_ptr<BV> a, boost::shared_ptr<BV> b, const Ravelin::Transform3d& aTb, CollisionGeometryPtr geom_a, CollisionGeometryPtr geom_b);
 
@@ -155,6 +250,9 @@ class CCD : public CollisionDetection
     template <class OutputIterator>
     OutputIterator find_contacts_box_sphere(CollisionGeometryPtr cgA, CollisionGeometryPtr cgB, OutputIterator output_begin, double TOL);
 
+    template <class OutputIterator>
+    OutputIterator find_contacts_box_box(CollisionGeometryPtr cgA, CollisionGeometryPtr cgB, OutputIterator output_begin, double TOL);
+
     template <class RandomAccessIterator>
     void insertion_sort(RandomAccessIterator begin, RandomAccessIterator end);
 
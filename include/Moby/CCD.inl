@@ -18,7 +18,9 @@ OutputIterator CCD::find_contacts(CollisionGeometryPtr cgA, CollisionGeometryPtr
   }
   else if (boost::dynamic_pointer_cast<BoxPrimitive>(pA))
   {
-    if (boost::dynamic_pointer_cast<PlanePrimitive>(pB))
+    if (boost::dynamic_pointer_cast<BoxPrimitive>(pB))
+      return find_contacts_box_box(cgA, cgB, output_begin, TOL);
+    else if (boost::dynamic_pointer_cast<PlanePrimitive>(pB))
       return find_contacts_plane_generic(cgB, cgA, output_begin, TOL);
     else if (boost::dynamic_pointer_cast<PolyhedralPrimitive>(pB))
       return find_contacts_polyhedron_polyhedron(cgA, cgB, output_begin, TOL);
@@ -106,14 +108,24 @@ OutputIterator CCD::find_contacts_polyhedron_polyhedron(CollisionGeometryPtr cgA
   boost::shared_ptr<const Ravelin::Pose3d> poseA = pA->get_pose(cgA);
   boost::shared_ptr<const Ravelin::Pose3d> poseB = pB->get_pose(cgB);
 
-  // get transforms to global frame
-  Ravelin::Transform3d wTa = Ravelin::Pose3d::calc_relative_pose(poseA, GLOBAL);
-  Ravelin::Transform3d wTb = Ravelin::Pose3d::calc_relative_pose(poseB, GLOBAL);
-
-  // call v-clip
-  boost::shared_ptr<const Polyhedron::Feature> closestA;
-  boost::shared_ptr<const Polyhedron::Feature> closestB;
+  // get transforms to global frame (memoized; every query this step for a
+  // pose pair shares one composition)
+  const Ravelin::Transform3d& wTa = _transform_cache.get(poseA, GLOBAL);
+  const Ravelin::Transform3d& wTb = _transform_cache.get(poseB, GLOBAL);
+
+  // call v-clip, warm-started from the feature pair that was closest on the
+  // last query for this geometry pair; with temporal coherence the feature
+  // walk then terminates after a handful of feature tests rather than
+  // traversing the polyhedra from an arbitrary starting feature (the seed
+  // affects only the length of the walk, never the answer)
+  std::pair<boost::shared_ptr<const Polyhedron::Feature>, boost::shared_ptr<const Polyhedron::Feature> >& fcache = _vclip_features[std::make_pair(cgA, cgB)];
+  boost::shared_ptr<const Polyhedron::Feature> closestA = fcache.first;
+  boost::shared_ptr<const Polyhedron::Feature> closestB = fcache.second;
   double dist = Polyhedron::vclip(pA, pB, poseA, poseB, closestA, closestB);
+
+  // save the closest features for the next query on this pair
+  fcache.first = closestA;
+  fcache.second = closestB;
   FILE_LOG(LOG_COLDET) << "v-clip reports distance of " << dist << std::endl;
 
   // see whether to generate contacts
@@ -293,8 +305,10 @@ OutputIterator CCD::find_contacts_polyhedron_polyhedron(CollisionGeometryPtr cgA
       // get the normal
       const Ravelin::Vector3d& n = planes.front().first.get_normal(); 
 
-      // compute the convex hulls of the two sets of vertices
-      std::vector<Point3d> voA, voB, hullA, hullB;
+      // compute the convex hulls of the two sets of vertices (manifolds are
+      // almost always small, so the scratch containers keep their storage
+      // inline and only spill to the heap for unusually rich contact sets)
+      SmallVector<Point3d, 8> voA, voB, hullA, hullB;
       BOOST_FOREACH(boost::shared_ptr<Polyhedron::Vertex> v, vertsA)
         voA.push_back(wTa.transform_point(Point3d(v->o, poseA)));
       BOOST_FOREACH(boost::shared_ptr<Polyhedron::Vertex> v, vertsB)
@@ -303,7 +317,7 @@ OutputIterator CCD::find_contacts_polyhedron_polyhedron(CollisionGeometryPtr cgA
       CompGeom::calc_convex_hull(voB.begin(), voB.end(), n, std::back_inserter(hullB));
 
       // compute the intersection of the convex hulls 
-      std::vector<Point3d> isect;
+      SmallVector<Point3d, 8> isect;
       CompGeom::intersect_convex_polygons(hullA.begin(), hullA.end(), 
                                           hullB.begin(), hullB.end(), n, 
                                           std::back_inserter(isect));
@@ -536,7 +550,7 @@ OutputIterator CCD::find_contacts_edge_face(CollisionGeometryPtr cgA, CollisionG
   Ravelin::Vector3d normal(Ravelin::Origin3d(fB->get_plane().get_normal()), cgB->get_pose());
   
   //We calculate the transform from cgB to GLOBAL for later use
-  Ravelin::Transform3d wTB = Ravelin::Pose3d::calc_relative_pose(cgB->get_pose(),GLOBAL);
+  const Ravelin::Transform3d& wTB = _transform_cache.get(cgB->get_pose(), GLOBAL);
   
   //transform the normal to the global frame
   Ravelin::Vector3d normal0=wTB.transform_vector(normal);
@@ -561,7 +575,7 @@ OutputIterator CCD::find_contacts_edge_face(CollisionGeometryPtr cgA, CollisionG
   }
 
   //Finding transform matrix for the edge
-  Ravelin::Transform3d wTA = Ravelin::Pose3d::calc_relative_pose(cgA->get_pose(),GLOBAL);
+  const Ravelin::Transform3d& wTA = _transform_cache.get(cgA->get_pose(), GLOBAL);
 
   //Transforming v1
   Ravelin::Vector3d v1(Ravelin::Origin3d(eA->v1->o), cgA->get_pose());
@@ -603,14 +617,14 @@ OutputIterator CCD::find_contacts_face_face(CollisionGeometryPtr cgA, CollisionG
   Ravelin::Vector3d normal(Ravelin::Origin3d(fA->get_plane().get_normal()), cgA->get_pose());
   
   //We calculate the transform from cgB to GLOBAL for later use
-  Ravelin::Transform3d wTA = Ravelin::Pose3d::calc_relative_pose(cgA->get_pose(),GLOBAL);
+  const Ravelin::Transform3d& wTA = _transform_cache.get(cgA->get_pose(), GLOBAL);
   
   //transform the normal to the global frame
   Ravelin::Vector3d normal_0=wTA.transform_vector(normal);
 
   //get all vertex from face
   Polyhedron::VertexFaceIterator vfiA(fA,true);
-  std::vector<Ravelin::Vector3d> v3dA;
+  SmallVector<Ravelin::Vector3d, 8> v3dA;
   while(vfiA.has_next()){
     boost::shared_ptr<Polyhedron::Vertex> v=*vfiA;
     vfiA.advance();
@@ -621,11 +635,11 @@ OutputIterator CCD::find_contacts_face_face(CollisionGeometryPtr cgA, CollisionG
 
   //Face B:
   //We calculate the transform from cgB to GLOBAL for later use
-  Ravelin::Transform3d wTB = Ravelin::Pose3d::calc_relative_pose(cgB->get_pose(),GLOBAL);
+  const Ravelin::Transform3d& wTB = _transform_cache.get(cgB->get_pose(), GLOBAL);
   
   //2. get all vertex from face
   Polyhedron::VertexFaceIterator vfiB(fB,true);
-  std::vector<Ravelin::Vector3d> v3dB;
+  SmallVector<Ravelin::Vector3d, 8> v3dB;
   while(vfiB.has_next()){
     boost::shared_ptr<Polyhedron::Vertex> v=*vfiB;
     vfiB.advance();
@@ -634,8 +648,8 @@ OutputIterator CCD::find_contacts_face_face(CollisionGeometryPtr cgA, CollisionG
     v3dB.push_back(p0);
   }
   
-  //intersectiong 2 faces
-  std::vector<Point3d> isect;
+  //intersectiong 2 faces (scratch storage stays inline for typical manifolds)
+  SmallVector<Point3d, 8> isect;
   CompGeom::intersect_convex_polygons(v3dA.begin(),v3dA.end(),v3dB.begin(),v3dB.end(),normal_0,std::back_inserter(isect));
   //adding output
   for(unsigned i=0;i<isect.size();i++){
@@ -952,7 +966,7 @@ OutputIterator CCD::find_contacts_sphere_heightmap(CollisionGeometryPtr cgA, Col
   boost::shared_ptr<const Ravelin::Pose3d> pB = hmB->get_pose(cgB);
 
   // get the transform from the sphere pose to the heightmap
-  Ravelin::Transform3d T = Ravelin::Pose3d::calc_relative_pose(pA, pB);
+  const Ravelin::Transform3d& T = _transform_cache.get(pA, pB);
 
   // transform the sphere center to the height map space
   Point3d ps_c(0.0, 0.0, 0.0, pA);
@@ -992,27 +1006,30 @@ OutputIterator CCD::find_contacts_sphere_heightmap(CollisionGeometryPtr cgA, Col
   bv_lo[Z] -= sA->get_radius();
   bv_hi[Z] += sA->get_radius();
 
-  // get the heightmap width, depth, and heights
+  // get the heightmap width, depth, and grid dimensions (height samples are
+  // read through the accessor so that paged heightmaps fault in only the
+  // tiles under the queried region)
   double width = hmB->get_width();
   double depth = hmB->get_depth();
-  const Ravelin::MatrixNd& heights = hmB->get_heights();
+  const unsigned HM_ROWS = hmB->rows();
+  const unsigned HM_COLS = hmB->columns();
 
   // get the lower i and j indices
-  unsigned lowi = constrain_unsigned((bv_lo[X]+width*0.5)*(heights.rows()-1)/width,heights.rows()-1);
-  unsigned lowj = constrain_unsigned((bv_lo[Z]+depth*0.5)*(heights.columns()-1)/depth,heights.columns()-1);
+  unsigned lowi = constrain_unsigned((bv_lo[X]+width*0.5)*(HM_ROWS-1)/width,HM_ROWS-1);
+  unsigned lowj = constrain_unsigned((bv_lo[Z]+depth*0.5)*(HM_COLS-1)/depth,HM_COLS-1);
 
   // get the upper i and j indices
-  unsigned upi = constrain_unsigned(((bv_hi[X]+width*0.5)*(heights.rows()-1)/width)+1,heights.rows()-1);
-  unsigned upj = constrain_unsigned(((bv_hi[Z]+depth*0.5)*(heights.columns()-1)/depth)+1,heights.columns()-1);
+  unsigned upi = constrain_unsigned(((bv_hi[X]+width*0.5)*(HM_ROWS-1)/width)+1,HM_ROWS-1);
+  unsigned upj = constrain_unsigned(((bv_hi[Z]+depth*0.5)*(HM_COLS-1)/depth)+1,HM_COLS-1);
 
   // iterate over all points in the bounding region
   for (unsigned i=lowi; i< upi; i++)
     for (unsigned j=lowj; j< upj; j++)
     {
       // compute the point on the heightmap
-      double x = -width*0.5+width*i/(heights.rows()-1);
-      double z = -depth*0.5+depth*j/(heights.columns()-1);
-      Point3d p(x, heights(i,j), z, pB);
+      double x = -width*0.5+width*i/(HM_ROWS-1);
+      double z = -depth*0.5+depth*j/(HM_COLS-1);
+      Point3d p(x, hmB->height(i,j), z, pB);
 
       // get the distance from the primitive
       Point3d p_A = Ravelin::Pose3d::transform_point(pA, p);
@@ -1063,14 +1080,18 @@ OutputIterator CCD::find_contacts_convex_heightmap(CollisionGeometryPtr cgA, Col
   boost::shared_ptr<const Ravelin::Pose3d> pB = hmB->get_pose(cgB);
 
   // get the transform from the primitive pose to the heightmap
-  Ravelin::Transform3d T = Ravelin::Pose3d::calc_relative_pose(pA, pB);
+  const Ravelin::Transform3d& T = _transform_cache.get(pA, pB);
 
-  // intersect vertices from the convex primitive against the heightmap
-  std::vector<Point3d> cverts;
+  // intersect vertices from the convex primitive against the heightmap; the
+  // whole vertex batch is brought into heightmap space in one tight pass
+  // before the per-vertex tests
+  std::vector<Point3d> cverts, hverts;
   sA->get_vertices(pA, cverts);
+  hverts.reserve(cverts.size());
+  TransformCache::transform_points(T, cverts.begin(), cverts.end(), std::back_inserter(hverts));
   for (unsigned i=0; i< cverts.size(); i++)
   {
-    Point3d pt = T.transform_point(cverts[i]);
+    const Point3d& pt = hverts[i];
     const double HEIGHT = hmB->calc_height(pt);
     if (HEIGHT < TOL)
     {
@@ -1110,27 +1131,30 @@ OutputIterator CCD::find_contacts_convex_heightmap(CollisionGeometryPtr cgA, Col
   bv_lo = obb.get_lower_bounds();
   bv_hi = obb.get_upper_bounds();
 
-  // get the heightmap width, depth, and heights
+  // get the heightmap width, depth, and grid dimensions (height samples are
+  // read through the accessor so that paged heightmaps fault in only the
+  // tiles under the queried region)
   double width = hmB->get_width();
   double depth = hmB->get_depth();
-  const Ravelin::MatrixNd& heights = hmB->get_heights();
+  const unsigned HM_ROWS = hmB->rows();
+  const unsigned HM_COLS = hmB->columns();
 
   // get the lower i and j indices
-  unsigned lowi = constrain_unsigned((bv_lo[X]+width*0.5)*(heights.rows()-1)/width,heights.rows()-1);
-  unsigned lowj = constrain_unsigned((bv_lo[Z]+depth*0.5)*(heights.columns()-1)/depth,heights.columns()-1);
+  unsigned lowi = constrain_unsigned((bv_lo[X]+width*0.5)*(HM_ROWS-1)/width,HM_ROWS-1);
+  unsigned lowj = constrain_unsigned((bv_lo[Z]+depth*0.5)*(HM_COLS-1)/depth,HM_COLS-1);
 
   // get the upper i and j indices
-  unsigned upi = constrain_unsigned(((bv_hi[X]+width*0.5)*(heights.rows()-1)/width)+1,heights.rows()-1);
-  unsigned upj = constrain_unsigned(((bv_hi[Z]+depth*0.5)*(heights.columns()-1)/depth)+1,heights.columns()-1);
+  unsigned upi = constrain_unsigned(((bv_hi[X]+width*0.5)*(HM_ROWS-1)/width)+1,HM_ROWS-1);
+  unsigned upj = constrain_unsigned(((bv_hi[Z]+depth*0.5)*(HM_COLS-1)/depth)+1,HM_COLS-1);
 
   // iterate over all points in the bounding region
   for (unsigned i=lowi; i<= upi; i++)
     for (unsigned j=lowj; j< upj; j++)
     {
       // compute the point on the heightmap
-      double x = -width*0.5+width*i/(heights.rows()-1);
-      double z = -depth*0.5+depth*j/(heights.columns()-1);
-      Point3d p(x, heights(i,j), z, pB);
+      double x = -width*0.5+width*i/(HM_ROWS-1);
+      double z = -depth*0.5+depth*j/(HM_COLS-1);
+      Point3d p(x, hmB->height(i,j), z, pB);
 
       // get the distance from the primitive
       Point3d p_A = Ravelin::Pose3d::transform_point(pA, p);
@@ -1258,7 +1282,238 @@ OutputIterator CCD::find_contacts_box_sphere(CollisionGeometryPtr cgA, Collision
   return o;
 }
 
-/// Gets contact points between a torus and a plane 
+/// Finds contacts between two boxes using separating axis tests
+/**
+ * Computes a full contact manifold (up to eight points for face-face
+ * configurations) analytically from the box geometry, avoiding both GJK
+ * iteration and the polyhedral feature-walking machinery. The last
+ * separating axis found for a pair is cached and tested first on the next
+ * query, so temporally coherent separated pairs are rejected with a single
+ * axis test.
+ */
+template <class OutputIterator>
+OutputIterator CCD::find_contacts_box_box(CollisionGeometryPtr cgA, CollisionGeometryPtr cgB, OutputIterator o, double TOL)
+{
+  const double INF = std::numeric_limits<double>::max();
+  const unsigned N_SAT_AXES = 15, MAX_MANIFOLD = 8;
+
+  // get the two boxes
+  boost::shared_ptr<BoxPrimitive> bA = boost::dynamic_pointer_cast<BoxPrimitive>(cgA->get_geometry());
+  boost::shared_ptr<BoxPrimitive> bB = boost::dynamic_pointer_cast<BoxPrimitive>(cgB->get_geometry());
+
+  // get the box poses and the transforms to the global frame
+  boost::shared_ptr<const Ravelin::Pose3d> poseA = bA->get_pose(cgA);
+  boost::shared_ptr<const Ravelin::Pose3d> poseB = bB->get_pose(cgB);
+  const Ravelin::Transform3d& wTa = _transform_cache.get(poseA, GLOBAL);
+  const Ravelin::Transform3d& wTb = _transform_cache.get(poseB, GLOBAL);
+
+  // get the half-extents of both boxes
+  double eA[3], eB[3];
+  eA[0] = bA->get_x_len()*0.5; eA[1] = bA->get_y_len()*0.5; eA[2] = bA->get_z_len()*0.5;
+  eB[0] = bB->get_x_len()*0.5; eB[1] = bB->get_y_len()*0.5; eB[2] = bB->get_z_len()*0.5;
+
+  // compute the box centers and axes in the global frame
+  Point3d cA = wTa.transform_point(Point3d(0.0, 0.0, 0.0, poseA));
+  Point3d cB = wTb.transform_point(Point3d(0.0, 0.0, 0.0, poseB));
+  Ravelin::Vector3d uA[3], uB[3];
+  uA[0] = wTa.transform_vector(Ravelin::Vector3d(1.0, 0.0, 0.0, poseA));
+  uA[1] = wTa.transform_vector(Ravelin::Vector3d(0.0, 1.0, 0.0, poseA));
+  uA[2] = wTa.transform_vector(Ravelin::Vector3d(0.0, 0.0, 1.0, poseA));
+  uB[0] = wTb.transform_vector(Ravelin::Vector3d(1.0, 0.0, 0.0, poseB));
+  uB[1] = wTb.transform_vector(Ravelin::Vector3d(0.0, 1.0, 0.0, poseB));
+  uB[2] = wTb.transform_vector(Ravelin::Vector3d(0.0, 0.0, 1.0, poseB));
+
+  // get the vector between the box centers
+  Ravelin::Vector3d d = cB - cA;
+
+  // order the candidate axes so that a cached separating axis is tested first
+  const std::pair<CollisionGeometryPtr, CollisionGeometryPtr> key = std::make_pair(cgA, cgB);
+  unsigned order[N_SAT_AXES];
+  for (unsigned k=0; k< N_SAT_AXES; k++)
+    order[k] = k;
+  std::map<std::pair<CollisionGeometryPtr, CollisionGeometryPtr>, unsigned>::const_iterator cache_iter = _box_box_sep_axis.find(key);
+  if (cache_iter != _box_box_sep_axis.end())
+    std::swap(order[0], order[cache_iter->second]);
+
+  // test the fifteen candidate axes (A's face normals, B's face normals, and
+  // the nine edge direction cross products), tracking the axis of minimum
+  // penetration; face and edge axes are tracked separately so that faces can
+  // be preferred when depths are comparable (edge manifolds are single points
+  // and yield jittery stacking)
+  double best_face_depth = INF, best_edge_depth = INF;
+  unsigned best_face = 0, best_edge = 0;
+  Ravelin::Vector3d best_face_n(GLOBAL), best_edge_n(GLOBAL);
+  for (unsigned m=0; m< N_SAT_AXES; m++)
+  {
+    const unsigned k = order[m];
+
+    // build the candidate axis, skipping near-parallel edge pairs
+    Ravelin::Vector3d n(GLOBAL);
+    if (k < 3)
+      n = uA[k];
+    else if (k < 6)
+      n = uB[k-3];
+    else
+    {
+      n = Ravelin::Vector3d::cross(uA[(k-6)/3], uB[(k-6)%3]);
+      double nrm = n.norm();
+      if (nrm < NEAR_ZERO)
+        continue;
+      n /= nrm;
+    }
+
+    // project both boxes and the center offset onto the axis
+    double ra = eA[0]*std::fabs(n.dot(uA[0])) + eA[1]*std::fabs(n.dot(uA[1])) + eA[2]*std::fabs(n.dot(uA[2]));
+    double rb = eB[0]*std::fabs(n.dot(uB[0])) + eB[1]*std::fabs(n.dot(uB[1])) + eB[2]*std::fabs(n.dot(uB[2]));
+    double dn = n.dot(d);
+    double depth = ra + rb - std::fabs(dn);
+
+    // a separating axis disposes of the pair; remember it for next time
+    if (depth < -TOL)
+    {
+      _box_box_sep_axis[key] = k;
+      return o;
+    }
+
+    // orient the axis to point away from B (the contact normal convention)
+    Ravelin::Vector3d np = (dn > 0.0) ? -n : n;
+    if (k < 6)
+    {
+      if (depth < best_face_depth)
+      {
+        best_face_depth = depth;
+        best_face = k;
+        best_face_n = np;
+      }
+    }
+    else if (depth < best_edge_depth)
+    {
+      best_edge_depth = depth;
+      best_edge = k;
+      best_edge_n = np;
+    }
+  }
+
+  // the boxes are touching; any cached separating axis is stale
+  _box_box_sep_axis.erase(key);
+
+  // use an edge-edge contact only when its depth is clearly smaller than the
+  // best face depth
+  if (best_edge_depth < best_face_depth*0.95)
+  {
+    const unsigned i = (best_edge-6)/3, j = (best_edge-6)%3;
+
+    // find the supporting edges: fix the extremal coordinates along the two
+    // axes perpendicular to each edge direction
+    Ravelin::Vector3d nAB = -best_edge_n;
+    Point3d pA0 = cA, pB0 = cB;
+    for (unsigned k=0; k< 3; k++)
+    {
+      if (k != i)
+        pA0 += uA[k]*((nAB.dot(uA[k]) > 0.0) ? eA[k] : -eA[k]);
+      if (k != j)
+        pB0 -= uB[k]*((nAB.dot(uB[k]) > 0.0) ? eB[k] : -eB[k]);
+    }
+
+    // compute the closest points on the two edge lines
+    Ravelin::Vector3d w = pB0 - pA0;
+    double b = uA[i].dot(uB[j]);
+    double e = uA[i].dot(w), f = uB[j].dot(w);
+    double denom = 1.0 - b*b;
+    double s = (denom > NEAR_ZERO) ? (e - b*f)/denom : 0.0;
+    double t = b*s - f;
+    Point3d p = (pA0 + uA[i]*s + pB0 + uB[j]*t)*0.5;
+    *o++ = create_contact(cgA, cgB, p, best_edge_n, -best_edge_depth);
+    return o;
+  }
+
+  // face contact: the box owning the minimum-penetration axis supplies the
+  // reference face; the other box supplies the incident face
+  const bool ref_is_A = (best_face < 3);
+  const Ravelin::Vector3d* uR = (ref_is_A) ? uA : uB;
+  const Ravelin::Vector3d* uI = (ref_is_A) ? uB : uA;
+  const double* eR = (ref_is_A) ? eA : eB;
+  const double* eI = (ref_is_A) ? eB : eA;
+  Point3d cR = (ref_is_A) ? cA : cB;
+  Point3d cI = (ref_is_A) ? cB : cA;
+  const unsigned rax = (ref_is_A) ? best_face : best_face-3;
+
+  // outward normal and center of the reference face
+  Ravelin::Vector3d nref = uR[rax];
+  if (nref.dot(cI - cR) < 0.0)
+    nref = -nref;
+  Point3d fcR = cR + nref*eR[rax];
+
+  // the incident face is the face of the other box most anti-parallel to the
+  // reference normal
+  unsigned iax = 0;
+  double max_dot = 0.0;
+  for (unsigned k=0; k< 3; k++)
+  {
+    double dk = std::fabs(nref.dot(uI[k]));
+    if (dk > max_dot)
+    {
+      max_dot = dk;
+      iax = k;
+    }
+  }
+  Point3d fcI = cI + uI[iax]*((nref.dot(uI[iax]) > 0.0) ? -eI[iax] : eI[iax]);
+
+  // get the corners of the incident face
+  const unsigned i1 = (iax+1)%3, i2 = (iax+2)%3;
+  Ravelin::Vector3d s1 = uI[i1]*eI[i1], s2 = uI[i2]*eI[i2];
+  Point3d poly[MAX_MANIFOLD], clipped[MAX_MANIFOLD];
+  unsigned npoly = 4;
+  poly[0] = fcI + s1 + s2;
+  poly[1] = fcI - s1 + s2;
+  poly[2] = fcI - s1 - s2;
+  poly[3] = fcI + s1 - s2;
+
+  // clip the incident face against the four side planes of the reference face
+  // (Sutherland-Hodgman); the result has at most eight vertices
+  for (unsigned plane=0; plane< 4 && npoly > 0; plane++)
+  {
+    const unsigned tax = (rax + 1 + plane/2)%3;
+    Ravelin::Vector3d t = (plane % 2 == 0) ? uR[tax] : -uR[tax];
+    unsigned nclipped = 0;
+    for (unsigned v=0; v< npoly; v++)
+    {
+      const Point3d& p0 = poly[v];
+      const Point3d& p1 = poly[(v+1)%npoly];
+      double d0 = t.dot(p0 - fcR) - eR[tax];
+      double d1 = t.dot(p1 - fcR) - eR[tax];
+      if (d0 <= 0.0)
+        clipped[nclipped++] = p0;
+      if ((d0 < 0.0) != (d1 < 0.0))
+        clipped[nclipped++] = p0 + (p1 - p0)*(d0/(d0 - d1));
+    }
+    std::copy(clipped, clipped+nclipped, poly);
+    npoly = nclipped;
+  }
+
+  // emit a contact for every clipped point at or below the reference face;
+  // the normal points away from B
+  Ravelin::Vector3d normal = (ref_is_A) ? -nref : nref;
+  unsigned nc = 0;
+  for (unsigned v=0; v< npoly; v++)
+  {
+    double dist = nref.dot(poly[v] - fcR);
+    if (dist <= TOL)
+    {
+      *o++ = create_contact(cgA, cgB, poly[v], normal, dist);
+      nc++;
+    }
+  }
+
+  // degenerate clip (e.g., boxes touching exactly edge-on): fall back to the
+  // generic polyhedral machinery rather than reporting no contact
+  if (nc == 0)
+    return find_contacts_polyhedron_polyhedron(cgA, cgB, o, TOL);
+
+  return o;
+}
+
+/// Gets contact points between a torus and a plane
 template <class OutputIterator>
 OutputIterator CCD::find_contacts_torus_plane(CollisionGeometryPtr cgA, CollisionGeometryPtr cgB, OutputIterator o, double TOL)
 {
@@ -25,6 +25,8 @@ class CSG : public Primitive
     virtual void get_vertices(boost::shared_ptr<const Ravelin::Pose3d> P, std::vector<Point3d>& vertices);
 //    virtual void get_vertices(BVPtr bv, std::vector<const Point3d*>& vertices); 
     virtual double calc_dist_and_normal(const Point3d& p, Ravelin::Vector3d& normal) const;
+    virtual double calc_signed_dist(const Point3d& p) const;
+    virtual double get_bounding_radius() const;
 //    virtual bool intersect_seg(BVPtr bv, const LineSeg3& seg, double& t, Point3d& isect, Ravelin::Vector3d& normal) const;
     virtual osg::Node* create_visualization();
     virtual boost::shared_ptr<const IndexedTriArray> get_mesh(boost::shared_ptr<const Ravelin::Pose3d> P); 
@@ -44,6 +46,8 @@ class CSG : public Primitive
 //    bool intersect_seg_diff(BVPtr bv, const LineSeg3& seg, double& t, Point3d& isect, Ravelin::Vector3d& normal) const;
     virtual void calc_mass_properties();
     void center_mesh();
+    void update_bounds() const;
+    long long memo_cell_key(const Point3d& p) const;
 
     /// The axis aligned bounding box for this primitive
     boost::shared_ptr<AABB> _aabb;
@@ -59,6 +63,22 @@ class CSG : public Primitive
 
     /// A pointer to the computed triangle mesh
     boost::shared_ptr<IndexedTriArray> _mesh;
+
+    /// Whether the cached operand bounds below are current
+    mutable bool _bounds_valid;
+
+    /// Cached operand bounding sphere centers (in the CSG frame)
+    mutable Ravelin::Origin3d _bcenter1, _bcenter2;
+
+    /// Cached operand bounding sphere radii
+    mutable double _brad1, _brad2;
+
+    /// Edge length of the spatial memoization cells
+    mutable double _memo_cell_size;
+
+    /// The operand (1 or 2) that determined the last signed distance query
+    /// from each spatial cell
+    mutable std::map<long long, unsigned char> _dominant_cells;
 }; // end class
 
 } // end namespace
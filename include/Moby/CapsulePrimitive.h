@@ -0,0 +1,79 @@
+/****************************************************************************
+ * Copyright 2005 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _CAPSULE_PRIMITIVE_H
+#define _CAPSULE_PRIMITIVE_H
+
+#include <Moby/Primitive.h>
+
+namespace Moby {
+
+class SSL;
+class SpherePrimitive;
+class BoxPrimitive;
+class PlanePrimitive;
+
+/// Defines a capsule (sphere-swept segment) primitive
+/**
+ * The capsule is aligned with the y-axis of its pose: it is the set of
+ * points within distance \a radius of the segment from (0,-height/2,0) to
+ * (0,height/2,0).  Because the surface is a sphere sweep, distance queries
+ * against points, spheres, and other capsules reduce to segment distance
+ * computations, and are evaluated in closed form.
+ */
+class CapsulePrimitive : public Primitive
+{
+  public:
+    CapsulePrimitive();
+    CapsulePrimitive(double radius, double height);
+    CapsulePrimitive(double radius, double height, const Ravelin::Pose3d& T);
+    virtual bool is_convex() const { return true; }
+    void set_radius(double radius);
+    void set_height(double height);
+    virtual void set_pose(const Ravelin::Pose3d& T);
+    virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
+    virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
+    virtual BVPtr get_BVH_root(CollisionGeometryPtr geom);
+    virtual void get_vertices(boost::shared_ptr<const Ravelin::Pose3d> P, std::vector<Point3d>& vertices) const;
+    virtual double calc_dist_and_normal(const Point3d& point, std::vector<Ravelin::Vector3d>& normals) const;
+    virtual double calc_signed_dist(boost::shared_ptr<const Primitive> p, Point3d& pthis, Point3d& pp) const;
+    double calc_signed_dist(boost::shared_ptr<const CapsulePrimitive> c, Point3d& pthis, Point3d& pcap) const;
+    double calc_signed_dist(boost::shared_ptr<const SpherePrimitive> s, Point3d& pthis, Point3d& psph) const;
+    double calc_signed_dist(boost::shared_ptr<const PlanePrimitive> p, Point3d& pthis, Point3d& pplane) const;
+    double calc_signed_dist(boost::shared_ptr<const BoxPrimitive> b, Point3d& pthis, Point3d& pbox) const;
+    virtual boost::shared_ptr<const IndexedTriArray> get_mesh(boost::shared_ptr<const Ravelin::Pose3d> P);
+    virtual osg::Node* create_visualization();
+    virtual Point3d get_supporting_point(const Ravelin::Vector3d& d) const;
+    virtual double calc_signed_dist(const Point3d& p) const;
+    virtual void calc_signed_dists(const Point3d* points, unsigned n, double* dists) const;
+    virtual double get_bounding_radius() const { return _height*0.5 + _radius; }
+
+    /// Gets the radius of this capsule
+    double get_radius() const { return _radius; }
+
+    /// Gets the height (length of the cylindrical portion) of this capsule
+    double get_height() const { return _height; }
+
+  private:
+    virtual void calc_mass_properties();
+    double calc_closest_point(const Point3d& p, Point3d& closest) const;
+
+    /// Radius of the capsule
+    double _radius;
+
+    /// Height of the cylindrical portion of the capsule
+    double _height;
+
+    /// Number of points per circle used to tessellate the capsule
+    unsigned _npoints;
+
+    /// The bounding volumes around the capsule, indexed by geometry
+    std::map<CollisionGeometryPtr, boost::shared_ptr<SSL> > _ssls;
+};
+
+} // end namespace
+
+#endif
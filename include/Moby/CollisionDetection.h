@@ -45,12 +45,56 @@ class CollisionDetection : public virtual Base
     virtual double calc_CA_Euler_step(const PairwiseDistInfo& pdi) = 0;
     virtual void find_contacts(CollisionGeometryPtr cgA, CollisionGeometryPtr cgB, std::vector<UnilateralConstraint>& contacts, double TOL = NEAR_ZERO) = 0;
 
+    /// Finds contacts against a pose snapshot, for asynchronous detection
+    /**
+     * Override in detectors meant for ConstraintSimulator's asynchronous
+     * detection mode (see ConstraintSimulator::set_async_collision_detection()).
+     * The implementation must compute contacts from the poses recorded in
+     * the snapshot (absolute, in the global frame) rather than from the live
+     * geometry poses: it runs on a worker thread while the stepping thread
+     * may be updating the world. The default implementation finds nothing.
+     */
+    virtual void find_contacts_async(const std::vector<std::pair<CollisionGeometryPtr, Ravelin::Pose3d> >& pose_snapshot, std::vector<UnilateralConstraint>& contacts) {}
+
     /// Calculates the signed distance between two geometries
-    virtual double calc_signed_dist(CollisionGeometryPtr cg1, CollisionGeometryPtr cg2, Point3d& p1, Point3d& p2)
+    virtual double calc_signed_dist(CollisionGeometryPtr cg1, CollisionGeometryPtr cg2, Point3d& p1, Point3d& p2, double threshold = std::numeric_limits<double>::max())
+    {
+      return CollisionGeometry::calc_signed_dist(cg1, cg2, p1, p2, threshold);
+    }
+
+    /// Calculates the signed distance between two geometries, recording narrow-phase statistics
+    virtual double calc_signed_dist(CollisionGeometryPtr cg1, CollisionGeometryPtr cg2, Point3d& p1, Point3d& p2, PairwiseDistInfo::NarrowPhaseStats& stats, double threshold = std::numeric_limits<double>::max())
     {
-      return CollisionGeometry::calc_signed_dist(cg1, cg2, p1, p2);
+      return CollisionGeometry::calc_signed_dist(cg1, cg2, p1, p2, stats, threshold);
     }
 
+    /// Estimates the heap memory held by the detector's internal state, in bytes
+    /**
+     * Estimates exclude allocator overhead (see Primitive::calc_memory_usage()).
+     * The default implementation reports nothing.
+     */
+    virtual unsigned long calc_memory_usage() const { return 0; }
+
+    /// Releases caches that can be rebuilt on demand
+    /**
+     * Called when a simulator exceeds its memory budget (see
+     * Simulator::memory_budget). Implementations must only release state
+     * that subsequent queries can recompute, possibly more slowly.
+     */
+    virtual void release_transient_memory() {}
+
+    /// Drops persistent per-pair state involving a body's geometries
+    /**
+     * Called when a body is repositioned discontinuously (teleported by a
+     * controller, or restored from a checkpoint). Per-pair state accumulated
+     * over the pair's pose history -- most importantly minimum-observed
+     * distance bounds -- describes poses the body no longer occupies and can
+     * make subsequent queries unsound for just those pairs; state for pairs
+     * not involving the body remains valid and must be kept. The default
+     * implementation keeps no such state.
+     */
+    virtual void invalidate_pair_state(ControlledBodyPtr body) {}
+
     /// Get the shared pointer for this
     boost::shared_ptr<CollisionDetection> get_this() { return boost::dynamic_pointer_cast<CollisionDetection>(shared_from_this()); }
 
@@ -9,6 +9,7 @@
 
 #include <stack>
 #include <list>
+#include <limits>
 #include <vector>
 #include <map>
 #include <Ravelin/Pose3d.h>
@@ -19,6 +20,7 @@
 #include <Moby/Base.h>
 #include <Moby/Triangle.h>
 #include <Moby/Primitive.h>
+#include <Moby/PairwiseDistInfo.h>
 
 namespace Ravelin {
 class SingleBodyd;  
@@ -42,10 +44,12 @@ class CollisionGeometry : public virtual Base
     void set_relative_pose(const Ravelin::Pose3d& pose);  
     void write_vrml(const std::string& filename) const;
     PrimitivePtr set_geometry(PrimitivePtr primitive);
+    PrimitivePtr add_lod_geometry(PrimitivePtr primitive, double min_dist);
     virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
     virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
     void set_single_body(boost::shared_ptr<Ravelin::SingleBodyd> s);
-    static double calc_signed_dist(CollisionGeometryPtr a, CollisionGeometryPtr b, Point3d& cpa, Point3d& cpb);
+    static double calc_signed_dist(CollisionGeometryPtr a, CollisionGeometryPtr b, Point3d& cpa, Point3d& cpb, double threshold = std::numeric_limits<double>::max());
+    static double calc_signed_dist(CollisionGeometryPtr a, CollisionGeometryPtr b, Point3d& cpa, Point3d& cpb, PairwiseDistInfo::NarrowPhaseStats& stats, double threshold = std::numeric_limits<double>::max());
     double calc_signed_dist(const Point3d& p);
     double calc_dist_and_normal(const Point3d& p, std::vector<Ravelin::Vector3d>& n) const;
     void get_vertices(std::vector<Point3d>& p) const;
@@ -70,14 +74,46 @@ class CollisionGeometry : public virtual Base
     /// Gets the geometry for this primitive
     PrimitivePtr get_geometry() const { return _geometry; }
 
+    /// Gets the resolution ladder (pairs of activation distance and primitive)
+    const std::vector<std::pair<double, PrimitivePtr> >& get_lod_geometries() const { return _lods; }
+
+    /// Marks the world-frame pose of this geometry as changed
+    void mark_pose_stale() { _pose_stale = true; bump_generation(); }
+
+    /// Gets whether the pose has changed since clear_pose_stale() was called
+    bool pose_stale() const { return _pose_stale; }
+
+    /// Indicates that pose-derived data (e.g., bounds) has been recomputed
+    void clear_pose_stale() { _pose_stale = false; }
+
+    /// The material of this geometry (an index into the simulator's material-pair table; default 0)
+    /**
+     * Contact parameters for a pair of geometries are resolved by directly
+     * indexing the simulator's material-pair table with the two material
+     * ids, before any search of the per-object contact parameters map (see
+     * ConstraintSimulator::get_contact_parameters()).
+     */
+    unsigned material_id;
+
   protected:
+    unsigned select_lod(double dist) const;
+
+    /// Gets the primitive for a level of detail (ladder size = full resolution)
+    PrimitivePtr get_lod_primitive(unsigned i) const { return (i < _lods.size()) ? _lods[i].second : _geometry; }
+
     /// The pose of the CollisionGeometry (relative to the rigid body)
     boost::shared_ptr<Ravelin::Pose3d> _F;
+
+    /// Coarser stand-in primitives, sorted from coarsest to finest
+    std::vector<std::pair<double, PrimitivePtr> > _lods;
   
     /// The underlying geometry
     PrimitivePtr _geometry;
 
   private:
+    /// Whether the world-frame pose has changed since derived data was computed
+    bool _pose_stale;
+
     boost::weak_ptr<Ravelin::SingleBodyd> _single_body;
     boost::weak_ptr<CollisionGeometry> _parent;
 }; // end class
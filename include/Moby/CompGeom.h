@@ -32,15 +32,8 @@
 #include <Moby/NumericalException.h>
 #include <Moby/Types.h>
 
-#ifdef THREADSAFE
-#include <pthread.h>
-#endif
-
 // needed for qhull
-extern "C"
-{
-  #include <qhull/qhull_a.h>
-}
+#include <Moby/QhullContext.h>
 
 namespace Moby {
 
@@ -148,6 +141,8 @@ class CompGeom
     template <class ForwardIterator, class OutputIterator>
     static OutputIterator calc_convex_hull(ForwardIterator source_begin, ForwardIterator source_end, OutputIterator target_begin);
 
+    static void calc_convex_hulls(const std::vector<std::vector<Point3d> >& point_sets, std::vector<TessellatedPolyhedronPtr>& hulls);
+
     template <class ForwardIterator>
     static PolygonLocationType polygon_location(ForwardIterator begin, ForwardIterator end, const Point2d& point);
 
@@ -263,10 +258,6 @@ class CompGeom
     static bool test_edge_tri(const Point3d& a, const Point3d& b, const Triangle& t, unsigned i0, unsigned i1);
     static bool test_point_in_tri(const Point3d& p, const Triangle& t, unsigned i0, unsigned i1);
     static bool test_coplanar_tri_tri(const Ravelin::Vector3d& N, const Triangle& t1, const Triangle& t2);
-
-    #ifdef THREADSAFE
-    static pthread_mutex_t _qhull_mutex;
-    #endif
 }; // end class
 
 /// Specialized one-parameter computational geometry routines
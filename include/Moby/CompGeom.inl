@@ -263,13 +263,12 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Point3d*>::calc_
     j += DIM;
   }
 
-  // lock the qhull mutex -- qhull is non-reentrant
-  #ifdef THREADSAFE
-  pthread_mutex_lock(&CompGeom::_qhull_mutex);
-  #endif  
+  // acquire a qhull context (the global mutex for classic qhull; a local
+  // context when building against reentrant qhull)
+  QHULL_INIT_CONTEXT(errfile);
 
   // execute qhull  
-  exit_code = qh_new_qhull(DIM, N_POINTS, points_begin, IS_MALLOC, flags, outfile, errfile);
+  exit_code = QHULL_NEW_QHULL(DIM, N_POINTS, points_begin, IS_MALLOC, flags, outfile, errfile);
   if (exit_code != 0)
   {
     // points are not collinear.. unsure of the error...
@@ -278,13 +277,11 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Point3d*>::calc_
       FILE_LOG(LOG_COMPGEOM) << "  " << **i << std::endl;
 
     // free qhull memory
-    qh_freeqhull(!qh_ALL);
-    qh_memfreeshort(&curlong, &totlong);
+    QHULL_FREEQHULL();
+    QHULL_MEMFREESHORT(&curlong, &totlong);
 
-    // release the mutex, since we're not using qhull anymore
-    #ifdef THREADSAFE
-    pthread_mutex_unlock(&CompGeom::_qhull_mutex);
-    #endif
+    // release the qhull context
+    QHULL_RELEASE_CONTEXT();
 
     // close the error stream, if necessary
     if (!LOGGING(LOG_COMPGEOM))
@@ -300,13 +297,11 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Point3d*>::calc_
     (*target_begin++) = vertex_map[vertex->point];
  
   // free qhull memory
-  qh_freeqhull(!qh_ALL);
-  qh_memfreeshort(&curlong, &totlong);
+  QHULL_FREEQHULL();
+  QHULL_MEMFREESHORT(&curlong, &totlong);
 
-  // release the qhull mutex
-  #ifdef THREADSAFE
-  pthread_mutex_unlock(&CompGeom::_qhull_mutex);
-  #endif 
+  // release the qhull context
+  QHULL_RELEASE_CONTEXT();
 
   // close the error stream, if necessary
   if (!LOGGING(LOG_COMPGEOM))
@@ -789,23 +784,20 @@ TessellatedPolyhedronPtr CompGeomSpecOne<ForwardIterator, Point3d>::calc_convex_
   for (ForwardIterator i = first; i != last; i++)
     FILE_LOG(LOG_COMPGEOM) << *i << std::endl;
 
-  // lock the qhull mutex -- qhull is non-reentrant
-  #ifdef THREADSAFE
-  pthread_mutex_lock(&CompGeom::_qhull_mutex);
-  #endif  
+  // acquire a qhull context (the global mutex for classic qhull; a local
+  // context when building against reentrant qhull)
+  QHULL_INIT_CONTEXT(errfile);
 
   // execute qhull  
-  exit_code = qh_new_qhull(DIM, N_POINTS, points_begin, IS_MALLOC, flags, outfile, errfile);
+  exit_code = QHULL_NEW_QHULL(DIM, N_POINTS, points_begin, IS_MALLOC, flags, outfile, errfile);
   if (exit_code)
   {
     // free qhull memory
-    qh_freeqhull(!qh_ALL);
-    qh_memfreeshort(&curlong, &totlong);
+    QHULL_FREEQHULL();
+    QHULL_MEMFREESHORT(&curlong, &totlong);
 
     // qhull failed -- perhaps the dimensionality is 2 rather than 3?
-    #ifdef THREADSAFE
-    pthread_mutex_unlock(&CompGeom::_qhull_mutex);
-    #endif
+    QHULL_RELEASE_CONTEXT();
 
     // close the error stream, if necessary
     if (!LOGGING(LOG_COMPGEOM))
@@ -820,7 +812,7 @@ TessellatedPolyhedronPtr CompGeomSpecOne<ForwardIterator, Point3d>::calc_convex_
 
   // get all of the vertices
   std::map<vertexT*, unsigned> vertex_map;
-  for (vertexT* vertex=qh vertex_list;vertex && vertex->next;vertex= vertex->next)
+  for (vertexT* vertex=QH(vertex_list);vertex && vertex->next;vertex= vertex->next)
   {
     Point3d v;
     for (unsigned i=0; i< (unsigned) DIM; i++)
@@ -830,13 +822,13 @@ TessellatedPolyhedronPtr CompGeomSpecOne<ForwardIterator, Point3d>::calc_convex_
   }
 
   // triangulate
-  qh_triangulate();
+  QHULL_TRIANGULATE();
  
   // setup list of facets
   std::list<IndexedTri> facets;
  
   // get the facet information
-  for (facetT* facet=qh facet_list;facet && facet->next;facet=facet->next)
+  for (facetT* facet=QH(facet_list);facet && facet->next;facet=facet->next)
   {
     if (!facet->vertices)
       continue;
@@ -865,14 +857,12 @@ TessellatedPolyhedronPtr CompGeomSpecOne<ForwardIterator, Point3d>::calc_convex_
   }
   
   // free qhull memory
-  qh_freeqhull(!qh_ALL);
-  qh_memfreeshort(&curlong, &totlong);
+  QHULL_FREEQHULL();
+  QHULL_MEMFREESHORT(&curlong, &totlong);
   assert(!curlong && !totlong);
   
-  // release the qhull mutex
-  #ifdef THREADSAFE
-  pthread_mutex_unlock(&CompGeom::_qhull_mutex);
-  #endif  
+  // release the qhull context
+  QHULL_RELEASE_CONTEXT();
 
   // if the there aren't enough triangles, can't create the polyhedron
   assert(facets.size() >= 4);
@@ -1741,13 +1731,12 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Point2d>::calc_c
     j += DIM;
   }
 
-  // lock the qhull mutex -- qhull is non-reentrant
-  #ifdef THREADSAFE
-  pthread_mutex_lock(&CompGeom::_qhull_mutex);
-  #endif  
+  // acquire a qhull context (the global mutex for classic qhull; a local
+  // context when building against reentrant qhull)
+  QHULL_INIT_CONTEXT(errfile);
 
   // execute qhull  
-  exit_code = qh_new_qhull(DIM, N_POINTS, points_begin, IS_MALLOC, flags, outfile, errfile);
+  exit_code = QHULL_NEW_QHULL(DIM, N_POINTS, points_begin, IS_MALLOC, flags, outfile, errfile);
   if (exit_code != 0)
   {
     // points are not collinear.. unsure of the error...
@@ -1756,13 +1745,11 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Point2d>::calc_c
       FILE_LOG(LOG_COMPGEOM) << "  " << *i << std::endl;
 
     // free qhull memory
-    qh_freeqhull(!qh_ALL);
-    qh_memfreeshort(&curlong, &totlong);
+    QHULL_FREEQHULL();
+    QHULL_MEMFREESHORT(&curlong, &totlong);
 
-    // release the mutex, since we're not using qhull anymore
-    #ifdef THREADSAFE
-    pthread_mutex_unlock(&CompGeom::_qhull_mutex);
-    #endif
+    // release the qhull context
+    QHULL_RELEASE_CONTEXT();
 
     // close the error stream, if necessary
     if (!LOGGING(LOG_COMPGEOM))
@@ -1775,7 +1762,7 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Point2d>::calc_c
   std::map<Point2d*, std::list<Point2d*> > edges;
   
   // iterate through all facets  
-  for (facetT* facet=qh facet_list;facet && facet->next;facet=facet->next)
+  for (facetT* facet=QH(facet_list);facet && facet->next;facet=facet->next)
   {
     // setup a list of vertices for the facet
     std::list<Point2d*> facet_vertices;
@@ -1794,13 +1781,11 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Point2d>::calc_c
   }    
   
   // free qhull memory
-  qh_freeqhull(!qh_ALL);
-  qh_memfreeshort(&curlong, &totlong);
+  QHULL_FREEQHULL();
+  QHULL_MEMFREESHORT(&curlong, &totlong);
 
-  // release the qhull mutex
-  #ifdef THREADSAFE
-  pthread_mutex_unlock(&CompGeom::_qhull_mutex);
-  #endif  
+  // release the qhull context
+  QHULL_RELEASE_CONTEXT();
 
   // construct the set of processed vertex
   std::set<Point2d*> processed;
@@ -1897,13 +1882,12 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Ravelin::Origin2
     j += DIM;
   }
 
-  // lock the qhull mutex -- qhull is non-reentrant
-  #ifdef THREADSAFE
-  pthread_mutex_lock(&CompGeom::_qhull_mutex);
-  #endif  
+  // acquire a qhull context (the global mutex for classic qhull; a local
+  // context when building against reentrant qhull)
+  QHULL_INIT_CONTEXT(errfile);
 
   // execute qhull  
-  exit_code = qh_new_qhull(DIM, N_POINTS, points_begin, IS_MALLOC, flags, outfile, errfile);
+  exit_code = QHULL_NEW_QHULL(DIM, N_POINTS, points_begin, IS_MALLOC, flags, outfile, errfile);
   if (exit_code != 0)
   {
     // points are not collinear.. unsure of the error...
@@ -1912,13 +1896,11 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Ravelin::Origin2
       FILE_LOG(LOG_COMPGEOM) << "  " << *i << std::endl;
 
     // free qhull memory
-    qh_freeqhull(!qh_ALL);
-    qh_memfreeshort(&curlong, &totlong);
+    QHULL_FREEQHULL();
+    QHULL_MEMFREESHORT(&curlong, &totlong);
 
-    // release the mutex, since we're not using qhull anymore
-    #ifdef THREADSAFE
-    pthread_mutex_unlock(&CompGeom::_qhull_mutex);
-    #endif
+    // release the qhull context
+    QHULL_RELEASE_CONTEXT();
 
     // close the error stream, if necessary
     if (!LOGGING(LOG_COMPGEOM))
@@ -1931,7 +1913,7 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Ravelin::Origin2
   std::map<Ravelin::Origin2d*, std::list<Ravelin::Origin2d*> > edges;
   
   // iterate through all facets  
-  for (facetT* facet=qh facet_list;facet && facet->next;facet=facet->next)
+  for (facetT* facet=QH(facet_list);facet && facet->next;facet=facet->next)
   {
     // setup a list of vertices for the facet
     std::list<Ravelin::Origin2d*> facet_vertices;
@@ -1950,13 +1932,11 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Ravelin::Origin2
   }    
   
   // free qhull memory
-  qh_freeqhull(!qh_ALL);
-  qh_memfreeshort(&curlong, &totlong);
+  QHULL_FREEQHULL();
+  QHULL_MEMFREESHORT(&curlong, &totlong);
 
-  // release the qhull mutex
-  #ifdef THREADSAFE
-  pthread_mutex_unlock(&CompGeom::_qhull_mutex);
-  #endif  
+  // release the qhull context
+  QHULL_RELEASE_CONTEXT();
 
   // construct the set of processed vertex
   std::set<Ravelin::Origin2d*> processed;
@@ -2606,13 +2586,12 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Point2d*>::calc_
     j += DIM;
   }
 
-  // lock the qhull mutex -- qhull is non-reentrant
-  #ifdef THREADSAFE
-  pthread_mutex_lock(&CompGeom::_qhull_mutex);
-  #endif  
+  // acquire a qhull context (the global mutex for classic qhull; a local
+  // context when building against reentrant qhull)
+  QHULL_INIT_CONTEXT(errfile);
 
   // execute qhull  
-  exit_code = qh_new_qhull(DIM, N_POINTS, points_begin, IS_MALLOC, flags, outfile, errfile);
+  exit_code = QHULL_NEW_QHULL(DIM, N_POINTS, points_begin, IS_MALLOC, flags, outfile, errfile);
   if (exit_code != 0)
   {
     // points are not collinear.. unsure of the error...
@@ -2621,13 +2600,11 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Point2d*>::calc_
       FILE_LOG(LOG_COMPGEOM) << "  " << *i << std::endl;
 
     // free qhull memory
-    qh_freeqhull(!qh_ALL);
-    qh_memfreeshort(&curlong, &totlong);
+    QHULL_FREEQHULL();
+    QHULL_MEMFREESHORT(&curlong, &totlong);
 
-    // release the mutex, since we're not using qhull anymore
-    #ifdef THREADSAFE
-    pthread_mutex_unlock(&CompGeom::_qhull_mutex);
-    #endif
+    // release the qhull context
+    QHULL_RELEASE_CONTEXT();
 
     // close the error stream, if necessary
     if (!LOGGING(LOG_COMPGEOM))
@@ -2641,7 +2618,7 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Point2d*>::calc_
   std::map<Point2d*, std::list<Point2d*> > edges;
   
   // iterate through all facets  
-  for (facetT* facet=qh facet_list;facet && facet->next;facet=facet->next)
+  for (facetT* facet=QH(facet_list);facet && facet->next;facet=facet->next)
   {
     // setup a list of vertices for the facet
     std::list<Point2d*> facet_vertices;
@@ -2660,13 +2637,11 @@ OutputIterator CompGeomSpecTwo<ForwardIterator, OutputIterator, Point2d*>::calc_
   }    
   
   // free qhull memory
-  qh_freeqhull(!qh_ALL);
-  qh_memfreeshort(&curlong, &totlong);
+  QHULL_FREEQHULL();
+  QHULL_MEMFREESHORT(&curlong, &totlong);
 
-  // release the qhull mutex
-  #ifdef THREADSAFE
-  pthread_mutex_unlock(&CompGeom::_qhull_mutex);
-  #endif  
+  // release the qhull context
+  QHULL_RELEASE_CONTEXT();
 
   // construct the set of processed vertex
   std::set<Point2d*> processed;
@@ -2860,23 +2835,20 @@ TessellatedPolyhedronPtr CompGeom::calc_hs_intersection(ForwardIterator start, F
     j += DIM;
   }
 
-  // lock the qhull mutex -- qhull is non-reentrant
-  #ifdef THREADSAFE
-  pthread_mutex_lock(&CompGeom::_qhull_mutex);
-  #endif
+  // acquire a qhull context (the global mutex for classic qhull; a local
+  // context when building against reentrant qhull)
+  QHULL_INIT_CONTEXT(errfile);
 
   // execute qhull
-  int exit_code = qh_new_qhull(DIM, nspaces, qhull_hs.get(), IS_MALLOC, (char*) flags.str().c_str(), outfile, errfile);
+  int exit_code = QHULL_NEW_QHULL(DIM, nspaces, qhull_hs.get(), IS_MALLOC, (char*) flags.str().c_str(), outfile, errfile);
   if (exit_code)
   {
     // free qhull memory
-    qh_freeqhull(!qh_ALL);
-    qh_memfreeshort(&curlong, &totlong);
+    QHULL_FREEQHULL();
+    QHULL_MEMFREESHORT(&curlong, &totlong);
 
-    // qhull failed
-    #ifdef THREADSAFE
-    pthread_mutex_unlock(&CompGeom::_qhull_mutex);
-    #endif
+    // qhull failed -- release the context
+    QHULL_RELEASE_CONTEXT();
 
     // close the error stream, if necessary
     if (!LOGGING(LOG_COMPGEOM))
@@ -2887,48 +2859,54 @@ TessellatedPolyhedronPtr CompGeom::calc_hs_intersection(ForwardIterator start, F
   }
 
   // verify that the qhull dimension is correct
-  assert(qh hull_dim == 3);
+  assert(QH(hull_dim) == 3);
 
   // determine the intersection vertices; NOTE: this code was motivated by
   // qhull's qh_printafacet() and qh_printfacets() functions
   std::list<Point3d> points;
-  for (facetT* facet=qh facet_list;facet && facet->next;facet=facet->next)
+  for (facetT* facet=QH(facet_list);facet && facet->next;facet=facet->next)
   {
     if (facet->offset > 0)
     {
       // facet has infinite offset
-      qh_freeqhull(!qh_ALL);
-      qh_memfreeshort(&curlong, &totlong);
+      QHULL_FREEQHULL();
+      QHULL_MEMFREESHORT(&curlong, &totlong);
       assert(!curlong && !totlong);
 
+      // release the qhull context before throwing
+      QHULL_RELEASE_CONTEXT();
+
       throw NumericalException();
       return TessellatedPolyhedronPtr();
     }
-    coordT* point = (coordT*) qh_memalloc(qh normal_size);
+    coordT* point = (coordT*) QHULL_MEMALLOC(QH(normal_size));
     coordT* coordp = point;
     coordT* normp = facet->normal;
-    coordT* feasiblep = qh feasible_point;
-    if (facet->offset < -qh MINdenom)
-      for (int k=qh hull_dim; k--; )
+    coordT* feasiblep = QH(feasible_point);
+    if (facet->offset < -QH(MINdenom))
+      for (int k=QH(hull_dim); k--; )
         *(coordp++) = (*(normp++) / -facet->offset) + *(feasiblep++);
     else
-      for (int k=qh hull_dim; k--;)
+      for (int k=QH(hull_dim); k--;)
       {
         boolT zerodiv;
         coordT* feasiblep1 = feasiblep+1;
         feasiblep = feasiblep1+1;
-        *(coordp++) = qh_divzero(*(normp++), facet->offset, qh MINdenom_1, &zerodiv) + *feasiblep1  + *feasiblep;
+        *(coordp++) = qh_divzero(*(normp++), facet->offset, QH(MINdenom_1), &zerodiv) + *feasiblep1  + *feasiblep;
         feasiblep++;
         if (zerodiv)
         {
           // facet has infinite offset
-          qh_memfree(point, qh normal_size);
+          QHULL_MEMFREE(point, QH(normal_size));
 
           // free qhull memory
-          qh_freeqhull(!qh_ALL);
-          qh_memfreeshort(&curlong, &totlong);
+          QHULL_FREEQHULL();
+          QHULL_MEMFREESHORT(&curlong, &totlong);
           assert(!curlong && !totlong);
 
+          // release the qhull context before throwing
+          QHULL_RELEASE_CONTEXT();
+
           throw NumericalException();
           return TessellatedPolyhedronPtr();
         }
@@ -2938,18 +2916,16 @@ TessellatedPolyhedronPtr CompGeom::calc_hs_intersection(ForwardIterator start, F
     points.push_back(Ravelin::Vector3d(*point, *(point+1), *(point+2)));
 
     // free the temporary memory
-    qh_memfree(point, qh normal_size);
+    QHULL_MEMFREE(point, QH(normal_size));
   }
 
   // free qhull memory
-  qh_freeqhull(!qh_ALL);
-  qh_memfreeshort(&curlong, &totlong);
+  QHULL_FREEQHULL();
+  QHULL_MEMFREESHORT(&curlong, &totlong);
   assert(!curlong && !totlong);
   
-  // release the qhull mutex
-  #ifdef THREADSAFE
-  pthread_mutex_unlock(&CompGeom::_qhull_mutex);
-  #endif
+  // release the qhull context
+  QHULL_RELEASE_CONTEXT();
 
   // now, calculate the convex hull of the intersection points  
   TessellatedPolyhedronPtr p = calc_convex_hull(points.begin(), points.end());
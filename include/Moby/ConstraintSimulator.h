@@ -8,6 +8,7 @@
 #define _CONSTRAINT_SIMULATOR_H
 
 #include <map>
+#include <limits>
 #include <Ravelin/sorted_pair>
 #include <Moby/Simulator.h>
 #include <Moby/ImpactConstraintHandler.h>
@@ -33,10 +34,28 @@ class ConstraintSimulator : public Simulator
 
   public:
     ConstraintSimulator();
+    virtual ~ConstraintSimulator();
     virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
     virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
     boost::shared_ptr<ContactParameters> get_contact_parameters(CollisionGeometryPtr geom1, CollisionGeometryPtr geom2) const;
+    void set_material_params(unsigned material1, unsigned material2, boost::shared_ptr<ContactParameters> cp);
+
+    /// Gets the contact parameters for a pair of materials by direct indexing (NULL if no entry)
+    boost::shared_ptr<ContactParameters> get_material_params(unsigned material1, unsigned material2) const
+    {
+      if (material1 >= _num_materials || material2 >= _num_materials)
+        return boost::shared_ptr<ContactParameters>();
+      return _material_params[material1*_num_materials + material2];
+    }
+
     const std::vector<PairwiseDistInfo>& get_pairwise_distances() const { return _pairwise_distances; }
+    CollisionGeometryPtr ray_cast(const Point3d& origin, const Ravelin::Vector3d& dir, double max_dist, double& t, Ravelin::Vector3d& normal);
+    virtual void calc_memory_footprint(MemoryFootprint& fp) const;
+    virtual void release_transient_memory();
+    void invalidate_pair_state(ControlledBodyPtr body);
+
+    /// Gets the LCP solver used for impact handling, e.g., for sampling solver statistics per step
+    LCP& get_impact_lcp_solver() { return _impact_constraint_handler.get_lcp_solver(); }
 
     /// The constraint stabilization mechanism
     ConstraintStabilization cstab;
@@ -77,6 +96,12 @@ class ConstraintSimulator : public Simulator
     std::vector<UnilateralConstraint>& get_rigid_constraints() { return _rigid_constraints; }
 
     /// Mapping from objects to contact parameters
+    /**
+     * Entries here override the material-pair table for specific object
+     * pairs; pairs resolved by material alone should use the table instead
+     * (see set_material_params()), which is indexed directly rather than
+     * searched.
+     */
     std::map<Ravelin::sorted_pair<BasePtr>, boost::shared_ptr<ContactParameters> > contact_params;
 
     /// If set to 'true' simulator will process contact points for rendering
@@ -85,23 +110,184 @@ class ConstraintSimulator : public Simulator
     /// Gets the collision detection mechanism
     boost::shared_ptr<CollisionDetection> get_collision_detection() const { return _coldet; }
 
+    void set_async_collision_detection(boost::shared_ptr<CollisionDetection> coldet);
+
+    /// Gets the asynchronous collision detector, if any
+    boost::shared_ptr<CollisionDetection> get_async_collision_detection() const { return _async_coldet; }
+
     /// The distance threshold for a contact to be handled
     /**
-     * Bodies are only considered to be in contact 
+     * Bodies are only considered to be in contact
      * if their distance is less than this
      * threshold.
      */
     double contact_dist_thresh;
 
+    /// Relative pose drift below which a cached contact manifold is reused
+    /**
+     * If the relative pose of a geometry pair has changed less than this
+     * tolerance (combined translational and rotational drift) since the
+     * pair's manifold was last computed, the cached contact points are reused
+     * with refreshed signed violations instead of re-running the narrow
+     * phase. Set to zero (the default) to disable manifold caching.
+     */
+    double manifold_reuse_tol;
+
+    /// Width of the hysteresis band on contact activation (0 = disabled)
+    /**
+     * A geometry pair starts generating contact constraints when its
+     * distance drops below contact_dist_thresh, but once active it keeps
+     * generating them until the distance exceeds contact_dist_thresh plus
+     * this band.  A marginal contact whose distance oscillates about the
+     * threshold otherwise flickers in and out of the active set, re-forming
+     * islands and cold-starting the constraint solver on every step.  Set
+     * to zero (the default) to disable hysteresis.
+     */
+    double contact_hysteresis;
+
+    /// Maximum contact points kept per geometry pair (0 = unlimited)
+    /**
+     * Meshes resting face-to-face emit dozens of nearly redundant contact
+     * points, and every point adds rows to the downstream LCP.  When this is
+     * nonzero (4 is the customary choice), each freshly computed manifold is
+     * reduced to the deepest point plus the points that best spread the
+     * remaining manifold area, with near-ties broken toward the points kept
+     * on the previous step so the reduced set does not churn while a pair
+     * rests.  Set to zero (the default) to keep every contact point.
+     */
+    unsigned max_manifold_points;
+
+    /// A spherical region of interest (see roi_enabled)
+    struct RegionOfInterest
+    {
+      RegionOfInterest() { radius = 0.0; }
+
+      Point3d center;             ///< center in the global frame (ignored when an anchor is set)
+      double radius;              ///< radius of the region
+      ControlledBodyPtr anchor;   ///< if set, the region follows this body
+    };
+
+    /// The regions of interest (see roi_enabled)
+    std::vector<RegionOfInterest> roi_volumes;
+
+    /// Whether bodies outside every region of interest are frozen
+    /**
+     * If set (sleeping_enabled must be set as well), bodies farther than
+     * roi_promotion_dist outside every region in roi_volumes are deactivated
+     * through the sleep machinery, so integration, controllers, and
+     * sleeping-pair distance checks all skip them; frozen bodies are
+     * promoted back to full simulation when a region approaches within
+     * roi_promotion_dist or a contact chain from an active body reaches
+     * them.  Bodies with controllers are never frozen, and an anchored
+     * region's body is trivially inside its own region.  Disabled by
+     * default.
+     */
+    bool roi_enabled;
+
+    /// Distance beyond a region boundary at which bodies freeze/promote (see roi_enabled)
+    double roi_promotion_dist;
+
+    void update_roi_states();
+
+    /// Aggregated narrow-phase cost of a geometry pair over the current window
+    struct PairCostRecord
+    {
+      PairCostRecord() { total_time = 0.0; queries = culled = certified = iterations = kernel_hits = kernel_misses = 0; }
+
+      CollisionGeometryPtr a;   // the first geometry
+      CollisionGeometryPtr b;   // the second geometry
+      double total_time;        // wall-clock seconds of narrow phase
+      unsigned queries;         // narrow-phase queries performed
+      unsigned culled;          // queries resolved by a culling certificate
+      unsigned certified;       // queries resolved by a separating-plane certificate
+      unsigned iterations;      // level-of-detail requeries performed
+      unsigned kernel_hits;     // dispatch-table lookups that found a kernel
+      unsigned kernel_misses;   // lookups that fell back to virtual dispatch
+    };
+
+    void get_top_narrow_phase_pairs(unsigned k, std::vector<PairCostRecord>& records) const;
+    void reset_narrow_phase_stats();
+
+    /// Whether per-pair narrow-phase statistics are aggregated
+    /**
+     * If set, calc_pairwise_distances() times every narrow-phase query and
+     * folds its statistics into a per-pair aggregate that
+     * get_top_narrow_phase_pairs() reports (the window is the period since
+     * the last reset_narrow_phase_stats() call). Disabled by default; the
+     * aggregation costs one map update per checked pair per step.
+     */
+    bool record_narrow_phase_stats;
+
+    /// Whether the broad phase is pipelined onto a worker thread
+    /**
+     * If set, a mini-step hands the next mini-step's broad phase to a
+     * persistent worker thread just before impact handling begins, when the
+     * positions for the next mini-step are already final; the result is
+     * consumed at the start of the next mini-step, hiding the broad-phase
+     * latency behind the impact LCP solves.  The swept bounding volumes are
+     * computed from the pre-impact velocities, so the prefetched result is
+     * discarded and the broad phase re-run synchronously whenever the
+     * impulses increased any body's speed.  User callbacks must not
+     * reposition bodies when this flag is set, since the worker reads body
+     * poses while the callbacks run.  Disabled by default.
+     */
+    bool async_broad_phase;
+
+    /// Whether far pairs are culled with a budgeted batch GJK pass
+    /**
+     * If set, calc_pairwise_distances() first runs GJK::batch_cull() over
+     * all convex-convex pairs from the broad phase; pairs certified to be
+     * farther apart than contact_dist_thresh skip the precise narrow phase
+     * and report their certified distance lower bound instead of the exact
+     * distance (their consumers only test against the threshold). Disabled
+     * by default.
+     */
+    bool gjk_batch_culling;
+
+    /// Whether cached separating-plane certificates gate the exact narrow phase
+    /**
+     * If set, each convex pair's last exact query stores a separating plane
+     * fixed in one geometry's frame; at subsequent steps the plane is checked
+     * in a few flops (the other geometry's bounding sphere against the plane)
+     * before any exact query runs. Only pairs whose certificate fails proceed
+     * to the exact narrow phase; in steady scenes most pairs keep valid
+     * certificates between steps. Disabled by default.
+     */
+    bool separating_plane_certificates;
+
+    /// Whether exact narrow-phase results are memoized for trajectory replays
+    /**
+     * If set, calc_pairwise_distances() keys every exact signed-distance
+     * query on the geometry pair and a hash of the pair's quantized relative
+     * pose, serves repeated queries from the memo, and persists the memo to
+     * replay_cache_file when the simulator is destroyed.  The first pass over
+     * a kinematically-scripted trajectory populates the cache; subsequent
+     * replays of the same trajectory (e.g., re-rendering a recording once per
+     * camera) are then served entirely from disk.  A result is served only at
+     * a bit-identical (quantized) relative pose, so dynamically-simulated
+     * scenes gain nothing from the mode.  Disabled by default.
+     */
+    bool replay_cache_enabled;
+
+    /// The file the replay memo is loaded from and persisted to (see replay_cache_enabled)
+    std::string replay_cache_file;
+
   protected:
     void calc_impacting_unilateral_constraint_forces(double dt);
     void find_unilateral_constraints(double min_contact_dist);
+    void reduce_contact_manifold(std::vector<UnilateralConstraint>& constraints, unsigned first, CollisionGeometryPtr gA, CollisionGeometryPtr gB);
     void calc_compliant_unilateral_constraint_forces();
     void preprocess_constraint(UnilateralConstraint& e);
     void determine_geometries();
     void broad_phase(double dt);
-    void calc_pairwise_distances();
+    void calc_pairwise_distances(double threshold = std::numeric_limits<double>::max());
+    void update_sleep_states(double h);
     void visualize_contact( UnilateralConstraint& constraint );
+    void start_broad_phase_async(double dt);
+    bool finish_broad_phase_async();
+    void cancel_broad_phase_async();
+    void post_async_detection_job();
+    void consume_async_detection();
 
     /// Object for handling impact constraints
     ImpactConstraintHandler _impact_constraint_handler;
@@ -123,9 +309,86 @@ class ConstraintSimulator : public Simulator
     /// The dissipation mechanism, if any
     boost::shared_ptr<Dissipation> _dissipator;
 
+    /// The dense material-pair parameter table, stored row-major and symmetric
+    /**
+     * Entry (i,j) holds the contact parameters for materials i and j (see
+     * CollisionGeometry::material_id); get_contact_parameters() resolves the
+     * common case by indexing this table directly instead of searching
+     * contact_params.
+     */
+    std::vector<boost::shared_ptr<ContactParameters> > _material_params;
+
+    /// The dimension of the material-pair table
+    unsigned _num_materials;
+
     /// Pairwise distances at bodies' current configurations
     std::vector<PairwiseDistInfo> _pairwise_distances;
 
+    /// A cached contact manifold for a geometry pair
+    struct ManifoldCacheEntry
+    {
+      Ravelin::Transform3d aTb;                   // relative pose of the pair at capture
+      std::vector<UnilateralConstraint> contacts; // the cached contact constraints
+    };
+
+    /// Persistent contact manifolds, keyed on geometry pair
+    std::map<Ravelin::sorted_pair<CollisionGeometryPtr>, ManifoldCacheEntry> _manifold_cache;
+
+    /// Geometry pairs currently in contact (see contact_hysteresis)
+    std::set<Ravelin::sorted_pair<CollisionGeometryPtr> > _active_pairs;
+
+    /// Bodies frozen by region-of-interest culling, as distinct from bodies
+    /// slept by the velocity-based sleep test (see update_roi_states())
+    std::set<boost::shared_ptr<Ravelin::DynamicBodyd> > _roi_frozen;
+
+    /// A cached separating-plane certificate for a geometry pair
+    /**
+     * The plane is a supporting plane from the pair's last exact query,
+     * stored in one (convex) geometry's frame so it rides with that geometry
+     * as it moves; that side of the certificate can never go stale. The
+     * other geometry is tested against the plane by its bounding sphere, so
+     * validation costs a handful of flops (see calc_pairwise_distances()).
+     */
+    struct SeparationCertificate
+    {
+      SeparationCertificate() { valid = false; }
+
+      bool valid;               // whether the certificate may be tested
+      CollisionGeometryPtr ga;  // the geometry the plane is fixed to
+      Ravelin::Vector3d nhat;   // plane normal in ga's frame, pointing away from ga
+      Point3d point;            // a point on the plane, in ga's frame
+      double clearance;         // certified clearance of ga behind the plane
+      double other_radius;      // bounding sphere radius of the other geometry
+    };
+
+    /// Cached separating-plane certificates, keyed on geometry pair
+    std::map<Ravelin::sorted_pair<CollisionGeometryPtr>, SeparationCertificate> _separation_certs;
+
+    /// Contact points kept by the last manifold reduction per pair (see max_manifold_points)
+    std::map<Ravelin::sorted_pair<CollisionGeometryPtr>, std::vector<Point3d> > _kept_manifold_points;
+
+    /// Aggregated per-pair narrow-phase statistics (see record_narrow_phase_stats)
+    std::map<Ravelin::sorted_pair<CollisionGeometryPtr>, PairCostRecord> _pair_costs;
+
+    /// A memoized exact narrow-phase result (see replay_cache_enabled)
+    struct ReplayCacheEntry
+    {
+      double dist;           // the signed distance
+      Ravelin::Origin3d pa;  // closest point on the first geometry, in its frame
+      Ravelin::Origin3d pb;  // closest point on the second geometry, in its frame
+    };
+
+    /// The replay memo, keyed on (id-ordered pair hash, relative pose hash)
+    /**
+     * The pair is hashed by geometry id rather than by pointer so keys remain
+     * stable across processes; the in-frame witness points are reattached to
+     * the geometries' current poses when an entry is served.
+     */
+    std::map<std::pair<unsigned long long, unsigned long long>, ReplayCacheEntry> _replay_cache;
+
+    void load_replay_cache();
+    void save_replay_cache();
+
     /// Work vector
     Ravelin::VectorNd _workV;
 
@@ -137,6 +400,43 @@ class ConstraintSimulator : public Simulator
 
     /// Geometric pairs that should be checked for unilateral constraints (according to broad phase collision detection)
     std::vector<std::pair<CollisionGeometryPtr, CollisionGeometryPtr> > _pairs_to_check;
+
+    /// Workspace for the batch GJK culling pass (persists across steps)
+    std::vector<CollisionGeometryPtr> _cull_gA, _cull_gB;
+    std::vector<unsigned> _cull_map;
+    std::vector<char> _culled, _pair_culled, _pair_certified;
+    std::vector<double> _cull_bounds, _pair_bounds;
+
+    /// Workspace and state for the replay memo (see replay_cache_enabled)
+    std::vector<std::pair<unsigned long long, unsigned long long> > _replay_keys;
+    bool _replay_cache_loaded, _replay_cache_dirty;
+
+  private:
+    static void* broad_phase_worker(void* arg);
+
+    /// State for the pipelined broad phase (see async_broad_phase)
+    pthread_t _bp_thread;
+    pthread_mutex_t _bp_mutex;
+    pthread_cond_t _bp_cond;
+    bool _bp_thread_running, _bp_job_pending, _bp_job_done, _bp_shutdown;
+    bool _bp_active;
+    double _bp_dt;
+    std::vector<std::pair<CollisionGeometryPtr, CollisionGeometryPtr> > _bp_pairs;
+    std::vector<double> _bp_speeds;
+
+    static void* async_detection_worker(void* arg);
+
+    /// State for the asynchronous detector (see set_async_collision_detection())
+    boost::shared_ptr<CollisionDetection> _async_coldet;
+    pthread_t _acd_thread;
+    pthread_mutex_t _acd_mutex;
+    pthread_cond_t _acd_cond;
+    bool _acd_thread_running, _acd_job_pending, _acd_shutdown, _acd_busy;
+    std::vector<std::pair<CollisionGeometryPtr, Ravelin::Pose3d> > _acd_snapshot;
+    std::vector<UnilateralConstraint> _acd_buffers[2];
+    unsigned _acd_front;       // buffer most recently completed by the worker
+    bool _acd_result_valid;    // whether any query has completed yet
+    bool _acd_result_consumed; // whether the front buffer was already merged
 }; // end class
 
 } // end namespace
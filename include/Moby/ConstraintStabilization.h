@@ -21,7 +21,12 @@ class ConstraintStabilization
 {
   public:
     ConstraintStabilization();
-    void stabilize(boost::shared_ptr<ConstraintSimulator> sim); 
+    void stabilize(boost::shared_ptr<ConstraintSimulator> sim);
+    unsigned long calc_memory_usage() const;
+    void release_transient_memory();
+
+    /// Gets the pivoting LCP solver, e.g., for reading solver statistics or setting telemetry callbacks
+    LCP& get_lcp_solver() { return _lcp; }
 
     // tolerance to solve unilateral constraints to
     double eps;
@@ -32,17 +37,20 @@ class ConstraintStabilization
     // maximum number of iterations for constraint stabilization
     unsigned max_iterations;
 
+    // tolerance below which per-iteration violation change counts as a stall
+    double stagnation_tol;
+
   private:
     void get_body_configurations(Ravelin::VectorNd& q, boost::shared_ptr<ConstraintSimulator> sim);
     void update_body_configurations(const Ravelin::VectorNd& q, boost::shared_ptr<ConstraintSimulator> sim);
     bool update_q(const Ravelin::VectorNd& dq, Ravelin::VectorNd& q, boost::shared_ptr<ConstraintSimulator> sim);
     void compute_problem_data(std::vector<UnilateralConstraintProblemData>& pd, boost::shared_ptr<ConstraintSimulator> sim);
     void add_contact_constraints(std::vector<UnilateralConstraint>& constraints, CollisionGeometryPtr cg1, CollisionGeometryPtr cg2, boost::shared_ptr<ConstraintSimulator> sim);
-    void add_limit_constraints(const std::vector<ControlledBodyPtr>& bodies, std::vector<UnilateralConstraint>& constraints);
+    void add_limit_constraints(const std::vector<ControlledBodyPtr>& bodies, std::vector<UnilateralConstraint>& constraints, boost::shared_ptr<ConstraintSimulator> sim);
     void generate_body_index_map(std::map<boost::shared_ptr<Ravelin::DynamicBodyd>, unsigned>& body_index_map, boost::shared_ptr<ConstraintSimulator> sim);
     static void set_unilateral_constraint_data(UnilateralConstraintProblemData& pd, const std::list<boost::shared_ptr<Ravelin::SingleBodyd> >& single_bodies);
     static void set_bilateral_only_constraint_data(UnilateralConstraintProblemData& q, const std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> >& island);
-    void determine_dq(UnilateralConstraintProblemData& pd, Ravelin::VectorNd& dqm, const std::map<boost::shared_ptr<Ravelin::DynamicBodyd>, unsigned>& body_index_map);
+    void determine_dq(UnilateralConstraintProblemData& pd, Ravelin::VectorNd& dqm, const std::map<boost::shared_ptr<Ravelin::DynamicBodyd>, unsigned>& body_index_map, Ravelin::VectorNd& z);
     void update_from_stacked(const Ravelin::VectorNd& z, UnilateralConstraintProblemData& pd);
     void update_velocities(const UnilateralConstraintProblemData& pd);
     static double get_min_pairwise_dist(const std::vector<PairwiseDistInfo>& pdi); 
@@ -61,6 +69,20 @@ class ConstraintStabilization
     // the LCP solver
     LCP _lcp;
 
+    // LCP workspace (persists across stabilization iterations)
+    Ravelin::MatrixNd _MM;
+    Ravelin::VectorNd _qq;
+
+    // per-island LCP solutions from the previous stabilization iteration,
+    // used to warm-start the next iteration's solves
+    std::vector<Ravelin::VectorNd> _zlast;
+
+    /// Per-thread instances for solving disjoint islands concurrently
+    std::vector<boost::shared_ptr<ConstraintStabilization> > _workers;
+
+    // saved generalized velocities (persistent, so saving does not allocate)
+    std::vector<Ravelin::VectorNd> _qd_save;
+
     // the unilateral constraints
     std::vector<UnilateralConstraint> constraints;
 
@@ -0,0 +1,73 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _MOBY_CONTACT_FORCE_HISTORY_H_
+#define _MOBY_CONTACT_FORCE_HISTORY_H_
+
+#include <map>
+#include <Ravelin/sorted_pair>
+#include <Moby/Types.h>
+
+namespace Moby {
+
+/// Per-contact force/impulse history shared between contact handlers
+/**
+ * The impact handler (velocity level) and the sustained unilateral
+ * constraint handler (acceleration level) solve closely related
+ * complementarity problems over the same contacts, yet each historically
+ * started its solver from scratch.  This object records the last normal
+ * and frictional components solved for each geometry pair; a handler seeds
+ * its pivoting solver from the records before solving and writes its
+ * solution back afterward.  Only the active set that a seed implies
+ * matters to the pivoting solver-- force and impulse magnitudes at the two
+ * levels differ by a factor of the step size-- so records written at one
+ * level remain useful seeds at the other.
+ */
+class ContactForceHistory
+{
+  public:
+    /// The last solved force/impulse components for one contact pair
+    struct Record
+    {
+      Record() { cn = cs = ct = 0.0; }
+      double cn;  // normal component
+      double cs;  // first friction direction component
+      double ct;  // second friction direction component
+    };
+
+    /// Gets the record for a geometry pair, returning false if none exists
+    bool lookup(CollisionGeometryPtr gA, CollisionGeometryPtr gB, Record& r) const
+    {
+      std::map<Ravelin::sorted_pair<CollisionGeometryPtr>, Record>::const_iterator i = _records.find(Ravelin::make_sorted_pair(gA, gB));
+      if (i == _records.end())
+        return false;
+      r = i->second;
+      return true;
+    }
+
+    /// Updates the record for a geometry pair
+    void update(CollisionGeometryPtr gA, CollisionGeometryPtr gB, double cn, double cs, double ct)
+    {
+      // periodically clear the table so that stale pairs do not accumulate
+      // in long-running scenes
+      const unsigned RECORDS_MAX = 1024;
+      if (_records.size() >= RECORDS_MAX)
+        _records.clear();
+
+      Record& r = _records[Ravelin::make_sorted_pair(gA, gB)];
+      r.cn = cn;
+      r.cs = cs;
+      r.ct = ct;
+    }
+
+  private:
+    /// The recorded components, keyed on the geometry pair
+    std::map<Ravelin::sorted_pair<CollisionGeometryPtr>, Record> _records;
+}; // end class
+
+} // end namespace
+
+#endif
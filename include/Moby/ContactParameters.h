@@ -20,6 +20,8 @@ class ContactParameters : public Base
     ContactParameters(BasePtr o1, BasePtr o2);
     virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
     virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
+    void load_coefficients_from_xml(boost::shared_ptr<const XMLTree> node);
+    void save_coefficients_to_xml(XMLTreePtr node) const;
 
     /// The objects in contact
     Ravelin::sorted_pair<BasePtr> objects;  
@@ -33,6 +35,12 @@ class ContactParameters : public Base
     /// Coefficient of viscous friction for contact (default is 0.0)
     double mu_viscous;
 
+    /// Coefficient of torsional friction about the contact normal (default is 0.0)
+    double mu_torsional;
+
+    /// Coefficient of rolling friction for contact (default is 0.0)
+    double mu_rolling;
+
     /// contact compliance (inverse of stiffness- zero compliance equals true rigidity)
     double compliance;
 
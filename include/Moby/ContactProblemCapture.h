@@ -0,0 +1,47 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _MOBY_CONTACT_PROBLEM_CAPTURE_H
+#define _MOBY_CONTACT_PROBLEM_CAPTURE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <Moby/UnilateralConstraintProblemData.h>
+
+namespace Moby {
+
+/// Serializes unilateral constraint problems for offline solver tuning
+/**
+ * Writes the numeric core of a UnilateralConstraintProblemData (problem
+ * dimensions, per-constraint friction and restitution metadata, all
+ * cross-constraint matrices and all velocity/impulse vectors) to a compact
+ * binary format so that contact problems captured from live simulations can
+ * be replayed through the solver backends offline. Kinematic data (contact
+ * points, normals, body references) is not captured, so a replayed problem
+ * supports the numeric solve only, not impulse application.
+ */
+class ContactProblemCapture
+{
+  public:
+    static void write(const UnilateralConstraintProblemData& q, std::ostream& out);
+    static bool read(UnilateralConstraintProblemData& q, std::vector<UnilateralConstraint>& constraints, std::istream& in);
+    static void capture(const UnilateralConstraintProblemData& q);
+    static void capture_failure(const UnilateralConstraintProblemData& q);
+
+    /// Prefix for capture files '<prefix>NNNNNN[.fail].ucp' (empty disables capture)
+    static std::string capture_prefix;
+
+    /// If true, every assembled problem is captured; otherwise only failures
+    static bool capture_all;
+
+  private:
+    static void do_capture(const UnilateralConstraintProblemData& q, bool failure);
+}; // end class
+
+} // end namespace
+
+#endif
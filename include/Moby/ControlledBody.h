@@ -7,8 +7,10 @@
 #ifndef _CONTROLLED_BODY_H
 #define _CONTROLLED_BODY_H
 
+#include <vector>
 #include <boost/shared_ptr.hpp>
 #include <boost/foreach.hpp>
+#include <Ravelin/VectorNd.h>
 #include <Moby/Base.h>
 #include <Moby/Constants.h>
 #include <Moby/Log.h>
@@ -24,9 +26,14 @@ class ControlledBody : public virtual Visualizable
 
   public:
 
-    ControlledBody() 
-    { 
-      controller = NULL; 
+    ControlledBody()
+    {
+      controller = NULL;
+      batch_controller = NULL;
+      batch_controller_arg = NULL;
+      control_period = 0.0;
+      _next_control_time = 0.0;
+      _held_gf_valid = false;
     }
 
     virtual ~ControlledBody() {}
@@ -39,6 +46,38 @@ class ControlledBody : public virtual Visualizable
     /// Argument to be passed to the controller
     void* controller_arg;
 
+    /// Signature for batched controller callbacks
+    /**
+     * The callback must resize gf to bodies.size() and write the generalized
+     * force for bodies[i] into gf[i].
+     */
+    typedef void (*BatchControllerCallback)(const std::vector<boost::shared_ptr<ControlledBody> >& bodies, std::vector<Ravelin::VectorNd>& gf, double time, void* arg);
+
+    /// The batched controller callback, if any, for this body
+    /**
+     * Bodies sharing the same callback and argument are grouped by the
+     * simulator and receive a single invocation per step covering the whole
+     * group, so a control law shared by many identical bodies computes its
+     * forces in one pass instead of once per body. Takes precedence over
+     * controller when both are set.
+     */
+    BatchControllerCallback batch_controller;
+
+    /// Argument to be passed to the batched controller
+    void* batch_controller_arg;
+
+    /// The period between controller invocations, in simulation seconds
+    /**
+     * With the default of zero the body's controller fires every step.  A
+     * positive period makes the simulator fire the controller only on steps
+     * where the period has elapsed since the last firing; between firings
+     * the generalized force recorded at the last firing is re-applied
+     * unchanged (zero-order hold), mirroring a discrete control loop running
+     * slower than the simulation rate.  Applies to both controller and
+     * batch_controller.
+     */
+    double control_period;
+
     /// Gets the set of recurrent forces applied to this body
     const std::list<RecurrentForcePtr>& get_recurrent_forces() const { return _rfs; }
 
@@ -59,6 +98,13 @@ class ControlledBody : public virtual Visualizable
     /// Set of recurrent forces applied to this body
     std::list<RecurrentForcePtr> _rfs;
 
+    // multi-rate control state (see control_period; managed by Simulator):
+    // the earliest time the controller may fire again, and the output held
+    // between firings
+    double _next_control_time;
+    bool _held_gf_valid;
+    Ravelin::VectorNd _held_gf;
+
   protected:
 
     /// Pointer to the simulator (necessary for applying impulses w/constraints)
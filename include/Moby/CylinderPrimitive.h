@@ -34,10 +34,13 @@ class CylinderPrimitive : public Primitive
     virtual void get_vertices(boost::shared_ptr<const Ravelin::Pose3d> P, std::vector<Point3d>& vertices) const;
     virtual double calc_dist_and_normal(const Point3d& point, std::vector<Ravelin::Vector3d>& normals) const;
     virtual double calc_signed_dist(boost::shared_ptr<const Primitive> p, Point3d& pthis, Point3d& pp) const;
+    double calc_signed_dist(boost::shared_ptr<const CylinderPrimitive> c, Point3d& pthis, Point3d& pcyl) const;
     virtual boost::shared_ptr<const IndexedTriArray> get_mesh(boost::shared_ptr<const Ravelin::Pose3d> P);
     virtual osg::Node* create_visualization();
     virtual Point3d get_supporting_point(const Ravelin::Vector3d& d) const;
     virtual double calc_signed_dist(const Point3d& p) const;
+    virtual void calc_signed_dists(const Point3d* points, unsigned n, double* dists) const;
+    virtual bool ray_cast(const Point3d& origin, const Ravelin::Vector3d& dir, double max_dist, double& t, Ravelin::Vector3d& normal) const;
     virtual double get_bounding_radius() const { return std::max(_radius, _height); } 
 
     /// Gets the radius of this cylinder
@@ -20,6 +20,7 @@ class DampingForce : public RecurrentForce
     DampingForce(const DampingForce& source);
     virtual ~DampingForce() {}
     virtual void add_force(boost::shared_ptr<Ravelin::DynamicBodyd> body);
+    virtual void add_force_batch(const std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> >& bodies);
     virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
     virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
 
@@ -0,0 +1,83 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _DISTANCE_FIELD_PRIMITIVE_H
+#define _DISTANCE_FIELD_PRIMITIVE_H
+
+#include <Moby/Primitive.h>
+#include <Moby/ADF.h>
+#include <Moby/FlatADF.h>
+#include <Moby/OBB.h>
+
+namespace Moby {
+
+/// A collision primitive backed by a precomputed adaptive signed distance field
+/**
+ * Bakes a triangle mesh into an adaptively-sampled distance field (see ADF)
+ * and serves signed distance queries by trilinear interpolation within the
+ * containing octree cell, rather than traversing the source mesh per query.
+ * The field can be built from a mesh at load time (and saved so subsequent
+ * loads skip the bake) or loaded directly from a baked file. Queries are
+ * served through a flattened, pointer-free copy of the octree (see FlatADF);
+ * bakes are saved in the flattened binary layout, which later loads memory-
+ * map directly, though fields written with ADF::save_to_file() still load.
+ * Intended for complex static environment geometry; mass properties are not
+ * computed.
+ */
+class DistanceFieldPrimitive : public Primitive
+{
+  public:
+    DistanceFieldPrimitive();
+    void build_from_mesh(const IndexedTriArray& mesh, unsigned max_recursion, double epsilon);
+    void set_distance_field(boost::shared_ptr<ADF> field);
+
+    /// Gets the underlying adaptive distance field (NULL if memory-mapped from a flattened file)
+    boost::shared_ptr<ADF> get_distance_field() const { return _field; }
+
+    /// Gets the flattened distance field queries are served from
+    boost::shared_ptr<const FlatADF> get_flat_field() const { return _flat; }
+
+    virtual void get_vertices(boost::shared_ptr<const Ravelin::Pose3d> P, std::vector<Point3d>& vertices) const;
+    virtual double calc_dist_and_normal(const Point3d& point, std::vector<Ravelin::Vector3d>& normals) const;
+    virtual double calc_signed_dist(boost::shared_ptr<const Primitive> p, Point3d& pthis, Point3d& pp) const;
+    virtual double calc_signed_dist(const Point3d& p) const;
+    virtual osg::Node* create_visualization();
+    virtual boost::shared_ptr<const IndexedTriArray> get_mesh(boost::shared_ptr<const Ravelin::Pose3d> P);
+    virtual void calc_mass_properties() { _density.reset(); _J.set_zero(); }
+    virtual BVPtr get_BVH_root(CollisionGeometryPtr geom);
+    virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
+    virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
+    virtual double get_bounding_radius() const;
+
+  protected:
+    double query_field(const Point3d& p, Ravelin::Vector3d& cp) const;
+
+    /// The baked adaptive distance field (NULL if memory-mapped from a flattened file)
+    boost::shared_ptr<ADF> _field;
+
+    /// The flattened field all queries are served from
+    boost::shared_ptr<FlatADF> _flat;
+
+    /// The source mesh, if the field was built from one
+    boost::shared_ptr<const IndexedTriArray> _mesh;
+
+    /// The bounding volumes for the field
+    std::map<CollisionGeometryPtr, boost::shared_ptr<OBB> > _obbs;
+
+    /// Field file name (for XML serialization)
+    std::string _field_fname;
+
+    /// Source mesh file name (for XML serialization)
+    std::string _mesh_fname;
+
+    /// Bake parameters (for XML serialization)
+    unsigned _max_recursion;
+    double _epsilon;
+}; // end class
+
+} // end namespace
+
+#endif
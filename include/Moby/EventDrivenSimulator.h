@@ -59,6 +59,20 @@ class EventDrivenSimulator : public TimeSteppingSimulator
      */ 
     double euler_step;
 
+    /// Whether event-time estimates are cached in a predictive queue
+    /**
+     * If set, the conservative-advancement certificates computed for each
+     * geometry pair and each articulated body's joint limits are cached as
+     * absolute event-time lower bounds in a time-ordered queue.  Pairs and
+     * bodies whose trajectories have not changed keep their certificates
+     * across event-location passes, so the per-pass work scales with the
+     * number of imminent events rather than with scene size.  Certificates
+     * are dropped for any body that receives an impulse and for the whole
+     * scene when velocity limit estimates are violated.  Disabled by
+     * default.
+     */
+    bool use_event_queue;
+
   protected:
     virtual double check_pairwise_constraint_violations(double t);
     void validate_limit_estimates();
@@ -86,6 +100,8 @@ class EventDrivenSimulator : public TimeSteppingSimulator
     double calc_CA_step();
     double calc_next_CA_step(double contact_dist_thresh) const;
     void reset_limit_estimates() const;
+    void invalidate_event_estimates();
+    void clear_event_estimates();
     void update_constraint_violations(const std::vector<PairwiseDistInfo>& pairwise_distances);
 
     /// Interpenetration constraint violation tolerances
@@ -102,8 +118,18 @@ class EventDrivenSimulator : public TimeSteppingSimulator
      */
     std::map<UnilateralConstraint, double, UnilateralConstraintCmp> _zero_velocity_tolerances;
 
-    /// Object for handling sustained rigid unilateral constraints 
+    /// Object for handling sustained rigid unilateral constraints
     SustainedUnilateralConstraintHandler _rigid_unilateral_constraint_handler;
+
+    /// The predictive event queue, ordered on absolute event-time lower bounds (see use_event_queue)
+    typedef std::multimap<double, Ravelin::sorted_pair<CollisionGeometryPtr> > PairEventQueue;
+    PairEventQueue _pair_event_queue;
+
+    /// Positions of geometry pairs within the predictive event queue
+    std::map<Ravelin::sorted_pair<CollisionGeometryPtr>, PairEventQueue::iterator> _pair_event_queue_pos;
+
+    /// Absolute times below which articulated bodies are certified free of joint-limit events
+    std::map<ControlledBodyPtr, double> _joint_event_times;
 }; // end class
 
 #include "EventDrivenSimulator.inl"
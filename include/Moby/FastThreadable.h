@@ -9,6 +9,10 @@
 namespace Moby {
 
 /// This class exists solely to make static declaration of dynamically allocated variables safe
+/**
+ * \note new internal code should prefer ScratchArena, which allocates its
+ *       per-worker storage once per process instead of per instance.
+ */
 template <class T>
 class FastThreadable
 {
@@ -0,0 +1,97 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _MOBY_FLAT_ADF_H_
+#define _MOBY_FLAT_ADF_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <Ravelin/Vector3d.h>
+#include <Moby/Types.h>
+
+namespace Moby {
+
+class ADF;
+
+/// A flattened, pointer-free adaptively-sampled distance field
+/**
+ * The ADF octree links its cells through shared pointers and stores a vector
+ * of vertices and distances per cell, so every query descent chases pointers
+ * across the heap.  A FlatADF is built from a finished ADF: the cells are
+ * packed into one linear array in breadth-first order (the eight children of
+ * a cell are contiguous, addressed by a single first-child index) and the
+ * leaf corner distances are packed into a second contiguous array.  Cell
+ * bounds are not stored at all -- they are reconstructed by halving during
+ * the descent -- so a cell record is eight bytes and a query touches a
+ * handful of cache lines.  The same layout is written verbatim by
+ * save_to_file() and memory-mapped back by load_from_file(), so baked
+ * environment fields load without parsing or per-cell allocation.
+ */
+class FlatADF
+{
+  public:
+    FlatADF();
+    FlatADF(boost::shared_ptr<const ADF> root);
+    ~FlatADF();
+    void build(boost::shared_ptr<const ADF> root);
+    double calc_signed_distance(const Ravelin::Vector3d& point) const;
+    Ravelin::Vector3d determine_normal(const Ravelin::Vector3d& point) const;
+    bool contains(const Ravelin::Vector3d& point) const;
+    void get_bounds(Ravelin::Vector3d& lo, Ravelin::Vector3d& hi) const;
+    void save_to_file(const std::string& filename) const;
+    static boost::shared_ptr<FlatADF> load_from_file(const std::string& filename);
+    static bool is_flat_field_file(const std::string& filename);
+
+    /// Gets the number of cells in the flattened octree
+    unsigned count_cells() const { return _num_cells; }
+
+  private:
+    /// One flattened octree cell
+    /**
+     * first_child indexes this cell's first child in the cell array (the
+     * eight children are contiguous, in subvolume order) and is zero for a
+     * leaf; dist_ofs indexes a leaf's eight corner distances in the packed
+     * distance array.
+     */
+    struct FlatCell
+    {
+      unsigned first_child;
+      unsigned dist_ofs;
+    };
+
+    // declared but not defined; the raw arrays alias internal storage (or a
+    // file mapping), so copying is unsafe
+    FlatADF(const FlatADF&);
+    FlatADF& operator=(const FlatADF&);
+
+    unsigned find_leaf(const Ravelin::Vector3d& point, double lo[3], double hi[3]) const;
+    double interp(unsigned leaf, const double lo[3], const double hi[3], double px, double py, double pz) const;
+    void unload();
+
+    /// The root cell bounds
+    double _lo[3], _hi[3];
+
+    /// The cell and packed leaf-distance arrays; these point either into the
+    /// in-core storage below or into the file mapping
+    const FlatCell* _cells;
+    const double* _dists;
+    unsigned _num_cells, _num_leafs;
+
+    /// In-core storage (populated by build())
+    std::vector<FlatCell> _cell_storage;
+    std::vector<double> _dist_storage;
+
+    /// The file mapping (populated by load_from_file())
+    void* _mapping;
+    std::size_t _mapping_len;
+    int _fd;
+}; // end class
+
+} // end namespace
+
+#endif
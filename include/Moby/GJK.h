@@ -8,47 +8,53 @@
 #define _GJK_H
 
 #include <iostream>
+#include <limits>
+#include <cassert>
+#include <Ravelin/Origin3d.h>
 namespace Moby {
 
-/// An implementation of the GJK algorithm 
+/// An implementation of the GJK algorithm
 class GJK
 {
   public:
-    static double do_gjk(boost::shared_ptr<const Primitive> A, boost::shared_ptr<const Primitive> B, boost::shared_ptr<const Ravelin::Pose3d> pA, boost::shared_ptr<const Ravelin::Pose3d> pB, Point3d& cpA, Point3d& cpB, unsigned max_iter = 1000);
+    static double do_gjk(boost::shared_ptr<const Primitive> A, boost::shared_ptr<const Primitive> B, boost::shared_ptr<const Ravelin::Pose3d> pA, boost::shared_ptr<const Ravelin::Pose3d> pB, Point3d& cpA, Point3d& cpB, unsigned max_iter = 1000, double threshold = std::numeric_limits<double>::max());
+    static bool cull_pair(CollisionGeometryPtr gA, CollisionGeometryPtr gB, double thresh, unsigned budget, double& bound);
+    static void batch_cull(const std::vector<CollisionGeometryPtr>& gA, const std::vector<CollisionGeometryPtr>& gB, double thresh, unsigned budget, std::vector<char>& culled, std::vector<double>& bounds);
 
   private:
-    struct SVertex
-    {
-      Point3d v;      // vA - vB: the vertex in the simplex
-      Point3d vA, vB; // vertices from geometry A and B
-      std::ostream& output(std::ostream& out) const;
-
-      SVertex() {}
-      SVertex(const Point3d& a, const Point3d& b)
-      {
-        vA = a;
-        vB = b;
-        v = Ravelin::Pose3d::transform_point(GLOBAL, a) - 
-            Ravelin::Pose3d::transform_point(GLOBAL, b);
-      }
-    };
+    static double do_epa(boost::shared_ptr<const Primitive> A, boost::shared_ptr<const Primitive> B, boost::shared_ptr<const Ravelin::Pose3d> pA, boost::shared_ptr<const Ravelin::Pose3d> pB, Point3d& cpA, Point3d& cpB);
 
+    /// A flat fixed-storage simplex over Minkowski-difference vertices
+    /**
+     * The simplex is a plain value type: four Ravelin::Origin3d slots and a
+     * type tag, with no heap state and no reference-counted members, so a
+     * GJK call keeps its working set in a handful of cache lines and
+     * performs no allocation or refcount traffic.  Instances are trivially
+     * copyable, so they can also be stored in per-pair coherence records to
+     * warm-start later queries.  Vertices are coordinates of an A support
+     * point minus a B support point, in the global frame.
+     */
     class Simplex
     {
       public:
         enum SimplexType { ePoint, eSegment, eTriangle, eTetra };
         SimplexType get_simplex_type() const { return _type; }
-        Simplex(const SVertex& p) { _type = ePoint; _v1 = p; }
-        void add(const SVertex& p);
-        Point3d find_closest_and_simplify();
-        Point3d find_closest();
-        const SVertex& get_vertex(unsigned i) const;
-        unsigned num_vertices() const;
+        Simplex() { _type = ePoint; }
+        Simplex(const Ravelin::Origin3d& p) { _type = ePoint; _v[0] = p; }
+        void add(const Ravelin::Origin3d& p);
+        Ravelin::Origin3d find_closest_and_simplify();
+        Ravelin::Origin3d find_closest();
+        const Ravelin::Origin3d& get_vertex(unsigned i) const { assert(i < num_vertices()); return _v[i]; }
+        unsigned num_vertices() const { return (unsigned) _type + 1; }
         std::ostream& output(std::ostream& out) const;
 
       private:
+        static Ravelin::Origin3d closest_on_segment(const Ravelin::Origin3d& a, const Ravelin::Origin3d& b, double& t);
+        static Ravelin::Origin3d closest_on_triangle(const Ravelin::Origin3d& a, const Ravelin::Origin3d& b, const Ravelin::Origin3d& c, double& s, double& t);
+        Ravelin::Origin3d closest_on_tetra(double& u, double& v, double& w) const;
+
         SimplexType _type;
-        SVertex _v1, _v2, _v3, _v4;
+        Ravelin::Origin3d _v[4];
     };
 
 }; // end class
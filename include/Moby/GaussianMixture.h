@@ -42,6 +42,15 @@ class GaussianMixture : public Primitive
       void construct_vertices();
       void construct_BVs(CollisionGeometryPtr geom);
       void create_mesh();
+      void build_eval_accel();
+
+      /// Per-Gaussian constants precomputed for fast height-field evaluation
+      struct GaussAux
+      {
+        double a, b, c;    // quadratic form coefficients at the query point
+        double lam_min;    // smallest eigenvalue of the quadratic form
+        double log_A;      // log of the Gaussian height
+      };
 
       /// Note: there are no mass properties, because this can have no mass!
       virtual void calc_mass_properties() { }
@@ -61,6 +70,12 @@ class GaussianMixture : public Primitive
       /// The set of Gaussians
       std::vector<Gauss> _gauss;
 
+      /// Precomputed evaluation constants, aligned with _gauss
+      std::vector<GaussAux> _aux;
+
+      /// Indices of _gauss ordered by descending height (for pruned evaluation)
+      std::vector<unsigned> _desc_height;
+
       /// The mapping from bounding volumes to Gaussians
       std::map<OBBPtr, unsigned> _obbs;
 
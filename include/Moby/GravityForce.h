@@ -8,6 +8,7 @@
 #define _GRAVITY_FORCE_H
 
 #include <Ravelin/Vector3d.h>
+#include <Ravelin/RigidBodyd.h>
 #include <Moby/RecurrentForce.h>
 
 namespace Moby {
@@ -18,11 +19,15 @@ class GravityForce : public RecurrentForce
     GravityForce(const GravityForce& source);
     virtual ~GravityForce() {}
     virtual void add_force(boost::shared_ptr<Ravelin::DynamicBodyd> body);
+    virtual void add_force_batch(const std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> >& bodies);
     virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
     virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
 
     /// The gravity vector
     Ravelin::Vector3d gravity;
+
+  private:
+    void add_gravity(boost::shared_ptr<Ravelin::RigidBodyd> rb);
 }; // end class
 } // end namespace
 
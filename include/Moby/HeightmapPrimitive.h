@@ -36,14 +36,29 @@ class HeightmapPrimitive : public Primitive
     virtual BVPtr get_BVH_root(CollisionGeometryPtr geom);
     virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
     virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
+    /// Gets the in-core height matrix (empty for paged heightmaps; prefer height()/rows()/columns())
     const Ravelin::MatrixNd& get_heights() const { return _heights; }
     double get_width() const { return _width; }
     double get_depth() const { return _depth; }
     virtual double get_bounding_radius() const { return 0.0; }
+    void calc_heights(boost::shared_ptr<const Ravelin::Pose3d> P, const std::vector<Point3d>& points, std::vector<double>& heights) const;
 
   protected:
     virtual double calc_height(const Point3d& p) const;
     void calc_gradient(const Point3d& p, double& gx, double& gz) const;
+    double eval_bilinear(double qx, double qz) const;
+
+    /// Gets one height sample (overridden by paged heightmaps that do not keep the full grid in core)
+    virtual double height(unsigned i, unsigned j) const { return _heights(i,j); }
+
+    /// Gets the number of height samples along the x direction
+    virtual unsigned rows() const { return _heights.rows(); }
+
+    /// Gets the number of height samples along the z direction
+    virtual unsigned columns() const { return _heights.columns(); }
+
+    /// Gets the range of height samples in the map
+    virtual void calc_min_max_heights(double& miny, double& maxy) const;
 
     /// width of the heightmap
     double _width;
@@ -54,8 +69,14 @@ class HeightmapPrimitive : public Primitive
     // heights
     Ravelin::MatrixNd _heights;
 
-    /// The bounding volumes for the heightmap 
-    std::map<CollisionGeometryPtr, boost::shared_ptr<OBB> > _obbs; 
+    /// The bounding volumes for the heightmap
+    std::map<CollisionGeometryPtr, boost::shared_ptr<OBB> > _obbs;
+
+    /// The last-accessed bilinear patch (see eval_bilinear())
+    mutable bool _patch_valid;
+    mutable unsigned _patch_i, _patch_j;
+    mutable double _patch_f00, _patch_f10, _patch_f01, _patch_f11;
+    mutable double _patch_x0, _patch_z0, _patch_inv_dx, _patch_inv_dz;
 
 }; // end class
 
@@ -23,12 +23,14 @@
 #include <Moby/LCP_IPOPT.h>
 #endif
 #include <Ravelin/LinAlgd.h>
+#include <Ravelin/sorted_pair>
 #include <Moby/Base.h>
 #include <Moby/Types.h>
 #include <Moby/LCP.h>
 #include <Moby/SparseJacobian.h>
 #include <Moby/UnilateralConstraint.h>
 #include <Moby/UnilateralConstraintProblemData.h>
+#include <Moby/ContactForceHistory.h>
 
 namespace Moby {
 
@@ -47,6 +49,9 @@ class ImpactConstraintHandler
     void process_constraints(const std::vector<UnilateralConstraint>& constraints);
     static boost::shared_ptr<Ravelin::DynamicBodyd> get_super_body(boost::shared_ptr<Ravelin::SingleBodyd> sb);
 
+    /// Gets the pivoting LCP solver, e.g., for reading solver statistics or setting telemetry callbacks
+    LCP& get_lcp_solver() { return _lcp; }
+
     /// If set to true, uses the interior-point solver (default is false)
     bool use_ip_solver;
 
@@ -56,12 +61,96 @@ class ImpactConstraintHandler
     /// The tolerance for to the interior-point solver (default 1e-6)
     double ip_eps;
 
+    /// If set to true, uses the projected Gauss-Seidel solver (default is false)
+    bool use_pgs_solver;
+
+    /// The maximum number of sweeps for the projected Gauss-Seidel solver (default 50)
+    unsigned pgs_max_iterations;
+
+    /// The convergence tolerance for the projected Gauss-Seidel solver (default 1e-8)
+    double pgs_tolerance;
+
+    /// If set to true, uses the cone-complementarity solver (default is false)
+    /**
+     * The direct backends linearize each Coulomb cone into 2+NK polyhedral
+     * rows, so cone accuracy is bought with problem size. This backend keeps
+     * the exact second-order cone with three unknowns per contact, iterating
+     * projected fixed-point sweeps like the Gauss-Seidel solver; friction is
+     * isotropic at any sliding direction with no edge count to tune. Takes
+     * precedence over use_pgs_solver and auto_solver_selection.
+     */
+    bool use_ccp_solver;
+
+    /// The maximum number of sweeps for the cone-complementarity solver (default 100)
+    unsigned ccp_max_iterations;
+
+    /// The convergence tolerance for the cone-complementarity solver (default 1e-8)
+    double ccp_tolerance;
+
+    /// If set to true, picks the solver per island by problem size (default is false)
+    /**
+     * Small islands keep the configured direct model (pivoting LCP solves
+     * are fastest at low dimension), while islands with at least
+     * auto_pgs_contact_threshold contacts are handed to the projected
+     * Gauss-Seidel solver, whose per-sweep cost grows only linearly with
+     * the island dimension. use_pgs_solver, when set, forces PGS everywhere
+     * regardless of this flag.
+     */
+    bool auto_solver_selection;
+
+    /// If set to true, all islands use the viscous friction model (default is false)
+    /**
+     * The viscous model costs a single linear solve per island, making it
+     * the cheapest constraint handling available; a real-time simulator
+     * over its wall-clock budget sets this to trade Coulomb friction
+     * accuracy for bounded latency (see
+     * TimeSteppingSimulator::rt_step_budget).
+     */
+    bool force_visc_friction_model;
+
+    /// Island contact count at/above which auto selection uses PGS (default 16)
+    unsigned auto_pgs_contact_threshold;
+
+    /// If set to true, relaxes solver tolerances on negligible-energy islands (default is false)
+    /**
+     * An island whose kinetic energy is below adaptive_ke_threshold and
+     * whose largest constraint velocity magnitude is below
+     * adaptive_velocity_threshold is resolving micro-jitter, not an impact;
+     * the iterative solver tolerances (pgs_tolerance, ccp_tolerance and
+     * ip_eps) are
+     * multiplied by adaptive_tolerance_scale for the duration of that
+     * island's solve, cutting iterations where the extra precision would be
+     * invisible. Energetic islands are always solved to the configured
+     * tolerances.
+     */
+    bool adaptive_tolerance;
+
+    /// Island kinetic energy below which tolerances relax (default 1e-6)
+    double adaptive_ke_threshold;
+
+    /// Largest constraint speed below which tolerances relax (default 1e-4)
+    double adaptive_velocity_threshold;
+
+    /// Factor applied to solver tolerances on negligible-energy islands (default 100)
+    double adaptive_tolerance_scale;
+
+    /// Per-contact force/impulse history, shareable with other handlers for cross-handler warm starts
+    boost::shared_ptr<ContactForceHistory> contact_force_history;
+
+    unsigned solve_pgs(UnilateralConstraintProblemData& epd);
+    unsigned solve_ccp(UnilateralConstraintProblemData& epd);
+    static unsigned color_constraint_graph(const UnilateralConstraintProblemData& epd, std::vector<unsigned>& colors);
+    unsigned long calc_memory_usage() const;
+    void release_transient_memory();
+
   private:
     static void compute_signed_dist_dot_Jacobian(UnilateralConstraintProblemData& q, Ravelin::MatrixNd& J);
     void solve_frictionless_lcp(UnilateralConstraintProblemData& q, Ravelin::VectorNd& z);
     void apply_visc_friction_model_to_connected_constraints(const std::list<UnilateralConstraint*>& constraints, const std::list<boost::shared_ptr<Ravelin::SingleBodyd> >& single_bodies);
     void apply_no_slip_model_to_connected_constraints(const std::list<UnilateralConstraint*>& constraints, const std::list<boost::shared_ptr<Ravelin::SingleBodyd> >& single_bodies);
     void apply_ap_model_to_connected_constraints(const std::list<UnilateralConstraint*>& constraints, const std::list<boost::shared_ptr<Ravelin::SingleBodyd> >& single_bodies);
+    void apply_pgs_model_to_connected_constraints(const std::list<UnilateralConstraint*>& constraints, const std::list<boost::shared_ptr<Ravelin::SingleBodyd> >& single_bodies);
+    void apply_ccp_model_to_connected_constraints(const std::list<UnilateralConstraint*>& constraints, const std::list<boost::shared_ptr<Ravelin::SingleBodyd> >& single_bodies);
     static void update_from_stacked(UnilateralConstraintProblemData& q, const Ravelin::VectorNd& z);
     static void update_from_stacked(UnilateralConstraintProblemData& q);
     double calc_min_constraint_velocity(const UnilateralConstraintProblemData& q) const;
@@ -72,9 +161,12 @@ class ImpactConstraintHandler
     void apply_visc_friction_model(UnilateralConstraintProblemData& epd);
     void apply_no_slip_model(UnilateralConstraintProblemData& epd);
     void apply_ap_model(UnilateralConstraintProblemData& epd);
+    void apply_pgs_model(UnilateralConstraintProblemData& epd);
+    void apply_ccp_model(UnilateralConstraintProblemData& epd);
     void solve_qp(Ravelin::VectorNd& z, UnilateralConstraintProblemData& epd);
     void solve_nqp(Ravelin::VectorNd& z, UnilateralConstraintProblemData& epd);
     void apply_model(const std::vector<UnilateralConstraint>& constraints);
+    void apply_model_to_group(std::pair<std::list<UnilateralConstraint*>, std::list<boost::shared_ptr<Ravelin::SingleBodyd> > >& group);
     void apply_model_to_connected_constraints(const std::list<UnilateralConstraint*>& constraints, const std::list<boost::shared_ptr<Ravelin::SingleBodyd> >& single_bodies);
     void compute_problem_data(UnilateralConstraintProblemData& epd, const std::list<boost::shared_ptr<Ravelin::SingleBodyd> >& single_bodies);
     void solve_lcp(UnilateralConstraintProblemData& epd, Ravelin::VectorNd& z);
@@ -94,7 +186,9 @@ class ImpactConstraintHandler
     static Ravelin::MatrixNd& to_dense(const std::vector<Ravelin::MatrixNd>& J, Ravelin::MatrixNd& B);
     static void get_generalized_velocity(const UnilateralConstraintProblemData& epd, Ravelin::VectorNd& v);
     static void compute_limit_components(const Ravelin::MatrixNd& X, UnilateralConstraintProblemData& epd);
+    static void compute_limit_components(const std::vector<Ravelin::MatrixNd>& X_diag, UnilateralConstraintProblemData& epd);
     static void compute_X(UnilateralConstraintProblemData& epd, Ravelin::MatrixNd& X);
+    static void compute_X_diag(UnilateralConstraintProblemData& epd, std::vector<Ravelin::MatrixNd>& X_diag);
     static void update_generalized_velocities(const UnilateralConstraintProblemData& epd, const Ravelin::VectorNd& dv); 
     static void add_contact_to_Jacobian(const UnilateralConstraint& c, SparseJacobian& Cn, SparseJacobian& Cs, SparseJacobian& Ct, const std::map<boost::shared_ptr<Ravelin::DynamicBodyd>, unsigned>& gc_map, unsigned contact_index);
     static void add_contact_dir_to_Jacobian(boost::shared_ptr<Ravelin::RigidBodyd> rb, boost::shared_ptr<Ravelin::ArticulatedBodyd> ab, SparseJacobian& C, const Ravelin::Vector3d& contact_point, const Ravelin::Vector3d& d, const std::map<boost::shared_ptr<Ravelin::DynamicBodyd>, unsigned>& gc_map, unsigned contact_index);
@@ -103,9 +197,18 @@ class ImpactConstraintHandler
     Ravelin::LinAlgd _LA;
     LCP _lcp;
 
+    /// Identity of a constraint set: contact geometry pairs plus limit joint/DOF identities, in problem order
+    typedef std::pair<std::vector<Ravelin::sorted_pair<CollisionGeometryPtr> >, std::vector<std::pair<JointPtr, unsigned> > > WarmStartKey;
+
+    /// Warm-start cache mapping a constraint set identity to the last LCP solution computed for it
+    std::map<WarmStartKey, Ravelin::VectorNd> _warm_start_cache;
+
     // persistent constraint data
     UnilateralConstraintProblemData _epd;
 
+    // per-thread handler instances for parallel constraint-group solves
+    std::vector<boost::shared_ptr<ImpactConstraintHandler> > _workers;
+
     // a pointer to the simulator
     boost::shared_ptr<ConstraintSimulator> _simulator;
 
@@ -113,6 +216,9 @@ class ImpactConstraintHandler
     Ravelin::MatrixNd _MM;
     Ravelin::VectorNd _zlast, _v;
 
+    // packed generalized-impulse slab for apply_impulses()
+    Ravelin::VectorNd _gj;
+
     // temporaries for solve_qp_work() and solve_nqp_work()
     Ravelin::VectorNd _workv, _new_Cn_v;
 
@@ -145,10 +251,17 @@ class ImpactConstraintHandler
     Ravelin::MatrixNd _RTH;
     Ravelin::VectorNd _w, _workv2, _x;
 
+    // cached nullspace from the last solve_nqp_work() call, reused while the
+    // implicit constraint matrix is unchanged (sustained contact)
+    Ravelin::MatrixNd _nqp_null_A, _nqp_null_R;
+
     // temporaries for solve_lcp()
     Ravelin::MatrixNd _AU, _AV, _B, _C, _D;
     Ravelin::VectorNd _AS, _alpha_x, _qq, _Cn_vplus;
 
+    // variable bound temporaries for the active-set QP fallbacks
+    Ravelin::VectorNd _lb, _ub;
+
     // QLCPD solver
     #ifdef USE_QLCPD
     QLCPD _qp;
@@ -41,10 +41,15 @@ class IndexedTriArray
     unsigned num_tris() const { return (_facets) ? _facets->size() : 0; }
     Triangle get_triangle(unsigned i, boost::shared_ptr<const Ravelin::Pose3d> P) const;
     IndexedTriArray transform(const Ravelin::Transform3d& T) const;
+    void update_vertices(boost::shared_ptr<const std::vector<Ravelin::Origin3d> > vertices);
     IndexedTriArray compress_vertices() const;
+    IndexedTriArray decimate(unsigned target_tris) const;
     static IndexedTriArray read_from_obj(const std::string& filename);
     static void write_to_obj(const IndexedTriArray& mesh, const std::string& filename);
     void write_to_obj(const std::string& filename) const { write_to_obj(*this, filename); }
+    static IndexedTriArray read_from_binary(const std::string& filename);
+    static void write_to_binary(const IndexedTriArray& mesh, const std::string& filename);
+    void write_to_binary(const std::string& filename) const { write_to_binary(*this, filename); }
     static IndexedTriArray merge(const IndexedTriArray& mesh1, const IndexedTriArray& mesh2, double equal_tol = 0.0);
     IndexedTriArray& operator=(const IndexedTriArray& mesh);
     std::vector<std::list<unsigned> > determine_vertex_edge_map() const;
@@ -78,6 +83,7 @@ class IndexedTriArray
     static bool query_intersect_tri_tri(const Triangle& t1, const Triangle& t2);
     void validate() const;
     void calc_incident_facets();
+    void optimize_facet_order();
 
     /// Sorted vector of coplanar edges (all facets touching each edge are coplanar)
     std::vector<Ravelin::sorted_pair<unsigned> > _coplanar_edges;
@@ -35,6 +35,9 @@ IndexedTriArray::IndexedTriArray(ForwardIterator1 verts_begin, ForwardIterator1
   // validate that indices are within range
   validate();
 
+  // reorder the facets for vertex cache and BVH leaf locality
+  optimize_facet_order();
+
   // calculate incident facets and determine coplanar features
   calc_incident_facets();
   determine_coplanar_features();
@@ -43,7 +43,35 @@ class Joint : public Visualizable, public virtual Ravelin::Jointd
     Joint(boost::weak_ptr<RigidBody> inboard, boost::weak_ptr<RigidBody> outboard);
     virtual ~Joint() {}
     void set_location(const Point3d& p, RigidBodyPtr inboard, RigidBodyPtr outboard);
+    void prepare_step();
+    void invalidate_step_data();
+    void evaluate_constraints_prepared(double C[]);
+    void calc_constraint_jacobian_prepared(bool inboard, Ravelin::MatrixNd& Cq);
     Ravelin::VectorNd& get_scaled_force(Ravelin::VectorNd& f);
+
+    /// Invokes op(dof_index) for every DOF, with a compile-time trip count when possible
+    /**
+     * One-DOF revolute and prismatic joints dominate most models, so the
+     * loops that visit every DOF of every joint mostly run with a trip count
+     * of one that the compiler cannot see past the virtual num_dof() call.
+     * This switches on num_dof() once per joint and instantiates the loop
+     * with the count as a template constant for the common low-DOF cases,
+     * letting the compiler unroll the per-DOF body and index with constants;
+     * larger counts fall back to the runtime-bounded loop.
+     */
+    template <class OpT>
+    void for_each_dof(OpT& op) const
+    {
+      switch (num_dof())
+      {
+        case 1:  for_each_dof_fixed<1, OpT>(op); break;
+        case 2:  for_each_dof_fixed<2, OpT>(op); break;
+        case 3:  for_each_dof_fixed<3, OpT>(op); break;
+        default:
+          for (unsigned j=0; j< num_dof(); j++)
+            op(j);
+      }
+    }
     virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
     virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
     virtual void set_inboard_link(RigidBodyPtr link, bool update_pose);
@@ -102,7 +130,27 @@ class Joint : public Visualizable, public virtual Ravelin::Jointd
      */
     virtual void init_data();
 
+    /// Whether the cached constraint evaluations reflect the current poses
+    bool _C_cache_valid;
+
+    /// Whether the cached constraint Jacobians reflect the current poses
+    bool _Cq_cache_valid;
+
+    /// Cached constraint evaluations at the prepared configuration
+    double _C_cache[7];
+
+    /// Cached constraint Jacobian blocks at the prepared configuration
+    Ravelin::MatrixNd _Cq_in_cache, _Cq_out_cache;
+
   private:
+    /// Fixed-count instantiation of the per-DOF loop (see for_each_dof())
+    template <unsigned NDOF, class OpT>
+    void for_each_dof_fixed(OpT& op) const
+    {
+      for (unsigned j=0; j< NDOF; j++)
+        op(j);
+    }
+
     boost::shared_ptr<Ravelin::Pose3d> _vtransform;
 }; // end class
 } // end namespace
@@ -7,10 +7,13 @@
 #ifndef _MOBY_LCP_H
 #define _MOBY_LCP_H
 
+#include <iostream>
+#include <string>
 #include <Ravelin/MatrixNd.h>
 #include <Ravelin/SparseMatrixNd.h>
 #include <Ravelin/LinAlgd.h>
 #include <Ravelin/VectorNd.h>
+#include <Moby/SolverStats.h>
 
 namespace Moby {
 
@@ -26,16 +29,47 @@ class LCP
     bool lcp_fast_regularized(const Ravelin::MatrixNd& M, const Ravelin::VectorNd& q, Ravelin::VectorNd& z, int min_exp = -20, unsigned step_exp = 4, int max_exp = 20, double piv_tol = -1.0, double zero_tol = -1.0);
     bool fast_pivoting(const Ravelin::MatrixNd& M, const Ravelin::VectorNd& q, Ravelin::VectorNd& z, double eps = std::sqrt(std::numeric_limits<double>::epsilon()));
 
+    /// Gets the number of pivots performed by the last solve
+    unsigned get_pivots() const { return pivots; }
+
+    /// Statistics accumulated over solves (reset by the caller as desired)
+    SolverStats stats;
+
+    /// If true, each solve records a SVD-based condition number estimate of its matrix in stats (expensive; default false)
+    bool estimate_conditioning;
+
+    /// If true, Lemke basis solves on large dense problems run in single precision with double-precision iterative refinement (default false)
+    bool use_mixed_precision;
+
+    /// Minimum problem size for mixed-precision basis solves; smaller solves always use double precision (default 200)
+    unsigned mixed_precision_min_size;
+
+    static void write_lcp(const Ravelin::MatrixNd& M, const Ravelin::VectorNd& q, std::ostream& out);
+    static bool read_lcp(Ravelin::MatrixNd& M, Ravelin::VectorNd& q, std::istream& in);
+    static void capture(const Ravelin::MatrixNd& M, const Ravelin::VectorNd& q);
+
+    /// Prefix for capturing assembled LCPs to '<prefix>NNNNNN.Mq' files (empty disables capture)
+    static std::string capture_prefix;
+
   private:
     unsigned pivots;
+    bool _nested;
+    void record_solve(const Ravelin::MatrixNd& M, const Ravelin::VectorNd& q, const Ravelin::VectorNd& z, bool solved, double lambda);
+    void record_solve(const Ravelin::SparseMatrixNd& M, const Ravelin::VectorNd& q, const Ravelin::VectorNd& z, bool solved, double lambda);
     static void log_failure(const Ravelin::MatrixNd& M, const Ravelin::VectorNd& q);
     static void set_basis(unsigned n, unsigned count, std::vector<unsigned>& bas, std::vector<unsigned>& nbas);
     static unsigned rand_min(const Ravelin::VectorNd& v, double zero_tol);
+    bool solve_basis_mixed(const Ravelin::MatrixNd& A, Ravelin::VectorNd& x);
+    void substitute_float(unsigned n, std::vector<float>& x) const;
 
     // temporaries for regularized solver
     Ravelin::MatrixNd _MM;
     Ravelin::VectorNd _wx;
 
+    // temporaries for statistics recording
+    Ravelin::MatrixNd _rM, _rU, _rV;
+    Ravelin::VectorNd _rS, _rw;
+
     // temporaries for fast pivoting solver
     Ravelin::VectorNd _z, _w, _qbas, _qprime;
     Ravelin::MatrixNd _Msub, _Mmix, _M;
@@ -46,6 +80,11 @@ class LCP
     Ravelin::MatrixNd _Bl, _Al, _t1, _t2;
     std::vector<unsigned> _all, _tlist, _bas, _nonbas, _j, _max_elm;
 
+    // temporaries for mixed-precision basis solves
+    std::vector<float> _f_A, _f_x;
+    std::vector<unsigned> _f_piv;
+    Ravelin::VectorNd _mp_b, _mp_r, _mp_t;
+
     // temporary for sparse Lemke solver
     Ravelin::SparseMatrixNd _sBl;
     Ravelin::SparseMatrixNd _MMs, _MMx, _eye, _zero, _diag_lambda;
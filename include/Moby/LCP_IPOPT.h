@@ -17,15 +17,19 @@
 #include <Moby/LCP.h>
 #include <Moby/Event.h>
 #include <Moby/EventProblemData.h>
+#include <Moby/SolverStats.h>
 
 namespace Moby {
 
-/// Defines the mechanism for handling impact events 
-class LCP_IPOPT : public Ipopt::TNLP 
+/// Defines the mechanism for handling impact events
+class LCP_IPOPT : public Ipopt::TNLP
 {
   public:
     LCP_IPOPT();
 
+    /// Statistics accumulated over solves (reset by the caller as desired)
+    SolverStats stats;
+
     /// Particular solution (before optimization), final solution (after)
     Ravelin::VectorNd z;
 
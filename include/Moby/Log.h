@@ -12,16 +12,30 @@
 #include <limits>
 #include <sstream>
 #include <fstream>
+#include <string>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 
 namespace Moby {
 
+/// Logging categories compiled into the binary
+/**
+ * Defaults to all categories. Defining MOBY_LOG_COMPILED_CATEGORIES at build
+ * time (e.g., -DMOBY_LOG_COMPILED_CATEGORIES=LOG_CONSTRAINT) restricts the
+ * mask: FILE_LOG/LOGGING sites for categories outside the mask fold to a
+ * compile-time constant false, so their stream chains are elided entirely
+ * and cost zero instructions in hot functions.
+ */
+#ifndef MOBY_LOG_COMPILED_CATEGORIES
+#define MOBY_LOG_COMPILED_CATEGORIES (~0u)
+#endif
+
 #ifdef NDEBUG
 #define FILE_LOG(level) if (false) Log<OutputToFile>().get(level)
 #define LOGGING(level) false
 #else
-#define FILE_LOG(level) if ((level & Log<OutputToFile>::reporting_level) > 0) Log<OutputToFile>().get(level)
-#define LOGGING(level) ((level & Log<OutputToFile>::reporting_level) > 0)
+#define FILE_LOG(level) if (((level) & MOBY_LOG_COMPILED_CATEGORIES & Log<OutputToFile>::reporting_level) > 0) Log<OutputToFile>().get(level)
+#define LOGGING(level) (((level) & MOBY_LOG_COMPILED_CATEGORIES & Log<OutputToFile>::reporting_level) > 0)
 #endif
 
 struct OutputToFile
@@ -29,6 +43,21 @@ struct OutputToFile
   static std::ofstream stream;
 
   static void output(const std::string& msg);
+
+  /// Routes messages into an in-memory ring buffer instead of the stream
+  /**
+   * With a nonzero capacity, output() appends messages to a preallocated
+   * ring of the last N messages instead of writing (and flushing) the
+   * fstream inline, so logging in production does not serialize the step on
+   * file I/O; dump_ring() writes the buffered messages out in order. Like
+   * the rest of the logging surface, the ring is not thread-safe.
+   */
+  static void set_ring_capacity(unsigned n);
+  static void dump_ring();
+
+  static std::vector<std::string> ring;
+  static unsigned ring_next;
+  static bool ring_wrapped;
 };
 
 template <typename OutputPolicy>
@@ -10,6 +10,7 @@
 #include <pthread.h>
 #include <map>
 #include <list>
+#include <set>
 #include <vector>
 #include <boost/shared_ptr.hpp>
 #include <Ravelin/Vector3d.h>
@@ -140,6 +141,12 @@ class MCArticulatedBody : public ArticulatedBody
     virtual Ravelin::MatrixNd& solve_generalized_inertia(const Ravelin::MatrixNd& B, Ravelin::MatrixNd& X);
     void select_sub_contact_Jacobians(const UnilateralConstraintProblemData& q, SparseJacobian& Jc_sub, SparseJacobian& Dc_sub) const;
     Ravelin::VectorNd& solve_Jx_iM_JxT(const Ravelin::VectorNd& rhs, Ravelin::VectorNd& x) const;
+    void build_joint_adjacency(std::vector<std::set<unsigned> >& adj) const;
+    static void min_degree_order(std::vector<std::set<unsigned> > adj, const std::vector<bool>& in_subset, std::vector<unsigned>& order);
+    static void add_elimination_fill(std::vector<std::set<unsigned> >& adj, const std::vector<unsigned>& order);
+    bool partition_joint_graph(const std::vector<std::set<unsigned> >& adj, std::vector<bool>& inA, std::vector<bool>& inB, std::vector<bool>& inS) const;
+    bool eliminate_block_pivots(Ravelin::MatrixNd& A, const std::vector<unsigned>& pos, const std::vector<std::set<unsigned> >& adj, unsigned m0, unsigned m1, const std::vector<bool>& in_sep, const std::vector<unsigned>& sep_ofs, Ravelin::MatrixNd* Ssum);
+    bool factor_Jx_iM_JxT_sparse();
 
     /// The last-computed generalized velocity (in axis-angle representation)
     Ravelin::VectorNd _xd;
@@ -159,6 +166,22 @@ class MCArticulatedBody : public ArticulatedBody
     /// Indicates whether J*iM*J' is rank deficient
     bool _rank_def;
 
+    /// Indicates whether the block-sparse factorization of Jx*iM*Jx' is valid
+    bool _block_factor_valid;
+
+    /// The elimination ordering over joints for the block factorization
+    std::vector<unsigned> _elim_order;
+
+    /// The inverted pivot (diagonal) blocks of the block LDL' factorization
+    std::vector<Ravelin::MatrixNd> _pivot_inv;
+
+    /// For each joint, the joints that follow it in the elimination order
+    /// and couple to it with a nonzero factor block
+    std::vector<std::vector<unsigned> > _factor_nbrs;
+
+    /// The lower-triangular factor blocks L(i,p), ordered as _factor_nbrs
+    std::vector<std::vector<Ravelin::MatrixNd> > _factor_blocks;
+
     /// Constraint Jacobian
     SparseJacobian _Jx;
 
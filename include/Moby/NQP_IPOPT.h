@@ -17,15 +17,19 @@
 #include <Moby/LCP.h>
 #include <Moby/Event.h>
 #include <Moby/EventProblemData.h>
+#include <Moby/SolverStats.h>
 
 namespace Moby {
 
-/// Defines the mechanism for handling impact events 
-class NQP_IPOPT : public Ipopt::TNLP 
+/// Defines the mechanism for handling impact events
+class NQP_IPOPT : public Ipopt::TNLP
 {
   public:
     NQP_IPOPT();
 
+    /// Statistics accumulated over solves (reset by the caller as desired)
+    SolverStats stats;
+
     /// Particular solution (before optimization), final solution (after)
     Ravelin::VectorNd z;
 
@@ -66,7 +70,7 @@ class NQP_IPOPT : public Ipopt::TNLP
     virtual bool eval_g(Ipopt::Index n, const Ipopt::Number* x, bool new_x, Ipopt::Index m, Ipopt::Number* g);
     virtual bool eval_jac_g(Ipopt::Index n, const Ipopt::Number* x, bool new_x, Ipopt::Index m, Ipopt::Index nele_jac, Ipopt::Index* iRow, Ipopt::Index* jCol, Ipopt::Number* values);
     virtual bool eval_h(Ipopt::Index n, const Ipopt::Number* x, bool new_x, Ipopt::Number obj_factor, Ipopt::Index m, const Ipopt::Number* lambda, bool new_lambda, Ipopt::Index nele_hess, Ipopt::Index* iRow, Ipopt::Index* jCol, Ipopt::Number* values);
-    virtual void finalize_solution(Ipopt::SolverReturn status, Ipopt::Index n, const Ipopt::Number* x, const Ipopt::Number* z_L, const Ipopt::Number* z_U, Ipopt::Index, const Ipopt::Number* g, const Ipopt::Number* lambda, Ipopt::Number obj_value, const Ipopt::IpoptData* ip_data, Ipopt::IpoptCalculatedQuantities* ip_cq);
+    virtual void finalize_solution(Ipopt::SolverReturn status, Ipopt::Index n, const Ipopt::Number* x, const Ipopt::Number* z_L, const Ipopt::Number* z_U, Ipopt::Index m, const Ipopt::Number* g, const Ipopt::Number* lambda, Ipopt::Number obj_value, const Ipopt::IpoptData* ip_data, Ipopt::IpoptCalculatedQuantities* ip_cq);
 
     // tolerance for checking for zero
     double _ZERO_EPS;
@@ -107,6 +111,17 @@ class NQP_IPOPT : public Ipopt::TNLP
 
     // tolerance for the Coulomb friction and kappa constraints
     double _tol;
+
+    // problem dimensions for which the sparsity structures above were
+    // computed; get_nlp_info() reuses the structures when these match
+    unsigned _struct_n, _struct_m;
+    bool _struct_dense, _struct_valid;
+
+    // primal/dual iterates saved by finalize_solution() for warm starting
+    Ravelin::VectorNd _x_last, _zL_last, _zU_last, _lambda_last;
+
+    // whether the iterates above come from a successful solve
+    bool _warm_start_ready;
 }; // end class
 } // end namespace
 
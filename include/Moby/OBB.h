@@ -20,7 +20,7 @@
 #include <Moby/BV.h>
 #include <Moby/Constants.h>
 #include <Moby/Types.h>
-#include <Moby/FastThreadable.h>
+#include <Moby/ScratchArena.h>
 #include <Moby/CompGeom.h>
 //#include <Moby/TriangleMeshPrimitive.h>
 
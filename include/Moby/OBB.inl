@@ -586,8 +586,8 @@ OBB::OBB(ForwardIterator begin, ForwardIterator end)
 
   // determine the eigenvalues and eigenvectors of the covariance matrix
   Ravelin::Vector3d evals;
-  FastThreadable<Ravelin::LinAlgd> LA;
-  LA().eig_symm_plus(C, evals);
+  Ravelin::LinAlgd& LA = ScratchArena<Ravelin::LinAlgd>::global().view();
+  LA.eig_symm_plus(C, evals);
   
   // first eigenvector will be direction of minimum variance
   // but add all three eigenvectors
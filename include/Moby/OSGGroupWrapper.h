@@ -7,6 +7,7 @@
 #ifndef _OSG_GROUP_WRAPPER_H_
 #define _OSG_GROUP_WRAPPER_H_
 
+#include <Ravelin/Pose3d.h>
 #include <Moby/Base.h>
 
 namespace osg
@@ -27,6 +28,7 @@ class OSGGroupWrapper : public virtual Base
     ~OSGGroupWrapper();
     virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
     virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
+    void update_transform(const Ravelin::Pose3d& P);
     osg::Group* get_group() { return _group; }
 
   private:
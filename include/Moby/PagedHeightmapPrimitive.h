@@ -0,0 +1,97 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _PAGED_HEIGHTMAP_PRIMITIVE_H
+#define _PAGED_HEIGHTMAP_PRIMITIVE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <Moby/HeightmapPrimitive.h>
+
+namespace Moby {
+
+/// A heightmap whose height grid is paged in from disk in tiles
+/**
+ * A standard HeightmapPrimitive keeps its full height grid in core, which
+ * is untenable for world-scale terrains (a kilometer at centimeter
+ * resolution is 10^10 samples).  This primitive instead memory-maps a
+ * binary height file and treats the grid as square tiles of samples: a
+ * height query faults in only the pages of the tile it touches, and an LRU
+ * cache of resident tiles returns the least recently used tile's pages to
+ * the operating system once a residency limit is reached.  Because queries
+ * originate from collision checks against bodies, the resident set
+ * naturally tracks the terrain around active bodies.
+ *
+ * The backing file layout is native-endian binary: two 32-bit unsigned
+ * integers (rows, columns), two doubles (the minimum and maximum height,
+ * precomputed so the bounding volume needs no full scan), then
+ * rows*columns doubles of height samples in row-major order.
+ */
+class PagedHeightmapPrimitive : public HeightmapPrimitive
+{
+  public:
+    PagedHeightmapPrimitive();
+    PagedHeightmapPrimitive(const Ravelin::Pose3d& T);
+    virtual ~PagedHeightmapPrimitive();
+    virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
+    virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
+
+    /// Gets the number of currently resident tiles
+    unsigned num_resident_tiles() const { return _lru.size(); }
+
+  protected:
+    virtual double height(unsigned i, unsigned j) const;
+    virtual unsigned rows() const { return _rows; }
+    virtual unsigned columns() const { return _columns; }
+    virtual void calc_min_max_heights(double& miny, double& maxy) const { miny = _min_height; maxy = _max_height; }
+
+  private:
+    void open_height_file(const std::string& fname);
+    void close_height_file();
+    void touch_tile(unsigned ti, unsigned tj) const;
+    void release_tile(unsigned tile) const;
+
+    /// The backing height file
+    std::string _fname;
+
+    /// The backing file descriptor (-1 when no file is open)
+    int _fd;
+
+    /// The memory mapping of the backing file (NULL when no file is open)
+    void* _mapping;
+
+    /// The length of the mapping, in bytes
+    std::size_t _mapping_len;
+
+    /// The height samples within the mapping, in row-major order
+    const double* _samples;
+
+    /// The grid dimensions
+    unsigned _rows, _columns;
+
+    /// The height range recorded in the file header
+    double _min_height, _max_height;
+
+    /// The tile edge length, in samples
+    unsigned _tile_size;
+
+    /// The number of tiles along the column (z) direction
+    unsigned _tiles_per_row;
+
+    /// The maximum number of resident tiles
+    unsigned _max_resident;
+
+    /// The resident tiles, most recently used first (mutable: height queries are logically const)
+    mutable std::list<unsigned> _lru;
+
+    /// Maps resident tile indices to their positions in the LRU list
+    mutable std::map<unsigned, std::list<unsigned>::iterator> _resident;
+}; // end class
+
+} // end namespace
+
+#endif
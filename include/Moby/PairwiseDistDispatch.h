@@ -0,0 +1,55 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _PAIRWISE_DIST_DISPATCH_H
+#define _PAIRWISE_DIST_DISPATCH_H
+
+#include <map>
+#include <typeinfo>
+#include <boost/shared_ptr.hpp>
+#include <Moby/Types.h>
+
+namespace Moby {
+
+class Primitive;
+
+/// Direct-dispatch table for specialized primitive-pair signed distance kernels
+/**
+ * The virtual calc_signed_dist() implementations discover the dynamic type of
+ * the other primitive through a chain of dynamic_pointer_cast checks, which
+ * is run once per pair per narrow-phase query. This table maps a pair of
+ * dynamic primitive types straight to the specialized kernel those chains
+ * would eventually select, so a query costs one map lookup and one indirect
+ * call. CollisionGeometry::calc_signed_dist() consults the table first and
+ * falls back on the virtual chain for unregistered pairs, so the table only
+ * needs entries for the pairs with specialized kernels; plugins may register
+ * kernels for their own primitive types.
+ */
+class PairwiseDistDispatch
+{
+  public:
+    /// A signed distance kernel for a specific pair of dynamic primitive types
+    typedef double (*DistFn)(boost::shared_ptr<const Primitive> pA, boost::shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb);
+
+    static bool lookup(boost::shared_ptr<const Primitive> pA, boost::shared_ptr<const Primitive> pB, double& dist, Point3d& pa, Point3d& pb);
+    static void register_kernel(const std::type_info& tA, const std::type_info& tB, DistFn fn);
+
+  private:
+    typedef std::pair<const std::type_info*, const std::type_info*> TypePair;
+
+    /// Orders type pairs using std::type_info::before()
+    struct TypePairComp
+    {
+      bool operator()(const TypePair& a, const TypePair& b) const;
+    };
+
+    typedef std::map<TypePair, DistFn, TypePairComp> Table;
+    static Table& table();
+}; // end class
+
+} // end namespace
+
+#endif
@@ -13,11 +13,42 @@ namespace Moby {
 
 struct PairwiseDistInfo
 {
+  /// The narrow-phase path that produced the distance
+  enum NarrowPhaseAlg
+  {
+    eAlgNone,        // no query has been recorded
+    eAlgCulled,      // the batch GJK culling pass certified the pair as far
+    eAlgCertificate, // a cached separating-plane certificate held
+    eAlgReplay,      // the replay memo served a previously-recorded result
+    eAlgKernel,      // a specialized dispatch-table kernel resolved the query
+    eAlgVirtual      // the generic virtual dispatch chain resolved the query
+  };
+
+  /// Statistics for the last narrow-phase query on a pair
+  /**
+   * Filled by ConstraintSimulator::calc_pairwise_distances() so that the
+   * cost of individual geometry pairs can be observed in production (see
+   * ConstraintSimulator::get_top_narrow_phase_pairs()) without attaching an
+   * external profiler.
+   */
+  struct NarrowPhaseStats
+  {
+    NarrowPhaseStats() { reset(); }
+    void reset() { alg = eAlgNone; iterations = 0; kernel_hits = 0; kernel_misses = 0; query_time = 0.0; }
+
+    NarrowPhaseAlg alg;      // the path that produced the distance
+    unsigned iterations;     // level-of-detail requeries performed
+    unsigned kernel_hits;    // dispatch-table lookups that found a kernel
+    unsigned kernel_misses;  // lookups that fell back to virtual dispatch
+    double query_time;       // wall-clock seconds spent on the query
+  };
+
   CollisionGeometryPtr a;  // the first geometry
   CollisionGeometryPtr b;  // the second geometry
   double dist;             // the signed distance
   Point3d pa;              // the closest point on geometry A
   Point3d pb;              // the closest point on geometry B
+  NarrowPhaseStats stats;  // statistics for the last narrow-phase query
 }; // end struct
 
 } // end namespace
@@ -13,6 +13,7 @@
 namespace Moby {
 
 class CylinderPrimitive;
+class ConePrimitive;
 class SpherePrimitive;
 class BoxPrimitive;
 class PolyhedralPrimitive;
@@ -33,8 +34,11 @@ class PlanePrimitive : public Primitive
     virtual double calc_signed_dist(boost::shared_ptr<const Primitive> p, Point3d& pthis, Point3d& pp) const;
     double calc_signed_dist(boost::shared_ptr<const PolyhedralPrimitive> b, Point3d& pthis, Point3d& pb) const;
     double calc_signed_dist(boost::shared_ptr<const CylinderPrimitive> s, Point3d& pthis, Point3d& psph) const;
+    double calc_signed_dist(boost::shared_ptr<const ConePrimitive> c, Point3d& pthis, Point3d& pcone) const;
     double calc_signed_dist(boost::shared_ptr<const SpherePrimitive> s, Point3d& pthis, Point3d& psph) const;
     virtual double calc_signed_dist(const Point3d& p) const;
+    virtual void calc_signed_dists(const Point3d* points, unsigned n, double* dists) const;
+    virtual bool ray_cast(const Point3d& origin, const Ravelin::Vector3d& dir, double max_dist, double& t, Ravelin::Vector3d& normal) const;
     virtual osg::Node* create_visualization();
     virtual boost::shared_ptr<const IndexedTriArray> get_mesh(boost::shared_ptr<const Ravelin::Pose3d> P);
     virtual void calc_mass_properties() { _density.reset(); _J.set_zero(); }
@@ -23,14 +23,17 @@ class PolyhedralPrimitive : public Primitive
 {
   public:
 
-    PolyhedralPrimitive() : Primitive() { }
-    PolyhedralPrimitive(const Ravelin::Pose3d& T) : Primitive(T) { }
+    PolyhedralPrimitive() : Primitive() { _union_pending = false; }
+    PolyhedralPrimitive(const Ravelin::Pose3d& T) : Primitive(T) { _union_pending = false; }
     virtual double calc_signed_dist(boost::shared_ptr<const Primitive> p, Point3d& pthis, Point3d& pp) const;
     virtual double calc_dist_and_normal(const Point3d& p, std::vector<Ravelin::Vector3d>& normals) const;
     virtual osg::Node* create_visualization();
     virtual BVPtr get_BVH_root(CollisionGeometryPtr geom);
     virtual void set_polyhedron(const Polyhedron& p);
+    virtual unsigned long calc_memory_usage() const;
+    void set_union(boost::shared_ptr<const PolyhedralPrimitive> pA, boost::shared_ptr<const PolyhedralPrimitive> pB, const Ravelin::Transform3d& aTb);
     virtual void get_vertices(boost::shared_ptr<const Ravelin::Pose3d> P, std::vector<Point3d>& vertices) const;
+    virtual Point3d get_supporting_point(const Ravelin::Vector3d& d) const;
     virtual boost::shared_ptr<const IndexedTriArray> get_mesh(boost::shared_ptr<const Ravelin::Pose3d> P);
     virtual bool is_convex() const;
     virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
@@ -38,15 +41,16 @@ class PolyhedralPrimitive : public Primitive
     virtual void set_pose(const Ravelin::Pose3d& P);
 
     /// Gets the polyhedron corresponding to this primitive (in its transformed state)
-    const Polyhedron& get_polyhedron() const { return _poly; }
+    const Polyhedron& get_polyhedron() const { update_union(); return _poly; }
 
     // Gets the number of facets in this primitive
-    virtual unsigned num_facets() const { return _poly.get_faces().size();}
+    virtual unsigned num_facets() const { update_union(); return _poly.get_faces().size();}
 
     // Gets the bounding radius of this primitive
     virtual double get_bounding_radius() const
     {
       // get the vertices
+      update_union();
       const std::vector<boost::shared_ptr<Polyhedron::Vertex> >& verts = _poly.get_vertices();
       if (verts.empty())
         return 0.0;
@@ -65,7 +69,13 @@ class PolyhedralPrimitive : public Primitive
   protected:
     void calc_mass_properties();
     double calc_signed_dist(boost::shared_ptr<const PolyhedralPrimitive> p, Point3d& pthis, Point3d& pp) const;
+    void update_union() const;
     Polyhedron _poly;
+
+    /// Operands of a pending hull union (see set_union()); built on first query
+    boost::shared_ptr<const PolyhedralPrimitive> _union_opA, _union_opB;
+    Ravelin::Transform3d _union_aTb;
+    bool _union_pending;
 }; // end class
 
 #include "PolyhedralPrimitive.inl"
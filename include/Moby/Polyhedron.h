@@ -8,16 +8,17 @@
 #define _POLYHEDRON_H
 
 #include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/pool/pool_alloc.hpp>
 #include <Moby/Constants.h>
 #include <Moby/Plane.h>
 #include <Moby/Log.h>
 #include <Moby/NumericalException.h>
 
 // needed for qhull
-extern "C"
-{
-  #include <qhull/qhull_a.h>
-}
+#include <Moby/QhullContext.h>
 
 
 namespace Moby {
@@ -48,19 +49,37 @@ class Polyhedron
     /// The face structure
     struct Face : public boost::enable_shared_from_this<Face>, public Feature
     {
+      Face() : _plane_cached(false) {}
       virtual ~Face() {}
-      std::list<boost::weak_ptr<Edge> > e; // edges coincident to this face (ccw ordering) 
+      std::list<boost::weak_ptr<Edge> > e; // edges coincident to this face (ccw ordering)
       Plane get_plane() const;
       boost::shared_ptr<void> data;                // arbitrary user data
+
+      private:
+        friend class Polyhedron;
+
+        // the plane containing the face, cached on first computation (the
+        // face geometry is static once the topology has been built)
+        mutable Plane _plane;
+        mutable bool _plane_cached;
     };
 
     /// The edge structure
     struct Edge : public boost::enable_shared_from_this<Edge>, public Feature
     {
+      Edge() : _dir_cached(false) {}
       virtual ~Edge() {}
-      boost::shared_ptr<Vertex> v1, v2; // vertices of this edge 
-      boost::shared_ptr<Face> face1, face2;   // faces coincident to this edge 
+      boost::shared_ptr<Vertex> v1, v2; // vertices of this edge
+      boost::shared_ptr<Face> face1, face2;   // faces coincident to this edge
+      const Ravelin::Origin3d& get_direction() const;
       boost::shared_ptr<void> data;                // arbitrary user data
+
+      private:
+        friend class Polyhedron;
+
+        // the unit direction from v1 to v2, cached on first computation
+        mutable Ravelin::Origin3d _dir;
+        mutable bool _dir_cached;
     };
 
     // iterates over the vertices in a face
@@ -82,10 +101,27 @@ class Polyhedron
 
     enum LocationType { eInside, eOutside, eOnVertex, eOnEdge, eOnFace };  
 
+    /// Allocates a polyhedron feature (Vertex, Edge, or Face) from a per-type memory pool
+    /**
+     * Features (and their shared_ptr control blocks) are carved out of large
+     * contiguous pool chunks rather than individually heap allocated, which
+     * avoids fragmenting the heap and keeps signed-distance and V-clip walks
+     * over the topology cache friendly in scenes with thousands of convex
+     * pieces. Handles remain ordinary shared_ptrs, so iterator and user code
+     * (e.g., VertexFaceIterator) is unaffected.
+     */
+    template <class T>
+    static boost::shared_ptr<T> create_feature()
+    {
+      return boost::allocate_shared<T>(boost::fast_pool_allocator<T>());
+    }
+
+
     Polyhedron();
-    Polyhedron(const Polyhedron& p) { _convexity_computed = false; operator=(p); }
+    Polyhedron(const Polyhedron& p) { _convexity_computed = false; _derived_computed = false; operator=(p); }
     static double vclip(boost::shared_ptr<const PolyhedralPrimitive> pA, boost::shared_ptr<const PolyhedralPrimitive> pB, boost::shared_ptr<const Ravelin::Pose3d> poseA, boost::shared_ptr<const Ravelin::Pose3d> poseB, boost::shared_ptr<const Polyhedron::Feature>& closestA, boost::shared_ptr<const Polyhedron::Feature>& closestB);
-    static Polyhedron calc_minkowski_diff(boost::shared_ptr<const PolyhedralPrimitive> pA, boost::shared_ptr<const PolyhedralPrimitive> pB, boost::shared_ptr<const Ravelin::Pose3d> poseA, boost::shared_ptr<const Ravelin::Pose3d> poseB); 
+    static Polyhedron calc_minkowski_diff(boost::shared_ptr<const PolyhedralPrimitive> pA, boost::shared_ptr<const PolyhedralPrimitive> pB, boost::shared_ptr<const Ravelin::Pose3d> poseA, boost::shared_ptr<const Ravelin::Pose3d> poseB);
+    static Polyhedron calc_union(const Polyhedron& pA, const Polyhedron& pB, const Ravelin::Transform3d& aTb);
 /*
     double find_closest_features(const Ravelin::Origin3d& p, std::list<boost::shared_ptr<Feature> >& closest_features, bool& inside) const;
 */
@@ -126,7 +162,24 @@ class Polyhedron
      * zero) indicate that the polyhedron is convex; greater values indicate
      * that the polyhedron is non-convex.
      */ 
-    double convexity() { if (!_convexity_computed) determine_convexity(); return _convexity; } 
+    double convexity() { if (!_convexity_computed) determine_convexity(); return _convexity; }
+
+    /// Determines whether the convexity measure has already been computed
+    bool convexity_computed() const { return _convexity_computed; }
+
+    /// Sets the convexity measure directly (for deserializing precomputed data)
+    void set_convexity(double cx) { _convexity = cx; _convexity_computed = true; }
+
+    /// Gets the planes containing the faces, packed in face order
+    const std::vector<Plane>& get_face_planes() { if (!_derived_computed) calc_derived_data(); return _face_planes; }
+
+    /// Gets the unit edge directions (from v1 to v2), packed in edge order
+    const std::vector<Ravelin::Origin3d>& get_edge_directions() { if (!_derived_computed) calc_derived_data(); return _edge_dirs; }
+
+    std::pair<const unsigned*, const unsigned*> get_vertex_neighbors(unsigned vidx);
+    unsigned find_extreme_vertex(const Ravelin::Origin3d& dir);
+    void calc_derived_data();
+    void invalidate_derived_data();
 
     /// Gets the Voronoi plane from two input features
     /**
@@ -165,6 +218,22 @@ class Polyhedron
     double _convexity;
     bool _convexity_computed;
 
+    // derived per-face/per-edge/per-vertex data, packed in feature order and
+    // computed once (see calc_derived_data())
+    bool _derived_computed;
+    std::vector<Plane> _face_planes;
+    std::vector<Ravelin::Origin3d> _edge_dirs;
+    std::vector<unsigned> _vertex_adj;        // vertex adjacency, CSR packed
+    std::vector<unsigned> _vertex_adj_begin;  // per-vertex offsets into _vertex_adj
+
+    // the Gauss map: a cube map over directions whose cells store the index
+    // of the vertex supporting the cell center direction (see
+    // find_extreme_vertex())
+    enum { GAUSS_MAP_RES = 8 };
+    std::vector<unsigned> _gauss_map;
+    static unsigned gauss_map_cell(const Ravelin::Origin3d& dir);
+    unsigned climb_to_support(unsigned start, const Ravelin::Origin3d& dir);
+
     std::vector<boost::shared_ptr<Vertex> > _vertices;
     std::vector<boost::shared_ptr<Face> > _faces;
     std::vector<boost::shared_ptr<Edge> > _edges;
@@ -35,7 +35,7 @@ else if ((vei = v_edges.find(std::make_pair(vB, vA))) != v_edges.end()) \
 } \
 else \
 { \
-  eAB = boost::shared_ptr<Polyhedron::Edge>(new Polyhedron::Edge); \
+  eAB = Polyhedron::create_feature<Polyhedron::Edge>(); \
   v_edges[std::make_pair(vA, vB)] = eAB; \
   if (cw) \
     eAB->face1 = f; \
@@ -64,7 +64,7 @@ Polyhedron Polyhedron::calc_convex_hull(ForwardIterator begin, ForwardIterator e
   std::vector<boost::shared_ptr<Polyhedron::Vertex> > verts;
   while (begin != end)
   {
-    verts.push_back(boost::shared_ptr<Polyhedron::Vertex>(new Polyhedron::Vertex));
+    verts.push_back(Polyhedron::create_feature<Polyhedron::Vertex>());
     verts.back()->o = Ravelin::Origin3d(*begin);
     begin++;
   }
@@ -106,8 +106,12 @@ Polyhedron Polyhedron::calc_convex_hull(ForwardIterator begin, ForwardIterator e
     qhull_points[j++] = verts[i]->o[Z];
   }
 
-  // execute qhull  
-  exit_code = qh_new_qhull(DIM, N_POINTS, points_begin, IS_MALLOC, flags, outfile, errfile);
+  // acquire a qhull context (the global mutex for classic qhull; a local
+  // context when building against reentrant qhull)
+  QHULL_INIT_CONTEXT(errfile);
+
+  // execute qhull
+  exit_code = QHULL_NEW_QHULL(DIM, N_POINTS, points_begin, IS_MALLOC, flags, outfile, errfile);
   if (exit_code != 0)
   {
     // points are not collinear.. unsure of the error...
@@ -116,8 +120,11 @@ Polyhedron Polyhedron::calc_convex_hull(ForwardIterator begin, ForwardIterator e
       FILE_LOG(LOG_COMPGEOM) << "  " << verts[i] << std::endl;
 
     // free qhull memory
-    qh_freeqhull(!qh_ALL);
-    qh_memfreeshort(&curlong, &totlong);
+    QHULL_FREEQHULL();
+    QHULL_MEMFREESHORT(&curlong, &totlong);
+
+    // release the qhull context
+    QHULL_RELEASE_CONTEXT();
 
     // close the error stream, if necessary
     if (!LOGGING(LOG_COMPGEOM))
@@ -141,13 +148,13 @@ Polyhedron Polyhedron::calc_convex_hull(ForwardIterator begin, ForwardIterator e
   if (LOGGING(LOG_COMPGEOM))
   {
     // triangulation may or may not be disabled...
-    qh_triangulate();
+    QHULL_TRIANGULATE();
     for (unsigned i=0; i< poly._vertices.size(); i++)
       FILE_LOG(LOG_COMPGEOM) << "vertex " << i << ": " << poly._vertices[i]->o << std::endl;
   }
 
   // TODO: remove this when we can handle non-simplicial facets
-  qh_triangulate();
+  QHULL_TRIANGULATE();
 
   // need maps for new edges created for simplicial and non-simplicial facets
   std::map<std::pair<vertexT*, vertexT*>, boost::shared_ptr<Polyhedron::Edge> > v_edges;
@@ -157,13 +164,13 @@ Polyhedron Polyhedron::calc_convex_hull(ForwardIterator begin, ForwardIterator e
   std::map<std::pair<vertexT*, vertexT*>, boost::shared_ptr<Polyhedron::Edge> >::const_iterator vei;
   
   // iterate through facets
-  for (facetT* facet=qh facet_list;facet && facet->next;facet=facet->next)
+  for (facetT* facet=QH(facet_list);facet && facet->next;facet=facet->next)
   {
     if (!facet->vertices)
       continue;
 
     // create a new facet
-    boost::shared_ptr<Polyhedron::Face> f(new Polyhedron::Face);
+    boost::shared_ptr<Polyhedron::Face> f = Polyhedron::create_feature<Polyhedron::Face>();
 
     // see whether the facet is simplicial- it changes how we must process
     // edges
@@ -222,7 +229,7 @@ Polyhedron Polyhedron::calc_convex_hull(ForwardIterator begin, ForwardIterator e
         if (new_edge_iter == r_edges.end())
         {
           // create an edge and add it to the map
-          e = boost::shared_ptr<Polyhedron::Edge>(new Polyhedron::Edge);
+          e = Polyhedron::create_feature<Polyhedron::Edge>();
           poly._edges.push_back(e);
           r_edges[ridge] = e;
 
@@ -345,8 +352,11 @@ Polyhedron Polyhedron::calc_convex_hull(ForwardIterator begin, ForwardIterator e
   }
 
   // free qhull memory
-  qh_freeqhull(!qh_ALL);
-  qh_memfreeshort(&curlong, &totlong);
+  QHULL_FREEQHULL();
+  QHULL_MEMFREESHORT(&curlong, &totlong);
+
+  // release the qhull context
+  QHULL_RELEASE_CONTEXT();
 
   // close the error stream, if necessary
   if (!LOGGING(LOG_COMPGEOM))
@@ -54,10 +54,16 @@ class Primitive : public virtual Base
     virtual void set_pose(const Ravelin::Pose3d& T);
     virtual Point3d get_supporting_point(const Ravelin::Vector3d& d) const;
     virtual double calc_signed_dist(const Point3d& p) const;
+    virtual void calc_signed_dists(const Point3d* points, unsigned n, double* dists) const;
+    virtual bool ray_cast(const Point3d& origin, const Ravelin::Vector3d& dir, double max_dist, double& t, Ravelin::Vector3d& normal) const;
+    virtual void ray_cast(const Point3d* origins, const Ravelin::Vector3d* dirs, unsigned n, double max_dist, double* t, Ravelin::Vector3d* normals) const;
     void add_collision_geometry(CollisionGeometryPtr cg);
     void remove_collision_geometry(CollisionGeometryPtr cg);
     boost::shared_ptr<const Ravelin::Pose3d> get_pose(CollisionGeometryPtr g) const;
-    virtual double get_bounding_radius() const = 0; 
+    virtual double get_bounding_radius() const = 0;
+    static void begin_calc_mass_properties_batch();
+    static void end_calc_mass_properties_batch();
+    virtual unsigned long calc_memory_usage() const;
 
     /// Computes the maximum distance by a point on the geometry
     virtual double calc_max_dist(double lin_cont, double ang_cont, double dist, const Ravelin::Vector3d& d0, const Ravelin::Vector3d& w0, boost::shared_ptr<const Ravelin::Pose3d> P)
@@ -98,6 +104,7 @@ class Primitive : public virtual Base
 
   protected:
     virtual void calc_mass_properties() = 0;
+    bool defer_calc_mass_properties();
 
     /// The pose of this primitive (relative to the global frame)
     boost::shared_ptr<Ravelin::Pose3d> _F;
@@ -121,6 +128,12 @@ class Primitive : public virtual Base
 
   private:
 
+    /// Whether mass-property computations are currently batched
+    static bool _mass_props_batch_active;
+
+    /// Primitives whose mass-property computations have been deferred
+    static std::vector<Primitive*> _mass_props_batch;
+
     /// The visualization transform (possibly NULL)
     osg::MatrixTransform* _vtransform;
 
@@ -18,6 +18,7 @@ class QLCPD
 {
   public:
     QLCPD();
+    void release_transient_memory();
 
   template <class Mat1, class Vec1, class Vec2, class Vec3, class Mat2, class Vec4, class Mat3, class Vec5, class Vec6>
   bool qp_activeset(const Mat1& H, const Vec1& c, const Vec2& lb, const Vec3& ub, const Mat2& M, const Vec4& q, const Mat3& A, const Vec5& b, Vec6& z);
@@ -42,6 +43,9 @@ class QLCPD
     // sets values for QLCPD
     void set_values(int n, int m);
 
+    // sizes the solver workspaces (retained at their high-water mark)
+    void setup_workspaces(int nm, int mlp, int maxg);
+
     // workspace sizes for active set solver
     int _mxws, _mxlws;
 
@@ -84,27 +84,17 @@ bool QLCPD::qp_activeset(const Mat1& H, const Vec1& c, const Vec2& lb, const Vec
   int nout = 0;      // "channel" for output (stdout?)
   int ifail = 0;
 
-  // setup workspaces
-  _r.resize(n+m);
-  _w.resize(n+m);
-  _e.resize(n+m);
-  _alp.resize(n+m);
-
-  // setup linear workspaces
-  _ls.resize(n+m);
-  _lp.resize(mlp);
+  // setup workspaces (retained at their high-water mark across solves)
+  setup_workspaces(n+m, mlp, maxg);
 
   // setup other miscellaneous variables
   int peq = 0;  // pointer to end of equality constraint indices in ls
 
   // initial estimates of eigenvalues of Hessian
   int nv = 1;
-  _v.resize(maxg);
   _v[0] = 1.0;
 
-  // setup workspace
-  _ws.resize(_mxws);
-  _lws.resize(_mxlws);
+  // copy the scaled problem into the Fortran workspace
   std::copy(c.column_iterator_begin(), c.column_iterator_end(), _ws.begin());
   std::copy(H.column_iterator_begin(), H.column_iterator_end(), _ws.begin()+n);
 
@@ -254,28 +244,16 @@ bool QLCPD::find_closest_feasible(const Vec1& lb, const Vec2& ub, const Mat1& M,
   int nout = 0;      // "channel" for output (stdout?)
   int ifail = 0;
 
-  // setup workspaces
-  _r.resize(n+m+1);
-  _w.resize(n+m+1);
-  _e.resize(n+m+1);
-  _alp.resize(n+m+1);
-
-  // setup linear workspaces
-  _ls.resize(n+m+1);
-  _lp.resize(mlp);
+  // setup workspaces (retained at their high-water mark across solves)
+  setup_workspaces(n+m+1, mlp, maxg);
 
   // setup other miscellaneous variables
   int peq = 0;  // pointer to end of equality constraint indices in ls
 
   // initial estimates of eigenvalues of Hessian
   int nv = 1;
-  _v.resize(maxg);
   _v[0] = 1.0;
 
-  // setup workspace
-  _ws.resize(_mxws);
-  _lws.resize(_mxlws);
-
   // resize the gradient
   _g.resize(n+1);
 
@@ -413,27 +391,17 @@ bool QLCPD::lp_activeset(const Vec1& c, const Vec2& lb, const Vec3& ub, const Ma
   int nout = 0;      // "channel" for output (stdout?)
   int ifail = 0;
 
-  // setup workspaces
-  _r.resize(n+m);
-  _w.resize(n+m);
-  _e.resize(n+m);
-  _alp.resize(n+m);
-
-  // setup linear workspaces
-  _ls.resize(n+m);
-  _lp.resize(mlp);
+  // setup workspaces (retained at their high-water mark across solves)
+  setup_workspaces(n+m, mlp, maxg);
 
   // setup other miscellaneous variables
   int peq = 0;  // pointer to end of equality constraint indices in ls
 
   // initial estimates of eigenvalues of Hessian
   int nv = 1;
-  _v.resize(maxg);
   _v[0] = 1.0;
 
-  // setup workspace
-  _ws.resize(_mxws);
-  _lws.resize(_mxlws);
+  // copy the scaled problem into the Fortran workspace
   std::copy(c.column_iterator_begin(), c.column_iterator_end(), _ws.begin());
 
   // resize the gradient
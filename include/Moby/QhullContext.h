@@ -0,0 +1,91 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _MOBY_QHULL_CONTEXT_H
+#define _MOBY_QHULL_CONTEXT_H
+
+/// Adapter layer over the classic and reentrant qhull APIs
+/**
+ * The classic qhull library keeps all of its state in a global structure,
+ * so every hull computation in the process must be serialized through a
+ * single mutex.  The reentrant library (libqhull_r) threads an explicit
+ * context (qhT*) through every call instead, which lets each thread build
+ * hulls concurrently.  Unfortunately, the two headers define conflicting
+ * types, so a build must pick one API or the other; defining
+ * MOBY_QHULL_REENTRANT selects the reentrant library.
+ *
+ * Code that uses qhull should bracket its qhull calls with
+ * QHULL_INIT_CONTEXT(errfile) / QHULL_RELEASE_CONTEXT() and use the macros
+ * below in place of the corresponding qhull functions; member accesses on
+ * the (implicit or explicit) context go through QH(member).  The
+ * FORALLvertices / FORALLfacets style iteration macros work unmodified in
+ * both modes: in reentrant mode QHULL_INIT_CONTEXT() declares a local
+ * variable named 'qh' that those macros pick up.
+ */
+
+#ifdef MOBY_QHULL_REENTRANT
+
+// needed for qhull
+extern "C"
+{
+  #include <libqhull_r/qhull_ra.h>
+}
+
+// setup a local context; the name 'qh' lets qhull's iteration macros work
+#define QHULL_INIT_CONTEXT(errfile) \
+  qhT _qh_context; \
+  qhT* const qh = &_qh_context; \
+  qh_zero(qh, errfile)
+#define QHULL_RELEASE_CONTEXT() ((void) 0)
+#define QHULL_NEW_QHULL(dim, n, points, is_malloc, flags, outfile, errfile) \
+  qh_new_qhull(qh, dim, n, points, is_malloc, flags, outfile, errfile)
+#define QHULL_FREEQHULL() qh_freeqhull(qh, !qh_ALL)
+#define QHULL_MEMFREESHORT(pcurlong, ptotlong) \
+  qh_memfreeshort(qh, pcurlong, ptotlong)
+#define QHULL_TRIANGULATE() qh_triangulate(qh)
+#define QHULL_MEMALLOC(size) qh_memalloc(qh, size)
+#define QHULL_MEMFREE(object, size) qh_memfree(qh, object, size)
+#define QH(member) (qh->member)
+
+#else // classic (non-reentrant) qhull
+
+#ifdef THREADSAFE
+#include <pthread.h>
+#endif
+
+// needed for qhull
+extern "C"
+{
+  #include <qhull/qhull_a.h>
+}
+
+namespace Moby {
+#ifdef THREADSAFE
+extern pthread_mutex_t _qhull_mutex;
+#endif
+} // end namespace
+
+// serialize access to qhull's global state
+#ifdef THREADSAFE
+#define QHULL_INIT_CONTEXT(errfile) pthread_mutex_lock(&Moby::_qhull_mutex)
+#define QHULL_RELEASE_CONTEXT() pthread_mutex_unlock(&Moby::_qhull_mutex)
+#else
+#define QHULL_INIT_CONTEXT(errfile) ((void) (errfile))
+#define QHULL_RELEASE_CONTEXT() ((void) 0)
+#endif
+#define QHULL_NEW_QHULL(dim, n, points, is_malloc, flags, outfile, errfile) \
+  qh_new_qhull(dim, n, points, is_malloc, flags, outfile, errfile)
+#define QHULL_FREEQHULL() qh_freeqhull(!qh_ALL)
+#define QHULL_MEMFREESHORT(pcurlong, ptotlong) \
+  qh_memfreeshort(pcurlong, ptotlong)
+#define QHULL_TRIANGULATE() qh_triangulate()
+#define QHULL_MEMALLOC(size) qh_memalloc(size)
+#define QHULL_MEMFREE(object, size) qh_memfree(object, size)
+#define QH(member) (qh member)
+
+#endif // MOBY_QHULL_REENTRANT
+
+#endif
@@ -50,16 +50,41 @@ class RCArticulatedBody : public virtual ArticulatedBody, public virtual Ravelin
     virtual Ravelin::MatrixNd& calc_jacobian(const Point3d& point, const Ravelin::Pose3d& base_pose, const std::map<JointPtr, Ravelin::VectorNd>& q, RigidBodyPtr link, Ravelin::MatrixNd& J);
 */
     RCArticulatedBodyPtr clone() const;
+    virtual void calc_fwd_dyn();
     virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
     virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
     virtual void set_links_and_joints(const std::vector<RigidBodyPtr>& links, const std::vector<JointPtr>& joints);
     virtual void apply_generalized_impulse(const Ravelin::SharedVectorNd& gj);
+    void calc_inv_dyn_batch(const std::vector<Ravelin::VectorNd>& q, const std::vector<Ravelin::VectorNd>& qd, const std::vector<Ravelin::VectorNd>& qdd, std::vector<Ravelin::VectorNd>& tau);
+    virtual Ravelin::MatrixNd& get_generalized_inertia(Ravelin::MatrixNd& M);
+    virtual Ravelin::VectorNd& solve_generalized_inertia(const Ravelin::VectorNd& b, Ravelin::VectorNd& x);
+    virtual Ravelin::MatrixNd& solve_generalized_inertia(const Ravelin::MatrixNd& B, Ravelin::MatrixNd& X);
+    void invalidate_jsim_cache();
+
+    /// Configuration drift (inf-norm) under which the cached joint-space inertia matrix is reused (default = 0: reuse only at an identical configuration)
+    double jsim_staleness_tol;
+
+    /// The step size the implicit joint friction and damping solve integrates over (set by the simulator before each forward dynamics computation; zero falls back to the standard, frictionless solve)
+    double joint_friction_dt;
 
   protected:
      virtual void compile();
 
   private:
     RCArticulatedBody(const RCArticulatedBody& rcab) {}
+    bool jsim_cache_fresh();
+    bool update_jsim_factorization();
+
+    // cached joint-space inertia matrix, its Cholesky factorization, and the
+    // configuration at which both were computed (see jsim_staleness_tol)
+    Ravelin::MatrixNd _jsim, _jsim_chol;
+    Ravelin::VectorNd _jsim_q, _jsim_qwork;
+    bool _jsim_valid, _jsim_chol_valid;
+
+    // workspaces for the implicit joint friction/damping solve (see
+    // calc_fwd_dyn()), reused across steps
+    Ravelin::MatrixNd _fric_M, _fric_A;
+    Ravelin::VectorNd _fric_a0, _fric_v, _fric_D, _fric_rhs;
 }; // end class
 
 } // end namespace
@@ -27,7 +27,21 @@ class RecurrentForce : public virtual Base
     virtual ~RecurrentForce() { }
     
     /// Abstract method for applying this force/torque to a body
-    virtual void add_force(boost::shared_ptr<Ravelin::DynamicBodyd> body) = 0;  
+    virtual void add_force(boost::shared_ptr<Ravelin::DynamicBodyd> body) = 0;
+
+    /// Applies this force/torque to a batch of bodies at once
+    /**
+     * The default implementation dispatches add_force() per body.
+     * Subclasses whose force law is independent across bodies (drag,
+     * damping, gravity) override this to apply the whole batch in one
+     * pass, avoiding per-body virtual dispatch and enabling the bodies
+     * to be processed in parallel.
+     */
+    virtual void add_force_batch(const std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> >& bodies)
+    {
+      for (unsigned i=0; i< bodies.size(); i++)
+        add_force(bodies[i]);
+    }
 }; // end class
 
 } // end namespace Moby
@@ -54,6 +54,9 @@ class RigidBody : public virtual Ravelin::RigidBodyd, public virtual ControlledB
     virtual ~RigidBody() {}
 
     virtual void set_visualization_data(osg::Node* vdata) { Visualizable::set_visualization_data(vdata); }
+    virtual void set_pose(const Ravelin::Pose3d& pose);
+    virtual void update_visualization();
+    void invalidate_pose();
 
     virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
     virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
@@ -74,16 +77,41 @@ class RigidBody : public virtual Ravelin::RigidBodyd, public virtual ControlledB
     template <class OutputIterator>
     OutputIterator get_child_links(OutputIterator begin) const;
 
+    /// Gets whether the body is asleep (deactivated)
+    bool is_asleep() const { return _asleep; }
+
+    void put_to_sleep();
+    void wake();
+    bool update_sleep_timer(double h);
+
     /// Collision geometries, if any, for this rigid body
     std::list<CollisionGeometryPtr> geometries;
 
     /// Compliance value, determines event type
     Compliance compliance;
 
+    /// Linear velocity magnitude below which the body may sleep (default = 1e-2)
+    double sleep_linear_vel_thresh;
+
+    /// Angular velocity magnitude below which the body may sleep (default = 1e-2)
+    double sleep_angular_vel_thresh;
+
+    /// Time the velocity must remain below the sleep thresholds before the body may sleep (default = 0.5)
+    double sleep_time_thresh;
+
   private:
     RigidBodyPtr get_parent_link(boost::shared_ptr<Ravelin::Jointd> j) const;
     RigidBodyPtr get_child_link(boost::shared_ptr<Ravelin::Jointd> j) const;
 
+    /// Whether the body is asleep
+    bool _asleep;
+
+    /// Time the body's velocity has remained below the sleep thresholds
+    double _sleep_timer;
+
+    /// Whether the visualization transform is out of date
+    bool _viz_pose_stale;
+
 #ifdef USE_OSG
     osg::Node * inertia_viz;
 #endif
@@ -33,8 +33,9 @@ class SDFReader
     
   private:
     enum TupleType { eNone, eVectorN, eVector3, eQuat };
-    static std::vector<boost::shared_ptr<Primitive> > _primitives; 
-    static std::vector<boost::shared_ptr<OSGGroupWrapper> > _osg_wrappers; 
+    static std::vector<boost::shared_ptr<Primitive> > _primitives;
+    static std::vector<boost::shared_ptr<OSGGroupWrapper> > _osg_wrappers;
+    static std::map<std::string, boost::shared_ptr<Primitive> > _cooked_meshes;
 
     struct SurfaceData
     {
@@ -45,6 +46,7 @@ class SDFReader
     };
 
     static void read_surface(boost::shared_ptr<const XMLTree> node, boost::shared_ptr<SurfaceData>& sd);
+    static void cook_meshes(boost::shared_ptr<const XMLTree> world_tree);
     static boost::shared_ptr<TimeSteppingSimulator> read_world(boost::shared_ptr<const XMLTree> node);
     static std::vector<ControlledBodyPtr> read_models(boost::shared_ptr<const XMLTree> node, boost::shared_ptr<TimeSteppingSimulator> sim);
     static std::string read_string(boost::shared_ptr<const XMLTree> node);
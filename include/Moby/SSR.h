@@ -17,7 +17,7 @@
 #include <Ravelin/AAngled.h>
 #include <Moby/BV.h>
 #include <Moby/Constants.h>
-#include <Moby/FastThreadable.h>
+#include <Moby/ScratchArena.h>
 #include <Moby/Types.h>
 #include <Moby/CompGeom.h>
 
@@ -117,8 +117,8 @@ SSR::SSR(ForwardIterator begin, ForwardIterator end)
 
     // determine the eigenvalues and eigenvectors of the covariance matrix
     Ravelin::Vector3d evals;
-    FastThreadable<Ravelin::LinAlgd> LA;
-    LA().eig_symm_plus(C, evals);
+    Ravelin::LinAlgd& LA = ScratchArena<Ravelin::LinAlgd>::global().view();
+    LA.eig_symm_plus(C, evals);
     
     // first eigenvector will be direction of minimum variance; that's the
     // one that we want to align with
@@ -0,0 +1,69 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _MOBY_SCRATCH_ARENA_H_
+#define _MOBY_SCRATCH_ARENA_H_
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <vector>
+
+namespace Moby {
+
+/// Centralized, preallocated per-worker scratch storage
+/**
+ * Supersedes FastThreadable for internal use. FastThreadable instances
+ * declared inside hot functions reallocate their per-thread storage on
+ * every call; a ScratchArena is constructed once per type for the whole
+ * process, with one scratch object per worker allocated up front (sized
+ * by the maximum OpenMP team size), so first-touch allocation never
+ * happens inside a hot loop. Callers bind a typed view (a plain reference
+ * to this worker's slot) once at function entry and use it thereafter,
+ * rather than re-querying the worker index on every access.
+ */
+template <class T>
+class ScratchArena
+{
+  public:
+    /// Gets the process-wide arena for type T
+    static ScratchArena& global()
+    {
+      static ScratchArena arena;
+      return arena;
+    }
+
+    /// Gets the calling worker's scratch object
+    /**
+     * The returned reference is only valid on the worker that requested it;
+     * bind it once at function entry and do not pass it across threads.
+     */
+    T& view()
+    {
+      #ifdef _OPENMP
+      return _x[omp_get_thread_num()];
+      #else
+      return _x.front();
+      #endif
+    }
+
+  private:
+    ScratchArena()
+    {
+      #ifdef _OPENMP
+      _x.resize(omp_get_max_threads());
+      #else
+      _x.resize(1);
+      #endif
+    }
+
+    /// One scratch object per worker, allocated at arena construction
+    std::vector<T> _x;
+};
+
+} // end namespace
+
+#endif
@@ -0,0 +1,75 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _SIMULATION_STAGE_H
+#define _SIMULATION_STAGE_H
+
+#include <set>
+#include <string>
+
+namespace Moby {
+
+class Simulator;
+
+/// One stage of the simulator stepping pipeline
+/**
+ * A stage is a named unit of per-step work with declared read and write
+ * sets over coarse simulation state fields (e.g., "pose", "velocity",
+ * "force", "contact-candidates").  Simulator::step() executes its pipeline
+ * of stages in order through a scheduler that runs consecutive
+ * non-conflicting stages concurrently (see Simulator::run_pipeline()); the
+ * built-in collision, dynamics, and constraint phases are themselves
+ * stages, so user stages (e.g., fluid coupling or cable models) are
+ * inserted into the same sequence via Simulator::insert_stage_before() /
+ * insert_stage_after() and parallelized by the same machinery.  The
+ * wildcard field "*" conflicts with every field and marks a stage that
+ * must run alone.
+ */
+class SimulationStage
+{
+  public:
+    SimulationStage(const std::string& stage_name) : name(stage_name) {}
+    virtual ~SimulationStage() {}
+
+    /// Executes the stage's work for one step of size dt
+    virtual void execute(Simulator* s, double dt) = 0;
+
+    bool conflicts_with(const SimulationStage& s) const;
+
+    /// The stage name (used to address insertion points)
+    const std::string name;
+
+    /// The state fields the stage reads
+    std::set<std::string> reads;
+
+    /// The state fields the stage writes
+    std::set<std::string> writes;
+}; // end class
+
+/// A stage that forwards to a member function of a simulator class
+/**
+ * Lets the simulator classes expose their existing phase methods as
+ * built-in pipeline stages without widening their access: the member
+ * pointer is formed inside the owning class (where protected access is
+ * available) and only invoked here.
+ */
+template <class S>
+class MemberFnStage : public SimulationStage
+{
+  public:
+    typedef void (S::*PhaseFn)(double dt);
+
+    MemberFnStage(const std::string& stage_name, S* sim, PhaseFn fn) : SimulationStage(stage_name) { _sim = sim; _fn = fn; }
+    virtual void execute(Simulator* s, double dt) { (_sim->*_fn)(dt); }
+
+  private:
+    S* _sim;
+    PhaseFn _fn;
+}; // end class
+
+} // end namespace
+
+#endif
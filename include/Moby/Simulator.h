@@ -8,15 +8,21 @@
 #define _SIMULATOR_H
 
 #include <sys/times.h>
+#ifdef THREADSAFE
+#include <pthread.h>
+#endif
 #include <list>
 #include <map>
 #include <set>
 #include <boost/shared_ptr.hpp>
 
+#include <Ravelin/SparseMatrixNd.h>
 #include <Moby/Base.h>
 #include <Moby/Log.h>
+#include <Moby/StepProfiler.h>
 #include <Moby/RigidBody.h>
 #include <Moby/ArticulatedBody.h>
+#include <Moby/SpatialVectorSlab.h>
 
 namespace osg { 
   class Node;
@@ -30,6 +36,7 @@ class RigidBody;
 class ArticulatedBody;
 class RCArticulatedBody;
 class VisualizationData;
+class SimulationStage;
 
 /// Simulator for both unarticulated and articulated rigid bodies without contact
 /**
@@ -48,12 +55,47 @@ class Simulator : public virtual Base
     Simulator();
     virtual ~Simulator(); 
     virtual double step(double step_size);
+    static void step_ensemble(const std::vector<boost::shared_ptr<Simulator> >& sims, double step_size, unsigned nsteps = 1);
+    void partition_islands(unsigned ndomains, std::vector<std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> > >& domains);
     ControlledBodyPtr find_dynamic_body(const std::string& name) const;
     void add_dynamic_body(ControlledBodyPtr body);
     void remove_dynamic_body(ControlledBodyPtr body);
     void update_visualization();
+    void snapshot_visualization();
+    void apply_visualization_snapshot();
     virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
-    virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);  
+    virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
+    void save_checkpoint(const std::string& fname);
+    void restore_checkpoint(const std::string& fname);
+    void push_state_snapshot();
+    void restore_state_snapshot();
+    void pop_state_snapshot(bool restore = true);
+    double step_with_jacobian(double step_size);
+
+    /// Gets the step Jacobian computed by the last call to step_with_jacobian()
+    const Ravelin::SparseMatrixNd& get_step_jacobian() const { return _step_jacobian; }
+    bool open_shm_cosim(const std::string& name);
+    void close_shm_cosim();
+    void publish_shm_cosim();
+
+    /// Header of the shared-memory co-simulation segment (see open_shm_cosim())
+    struct ShmCoSimHeader
+    {
+      unsigned magic;                ///< identifies a Moby co-simulation segment
+      unsigned nbodies;              ///< number of ShmCoSimRecord slots following
+      volatile unsigned state_seq;   ///< seqlock over time and pose/velocity data (written by Moby)
+      volatile unsigned wrench_seq;  ///< seqlock over the wrench inputs (written by the peer)
+      unsigned wrench_enabled;       ///< set nonzero by the peer once it publishes wrenches
+      double time;                   ///< simulation time of the published state
+    };
+
+    /// Per-body slot in the co-simulation segment, in publication order
+    struct ShmCoSimRecord
+    {
+      double pose[7];      ///< global position (x,y,z) and orientation quaternion (x,y,z,w)
+      double velocity[6];  ///< spatial velocity in the global frame: angular, then linear
+      double wrench[6];    ///< external input in a global-aligned frame at the body origin: force, then torque
+    };
 
     /// The current simulation time
     double current_time;
@@ -61,6 +103,47 @@ class Simulator : public virtual Base
     /// The dissipation mechanism for larger time steps
     boost::shared_ptr<Dissipation> dissipator;
 
+    /// Per-phase timing statistics for stepping (disabled by default)
+    StepProfiler profiler;
+
+    /// Per-subsystem estimate of the simulator's heap memory, in bytes
+    /**
+     * Filled in by calc_memory_footprint().  Estimates exclude allocator
+     * overhead and visualization (OSG) data.
+     */
+    struct MemoryFootprint
+    {
+      MemoryFootprint() { geometry = collision_detection = solver_workspaces = 0; }
+
+      /// Primitive geometry: meshes, BV hierarchies, polyhedra
+      unsigned long geometry;
+
+      /// Collision detector state: broad-phase bounds and narrow-phase caches
+      unsigned long collision_detection;
+
+      /// Constraint solver workspaces and warm-start caches
+      unsigned long solver_workspaces;
+
+      /// The summed footprint
+      unsigned long total() const { return geometry + collision_detection + solver_workspaces; }
+
+      void dump(std::ostream& out) const;
+    };
+
+    virtual void calc_memory_footprint(MemoryFootprint& fp) const;
+    virtual void release_transient_memory();
+
+    /// Heap memory budget for the simulator, in bytes (default 0 = unlimited)
+    /**
+     * When nonzero, each step that ends with the estimated footprint (see
+     * calc_memory_footprint()) above this budget releases the rebuildable
+     * caches via release_transient_memory(), trading resolve time on later
+     * steps for bounded memory growth.  Geometry and solver workspaces sized
+     * to the scene are not released; a budget below their footprint logs the
+     * overage without freeing anything.
+     */
+    unsigned long memory_budget;
+
     /// Gets the list of dynamic bodies in the simulator
     /**
      * \note if a dynamic body is articulated, only the articulated body is
@@ -85,20 +168,252 @@ class Simulator : public virtual Base
     /// Set of implicit joints maintained in the simulation (does not include implicit joints belonging to RCArticulatedBody objects)
     std::vector<JointPtr> implicit_joints;
 
+    /// If true, bodies at rest may be put to sleep (default = false)
+    /**
+     * Sleeping bodies are excluded from forward dynamics computation and
+     * integration, and pairs of sleeping bodies are excluded from pairwise
+     * distance checks. Bodies sleep and wake an island at a time: an island
+     * sleeps only when every body in it has remained below its velocity
+     * thresholds for its sleep time window (see RigidBody), and a sleeping
+     * island is woken as a unit by a new contact or an applied force.
+     */
+    bool sleeping_enabled;
+
+    /// Whether quiescent steps are fast-forwarded without simulating
+    /**
+     * If set (and sleeping is enabled), step() first checks whether the
+     * scene is quiescent- every enabled body asleep and no controllers
+     * installed- and, if so, advances the clock by the step size without
+     * running collision detection, dynamics or integration (see
+     * scene_is_quiescent()). Long stretches where nothing moves then cost
+     * a flag scan per step instead of a full pipeline pass; an applied
+     * force or impulse wakes its body and ends the fast-forward. Disabled
+     * by default.
+     */
+    bool steady_state_skipping_enabled;
+
+    /// Whether integration advances state through packed structure-of-arrays buffers
+    /**
+     * If set, integrate() gathers the generalized coordinates, velocities,
+     * and accelerations of all bodies into contiguous arrays, advances them
+     * with straight-line loops over the packed storage, and scatters the
+     * results back, rather than updating each heap-allocated body in turn.
+     * Disabled by default; most useful for scenes with many free rigid
+     * bodies.
+     */
+    bool soa_integration;
+
+    /// Whether gravity-only free bodies are integrated analytically
+    /**
+     * If set, integrate() identifies enabled rigid bodies that are outside
+     * any articulated body, have no controllers, and whose recurrent forces
+     * are all GravityForce instances ("ballistic" bodies). Such bodies skip
+     * force accumulation and the per-island dynamics solve entirely: their
+     * acceleration is exactly the summed gravity, so the step advances their
+     * coordinates by the current velocity and adds g*dt to the linear
+     * velocity in closed form. The gyroscopic angular term is dropped, so
+     * this path suits particle-like debris rather than fast tumbling bodies.
+     * Disabled by default; has no effect on simulators that do not advance
+     * state through Simulator::integrate() (e.g., TimeSteppingSimulator).
+     */
+    bool ballistic_fast_path;
+
+    /// Whether fixed implicit joints are merged into compound bodies at load
+    /**
+     * If set, load_from_xml() eliminates every fixed implicit joint between
+     * two free rigid bodies: the outboard body's inertia is folded into the
+     * inboard body, its collision geometries are reattached to the inboard
+     * body at the same absolute pose, and the outboard body and the joint
+     * are removed from the simulation. This removes the merged bodies'
+     * degrees-of-freedom and the joints' constraint rows from every solve.
+     * Joints into articulated bodies and outboard bodies with controllers or
+     * visualization data are left unmerged. Disabled by default.
+     */
+    bool merge_fixed_joints;
+
+    /// Whether island dynamics are placed NUMA-aware on multi-socket hosts
+    /**
+     * If set (and the build has OpenMP on Linux), the per-island forward
+     * dynamics loop binds each worker thread to one NUMA node and assigns
+     * every constraint island to a node, so a given island is always solved
+     * by threads of the same socket.  Assignments are sticky: an island
+     * keeps its node from step to step, and a rebuild of the island
+     * decomposition migrates only the islands whose membership actually
+     * changed.  The solver scratch an island's threads allocate is then
+     * faulted onto -- and stays on -- that socket under the kernel's
+     * first-touch policy, so the bulk of the dynamics working set never
+     * crosses the interconnect.  Has no effect on single-node hosts or
+     * builds without OpenMP.  Disabled by default.
+     */
+    bool numa_aware_islands;
+
+    /// The ordered pipeline of stages executed by step()
+    /**
+     * Built lazily from the built-in phases (see build_default_pipeline());
+     * user stages are spliced around them with insert_stage_before() /
+     * insert_stage_after().  Consecutive stages whose declared read/write
+     * sets do not conflict are run concurrently (see run_pipeline()).
+     */
+    std::vector<boost::shared_ptr<SimulationStage> > pipeline;
+
+    bool insert_stage_before(boost::shared_ptr<SimulationStage> stage, const std::string& name);
+    bool insert_stage_after(boost::shared_ptr<SimulationStage> stage, const std::string& name);
+
+    static bool body_is_asleep(boost::shared_ptr<Ravelin::DynamicBodyd> db);
+    void wake_body(boost::shared_ptr<Ravelin::DynamicBodyd> db);
+    bool scene_is_quiescent() const;
+
+    void start_impulse_batch();
+    void flush_impulse_batch();
+
   protected:
+    virtual void build_default_pipeline();
+    void run_pipeline(double dt);
+    bool try_fast_forward(double step_size);
+    void run_integration_stage(double dt);
+    void enforce_memory_budget();
     void apply_impulse(boost::shared_ptr<Ravelin::DynamicBodyd> db, const Ravelin::SharedVectorNd& gj);
+    void get_impulse_island(boost::shared_ptr<Ravelin::DynamicBodyd> db, std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> >& island, std::vector<JointPtr>& island_ijoints) const;
+    void apply_island_impulse(const std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> >& island, const std::vector<JointPtr>& island_ijoints, const Ravelin::VectorNd& f);
+
+    /// Accumulated generalized impulses, per body, while batching
+    std::map<boost::shared_ptr<Ravelin::DynamicBodyd>, Ravelin::VectorNd> _impulse_batch;
+
+    /// Whether apply_impulse() currently accumulates rather than applies
+    bool _batching_impulses;
     void solve(const std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> >& island, const std::vector<JointPtr>& island_joints, const Ravelin::VectorNd& v, const Ravelin::VectorNd& f, double dt, Ravelin::VectorNd& a, Ravelin::VectorNd& lambda) const;
     virtual double check_pairwise_constraint_violations(double t) { return 0.0; }
     void find_islands(std::vector<std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> > >& islands);
     unsigned num_generalized_coordinates(const std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> > & island) const;
+
+    /// Island decomposition from the last find_islands() call
+    /**
+     * Islands depend only on the enabled bodies and the simulator implicit
+     * joints, both of which change rarely, so the decomposition is memoized:
+     * find_islands() revalidates the cache by comparing those inputs against
+     * the snapshots below -- a flat pointer comparison -- and reruns the
+     * graph traversal only when they differ.  Toggling the enabled flag of
+     * an individual articulated-body link (rather than a body in the
+     * simulator) is not captured by the key; release_transient_memory()
+     * forces a rebuild.
+     */
+    std::vector<std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> > > _cached_islands;
+
+    /// The enabled dynamic bodies the cached islands were computed from (empty = cache invalid)
+    std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> > _island_key_bodies;
+
+    /// The implicit joints the cached islands were computed from
+    std::vector<JointPtr> _island_key_joints;
+
+    void update_numa_island_domains(const std::vector<std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> > >& islands);
+
+    /// CPU lists of the host's NUMA nodes (read lazily; fewer than two = placement inert)
+    std::vector<std::vector<int> > _numa_node_cpus;
+
+    /// Whether the NUMA topology has been read from the host
+    bool _numa_topology_read;
+
+    /// Sticky island-to-node assignments, keyed by island representative
+    std::map<boost::shared_ptr<Ravelin::DynamicBodyd>, unsigned> _numa_domain_of;
+
+    /// Node assignment of each island for the current step
+    std::vector<unsigned> _numa_island_domain;
+
+    /// Last node each worker thread was pinned to (-1 = not yet pinned)
+    std::vector<int> _numa_thread_node;
     osg::Group* _persistent_vdata;
     osg::Group* _transient_vdata;
     void calc_fwd_dyn(double dt);
+    void calc_fwd_dyn_island(std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> >& island, double dt);
     void precalc_fwd_dyn();
+    void integrate_packed(double dt);
+    void find_ballistic_bodies();
+    bool advance_ballistic(boost::shared_ptr<Ravelin::DynamicBodyd> db, double dt);
+
+    /// Bodies on the ballistic fast path this step, with their summed gravity
+    std::map<boost::shared_ptr<Ravelin::DynamicBodyd>, Ravelin::Vector3d> _ballistic;
+
+    /// Packed state buffers for structure-of-arrays integration
+    Ravelin::VectorNd _packed_gc, _packed_gve, _packed_gv, _packed_ga;
+
+    /// Spatial-vector batches for the ballistic velocity update (reused across steps)
+    SpatialVectorSlab _ballistic_vslab, _ballistic_gslab;
+
+    /// Checkpoint buffer and gather/scatter workspace (reused across calls)
+    std::vector<char> _ckpt_buffer;
+    Ravelin::VectorNd _ckpt_work;
+
+    /// Generalized-force workspace for precalc_fwd_dyn() (reused across steps)
+    Ravelin::VectorNd _gf_work;
+    std::vector<Ravelin::VectorNd> _batch_gf_work;
+
+    /// One frame of the in-memory snapshot stack (see push_state_snapshot())
+    struct StateSnapshot
+    {
+      double time;                     // simulation time at capture
+      std::vector<double> slab;        // packed coordinates and velocities
+      std::vector<int> offsets;        // per-body slab offsets (-1: not captured)
+      std::vector<unsigned> ngc, ngv;  // per-body coordinate/velocity dimensions
+    };
+
+    void merge_fixed_implicit_joints();
+    void invalidate_joint_step_data();
+    void apply_shm_cosim_wrenches();
+    void capture_body_state(unsigned i, StateSnapshot& ss);
+    void capture_woken_body(boost::shared_ptr<Ravelin::DynamicBodyd> db);
+    void gather_sim_state(Ravelin::VectorNd& x);
+    void scatter_sim_state(const Ravelin::VectorNd& x);
+
+    /// The step Jacobian from the last step_with_jacobian() call
+    Ravelin::SparseMatrixNd _step_jacobian;
+
+    /// Stacked-state workspaces for step_with_jacobian()
+    Ravelin::VectorNd _jac_x0, _jac_xnom, _jac_xpert;
+
+    /// Stack of live state snapshots (innermost frame last)
+    std::vector<boost::shared_ptr<StateSnapshot> > _snapshot_stack;
+
+    /// Recycled snapshot frames (slabs keep their capacity across uses)
+    std::vector<boost::shared_ptr<StateSnapshot> > _snapshot_pool;
+
+    /// Mapped co-simulation segment (NULL when closed) and its extent
+    void* _shm_cosim;
+    unsigned _shm_cosim_size;
+
+    /// Name of the open co-simulation segment (for unlinking at close)
+    std::string _shm_cosim_name;
+
+    /// Rigid bodies published to the segment, in record order
+    std::vector<boost::shared_ptr<Ravelin::RigidBodyd> > _shm_cosim_bodies;
+
+    /// Consistent snapshot of the peer's wrench inputs (reused across steps)
+    std::vector<double> _shm_cosim_scratch;
 
     /// The set of bodies in the simulation
     std::vector<ControlledBodyPtr> _bodies;
-  
+
+    /// Islands of bodies that were put to sleep as a unit (woken as a unit)
+    std::vector<std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> > > _sleeping_islands;
+
+    /// Pose snapshot buffers for visualization decoupled from stepping
+    /**
+     * The stepping thread fills the back buffer (unsynchronized) and
+     * publishes it to the front buffer with an O(1) swap; the render thread
+     * swaps the front buffer into the render buffer and applies it. Neither
+     * thread ever waits while the other walks its buffer.
+     */
+    std::vector<std::pair<OSGGroupWrapperPtr, Ravelin::Pose3d> > _pose_back_buffer;
+    std::vector<std::pair<OSGGroupWrapperPtr, Ravelin::Pose3d> > _pose_front_buffer;
+    std::vector<std::pair<OSGGroupWrapperPtr, Ravelin::Pose3d> > _pose_render_buffer;
+
+    /// Whether the front buffer holds a snapshot not yet rendered
+    bool _pose_snapshot_ready;
+
+    #ifdef THREADSAFE
+    /// Mutex guarding only the front buffer swaps
+    pthread_mutex_t _pose_buffer_mutex;
+    #endif
+
     /// The derivative at the current time
     Ravelin::VectorNd _current_dx;
 
@@ -18,20 +18,34 @@ double Simulator::integrate(double dt, ForwardIterator begin, ForwardIterator en
   tms cstart;  
   clock_t start = times(&cstart);
 
+  // identify bodies that can take the analytic ballistic fast path
+  if (ballistic_fast_path)
+    find_ballistic_bodies();
+
   // pre-calculate dynamics
   precalc_fwd_dyn();
 
   // calculate forward dynamics
   calc_fwd_dyn(dt);
 
-  // update generalized velocities and use new generalized 
-  // velocities to calculate new generalized coordinates 
-  for (unsigned j=0; j< _bodies.size(); j++)
+  // update generalized velocities and use new generalized
+  // velocities to calculate new generalized coordinates
+  if (soa_integration)
+  {
+    // advance all state through packed structure-of-arrays buffers
+    integrate_packed(dt);
+  }
+  else for (unsigned j=0; j< _bodies.size(); j++)
   {
     // NOTE: coordinates must be set first to ensure that frame information
     // is correct for velocities: mixed pose will be incorrect if
     // generalized_velocity is set first
-    boost::shared_ptr<Ravelin::DynamicBodyd> db = boost::dynamic_pointer_cast<Ravelin::DynamicBodyd>(_bodies[j]); 
+    boost::shared_ptr<Ravelin::DynamicBodyd> db = boost::dynamic_pointer_cast<Ravelin::DynamicBodyd>(_bodies[j]);
+
+    // ballistic bodies skipped the dynamics solve; advance them analytically
+    if (!_ballistic.empty() && advance_ballistic(db, dt))
+      continue;
+
     db->get_generalized_acceleration(ga);
     db->get_generalized_velocity(Ravelin::DynamicBodyd::eSpatial, gv);
     db->get_generalized_velocity(Ravelin::DynamicBodyd::eEuler, gve);
@@ -44,7 +58,10 @@ double Simulator::integrate(double dt, ForwardIterator begin, ForwardIterator en
     gc += gve;
     db->set_generalized_coordinates_euler(gc);
     db->set_generalized_velocity(Ravelin::DynamicBodyd::eSpatial, gv);
-  } 
+  }
+
+  // the fast path set is rebuilt every step
+  _ballistic.clear();
 
   // tabulate dynamics computation
   tms cstop;  
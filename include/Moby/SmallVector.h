@@ -0,0 +1,82 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _MOBY_SMALL_VECTOR_H
+#define _MOBY_SMALL_VECTOR_H
+
+#include <algorithm>
+
+namespace Moby {
+
+/// A sequence with inline storage for small sizes
+/**
+ * Behaves like a pared-down std::vector, except that the first N elements
+ * live inside the object itself; the heap is only touched if the sequence
+ * grows past N. Contact manifolds rarely exceed a handful of points, so the
+ * scratch containers in the contact pipeline use this type to avoid paying
+ * a heap allocation per query. Storage remains contiguous after a spill, so
+ * iterators are plain pointers (invalidated by growth, as with std::vector).
+ */
+template <class T, unsigned N>
+class SmallVector
+{
+  public:
+    typedef T value_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+    typedef unsigned size_type;
+
+    SmallVector() { _data = _inline; _size = 0; _capacity = N; }
+    ~SmallVector() { if (_data != _inline) delete [] _data; }
+
+    size_type size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    void clear() { _size = 0; }
+    reference operator[](size_type i) { return _data[i]; }
+    const_reference operator[](size_type i) const { return _data[i]; }
+    reference front() { return _data[0]; }
+    const_reference front() const { return _data[0]; }
+    reference back() { return _data[_size-1]; }
+    const_reference back() const { return _data[_size-1]; }
+    iterator begin() { return _data; }
+    const_iterator begin() const { return _data; }
+    iterator end() { return _data + _size; }
+    const_iterator end() const { return _data + _size; }
+
+    void push_back(const T& t)
+    {
+      if (_size == _capacity)
+        grow();
+      _data[_size++] = t;
+    }
+
+  private:
+    // copying would require a deep copy of any spilled storage; the scratch
+    // containers this type serves never need it
+    SmallVector(const SmallVector&);
+    SmallVector& operator=(const SmallVector&);
+
+    /// Doubles the capacity, spilling to (or growing) heap storage
+    void grow()
+    {
+      T* bigger = new T[_capacity*2];
+      std::copy(_data, _data+_size, bigger);
+      if (_data != _inline)
+        delete [] _data;
+      _data = bigger;
+      _capacity *= 2;
+    }
+
+    T _inline[N];
+    T* _data;
+    size_type _size, _capacity;
+}; // end class
+
+} // end namespace
+
+#endif
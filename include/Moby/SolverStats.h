@@ -0,0 +1,140 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _MOBY_SOLVER_STATS_H
+#define _MOBY_SOLVER_STATS_H
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <boost/shared_ptr.hpp>
+
+namespace Moby {
+
+/// Telemetry accumulated by the optimization-based solvers
+/**
+ * Each solver backend (the pivoting LCP solvers, the IPOPT-backed QP and
+ * LCP solvers) owns one of these records and updates it after every solve:
+ * pivot counts, the regularization factor that was necessary, the
+ * complementarity residual of the returned solution and (optionally) a
+ * condition number estimate of the solve matrix. Fields that are not
+ * meaningful for a backend, or that were not computed, are left at -1.
+ * The record accumulates until reset() is called, so callers typically
+ * sample or reset it once per simulation step. An optional callback fires
+ * after any solve that fails or exceeds the configured warning thresholds,
+ * allowing body parameters to be adapted online when problems become
+ * pathologically conditioned.
+ */
+class SolverStats
+{
+  public:
+    SolverStats()
+    {
+      pivot_warn_threshold = std::numeric_limits<unsigned>::max();
+      regularization_warn_threshold = std::numeric_limits<double>::max();
+      cond_warn_threshold = std::numeric_limits<double>::max();
+      warn_callback_fn = NULL;
+      reset();
+    }
+
+    /// Clears the accumulated statistics (thresholds and callback are kept)
+    void reset()
+    {
+      solves = failures = 0;
+      last_pivots = max_pivots = 0;
+      total_pivots = 0;
+      last_regularization = max_regularization = 0.0;
+      last_residual = max_residual = -1.0;
+      last_cond = max_cond = -1.0;
+    }
+
+    /// Records the outcome of one solve, firing the warning callback if warranted
+    void record(unsigned pivots, double regularization, double residual, double cond, bool solved)
+    {
+      solves++;
+      if (!solved)
+        failures++;
+      last_pivots = pivots;
+      total_pivots += pivots;
+      max_pivots = std::max(max_pivots, pivots);
+      last_regularization = regularization;
+      max_regularization = std::max(max_regularization, regularization);
+      last_residual = residual;
+      max_residual = std::max(max_residual, residual);
+      last_cond = cond;
+      max_cond = std::max(max_cond, cond);
+
+      // see whether the warning callback should fire
+      if (warn_callback_fn &&
+          (!solved || pivots > pivot_warn_threshold ||
+           regularization > regularization_warn_threshold ||
+           cond > cond_warn_threshold))
+        (*warn_callback_fn)(*this, warn_callback_data);
+    }
+
+    /// Writes the accumulated statistics in human-readable form
+    std::ostream& dump(std::ostream& out) const
+    {
+      out << "solves: " << solves << "  failures: " << failures << std::endl;
+      out << "pivots (last/max/total): " << last_pivots << " / " << max_pivots << " / " << total_pivots << std::endl;
+      out << "regularization (last/max): " << last_regularization << " / " << max_regularization << std::endl;
+      out << "residual (last/max): " << last_residual << " / " << max_residual << std::endl;
+      out << "condition estimate (last/max): " << last_cond << " / " << max_cond << std::endl;
+      return out;
+    }
+
+    /// The number of solves attempted since the last reset
+    unsigned solves;
+
+    /// The number of solves that returned without a solution
+    unsigned failures;
+
+    /// The number of pivots performed by the last solve (0 for interior-point solves)
+    unsigned last_pivots;
+
+    /// The most pivots performed by any single solve since the last reset
+    unsigned max_pivots;
+
+    /// The total pivots performed since the last reset
+    unsigned long total_pivots;
+
+    /// The regularization factor the last solve needed (0 = unregularized)
+    double last_regularization;
+
+    /// The largest regularization factor needed since the last reset
+    double max_regularization;
+
+    /// The l-inf complementarity residual of the last solution (-1 if unknown)
+    double last_residual;
+
+    /// The largest residual observed since the last reset
+    double max_residual;
+
+    /// The condition number estimate for the last solve matrix (-1 if not computed)
+    double last_cond;
+
+    /// The largest condition number estimate since the last reset
+    double max_cond;
+
+    /// Pivot count above which the warning callback fires
+    unsigned pivot_warn_threshold;
+
+    /// Regularization factor above which the warning callback fires
+    double regularization_warn_threshold;
+
+    /// Condition number estimate above which the warning callback fires
+    double cond_warn_threshold;
+
+    /// Optional callback invoked after a failed solve or one exceeding a threshold
+    void (*warn_callback_fn)(const SolverStats&, boost::shared_ptr<void>);
+
+    /// Data passed to the warning callback
+    boost::shared_ptr<void> warn_callback_data;
+}; // end class
+
+} // end namespace
+
+#endif
@@ -0,0 +1,66 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _SPATIAL_GRID_CCD_H
+#define _SPATIAL_GRID_CCD_H
+
+#include <map>
+#include <vector>
+#include <Moby/CCD.h>
+
+namespace Moby {
+
+/// Collision detector that replaces the sweep-and-prune broad phase with a uniform spatial hash grid
+/**
+ * Geometries are binned into a uniform grid keyed on integer cell
+ * coordinates, and only geometries sharing a cell are tested for AABB
+ * overlap. For scenes of mostly uniformly sized objects (e.g., granular
+ * material over a heightmap), neighbor queries are O(1) per geometry instead
+ * of requiring three sorted global axis sweeps. The narrow phase is
+ * inherited unchanged from CCD.
+ */
+class SpatialGridCCD : public CCD
+{
+  public:
+    SpatialGridCCD();
+    virtual ~SpatialGridCCD() {}
+    virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
+    virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
+    virtual void broad_phase(double dt, const std::vector<ControlledBodyPtr>& bodies, std::vector<std::pair<CollisionGeometryPtr, CollisionGeometryPtr> >& to_check);
+
+    /// The edge length of a grid cell (if zero, twice the mean bounding radius of the scene is used)
+    double cell_size;
+
+  private:
+    // integer grid cell coordinates
+    struct CellKey
+    {
+      int x, y, z;
+      bool operator<(const CellKey& k) const
+      {
+        if (x != k.x) return x < k.x;
+        if (y != k.y) return y < k.y;
+        return z < k.z;
+      }
+    };
+
+    // swept AABB for a geometry during one broad phase
+    struct GeomBounds
+    {
+      CollisionGeometryPtr geom;
+      Point3d lo, hi;
+    };
+
+    // the grid cells, rebuilt each broad phase
+    std::map<CellKey, std::vector<unsigned> > _cells;
+
+    // per-geometry bounding spheres (rebuilt per step from body poses)
+    std::map<CollisionGeometryPtr, BVPtr> _bounding_spheres;
+}; // end class
+
+} // end namespace
+
+#endif
@@ -0,0 +1,69 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _MOBY_SPATIAL_VECTOR_SLAB_H
+#define _MOBY_SPATIAL_VECTOR_SLAB_H
+
+#include <boost/shared_array.hpp>
+#include <Ravelin/Origin3d.h>
+#include <Ravelin/SVelocityd.h>
+#include <Ravelin/SForced.h>
+#include <Ravelin/Transform3d.h>
+#include <Moby/Types.h>
+
+namespace Moby {
+
+/// A batch of spatial vectors stored structure-of-arrays for vector kernels
+/**
+ * Ravelin's spatial types (SVelocityd, SForced) are arrays-of-structures:
+ * the six components of each vector sit together, so a loop over many
+ * spatial vectors strides through memory and defeats the compiler's
+ * vectorizer.  This slab stores a batch transposed -- six contiguous lanes,
+ * one per component, each cache-line aligned storage drawn from the
+ * "spatial-slab" AlignedSlabPool -- so the batched kernels below compile to
+ * straight-line unit-stride sweeps that process one batch element per
+ * vector lane.  Lanes 0..2 hold the upper (angular/torque) components and
+ * lanes 3..5 the lower (linear/force) components.
+ *
+ * The slab carries no pose: the caller batches vectors it knows to share a
+ * frame (or has transformed into one) and reattaches the pose on scatter,
+ * the same contract the packed generalized-coordinate buffers in
+ * Simulator::integrate_packed() follow.
+ */
+class SpatialVectorSlab
+{
+  public:
+    SpatialVectorSlab() { _n = _capacity = 0; }
+    void resize(unsigned n);
+
+    /// Gets the number of spatial vectors in the batch
+    unsigned size() const { return _n; }
+
+    /// Gets component lane i (0..2 upper/angular, 3..5 lower/linear)
+    double* lane(unsigned i) { return _lanes[i].get(); }
+    const double* lane(unsigned i) const { return _lanes[i].get(); }
+
+    void set(unsigned i, const Ravelin::Origin3d& upper, const Ravelin::Origin3d& lower);
+    void get(unsigned i, Ravelin::Origin3d& upper, Ravelin::Origin3d& lower) const;
+    void set(unsigned i, const Ravelin::SVelocityd& v);
+    void set(unsigned i, const Ravelin::SForced& f);
+    Ravelin::SVelocityd get_velocity(unsigned i, boost::shared_ptr<const Ravelin::Pose3d> pose) const;
+    Ravelin::SForced get_force(unsigned i, boost::shared_ptr<const Ravelin::Pose3d> pose) const;
+
+  private:
+    boost::shared_array<double> _lanes[6];
+    unsigned _n, _capacity;
+}; // end class
+
+void batch_spatial_axpy(double a, const SpatialVectorSlab& x, SpatialVectorSlab& y);
+void batch_spatial_cross(const SpatialVectorSlab& v, const SpatialVectorSlab& w, SpatialVectorSlab& out);
+void batch_spatial_cross_star(const SpatialVectorSlab& v, const SpatialVectorSlab& f, SpatialVectorSlab& out);
+void batch_spatial_dot(const SpatialVectorSlab& v, const SpatialVectorSlab& f, double* out);
+void batch_spatial_transform(const Ravelin::Transform3d& T, const SpatialVectorSlab& m, SpatialVectorSlab& out);
+
+} // end namespace
+
+#endif
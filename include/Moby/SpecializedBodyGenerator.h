@@ -0,0 +1,53 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _MOBY_SPECIALIZED_BODY_GENERATOR_H
+#define _MOBY_SPECIALIZED_BODY_GENERATOR_H
+
+#include <iostream>
+#include <string>
+#include <Moby/RCArticulatedBody.h>
+
+namespace Moby {
+
+/// Emits fixed-topology specialized C++ for a loaded RCArticulatedBody
+/**
+ * Deployments that simulate one robot model millions of times pay every
+ * step for generality the model never uses: the forward dynamics solve
+ * walks heap-allocated joints through virtual dispatch and factors the
+ * joint-space inertia with a general dense routine that knows nothing of
+ * the model's fixed coupling structure.  This generator takes a fully
+ * loaded body and writes a complete plugin translation unit specializing
+ * the forward dynamics for that body's topology: the class it emits
+ * derives from RCArticulatedBody and overrides calc_fwd_dyn() with
+ * straight-line code for the exact generalized coordinate count, a fully
+ * unrolled Cholesky factorization whose structural zeros -- coordinate
+ * pairs whose joints lie in disjoint subtrees of the kinematic tree, which
+ * can never couple in the inertia -- are pruned at generation time, and
+ * unrolled triangular solves, all over scalar locals the compiler keeps in
+ * registers.
+ *
+ * The emitted file compiles against the installed Moby headers into a
+ * shared library exporting the factory() symbol and loads through the
+ * existing RCArticulatedBodySymbolicPlugin XML hook (see
+ * XMLReader::read_rc_abody_symbolic()), so a specialized body drops into a
+ * simulation file without any other change.  The generated code verifies
+ * the runtime coordinate count against the generated one and falls back to
+ * the generic solve on mismatch (or when implicit joint friction is
+ * active), so a stale plugin degrades to correct-but-slower rather than
+ * wrong.  Emitted code size grows cubically with the coordinate count;
+ * regenerate whenever the model's links or joints change.
+ */
+class SpecializedBodyGenerator
+{
+  public:
+    static bool generate(boost::shared_ptr<RCArticulatedBody> body, const std::string& class_name, std::ostream& out);
+    static bool generate(boost::shared_ptr<RCArticulatedBody> body, const std::string& class_name, const std::string& filename);
+}; // end class
+
+} // end namespace
+
+#endif
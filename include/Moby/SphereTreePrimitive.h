@@ -0,0 +1,96 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _SPHERE_TREE_PRIMITIVE_H
+#define _SPHERE_TREE_PRIMITIVE_H
+
+#include <Moby/Primitive.h>
+
+namespace Moby {
+
+class BoundingSphere;
+
+/// Approximates another primitive with a small tree of medial spheres
+/**
+ * Samples the source primitive's surface through its signed distance
+ * queries, grows the largest interior (medial) sphere tangent at each
+ * sample, greedily keeps the spheres that cover the samples, and assembles
+ * the survivors into a binary bounding tree.  Distance queries then descend
+ * the tree and resolve analytically against leaf spheres, so geometry
+ * approximated this way answers narrow-phase queries at sphere cost and
+ * takes the sphere fast path through conservative advancement, regardless
+ * of the complexity of the source.  Intended for small fast-moving debris,
+ * where contact fidelity matters less than narrow-phase throughput; mass
+ * properties are taken from the source primitive.
+ */
+class SphereTreePrimitive : public Primitive
+{
+  public:
+    SphereTreePrimitive();
+    void set_source(PrimitivePtr source);
+    void set_max_spheres(unsigned max_spheres);
+    void set_num_samples(unsigned nsamples);
+
+    /// Gets the primitive this sphere tree approximates
+    PrimitivePtr get_source() const { return _source; }
+
+    /// Gets the number of leaf spheres in the tree
+    unsigned num_spheres() const { return _nleaves; }
+
+    virtual void get_vertices(boost::shared_ptr<const Ravelin::Pose3d> P, std::vector<Point3d>& vertices) const;
+    virtual double calc_dist_and_normal(const Point3d& point, std::vector<Ravelin::Vector3d>& normals) const;
+    virtual double calc_signed_dist(boost::shared_ptr<const Primitive> p, Point3d& pthis, Point3d& pp) const;
+    virtual double calc_signed_dist(const Point3d& p) const;
+    virtual Point3d get_supporting_point(const Ravelin::Vector3d& d) const;
+    virtual osg::Node* create_visualization();
+    virtual boost::shared_ptr<const IndexedTriArray> get_mesh(boost::shared_ptr<const Ravelin::Pose3d> P);
+    virtual BVPtr get_BVH_root(CollisionGeometryPtr geom);
+    virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
+    virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
+    virtual double get_bounding_radius() const;
+    virtual unsigned long calc_memory_usage() const;
+
+  protected:
+    virtual void calc_mass_properties();
+
+    /// A sphere in the tree; internal nodes bound their whole subtree
+    struct SphereNode
+    {
+      Ravelin::Origin3d center;  // the center, in the primitive frame
+      double radius;             // the sphere radius
+      unsigned kids[2];          // child node indices (UINT_MAX marks a leaf)
+    };
+
+    void build();
+    unsigned build_node(std::vector<std::pair<Ravelin::Origin3d, double> >& spheres, unsigned lo, unsigned hi);
+    double query_point(unsigned idx, const Ravelin::Origin3d& p, double best, unsigned& best_leaf) const;
+    void query_primitive(unsigned idx, boost::shared_ptr<const Primitive> p, const Ravelin::Transform3d& oTt, boost::shared_ptr<const Ravelin::Pose3d> tpose, std::vector<Ravelin::Vector3d>& normals, double& best, Point3d& best_pthis, Point3d& best_pother) const;
+
+    /// The primitive being approximated
+    PrimitivePtr _source;
+
+    /// The tree nodes, root first (empty until a source is set)
+    std::vector<SphereNode> _nodes;
+
+    /// The number of leaf spheres in the tree
+    unsigned _nleaves;
+
+    /// The maximum number of leaf spheres kept by the builder
+    unsigned _max_spheres;
+
+    /// The number of surface samples the builder draws from the source
+    unsigned _nsamples;
+
+    /// The bounding volumes for the tree
+    std::map<CollisionGeometryPtr, boost::shared_ptr<BoundingSphere> > _bsphs;
+
+    /// Scratch geometry registering a query frame on the source for building
+    CollisionGeometryPtr _scratch;
+}; // end class
+
+} // end namespace
+
+#endif
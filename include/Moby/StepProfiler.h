@@ -0,0 +1,86 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _STEP_PROFILER_H
+#define _STEP_PROFILER_H
+
+#include <deque>
+#include <iostream>
+
+namespace Moby {
+
+/// Lightweight per-phase wall-clock instrumentation for simulator stepping
+/**
+ * Accumulates the time spent in each phase of a simulation step (broad
+ * phase, narrow phase, forward dynamics, impact handling, stabilization and
+ * integration) using RAII timers placed in the stepping code. Per-step
+ * totals are folded into lifetime statistics and a sliding window of recent
+ * steps, so regressions can be observed in production without attaching an
+ * external profiler. Disabled by default; when disabled the timers cost two
+ * branches per phase.
+ */
+class StepProfiler
+{
+  public:
+    enum Phase
+    {
+      eBroadPhase,
+      eNarrowPhase,
+      eForwardDynamics,
+      eImpactHandling,
+      eStabilization,
+      eIntegration,
+      N_PHASES
+    };
+
+    StepProfiler();
+    void start_step();
+    void end_step();
+    void reset();
+    void set_window_size(unsigned n);
+    static const char* phase_name(Phase p);
+    double get_last(Phase p) const;
+    double get_total(Phase p) const;
+    double get_max(Phase p) const;
+    double get_window_mean(Phase p) const;
+    double get_window_max(Phase p) const;
+    std::ostream& dump(std::ostream& out) const;
+
+    /// Gets the number of completed steps observed
+    unsigned get_num_steps() const { return _steps; }
+
+    /// If set to true, the timers accumulate phase times (default is false)
+    bool enabled;
+
+    /// RAII timer that charges its lifetime to a phase of the current step
+    class ScopedTimer
+    {
+      public:
+        ScopedTimer(StepProfiler& profiler, Phase p);
+        ~ScopedTimer();
+
+      private:
+        StepProfiler& _profiler;
+        Phase _phase;
+        double _start;
+    };
+
+  private:
+    friend class ScopedTimer;
+    static double now();
+    void add(Phase p, double elapsed);
+
+    double _last[N_PHASES];    // phase times of the step in progress / just completed
+    double _total[N_PHASES];   // lifetime accumulated phase times
+    double _max[N_PHASES];     // largest per-step phase times observed
+    std::deque<double> _window[N_PHASES];  // per-step phase times of the last _window_size steps
+    unsigned _window_size;
+    unsigned _steps;
+}; // end class
+
+} // end namespace
+
+#endif
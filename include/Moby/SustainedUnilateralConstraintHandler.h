@@ -16,6 +16,7 @@
 #include <Moby/LCP.h>
 #include <Moby/UnilateralConstraint.h>
 #include <Moby/SustainedUnilateralConstraintProblemData.h>
+#include <Moby/ContactForceHistory.h>
 
 namespace Moby {
 
@@ -26,11 +27,23 @@ class SustainedUnilateralConstraintHandler
     SustainedUnilateralConstraintHandler();
     void process_constraints(const std::vector<UnilateralConstraint>& constraints);
 
+    /// contacts separating faster than this are predicted inactive
+    double active_set_vel_tol;
+
+    /// contacts accelerating apart faster than this are predicted inactive
+    double active_set_accel_tol;
+
+    /// Per-contact force history, shareable with the impact handler for cross-handler warm starts
+    boost::shared_ptr<ContactForceHistory> contact_force_history;
+
   private:
     static void calc_constraint_velocities(SustainedUnilateralConstraintProblemData& q, Ravelin::VectorNd& cn_v, Ravelin::VectorNd& cs_v, Ravelin::VectorNd& ct_v, Ravelin::VectorNd& l_v); 
     static ControlledBodyPtr get_super_body(boost::shared_ptr<Ravelin::SingleBodyd> sb);
     void apply_model(const std::vector<UnilateralConstraint>& constraints);
     void apply_model_to_connected_constraints(const std::list<UnilateralConstraint*>& constraints);
+    void solve_connected_constraints(const std::list<UnilateralConstraint*>& constraints);
+    void predict_active_set(const std::list<UnilateralConstraint*>& constraints, std::list<UnilateralConstraint*>& predicted, std::list<UnilateralConstraint*>& excluded) const;
+    void undo_applied_forces();
     void apply_purely_viscous_model_to_connected_constraints(const std::list<UnilateralConstraint*>& constraints);
     void compute_problem_data(SustainedUnilateralConstraintProblemData& epd);
     void compute_problem_data2(SustainedUnilateralConstraintProblemData& epd);
@@ -49,6 +62,9 @@ class SustainedUnilateralConstraintHandler
     /// Problem data
     SustainedUnilateralConstraintProblemData _epd;
 
+    /// generalized forces applied since the last clear (for active-set fallback)
+    std::map<ControlledBodyPtr, Ravelin::VectorNd> _applied_gj;
+
     /// Matrices and vectors for solving LCP
     Ravelin::MatrixNd _UL, _LL, _MM, _UR, _workM;
     Ravelin::VectorNd _qq, _workv;
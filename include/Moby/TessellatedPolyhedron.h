@@ -37,6 +37,7 @@ class TessellatedPolyhedron
     void operator=(const TessellatedPolyhedron& p);
     const IndexedTriArray& get_mesh() const { return _mesh; }
     void transform(const Ravelin::Transform3d& T);
+    void update_vertices(const std::vector<Ravelin::Origin3d>& positions);
     const std::vector<Ravelin::Origin3d>& get_vertices() const { return _mesh.get_vertices(); }
     const std::vector<IndexedTri>& get_facets() const { return _mesh.get_facets(); }
     bool inside(const Ravelin::Origin3d& point, double tol = NEAR_ZERO);
@@ -39,6 +39,65 @@ class TimeSteppingSimulator : public ConstraintSimulator
     // the minimum step that the simulator should take (default = 1e-8)
     double min_step_size;
 
+    /// If true, steps optimistically with rollback instead of using conservative advancement bounds (default = false)
+    /**
+     * The conservative advancement bound can be extremely pessimistic for
+     * fast-moving but non-colliding bodies (e.g., spinning flywheels),
+     * forcing tiny steps.  With optimistic stepping, the simulator
+     * speculatively integrates positions by the full remaining step, checks
+     * the post-step pairwise distances for new or worsened penetration, and
+     * rolls back to the saved state and halves the step only on violation;
+     * the conservative advancement bound is used as a fallback only when
+     * the step has been halved down to min_step_size.
+     */
+    bool optimistic_stepping;
+
+    /// If true, bodies certified contact-free integrate by the full step (default = false)
+    /**
+     * With two-level stepping, each step partitions the bodies using the
+     * broad phase computed over the full interval: a body with no geometry
+     * in any candidate pair cannot contact anything before the end of the
+     * step (the broad phase sweeps bounding volumes over the interval), so
+     * it integrates once by the full step.  Only the remaining bodies --
+     * the islands near contact -- subdivide via do_mini_step().  This keeps
+     * one grazing contact from forcing substepping on every unrelated body
+     * in the scene.  Articulated bodies also require that no joint limit be
+     * reachable within the step at current joint velocities.
+     */
+    bool two_level_stepping;
+
+    /// If true, generates speculative contacts instead of subdividing steps (default = false)
+    /**
+     * Thin geometry can force conservative advancement into extreme
+     * substepping.  With speculative contacts, every mini-step integrates
+     * positions by the full interval and tunneling is prevented at the
+     * velocity level instead: any pair whose conservative time of impact
+     * falls inside the step generates a contact constraint at its current
+     * closest features, credited with an approach speed of gap/dt so the
+     * solver removes exactly the normal velocity that would carry the pair
+     * past the surface.  Fast bodies introduced mid-simulation may
+     * penetrate for a single step before their first constraint solve.
+     */
+    bool speculative_contacts;
+
+    /// Wall-clock budget for one step() call, in seconds (default = 0: unlimited)
+    /**
+     * With a positive budget, step() arms a wall-clock deadline; once a
+     * mini-step begins past the deadline, constraint handling degrades for
+     * the remainder of the step: the projected Gauss-Seidel sweep cap is
+     * clamped to rt_pgs_max_iterations and every impact island is handled
+     * with the single-solve viscous friction model.  This trades friction
+     * accuracy for bounded latency (hardware-in-the-loop deadlines);
+     * whether the last step degraded is reported through rt_degraded.
+     */
+    double rt_step_budget;
+
+    /// PGS sweep cap applied while over the real-time budget (default = 10)
+    unsigned rt_pgs_max_iterations;
+
+    /// Whether the last step() degraded constraint handling to meet rt_step_budget
+    bool rt_degraded;
+
     /// Determines whether two geometries are not checked
     std::set<Ravelin::sorted_pair<CollisionGeometryPtr> > unchecked_pairs;
 
@@ -49,10 +108,27 @@ class TimeSteppingSimulator : public ConstraintSimulator
     boost::shared_ptr<TimeSteppingSimulator> get_this() { return boost::dynamic_pointer_cast<TimeSteppingSimulator>(shared_from_this()); }
     
   protected:
+    virtual void build_default_pipeline();
+    void run_broad_phase_stage(double dt);
+    void run_narrow_phase_stage(double dt);
+    void run_euler_stage(double dt);
+    void run_callback_stage(double dt);
+    void run_stabilization_stage(double dt);
+    void check_rt_budget();
+
+    /// Wall-clock deadline of the current step (see rt_step_budget)
+    double _rt_deadline;
+
+    /// PGS sweep cap to restore after a degraded step
+    unsigned _rt_saved_pgs_max;
+
     bool constraints_met(const std::vector<PairwiseDistInfo>& current_pairwise_distances);
     std::set<Ravelin::sorted_pair<CollisionGeometryPtr> > get_current_contact_geoms() const;
     double do_mini_step(double dt);
+    double do_mini_step_optimistic(double dt);
+    void find_speculative_contacts(double dt);
     void step_si_Euler(double dt);
+    void step_two_level(double dt);
     double calc_next_CA_Euler_step(double contact_dist_thresh) const;
 }; // end class
 
@@ -12,6 +12,7 @@
 namespace Moby {
 
 class PlanePrimitive;
+class CylinderPrimitive;
 
 /// Represents a solid box centered at the origin (by default)
 class TorusPrimitive : public Primitive
@@ -31,6 +32,7 @@ class TorusPrimitive : public Primitive
     virtual osg::Node* create_visualization();
     virtual double calc_signed_dist(boost::shared_ptr<const Primitive> p, Point3d& pthis, Point3d& pp) const;
     virtual double calc_signed_dist(boost::shared_ptr<const PlanePrimitive> p, Point3d& pthis, Point3d& pp) const;
+    double calc_signed_dist(boost::shared_ptr<const CylinderPrimitive> p, Point3d& pthis, Point3d& pp) const;
     virtual void get_vertices(boost::shared_ptr<const Ravelin::Pose3d> P, std::vector<Point3d>& p) const;
     virtual double calc_signed_dist(const Point3d& p) const;
     virtual double get_bounding_radius() const { return _major_radius + _minor_radius; }
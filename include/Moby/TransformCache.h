@@ -0,0 +1,68 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _MOBY_TRANSFORM_CACHE_H
+#define _MOBY_TRANSFORM_CACHE_H
+
+#include <map>
+#include <boost/shared_ptr.hpp>
+#include <Ravelin/Pose3d.h>
+#include <Ravelin/Transform3d.h>
+
+namespace Moby {
+
+/// Per-step memoization of relative pose transforms
+/**
+ * Composing the transform between two poses walks both relative pose chains
+ * to a common ancestor; the narrow phase repeats identical walks many times
+ * per step (every query for a geometry pair re-derives the same transforms).
+ * This cache keys the composed transform on the (source, target) pose
+ * identity, so each pair is composed at most once per step. Poses move in
+ * place as bodies integrate, so clear() must be called whenever poses may
+ * have changed- the collision detector clears it at the start of each broad
+ * phase.
+ */
+class TransformCache
+{
+  public:
+    /// Invalidates all memoized transforms (call whenever poses change)
+    void clear() { _transforms.clear(); }
+
+    /// Gets the number of memoized transforms
+    unsigned size() const { return (unsigned) _transforms.size(); }
+
+    /// Gets the transform from source to target, composing it at most once between clears
+    const Ravelin::Transform3d& get(boost::shared_ptr<const Ravelin::Pose3d> source, boost::shared_ptr<const Ravelin::Pose3d> target)
+    {
+      std::pair<const Ravelin::Pose3d*, const Ravelin::Pose3d*> key(source.get(), target.get());
+      std::map<std::pair<const Ravelin::Pose3d*, const Ravelin::Pose3d*>, Ravelin::Transform3d>::iterator i = _transforms.find(key);
+      if (i != _transforms.end())
+        return i->second;
+      return _transforms.insert(std::make_pair(key, Ravelin::Pose3d::calc_relative_pose(source, target))).first->second;
+    }
+
+    /// Applies one transform to a batch of points in a single tight pass
+    /**
+     * Separating the transform application from per-point logic gives the
+     * compiler a straight-line loop over the coordinate data to vectorize,
+     * instead of transform arithmetic interleaved with branching work.
+     */
+    template <class ForwardIterator, class OutputIterator>
+    static OutputIterator transform_points(const Ravelin::Transform3d& T, ForwardIterator begin, ForwardIterator end, OutputIterator output_begin)
+    {
+      for (ForwardIterator i = begin; i != end; i++)
+        *output_begin++ = T.transform_point(*i);
+      return output_begin;
+    }
+
+  private:
+    /// Memoized transforms, keyed on (source, target) pose identity
+    std::map<std::pair<const Ravelin::Pose3d*, const Ravelin::Pose3d*>, Ravelin::Transform3d> _transforms;
+}; // end class
+
+} // end namespace
+
+#endif
@@ -8,6 +8,7 @@
 #define _MOBY_TRIANGLE_H
 
 #include <ostream>
+#include <vector>
 #include <Ravelin/Vector2d.h>
 #include <Ravelin/Vector3d.h>
 #include <Ravelin/Pose3d.h>
@@ -38,6 +39,8 @@ class Triangle
     double calc_signed_dist(const Point3d& point, Point3d& closest_point) const;
     static double calc_sq_dist(const Triangle& tri, const Point3d& point, Point3d& closest_point);
     static double calc_sq_dist(const Triangle& tri, const Point3d& point, double& s, double& t);
+    static void calc_sq_dists(const Triangle* tris, unsigned n, const Point3d& point, double* sq_dists, Point3d* closest_points = NULL);
+    static void calc_sq_dists(const std::vector<Triangle>& tris, const Point3d& point, std::vector<double>& sq_dists, std::vector<Point3d>& closest_points);
     static double calc_sq_dist(const Triangle& tri, const Point3d& origin, const Ravelin::Vector3d& dir, Point3d& cp_seg, Point3d& cp_tri, double& t_line);
     static double calc_sq_dist(const Triangle& tri, const LineSeg3& seg, Point3d& cp_tri, Point3d& cp_seg);
     static double calc_sq_dist(const Triangle& t1, const Triangle& t2, Point3d& cp1, Point3d& cp2);
@@ -67,6 +70,7 @@ class Triangle
   private:
 
     void determine_params(const Point3d& x, double& s, double& t) const;
+    static double calc_sq_dist_from_coeffs(double A00, double A01, double A11, double B0, double B1, double C, double det, double& s, double& t);
     static double calc_sq_dist(const Point3d& origin, const Ravelin::Vector3d& dir, const LineSeg3& seg, Point3d& cp_line, Point3d& cp_seg, double& t_line, double& t_seg);
     static Ravelin::LinAlgd _LA;
 }; // end class
@@ -12,6 +12,7 @@
 #include <iostream>
 #include <cmath>
 #include <list>
+#include <set>
 #include <string>
 #include <Moby/Types.h>
 #include <Moby/Primitive.h>
@@ -21,7 +22,8 @@ namespace Moby {
 /// Represents a triangle mesh "primitive" for inertia properties, collision detection, and visualization
 class TriangleMeshPrimitive : public Primitive
 {
-  public: 
+  public:
+    enum BVTreeType { eOBBTree, eSSRTree, eSSLTree };
     TriangleMeshPrimitive();
     TriangleMeshPrimitive(const std::string& filename, bool center = true);
     TriangleMeshPrimitive(const std::string& filename, const Ravelin::Pose3d& T, bool center = true);
@@ -30,9 +32,22 @@ class TriangleMeshPrimitive : public Primitive
     virtual double get_bounding_radius() const { return 0.0; }
     /// Gets the length of an edge in the mesh above which point sub-samples are created
     double get_edge_sample_length() const { return _edge_sample_length; }
+    void set_refit_enabled(bool enabled);
+    /// Gets whether pose updates refit the existing BV hierarchy instead of rebuilding it
+    bool get_refit_enabled() const { return _refit_enabled; }
+    void set_refit_fatness_tol(double tol);
+    /// Gets the root volume growth ratio above which a refitted hierarchy is lazily rebuilt
+    double get_refit_fatness_tol() const { return _refit_fatness_tol; }
+    void set_BV_tree_type(BVTreeType type);
+    /// Gets the bounding volume type used for this primitive's hierarchies
+    BVTreeType get_BV_tree_type() const { return _bv_tree_type; }
+    void optimize_BVH_layout(CollisionGeometryPtr geom);
+    virtual unsigned long calc_memory_usage() const;
 
     virtual double calc_signed_dist(const Point3d& p) const;
-    virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);  
+    virtual bool ray_cast(const Point3d& origin, const Ravelin::Vector3d& dir, double max_dist, double& t, Ravelin::Vector3d& normal) const;
+    virtual void ray_cast(const Point3d* origins, const Ravelin::Vector3d* dirs, unsigned n, double max_dist, double* t, Ravelin::Vector3d* normals) const;
+    virtual void load_from_xml(boost::shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map);
     virtual void save_to_xml(XMLTreePtr node, std::list<boost::shared_ptr<const Base> >& shared_objects) const;
     virtual BVPtr get_BVH_root(CollisionGeometryPtr geom);
     virtual void get_vertices(boost::shared_ptr<const Ravelin::Pose3d> P, std::vector<Point3d>& vertices) const;
@@ -63,6 +78,21 @@ class TriangleMeshPrimitive : public Primitive
     /// Edge sample length above which pseudo-vertices are added
     double _edge_sample_length;
 
+    /// If true, pose updates refit the existing BV hierarchies rather than rebuilding them
+    bool _refit_enabled;
+
+    /// Ratio of refitted root volume to as-built root volume above which a rebuild is triggered
+    double _refit_fatness_tol;
+
+    /// The bounding volume type used to build hierarchies (see set_BV_tree_type())
+    BVTreeType _bv_tree_type;
+
+    /// Root volume of each hierarchy when it was last built (for the fatness test)
+    std::map<CollisionGeometryPtr, double> _build_volumes;
+
+    /// Geometries whose hierarchies have degraded past the fatness tolerance and await rebuild
+    std::set<CollisionGeometryPtr> _needs_rebuild;
+
     /// Thick triangle structure augmented with mesh data
     class AThickTri : public ThickTriangle
     {
@@ -73,9 +103,12 @@ class TriangleMeshPrimitive : public Primitive
     };
 
     void construct_mesh_vertices(boost::shared_ptr<const IndexedTriArray> mesh, CollisionGeometryPtr geom);
+    BVPtr fit_BV(const std::vector<Point3d>& points) const;
+    void get_split_axes(BVPtr bv, Ravelin::Vector3d axes[3]) const;
     void build_BB_tree(CollisionGeometryPtr geom);
+    void refit_BB_tree(CollisionGeometryPtr geom, const Ravelin::Transform3d& T);
     void split_tris(const Point3d& point, const Ravelin::Vector3d& normal, const IndexedTriArray& orig_mesh, const std::list<unsigned>& ofacets, std::list<unsigned>& pfacets, std::list<unsigned>& nfacets);
-    bool split(boost::shared_ptr<const IndexedTriArray> mesh, BVPtr source, BVPtr& tgt1, BVPtr& tgt2, const Ravelin::Vector3d& axis);
+    bool split(boost::shared_ptr<const IndexedTriArray> mesh, BVPtr source, const std::list<unsigned>& stris, BVPtr& tgt1, BVPtr& tgt2, std::list<unsigned>& ptris, std::list<unsigned>& ntris, const Ravelin::Vector3d& axis) const;
 
     template <class InputIterator, class OutputIterator>
     static OutputIterator get_vertices(const IndexedTriArray& tris, InputIterator fselect_begin, InputIterator fselect_end, OutputIterator output, boost::shared_ptr<const Ravelin::Pose3d> P);
@@ -23,6 +23,7 @@ namespace Moby {
 class BoxPrimitive;
 class SpherePrimitive;
 class CylinderPrimitive;
+class CapsulePrimitive;
 class TriangleMeshPrimitive;
 class Simulator;
 class RigidBody;
@@ -53,6 +54,8 @@ class URDFReader
         std::map<std::string, std::pair<Ravelin::VectorNd, std::string> > materials;
     };
 
+    static void compile_model(URDFData& data, std::vector<RigidBodyPtr>& links, std::vector<JointPtr>& joints);
+    static unsigned joint_type_block(JointPtr joint);
     static void find_outboards(const URDFData& data, RigidBodyPtr link, std::vector<std::pair<JointPtr, RigidBodyPtr> >& outboards, std::map<RigidBodyPtr, RigidBodyPtr>& parents);
     static void output_data(const URDFData& data, RigidBodyPtr link);
     static JointPtr find_joint(const URDFData& data, RigidBodyPtr outboard_link);
@@ -65,6 +68,7 @@ class URDFReader
     static boost::shared_ptr<SpherePrimitive> read_sphere(boost::shared_ptr<const XMLTree> node, URDFData& data);
     static boost::shared_ptr<BoxPrimitive> read_box(boost::shared_ptr<const XMLTree> node, URDFData& data);
     static boost::shared_ptr<CylinderPrimitive> read_cylinder(boost::shared_ptr<const XMLTree> node, URDFData& data);
+    static boost::shared_ptr<CapsulePrimitive> read_capsule(boost::shared_ptr<const XMLTree> node, URDFData& data);
     static Ravelin::Matrix3d read_inertia(boost::shared_ptr<const XMLTree> node, URDFData& data);
     static double read_mass(boost::shared_ptr<const XMLTree> node, URDFData& data);
     static Ravelin::Pose3d read_origin(boost::shared_ptr<const XMLTree> node, URDFData& data);
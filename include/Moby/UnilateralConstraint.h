@@ -9,6 +9,7 @@
 
 #include <iostream>
 #include <list>
+#include <vector>
 #include <Ravelin/Vector3d.h>
 #include <Ravelin/SForced.h>
 #include <Ravelin/DynamicBodyd.h>
@@ -31,10 +32,13 @@ class UnilateralConstraint
     enum UnilateralConstraintClass { ePositive, eZero, eNegative };
     enum Compliance { eRigid, eCompliant};
     UnilateralConstraint();
-    UnilateralConstraint(const UnilateralConstraint& e) { _contact_frame = boost::shared_ptr<Ravelin::Pose3d>(new Ravelin::Pose3d); *this = e; }
+    UnilateralConstraint(const UnilateralConstraint& e) { _contact_frame = acquire_contact_frame(); *this = e; }
+    ~UnilateralConstraint() { release_contact_frame(_contact_frame); }
     static void determine_connected_constraints(const std::vector<UnilateralConstraint>& constraints, const std::vector<JointPtr>& implicit_joints, std::list<std::pair<std::list<UnilateralConstraint*>, std::list<boost::shared_ptr<Ravelin::SingleBodyd> > > >& groups, std::list<std::vector<boost::shared_ptr<Ravelin::DynamicBodyd> > >& remaining_islands);
     static void remove_inactive_groups(std::list<std::pair<std::list<UnilateralConstraint*>, std::list<boost::shared_ptr<Ravelin::SingleBodyd> > > >& groups);
+    static void invalidate_inverse_inertias();
     UnilateralConstraint& operator=(const UnilateralConstraint& e);
+    void swap(UnilateralConstraint& e);
     double calc_contact_vel(const Ravelin::Vector3d& v) const;
     double calc_constraint_vel() const;
     double calc_constraint_tol() const;
@@ -66,6 +70,15 @@ class UnilateralConstraint
     /// Signed violation for this constraint
     double signed_violation;
 
+    /// Allowed approach speed along the normal (for speculative contacts)
+    /**
+     * Nonzero only for contacts generated ahead of the time of impact: the
+     * impact solver credits this speed to the normal constraint velocity,
+     * so only approach in excess of it -- which would carry the pair past
+     * the surface within the step -- is removed.
+     */
+    double contact_approach_vel;
+
     /// The coefficient of restitution for this limit
     double limit_epsilon;
 
@@ -107,6 +120,12 @@ class UnilateralConstraint
     /// The coefficient of viscous friction (for contact constraints)
     double contact_mu_viscous;
 
+    /// The coefficient of torsional friction about the normal (for contact constraints)
+    double contact_mu_torsional;
+
+    /// The coefficient of rolling friction (for contact constraints)
+    double contact_mu_rolling;
+
     /// Penalty Method Depth Penalty
     double contact_penalty_Kp;
     
@@ -138,9 +157,22 @@ class UnilateralConstraint
 
     // static variables
     boost::shared_ptr<Ravelin::Pose3d> _contact_frame;
+
+    // free list of recycled contact frames; constraints are created and
+    // destroyed by the hundreds per step, and the contact frame is their only
+    // dynamically allocated member, so pooling it makes steady-state
+    // construction allocation-free
+    static std::vector<boost::shared_ptr<Ravelin::Pose3d> > _frame_pool;
+    static boost::shared_ptr<Ravelin::Pose3d> acquire_contact_frame();
+    static void release_contact_frame(boost::shared_ptr<Ravelin::Pose3d>& frame);
     static Ravelin::MatrixNd JJ, J, Jx, Jy, J1, J2, dJ1, dJ2, workM1, workM2;
     static Ravelin::VectorNd v, workv, workv2;
 
+    // cached generalized inverse inertias, keyed by super body; valid until
+    // invalidate_inverse_inertias() is called (i.e., until positions change)
+    static std::map<boost::shared_ptr<Ravelin::DynamicBodyd>, Ravelin::MatrixNd> _inv_inertias;
+    static const Ravelin::MatrixNd& get_inverse_inertia(boost::shared_ptr<Ravelin::DynamicBodyd> su);
+
     void compute_cross_contact_contact_constraint_data(const UnilateralConstraint& e, Ravelin::MatrixNd& M) const;
     void compute_cross_contact_contact_constraint_data(const UnilateralConstraint& e, Ravelin::MatrixNd& M, boost::shared_ptr<Ravelin::DynamicBodyd> su) const;
     void compute_cross_contact_contact_constraint_data(const UnilateralConstraint& e, Ravelin::MatrixNd& M, boost::shared_ptr<Ravelin::DynamicBodyd> su, const Ravelin::MatrixNd& J) const;
@@ -156,6 +188,9 @@ class UnilateralConstraint
 
 std::ostream& operator<<(std::ostream& out, const UnilateralConstraint& e);
 
+/// ADL overload so swap-based algorithms exchange constraints without copying or allocating
+inline void swap(UnilateralConstraint& e1, UnilateralConstraint& e2) { e1.swap(e2); }
+
 #include "UnilateralConstraint.inl"
 
 } // end namespace Moby
@@ -1,6 +1,7 @@
 #ifndef _MOBY_EVENT_PROBLEM_DATA_H
 #define _MOBY_EVENT_PROBLEM_DATA_H
 
+#include <algorithm>
 #include <boost/foreach.hpp>
 #include <vector>
 #include <Ravelin/MatrixNd.h>
@@ -20,6 +21,9 @@ struct UnilateralConstraintProblemData
   // setup reasonable defaults
   UnilateralConstraintProblemData()
   {
+    // capacities survive reset() so the backing stores are never released
+    _NC_cap = _NL_cap = _NEQ_cap = _NGC_cap = 0;
+
     reset();
   }
 
@@ -181,6 +185,77 @@ struct UnilateralConstraintProblemData
     Cdot_iM_LT.resize(0,0);
   }
 
+  // reserves storage for a problem of the given dimensions
+  /**
+   * Sizes every matrix and vector member for a problem with NC contacts,
+   * NL limits, NEQ implicit constraint equations and NGC generalized
+   * coordinates. Ravelin matrices and vectors keep their backing stores on
+   * shrinking resizes, so a persistent problem data object that has been
+   * reserved behaves as a monotonically growing arena: all subsequent
+   * resizes at or below the reserved dimensions allocate nothing. The
+   * dimensions are high-water marked, so calling this on every impact event
+   * touches memory only when the problem outgrows the arena.
+   */
+  void reserve(unsigned NC, unsigned NL, unsigned NEQ, unsigned NGC)
+  {
+    // see whether the arena is already large enough
+    if (NC <= _NC_cap && NL <= _NL_cap && NEQ <= _NEQ_cap && NGC <= _NGC_cap)
+      return;
+
+    // update the high-water marks
+    _NC_cap = std::max(NC, _NC_cap);
+    _NL_cap = std::max(NL, _NL_cap);
+    _NEQ_cap = std::max(NEQ, _NEQ_cap);
+    _NGC_cap = std::max(NGC, _NGC_cap);
+
+    // grow the cross-constraint terms
+    Cn_X_CnT.resize(_NC_cap, _NC_cap);
+    Cn_X_CsT.resize(_NC_cap, _NC_cap);
+    Cn_X_CtT.resize(_NC_cap, _NC_cap);
+    Cn_X_LT.resize(_NC_cap, _NL_cap);
+    Cn_X_JxT.resize(_NC_cap, _NEQ_cap);
+    Cs_X_CsT.resize(_NC_cap, _NC_cap);
+    Cs_X_CtT.resize(_NC_cap, _NC_cap);
+    Cs_X_LT.resize(_NC_cap, _NL_cap);
+    Cs_X_JxT.resize(_NC_cap, _NEQ_cap);
+    Ct_X_CtT.resize(_NC_cap, _NC_cap);
+    Ct_X_LT.resize(_NC_cap, _NL_cap);
+    Ct_X_JxT.resize(_NC_cap, _NEQ_cap);
+    L_X_LT.resize(_NL_cap, _NL_cap);
+    L_X_JxT.resize(_NL_cap, _NEQ_cap);
+    Jx_X_JxT.resize(_NEQ_cap, _NEQ_cap);
+
+    // grow the bilateral constraint inertia terms
+    iM_JxT.resize(_NGC_cap, _NEQ_cap);
+    Jx_iM_JxT.resize(_NEQ_cap, _NEQ_cap);
+
+    // grow X times the Jacobian transposes
+    X_CnT.resize(_NGC_cap, _NC_cap);
+    X_CsT.resize(_NGC_cap, _NC_cap);
+    X_CtT.resize(_NGC_cap, _NC_cap);
+    X_LT.resize(_NGC_cap, _NL_cap);
+    X_JxT.resize(_NGC_cap, _NEQ_cap);
+
+    // grow the Cdot Jacobians
+    Cdot_iM_CnT.resize(_NC_cap, _NC_cap);
+    Cdot_iM_CsT.resize(_NC_cap, _NC_cap);
+    Cdot_iM_CtT.resize(_NC_cap, _NC_cap);
+    Cdot_iM_LT.resize(_NC_cap, _NL_cap);
+    Cdot_v.resize(_NC_cap);
+
+    // grow the vector-based terms and impulse magnitudes
+    Cn_v.resize(_NC_cap);
+    Cs_v.resize(_NC_cap);
+    Ct_v.resize(_NC_cap);
+    L_v.resize(_NL_cap);
+    Jx_v.resize(_NEQ_cap);
+    cn.resize(_NC_cap);
+    cs.resize(_NC_cap);
+    ct.resize(_NC_cap);
+    l.resize(_NL_cap);
+    lambda.resize(_NEQ_cap);
+  }
+
   // sets up indices for a QP
   void set_qp_indices()
   {
@@ -393,6 +468,10 @@ struct UnilateralConstraintProblemData
 
   // a pointer to the simulator
   boost::shared_ptr<Simulator> simulator;
+
+  private:
+    // arena high-water marks (see reserve())
+    unsigned _NC_cap, _NL_cap, _NEQ_cap, _NGC_cap;
 }; // end struct
 
 } // end namespace Moby
@@ -0,0 +1,45 @@
+/****************************************************************************
+ * Copyright 2005 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#ifndef _MOBY_VALIDATION_H
+#define _MOBY_VALIDATION_H
+
+#include <cassert>
+
+/// The tier of defensive checks compiled into Moby
+/**
+ * Levels (normally set through the VALIDATION_LEVEL CMake variable):
+ * <ul>
+ * <li>2 (default): all checks, including per-element checks inside hot
+ *     kernels (per-constraint frame verifications, per-iteration topology
+ *     checks, finiteness checks)</li>
+ * <li>1: boundary checks only; per-element checks inside designated hot
+ *     kernels compile out</li>
+ * <li>0: all tiered checks compile out</li>
+ * </ul>
+ * Both tiers expand to assert(), so NDEBUG disables them regardless of
+ * the level.
+ */
+#ifndef MOBY_VALIDATION_LEVEL
+#define MOBY_VALIDATION_LEVEL 2
+#endif
+
+// boundary validation: executed once per API call, outside of inner loops
+#if MOBY_VALIDATION_LEVEL >= 1
+#define MOBY_CHECK_BOUNDARY(expr) assert(expr)
+#else
+#define MOBY_CHECK_BOUNDARY(expr) ((void) 0)
+#endif
+
+// per-element validation: executed inside hot loops or once per constraint
+// per solver iteration; compiled out at validation level 1 and below
+#if MOBY_VALIDATION_LEVEL >= 2
+#define MOBY_CHECK_HOT(expr) assert(expr)
+#else
+#define MOBY_CHECK_HOT(expr) ((void) 0)
+#endif
+
+#endif
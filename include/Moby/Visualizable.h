@@ -31,8 +31,9 @@ class Visualizable : public virtual Base
   public:
     Visualizable();
     Visualizable(const Visualizable* v) : Base(v) { }
-    virtual ~Visualizable(); 
+    virtual ~Visualizable();
     virtual void update_visualization();
+    virtual void snapshot_visualization(std::vector<std::pair<OSGGroupWrapperPtr, Ravelin::Pose3d> >& poses);
     void set_visualization_relative_pose(const Ravelin::Pose3d& P);
     virtual void set_visualization_data(osg::Node* vdata); 
     virtual void set_visualization_data(OSGGroupWrapperPtr vdata); 
@@ -11,6 +11,7 @@
 #include <list>
 #include <string>
 #include <set>
+#include <vector>
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 #include <Ravelin/Origin3d.h>
@@ -64,12 +65,20 @@ class XMLAttrib
     void get_vector_value(Ravelin::SVector6d& v);
     void get_matrix_value(Ravelin::Matrix3d& m);
     void get_matrix_value(Ravelin::MatrixNd& m);
-    bool operator==(const XMLAttrib& a) const { return name == a.name; }
-    bool operator<(const XMLAttrib& a) const { return name < a.name; }
+    bool operator==(const XMLAttrib& a) const { return name_id == a.name_id; }
+    bool operator<(const XMLAttrib& a) const { return name_id < a.name_id; }
+    static unsigned intern(const std::string& name);
 
     /// The name of the attribute
     std::string name;
 
+    /// The interned id of the name (equal ids exactly when names are equal)
+    /**
+     * Attribute sets order on this id, so get_attrib() lookups compare
+     * integers rather than strings (see intern()).
+     */
+    unsigned name_id;
+
     /// The value in string form
     std::string value;
 
@@ -84,6 +93,8 @@ class XMLTree : public boost::enable_shared_from_this<XMLTree>
     XMLTree(const std::string& name);
     XMLTree(const std::string& name, const std::list<XMLAttrib>& attributes);
     static boost::shared_ptr<const XMLTree> read_from_xml(const std::string& name);
+    static boost::shared_ptr<const XMLTree> read_from_binary(const std::string& fname);
+    static bool write_to_binary(const std::string& fname, boost::shared_ptr<const XMLTree> tree);
     XMLAttrib* get_attrib(const std::string& attrib_name) const;
     std::list<boost::shared_ptr<const XMLTree> > find_child_nodes(const std::string& name) const;
     std::list<boost::shared_ptr<const XMLTree> > find_child_nodes(const std::list<std::string>& name) const;
@@ -101,8 +112,8 @@ class XMLTree : public boost::enable_shared_from_this<XMLTree>
     /// The set of attributes of this node
     std::set<XMLAttrib> attribs;  
 
-    /// The list of children of this node
-    std::list<XMLTreePtr> children;
+    /// The children of this node, in document order (flat for cache-friendly iteration)
+    std::vector<XMLTreePtr> children;
 
     /// The name of this node
     std::string name;
@@ -1,6 +1,6 @@
 /****************************************************************************
  * Copyright 2007 Evan Drumwright
- * This library is distributed under the terms of the Apache V2.0 
+ * This library is distributed under the terms of the Apache V2.0
  * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
  ****************************************************************************/
 
@@ -8,17 +8,60 @@
 #define _MOBY_XML_WRITER_H
 
 #include <list>
+#include <map>
 #include <string>
+#include <utility>
+#include <pthread.h>
 #include <Moby/Types.h>
 
 namespace Moby {
 
 /// Class for writing Base objects (and their derivatives) to XML
+/**
+ * The static serialize_to_xml() methods serialize a full object graph
+ * synchronously.  An XMLWriter instance additionally supports periodic state
+ * dumps during long runs: serialize_incremental() re-serializes only the
+ * objects whose modification stamps have moved since the instance's last
+ * dump (see Base::get_generation()), reuses the cached subtrees for the
+ * rest, and hands the assembled document to a background thread for
+ * rendering and disk I/O, so the caller pays for the diff rather than for a
+ * full save plus the write.
+ */
 class XMLWriter
 {
   public:
+    XMLWriter();
+    ~XMLWriter();
     static void serialize_to_xml(const std::string& filename, const std::list<boost::shared_ptr<const Base> >& objects);
     static void serialize_to_xml(const std::string& filename, boost::shared_ptr<const Base> object);
+    void serialize_incremental(const std::string& filename, const std::list<boost::shared_ptr<const Base> >& objects);
+    void serialize_incremental(const std::string& filename, boost::shared_ptr<const Base> object);
+    void wait_for_pending_writes();
+
+  private:
+    /// A cached serialization of one object
+    struct CacheEntry
+    {
+      unsigned long generation;                         // the object's stamp at capture
+      XMLTreePtr node;                                  // the serialized subtree
+      std::list<boost::shared_ptr<const Base> > deps;   // the objects the subtree references
+    };
+
+    static void* write_worker(void* arg);
+
+    /// Subtrees captured by the last incremental dump, keyed on object
+    std::map<boost::shared_ptr<const Base>, CacheEntry> _cache;
+
+    /// Documents awaiting the writer thread, oldest first
+    std::list<std::pair<std::string, XMLTreePtr> > _queue;
+
+    // the background writer thread and its synchronization state
+    pthread_t _thread;
+    bool _thread_running;
+    bool _busy;
+    bool _shutdown;
+    pthread_mutex_t _mutex;
+    pthread_cond_t _cond;
 };
 
 } // end namespace
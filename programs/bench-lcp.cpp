@@ -0,0 +1,131 @@
+/*****************************************************************************
+ * Benchmarks the LCP solver variants on captured contact problems
+ *****************************************************************************/
+
+#include <sys/time.h>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <Moby/LCP.h>
+
+using Ravelin::MatrixNd;
+using Ravelin::VectorNd;
+using namespace Moby;
+
+/// The number of solver variants benchmarked
+const unsigned N_SOLVERS = 4;
+
+/// The names of the solver variants
+const char* SOLVER_NAMES[N_SOLVERS] = { "lcp_fast", "lcp_fast_regularized", "lcp_lemke", "lcp_lemke_regularized" };
+
+/// Per-solver statistics accumulated over all problems
+struct SolverStats
+{
+  SolverStats() { problems = failures = pivots = 0; total_time = max_time = 0.0; }
+
+  unsigned problems;    // number of problems attempted
+  unsigned failures;    // number of problems the solver failed on
+  unsigned pivots;      // total pivots over all problems
+  double total_time;    // total wall time (seconds)
+  double max_time;      // maximum wall time on a single problem (seconds)
+};
+
+/// Gets the current wall time (in seconds)
+double get_wall_time()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double) tv.tv_sec + (double) tv.tv_usec * 1e-6;
+}
+
+/// Runs one solver variant on one problem, updating its statistics
+void run_solver(unsigned solver, LCP& lcp, const MatrixNd& M, const VectorNd& q, SolverStats& stats)
+{
+  VectorNd z;
+
+  // solve the problem, timing the solve
+  double start = get_wall_time();
+  bool success;
+  switch (solver)
+  {
+    case 0:  success = lcp.lcp_fast(M, q, z); break;
+    case 1:  success = lcp.lcp_fast_regularized(M, q, z); break;
+    case 2:  success = lcp.lcp_lemke(M, q, z); break;
+    default: success = lcp.lcp_lemke_regularized(M, q, z); break;
+  }
+  double elapsed = get_wall_time() - start;
+
+  // update the statistics
+  stats.problems++;
+  if (!success)
+    stats.failures++;
+  stats.pivots += lcp.get_pivots();
+  stats.total_time += elapsed;
+  stats.max_time = std::max(stats.max_time, elapsed);
+}
+
+int main(int argc, char* argv[])
+{
+  // check that syntax ok
+  if (argc < 2)
+  {
+    std::cerr << "syntax: moby-bench-lcp <file>+" << std::endl;
+    std::cerr << "  where each <file> is a captured LCP written by Moby" << std::endl;
+    std::cerr << "  (set MOBY_LCP_CAPTURE_PREFIX to capture problems from a live run)" << std::endl;
+    return -1;
+  }
+
+  // setup the solver and the statistics
+  LCP lcp;
+  std::vector<SolverStats> stats(N_SOLVERS);
+
+  // process each captured problem in turn
+  unsigned n_loaded = 0;
+  for (int i=1; i< argc; i++)
+  {
+    // read the problem
+    std::ifstream in(argv[i]);
+    MatrixNd M;
+    VectorNd q;
+    if (!in || !LCP::read_lcp(M, q, in))
+    {
+      std::cerr << "moby-bench-lcp: unable to read LCP from " << argv[i] << std::endl;
+      continue;
+    }
+    n_loaded++;
+
+    // run each solver variant on the problem
+    for (unsigned j=0; j< N_SOLVERS; j++)
+      run_solver(j, lcp, M, q, stats[j]);
+  }
+
+  // look for no problems loaded
+  if (n_loaded == 0)
+  {
+    std::cerr << "moby-bench-lcp: no problems loaded" << std::endl;
+    return -1;
+  }
+
+  // output the per-solver statistics
+  std::cout << n_loaded << " problem(s) loaded" << std::endl << std::endl;
+  std::cout << std::left << std::setw(24) << "solver"
+            << std::right << std::setw(10) << "failures"
+            << std::setw(12) << "fail rate"
+            << std::setw(10) << "pivots"
+            << std::setw(14) << "mean time (s)"
+            << std::setw(14) << "max time (s)" << std::endl;
+  for (unsigned j=0; j< N_SOLVERS; j++)
+  {
+    const SolverStats& s = stats[j];
+    std::cout << std::left << std::setw(24) << SOLVER_NAMES[j]
+              << std::right << std::setw(10) << s.failures
+              << std::setw(12) << std::fixed << std::setprecision(4) << ((double) s.failures / s.problems)
+              << std::setw(10) << s.pivots
+              << std::setw(14) << std::scientific << std::setprecision(3) << (s.total_time / s.problems)
+              << std::setw(14) << s.max_time << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,48 @@
+#!/bin/bash
+
+# repeatability check for the deterministic parallel mode: runs moby-regress
+# on the given scene(s) under several thread counts and verifies that the
+# recorded trajectories are bitwise identical (zero tolerance in
+# moby-compare-trajs); build Moby with -DDETERMINISTIC_PARALLEL=ON and
+# -DOMP=ON before running this
+
+usage()
+{
+  echo "check-determinism.sh <path to Moby build> <regress options file> <scene xml> [scene xml ...]"
+  exit 1
+}
+
+# check for proper number of arguments
+[ "$#" -lt 3 ] && usage
+
+BUILD_PATH=$1
+OPTIONS_FILE=$2
+shift 2
+
+THREAD_COUNTS="1 2 4 8"
+FAILURES=0
+TMPDIR=$(mktemp -d)
+trap "rm -rf $TMPDIR" EXIT
+
+for scene in "$@"; do
+  base=$(basename $scene .xml)
+
+  # generate the reference trajectory single-threaded, then once more to
+  # catch run-to-run nondeterminism before varying the thread count
+  ref=$TMPDIR/$base-ref.out
+  OMP_NUM_THREADS=1 $BUILD_PATH/moby-regress $OPTIONS_FILE $scene $ref || { echo "$base: regress failed"; FAILURES=1; continue; }
+
+  for nthreads in $THREAD_COUNTS; do
+    out=$TMPDIR/$base-$nthreads.out
+    OMP_NUM_THREADS=$nthreads $BUILD_PATH/moby-regress $OPTIONS_FILE $scene $out || { echo "$base: regress failed with $nthreads threads"; FAILURES=1; continue; }
+    if $BUILD_PATH/moby-compare-trajs $ref $out 0.0 > /dev/null; then
+      echo "$base: $nthreads thread(s) ok"
+    else
+      echo "$base: trajectory differs with $nthreads thread(s)"
+      FAILURES=1
+    fi
+  done
+done
+
+[ $FAILURES -eq 0 ] && echo "all trajectories reproduced exactly"
+exit $FAILURES
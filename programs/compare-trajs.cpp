@@ -11,6 +11,120 @@
 static const unsigned BUF_SIZE = 100000;
 static char buffer[BUF_SIZE];
 
+// the magic for binary trajectories written by driver (-traj=)
+static const char TRAJ_MAGIC[8] = { 'M','o','b','y','T','r','j','1' };
+
+// determines whether a file is a binary trajectory
+bool is_binary_traj(const char* fname)
+{
+  std::ifstream in(fname, std::ios::binary);
+  char magic[8];
+  in.read(magic, sizeof(magic));
+  return !in.fail() && memcmp(magic, TRAJ_MAGIC, sizeof(magic)) == 0;
+}
+
+// NOTE: compares using l-inf norm
+double comp(const std::vector<double>& v1, const std::vector<double>& v2);
+
+// streams two binary trajectories frame-by-frame, comparing in constant memory
+/**
+ * Production trajectories run to tens of GB, so neither file is ever held in
+ * memory: frames are read in lockstep into two reusable buffers.  Errors are
+ * also accumulated over windows of frames (max and RMS of the per-frame
+ * l-inf differences), and the worst window is reported so a transient
+ * divergence is localizable without rereading the file.  Reading stops at
+ * the first frame that exceeds the tolerance.
+ */
+int compare_binary_trajs(const char* fname1, const char* fname2, double tol, unsigned window)
+{
+  // open both files and skip the magic
+  std::ifstream in1(fname1, std::ios::binary);
+  std::ifstream in2(fname2, std::ios::binary);
+  char magic[8];
+  in1.read(magic, sizeof(magic));
+  in2.read(magic, sizeof(magic));
+
+  // read and verify the frame strides
+  unsigned stride1 = 0, stride2 = 0;
+  in1.read((char*) &stride1, sizeof(stride1));
+  in2.read((char*) &stride2, sizeof(stride2));
+  if (in1.fail() || in2.fail() || stride1 == 0 || stride1 != stride2)
+  {
+    std::cerr << "compare-trajs: trajectory strides unreadable or unequal" << std::endl;
+    return -1;
+  }
+
+  // stream fixed-stride frames in lockstep until end-of-file
+  std::vector<double> f1(stride1), f2(stride2);
+  double max_diff = 0.0;
+  double win_max = 0.0, win_sumsq = 0.0;
+  double worst_win_max = 0.0, worst_win_rms = 0.0;
+  unsigned long worst_win_start = 0, win_start = 0, frame = 0;
+  while (true)
+  {
+    in1.read((char*) &f1.front(), sizeof(double)*stride1);
+    in2.read((char*) &f2.front(), sizeof(double)*stride2);
+    if (in1.eof() || in2.eof())
+    {
+      if (!in1.eof() || !in2.eof())
+      {
+        std::cerr << "compare-trajs: unequal numbers of frames" << std::endl;
+        return -1;
+      }
+      break;
+    }
+    if (in1.fail() || in2.fail())
+    {
+      std::cerr << "compare-trajs: unable to read one or both trajectories" << std::endl;
+      return -1;
+    }
+
+    // compare the frames (time plus coordinates)
+    double diff = comp(f1, f2);
+    max_diff = std::max(max_diff, diff);
+    win_max = std::max(win_max, diff);
+    win_sumsq += diff*diff;
+
+    // stop reading at the first frame past tolerance
+    if (diff > tol)
+    {
+      std::cerr << "compare-trajs: tolerance exceeded at frame " << frame << " (t=" << f1.front() << "): " << diff << std::endl;
+      return -1;
+    }
+
+    // close out the window
+    frame++;
+    if (frame - win_start == window)
+    {
+      if (win_max > worst_win_max)
+      {
+        worst_win_max = win_max;
+        worst_win_rms = std::sqrt(win_sumsq/window);
+        worst_win_start = win_start;
+      }
+      win_max = win_sumsq = 0.0;
+      win_start = frame;
+    }
+  }
+
+  // close out any partial final window
+  if (frame > win_start && win_max > worst_win_max)
+  {
+    worst_win_max = win_max;
+    worst_win_rms = std::sqrt(win_sumsq/(frame - win_start));
+    worst_win_start = win_start;
+  }
+
+  std::cout << "maximum difference: " << max_diff << std::endl;
+  if (frame > 0)
+  {
+    std::cout << "worst window (frames " << worst_win_start << ".." << std::min((unsigned long) (worst_win_start + window), frame) - 1 << "): ";
+    std::cout << "max " << worst_win_max << "  rms " << worst_win_rms << std::endl;
+  }
+
+  return (max_diff > tol) ? -1 : 0;
+}
+
 unsigned count_lines(char* fname)
 {
   std::ifstream in(fname);
@@ -99,6 +213,22 @@ int main(int argc, char* argv[])
   if (argc < 4)
     return -1;
 
+  // binary trajectories (written by driver with -traj=) stream; an optional
+  // fourth argument sets the metric window size in frames
+  if (is_binary_traj(argv[1]) || is_binary_traj(argv[2]))
+  {
+    if (!is_binary_traj(argv[1]) || !is_binary_traj(argv[2]))
+    {
+      std::cerr << "compare-trajs: cannot compare a binary trajectory against a text one" << std::endl;
+      return -1;
+    }
+
+    unsigned window = (argc > 4) ? std::atoi(argv[4]) : 1000;
+    if (window == 0)
+      window = 1;
+    return compare_binary_trajs(argv[1], argv[2], std::atof(argv[3]), window);
+  }
+
   // read the two files
   std::ifstream in1(argv[1]);
   std::ifstream in2(argv[2]);
@@ -1,7 +1,7 @@
 #include <getopt.h>
 #include <boost/foreach.hpp>
 #include <Moby/Polyhedron.h>
-#include <Moby/sorted_pair>
+#include <Ravelin/sorted_pair>
 #include <Moby/CompGeom.h>
 #include <string>
 #include <queue>
@@ -384,7 +384,7 @@ double dist = -1.0;
     g_color = (double) rand() / RAND_MAX;
     b_color = (double) rand() / RAND_MAX;
     out << "# halfspace: " << _positive << std::endl;
-    Polyhedron::to_vrml(out, *hs_isect, Point3d(r_color, g_color, b_color), true);
+    Polyhedron::to_vrml(out, *hs_isect, Origin3d(r_color, g_color, b_color), true);
     out << std::endl;
   }
 
@@ -416,7 +416,7 @@ double dist = -1.0;
     g_color = (double) rand() / RAND_MAX;
     b_color = (double) rand() / RAND_MAX;
     out << "# halfspace: " << _negative << std::endl;
-    Polyhedron::to_vrml(out, *hs_isect, Point3d(r_color, g_color, b_color), true);
+    Polyhedron::to_vrml(out, *hs_isect, Origin3d(r_color, g_color, b_color), true);
     out << std::endl;
   }
 
@@ -1378,7 +1378,8 @@ int main(int argc, char* argv[])
   std::list<BSP*> leafs = bsp.get_leafs();
   std::cout << leafs.size() << " leaf spaces generated" << std::endl;
 
-  // iterate over all leaf nodes
+  // gather the point sets from the leaf nodes
+  std::vector<std::vector<Point3d> > point_sets;
   unsigned index = 0;
   for (std::list<BSP*>::const_iterator i = leafs.begin(); i != leafs.end(); i++, index++)
   {
@@ -1397,37 +1398,49 @@ int main(int argc, char* argv[])
     // get the points from the BSP node
     std::list<Point3d> points = (*i)->get_points();
     points.insert(points.end(), extra_points[*i].begin(), extra_points[*i].end());
-    std::cout << "BSP #" << index << ": " << (*i) << " number of points: " << points.size();
+    std::cout << "BSP #" << index << ": " << (*i) << " number of points: " << points.size() << std::endl;
+    point_sets.push_back(std::vector<Point3d>(points.begin(), points.end()));
 
-    // make sure that the number of points is not too small
+    // point sets that are too small are degenerate; empty them so that the
+    // batch hull computation skips them
     if (points.size() < 4)
     {
       std::cout << " (< 4 points = degenerate; not writing)" << std::endl;
       std::cout << " points:" << std::endl;
       BOOST_FOREACH(const Point3d& pt, points)
         std::cout << "   " << pt << std::endl;
-      continue;
+      point_sets.back().clear();
     }
+  }
+
+  // compute the convex hulls of all pieces as a batch (processed in
+  // parallel when Moby is built with OpenMP and THREADSAFE)
+  std::cout << "computing convex hulls" << std::endl;
+  std::vector<TessellatedPolyhedronPtr> hulls;
+  CompGeom::calc_convex_hulls(point_sets, hulls);
 
-    // compute the convex hull of the points
-    PolyhedronPtr p = CompGeom::calc_convex_hull(points.begin(), points.end());
-    if (!p)
+  // write out the hulls
+  for (unsigned i=0; i< hulls.size(); i++)
+  {
+    // look for a degenerate piece
+    if (!hulls[i])
     {
-      std::cout << " (unable to calculate hull = degenerate; not writing)" << std::endl;
-      std::cout << " points:" << std::endl;
-      BOOST_FOREACH(const Point3d& pt, points)
-        std::cout << "   " << pt << std::endl;
+      if (!point_sets[i].empty())
+      {
+        std::cout << "BSP #" << i << " (unable to calculate hull = degenerate; not writing)" << std::endl;
+        std::cout << " points:" << std::endl;
+        BOOST_FOREACH(const Point3d& pt, point_sets[i])
+          std::cout << "   " << pt << std::endl;
+      }
       continue;
     }
-    else
-      std::cout << std::endl;
 
     // create the output filename
     std::ostringstream sstr;
-    sstr << fname_root << "." << index << ".obj";
+    sstr << fname_root << "." << i << ".obj";
 
     // write the OBJ file
-    p->get_mesh().write_to_obj(sstr.str());
+    hulls[i]->get_mesh().write_to_obj(sstr.str());
   }
 
   // close the BSP log
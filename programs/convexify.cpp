@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <boost/foreach.hpp>
 #include <Moby/Polyhedron.h>
 #include <Moby/CompGeom.h>
@@ -8,23 +9,42 @@ using namespace Moby;
 
 int main(int argc, char* argv[])
 {
-  if (argc != 3)
+  if (argc != 3 && !(argc == 5 && std::string(argv[1]) == "-d"))
   {
-    std::cerr << "syntax: convexify <input> <output>" << std::endl;
+    std::cerr << "syntax: convexify [-d <target-tris>] <input> <output>" << std::endl;
     std::cerr << std::endl;
     std::cerr << "convexify takes the description of a 3D geometry from the input file (a Wavefront OBJ" << std::endl;
     std::cerr << "file) and constructs a new Wavefront 3D file of the convex hull of that file." << std::endl;
+    std::cerr << "With -d, the mesh is instead decimated to (approximately) the target triangle count" << std::endl;
+    std::cerr << "using quadric error metrics; concavities are retained, so the result is suitable as" << std::endl;
+    std::cerr << "a collision proxy for concave geometry." << std::endl;
     return -1;
   }
 
+  // decimate instead of convexify, if requested
+  if (argc == 5)
+  {
+    // read in the file
+    IndexedTriArray mesh = IndexedTriArray::read_from_obj(std::string(argv[3]));
+
+    // decimate to the target triangle count
+    unsigned target_tris = (unsigned) std::atoi(argv[2]);
+    IndexedTriArray decimated = mesh.decimate(target_tris);
+    std::cerr << "convexify: decimated " << mesh.num_tris() << " triangles to " << decimated.num_tris() << std::endl;
+
+    // write the resulting mesh to the output file
+    decimated.write_to_obj(std::string(argv[4]));
+    return 0;
+  }
+
   // read in the file
-  IndexedTriArray mesh = IndexedTriArray::read_from_obj(std::string(argv[1])); 
+  IndexedTriArray mesh = IndexedTriArray::read_from_obj(std::string(argv[1]));
 
   // get the vertices
   const std::vector<Origin3d>& vertices = mesh.get_vertices();
 
   // compute the convex hull
-  TessellatedPolyhedronPtr p = CompGeom::calc_convex_hull(vertices.begin(), vertices.end());    
+  TessellatedPolyhedronPtr p = CompGeom::calc_convex_hull(vertices.begin(), vertices.end());
 
   // write the resulting mesh to the output file
   if (!p)
@@ -8,12 +8,18 @@
 #include <errno.h>
 #include <sys/time.h>
 #include <dlfcn.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <deque>
 #include <iostream>
 #include <cmath>
 #include <fstream>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string.hpp>
 #include <Ravelin/Log.h>
+#include <Ravelin/DynamicBodyd.h>
 #include <Moby/XMLTree.h>
 #include <Moby/XMLReader.h>
 #include <Moby/XMLWriter.h>
@@ -84,6 +90,10 @@ namespace Moby{
   
   /// Last pickle iteration
   int LAST_PICKLE = -1;
+
+  /// Writer for periodic pickles: diffs against the last dump and performs
+  /// the disk I/O on a background thread, so pickling does not stall stepping
+  Moby::XMLWriter PICKLER;
   
   /// Extension/format for 3D outputs (default=Wavefront obj)
   char THREED_EXT[5] = "obj";
@@ -92,6 +102,12 @@ namespace Moby{
   /// options will set to true)
   bool UPDATE_GRAPHICS = false;
   
+  /// The number of simulator instances to run in batch mode (1 = normal)
+  unsigned BATCH_SIZE = 1;
+
+  /// Steps per tight loop in headless throughput mode (0 = mode disabled)
+  unsigned THROUGHPUT_BATCH = 0;
+
   /// The maximum number of iterations (default infinity)
   unsigned MAX_ITER = std::numeric_limits<unsigned>::max();
   
@@ -114,6 +130,12 @@ namespace Moby{
   
   /// Render Contact Points
   bool RENDER_CONTACT_POINTS = false;
+
+  /// Name of the binary trajectory output file (empty = no trajectory output)
+  std::string TRAJ_FNAME;
+
+  /// Interval (in iterations) between recorded trajectory frames
+  int TRAJ_IVAL = 1;
   
   /// The map of objects read from the simulation XML file
   std::map<std::string, BasePtr> READ_MAP;
@@ -143,6 +165,284 @@ namespace Moby{
 #endif
   }
   
+  // ---------------------- binary trajectory recording ----------------------
+  // Frames of generalized coordinates are queued by the stepping thread and
+  // written to disk by a background thread over a bounded queue, so long
+  // unattended runs never stall on flushes. Format ("MobyTrj1"): the 8-byte
+  // magic, a 4-byte unsigned frame stride (doubles per frame, including the
+  // leading simulation time), then packed frames of 'stride' doubles to EOF.
+
+  /// The binary trajectory format magic
+  const char TRAJ_MAGIC[8] = { 'M','o','b','y','T','r','j','1' };
+
+  /// Maximum number of queued frames before the stepping thread blocks
+  const unsigned TRAJ_QUEUE_MAX = 1024;
+
+  /// The trajectory output file (NULL until the first frame is recorded)
+  std::FILE* TRAJ_FILE = NULL;
+
+  /// The background writer thread and the queue it drains
+  pthread_t TRAJ_THREAD;
+  pthread_mutex_t TRAJ_MUTEX = PTHREAD_MUTEX_INITIALIZER;
+  pthread_cond_t TRAJ_NOT_EMPTY = PTHREAD_COND_INITIALIZER;
+  pthread_cond_t TRAJ_NOT_FULL = PTHREAD_COND_INITIALIZER;
+  std::deque<std::vector<double> > TRAJ_QUEUE;
+  bool TRAJ_DONE = false;
+
+  /// The number of doubles per trajectory frame
+  unsigned TRAJ_STRIDE = 0;
+
+  /// Drains the trajectory queue to disk (runs on the background thread)
+  void* traj_writer_thread(void*)
+  {
+    while (true)
+    {
+      // wait for a frame (or shutdown)
+      pthread_mutex_lock(&TRAJ_MUTEX);
+      while (TRAJ_QUEUE.empty() && !TRAJ_DONE)
+        pthread_cond_wait(&TRAJ_NOT_EMPTY, &TRAJ_MUTEX);
+      if (TRAJ_QUEUE.empty())
+      {
+        pthread_mutex_unlock(&TRAJ_MUTEX);
+        return NULL;
+      }
+
+      // dequeue the frame
+      std::vector<double> frame;
+      frame.swap(TRAJ_QUEUE.front());
+      TRAJ_QUEUE.pop_front();
+      pthread_cond_signal(&TRAJ_NOT_FULL);
+      pthread_mutex_unlock(&TRAJ_MUTEX);
+
+      // write it outside the lock
+      std::fwrite(&frame.front(), sizeof(double), frame.size(), TRAJ_FILE);
+    }
+  }
+
+  /// Queues a frame of generalized coordinates for the background writer
+  void record_trajectory_frame(boost::shared_ptr<Simulator> s)
+  {
+    // assemble the frame: simulation time, then the generalized coordinates
+    // of every dynamic body, in body order
+    std::vector<double> frame;
+    frame.push_back(s->current_time);
+    Ravelin::VectorNd gc;
+    BOOST_FOREACH(ControlledBodyPtr cb, s->get_dynamic_bodies())
+    {
+      boost::shared_ptr<Ravelin::DynamicBodyd> db = boost::dynamic_pointer_cast<Ravelin::DynamicBodyd>(cb);
+      if (!db)
+        continue;
+      db->get_generalized_coordinates_euler(gc);
+      for (unsigned i=0; i< gc.size(); i++)
+        frame.push_back(gc[i]);
+    }
+
+    // on the first frame, write the header and start the writer thread
+    if (!TRAJ_FILE)
+    {
+      TRAJ_FILE = std::fopen(TRAJ_FNAME.c_str(), "wb");
+      if (!TRAJ_FILE)
+      {
+        std::cerr << "driver: unable to open trajectory file " << TRAJ_FNAME << " for writing" << std::endl;
+        TRAJ_FNAME.clear();
+        return;
+      }
+      TRAJ_STRIDE = frame.size();
+      std::fwrite(TRAJ_MAGIC, sizeof(TRAJ_MAGIC), 1, TRAJ_FILE);
+      unsigned stride = TRAJ_STRIDE;
+      std::fwrite(&stride, sizeof(stride), 1, TRAJ_FILE);
+      pthread_create(&TRAJ_THREAD, NULL, &traj_writer_thread, NULL);
+    }
+
+    // the body set is fixed, so frames are fixed stride
+    assert(frame.size() == TRAJ_STRIDE);
+
+    // queue the frame, blocking if the writer has fallen too far behind
+    pthread_mutex_lock(&TRAJ_MUTEX);
+    while (TRAJ_QUEUE.size() >= TRAJ_QUEUE_MAX)
+      pthread_cond_wait(&TRAJ_NOT_FULL, &TRAJ_MUTEX);
+    TRAJ_QUEUE.push_back(std::vector<double>());
+    TRAJ_QUEUE.back().swap(frame);
+    pthread_cond_signal(&TRAJ_NOT_EMPTY);
+    pthread_mutex_unlock(&TRAJ_MUTEX);
+  }
+
+  /// Stops the trajectory writer, draining any queued frames
+  void finish_trajectory()
+  {
+    if (!TRAJ_FILE)
+      return;
+
+    // signal shutdown and wait for the queue to drain
+    pthread_mutex_lock(&TRAJ_MUTEX);
+    TRAJ_DONE = true;
+    pthread_cond_signal(&TRAJ_NOT_EMPTY);
+    pthread_mutex_unlock(&TRAJ_MUTEX);
+    pthread_join(TRAJ_THREAD, NULL);
+
+    std::fclose(TRAJ_FILE);
+    TRAJ_FILE = NULL;
+  }
+
+  // ---------------------- asynchronous callback dispatch -------------------
+  // With the -ac option, the user callbacks installed by plugins (the
+  // post-step callback and ConstraintSimulator's post-constraint callback)
+  // run on a background thread instead of the stepping thread, so logging
+  // and telemetry callbacks no longer stall stepping.  The stepping thread
+  // packs each event into a slot of a fixed ring; the slots' buffers persist
+  // across reuse, so steady-state publication allocates nothing, and the
+  // ring indices are ordered with the same fences the co-simulation seqlock
+  // uses, so neither thread ever takes a lock (the ring is single-producer/
+  // single-consumer: only the stepping thread publishes).  Contact events
+  // carry a copied snapshot of the constraint vector, so post-constraint
+  // callbacks observe exactly what they would have synchronously, just
+  // later.  Post-step callbacks receive the live simulator while stepping
+  // continues, so under -ac they must restrict themselves to state the
+  // stepping thread does not mutate (fine for the counters and telemetry
+  // this option exists for).
+
+  /// Whether user callbacks are dispatched asynchronously (-ac option)
+  bool ASYNC_CALLBACKS = false;
+
+  /// The kinds of events dispatched to the callback thread
+  enum EventType { eEventContacts, eEventPostStep };
+
+  /// A slot in the event ring; its buffers persist so reuse does not allocate
+  struct EventSlot
+  {
+    EventType type;
+    std::vector<UnilateralConstraint> contacts;  // eEventContacts payload
+  };
+
+  /// The event ring (the size must be a power of two)
+  const unsigned EVENT_RING_SIZE = 256;
+  EventSlot EVENT_RING[EVENT_RING_SIZE];
+
+  /// Ring indices; the producer owns the head, the consumer owns the tail
+  volatile unsigned EVENT_HEAD = 0;
+  volatile unsigned EVENT_TAIL = 0;
+
+  /// The callback thread and its shutdown flag
+  pthread_t EVENT_THREAD;
+  volatile bool EVENT_DONE = false;
+
+  /// The user callbacks being deferred (saved before rerouting)
+  void (*USER_POST_STEP_FN)(Simulator*) = NULL;
+  void (*USER_CONSTRAINT_POST_FN)(const std::vector<UnilateralConstraint>&, boost::shared_ptr<void>) = NULL;
+  boost::shared_ptr<void> USER_CONSTRAINT_POST_DATA;
+
+  /// The simulator passed to deferred post-step callbacks
+  boost::shared_ptr<Simulator> EVENT_SIM;
+
+  /// Runs the deferred user callbacks (runs on the callback thread)
+  void* event_dispatch_thread(void*)
+  {
+    while (true)
+    {
+      // wait for an event (or shutdown); the poll sleep bounds the latency
+      if (EVENT_TAIL == EVENT_HEAD)
+      {
+        if (EVENT_DONE)
+          return NULL;
+        usleep(100);
+        continue;
+      }
+
+      // the slot contents were written before the head advanced
+      __sync_synchronize();
+      EventSlot& slot = EVENT_RING[EVENT_TAIL & (EVENT_RING_SIZE-1)];
+
+      // dispatch the event
+      switch (slot.type)
+      {
+        case eEventContacts:
+          (*USER_CONSTRAINT_POST_FN)(slot.contacts, USER_CONSTRAINT_POST_DATA);
+          break;
+
+        case eEventPostStep:
+          (*USER_POST_STEP_FN)(EVENT_SIM.get());
+          break;
+      }
+
+      // release the slot back to the producer
+      __sync_synchronize();
+      EVENT_TAIL = EVENT_TAIL + 1;
+    }
+  }
+
+  /// Claims the next ring slot (runs on the stepping thread)
+  EventSlot& claim_event_slot()
+  {
+    // waiting (rather than dropping) keeps the callback stream lossless;
+    // the wait only triggers if the consumer falls a full ring behind
+    while (EVENT_HEAD - EVENT_TAIL >= EVENT_RING_SIZE)
+      usleep(100);
+    return EVENT_RING[EVENT_HEAD & (EVENT_RING_SIZE-1)];
+  }
+
+  /// Publishes the claimed slot to the callback thread
+  void publish_event_slot()
+  {
+    __sync_synchronize();
+    EVENT_HEAD = EVENT_HEAD + 1;
+  }
+
+  /// The rerouted post-constraint callback (runs on the stepping thread)
+  void enqueue_constraint_post_event(const std::vector<UnilateralConstraint>& constraints, boost::shared_ptr<void>)
+  {
+    EventSlot& slot = claim_event_slot();
+    slot.type = eEventContacts;
+    slot.contacts = constraints;
+    publish_event_slot();
+  }
+
+  /// The rerouted post-step callback (runs on the stepping thread)
+  void enqueue_post_step_event(Simulator*)
+  {
+    EventSlot& slot = claim_event_slot();
+    slot.type = eEventPostStep;
+    publish_event_slot();
+  }
+
+  /// Reroutes installed user callbacks through the event ring (see -ac)
+  void start_async_callbacks(boost::shared_ptr<Simulator> s)
+  {
+    // reroute the post-step callback, if one was installed
+    if (s->post_step_callback_fn)
+    {
+      USER_POST_STEP_FN = s->post_step_callback_fn;
+      s->post_step_callback_fn = &enqueue_post_step_event;
+    }
+
+    // reroute the post-constraint callback, if one was installed; the
+    // callback data stays on the simulator and is passed from the saved
+    // copy, so the enqueue wrapper ignores its data argument
+    boost::shared_ptr<ConstraintSimulator> cs = boost::dynamic_pointer_cast<ConstraintSimulator>(s);
+    if (cs && cs->constraint_post_callback_fn)
+    {
+      USER_CONSTRAINT_POST_FN = cs->constraint_post_callback_fn;
+      USER_CONSTRAINT_POST_DATA = cs->constraint_post_callback_data;
+      cs->constraint_post_callback_fn = &enqueue_constraint_post_event;
+    }
+
+    // start the callback thread if anything was rerouted
+    if (USER_POST_STEP_FN || USER_CONSTRAINT_POST_FN)
+    {
+      EVENT_SIM = s;
+      pthread_create(&EVENT_THREAD, NULL, &event_dispatch_thread, NULL);
+    }
+  }
+
+  /// Stops the callback thread, draining any queued events
+  void finish_async_callbacks()
+  {
+    if (!EVENT_SIM)
+      return;
+    EVENT_DONE = true;
+    pthread_join(EVENT_THREAD, NULL);
+    EVENT_SIM.reset();
+  }
+
   /// Gets the current time (as a floating-point number)
   double get_current_time()
   {
@@ -226,9 +526,13 @@ namespace Moby{
         // write the file (fails silently)
         char buffer[128];
         sprintf(buffer, "driver.out-%08u-%f.xml", ++LAST_PICKLE, s->current_time);
-        XMLWriter::serialize_to_xml(std::string(buffer), s);
+        PICKLER.serialize_incremental(std::string(buffer), s);
       }
     }
+
+    // record a trajectory frame, if desired
+    if (!TRAJ_FNAME.empty() && ITER % TRAJ_IVAL == 0)
+      record_trajectory_frame(s);
     
     // step the simulator
     if(OUTPUT_SIM_RATE){
@@ -288,7 +592,7 @@ namespace Moby{
         // write the file (fails silently)
         char buffer[128];
         sprintf(buffer, "driver.out-%08u-%f.xml", ++LAST_PICKLE, s->current_time);
-        XMLWriter::serialize_to_xml(std::string(buffer), s);
+        PICKLER.serialize_incremental(std::string(buffer), s);
       }
     }
     
@@ -367,8 +671,8 @@ namespace Moby{
       return root;
     
     // otherwise, look for it recursively
-    const std::list<XMLTreePtr>& children = root->children;
-    for (std::list<XMLTreePtr>::const_iterator i = children.begin(); i != children.end(); i++)
+    const std::vector<XMLTreePtr>& children = root->children;
+    for (std::vector<XMLTreePtr>::const_iterator i = children.begin(); i != children.end(); i++)
     {
       shared_ptr<const XMLTree> node = find_subtree(*i, name);
       if (node)
@@ -387,8 +691,8 @@ namespace Moby{
       fn(root);
     else
     {
-      const std::list<XMLTreePtr>& child_nodes = root->children;
-      for (std::list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+      const std::vector<XMLTreePtr>& child_nodes = root->children;
+      for (std::vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
         process_tag(tag, *i, fn);
     }
   }
@@ -653,9 +957,35 @@ namespace Moby{
         strcpy(THREED_EXT, &argv[i][ONECHAR_ARG]);
       } else if (option.find("-vcp") != std::string::npos)
         RENDER_CONTACT_POINTS = true;
+      else if (option.find("-ac") != std::string::npos)
+        ASYNC_CALLBACKS = true;
+      else if (option.find("-traj=") != std::string::npos)
+        TRAJ_FNAME = std::string(&argv[i][6]);
+      else if (option.find("-ti=") != std::string::npos)
+      {
+        TRAJ_IVAL = std::atoi(&argv[i][TWOCHAR_ARG]);
+        assert(TRAJ_IVAL > 0);
+      }
+      else if (option.find("-b=") != std::string::npos)
+      {
+        BATCH_SIZE = std::atoi(&argv[i][ONECHAR_ARG]);
+        assert(BATCH_SIZE > 0);
+      }
+      else if (option.find("-tp=") != std::string::npos)
+      {
+        THROUGHPUT_BATCH = std::atoi(&argv[i][TWOCHAR_ARG]);
+        assert(THROUGHPUT_BATCH > 0);
+      }
+      else if (option.find("-tp") != std::string::npos)
+        THROUGHPUT_BATCH = 100;
       
     }
     
+    // in batch mode, keep interned primitives alive across scene loads so
+    // that every instance shares the immutable geometry
+    if (BATCH_SIZE > 1)
+      XMLReader::retain_interned_primitives(true);
+
     // setup the simulation
     if (std::string(argv[argc-1]).find(".xml") != std::string::npos)
       READ_MAP = XMLReader::read(std::string(argv[argc-1]));
@@ -716,7 +1046,13 @@ namespace Moby{
       (*i)(NULL, READ_MAP, STEP_SIZE);
 #endif
     }
-    
+
+    // reroute any callbacks the plugins installed through the event ring
+    // (batch instances keep synchronous callbacks, like the other
+    // per-process outputs)
+    if (ASYNC_CALLBACKS && BATCH_SIZE == 1)
+      start_async_callbacks(s);
+
     // look for a scene description file
 #ifdef USE_OSG
     if (scene_path != "")
@@ -771,6 +1107,12 @@ namespace Moby{
   }
   
   int close(){
+    // stop the callback thread, if one is running
+    finish_async_callbacks();
+
+    // stop the trajectory writer, if one is running
+    finish_trajectory();
+
     // close the loaded library
     for(size_t i = 0; i < handles.size(); ++i){
       dlclose(handles[i]);
@@ -787,24 +1129,246 @@ namespace Moby{
     return 0;
   }
   
+  // ------------------------ in-process batch mode -------------------------
+  // A batch run steps several instances of the same scene in one process.
+  // The scene is loaded once per instance (the loads are serialized because
+  // the XML reader keeps static state), but the flyweight table is retained
+  // across the loads, so all instances share their immutable Primitive data
+  // and only the mutable per-instance state is duplicated.  Each instance
+  // then steps to MAX_ITER/MAX_TIME on its own thread.  Graphics, pickling
+  // and trajectory recording are per-process and stay out of batch mode.
+
+  /// Per-instance state for a batch run
+  struct BatchInstance
+  {
+    boost::shared_ptr<Simulator> sim;  // the instance's simulator
+    unsigned iters;                    // iterations completed
+    double elapsed;                    // wall-clock stepping time
+  };
+
+  /// The batch instances
+  std::vector<BatchInstance> BATCH;
+
+  /// Steps one batch instance to completion (runs on its own thread)
+  void* batch_step_thread(void* arg)
+  {
+    BatchInstance& bi = *(BatchInstance*) arg;
+    const double start = get_current_time();
+    while (bi.iters < MAX_ITER && bi.sim->current_time <= MAX_TIME)
+    {
+      bi.sim->step(STEP_SIZE);
+      bi.iters++;
+    }
+    bi.elapsed = get_current_time() - start;
+    return NULL;
+  }
+
+  /// Runs BATCH_SIZE instances of the scene and reports aggregate timing
+  int run_batch(int argc, char** argv, boost::shared_ptr<Simulator> s)
+  {
+    // the first instance was already loaded by init()
+    BATCH.resize(BATCH_SIZE);
+    BATCH[0].sim = s;
+
+    // load the remaining instances, reusing the interned primitives from
+    // the first load
+    for (unsigned i=1; i< BATCH_SIZE; i++)
+    {
+      std::map<std::string, BasePtr> read_map = XMLReader::read(std::string(argv[argc-1]));
+      for (std::map<std::string, BasePtr>::const_iterator j = read_map.begin(); j != read_map.end(); j++)
+      {
+        BATCH[i].sim = boost::dynamic_pointer_cast<Simulator>(j->second);
+        if (BATCH[i].sim)
+          break;
+      }
+      if (!BATCH[i].sim)
+      {
+        std::cerr << "driver: no simulator found loading batch instance " << i << std::endl;
+        return -1;
+      }
+
+      // call the plugin initializers on this instance, if any
+      BOOST_FOREACH(init_t init_fn, INIT)
+        (*init_fn)(NULL, read_map, STEP_SIZE);
+    }
+
+    // the loads are done; release the flyweight table (shared primitives
+    // stay alive through the instances that reference them)
+    XMLReader::retain_interned_primitives(false);
+
+    // initialize the stepping counters
+    for (unsigned i=0; i< BATCH_SIZE; i++)
+    {
+      BATCH[i].iters = 0;
+      BATCH[i].elapsed = 0.0;
+    }
+
+    // step the batch
+    const double batch_start = get_current_time();
+#ifdef THREADSAFE
+    // step every instance on its own thread
+    std::vector<pthread_t> threads(BATCH_SIZE);
+    for (unsigned i=0; i< BATCH_SIZE; i++)
+      pthread_create(&threads[i], NULL, &batch_step_thread, &BATCH[i]);
+    for (unsigned i=0; i< BATCH_SIZE; i++)
+      pthread_join(threads[i], NULL);
+#else
+    // Moby was not built thread-safe; step the instances serially (the
+    // memory sharing still applies)
+    for (unsigned i=0; i< BATCH_SIZE; i++)
+      batch_step_thread(&BATCH[i]);
+#endif
+
+    // report aggregate timing
+    const double batch_elapsed = get_current_time() - batch_start;
+    unsigned total_iters = 0;
+    for (unsigned i=0; i< BATCH_SIZE; i++)
+      total_iters += BATCH[i].iters;
+    std::cout << "batch: " << BATCH_SIZE << " instances, " << total_iters << " total iterations in " << batch_elapsed << "s";
+    if (batch_elapsed > 0.0)
+      std::cout << " (" << (total_iters / batch_elapsed) << " iter/s aggregate)";
+    std::cout << std::endl;
+
+    BATCH.clear();
+    return 0;
+  }
+
+  // ----------------------- headless throughput mode ------------------------
+  // With the -tp option and no viewer attached, the driver abandons the
+  // per-step loop and steps the simulator in tight fixed-size batches,
+  // hoisting its bookkeeping (logging window checks, interval outputs,
+  // stdout reporting, termination tests) to batch boundaries.  A batch is
+  // clamped so that it never crosses an iteration at which bookkeeping
+  // would fire, so -w, -traj, -lt and -lp behave exactly as in the
+  // per-step loop -- the checks just are not made every iteration.
+
+  /// Clamps a batch length so ival-periodic events stay on batch boundaries
+  unsigned clamp_to_interval(unsigned n, unsigned ival)
+  {
+    return std::min(n, ival - (ITER % ival));
+  }
+
+  /// Steps the simulator headless in tight batches (see -tp)
+  int run_throughput(boost::shared_ptr<Simulator> s)
+  {
+    while (true)
+    {
+      // set the logging level for the window containing this batch
+      if (ITER >= LOG_START && ITER <= LOG_STOP)
+      {
+        Moby::Log<OutputToFile>::reporting_level = LOG_REPORTING_LEVEL;
+        Ravelin::Log<OutputToFile>::reporting_level = LOG_REPORTING_LEVEL;
+      }
+      else
+      {
+        Moby::Log<OutputToFile>::reporting_level = 0;
+        Ravelin::Log<OutputToFile>::reporting_level = 0;
+      }
+
+      // output the iteration #, once per batch
+      if (OUTPUT_ITER_NUM)
+        std::cout << "iteration: " << ITER << "  simulation time: " << s->current_time << std::endl;
+
+      // serialize the simulation, if due
+      if (PICKLE_IVAL > 0 && (ITER % PICKLE_IVAL == 0 || ITER == 1))
+      {
+        char buffer[128];
+        sprintf(buffer, "driver.out-%08u-%f.xml", ++LAST_PICKLE, s->current_time);
+        PICKLER.serialize_incremental(std::string(buffer), s);
+      }
+
+      // record a trajectory frame, if due
+      if (!TRAJ_FNAME.empty() && ITER % TRAJ_IVAL == 0)
+        record_trajectory_frame(s);
+
+      // determine the batch length: stop short of the next iteration at
+      // which any bookkeeping fires
+      unsigned n = THROUGHPUT_BATCH;
+      n = std::min(n, MAX_ITER - ITER + 1);
+      if (PICKLE_IVAL > 0)
+        n = clamp_to_interval(n, PICKLE_IVAL);
+      if (!TRAJ_FNAME.empty())
+        n = clamp_to_interval(n, TRAJ_IVAL);
+      if (ITER < LOG_START)
+        n = std::min(n, LOG_START - ITER);
+      else if (ITER <= LOG_STOP && LOG_STOP < std::numeric_limits<unsigned>::max())
+        n = std::min(n, LOG_STOP + 1 - ITER);
+
+      // step the batch; only the time-limit test remains per step
+      unsigned stepped = 0;
+      while (stepped < n && s->current_time <= MAX_TIME)
+      {
+        s->step(STEP_SIZE);
+        stepped++;
+      }
+
+      // report batch timing, if desired
+      if ((OUTPUT_FRAME_RATE || OUTPUT_SIM_RATE) && stepped > 0)
+      {
+        const double tm = get_current_time();
+        std::cout << "batch of " << stepped << " steps in " << (tm - LAST_STEP_TIME) << "s (" << (stepped/(tm - LAST_STEP_TIME)) << " iter/s, avg " << ((ITER + stepped - 1) / (tm - FIRST_STEP_TIME)) << " iter/s)" << std::endl;
+        LAST_STEP_TIME = tm;
+      }
+
+      // advance the iteration counter past the batch
+      ITER += stepped;
+
+      // check the termination conditions once per batch
+      if (ITER > MAX_ITER || s->current_time > MAX_TIME || stepped < n)
+        break;
+    }
+
+    // write a final pickle, mirroring the last-frame output of the
+    // per-step loop
+    if (PICKLE_IVAL > 0)
+    {
+      char buffer[128];
+      sprintf(buffer, "driver.out-%08u-%f.xml", ++LAST_PICKLE, s->current_time);
+      PICKLER.serialize_incremental(std::string(buffer), s);
+    }
+
+    return 0;
+  }
+
   int init(int argc, char** argv){
     boost::shared_ptr<Simulator> s;
-    
+
     init(argc,argv,s);
 
     // if the step size is negative, set the step size to a default
     if (STEP_SIZE < 0.0)
       STEP_SIZE = DEFAULT_STEP_SIZE;
 
-    // begin simulating 
+    // run a batch, if one was requested
+    if (BATCH_SIZE > 1)
+    {
+      run_batch(argc, argv, s);
+      close();
+      return 0;
+    }
+
+    // run headless in throughput mode, if requested and no viewer or
+    // graphics output is attached
+    if (THROUGHPUT_BATCH > 0)
+    {
+      if (!ONSCREEN_RENDER && !UPDATE_GRAPHICS)
+      {
+        run_throughput(s);
+        close();
+        return 0;
+      }
+      std::cerr << "driver: ignoring -tp (a viewer or graphics output is attached)" << std::endl;
+    }
+
+    // begin simulating
     bool stop_sim = false;
     while (!stop_sim)
     {
       stop_sim = !step(s);
     }
-    
+
     close();
-    
+
     return 0;
   }
 } // end namespace Moby
@@ -0,0 +1,270 @@
+/*****************************************************************************
+ * Utility for performance regression testing
+ *
+ * Runs a scene for a fixed number of steps with the per-phase step
+ * instrumentation enabled and compares the mean per-step phase times
+ * against a checked-in baseline file. A phase that exceeds its baseline
+ * by more than the allowed tolerance fails the run, so performance
+ * regressions surface in review rather than in production.
+ *****************************************************************************/
+
+#include <errno.h>
+#include <sys/time.h>
+#include <dlfcn.h>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <boost/foreach.hpp>
+#include <Moby/XMLReader.h>
+#include <Moby/Log.h>
+#include <Moby/Simulator.h>
+#include <Moby/StepProfiler.h>
+#include <Moby/RigidBody.h>
+#include <Ravelin/DynamicBodyd.h>
+
+using boost::dynamic_pointer_cast;
+using boost::shared_ptr;
+using namespace Moby;
+
+/// Handle for dynamic library loading
+std::vector<void*> handles;
+
+/// The default simulation step size
+const double DEFAULT_STEP_SIZE = .001;
+
+/// The simulation step size
+double STEP_SIZE = DEFAULT_STEP_SIZE;
+
+/// The number of steps to run (default 1000)
+unsigned MAX_ITER = 1000;
+
+/// The allowed fractional increase over the baseline (default 20%)
+double TOLERANCE = 0.2;
+
+/// Whether to (re)write the baseline instead of comparing against it
+bool UPDATE_BASELINE = false;
+
+/// The map of objects read from the simulation XML file
+std::map<std::string, BasePtr> READ_MAP;
+
+/// Pointer to the controller's initializer, called once (if any)
+typedef void (*init_t)(void*, const std::map<std::string, BasePtr>&, double);
+std::list<init_t> INIT;
+
+// attempts to read control code plugin
+void read_plugin(const std::string& filename)
+{
+  // attempt to read the file
+  void* plugin = dlopen(filename.c_str(), RTLD_LAZY);
+  if (!plugin)
+  {
+    // get the error string, in case we need it
+    char* dlerror_str = dlerror();
+
+    // attempt to use the plugin path
+    char* plugin_path = getenv("MOBY_PLUGIN_PATH");
+    if (plugin_path)
+    {
+      // get the plugin path and make sure it has a path string at the end
+      std::string plugin_path_str(plugin_path);
+      if (plugin_path_str.at(plugin_path_str.size()-1) != '/')
+        plugin_path_str += '/';
+
+      // concatenate
+      plugin_path_str += filename;
+
+      // attempt to re-open the plugin
+      plugin = dlopen(plugin_path_str.c_str(), RTLD_LAZY);
+    }
+
+    // check whether the plugin was successfully loaded
+    if (!plugin)
+    {
+      std::cerr << "perfregress: failed to read plugin from " << filename << " (or using " << plugin_path << ")" << std::endl;
+      std::cerr << "  " << dlerror_str << std::endl;
+      exit(-1);
+    }
+  }
+  handles.push_back(plugin);
+
+  // attempt to load the initializer
+  dlerror();
+  INIT.push_back((init_t) dlsym(plugin, "init"));
+  const char* dlsym_error = dlerror();
+  if (dlsym_error)
+  {
+    std::cerr << "perfregress warning: cannot load symbol 'init' from " << filename << std::endl;
+    std::cerr << "        error follows: " << std::endl << dlsym_error << std::endl;
+    exit(-1);
+  }
+}
+
+/// Reads a baseline file of "<phase> <mean seconds per step>" lines
+bool read_baseline(const std::string& fname, std::map<std::string, double>& baseline)
+{
+  std::ifstream in(fname.c_str());
+  if (in.fail())
+    return false;
+
+  std::string phase;
+  double mean;
+  while (in >> phase >> mean)
+    baseline[phase] = mean;
+  return true;
+}
+
+/// Writes a baseline file from the measured per-step phase means
+void write_baseline(const std::string& fname, const StepProfiler& profiler)
+{
+  std::ofstream out(fname.c_str());
+  if (out.fail())
+  {
+    std::cerr << "perfregress: error opening baseline file " << fname << " for writing" << std::endl;
+    exit(-1);
+  }
+
+  const double N = (double) profiler.get_num_steps();
+  for (unsigned i=0; i< StepProfiler::N_PHASES; i++)
+  {
+    StepProfiler::Phase p = (StepProfiler::Phase) i;
+    out << StepProfiler::phase_name(p) << " " << (profiler.get_total(p)/N) << std::endl;
+  }
+}
+
+// where everything begins...
+int main(int argc, char** argv)
+{
+  const unsigned ONECHAR_ARG = 3, TWOCHAR_ARG = 4, THREECHAR_ARG = 5;
+
+  // check that syntax is ok
+  if (argc != 4)
+  {
+    std::cerr << "syntax: perfregress <options file> <xml file> <baseline file>" << std::endl;
+    std::cerr << "  options: -s=<step size> -mi=<steps> -tol=<fraction> -u (update baseline) -p=<plugin>" << std::endl;
+    return -1;
+  }
+
+  // read in the options file
+  std::ifstream options_in(argv[1]);
+  if (options_in.fail())
+  {
+    std::cerr << "perfregress: error opening options file " << argv[1] << std::endl;
+    return -1;
+  }
+
+  // get the options
+  std::vector<std::string> options;
+  std::string str;
+  while (true)
+  {
+    options_in >> str;
+    if (options_in.eof())
+      break;
+    options.push_back(str);
+  }
+  options_in.close();
+
+  // get all options
+  for (unsigned i=0; i< options.size(); i++)
+  {
+    // get the option
+    const std::string& option = options[i];
+
+    // process options
+    if (option.find("-s=") != std::string::npos)
+    {
+      STEP_SIZE = std::atof(option.substr(ONECHAR_ARG).c_str());
+      assert(STEP_SIZE >= 0.0 && STEP_SIZE < 1);
+    }
+    else if (option.find("-mi=") != std::string::npos)
+    {
+      MAX_ITER = std::atoi(option.substr(TWOCHAR_ARG).c_str());
+      assert(MAX_ITER > 0);
+    }
+    else if (option.find("-tol=") != std::string::npos)
+    {
+      TOLERANCE = std::atof(option.substr(THREECHAR_ARG).c_str());
+      assert(TOLERANCE >= 0.0);
+    }
+    else if (option.find("-u") != std::string::npos)
+      UPDATE_BASELINE = true;
+    else if (option.find("-p=") != std::string::npos)
+      read_plugin(option.substr(ONECHAR_ARG));
+  }
+
+  // setup the simulation
+  READ_MAP = XMLReader::read(std::string(argv[argc-2]));
+
+  // get the (only) simulation object
+  boost::shared_ptr<Simulator> s;
+  for (std::map<std::string, BasePtr>::const_iterator i = READ_MAP.begin(); i != READ_MAP.end(); i++)
+  {
+    s = boost::dynamic_pointer_cast<Simulator>(i->second);
+    if (s)
+      break;
+  }
+
+  // make sure that a simulator was found
+  if (!s)
+  {
+    std::cerr << "perfregress: no simulator found in " << argv[argc-2] << std::endl;
+    return -1;
+  }
+
+  // call the initializers, if any
+  if (!INIT.empty())
+  {
+    BOOST_FOREACH(init_t i, INIT)
+      (*i)(NULL, READ_MAP, STEP_SIZE);
+  }
+
+  // enable the per-phase step instrumentation and run the scene
+  s->profiler.enabled = true;
+  for (unsigned i=0; i< MAX_ITER; i++)
+    s->step(STEP_SIZE);
+
+  // update the baseline instead of comparing, if requested
+  const std::string baseline_fname(argv[argc-1]);
+  if (UPDATE_BASELINE)
+  {
+    write_baseline(baseline_fname, s->profiler);
+    std::cout << "perfregress: baseline " << baseline_fname << " updated (" << MAX_ITER << " steps)" << std::endl;
+    return 0;
+  }
+
+  // read the baseline; a missing baseline is an error (write one with -u)
+  std::map<std::string, double> baseline;
+  if (!read_baseline(baseline_fname, baseline))
+  {
+    std::cerr << "perfregress: error opening baseline file " << baseline_fname << " (run with -u to create it)" << std::endl;
+    return -1;
+  }
+
+  // compare the measured per-step means against the baseline
+  bool regressed = false;
+  const double N = (double) s->profiler.get_num_steps();
+  for (unsigned i=0; i< StepProfiler::N_PHASES; i++)
+  {
+    StepProfiler::Phase p = (StepProfiler::Phase) i;
+    const std::string phase(StepProfiler::phase_name(p));
+
+    // phases absent from the baseline are not checked (lets baselines omit
+    // phases a scene never exercises)
+    std::map<std::string, double>::const_iterator bi = baseline.find(phase);
+    if (bi == baseline.end())
+      continue;
+
+    const double measured = s->profiler.get_total(p)/N;
+    const double allowed = bi->second*(1.0 + TOLERANCE);
+    const bool fail = (measured > allowed);
+    if (fail)
+      regressed = true;
+
+    std::cout << phase << ": " << measured << "s/step (baseline " << bi->second
+              << "s/step, allowed " << allowed << "s/step) "
+              << (fail ? "REGRESSED" : "ok") << std::endl;
+  }
+
+  return (regressed) ? 1 : 0;
+}
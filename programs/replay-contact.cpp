@@ -0,0 +1,200 @@
+/*****************************************************************************
+ * Replays captured contact problems through the impact solver backends
+ *****************************************************************************/
+
+#include <sys/time.h>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <Moby/ContactProblemCapture.h>
+#include <Moby/ImpactConstraintHandler.h>
+#include <Moby/LCP.h>
+
+using Ravelin::MatrixNd;
+using Ravelin::VectorNd;
+using namespace Moby;
+
+/// Gets the current wall time (in seconds)
+double get_wall_time()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double) tv.tv_sec + (double) tv.tv_usec * 1e-6;
+}
+
+/// Computes the maximum normal velocity violation under the current impulses
+/**
+ * A nonnegative post-impact normal velocity at every contact and limit is
+ * the feasibility condition every backend must satisfy; the returned value
+ * is the largest violation (zero indicates a feasible solution).
+ */
+double calc_normal_violation(const UnilateralConstraintProblemData& q)
+{
+  double violation = 0.0;
+
+  // check the contact normal velocities
+  for (unsigned i=0; i< q.N_CONTACTS; i++)
+  {
+    double vn = q.Cn_v[i];
+    for (unsigned k=0; k< q.N_CONTACTS; k++)
+      vn += q.Cn_X_CnT(i,k)*q.cn[k] + q.Cn_X_CsT(i,k)*q.cs[k] + q.Cn_X_CtT(i,k)*q.ct[k];
+    for (unsigned k=0; k< q.N_LIMITS; k++)
+      vn += q.Cn_X_LT(i,k)*q.l[k];
+    violation = std::max(violation, -vn);
+  }
+
+  // check the limit velocities
+  for (unsigned i=0; i< q.N_LIMITS; i++)
+  {
+    double vl = q.L_v[i];
+    for (unsigned k=0; k< q.N_CONTACTS; k++)
+      vl += q.Cn_X_LT(k,i)*q.cn[k] + q.Cs_X_LT(k,i)*q.cs[k] + q.Ct_X_LT(k,i)*q.ct[k];
+    for (unsigned k=0; k< q.N_LIMITS; k++)
+      vl += q.L_X_LT(i,k)*q.l[k];
+    violation = std::max(violation, -vl);
+  }
+
+  return violation;
+}
+
+/// Assembles the no-slip LCP over the normal and limit impulses
+void assemble_lcp(const UnilateralConstraintProblemData& q, MatrixNd& MM, VectorNd& qq)
+{
+  const unsigned NC = q.N_CONTACTS;
+  const unsigned NL = q.N_LIMITS;
+
+  // setup the LCP matrix
+  MM.resize(NC+NL, NC+NL);
+  MM.set_sub_mat(0, 0, q.Cn_X_CnT);
+  MM.set_sub_mat(0, NC, q.Cn_X_LT);
+  MM.set_sub_mat(NC, 0, q.Cn_X_LT, Ravelin::eTranspose);
+  MM.set_sub_mat(NC, NC, q.L_X_LT);
+
+  // setup the LCP vector
+  qq.resize(NC+NL);
+  qq.set_sub_vec(0, q.Cn_v);
+  qq.set_sub_vec(NC, q.L_v);
+}
+
+/// Replays one problem through the named backend, reporting the outcome
+void replay(const std::string& backend, UnilateralConstraintProblemData& q, ImpactConstraintHandler& handler, LCP& lcp, unsigned& failures)
+{
+  // start every backend from zero impulses
+  q.cn.set_zero(q.N_CONTACTS);
+  q.cs.set_zero(q.N_CONTACTS);
+  q.ct.set_zero(q.N_CONTACTS);
+  q.l.set_zero(q.N_LIMITS);
+
+  // replay the problem
+  double start = get_wall_time();
+  bool success;
+  unsigned work;
+  if (backend == "pgs")
+  {
+    work = handler.solve_pgs(q);
+    success = (work < handler.pgs_max_iterations);
+  }
+  else
+  {
+    // assemble the no-slip LCP over [cn; l] and run the requested solver
+    MatrixNd MM;
+    VectorNd qq, z;
+    assemble_lcp(q, MM, qq);
+    if (backend == "lcp-fast")
+      success = lcp.lcp_fast(MM, qq, z);
+    else if (backend == "lcp-fast-reg")
+      success = lcp.lcp_fast_regularized(MM, qq, z);
+    else if (backend == "lcp-lemke")
+      success = lcp.lcp_lemke(MM, qq, z);
+    else
+      success = lcp.lcp_lemke_regularized(MM, qq, z);
+    work = lcp.get_pivots();
+
+    // store the solution so the violation can be evaluated
+    if (success)
+    {
+      q.cn = z.segment(0, q.N_CONTACTS);
+      q.l = z.segment(q.N_CONTACTS, z.size());
+    }
+  }
+  double elapsed = get_wall_time() - start;
+  if (!success)
+    failures++;
+
+  // report the outcome
+  std::cout << "  " << std::left << std::setw(16) << backend
+            << (success ? "solved" : "FAILED")
+            << "  iter/pivots: " << std::right << std::setw(6) << work
+            << "  time: " << std::scientific << std::setprecision(3) << elapsed
+            << "  violation: " << calc_normal_violation(q) << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+  // the backends available for replay
+  std::vector<std::string> backends;
+
+  // process options
+  int first_file = 1;
+  if (argc >= 3 && std::strcmp(argv[1], "-b") == 0)
+  {
+    backends.push_back(argv[2]);
+    first_file = 3;
+  }
+  else
+  {
+    backends.push_back("pgs");
+    backends.push_back("lcp-fast");
+    backends.push_back("lcp-fast-reg");
+    backends.push_back("lcp-lemke");
+    backends.push_back("lcp-lemke-reg");
+  }
+
+  // check that syntax ok
+  if (first_file >= argc)
+  {
+    std::cerr << "syntax: moby-replay-contact [-b <backend>] <file>+" << std::endl;
+    std::cerr << "  where each <file> is a captured contact problem (.ucp) and" << std::endl;
+    std::cerr << "  <backend> is one of pgs, lcp-fast, lcp-fast-reg, lcp-lemke," << std::endl;
+    std::cerr << "  lcp-lemke-reg (all are replayed if no backend is given)" << std::endl;
+    std::cerr << "  (set MOBY_CONTACT_CAPTURE_PREFIX to capture problems from a live run)" << std::endl;
+    return -1;
+  }
+
+  // setup the solver backends
+  ImpactConstraintHandler handler;
+  LCP lcp;
+  unsigned failures = 0;
+
+  // replay each captured problem in turn
+  for (int i=first_file; i< argc; i++)
+  {
+    // read the problem
+    std::ifstream in(argv[i], std::ifstream::binary);
+    UnilateralConstraintProblemData q;
+    std::vector<UnilateralConstraint> constraints;
+    if (!in || !ContactProblemCapture::read(q, constraints, in))
+    {
+      std::cerr << "moby-replay-contact: unable to read problem from " << argv[i] << std::endl;
+      continue;
+    }
+
+    // report the problem dimensions
+    std::cout << argv[i] << ": " << q.N_CONTACTS << " contact(s), "
+              << q.N_LIMITS << " limit(s), " << q.N_CONSTRAINT_EQNS_IMP
+              << " implicit constraint eqn(s)" << std::endl;
+
+    // replay the problem through each backend
+    for (unsigned j=0; j< backends.size(); j++)
+      replay(backends[j], q, handler, lcp, failures);
+  }
+
+  // report the total number of failures
+  std::cout << failures << " backend failure(s)" << std::endl;
+
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <cstdlib>
+#include <new>
+#include <Moby/AlignedSlabPool.h>
+
+using boost::shared_array;
+using namespace Moby;
+
+/// The alignment of every buffer, in bytes (one cache line)
+static const unsigned ALIGNMENT = 64;
+
+/// The capacity granularity, in doubles (one cache line)
+static const unsigned GRANULARITY = ALIGNMENT/sizeof(double);
+
+// Sole constructor; pools are only created through pool()
+AlignedSlabPool::AlignedSlabPool(const std::string& name)
+{
+  _name = name;
+  _acquires = _reuses = _heap_bytes = 0;
+  pthread_mutex_init(&_mutex, NULL);
+}
+
+AlignedSlabPool::~AlignedSlabPool()
+{
+  clear();
+  pthread_mutex_destroy(&_mutex);
+}
+
+/// The registry of named pools and its lock
+/**
+ * The registry (and the pools in it) is intentionally never destroyed:
+ * outstanding buffers release back to their pool from shared_array
+ * deleters, which may run at any time, including after static destruction
+ * has begun.
+ */
+static std::map<std::string, AlignedSlabPool*>* _pools = NULL;
+static pthread_mutex_t _pools_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/// Gets the named per-subsystem pool, creating it on first use
+AlignedSlabPool& AlignedSlabPool::pool(const std::string& subsystem)
+{
+  pthread_mutex_lock(&_pools_mutex);
+  if (!_pools)
+    _pools = new std::map<std::string, AlignedSlabPool*>;
+  AlignedSlabPool*& p = (*_pools)[subsystem];
+  if (!p)
+    p = new AlignedSlabPool(subsystem);
+  pthread_mutex_unlock(&_pools_mutex);
+  return *p;
+}
+
+/// Acquires a 64-byte aligned buffer with capacity for (at least) n doubles
+shared_array<double> AlignedSlabPool::acquire(unsigned n)
+{
+  // round the capacity up to whole cache lines so that buffers bucket well
+  unsigned capacity = (n + GRANULARITY-1)/GRANULARITY*GRANULARITY;
+  if (capacity == 0)
+    capacity = GRANULARITY;
+
+  // look for the smallest free buffer that fits
+  double* p = NULL;
+  pthread_mutex_lock(&_mutex);
+  _acquires++;
+  std::multimap<unsigned, double*>::iterator i = _free.lower_bound(capacity);
+  if (i != _free.end())
+  {
+    _reuses++;
+    capacity = i->first;
+    p = i->second;
+    _free.erase(i);
+  }
+  else
+    _heap_bytes += capacity*sizeof(double);
+  pthread_mutex_unlock(&_mutex);
+
+  // nothing suitable pooled; get an aligned buffer from the heap
+  if (!p)
+  {
+    void* mem = NULL;
+    if (posix_memalign(&mem, ALIGNMENT, capacity*sizeof(double)) != 0)
+      throw std::bad_alloc();
+    p = (double*) mem;
+  }
+
+  return shared_array<double>(p, Deleter(this, capacity));
+}
+
+/// Returns a buffer to the free list (called from the shared_array deleter)
+void AlignedSlabPool::release(double* p, unsigned capacity)
+{
+  pthread_mutex_lock(&_mutex);
+  _free.insert(std::make_pair(capacity, p));
+  pthread_mutex_unlock(&_mutex);
+}
+
+/// Frees all pooled (unacquired) buffers back to the heap
+void AlignedSlabPool::clear()
+{
+  pthread_mutex_lock(&_mutex);
+  for (std::multimap<unsigned, double*>::iterator i = _free.begin(); i != _free.end(); i++)
+  {
+    _heap_bytes -= i->first*sizeof(double);
+    free(i->second);
+  }
+  _free.clear();
+  pthread_mutex_unlock(&_mutex);
+}
+
+/// Writes this pool's reuse statistics in human-readable form
+std::ostream& AlignedSlabPool::dump(std::ostream& out) const
+{
+  out << "pool '" << _name << "': " << _acquires << " acquires, " << _reuses << " reuses, " << _heap_bytes << " heap bytes" << std::endl;
+  return out;
+}
+
+/// Writes the reuse statistics of every named pool
+std::ostream& AlignedSlabPool::dump_all(std::ostream& out)
+{
+  pthread_mutex_lock(&_pools_mutex);
+  if (_pools)
+    for (std::map<std::string, AlignedSlabPool*>::const_iterator i = _pools->begin(); i != _pools->end(); i++)
+      i->second->dump(out);
+  pthread_mutex_unlock(&_pools_mutex);
+  return out;
+}
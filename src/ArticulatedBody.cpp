@@ -4,6 +4,8 @@
  * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
  ****************************************************************************/
 
+#include <cmath>
+#include <limits>
 #include <iostream>
 #include <boost/foreach.hpp>
 #include <queue>
@@ -36,6 +38,82 @@ using std::queue;
 
 ArticulatedBody::ArticulatedBody()
 {
+  limit_estimation_accel_mult = 2.0;
+  reset_joint_limit_check();
+}
+
+/// Determines whether joint limits must be checked at time t
+/**
+ * Returns true when no conservative time-to-limit bound is in effect or when
+ * the bound has expired; also returns true when t precedes the time at which
+ * the bound was computed (time moved backwards, e.g., on checkpoint restore).
+ */
+bool ArticulatedBody::joint_limit_check_due(double t) const
+{
+  return (t < _limit_check_computed_at || t >= _next_limit_check_time);
+}
+
+/// Invalidates any scheduled joint limit check, forcing the next one to run
+void ArticulatedBody::reset_joint_limit_check()
+{
+  _limit_check_computed_at = 0.0;
+  _next_limit_check_time = -std::numeric_limits<double>::max();
+}
+
+/// Computes a conservative time-to-limit bound and schedules the next limit check
+/**
+ * For every DOF with a finite limit, this bounds the time for the DOF to
+ * close the gap to its nearer limit while moving at its current speed and
+ * accelerating at limit_estimation_accel_mult times its current acceleration
+ * magnitude; joint_limit_check_due() then reports false until the minimum
+ * such bound expires. The bound is only valid under integration: callers
+ * must reset the schedule whenever positions change by other means (e.g.,
+ * constraint stabilization or checkpoint restore).
+ */
+void ArticulatedBody::schedule_next_joint_limit_check(double t)
+{
+  const double INF = std::numeric_limits<double>::max();
+
+  // find the minimum time-to-limit bound over all joint DOFs
+  double bound = INF;
+  for (unsigned i=0; i< _joints.size(); i++)
+  {
+    boost::shared_ptr<Joint> joint = dynamic_pointer_cast<Joint>(_joints[i]);
+    for (unsigned j=0; j< joint->num_dof(); j++)
+    {
+      // get the gap to the nearer finite limit
+      double q = joint->q[j] + joint->_q_tare[j];
+      double gap = INF;
+      if (joint->hilimit[j] < INF)
+        gap = joint->hilimit[j] - q;
+      if (joint->lolimit[j] > -INF)
+        gap = std::min(gap, q - joint->lolimit[j]);
+      if (gap == INF)
+        continue;
+
+      // a DOF at or past a limit must be checked every step
+      if (gap <= 0.0)
+      {
+        reset_joint_limit_check();
+        return;
+      }
+
+      // solve gap = |qd|*s + 1/2*a*s^2 for the time s to close the gap
+      double qd = std::fabs(joint->qd[j]);
+      double a = limit_estimation_accel_mult * std::fabs(joint->qdd[j]);
+      double s;
+      if (a > 0.0)
+        s = (-qd + std::sqrt(qd*qd + 2.0*a*gap))/a;
+      else if (qd > 0.0)
+        s = gap/qd;
+      else
+        continue;
+      bound = std::min(bound, s);
+    }
+  }
+
+  _limit_check_computed_at = t;
+  _next_limit_check_time = (bound < INF) ? t + bound : INF;
 }
 
 /// Integrates a dynamic body
@@ -176,6 +254,24 @@ void ArticulatedBody::ode(double t, double dt, void* data, SharedVectorNd& dx)
   get_generalized_acceleration(dgv);
 }
 
+/// Per-DOF kernel for update_joint_constraint_violations()
+struct JointViolationOp
+{
+  JointViolationOp(JointPtr joint_, vector<double>& cvio_, unsigned& k_) : cvio(cvio_), k(k_) { joint = joint_; }
+  void operator()(unsigned j)
+  {
+    cvio[k] = 0.0;
+    if (joint->q[j] < joint->lolimit[j])
+      cvio[k] = joint->lolimit[j] - joint->q[j];
+    else if (joint->q[j] > joint->hilimit[j])
+      cvio[k] = joint->q[j] - joint->hilimit[j];
+    k++;
+  }
+  JointPtr joint;
+  vector<double>& cvio;
+  unsigned& k;
+};
+
 // TODO: remove this
 /// Updates joint constraint violation (after integration)
 void ArticulatedBody::update_joint_constraint_violations()
@@ -187,15 +283,9 @@ void ArticulatedBody::update_joint_constraint_violations()
   {
     JointPtr joint = dynamic_pointer_cast<Joint>(_joints[i]);
 
-    // loop over all DOF
-    for (unsigned j=0; j< _joints[i]->num_dof(); j++, k++)
-    {
-      _cvio[k] = 0.0;
-      if (joint->q[j] < joint->lolimit[j])
-        _cvio[k] = joint->lolimit[j] - joint->q[j];
-      else if (joint->q[j] > joint->hilimit[j])
-        _cvio[k] = joint->q[j] - joint->hilimit[j]; 
-    }
+    // loop over all DOF, with a compile-time trip count for low-DOF joints
+    JointViolationOp op(joint, _cvio, k);
+    joint->for_each_dof(op);
   }
 }
 
@@ -229,7 +319,16 @@ void ArticulatedBody::update_visualization()
   BOOST_FOREACH(shared_ptr<RigidBodyd> rb, _links)
     dynamic_pointer_cast<RigidBody>(rb)->update_visualization(); 
   BOOST_FOREACH(shared_ptr<Jointd> joint, _joints)
-    dynamic_pointer_cast<Joint>(joint)->update_visualization(); 
+    dynamic_pointer_cast<Joint>(joint)->update_visualization();
+}
+
+/// Records visualization poses for the body without touching the scene graph
+void ArticulatedBody::snapshot_visualization(std::vector<std::pair<OSGGroupWrapperPtr, Ravelin::Pose3d> >& poses)
+{
+  BOOST_FOREACH(shared_ptr<RigidBodyd> rb, _links)
+    dynamic_pointer_cast<RigidBody>(rb)->snapshot_visualization(poses);
+  BOOST_FOREACH(shared_ptr<Jointd> joint, _joints)
+    dynamic_pointer_cast<Joint>(joint)->snapshot_visualization(poses);
 }
 
 /// Loads a MCArticulatedBody object from an XML node
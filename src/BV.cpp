@@ -43,12 +43,48 @@ double BV::calc_distance(const BV* a, const BV* b, const Transform3d& aTb, Point
   return -1.0;
 }
 
+/// Initializes the single-precision culling mirror
+/**
+ * The mirror is a bounding sphere over the volume's axis-aligned bounds,
+ * padded to absorb the precision lost in rounding the center and radius to
+ * single precision; the mirror test can therefore never separate a pair that
+ * the exact volumes intersect.  Call only on volumes that will not change
+ * afterward -- the sentinel radius of -1 set on construction marks an
+ * uninitialized mirror, which the intersects() prefilter skips.
+ */
+void BV::init_cull_sphere()
+{
+  Origin3d lo(get_lower_bounds());
+  Origin3d hi(get_upper_bounds());
+  Origin3d c = (lo + hi)*0.5;
+  double r = (hi - c).norm();
+
+  // pad for single-precision rounding of the center and radius
+  double pad = (std::fabs(c[0]) + std::fabs(c[1]) + std::fabs(c[2]) + r)*1e-6;
+
+  cull_center[0] = (float) c[0];
+  cull_center[1] = (float) c[1];
+  cull_center[2] = (float) c[2];
+  cull_radius = (float) (r + pad);
+}
+
 /// Computes whether two abstract bounding volumes intersect
 bool BV::intersects(const BV* a, const BV* b)
 {
+  // test the single-precision culling mirrors first, when both volumes
+  // carry one; this reads sixteen bytes per node in place of the full
+  // volume data and rejects most distant pairs
+  if (a->cull_radius >= 0.0f && b->cull_radius >= 0.0f)
+  {
+    Origin3d d(b->cull_center[0] - a->cull_center[0], b->cull_center[1] - a->cull_center[1], b->cull_center[2] - a->cull_center[2]);
+    double rsum = (double) a->cull_radius + (double) b->cull_radius;
+    if (d.norm_sq() > rsum*rsum)
+      return false;
+  }
+
   // look for dummy type
   if (dynamic_cast<const DummyBV*>(a) || dynamic_cast<const DummyBV*>(b))
-    return true; 
+    return true;
 
   // look for OBB type
   if (dynamic_cast<const OBB*>(a))
@@ -152,9 +188,22 @@ bool BV::intersects(const BV* a, const BV* b)
  */
 bool BV::intersects(const BV* a, const BV* b, const Transform3d& aTb)
 {
+  // test the single-precision culling mirrors first, when both volumes
+  // carry one; this reads sixteen bytes per node in place of the full
+  // volume data and rejects most distant pairs
+  if (a->cull_radius >= 0.0f && b->cull_radius >= 0.0f)
+  {
+    Origin3d cb(b->cull_center[0], b->cull_center[1], b->cull_center[2]);
+    Origin3d ca(a->cull_center[0], a->cull_center[1], a->cull_center[2]);
+    Origin3d d = aTb.q * cb + aTb.x - ca;
+    double rsum = (double) a->cull_radius + (double) b->cull_radius;
+    if (d.norm_sq() > rsum*rsum)
+      return false;
+  }
+
   // look for dummy type
   if (dynamic_cast<const DummyBV*>(a) || dynamic_cast<const DummyBV*>(b))
-    return true; 
+    return true;
 
   // look for OBB type
   if (dynamic_cast<const OBB*>(a))
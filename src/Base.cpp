@@ -34,19 +34,21 @@ void BaseData::populate(Base* b)
   b->userdata = _userdata;
 }
 
-Base::Base() 
+Base::Base()
 {
   std::ostringstream oss;
   oss << this;
-  id = oss.str(); 
+  id = oss.str();
+  _generation = 0;
 }
 
-Base::Base(const Base* b) 
-{ 
-  userdata = b->userdata; 
+Base::Base(const Base* b)
+{
+  userdata = b->userdata;
   std::ostringstream oss;
   oss << this;
-  id = oss.str(); 
+  id = oss.str();
+  _generation = 0;
 }
 
 /// Method for loading the data for this object from XML
@@ -18,6 +18,7 @@
 #include <Moby/Constants.h>
 #include <Moby/CollisionGeometry.h>
 #include <Moby/HeightmapPrimitive.h>
+#include <Moby/CapsulePrimitive.h>
 #include <Moby/QP.h>
 #include <Moby/BoxPrimitive.h>
 
@@ -92,6 +93,9 @@ BoxPrimitive::BoxPrimitive(const Pose3d& P) : PolyhedralPrimitive(P)
     Point3d p(vertices[i]->o, Pp);
     vertices[i]->o = T.transform_point(p);
   }
+
+  // the vertices moved in place, so cached derived geometry is stale
+  _poly.invalidate_derived_data();
 }  
 
 /// Constructs a box of the specified size transformed by the given matrix
@@ -122,6 +126,9 @@ BoxPrimitive::BoxPrimitive(double xlen, double ylen, double zlen, const Pose3d&
     Point3d p(vertices[i]->o, Pp);
     vertices[i]->o = T.transform_point(p);
   }
+
+  // the vertices moved in place, so cached derived geometry is stale
+  _poly.invalidate_derived_data();
 }
 
 /// Constructs a polyhedron from the box
@@ -170,6 +177,14 @@ double BoxPrimitive::calc_signed_dist(shared_ptr<const Primitive> p, Point3d& pt
     return hmp->calc_signed_dist(bthis, pp, pthis);
   }
 
+  // now try box/capsule
+  shared_ptr<const CapsulePrimitive> capp = dynamic_pointer_cast<const CapsulePrimitive>(p);
+  if (capp)
+  {
+    shared_ptr<const BoxPrimitive> bthis = dynamic_pointer_cast<const BoxPrimitive>(shared_from_this());
+    return capp->calc_signed_dist(bthis, pp, pthis);
+  }
+
   // if the primitive is polyhedral and convex, can use vclip 
   shared_ptr<const PolyhedralPrimitive> polyp = dynamic_pointer_cast<const PolyhedralPrimitive>(p);
   if (polyp)
@@ -742,6 +757,73 @@ BVPtr BoxPrimitive::get_BVH_root(CollisionGeometryPtr geom)
   return obb;
 }
 
+/// Casts a ray against the box (analytic slab test)
+bool BoxPrimitive::ray_cast(const Point3d& origin, const Vector3d& dir, double max_dist, double& t, Vector3d& normal) const
+{
+  const unsigned THREE_D = 3;
+
+  // verify that the primitive knows about this pose
+  assert(_poses.find(const_pointer_cast<Pose3d>(origin.pose)) != _poses.end());
+
+  // setup extents
+  double extents[3] = { _xlen*0.5, _ylen*0.5, _zlen*0.5 };
+
+  // clip the ray against the three slabs, tracking the axis of entry
+  double tmin = 0.0, tmax = max_dist;
+  unsigned axis = THREE_D;
+  double axis_sign = 0.0;
+  for (unsigned i=0; i< THREE_D; i++)
+  {
+    if (std::fabs(dir[i]) < NEAR_ZERO)
+    {
+      // ray is parallel to the slab; no hit if the origin is outside it
+      if (origin[i] < -extents[i] || origin[i] > extents[i])
+        return false;
+    }
+    else
+    {
+      // compute the intersections with the near and far planes of the slab
+      double ood = 1.0/dir[i];
+      double t1 = (-extents[i] - origin[i]) * ood;
+      double t2 = (extents[i] - origin[i]) * ood;
+      double sign = -1.0;
+      if (t1 > t2)
+      {
+        std::swap(t1, t2);
+        sign = 1.0;
+      }
+
+      // the latest entry determines the hit face
+      if (t1 > tmin)
+      {
+        tmin = t1;
+        axis = i;
+        axis_sign = sign;
+      }
+      tmax = std::min(tmax, t2);
+      if (tmin > tmax)
+        return false;
+    }
+  }
+
+  // a degenerate entry (ray begins inside the box) has no entry face
+  if (axis == THREE_D)
+  {
+    t = 0.0;
+    normal = Vector3d::normalize(-dir);
+    return true;
+  }
+
+  // return the entry distance and the outward normal of the entry face
+  t = tmin;
+  normal.set_zero(origin.pose);
+  normal[axis] = axis_sign;
+  if (normal.dot(dir) > 0.0)
+    normal = -normal;
+
+  return true;
+}
+
 /// Computes the signed distance to a point
 double BoxPrimitive::calc_signed_dist(const Point3d& p) const
 {
@@ -784,7 +866,57 @@ double BoxPrimitive::calc_signed_dist(const Point3d& p) const
   return (inside) ? -intDist : std::sqrt(sqrDist);
 }
 
-/// Computes the closest point on the box to a point (and returns the distance) 
+/// Computes the signed distances of a batch of points from this primitive
+/**
+ * All points must be defined in the same pose; the pose is verified once and
+ * the box extents are hoisted out of the distance loop.
+ */
+void BoxPrimitive::calc_signed_dists(const Point3d* points, unsigned n, double* dists) const
+{
+  if (n == 0)
+    return;
+  assert(_poses.find(const_pointer_cast<Pose3d>(points[0].pose)) != _poses.end());
+
+  // setup extents
+  const double extents[3] = { _xlen*0.5, _ylen*0.5, _zlen*0.5 };
+
+  for (unsigned j=0; j< n; j++)
+  {
+    const Point3d& p = points[j];
+
+    // compute the squared distance to the point on the box
+    bool inside = true;
+    double sqrDist = 0.0;
+    double intDist = -std::numeric_limits<double>::max();
+    double delta = 0.0;
+    for (unsigned i=0; i< 3; i++)
+    {
+      // see whether this dimension of the point lies below the negative extent
+      if (p[i] < -extents[i])
+      {
+        delta = p[i] + extents[i];
+        sqrDist += delta*delta;
+        inside = false;
+      }
+      // see whether this dimension of the point lies above the positive extent
+      else if (p[i] > extents[i])
+      {
+        delta = p[i] - extents[i];
+        sqrDist += delta*delta;
+        inside = false;
+      }
+      else if (inside)
+      {
+        double dist = std::min(std::fabs(p[i] - extents[i]), std::fabs(p[i] + extents[i]));
+        intDist = std::max(intDist, dist);
+      }
+    }
+
+    dists[j] = (inside) ? -intDist : std::sqrt(sqrDist);
+  }
+}
+
+/// Computes the closest point on the box to a point (and returns the distance)
 double BoxPrimitive::calc_closest_point(const Point3d& point, Point3d& closest) const
 {
   const unsigned X = 0, Y = 1, Z = 2;
@@ -104,11 +104,23 @@ void C2ACCD::add_articulated_body(ArticulatedBodyPtr abody, bool disable_adjacen
 
 void C2ACCD::remove_collision_geometry(CollisionGeometryPtr cg)
 {
+  // drop cached traversal fronts involving this geometry
+  for (map<pair<CollisionGeometryPtr, CollisionGeometryPtr>, TraversalFront>::iterator i = _CA_fronts.begin(); i != _CA_fronts.end(); )
+  {
+    if (i->first.first == cg || i->first.second == cg)
+      _CA_fronts.erase(i++);
+    else
+      i++;
+  }
+
   CollisionDetection::remove_collision_geometry(cg);
 }
 
 void C2ACCD::remove_all_collision_geometries()
 {
+  // drop all cached traversal fronts
+  _CA_fronts.clear();
+
   CollisionDetection::remove_all_collision_geometries();
 }
 
@@ -928,14 +940,38 @@ double C2ACCD::do_CAStep(double dist, const Vector3d& dab, CollisionGeometryPtr
 }
 
 /// CA algorithm (no "control")
+/**
+ * The BV traversal exploits temporal coherence via front tracking: the node
+ * pairs at which the previous traversal for this geometry pair stopped
+ * (leaf pairs and pruned pairs) are cached and the next traversal resumes
+ * from them rather than re-descending from the roots.
+ */
 double C2ACCD::do_CA(double step_size, CollisionGeometryPtr a, CollisionGeometryPtr b, shared_ptr<SSR> ssr_a, shared_ptr<SSR> ssr_b, const Transform3d& aTb, double dt)
 {
   const double TTOL = alpha_tolerance / step_size;
   FILE_LOG(LOG_COLDET) << "C2ACCD::do_CA() entered" << endl;
 
-  // place the two SSR's onto a priority queue
+  // the largest cached front worth seeding from; larger fronts indicate
+  // lost coherence and cost more to revalidate than a fresh root descent
+  const unsigned MAX_FRONT_SIZE = 256;
+
+  // seed the priority queue from the cached traversal front for this pair,
+  // if one is usable; otherwise, descend from the roots
   priority_queue<SSRPair> Q;
-  Q.push(SSRPair(ssr_a, ssr_b));
+  const pair<CollisionGeometryPtr, CollisionGeometryPtr> pair_key = make_pair(a, b);
+  map<pair<CollisionGeometryPtr, CollisionGeometryPtr>, TraversalFront>::iterator front_iter = _CA_fronts.find(pair_key);
+  if (front_iter != _CA_fronts.end() && !front_iter->second.empty() && front_iter->second.size() <= MAX_FRONT_SIZE)
+  {
+    const TraversalFront& front = front_iter->second;
+    FILE_LOG(LOG_COLDET) << " -- seeding traversal from cached front of size " << front.size() << endl;
+    for (unsigned i=0; i< front.size(); i++)
+      Q.push(SSRPair(front[i].first, front[i].second));
+  }
+  else
+    Q.push(SSRPair(ssr_a, ssr_b));
+
+  // the node pairs at which this traversal stops become the new front
+  TraversalFront new_front;
 
   while (!Q.empty())
   {
@@ -961,7 +997,7 @@ double C2ACCD::do_CA(double step_size, CollisionGeometryPtr a, CollisionGeometry
       cpb = Pose3d::transform_point(shared_ptr<const Pose3d>(), cpb);
       FILE_LOG(LOG_COLDET) << " -- SSR leafs detected, distance: " << dist << " closest points: " << cpa << " and " << cpb << endl;
 
-      // compute dt for the primitives 
+      // compute dt for the primitives
       if ((cpa - cpb).norm() > NEAR_ZERO)
       {
         double dtstar = do_CAStep(dist, cpb - cpa, a, b, ssrs.first, ssrs.second);
@@ -969,7 +1005,14 @@ double C2ACCD::do_CA(double step_size, CollisionGeometryPtr a, CollisionGeometry
           dt = dtstar;
       }
       else
-        return 0.0; 
+      {
+        // geometries are touching; the cached front is no longer meaningful
+        _CA_fronts.erase(pair_key);
+        return 0.0;
+      }
+
+      // traversal stops at leaf pairs; this one joins the new front
+      new_front.push_back(make_pair(ssrs.first, ssrs.second));
 
       continue;
     }
@@ -1000,7 +1043,11 @@ double C2ACCD::do_CA(double step_size, CollisionGeometryPtr a, CollisionGeometry
         {
           dtstar = do_CAStep(dist, cpa - cpb, b, a, bchild, ssrs.first);
           if (dtstar > dt + TTOL)
+          {
+            // pruned; the traversal stops here for this pair
+            new_front.push_back(make_pair(ssrs.first, bchild));
             continue;
+          }
         }
 
         // smaller bound..  add it for processing
@@ -1034,7 +1081,11 @@ double C2ACCD::do_CA(double step_size, CollisionGeometryPtr a, CollisionGeometry
         {
           dtstar = do_CAStep(dist, cpb - cpa, a, b, achild, ssrs.second);
           if (dtstar > dt + TTOL)
+          {
+            // pruned; the traversal stops here for this pair
+            new_front.push_back(make_pair(achild, ssrs.second));
             continue;
+          }
         }
 
         // smaller bound..  add it for processing
@@ -1071,7 +1122,11 @@ double C2ACCD::do_CA(double step_size, CollisionGeometryPtr a, CollisionGeometry
           {
             dtstar = do_CAStep(dist, cpb - cpa, a, b, achild, ssrs.second);
             if (dtstar > dt + TTOL)
+            {
+              // pruned; the traversal stops here for this pair
+              new_front.push_back(make_pair(achild, ssrs.second));
               continue;
+            }
           }
 
           // smaller bound..  add it for processing
@@ -1105,7 +1160,11 @@ double C2ACCD::do_CA(double step_size, CollisionGeometryPtr a, CollisionGeometry
           {
             dtstar = do_CAStep(dist, cpa - cpb, b, a, bchild, ssrs.first);
             if (dtstar > dt + TTOL)
+            {
+              // pruned; the traversal stops here for this pair
+              new_front.push_back(make_pair(ssrs.first, bchild));
               continue;
+            }
           }
 
           // smaller bound..  add it for processing
@@ -1115,6 +1174,9 @@ double C2ACCD::do_CA(double step_size, CollisionGeometryPtr a, CollisionGeometry
     }
   } 
 
+  // cache the new front; the next traversal of this pair resumes from it
+  _CA_fronts[pair_key].swap(new_front);
+
   FILE_LOG(LOG_COLDET) << "C2ACCD::do_CA() exiting" << endl;
   return dt;
 }
@@ -1814,8 +1876,10 @@ void C2ACCD::build_BV_tree(CollisionGeometryPtr geom)
         Q.push(child);
     }
 
-    // wipe out userdata
+    // wipe out userdata and setup the single-precision culling mirror
+    // (the hierarchy does not change after construction)
     bv->userdata = shared_ptr<void>();
+    bv->init_cull_sphere();
   }
 
   // save the root
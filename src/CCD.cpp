@@ -24,6 +24,8 @@
 #include <Moby/BoundingSphere.h>
 #include <Moby/DummyBV.h>
 #include <Moby/SpherePrimitive.h>
+#include <Moby/SphereTreePrimitive.h>
+#include <Moby/CapsulePrimitive.h>
 #include <Moby/BoxPrimitive.h>
 #include <Moby/CylinderPrimitive.h>
 #include <Moby/ConePrimitive.h>
@@ -54,6 +56,19 @@ using namespace Moby;
 /// Constructs a collision detector with default tolerances
 CCD::CCD()
 {
+  // the bounds vectors must be built from scratch on the first broad phase
+  _rebuild_bounds_vecs = true;
+  _n_packed_bounds = 0;
+
+  // by default, every geometry enters the broad phase individually
+  compound_broad_phase = false;
+
+  // by default, the polyhedral CA routines examine every vertex
+  ca_vertex_budget = 0;
+
+  // by default, static geometry enters the sweep like everything else
+  bake_static_geometry = false;
+  _static_root = -1;
 }
 
 // TODO: remove this as integrator is Euler 8/11/15
@@ -125,10 +140,16 @@ double CCD::calc_CA_Euler_step(const PairwiseDistInfo& pdi)
   PrimitivePtr pA = pdi.a->get_geometry(); 
   PrimitivePtr pB = pdi.b->get_geometry();
 
-  // look for case of sphere
-  if (dynamic_pointer_cast<SpherePrimitive>(pA) || 
-      dynamic_pointer_cast<SpherePrimitive>(pB))
-    return calc_CA_Euler_step_sphere(pdi);  
+  // look for case of a sphere-swept surface (sphere-tree approximations
+  // resolve against leaf spheres and capsules are sphere-swept segments,
+  // so both take the sphere fast path too)
+  if (dynamic_pointer_cast<SpherePrimitive>(pA) ||
+      dynamic_pointer_cast<SpherePrimitive>(pB) ||
+      dynamic_pointer_cast<SphereTreePrimitive>(pA) ||
+      dynamic_pointer_cast<SphereTreePrimitive>(pB) ||
+      dynamic_pointer_cast<CapsulePrimitive>(pA) ||
+      dynamic_pointer_cast<CapsulePrimitive>(pB))
+    return calc_CA_Euler_step_sphere(pdi);
 
   // no special cases apply: call generic
   return calc_CA_Euler_step_generic(pdi);
@@ -234,6 +255,118 @@ double CCD::calc_CA_Euler_step_generic(const PairwiseDistInfo& pdi)
   return maxt;
 }
 
+/// Computes the first time of contact of a geometry swept along a pose path
+/**
+ * Planner-facing kinematic validity query: the geometry's rigid body is
+ * swept along the piecewise-linear pose path (each waypoint a pose of the
+ * body frame relative to the global frame, interpolated by translation and
+ * axis-angle fraction) and conservatively advanced against the obstacle
+ * geometries, entirely outside the simulation loop.  No dynamics state is
+ * involved: velocities, forces and the simulator are untouched, and the
+ * body's pose is restored before returning.
+ *
+ * Conservative advancement uses the same principle as calc_CA_Euler_step(),
+ * with the per-parameter motion bound derived from the path itself: over a
+ * segment, no point of the geometry moves farther than the frame translation
+ * plus the rotation angle times the geometry's bounding radius.
+ *
+ * \param cg the geometry to sweep; its single body must be a rigid body
+ * \param path the pose waypoints (at least one), spanning parameters [0,1]
+ * \param obstacles the geometries swept against (obstacles on the swept
+ *        geometry's own body are skipped)
+ * \param contact_dist the distance at which the sweep reports contact
+ * \return the earliest path parameter in [0,1] at which the swept geometry
+ *         comes within contact_dist of an obstacle, or infinity if the
+ *         whole sweep is free
+ */
+double CCD::calc_sweep_toc(CollisionGeometryPtr cg, const std::vector<Pose3d>& path, const std::vector<CollisionGeometryPtr>& obstacles, double contact_dist)
+{
+  const double INF = std::numeric_limits<double>::max();
+  const unsigned MAX_ADVANCES = 100;  // per-segment advancement cap
+  const double MIN_STEP = 1e-5;       // minimum parameter advance
+
+  // verify that the path is non-degenerate
+  if (path.empty())
+    throw std::runtime_error("CCD::calc_sweep_toc() - empty pose path");
+
+  // the sweep poses the body kinematically, so it must be a rigid body
+  RigidBodyPtr rb = dynamic_pointer_cast<RigidBody>(cg->get_single_body());
+  if (!rb)
+    throw std::runtime_error("CCD::calc_sweep_toc() - swept geometry is not on a rigid body");
+
+  // get the bounding radius of the swept geometry (about the body frame)
+  const double rmax = cg->get_farthest_point_distance();
+
+  // save the body's pose for restoration
+  Pose3d saved_pose = *rb->get_pose();
+  saved_pose.update_relative_pose(GLOBAL);
+
+  // sweep each segment in turn
+  double toc = INF;
+  const unsigned NSEG = std::max((unsigned) path.size()-1, (unsigned) 1);
+  for (unsigned seg=0; seg< path.size()-1 || (seg == 0 && path.size() == 1); seg++)
+  {
+    // get the segment endpoints (a single-waypoint path degenerates to a
+    // static check at that waypoint)
+    const Pose3d& P0 = path[seg];
+    const Pose3d& P1 = path[(seg+1 < path.size()) ? seg+1 : seg];
+
+    // bound the motion over the segment: no point of the geometry moves
+    // farther than the frame translation plus rotation angle times radius
+    AAngled aa = Quatd::invert(P0.q) * P1.q;
+    const double motion_bound = (P1.x - P0.x).norm() + std::fabs(aa.angle)*rmax;
+
+    // conservatively advance through the segment
+    double s = 0.0;
+    for (unsigned iter=0; iter< MAX_ADVANCES; iter++)
+    {
+      // pose the body at the interpolated pose
+      Pose3d P;
+      P.x = P0.x + (P1.x - P0.x)*s;
+      Quatd qs;
+      qs = AAngled(aa.x, aa.y, aa.z, aa.angle*s);
+      P.q = P0.q * qs;
+      rb->set_pose(P);
+
+      // get the minimum distance to the obstacles
+      double dist = INF;
+      for (unsigned i=0; i< obstacles.size(); i++)
+      {
+        // never sweep a geometry against its own body
+        if (obstacles[i] == cg || obstacles[i]->get_single_body() == cg->get_single_body())
+          continue;
+        Point3d pa, pb;
+        dist = std::min(dist, CollisionGeometry::calc_signed_dist(cg, obstacles[i], pa, pb));
+      }
+
+      // look for contact at this parameter
+      if (dist <= contact_dist)
+      {
+        toc = (seg + s)/NSEG;
+        break;
+      }
+
+      // a motionless segment that is free at one sample is free throughout
+      if (motion_bound < NEAR_ZERO)
+        break;
+
+      // advance by the certified-free fraction of the segment
+      s += std::max((dist - contact_dist)/motion_bound, MIN_STEP);
+      if (s >= 1.0)
+        break;
+    }
+
+    // stop sweeping at the first contact
+    if (toc < INF)
+      break;
+  }
+
+  // restore the body's pose
+  rb->set_pose(saved_pose);
+
+  return toc;
+}
+
 /// Generic method for *next* conservative step calculation (only for bodies in contact)
 double CCD::calc_next_CA_Euler_step_generic(const PairwiseDistInfo& pdi)
 {
@@ -361,7 +494,7 @@ double CCD::calc_next_CA_Euler_step_generic(const PairwiseDistInfo& pdi)
       // now transform it to the B pose
       SVelocityd rvB = aTb.inverse_transform(rvA);
 
-      return calc_next_CA_Euler_step_polyhedron_polyhedron(pA, pB, poseA, poseB, rvA, rvB, c.contact_normal, d);
+      return calc_next_CA_Euler_step_polyhedron_polyhedron(cgA, cgB, pA, pB, poseA, poseB, rvA, rvB, c.contact_normal, d);
     }
 
     // look for a plane
@@ -373,7 +506,7 @@ double CCD::calc_next_CA_Euler_step_generic(const PairwiseDistInfo& pdi)
       SVelocityd rv = Pose3d::transform(poseA, rbA->get_velocity()) -
                       Pose3d::transform(poseA, rbB->get_velocity());
 
-      return calc_next_CA_Euler_step_polyhedron_plane(pA, rv, poseA, c.contact_normal, d);
+      return calc_next_CA_Euler_step_polyhedron_plane(cgA, cgB, pA, rv, poseA, c.contact_normal, d);
     }
   }
 
@@ -390,7 +523,7 @@ double CCD::calc_next_CA_Euler_step_generic(const PairwiseDistInfo& pdi)
       SVelocityd rv = Pose3d::transform(poseB, rbA->get_velocity()) -
                       Pose3d::transform(poseB, rbB->get_velocity());
 
-      return calc_next_CA_Euler_step_polyhedron_plane(pB, -rv, poseB, -c.contact_normal, -d);
+      return calc_next_CA_Euler_step_polyhedron_plane(cgB, cgA, pB, -rv, poseB, -c.contact_normal, -d);
     }
   }
 
@@ -404,9 +537,10 @@ double CCD::calc_next_CA_Euler_step_generic(const PairwiseDistInfo& pdi)
  * \param nA the contact normal in frame A, given that polyhedron is defined in frame A
  * \param offset the offset of the contact plane
  */
-double CCD::calc_next_CA_Euler_step_polyhedron_plane(shared_ptr<PolyhedralPrimitive> p, const SVelocityd& rv, shared_ptr<const Pose3d> P, const Vector3d& normal, double offset0)
+double CCD::calc_next_CA_Euler_step_polyhedron_plane(CollisionGeometryPtr cgP, CollisionGeometryPtr cgPlane, shared_ptr<PolyhedralPrimitive> p, const SVelocityd& rv, shared_ptr<const Pose3d> P, const Vector3d& normal, double offset0)
 {
   const double INF = std::numeric_limits<double>::max();
+  const double MIN_STEP = 1e-5;
   double max_step = INF;
 
   // for illustration purposes, assume that polyhedron is body A, plane is
@@ -429,12 +563,26 @@ double CCD::calc_next_CA_Euler_step_polyhedron_plane(shared_ptr<PolyhedralPrimit
   // compute the dot product of the relative linear velocity and the normal
   double lv_dot_n = -nP.dot(rv.get_linear());
 
-  FILE_LOG(LOG_COLDET) << "CCD::calc_next_CA_Euler_step_polyhedron_plane(): contact normal: " << normal << " offset: " << offset0 << std::endl;  
-  FILE_LOG(LOG_COLDET) << "  lv'n: " << lv_dot_n << std::endl;  
+  FILE_LOG(LOG_COLDET) << "CCD::calc_next_CA_Euler_step_polyhedron_plane(): contact normal: " << normal << " offset: " << offset0 << std::endl;
+  FILE_LOG(LOG_COLDET) << "  lv'n: " << lv_dot_n << std::endl;
 
-  // loop over all vertices of the polyhedron (assumed to be in P frame)
-  for (unsigned i=0; i< v.size(); i++)
+  // determine how many vertices this query may examine and where to start;
+  // the continuation cursor rotates the examined slice across queries (see
+  // ca_vertex_budget)
+  unsigned n = v.size();
+  unsigned cursor = 0;
+  const bool budgeted = (ca_vertex_budget > 0 && v.size() > ca_vertex_budget);
+  if (budgeted)
   {
+    n = ca_vertex_budget;
+    cursor = _ca_cursors[std::make_pair(cgP, cgPlane)].first % v.size();
+  }
+
+  // loop over the vertices of the polyhedron (assumed to be in P frame)
+  for (unsigned k=0; k< n; k++)
+  {
+    const unsigned i = (cursor + k) % v.size();
+
     // get the distance of the vertex from the origin
     double r = v[i]->o.norm();
 
@@ -443,7 +591,7 @@ double CCD::calc_next_CA_Euler_step_polyhedron_plane(shared_ptr<PolyhedralPrimit
 
     // compute the distance from the vertex to the contact plane <n, x> = d
     double dist = nP.dot(vertex) - offset;
-    FILE_LOG(LOG_COLDET) << "vertex: " << Pose3d::transform_point(GLOBAL, vertex) << " distance: " << dist << " speed: " << std::max(0.0, lv_dot_n + av_norm*r) << "  max step: " << dist/std::max(0.0, lv_dot_n + av_norm*r) << std::endl;  
+    FILE_LOG(LOG_COLDET) << "vertex: " << Pose3d::transform_point(GLOBAL, vertex) << " distance: " << dist << " speed: " << std::max(0.0, lv_dot_n + av_norm*r) << "  max step: " << dist/std::max(0.0, lv_dot_n + av_norm*r) << std::endl;
 
     // if the distance is effectively zero, ignore the vertex
     if (dist < NEAR_ZERO)
@@ -452,10 +600,19 @@ double CCD::calc_next_CA_Euler_step_polyhedron_plane(shared_ptr<PolyhedralPrimit
     // compute the speed of the vertex
     double speed = std::max(0.0, lv_dot_n + av_norm*r);
 
-    // divide the distance by the maximum speed of that vertex   
+    // divide the distance by the maximum speed of that vertex
     max_step = std::min(max_step, dist/speed);
   }
 
+  // unexamined vertices are covered by the minimum-step fallback: examined
+  // vertices can only lower the step further, so the result stays safe;
+  // advance the cursor so the next query examines a fresh slice
+  if (budgeted)
+  {
+    max_step = std::min(max_step, MIN_STEP);
+    _ca_cursors[std::make_pair(cgP, cgPlane)].first = (cursor + n) % v.size();
+  }
+
   return max_step;
 }
 
@@ -464,9 +621,10 @@ double CCD::calc_next_CA_Euler_step_polyhedron_plane(shared_ptr<PolyhedralPrimit
  * \param nA the contact normal in frame A, given that polyhedron is defined in frame A
  * \param offset the offset of the contact plane
  */
-double CCD::calc_next_CA_Euler_step_polyhedron_polyhedron(shared_ptr<PolyhedralPrimitive> pA, shared_ptr<PolyhedralPrimitive> pB, shared_ptr<const Pose3d> poseA, shared_ptr<const Pose3d> poseB, const SVelocityd& rvA, const SVelocityd& rvB, const Vector3d& n0, double offset0)
+double CCD::calc_next_CA_Euler_step_polyhedron_polyhedron(CollisionGeometryPtr cgA, CollisionGeometryPtr cgB, shared_ptr<PolyhedralPrimitive> pA, shared_ptr<PolyhedralPrimitive> pB, shared_ptr<const Pose3d> poseA, shared_ptr<const Pose3d> poseB, const SVelocityd& rvA, const SVelocityd& rvB, const Vector3d& n0, double offset0)
 {
   const double INF = std::numeric_limits<double>::max();
+  const double MIN_STEP = 1e-5;
   double max_step = INF;
 
   // get the normal in A and B's frames
@@ -492,9 +650,30 @@ double CCD::calc_next_CA_Euler_step_polyhedron_polyhedron(shared_ptr<PolyhedralP
   double lvA_dot_n = -nA.dot(rvA.get_linear());
   double lvB_dot_n = nB.dot(rvB.get_linear());
 
-  // loop over all vertices of polyhedron A 
-  for (unsigned i=0; i< vA.size(); i++)
+  // determine how many vertices of each polyhedron this query may examine
+  // and where to start; the budget is split proportionally to the vertex
+  // counts, and the continuation cursors rotate the examined slices across
+  // queries (see ca_vertex_budget)
+  unsigned examA = vA.size(), examB = vB.size();
+  unsigned cursorA = 0, cursorB = 0;
+  const bool budgeted = (ca_vertex_budget > 0 &&
+                         vA.size() + vB.size() > ca_vertex_budget);
+  if (budgeted)
+  {
+    examA = (unsigned) ((double) ca_vertex_budget * vA.size()/(vA.size() + vB.size()));
+    examB = ca_vertex_budget - examA;
+    examA = std::min(examA, (unsigned) vA.size());
+    examB = std::min(examB, (unsigned) vB.size());
+    const std::pair<unsigned, unsigned>& cursors = _ca_cursors[std::make_pair(cgA, cgB)];
+    cursorA = cursors.first % vA.size();
+    cursorB = cursors.second % vB.size();
+  }
+
+  // loop over the vertices of polyhedron A
+  for (unsigned k=0; k< examA; k++)
   {
+    const unsigned i = (cursorA + k) % vA.size();
+
     // get the distance of the vertex from the origin
     double r = vA[i]->o.norm();
 
@@ -511,13 +690,15 @@ double CCD::calc_next_CA_Euler_step_polyhedron_polyhedron(shared_ptr<PolyhedralP
     // compute the speed of the vertex
     double speed = std::max(0.0, lvA_dot_n + avA_norm*r);
 
-    // divide the distance by the maximum speed of that vertex   
+    // divide the distance by the maximum speed of that vertex
     max_step = std::min(max_step, dist/speed);
   }
 
-  // loop over all vertices of polyhedron B 
-  for (unsigned i=0; i< vB.size(); i++)
+  // loop over the vertices of polyhedron B
+  for (unsigned k=0; k< examB; k++)
   {
+    const unsigned i = (cursorB + k) % vB.size();
+
     // get the distance of the vertex from the origin
     double r = vB[i]->o.norm();
 
@@ -534,10 +715,21 @@ double CCD::calc_next_CA_Euler_step_polyhedron_polyhedron(shared_ptr<PolyhedralP
     // compute the speed of the vertex
     double speed = std::max(0.0, lvB_dot_n + avB_norm*r);
 
-    // divide the distance by the maximum speed of that vertex   
+    // divide the distance by the maximum speed of that vertex
     max_step = std::min(max_step, dist/speed);
   }
 
+  // unexamined vertices are covered by the minimum-step fallback: examined
+  // vertices can only lower the step further, so the result stays safe;
+  // advance the cursors so the next query examines fresh slices
+  if (budgeted)
+  {
+    max_step = std::min(max_step, MIN_STEP);
+    std::pair<unsigned, unsigned>& cursors = _ca_cursors[std::make_pair(cgA, cgB)];
+    cursors.first = (cursorA + examA) % vA.size();
+    cursors.second = (cursorB + examB) % vB.size();
+  }
+
   return max_step;
 }
 
@@ -670,6 +862,129 @@ double CCD::calc_max_dist_per_t(RigidBodyPtr rb, const Vector3d& n, double rlen)
 }
 */
 
+/// Estimates the heap memory held by the detector's internal state, in bytes
+/**
+ * Counts the sweep-and-prune bounds arrays, the per-geometry bounding
+ * spheres, and the temporal-coherence caches.  Estimates exclude allocator
+ * overhead (see Primitive::calc_memory_usage()).
+ */
+unsigned long CCD::calc_memory_usage() const
+{
+  // red-black tree nodes carry three links plus a color beyond the payload
+  const unsigned long MAP_NODE = 3*sizeof(void*) + sizeof(int);
+
+  unsigned long bytes = 0;
+
+  // sweep-and-prune state
+  bytes += _x_bounds.capacity()*sizeof(std::pair<double, BoundsStruct>);
+  bytes += _y_bounds.capacity()*sizeof(std::pair<double, BoundsStruct>);
+  bytes += _z_bounds.capacity()*sizeof(std::pair<double, BoundsStruct>);
+  bytes += _packed_bounds.capacity()*sizeof(double);
+
+  // baked static hierarchy
+  bytes += _static_nodes.capacity()*sizeof(StaticNode);
+  bytes += _static_geoms.capacity()*sizeof(CollisionGeometryPtr);
+  bytes += _static_baked.capacity()*sizeof(CollisionGeometryPtr);
+
+  // per-geometry bounding data
+  bytes += _rmax.size()*(sizeof(std::pair<CollisionGeometryPtr, double>) + MAP_NODE);
+  bytes += _bounding_spheres.size()*(sizeof(std::pair<CollisionGeometryPtr, BVPtr>) + sizeof(BoundingSphere) + MAP_NODE);
+  bytes += _swept_BVs.size()*(sizeof(std::pair<CollisionGeometryPtr, BVPtr>) + sizeof(BoundingSphere) + MAP_NODE);
+
+  // temporal-coherence caches
+  bytes += _min_dist_observed.size()*(sizeof(std::pair<sorted_pair<CollisionGeometryPtr>, double>) + MAP_NODE);
+  bytes += _box_box_sep_axis.size()*(sizeof(std::pair<std::pair<CollisionGeometryPtr, CollisionGeometryPtr>, unsigned>) + MAP_NODE);
+  bytes += _vclip_features.size()*(sizeof(std::pair<std::pair<CollisionGeometryPtr, CollisionGeometryPtr>, std::pair<shared_ptr<const Polyhedron::Feature>, shared_ptr<const Polyhedron::Feature> > >) + MAP_NODE);
+  bytes += _ca_cursors.size()*(sizeof(std::pair<std::pair<CollisionGeometryPtr, CollisionGeometryPtr>, std::pair<unsigned, unsigned> >) + MAP_NODE);
+  bytes += _transform_cache.size()*(sizeof(std::pair<const Pose3d*, const Pose3d*>) + sizeof(Transform3d) + MAP_NODE);
+
+  return bytes;
+}
+
+/// Releases caches that can be rebuilt on demand
+/**
+ * Drops the swept BVs, the memoized transforms, and the temporal-coherence
+ * warm starts; subsequent queries recompute them (the warm starts only make
+ * queries faster, never change their results).  The sweep-and-prune bounds
+ * and the bounding spheres are kept: the bounds structures reference the
+ * spheres and both are rebuilt only when geometries are added or removed.
+ */
+void CCD::release_transient_memory()
+{
+  _swept_BVs.clear();
+  _min_dist_observed.clear();
+  _box_box_sep_axis.clear();
+  _vclip_features.clear();
+  _ca_cursors.clear();
+  _transform_cache.clear();
+
+  // the baked static hierarchy is rebuilt on demand from current poses
+  _static_nodes.clear();
+  _static_geoms.clear();
+  _static_baked.clear();
+  _static_root = -1;
+}
+
+/// Implements CollisionDetection::invalidate_pair_state()
+/**
+ * Erases the per-pair state kept across steps for every pair involving one
+ * of the body's geometries, in time linear in those pairs.  The minimum
+ * observed distance is a bound accumulated over the pair's pose history;
+ * after a discontinuous repositioning it can overstate the current
+ * separation and let conservative advancement step through a collision, so
+ * it must go.  The box-box separating axis and v-clip feature warm starts
+ * remain correct but only pay off under temporal coherence, which the jump
+ * has broken, so they are dropped as well.  Per-step caches (swept BVs,
+ * memoized transforms) are rebuilt every broad phase and need no surgery;
+ * the sweep-and-prune bounds are refilled from current poses each step and
+ * merely sort more slowly once after the jump.
+ */
+void CCD::invalidate_pair_state(ControlledBodyPtr body)
+{
+  // collect the body's collision geometries (per link for articulated bodies)
+  set<CollisionGeometryPtr> geoms;
+  ArticulatedBodyPtr ab = dynamic_pointer_cast<ArticulatedBody>(body);
+  if (ab)
+  {
+    BOOST_FOREACH(shared_ptr<RigidBodyd> link, ab->get_links())
+    {
+      RigidBodyPtr rb = dynamic_pointer_cast<RigidBody>(link);
+      geoms.insert(rb->geometries.begin(), rb->geometries.end());
+    }
+  }
+  else
+  {
+    RigidBodyPtr rb = dynamic_pointer_cast<RigidBody>(body);
+    if (rb)
+      geoms.insert(rb->geometries.begin(), rb->geometries.end());
+  }
+
+  // erase the pose-history distance bounds involving those geometries
+  for (map<sorted_pair<CollisionGeometryPtr>, double>::iterator i = _min_dist_observed.begin(); i != _min_dist_observed.end(); )
+  {
+    if (geoms.find(i->first.first) != geoms.end() || geoms.find(i->first.second) != geoms.end())
+      _min_dist_observed.erase(i++);
+    else
+      i++;
+  }
+
+  // erase the temporal-coherence warm starts involving those geometries
+  for (map<pair<CollisionGeometryPtr, CollisionGeometryPtr>, unsigned>::iterator i = _box_box_sep_axis.begin(); i != _box_box_sep_axis.end(); )
+  {
+    if (geoms.find(i->first.first) != geoms.end() || geoms.find(i->first.second) != geoms.end())
+      _box_box_sep_axis.erase(i++);
+    else
+      i++;
+  }
+  for (map<pair<CollisionGeometryPtr, CollisionGeometryPtr>, pair<shared_ptr<const Polyhedron::Feature>, shared_ptr<const Polyhedron::Feature> > >::iterator i = _vclip_features.begin(); i != _vclip_features.end(); )
+  {
+    if (geoms.find(i->first.first) != geoms.end() || geoms.find(i->first.second) != geoms.end())
+      _vclip_features.erase(i++);
+    else
+      i++;
+  }
+}
+
 /// Implements Base::load_from_xml()
 void CCD::load_from_xml(shared_ptr<const XMLTree> node, map<std::string, BasePtr>& id_map)
 {
@@ -680,6 +995,21 @@ void CCD::load_from_xml(shared_ptr<const XMLTree> node, map<std::string, BasePtr
 
   // call parent
   CollisionDetection::load_from_xml(node, id_map);
+
+  // read whether bodies enter the broad phase as compound proxies, if given
+  XMLAttrib* compound_attrib = node->get_attrib("compound-broad-phase");
+  if (compound_attrib)
+    compound_broad_phase = compound_attrib->get_bool_value();
+
+  // read the vertex budget for polyhedral conservative advancement, if given
+  XMLAttrib* ca_budget_attrib = node->get_attrib("ca-vertex-budget");
+  if (ca_budget_attrib)
+    ca_vertex_budget = ca_budget_attrib->get_unsigned_value();
+
+  // read whether static geometry is baked into one hierarchy, if given
+  XMLAttrib* bake_attrib = node->get_attrib("bake-static-geometry");
+  if (bake_attrib)
+    bake_static_geometry = bake_attrib->get_bool_value();
 }
 
 /// Implements Base::save_to_xml()
@@ -692,13 +1022,337 @@ void CCD::save_to_xml(XMLTreePtr node, list<shared_ptr<const Base> >& shared_obj
   // do not (re)set the node name - there can be derived classes
   // node->name = "CCD";
 
-  // call the parent method 
+  // call the parent method
   CollisionDetection::save_to_xml(node, shared_objects);
+
+  // save whether bodies enter the broad phase as compound proxies
+  node->attribs.insert(XMLAttrib("compound-broad-phase", compound_broad_phase));
+
+  // save the vertex budget for polyhedral conservative advancement
+  node->attribs.insert(XMLAttrib("ca-vertex-budget", ca_vertex_budget));
+
+  // save whether static geometry is baked into one hierarchy
+  node->attribs.insert(XMLAttrib("bake-static-geometry", bake_static_geometry));
 }
 
 /****************************************************************************
  Methods for broad phase begin
 ****************************************************************************/
+/// Swept world-space bounds of one convex piece (compound broad phase)
+struct PieceBound
+{
+  CollisionGeometryPtr geom;
+  double lo[3], hi[3];
+};
+
+/// A node of the per-body hierarchy over piece bounds
+struct CompoundNode
+{
+  double lo[3], hi[3];
+  int left, right;             // child node indices (-1 at leaves)
+  int piece;                   // piece index at leaves (-1 otherwise)
+};
+
+/// Orders piece indices by bound center along one axis
+struct PieceCenterComp
+{
+  PieceCenterComp(const vector<PieceBound>& bounds_, unsigned axis_) : bounds(bounds_) { axis = axis_; }
+  bool operator()(unsigned i, unsigned j) const { return bounds[i].lo[axis] + bounds[i].hi[axis] < bounds[j].lo[axis] + bounds[j].hi[axis]; }
+  const vector<PieceBound>& bounds;
+  unsigned axis;
+};
+
+/// Builds a median-split hierarchy node over pieces[begin, end), returning its index
+static int build_compound_tree(const vector<PieceBound>& bounds, vector<unsigned>& pieces, unsigned begin, unsigned end, vector<CompoundNode>& nodes)
+{
+  const unsigned THREE_D = 3;
+
+  // compute the node bounds over the piece range
+  CompoundNode n;
+  for (unsigned k=0; k< THREE_D; k++)
+  {
+    n.lo[k] = bounds[pieces[begin]].lo[k];
+    n.hi[k] = bounds[pieces[begin]].hi[k];
+  }
+  for (unsigned i=begin+1; i< end; i++)
+    for (unsigned k=0; k< THREE_D; k++)
+    {
+      n.lo[k] = std::min(n.lo[k], bounds[pieces[i]].lo[k]);
+      n.hi[k] = std::max(n.hi[k], bounds[pieces[i]].hi[k]);
+    }
+
+  // make a leaf from a single piece
+  if (end - begin == 1)
+  {
+    n.left = n.right = -1;
+    n.piece = (int) pieces[begin];
+    nodes.push_back(n);
+    return (int) nodes.size()-1;
+  }
+
+  // partition the pieces at the median along the longest node axis
+  unsigned axis = 0;
+  for (unsigned k=1; k< THREE_D; k++)
+    if (n.hi[k] - n.lo[k] > n.hi[axis] - n.lo[axis])
+      axis = k;
+  unsigned mid = begin + (end - begin)/2;
+  std::nth_element(pieces.begin()+begin, pieces.begin()+mid, pieces.begin()+end, PieceCenterComp(bounds, axis));
+
+  // build the children
+  n.piece = -1;
+  n.left = build_compound_tree(bounds, pieces, begin, mid, nodes);
+  n.right = build_compound_tree(bounds, pieces, mid, end, nodes);
+  nodes.push_back(n);
+  return (int) nodes.size()-1;
+}
+
+/// Tests two hierarchy nodes for bound overlap
+static bool compound_nodes_overlap(const CompoundNode& a, const CompoundNode& b)
+{
+  return !(a.hi[0] < b.lo[0] || b.hi[0] < a.lo[0] ||
+           a.hi[1] < b.lo[1] || b.hi[1] < a.lo[1] ||
+           a.hi[2] < b.lo[2] || b.hi[2] < a.lo[2]);
+}
+
+/// Descends two per-body hierarchies, emitting all overlapping piece pairs
+static void descend_compound_trees(const vector<PieceBound>& boundsA, const vector<CompoundNode>& nodesA, int a, const vector<PieceBound>& boundsB, const vector<CompoundNode>& nodesB, int b, const std::set<sorted_pair<CollisionGeometryPtr> >& disabled, vector<pair<CollisionGeometryPtr, CollisionGeometryPtr> >& to_check)
+{
+  // prune disjoint subtrees
+  if (!compound_nodes_overlap(nodesA[a], nodesB[b]))
+    return;
+
+  // emit a candidate pair from two leaves
+  const bool leafA = (nodesA[a].piece >= 0);
+  const bool leafB = (nodesB[b].piece >= 0);
+  if (leafA && leafB)
+  {
+    CollisionGeometryPtr cgA = boundsA[nodesA[a].piece].geom;
+    CollisionGeometryPtr cgB = boundsB[nodesB[b].piece].geom;
+    if (disabled.find(make_sorted_pair(cgA, cgB)) != disabled.end())
+      return;
+    to_check.push_back(make_pair(cgA, cgB));
+    return;
+  }
+
+  // descend the hierarchy with the larger node (a leaf is never descended)
+  double extA = (nodesA[a].hi[0] - nodesA[a].lo[0]) + (nodesA[a].hi[1] - nodesA[a].lo[1]) + (nodesA[a].hi[2] - nodesA[a].lo[2]);
+  double extB = (nodesB[b].hi[0] - nodesB[b].lo[0]) + (nodesB[b].hi[1] - nodesB[b].lo[1]) + (nodesB[b].hi[2] - nodesB[b].lo[2]);
+  if (leafB || (!leafA && extA > extB))
+  {
+    descend_compound_trees(boundsA, nodesA, nodesA[a].left, boundsB, nodesB, b, disabled, to_check);
+    descend_compound_trees(boundsA, nodesA, nodesA[a].right, boundsB, nodesB, b, disabled, to_check);
+  }
+  else
+  {
+    descend_compound_trees(boundsA, nodesA, a, boundsB, nodesB, nodesB[b].left, disabled, to_check);
+    descend_compound_trees(boundsA, nodesA, a, boundsB, nodesB, nodesB[b].right, disabled, to_check);
+  }
+}
+
+/// Body-level broad phase for bodies decomposed into many convex pieces
+/**
+ * Each body contributes exactly one proxy (the union of its pieces' swept
+ * bounds) to a sweep over the x-axis; only body pairs whose proxies overlap
+ * on all three axes descend their per-body hierarchies against each other,
+ * so two nearby decomposed bodies test piece pairs through two log-depth
+ * trees instead of flooding the global sweep-and-prune with every piece.
+ * The hierarchies are rebuilt from the current swept bounds each step:
+ * piece counts are small enough (tens) that rebuilding costs less than
+ * maintaining piece-level persistent structures.
+ */
+void CCD::broad_phase_compound(double dt, const vector<RigidBodyPtr>& rbs, vector<pair<CollisionGeometryPtr, CollisionGeometryPtr> >& to_check)
+{
+  const unsigned THREE_D = 3;
+
+  // compute swept piece bounds and build the per-body hierarchies
+  vector<vector<PieceBound> > bounds(rbs.size());
+  vector<vector<CompoundNode> > nodes(rbs.size());
+  vector<int> roots(rbs.size(), -1);
+  for (unsigned i=0; i< rbs.size(); i++)
+  {
+    BOOST_FOREACH(CollisionGeometryPtr cg, rbs[i]->geometries)
+    {
+      // compute the swept bounding volume (defined in the global frame)
+      BVPtr bv = construct_bounding_sphere(cg);
+      BVPtr swept_bv = get_swept_BV(cg, bv, dt);
+      assert(swept_bv->get_relative_pose() == GLOBAL);
+
+      // store the piece bounds
+      PieceBound pb;
+      pb.geom = cg;
+      Point3d lo = swept_bv->get_lower_bounds();
+      Point3d hi = swept_bv->get_upper_bounds();
+      for (unsigned k=0; k< THREE_D; k++)
+      {
+        pb.lo[k] = lo[k];
+        pb.hi[k] = hi[k];
+      }
+      bounds[i].push_back(pb);
+    }
+
+    // build the hierarchy over this body's pieces
+    if (bounds[i].empty())
+      continue;
+    vector<unsigned> order(bounds[i].size());
+    for (unsigned j=0; j< order.size(); j++)
+      order[j] = j;
+    roots[i] = build_compound_tree(bounds[i], order, 0, order.size(), nodes[i]);
+  }
+
+  // sweep the body proxies along the x-axis
+  vector<pair<double, unsigned> > starts;
+  for (unsigned i=0; i< rbs.size(); i++)
+    if (roots[i] >= 0)
+      starts.push_back(make_pair(nodes[i][roots[i]].lo[0], i));
+  std::sort(starts.begin(), starts.end());
+  for (unsigned ii=0; ii< starts.size(); ii++)
+  {
+    const unsigned i = starts[ii].second;
+    const CompoundNode& rootA = nodes[i][roots[i]];
+    for (unsigned jj=ii+1; jj< starts.size() && starts[jj].first <= rootA.hi[0]; jj++)
+    {
+      const unsigned j = starts[jj].second;
+
+      // only proxies that overlap on all three axes are candidates
+      if (!compound_nodes_overlap(rootA, nodes[j][roots[j]]))
+        continue;
+
+      // if both rigid bodies are disabled, don't check
+      if (!rbs[i]->is_enabled() && !rbs[j]->is_enabled())
+        continue;
+
+      FILE_LOG(LOG_COLDET) << "compound overlap between " << rbs[i]->body_id << " and " << rbs[j]->body_id << std::endl;
+
+      // descend the two hierarchies to emit surviving piece pairs
+      descend_compound_trees(bounds[i], nodes[i], roots[i], bounds[j], nodes[j], roots[j], disabled_pairs, to_check);
+    }
+  }
+}
+
+/// Maintains the baked hierarchy over all static geometry (see bake_static_geometry)
+/**
+ * Rebakes only when the set of static geometries changes or a static body
+ * has been repositioned explicitly (which marks its geometries' poses
+ * stale); an unchanged scene revalidates the bake with one pass over the
+ * static geometries and no tree work.  The hierarchy is built with the
+ * same median-split construction used for compound bodies, with one leaf
+ * per static geometry.
+ */
+void CCD::update_static_tree(double dt, const vector<RigidBodyPtr>& static_rbs)
+{
+  const unsigned THREE_D = 3;
+
+  // gather the static geometries
+  vector<CollisionGeometryPtr> statics;
+  for (unsigned i=0; i< static_rbs.size(); i++)
+    BOOST_FOREACH(CollisionGeometryPtr cg, static_rbs[i]->geometries)
+      statics.push_back(cg);
+  std::sort(statics.begin(), statics.end());
+
+  // an existing bake remains valid until the set changes or a pose moves
+  bool stale = (statics != _static_baked);
+  for (unsigned i=0; i< statics.size() && !stale; i++)
+    stale = statics[i]->pose_stale();
+  if (!stale)
+    return;
+
+  // drop farthest-point entries for static geometries that left the scene
+  // (entries for geometries that merely became dynamic again are owned by
+  // the sweep bookkeeping and are left alone)
+  for (unsigned i=0; i< _static_baked.size(); i++)
+    if (!std::binary_search(statics.begin(), statics.end(), _static_baked[i]) &&
+        _bounding_spheres.find(_static_baked[i]) == _bounding_spheres.end())
+      _rmax.erase(_static_baked[i]);
+
+  // compute world-space bounds for every static geometry; conservative
+  // advancement still needs the farthest-point distances for pairs with
+  // these geometries, so keep them registered even though the geometries
+  // no longer pass through the sweep bookkeeping
+  vector<PieceBound> bounds(statics.size());
+  for (unsigned i=0; i< statics.size(); i++)
+  {
+    CollisionGeometryPtr cg = statics[i];
+    if (_rmax.find(cg) == _rmax.end())
+      _rmax[cg] = cg->get_farthest_point_distance();
+
+    // compute the bounding volume (defined in the global frame)
+    BVPtr bv = construct_bounding_sphere(cg);
+    BVPtr swept_bv = get_swept_BV(cg, bv, dt);
+    assert(swept_bv->get_relative_pose() == GLOBAL);
+
+    // store the leaf bounds
+    bounds[i].geom = cg;
+    Point3d lo = swept_bv->get_lower_bounds();
+    Point3d hi = swept_bv->get_upper_bounds();
+    for (unsigned k=0; k< THREE_D; k++)
+    {
+      bounds[i].lo[k] = lo[k];
+      bounds[i].hi[k] = hi[k];
+    }
+
+    // the baked bounds now reflect the current pose
+    cg->clear_pose_stale();
+  }
+
+  // (re)bake the hierarchy
+  _static_nodes.clear();
+  _static_geoms.clear();
+  _static_root = -1;
+  if (!bounds.empty())
+  {
+    vector<unsigned> order(bounds.size());
+    for (unsigned i=0; i< order.size(); i++)
+      order[i] = i;
+    vector<CompoundNode> nodes;
+    _static_root = build_compound_tree(bounds, order, 0, order.size(), nodes);
+
+    // adopt the nodes; leaves reference geometries by index
+    _static_nodes.resize(nodes.size());
+    for (unsigned i=0; i< nodes.size(); i++)
+    {
+      for (unsigned k=0; k< THREE_D; k++)
+      {
+        _static_nodes[i].lo[k] = nodes[i].lo[k];
+        _static_nodes[i].hi[k] = nodes[i].hi[k];
+      }
+      _static_nodes[i].left = nodes[i].left;
+      _static_nodes[i].right = nodes[i].right;
+      _static_nodes[i].geom = nodes[i].piece;
+    }
+    _static_geoms.resize(bounds.size());
+    for (unsigned i=0; i< bounds.size(); i++)
+      _static_geoms[i] = bounds[i].geom;
+  }
+  _static_baked.swap(statics);
+
+  FILE_LOG(LOG_COLDET) << "CCD::update_static_tree() baked " << _static_geoms.size() << " static geometries" << std::endl;
+}
+
+/// Queries the baked static hierarchy with a world-space box, emitting candidate pairs
+void CCD::query_static_tree(int n, const double lo[3], const double hi[3], CollisionGeometryPtr geom, vector<pair<CollisionGeometryPtr, CollisionGeometryPtr> >& to_check) const
+{
+  const StaticNode& node = _static_nodes[n];
+
+  // prune disjoint subtrees
+  if (node.hi[0] < lo[0] || hi[0] < node.lo[0] ||
+      node.hi[1] < lo[1] || hi[1] < node.lo[1] ||
+      node.hi[2] < lo[2] || hi[2] < node.lo[2])
+    return;
+
+  // emit a candidate pair at a leaf
+  if (node.geom >= 0)
+  {
+    CollisionGeometryPtr sg = _static_geoms[node.geom];
+    if (disabled_pairs.find(make_sorted_pair(geom, sg)) == disabled_pairs.end())
+      to_check.push_back(make_pair(geom, sg));
+    return;
+  }
+
+  // descend
+  query_static_tree(node.left, lo, hi, geom, to_check);
+  query_static_tree(node.right, lo, hi, geom, to_check);
+}
+
 void CCD::broad_phase(double dt, const vector<ControlledBodyPtr>& bodies, vector<pair<CollisionGeometryPtr, CollisionGeometryPtr> >& to_check)
 {
   FILE_LOG(LOG_COLDET) << "CCD::broad_phase() entered" << std::endl;
@@ -706,6 +1360,10 @@ void CCD::broad_phase(double dt, const vector<ControlledBodyPtr>& bodies, vector
   // clear the swept BVs
   _swept_BVs.clear();
 
+  // poses have moved since the last step, so the memoized relative
+  // transforms used by the narrow phase are stale
+  _transform_cache.clear();
+
   // get the set of rigid bodies
   vector<RigidBodyPtr> rbs;
   for (unsigned i=0; i< bodies.size(); i++)
@@ -720,37 +1378,80 @@ void CCD::broad_phase(double dt, const vector<ControlledBodyPtr>& bodies, vector
       rbs.push_back(dynamic_pointer_cast<RigidBody>(bodies[i]));
   }
 
-  // look to see whether the bounds vector needs to be rebuilt
+  // decomposed bodies may enter the broad phase as one proxy per body
+  if (compound_broad_phase)
+  {
+    to_check.clear();
+    broad_phase_compound(dt, rbs, to_check);
+    FILE_LOG(LOG_COLDET) << "CCD::broad_phase() exited" << std::endl;
+    return;
+  }
+
+  // static geometry may be baked into a single world-space hierarchy; the
+  // sweep and its persistent bookkeeping then track dynamic bodies only,
+  // and each dynamic geometry queries the baked hierarchy directly (below)
+  vector<RigidBodyPtr> static_rbs;
+  if (bake_static_geometry)
+  {
+    vector<RigidBodyPtr> dynamic_rbs;
+    for (unsigned i=0; i< rbs.size(); i++)
+    {
+      if (rbs[i]->is_enabled())
+        dynamic_rbs.push_back(rbs[i]);
+      else
+        static_rbs.push_back(rbs[i]);
+    }
+    rbs.swap(dynamic_rbs);
+  }
+
+  // look to see whether the set of geometries has changed; if it has, splice
+  // the additions/removals into the persistent bounds vectors rather than
+  // rebuilding and re-sorting them from scratch
   unsigned count = 0;
   for (unsigned i=0; i< rbs.size(); i++)
     count += rbs[i]->geometries.size();
   if (count != _bounding_spheres.size())
   {
-    // clear the map of bounding spheres
-    _bounding_spheres.clear();
-
-    // indicate the bounding vectors need to be rebuilt
-    _rebuild_bounds_vecs = true;
-
+    // determine the set of geometries currently in the scene
+    set<CollisionGeometryPtr> current;
     for (unsigned j=0; j< rbs.size(); j++)
-    BOOST_FOREACH(CollisionGeometryPtr i, rbs[j]->geometries)
+      BOOST_FOREACH(CollisionGeometryPtr i, rbs[j]->geometries)
+        current.insert(i);
+
+    // remove bounds and cached data for geometries no longer present
+    for (std::map<CollisionGeometryPtr, BVPtr>::iterator i = _bounding_spheres.begin(); i != _bounding_spheres.end(); )
     {
-      // get farthest distance on each geometry while we're at it
-      _rmax[i] = i->get_farthest_point_distance();
+      if (current.find(i->first) == current.end())
+      {
+        remove_bounds(i->first);
+        _rmax.erase(i->first);
+        _bounding_spheres.erase(i++);
+      }
+      else
+        i++;
+    }
 
-      // get the primitive for the geometry
-      PrimitivePtr p = i->get_geometry();
+    // add bounds and cached data for newly added geometries
+    BOOST_FOREACH(CollisionGeometryPtr i, current)
+      if (_bounding_spheres.find(i) == _bounding_spheres.end())
+      {
+        // get farthest distance on each geometry while we're at it
+        _rmax[i] = i->get_farthest_point_distance();
 
-      // construct a bounding sphere for the geometry
-      BVPtr bv = construct_bounding_sphere(i);
+        // construct a bounding sphere for the geometry
+        BVPtr bv = construct_bounding_sphere(i);
 
-      // store the bounding sphere
-      _bounding_spheres[i] = bv;
-    }
+        // store the bounding sphere
+        _bounding_spheres[i] = bv;
+
+        // splice the new bounds into the persistent bounds vectors
+        add_bounds(i, bv);
+      }
   }
-  else
+
+  // update any bounding spheres that need to be rebuilt
+  if (!_rebuild_bounds_vecs)
   {
-    // update any bounding spheres that need to be rebuild
     for (std::map<CollisionGeometryPtr, BVPtr>::iterator i = _bounding_spheres.begin(); i != _bounding_spheres.end(); i++)
     {
       RigidBodyPtr rb = dynamic_pointer_cast<RigidBody>(i->first->get_single_body());
@@ -771,91 +1472,42 @@ void CCD::broad_phase(double dt, const vector<ControlledBodyPtr>& bodies, vector
   // clear the vector of pairs to check
   to_check.clear();
 
+  // validate (or rebake) the static hierarchy after the bookkeeping above,
+  // so geometries that just became static have left the sweep structures
+  if (bake_static_geometry)
+    update_static_tree(dt, static_rbs);
+
   // sort the AABBs
   sort_AABBs(rbs, dt);
 
-  // store how many overlaps we have for pairs
-  map<sorted_pair<CollisionGeometryPtr>, unsigned> overlaps;
-
-  // set of active bounds
-  set<CollisionGeometryPtr> active_bounds;
-
-  // scan through the x-bounds
-  for (unsigned i=0; i< _x_bounds.size(); i++)
-  {
-    // eliminate from the active bounds if at the end of a bound
-    if (_x_bounds[i].second.end)
-    {
-      assert(active_bounds.find(_x_bounds[i].second.geom) != active_bounds.end());
-      active_bounds.erase(_x_bounds[i].second.geom);
-    }
-    else
-    {
-      // at the start of a bound
-      BOOST_FOREACH(CollisionGeometryPtr cg, active_bounds)
-        overlaps[make_sorted_pair(cg, _x_bounds[i].second.geom)]++;
-
-      // add the geometry to the active set
-      active_bounds.insert(_x_bounds[i].second.geom);
-    }
-  }
-
-  // scan through the y-bounds
-  for (unsigned i=0; i< _y_bounds.size(); i++)
-  {
-    // eliminate from the active bounds if at the end of a bound
-    if (_y_bounds[i].second.end)
-    {
-      assert(active_bounds.find(_y_bounds[i].second.geom) != active_bounds.end());
-      active_bounds.erase(_y_bounds[i].second.geom);
-    }
-    else
-    {
-      // at the start of a bound
-      BOOST_FOREACH(CollisionGeometryPtr cg, active_bounds)
-        overlaps[make_sorted_pair(cg, _y_bounds[i].second.geom)]++;
+  // sweep each axis, accumulating overlapping pairs into flat buffers
+  vector<sorted_pair<CollisionGeometryPtr> > x_overlaps, y_overlaps, z_overlaps;
+  sweep_axis(_x_bounds, x_overlaps);
+  sweep_axis(_y_bounds, y_overlaps);
+  sweep_axis(_z_bounds, z_overlaps);
 
-      // add the geometry to the active set
-      active_bounds.insert(_y_bounds[i].second.geom);
-    }
-  }
+  // sort the per-axis buffers so that they may be intersected
+  std::sort(x_overlaps.begin(), x_overlaps.end());
+  std::sort(y_overlaps.begin(), y_overlaps.end());
+  std::sort(z_overlaps.begin(), z_overlaps.end());
 
-  // scan through the z-bounds
-  for (unsigned i=0; i< _z_bounds.size(); i++)
-  {
-    // eliminate from the active bounds if at the end of a bound
-    if (_z_bounds[i].second.end)
-    {
-      assert(active_bounds.find(_z_bounds[i].second.geom) != active_bounds.end());
-      active_bounds.erase(_z_bounds[i].second.geom);
-    }
-    else
-    {
-      // at the start of a bound
-      BOOST_FOREACH(CollisionGeometryPtr cg, active_bounds)
-        overlaps[make_sorted_pair(cg, _z_bounds[i].second.geom)]++;
-
-      // add the geometry to the active set
-      active_bounds.insert(_z_bounds[i].second.geom);
-    }
-  }
+  // only pairs that overlap along all three axes are candidates
+  vector<sorted_pair<CollisionGeometryPtr> > xy_overlaps, overlaps;
+  std::set_intersection(x_overlaps.begin(), x_overlaps.end(), y_overlaps.begin(), y_overlaps.end(), std::back_inserter(xy_overlaps));
+  std::set_intersection(xy_overlaps.begin(), xy_overlaps.end(), z_overlaps.begin(), z_overlaps.end(), std::back_inserter(overlaps));
 
   // now setup pairs to check
-  for (map<sorted_pair<CollisionGeometryPtr>, unsigned>::const_iterator i = overlaps.begin(); i != overlaps.end(); i++)
+  for (vector<sorted_pair<CollisionGeometryPtr> >::const_iterator i = overlaps.begin(); i != overlaps.end(); i++)
   {
-    FILE_LOG(LOG_COLDET) << i->second << " overlaps between " << i->first.first << " (" << i->first.first->get_single_body()->body_id << ") and " << i->first.second << " (" << i->first.second->get_single_body()->body_id << ")" << std::endl;
-
-    // only consider the pair if they overlap in all three dimensions
-    if (i->second < 3)
-      continue;
+    FILE_LOG(LOG_COLDET) << "overlap between " << i->first << " (" << i->first->get_single_body()->body_id << ") and " << i->second << " (" << i->second->get_single_body()->body_id << ")" << std::endl;
 
     // if the pair is disabled, continue looping
-    if (this->disabled_pairs.find(i->first) != this->disabled_pairs.end())
+    if (this->disabled_pairs.find(*i) != this->disabled_pairs.end())
       continue;
 
     // get the rigid bodies corresponding to the geometries
-    RigidBodyPtr rb1 = dynamic_pointer_cast<RigidBody>(i->first.first->get_single_body());
-    RigidBodyPtr rb2 = dynamic_pointer_cast<RigidBody>(i->first.second->get_single_body());
+    RigidBodyPtr rb1 = dynamic_pointer_cast<RigidBody>(i->first->get_single_body());
+    RigidBodyPtr rb2 = dynamic_pointer_cast<RigidBody>(i->second->get_single_body());
 
     // don't check pairs from the same rigid body
     if (rb1 == rb2)
@@ -866,13 +1518,119 @@ void CCD::broad_phase(double dt, const vector<ControlledBodyPtr>& bodies, vector
       continue;
 
     // if we're here, we have a candidate for the narrow phase
-    to_check.push_back(make_pair(i->first.first, i->first.second));
+    to_check.push_back(make_pair(i->first, i->second));
     FILE_LOG(LOG_COLDET) << "  ... checking pair" << std::endl;
   }
 
+  // test every dynamic geometry against the baked static hierarchy with a
+  // single traversal (static geometries do not pass through the sweep)
+  if (bake_static_geometry && _static_root >= 0)
+  {
+    const unsigned THREE_D = 3;
+    for (unsigned i=0; i< rbs.size(); i++)
+      BOOST_FOREACH(CollisionGeometryPtr cg, rbs[i]->geometries)
+      {
+        // get the geometry's swept world-space bounds
+        BVPtr swept_bv = get_swept_BV(cg, _bounding_spheres[cg], dt);
+        assert(swept_bv->get_relative_pose() == GLOBAL);
+        Point3d lo = swept_bv->get_lower_bounds();
+        Point3d hi = swept_bv->get_upper_bounds();
+        double qlo[THREE_D], qhi[THREE_D];
+        for (unsigned k=0; k< THREE_D; k++)
+        {
+          qlo[k] = lo[k];
+          qhi[k] = hi[k];
+        }
+        query_static_tree(_static_root, qlo, qhi, cg, to_check);
+      }
+  }
+
   FILE_LOG(LOG_COLDET) << "CCD::broad_phase() exited" << std::endl;
 }
 
+/// Sweeps one sorted axis of bounds, accumulating all pairs of geometries whose bounds overlap along the axis
+/**
+ * The axis is partitioned into contiguous segments that are swept in parallel
+ * (when OpenMP is available): a cheap serial prefix pass records the set of
+ * geometries active at each segment boundary, after which each segment is
+ * swept independently into a per-segment buffer; the buffers are concatenated
+ * at the end. Pair generation- the expensive part of sweep-and-prune- is
+ * thereby distributed over the available threads.
+ */
+void CCD::sweep_axis(const vector<pair<double, BoundsStruct> >& bounds, vector<sorted_pair<CollisionGeometryPtr> >& overlaps)
+{
+  // clear the vector of overlaps
+  overlaps.clear();
+
+  // determine the number of segments to sweep concurrently; small scenes are
+  // swept serially to avoid parallelization overhead
+  unsigned nsegs = 1;
+  #ifdef _OPENMP
+  const unsigned MIN_BOUNDS_PER_SEGMENT = 64;
+  nsegs = std::max((unsigned) 1, std::min((unsigned) omp_get_max_threads(), (unsigned) (bounds.size()/MIN_BOUNDS_PER_SEGMENT)));
+  #endif
+
+  // compute the segment boundaries (an even partition of the bounds vector)
+  vector<unsigned> seg_start(nsegs), seg_end(nsegs);
+  for (unsigned s=0; s< nsegs; s++)
+  {
+    seg_start[s] = (unsigned) (bounds.size() * s / nsegs);
+    seg_end[s] = (unsigned) (bounds.size() * (s+1) / nsegs);
+  }
+
+  // serially record the set of active geometries at the start of each segment
+  vector<vector<CollisionGeometryPtr> > seeds(nsegs);
+  set<CollisionGeometryPtr> active_bounds;
+  for (unsigned i=0, seg=0; i< bounds.size(); i++)
+  {
+    while (seg < nsegs && i == seg_start[seg])
+    {
+      seeds[seg].assign(active_bounds.begin(), active_bounds.end());
+      seg++;
+    }
+    if (bounds[i].second.end)
+      active_bounds.erase(bounds[i].second.geom);
+    else
+      active_bounds.insert(bounds[i].second.geom);
+  }
+
+  // sweep each segment into its own buffer
+  vector<vector<sorted_pair<CollisionGeometryPtr> > > buffers(nsegs);
+  #ifdef _OPENMP
+  #pragma omp parallel for
+  #endif
+  for (int s=0; s< (int) nsegs; s++)
+  {
+    // seed the active set with the geometries straddling the segment start
+    set<CollisionGeometryPtr> active(seeds[s].begin(), seeds[s].end());
+    vector<sorted_pair<CollisionGeometryPtr> >& buffer = buffers[s];
+
+    // scan through the bounds in this segment
+    for (unsigned i=seg_start[s]; i< seg_end[s]; i++)
+    {
+      // eliminate from the active bounds if at the end of a bound
+      if (bounds[i].second.end)
+      {
+        assert(active.find(bounds[i].second.geom) != active.end());
+        active.erase(bounds[i].second.geom);
+      }
+      else
+      {
+        // at the start of a bound
+        BOOST_FOREACH(CollisionGeometryPtr cg, active)
+          buffer.push_back(make_sorted_pair(cg, bounds[i].second.geom));
+
+        // add the geometry to the active set
+        active.insert(bounds[i].second.geom);
+      }
+    }
+  }
+
+  // concatenate the per-segment buffers
+  for (unsigned s=0; s< nsegs; s++)
+    overlaps.insert(overlaps.end(), buffers[s].begin(), buffers[s].end());
+}
+
 /// Gets the swept BV, creating it if necessary
 BVPtr CCD::get_swept_BV(CollisionGeometryPtr cg, BVPtr bv, double dt)
 {
@@ -910,10 +1668,13 @@ void CCD::sort_AABBs(const vector<RigidBodyPtr>& rigid_bodies, double dt)
     _z_bounds = _x_bounds;
   }
 
+  // recompute the swept bounds for every geometry in one packed pass
+  update_packed_bounds(dt);
+
   // update bounds vectors
-  update_bounds_vector(_x_bounds, eXAxis, dt, true);
-  update_bounds_vector(_y_bounds, eYAxis, dt, false);
-  update_bounds_vector(_z_bounds, eZAxis, dt, false);
+  update_bounds_vector(_x_bounds, eXAxis);
+  update_bounds_vector(_y_bounds, eYAxis);
+  update_bounds_vector(_z_bounds, eZAxis);
 
   // if geometry was added or removed, do standard sorts of vectors
   if (_rebuild_bounds_vecs)
@@ -934,65 +1695,129 @@ void CCD::sort_AABBs(const vector<RigidBodyPtr>& rigid_bodies, double dt)
   }
 }
 
-void CCD::update_bounds_vector(vector<pair<double, BoundsStruct> >& bounds, AxisType axis, double dt, bool recreate_bvs)
+/// Recomputes the world-space swept bounds of every geometry into a packed array
+/**
+ * Each geometry's swept bounding volume and its lower/upper bounds are
+ * computed exactly once per step and stored contiguously (six doubles per
+ * geometry), so the three per-axis bounds updates become straight-line
+ * sweeps over packed storage with no map lookups or virtual calls.
+ */
+void CCD::update_packed_bounds(double dt)
 {
-  const unsigned X = 0, Y = 1, Z = 2;
+  const unsigned X = 0, Y = 1, Z = 2, N_BOUNDS = 6;
 
-  FILE_LOG(LOG_COLDET) << " -- update_bounds_vector() entered (axis=" << axis << ")" << std::endl;
+  // size the packed array; slots persist across steps and removed
+  // geometries leave unused slots until the next rebuild
+  _packed_bounds.resize(_n_packed_bounds*N_BOUNDS);
 
-  // iterate over bounds vector
-  for (unsigned i=0; i< bounds.size(); i++)
+  // fill the packed array, visiting each geometry once (via its lower entry)
+  for (unsigned i=0; i< _x_bounds.size(); i++)
   {
-    // get the bounding volume and collision geometry
-    BVPtr bv = bounds[i].second.bv;
-    CollisionGeometryPtr geom = bounds[i].second.geom;
+    if (_x_bounds[i].second.end)
+      continue;
 
-    // recreate the BV if necessary
-    if (recreate_bvs)
-      _swept_BVs.erase(geom);
+    const BoundsStruct& bs = _x_bounds[i].second;
 
-    // get the swept bounding volume (should be defined in global frame)
-    BVPtr swept_bv = get_swept_BV(geom, bv, dt);
+    // a sleeping or disabled body cannot have moved unless its pose was set
+    // explicitly, which marks the geometry stale; skip its (already packed)
+    // bounds entirely
+    shared_ptr<RigidBody> rb = dynamic_pointer_cast<RigidBody>(bs.geom->get_single_body());
+    if (rb && !bs.geom->pose_stale() && (!rb->is_enabled() || rb->is_asleep()))
+      continue;
+
+    // compute the swept bounding volume (defined in the global frame)
+    BVPtr swept_bv = get_swept_BV(bs.geom, bs.bv, dt);
     assert(swept_bv->get_relative_pose() == GLOBAL);
+    FILE_LOG(LOG_COLDET) << "  updating collision geometry: " << bs.geom << "  rigid body: " << bs.geom->get_single_body()->body_id << std::endl;
+
+    // pack its bounds
+    Point3d lo = swept_bv->get_lower_bounds();
+    Point3d hi = swept_bv->get_upper_bounds();
+    double* b = &_packed_bounds[bs.idx*N_BOUNDS];
+    b[0] = lo[X]; b[1] = hi[X];
+    b[2] = lo[Y]; b[3] = hi[Y];
+    b[4] = lo[Z]; b[5] = hi[Z];
+
+    // the packed slot now reflects the current pose
+    bs.geom->clear_pose_stale();
+  }
+}
 
-    // get the bound for the bounding volume
-    Point3d bound = (bounds[i].second.end) ? swept_bv->get_upper_bounds() : swept_bv->get_lower_bounds();
-    FILE_LOG(LOG_COLDET) << "  updating collision geometry: " << geom << "  rigid body: " << geom->get_single_body()->body_id << std::endl;
+void CCD::update_bounds_vector(vector<pair<double, BoundsStruct> >& bounds, AxisType axis)
+{
+  const unsigned N_BOUNDS = 6;
 
-    // update the bounds for the given axis
-    switch (axis)
-    {
-      case eXAxis:
-        bounds[i].first = bound[X];
-        break;
+  FILE_LOG(LOG_COLDET) << " -- update_bounds_vector() entered (axis=" << axis << ")" << std::endl;
 
-      case eYAxis:
-        bounds[i].first = bound[Y];
-        break;
+  // assign bounds from the packed array filled by update_packed_bounds()
+  const unsigned axis_offset = ((unsigned) axis)*2;
+  for (unsigned i=0; i< bounds.size(); i++)
+  {
+    const BoundsStruct& bs = bounds[i].second;
+    bounds[i].first = _packed_bounds[bs.idx*N_BOUNDS + axis_offset + (bs.end ? 1 : 0)];
+  }
 
-      case eZAxis:
-        bounds[i].first = bound[Z];
-        break;
+  FILE_LOG(LOG_COLDET) << " -- update_bounds_vector() exited" << std::endl;
+}
 
-      default:
-        assert(false);
-    }
+/// Splices bounds entries for a newly added geometry into the persistent bounds vectors
+/**
+ * The entries are appended with placeholder values; update_bounds_vector()
+ * assigns the true bounds and the insertion sort in sort_AABBs() repairs the
+ * ordering in O(n) per out-of-place entry, avoiding a full O(n lg n) re-sort
+ * of the scene when a single body is spawned.
+ */
+void CCD::add_bounds(CollisionGeometryPtr geom, BVPtr bv)
+{
+  const double INF = std::numeric_limits<double>::max();
 
-    if (bounds[i].second.end)
-      FILE_LOG(LOG_COLDET) << "    upper bound: " << bounds[i].first << std::endl;
-    if (!bounds[i].second.end)
-      FILE_LOG(LOG_COLDET) << "    lower bound: " << bounds[i].first << std::endl;
-  }
+  // setup the bounds structure; the new geometry takes a fresh slot in the
+  // packed swept-bounds array
+  BoundsStruct bs;
+  bs.end = false;
+  bs.geom = geom;
+  bs.bv = bv;
+  bs.idx = _n_packed_bounds++;
+  geom->mark_pose_stale();
+
+  // append the lower bound to each axis
+  _x_bounds.push_back(make_pair(INF, bs));
+  _y_bounds.push_back(make_pair(INF, bs));
+  _z_bounds.push_back(make_pair(INF, bs));
+
+  // modify the bounds structure to indicate the end bound and append it
+  bs.end = true;
+  _x_bounds.push_back(make_pair(INF, bs));
+  _y_bounds.push_back(make_pair(INF, bs));
+  _z_bounds.push_back(make_pair(INF, bs));
+}
 
-  FILE_LOG(LOG_COLDET) << " -- update_bounds_vector() exited" << std::endl;
+/// Removes all bounds entries for a geometry from the persistent bounds vectors
+void CCD::remove_bounds(CollisionGeometryPtr geom)
+{
+  const unsigned N_AXES = 3;
+
+  // erasure preserves the sorted order of the remaining entries
+  for (unsigned k=0; k< N_AXES; k++)
+  {
+    vector<pair<double, BoundsStruct> >& bounds = (k == 0) ? _x_bounds : ((k == 1) ? _y_bounds : _z_bounds);
+    for (unsigned i=0; i< bounds.size(); )
+    {
+      if (bounds[i].second.geom == geom)
+        bounds.erase(bounds.begin()+i);
+      else
+        i++;
+    }
+  }
 }
 
 void CCD::build_bv_vector(const vector<RigidBodyPtr>& rigid_bodies, vector<pair<double, BoundsStruct> >& bounds)
 {
   const double INF = std::numeric_limits<double>::max();
 
-  // clear the vector
+  // clear the vector and restart the packed swept-bounds indexing
   bounds.clear();
+  unsigned idx = 0;
 
   // iterate over all collision geometries
   for (unsigned j=0; j< rigid_bodies.size(); j++)
@@ -1009,6 +1834,8 @@ void CCD::build_bv_vector(const vector<RigidBodyPtr>& rigid_bodies, vector<pair<
       bs.end = false;
       bs.geom = i;
       bs.bv = bv;
+      bs.idx = idx++;
+      bs.geom->mark_pose_stale();
 
       // add the lower bound
       bounds.push_back(make_pair(-INF, bs));
@@ -1017,6 +1844,9 @@ void CCD::build_bv_vector(const vector<RigidBodyPtr>& rigid_bodies, vector<pair<
       bs.end = true;
       bounds.push_back(make_pair(INF, bs));
     }
+
+  // record the number of packed swept-bounds slots
+  _n_packed_bounds = idx;
 }
 
 /// Constructs a bounding sphere for a given primitive type
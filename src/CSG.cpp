@@ -32,6 +32,8 @@ using boost::dynamic_pointer_cast;
 CSG::CSG()
 {
   _op = eUnion;
+  _bounds_valid = false;
+  _memo_cell_size = 0.0;
   calc_mass_properties();
 }
 
@@ -39,6 +41,8 @@ CSG::CSG()
 CSG::CSG(const Pose3d& T) : Primitive(T)
 {
   _op = eUnion;
+  _bounds_valid = false;
+  _memo_cell_size = 0.0;
   calc_mass_properties();
 }
 
@@ -52,6 +56,10 @@ void CSG::set_operand1(PrimitivePtr p)
   _smesh = pair<shared_ptr<IndexedTriArray>, list<unsigned> >();
   _invalidated = true;
 
+  // cached operand bounds and the query memo are no longer valid
+  _bounds_valid = false;
+  _dominant_cells.clear();
+
   // need to recalculate mass properties
   calc_mass_properties();
 }
@@ -66,6 +74,10 @@ void CSG::set_operand2(PrimitivePtr p)
   _smesh = pair<shared_ptr<IndexedTriArray>, list<unsigned> >();
   _invalidated = true;
 
+  // cached operand bounds and the query memo are no longer valid
+  _bounds_valid = false;
+  _dominant_cells.clear();
+
   // need to recalculate mass properties
   calc_mass_properties();
 }
@@ -80,6 +92,10 @@ void CSG::set_operator(BooleanOperation op)
   _smesh = pair<shared_ptr<IndexedTriArray>, list<unsigned> >();
   _invalidated = true;
 
+  // cached operand bounds and the query memo are no longer valid
+  _bounds_valid = false;
+  _dominant_cells.clear();
+
   // need to recalculate mass properties
   calc_mass_properties();
 }
@@ -97,7 +113,156 @@ double CSG::calc_signed_dist(shared_ptr<const Primitive> primitive, shared_ptr<c
 {
   // TODO: implement this
   assert(false);
-  return 0.0; 
+  return 0.0;
+}
+
+/// Gets the bounding radius of the CSG
+double CSG::get_bounding_radius() const
+{
+  // degenerate bound if either operand is not set
+  if (!_op1 || !_op2)
+    return 0.0;
+
+  // each operand's bound must account for the offset of the operand's pose
+  double r1 = _op1->get_pose()->x.norm() + _op1->get_bounding_radius();
+  double r2 = _op2->get_pose()->x.norm() + _op2->get_bounding_radius();
+
+  switch (_op)
+  {
+    case eUnion:         return std::max(r1, r2);
+    case eIntersection:  return std::min(r1, r2);
+    case eDifference:    return r1;
+    default:             assert(false); return 0.0;
+  }
+}
+
+/// Updates the cached operand bounding spheres used for query pruning
+void CSG::update_bounds() const
+{
+  // get the operand bounding spheres in the CSG frame
+  _bcenter1 = _op1->get_pose()->x;
+  _brad1 = _op1->get_bounding_radius();
+  _bcenter2 = _op2->get_pose()->x;
+  _brad2 = _op2->get_bounding_radius();
+
+  // size the memoization cells as a fraction of the overall bound
+  _memo_cell_size = std::max(get_bounding_radius(), NEAR_ZERO) * 0.03125;
+
+  // memoized dominant operands are stale
+  _dominant_cells.clear();
+
+  // bounds are now current
+  _bounds_valid = true;
+}
+
+/// Computes the key of the spatial memoization cell containing a point
+long long CSG::memo_cell_key(const Point3d& p) const
+{
+  const unsigned BITS = 21;
+  const long long MASK = ((long long) 1 << BITS) - 1;
+
+  // quantize the point to its cell; indices are wrapped into the key, so a
+  // collision (harmlessly) maps far apart cells to the same memo entry
+  long long ix = (long long) std::floor(p[0]/_memo_cell_size);
+  long long iy = (long long) std::floor(p[1]/_memo_cell_size);
+  long long iz = (long long) std::floor(p[2]/_memo_cell_size);
+  return (ix & MASK) | ((iy & MASK) << BITS) | ((iz & MASK) << (BITS+BITS));
+}
+
+/// Computes the signed distance from a point to the CSG
+/**
+ * Rather than always evaluating both operands, the query prunes with
+ * precomputed operand bounding spheres: the distance from the point to an
+ * operand's bounding sphere is a lower bound on the operand's signed
+ * distance, so a union can skip its farther operand and a difference can
+ * skip the subtracted operand whenever the bound proves that the operand
+ * cannot affect the result.  Operands may themselves be CSG primitives, so
+ * the per-node bounds act as a tree over all leaf primitives and a query
+ * descends only into subtrees whose bounds are near the point.  The operand
+ * that determined the last result is additionally memoized per spatial cell
+ * and is evaluated first on subsequent queries from the same cell, which
+ * maximizes the chance that the pruning test eliminates the other operand.
+ */
+double CSG::calc_signed_dist(const Point3d& p) const
+{
+  if (!_op1 || !_op2)
+    throw std::runtime_error("One or more CSG operands are missing!");
+
+  // update the cached operand bounds, if necessary
+  if (!_bounds_valid)
+    update_bounds();
+
+  // compute lower bounds on the operand signed distances from their
+  // bounding spheres
+  double lb1 = (p - Point3d(_bcenter1, p.pose)).norm() - _brad1;
+  double lb2 = (p - Point3d(_bcenter2, p.pose)).norm() - _brad2;
+
+  // look up the operand that dominated the last query from this cell
+  long long key = memo_cell_key(p);
+  std::map<long long, unsigned char>::const_iterator mi = _dominant_cells.find(key);
+  unsigned char dominant = (mi == _dominant_cells.end()) ? 0 : mi->second;
+
+  double d;
+  unsigned char winner;
+  if (_op == eUnion)
+  {
+    // evaluate the likely dominant operand first (the memoized winner, if
+    // known; otherwise the operand with the nearer bound)
+    bool one_first = (dominant == 1 || (dominant == 0 && lb1 <= lb2));
+    double dfirst = (one_first) ? _op1->calc_signed_dist(p) : _op2->calc_signed_dist(p);
+    double lbsecond = (one_first) ? lb2 : lb1;
+    if (dfirst <= lbsecond)
+    {
+      // the second operand provably cannot be nearer; skip it
+      d = dfirst;
+      winner = (one_first) ? 1 : 2;
+    }
+    else
+    {
+      double dsecond = (one_first) ? _op2->calc_signed_dist(p) : _op1->calc_signed_dist(p);
+      d = std::min(dfirst, dsecond);
+      if (dfirst <= dsecond)
+        winner = (one_first) ? 1 : 2;
+      else
+        winner = (one_first) ? 2 : 1;
+    }
+  }
+  else if (_op == eIntersection)
+  {
+    // the bounding spheres only yield lower bounds and the intersection
+    // takes the larger distance, so both operands must be evaluated
+    double d1 = _op1->calc_signed_dist(p);
+    double d2 = _op2->calc_signed_dist(p);
+    d = std::max(d1, d2);
+    winner = (d1 >= d2) ? 1 : 2;
+  }
+  else
+  {
+    assert(_op == eDifference);
+
+    // the first operand defines the part and is always evaluated
+    double d1 = _op1->calc_signed_dist(p);
+    if (d1 >= -lb2)
+    {
+      // the subtracted operand provably cannot reach the point; skip it
+      d = d1;
+      winner = 1;
+    }
+    else
+    {
+      double d2 = _op2->calc_signed_dist(p);
+      d = std::max(d1, -d2);
+      winner = (d1 >= -d2) ? 1 : 2;
+    }
+  }
+
+  // memoize the dominant operand for this cell, bounding the memo size
+  const unsigned MAX_MEMO_CELLS = 1000000;
+  if (_dominant_cells.size() >= MAX_MEMO_CELLS)
+    _dominant_cells.clear();
+  _dominant_cells[key] = winner;
+
+  return d;
 }
 
 /*
@@ -160,13 +325,17 @@ void CSG::set_pose(const Pose3d& p)
   // call the primitive transform
   Primitive::set_pose(p);
 
-  // invalidate vertices and the mesh 
+  // invalidate vertices and the mesh
   _vertices.clear();
   _mesh.reset();
 
   // invalidate this primitive
   _invalidated = true;
 
+  // cached operand bounds and the query memo are no longer valid
+  _bounds_valid = false;
+  _dominant_cells.clear();
+
   // recalculate the mass properties
   calc_mass_properties();
 }
@@ -0,0 +1,653 @@
+/****************************************************************************
+ * Copyright 2005 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <iostream>
+#include <algorithm>
+#ifdef USE_OSG
+#include <osg/Shape>
+#include <osg/ShapeDrawable>
+#include <osg/Geode>
+#endif
+#include <Moby/Constants.h>
+#include <Moby/CompGeom.h>
+#include <Moby/XMLTree.h>
+#include <Moby/SpherePrimitive.h>
+#include <Moby/PlanePrimitive.h>
+#include <Moby/BoxPrimitive.h>
+#include <Moby/TorusPrimitive.h>
+#include <Moby/SSL.h>
+#include <Moby/CollisionGeometry.h>
+#include <Moby/HeightmapPrimitive.h>
+#include <Moby/TriangleMeshPrimitive.h>
+#include <Moby/GJK.h>
+#include <Moby/CapsulePrimitive.h>
+
+using namespace Ravelin;
+using namespace Moby;
+using boost::shared_ptr;
+using boost::const_pointer_cast;
+using boost::dynamic_pointer_cast;
+using std::map;
+using std::list;
+using std::vector;
+using std::pair;
+using std::endl;
+
+/// Constructs a capsule along the y-axis with radius 1, height 1, and 10 circle points
+CapsulePrimitive::CapsulePrimitive()
+{
+  _radius = 1.0;
+  _height = 1.0;
+  _npoints = 10;
+  calc_mass_properties();
+}
+
+/// Constructs a capsule along the y-axis with specified radius and height, centered at the origin
+CapsulePrimitive::CapsulePrimitive(double radius, double height)
+{
+  if (height < (double) 0.0)
+    throw std::runtime_error("Attempting to set negative height in CapsulePrimitive (constructor)");
+  if (radius < (double) 0.0)
+    throw std::runtime_error("Attempting to set negative radius in CapsulePrimitive (constructor)");
+
+  _radius = radius;
+  _height = height;
+  _npoints = 10;
+  calc_mass_properties();
+}
+
+/// Constructs a capsule along the y-axis with specified radius, height, and pose
+CapsulePrimitive::CapsulePrimitive(double radius, double height, const Pose3d& T) : Primitive(T)
+{
+  if (height < (double) 0.0)
+    throw std::runtime_error("Attempting to set negative height in CapsulePrimitive (constructor)");
+  if (radius < (double) 0.0)
+    throw std::runtime_error("Attempting to set negative radius in CapsulePrimitive (constructor)");
+
+  _radius = radius;
+  _height = height;
+  _npoints = 10;
+  calc_mass_properties();
+}
+
+/// Finds the signed distance between the capsule and another primitive
+double CapsulePrimitive::calc_signed_dist(shared_ptr<const Primitive> p, Point3d& pthis, Point3d& pp) const
+{
+  // first look for plane primitive (closed form)
+  shared_ptr<const PlanePrimitive> planep = dynamic_pointer_cast<const PlanePrimitive>(p);
+  if (planep)
+    return calc_signed_dist(planep, pthis, pp);
+
+  // look for heightmap
+  shared_ptr<const HeightmapPrimitive> hmp = dynamic_pointer_cast<const HeightmapPrimitive>(p);
+  if (hmp)
+    return hmp->calc_signed_dist(dynamic_pointer_cast<const Primitive>(shared_from_this()), pp, pthis);
+
+  // look for torus (the torus is non-convex, so GJK does not apply)
+  shared_ptr<const TorusPrimitive> torusp = dynamic_pointer_cast<const TorusPrimitive>(p);
+  if (torusp)
+    return torusp->calc_signed_dist(dynamic_pointer_cast<const Primitive>(shared_from_this()), pp, pthis);
+
+  // look for capsule/capsule (closed form)
+  shared_ptr<const CapsulePrimitive> capp = dynamic_pointer_cast<const CapsulePrimitive>(p);
+  if (capp)
+    return calc_signed_dist(capp, pthis, pp);
+
+  // look for capsule/sphere (closed form)
+  shared_ptr<const SpherePrimitive> sphp = dynamic_pointer_cast<const SpherePrimitive>(p);
+  if (sphp)
+    return calc_signed_dist(sphp, pthis, pp);
+
+  // look for capsule/box (closed form)
+  shared_ptr<const BoxPrimitive> boxp = dynamic_pointer_cast<const BoxPrimitive>(p);
+  if (boxp)
+    return calc_signed_dist(boxp, pthis, pp);
+
+  // if the primitive is convex, can use GJK
+  if (p->is_convex())
+  {
+    shared_ptr<const Pose3d> Pcap = pthis.pose;
+    shared_ptr<const Pose3d> Pgeneric = pp.pose;
+    shared_ptr<const Primitive> cthis = dynamic_pointer_cast<const Primitive>(shared_from_this());
+    return GJK::do_gjk(cthis, p, Pcap, Pgeneric, pthis, pp);
+  }
+
+  // try capsule/(non-convex) trimesh
+  shared_ptr<const TriangleMeshPrimitive> trip = dynamic_pointer_cast<const TriangleMeshPrimitive>(p);
+  if (trip)
+    return trip->calc_signed_dist(dynamic_pointer_cast<const Primitive>(shared_from_this()), pp, pthis);
+
+  assert(false);
+  return 0.0;
+}
+
+/// Gets the signed distance between this capsule and another capsule
+/**
+ * The capsule surfaces are sphere sweeps of the axis segments, so the
+ * distance is the distance between the segments less the radii -- a single
+ * closed-form evaluation with no special cases for the caps.
+ */
+double CapsulePrimitive::calc_signed_dist(shared_ptr<const CapsulePrimitive> c, Point3d& pthis, Point3d& pcap) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  // get the transform from c's pose to this capsule's pose
+  Transform3d T = Pose3d::calc_relative_pose(pcap.pose, pthis.pose);
+
+  // this capsule's axis segment starts at its lower endpoint center; get
+  // c's axis direction and lower endpoint center in this frame
+  const double HH1 = _height * 0.5;
+  Origin3d u = T.q * Origin3d(0.0, 1.0, 0.0);
+  Origin3d P2 = T.q * Origin3d(0.0, -c->_height*0.5, 0.0) + T.x;
+  Origin3d P1(0.0, -HH1, 0.0);
+
+  // get the closest points between the axis segments (unit directions,
+  // parameters clamped to [0, height])
+  double b = u[Y];
+  double f = u[X]*(P1[X]-P2[X]) + u[Y]*(P1[Y]-P2[Y]) + u[Z]*(P1[Z]-P2[Z]);
+  double cc = P1[Y] - P2[Y];
+  double denom = 1.0 - b*b;
+  double s = 0.0;
+  if (denom > NEAR_ZERO)
+  {
+    s = (b*f - cc)/denom;
+    if (s < 0.0) s = 0.0; else if (s > _height) s = _height;
+  }
+  double t = b*s + f;
+  if (t < 0.0)
+  {
+    t = 0.0;
+    s = -cc;
+    if (s < 0.0) s = 0.0; else if (s > _height) s = _height;
+  }
+  else if (t > c->_height)
+  {
+    t = c->_height;
+    s = b*t - cc;
+    if (s < 0.0) s = 0.0; else if (s > _height) s = _height;
+  }
+
+  // get the separating direction between the segments
+  Origin3d a1 = P1;
+  a1[Y] += s;
+  Origin3d a2 = P2 + u*t;
+  Origin3d dvec = a1 - a2;
+  double dn = dvec.norm();
+  Origin3d nhat = (dn > NEAR_ZERO) ? dvec/dn : Origin3d(1.0, 0.0, 0.0);
+
+  // setup the closest points on the surfaces
+  pthis = Point3d(a1 - nhat*_radius, pthis.pose);
+  pcap = T.inverse_transform_point(Point3d(a2 + nhat*c->_radius, pthis.pose));
+
+  return dn - _radius - c->_radius;
+}
+
+/// Gets the signed distance between this capsule and a sphere
+double CapsulePrimitive::calc_signed_dist(shared_ptr<const SpherePrimitive> s, Point3d& pthis, Point3d& psph) const
+{
+  const unsigned Y = 1;
+
+  // get the transform from the sphere pose to this capsule's pose
+  Transform3d T = Pose3d::calc_relative_pose(psph.pose, pthis.pose);
+
+  // get the sphere center in this frame and the closest axis point
+  const double HH = _height * 0.5;
+  Origin3d c0 = T.x;
+  Origin3d a(0.0, c0[Y], 0.0);
+  if (a[Y] < -HH) a[Y] = -HH; else if (a[Y] > HH) a[Y] = HH;
+
+  // get the separating direction
+  Origin3d dvec = c0 - a;
+  double dn = dvec.norm();
+  Origin3d nhat = (dn > NEAR_ZERO) ? dvec/dn : Origin3d(1.0, 0.0, 0.0);
+
+  // setup the closest points on the surfaces
+  pthis = Point3d(a + nhat*_radius, pthis.pose);
+  psph = T.inverse_transform_point(Point3d(c0 - nhat*s->get_radius(), pthis.pose));
+
+  return dn - _radius - s->get_radius();
+}
+
+/// Gets the signed distance between this capsule and a plane
+/**
+ * The capsule's extremal point toward the plane is an axis endpoint center
+ * dropped by the radius, so the distance is a single closed-form evaluation.
+ */
+double CapsulePrimitive::calc_signed_dist(shared_ptr<const PlanePrimitive> p, Point3d& pthis, Point3d& pplane) const
+{
+  const unsigned Y = 1;
+
+  // get the transform from the capsule pose to the plane pose
+  Transform3d T = Pose3d::calc_relative_pose(pthis.pose, pplane.pose);
+
+  // get the lower axis endpoint center in the plane's frame
+  const double HH = _height * 0.5;
+  Origin3d e1 = T.q * Origin3d(0.0, HH, 0.0) + T.x;
+  Origin3d e2 = T.q * Origin3d(0.0, -HH, 0.0) + T.x;
+  Origin3d lowest = (e1[Y] < e2[Y]) ? e1 : e2;
+  lowest[Y] -= _radius;
+
+  // setup the closest points and return the height of the lowest point
+  Point3d lowest_plane(lowest, pplane.pose);
+  pthis = T.inverse_transform_point(lowest_plane);
+  pplane = lowest_plane;
+  pplane[Y] = 0.0;
+  return lowest[Y];
+}
+
+/// Gets the signed distance between this capsule and a box
+/**
+ * Minimizes the box distance over the axis segment: the squared distance
+ * from a point on the segment to the box is piecewise quadratic in the
+ * segment parameter, with breakpoints where a coordinate crosses a box
+ * face, so each piece is minimized in closed form.
+ */
+double CapsulePrimitive::calc_signed_dist(shared_ptr<const BoxPrimitive> b, Point3d& pthis, Point3d& pbox) const
+{
+  const unsigned THREE_D = 3;
+
+  // get the transform from the capsule pose to the box pose
+  Transform3d T = Pose3d::calc_relative_pose(pthis.pose, pbox.pose);
+
+  // get the axis segment in the box frame
+  const double HH = _height * 0.5;
+  Origin3d a = T.q * Origin3d(0.0, -HH, 0.0) + T.x;
+  Origin3d u = T.q * Origin3d(0.0, 1.0, 0.0);
+
+  // get the box half-extents
+  Origin3d e(b->get_x_len()*0.5, b->get_y_len()*0.5, b->get_z_len()*0.5);
+
+  // collect the segment parameters where a coordinate crosses a box face
+  double knots[8];
+  unsigned nknots = 0;
+  knots[nknots++] = 0.0;
+  knots[nknots++] = _height;
+  for (unsigned i=0; i< THREE_D; i++)
+  {
+    if (std::fabs(u[i]) < NEAR_ZERO)
+      continue;
+    double t1 = (e[i] - a[i])/u[i];
+    double t2 = (-e[i] - a[i])/u[i];
+    if (t1 > 0.0 && t1 < _height) knots[nknots++] = t1;
+    if (t2 > 0.0 && t2 < _height) knots[nknots++] = t2;
+  }
+  std::sort(knots, knots+nknots);
+
+  // minimize the squared box distance over each piece
+  double best_t = 0.0;
+  double best_f = std::numeric_limits<double>::max();
+  for (unsigned i=0; i< nknots-1; i++)
+  {
+    // determine the active coordinates from the piece midpoint
+    const double TMID = (knots[i] + knots[i+1]) * 0.5;
+    double A = 0.0, B = 0.0;
+    for (unsigned j=0; j< THREE_D; j++)
+    {
+      double pj = a[j] + TMID*u[j];
+      double cj;
+      if (pj > e[j])
+        cj = a[j] - e[j];
+      else if (pj < -e[j])
+        cj = a[j] + e[j];
+      else
+        continue;
+      A += u[j]*u[j];
+      B += 2.0*u[j]*cj;
+    }
+
+    // minimize the quadratic A*t^2 + B*t + C over the piece
+    double t = (A > NEAR_ZERO) ? -B/(2.0*A) : knots[i];
+    if (t < knots[i]) t = knots[i];
+    else if (t > knots[i+1]) t = knots[i+1];
+
+    // evaluate the true squared box distance at the candidate
+    double f = 0.0;
+    for (unsigned j=0; j< THREE_D; j++)
+    {
+      double excess = std::fabs(a[j] + t*u[j]) - e[j];
+      if (excess > 0.0)
+        f += excess*excess;
+    }
+    if (f < best_f)
+    {
+      best_f = f;
+      best_t = t;
+    }
+  }
+
+  // get the closest segment point and its projection onto the box
+  Origin3d p_seg = a + u*best_t;
+  Origin3d p_clamp = p_seg;
+  for (unsigned j=0; j< THREE_D; j++)
+  {
+    if (p_clamp[j] > e[j]) p_clamp[j] = e[j];
+    else if (p_clamp[j] < -e[j]) p_clamp[j] = -e[j];
+  }
+  Origin3d dvec = p_seg - p_clamp;
+  double dc = dvec.norm();
+
+  if (dc > NEAR_ZERO)
+  {
+    // segment is outside the box: closest points along the separating axis
+    Origin3d nhat = dvec/dc;
+    pbox = Point3d(p_clamp, pbox.pose);
+    pthis = T.inverse_transform_point(Point3d(p_seg - nhat*_radius, pbox.pose));
+    return dc - _radius;
+  }
+
+  // segment point is on/in the box; find the face of least clearance
+  unsigned jmin = 0;
+  double clearance = e[0] - std::fabs(p_seg[0]);
+  for (unsigned j=1; j< THREE_D; j++)
+  {
+    double cl = e[j] - std::fabs(p_seg[j]);
+    if (cl < clearance)
+    {
+      clearance = cl;
+      jmin = j;
+    }
+  }
+
+  // setup the witness points on that face and on the capsule surface
+  Origin3d nhat(0.0, 0.0, 0.0);
+  nhat[jmin] = (p_seg[jmin] >= 0.0) ? 1.0 : -1.0;
+  Origin3d p_face = p_seg;
+  p_face[jmin] = nhat[jmin]*e[jmin];
+  pbox = Point3d(p_face, pbox.pose);
+  pthis = T.inverse_transform_point(Point3d(p_seg - nhat*_radius, pbox.pose));
+  return -(clearance + _radius);
+}
+
+/// Gets the supporting point in a particular direction
+Point3d CapsulePrimitive::get_supporting_point(const Vector3d& d) const
+{
+  assert(_poses.find(const_pointer_cast<Pose3d>(d.pose)) != _poses.end());
+
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  // the support is the endpoint center selected by the direction, pushed
+  // out by the radius
+  Vector3d dn = Vector3d::normalize(d);
+  const double YC = (d[Y] > 0.0) ? _height*0.5 : -_height*0.5;
+  return Point3d(dn[X]*_radius, YC + dn[Y]*_radius, dn[Z]*_radius, d.pose);
+}
+
+/// Gets the distance from a point to the capsule's axis segment and the closest point on the segment
+double CapsulePrimitive::calc_closest_point(const Point3d& p, Point3d& closest) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  // clamp the point's axial coordinate to the segment
+  const double HH = _height * 0.5;
+  double s = p[Y];
+  if (s < -HH) s = -HH; else if (s > HH) s = HH;
+
+  // setup the closest point on the segment
+  closest = Point3d(0.0, s, 0.0, p.pose);
+
+  return std::sqrt(p[X]*p[X] + (p[Y]-s)*(p[Y]-s) + p[Z]*p[Z]);
+}
+
+/// Computes the signed distance and normal from the capsule to a point
+double CapsulePrimitive::calc_dist_and_normal(const Point3d& p, std::vector<Vector3d>& normals) const
+{
+  // get the distance from the axis segment
+  Point3d closest;
+  double dist = calc_closest_point(p, closest);
+
+  // setup the normal
+  normals.push_back(Vector3d());
+  Vector3d& normal = normals.back();
+  if (dist > NEAR_ZERO)
+  {
+    normal = p - closest;
+    normal /= dist;
+  }
+  else
+    normal = Vector3d(1.0, 0.0, 0.0, p.pose);
+
+  return dist - _radius;
+}
+
+/// Computes the signed distance from the capsule to a point
+double CapsulePrimitive::calc_signed_dist(const Point3d& p) const
+{
+  assert(_poses.find(const_pointer_cast<Pose3d>(p.pose)) != _poses.end());
+
+  Point3d closest;
+  return calc_closest_point(p, closest) - _radius;
+}
+
+/// Computes the signed distances from the capsule for a batch of points
+void CapsulePrimitive::calc_signed_dists(const Point3d* points, unsigned n, double* dists) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  if (n == 0)
+    return;
+
+  assert(_poses.find(const_pointer_cast<Pose3d>(points[0].pose)) != _poses.end());
+
+  const double HH = _height * 0.5;
+  for (unsigned i=0; i< n; i++)
+  {
+    const Point3d& p = points[i];
+    double s = p[Y];
+    if (s < -HH) s = -HH; else if (s > HH) s = HH;
+    dists[i] = std::sqrt(p[X]*p[X] + (p[Y]-s)*(p[Y]-s) + p[Z]*p[Z]) - _radius;
+  }
+}
+
+/// Sets the radius for this capsule
+void CapsulePrimitive::set_radius(double radius)
+{
+  _radius = radius;
+  if (_radius < 0.0)
+    throw std::runtime_error("Attempting to set negative radius on call to CapsulePrimitive::set_radius()");
+
+  // mass properties and bounding volumes no longer valid
+  calc_mass_properties();
+  _ssls.clear();
+
+  // need to update the visualization
+  update_visualization();
+}
+
+/// Sets the height for this capsule
+void CapsulePrimitive::set_height(double height)
+{
+  _height = height;
+  if (_height < 0.0)
+    throw std::runtime_error("Attempting to set negative height on call to CapsulePrimitive::set_height()");
+
+  // mass properties and bounding volumes no longer valid
+  calc_mass_properties();
+  _ssls.clear();
+
+  // need to update the visualization
+  update_visualization();
+}
+
+/// Transforms the primitive
+void CapsulePrimitive::set_pose(const Pose3d& p)
+{
+  // go ahead and set the new transform
+  Primitive::set_pose(p);
+
+  // recalculate the mass properties
+  calc_mass_properties();
+}
+
+/// Calculates mass properties for the capsule
+/**
+ * The capsule is treated as a cylinder plus two hemispherical caps; the
+ * mass is split between the pieces by volume.
+ */
+void CapsulePrimitive::calc_mass_properties()
+{
+  // compute the radius squared (we'll need this)
+  const double RSQ = _radius * _radius;
+
+  // get the volumes of the cylindrical portion and the two caps
+  const double VCYL = M_PI * RSQ * _height;
+  const double VSPH = M_PI * RSQ * _radius * 4.0/3.0;
+
+  // compute the mass if density is given
+  if (_density)
+    _J.m = *_density * (VCYL + VSPH);
+
+  // split the mass by volume between the cylinder and the caps
+  const double MCYL = (VCYL + VSPH > 0.0) ? _J.m * VCYL/(VCYL + VSPH) : 0.0;
+  const double MSPH = _J.m - MCYL;
+
+  // compute the longitudinal and transverse elements (cylinder plus two
+  // hemispheres translated to the endpoint centers)
+  const double HSQ = _height * _height;
+  const double LONG_ELM = MCYL * RSQ * 0.5 + MSPH * RSQ * 0.4;
+  const double NL_ELM = MCYL * (HSQ/12.0 + RSQ*0.25) +
+                        MSPH * (RSQ*0.4 + HSQ*0.25 + _height*_radius*0.375);
+
+  // compute the inertia matrix
+  _J.J = Matrix3d(NL_ELM, 0, 0, 0, LONG_ELM, 0, 0, 0, NL_ELM);
+}
+
+/// Gets the sphere-swept line (the capsule bounds itself exactly)
+BVPtr CapsulePrimitive::get_BVH_root(CollisionGeometryPtr geom)
+{
+  // get the pointer to the bounding volume
+  shared_ptr<SSL>& ssl = _ssls[geom];
+
+  // create the bounding volume, if necessary
+  if (!ssl)
+  {
+    // get the pose for this geometry
+    shared_ptr<const Pose3d> P = get_pose(geom);
+
+    // the SSL is the capsule itself: the axis segment swept by the radius
+    ssl = shared_ptr<SSL>(new SSL(Point3d(0.0, -_height*0.5, 0.0, P), Point3d(0.0, _height*0.5, 0.0, P), _radius));
+    ssl->geom = geom;
+  }
+
+  return ssl;
+}
+
+/// Gets vertices from the primitive
+void CapsulePrimitive::get_vertices(boost::shared_ptr<const Ravelin::Pose3d> P, std::vector<Point3d>& verts) const
+{
+  // rings of latitude per cap, including the cap/cylinder junction ring
+  const unsigned NLAT = 3;
+
+  // clear the vertices
+  verts.clear();
+
+  // if radius <= 0 or circle points < 3, return now
+  if (_radius <= 0.0 || _npoints < 3)
+    return;
+
+  // sample both caps: latitude rings from the junction toward the pole
+  const double HH = _height * 0.5;
+  for (int sgn = -1; sgn <= 1; sgn += 2)
+  {
+    for (unsigned j=0; j< NLAT; j++)
+    {
+      const double PHI = (M_PI * 0.5) * j / NLAT;
+      const double R = _radius * std::cos(PHI);
+      const double YOFF = _radius * std::sin(PHI);
+      for (unsigned i=0; i< _npoints; i++)
+      {
+        const double THETA = i * (M_PI * (double) 2.0/_npoints);
+        verts.push_back(Point3d(std::cos(THETA)*R, sgn*(HH+YOFF), std::sin(THETA)*R, P));
+      }
+    }
+
+    // add the pole
+    verts.push_back(Point3d(0.0, sgn*(HH+_radius), 0.0, P));
+  }
+}
+
+/// Gets the mesh corresponding to this primitive
+shared_ptr<const IndexedTriArray> CapsulePrimitive::get_mesh(boost::shared_ptr<const Ravelin::Pose3d> P)
+{
+  // verify that the primitive knows about this pose
+  assert(_poses.find(const_pointer_cast<Pose3d>(P)) != _poses.end());
+
+  // if radius = 0 or circle points < 3, return now
+  if (_radius <= 0.0 || _npoints < 3)
+    return shared_ptr<IndexedTriArray>(new IndexedTriArray());
+
+  // get the sample points and compute their convex hull
+  std::vector<Point3d> points;
+  get_vertices(P, points);
+  TessellatedPolyhedronPtr hull = CompGeom::calc_convex_hull(points.begin(), points.end());
+
+  // get the mesh
+  const std::vector<Origin3d>& v = hull->get_vertices();
+  const std::vector<IndexedTri>& f = hull->get_facets();
+  return shared_ptr<IndexedTriArray>(new IndexedTriArray(v.begin(), v.end(), f.begin(), f.end()));
+}
+
+/// Creates the visualization for this primitive
+osg::Node* CapsulePrimitive::create_visualization()
+{
+  #ifdef USE_OSG
+  osg::Capsule* cap = new osg::Capsule;
+  cap->setRadius((float) _radius);
+  cap->setHeight((float) _height);
+  cap->setRotation(osg::Quat(M_PI/2.0f, osg::Vec3f(1.0f, 0.0f, 0.0f)));
+  osg::Geode* geode = new osg::Geode;
+  geode->addDrawable(new osg::ShapeDrawable(cap));
+  return geode;
+  #else
+  return NULL;
+  #endif
+}
+
+/// Implements Base::load_from_xml() for serialization
+void CapsulePrimitive::load_from_xml(shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map)
+{
+  // verify that the node type is capsule
+  assert(strcasecmp(node->name.c_str(), "Capsule") == 0);
+
+  // load the parent data
+  Primitive::load_from_xml(node, id_map);
+
+  // read in the radius, if specified
+  XMLAttrib* radius_attr = node->get_attrib("radius");
+  if (radius_attr)
+    _radius = radius_attr->get_real_value();
+
+  // read in the height, if specified
+  XMLAttrib* height_attr = node->get_attrib("height");
+  if (height_attr)
+    _height = height_attr->get_real_value();
+
+  // read in the number of circle points, if specified
+  XMLAttrib* npoints_attr = node->get_attrib("num-circle-points");
+  if (npoints_attr)
+    _npoints = npoints_attr->get_unsigned_value();
+
+  // recompute mass properties
+  calc_mass_properties();
+}
+
+/// Implements Base::save_to_xml() for serialization
+void CapsulePrimitive::save_to_xml(XMLTreePtr node, std::list<shared_ptr<const Base> >& shared_objects) const
+{
+  // save the parent data
+  Primitive::save_to_xml(node, shared_objects);
+
+  // (re)set the node name
+  node->name = "Capsule";
+
+  // save the radius
+  node->attribs.insert(XMLAttrib("radius", _radius));
+
+  // save the height
+  node->attribs.insert(XMLAttrib("height", _height));
+
+  // save the number of circle points
+  node->attribs.insert(XMLAttrib("num-circle-points", _npoints));
+}
@@ -6,6 +6,8 @@
 
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <limits>
 #include <stack>
 #include <fstream>
 #include <Moby/TessellatedPolyhedron.h>
@@ -13,6 +15,8 @@
 #include <Moby/RigidBody.h>
 #include <Moby/Constants.h>
 #include <Moby/XMLTree.h>
+#include <Moby/PairwiseDistDispatch.h>
+#include <Moby/GJK.h>
 #include <Moby/CollisionGeometry.h>
 
 using std::vector;
@@ -26,6 +30,8 @@ using namespace Moby;
 CollisionGeometry::CollisionGeometry()
 {
   _F = shared_ptr<Pose3d>(new Pose3d);
+  _pose_stale = true;
+  material_id = 0;
 }
 
 /// Gets a supporting point for this geometry in a particular direction
@@ -100,6 +106,8 @@ PrimitivePtr CollisionGeometry::set_geometry(PrimitivePtr primitive)
 
   // save the primitive
   _geometry = primitive;
+  _pose_stale = true;
+  bump_generation();
 
   // add this to the primitive
   CollisionGeometryPtr cg = dynamic_pointer_cast<CollisionGeometry>(shared_from_this());
@@ -108,6 +116,48 @@ PrimitivePtr CollisionGeometry::set_geometry(PrimitivePtr primitive)
   return primitive;
 }
 
+/// Adds a lower level of detail to this geometry's resolution ladder
+/**
+ * Pairwise distance queries use the coarsest level whose activation distance
+ * is at or below the pair distance, falling back to the full-resolution
+ * primitive for near-contact pairs.
+ * \param primitive the coarse stand-in; it must enclose the full-resolution
+ *        geometry (e.g., its convex hull) so that coarse distances are
+ *        conservative
+ * \param min_dist the pair distance at and above which the level may be used
+ * \return the primitive added (for consistency with set_geometry())
+ */
+PrimitivePtr CollisionGeometry::add_lod_geometry(PrimitivePtr primitive, double min_dist)
+{
+  // add this to the primitive
+  CollisionGeometryPtr cg = dynamic_pointer_cast<CollisionGeometry>(shared_from_this());
+  primitive->add_collision_geometry(cg);
+
+  // insert the level, keeping the ladder sorted from coarsest to finest
+  unsigned i = 0;
+  while (i < _lods.size() && _lods[i].first > min_dist)
+    i++;
+  _lods.insert(_lods.begin()+i, std::make_pair(min_dist, primitive));
+
+  return primitive;
+}
+
+/// Selects the level of detail to use at an estimated pair distance
+/**
+ * \return an index into the resolution ladder; an index one past the end of
+ *         the ladder denotes the full-resolution primitive
+ */
+unsigned CollisionGeometry::select_lod(double dist) const
+{
+  // pick the coarsest level whose activation distance is not above the
+  // estimate; the ladder is sorted from coarsest to finest
+  for (unsigned i=0; i< _lods.size(); i++)
+    if (dist >= _lods[i].first)
+      return i;
+
+  return _lods.size();
+}
+
 /// Gets vertices for a primitive
 void CollisionGeometry::get_vertices(std::vector<Point3d>& vertices) const
 {
@@ -197,6 +247,10 @@ void CollisionGeometry::set_relative_pose(const Pose3d& P)
 
   // set the pose
   *_F = P;
+
+  // pose-derived data (e.g., bounds) must be recomputed
+  _pose_stale = true;
+  bump_generation();
 }
 
 /// Calculates the (unsigned) distance of a point from this collision geometry
@@ -233,20 +287,98 @@ double CollisionGeometry::calc_signed_dist(const Point3d& p)
 }
 
 /// Calculates the signed distances between two geometries and returns closest points if geometries are not interpenetrating
-double CollisionGeometry::calc_signed_dist(CollisionGeometryPtr gA, CollisionGeometryPtr gB, Point3d& pA, Point3d& pB) 
+double CollisionGeometry::calc_signed_dist(CollisionGeometryPtr gA, CollisionGeometryPtr gB, Point3d& pA, Point3d& pB, double threshold)
 {
-  // get the two primitives
-  PrimitivePtr primA = gA->get_geometry();
-  PrimitivePtr primB = gB->get_geometry();
-
-  // setup poses for the points
-  pA.pose = primA->get_pose(gA);
-  pB.pose = primB->get_pose(gB);
+  PairwiseDistInfo::NarrowPhaseStats discarded_stats;
+  return calc_signed_dist(gA, gB, pA, pB, discarded_stats, threshold);
+}
 
+/// Computes the signed distance between two geometries, recording narrow-phase statistics
+/**
+ * \param stats on return, records the path that resolved the query, the
+ *        number of level-of-detail requeries, and the dispatch-table hit
+ *        and miss counts (query_time is left untouched; timing is the
+ *        caller's concern)
+ * \param threshold when finite, the query may terminate as soon as the
+ *        distance is certified to be at least the threshold; the returned
+ *        value is then a lower bound on the distance (and the witness
+ *        points may be approximate), which suffices for callers that only
+ *        compare the distance against the threshold
+ */
+double CollisionGeometry::calc_signed_dist(CollisionGeometryPtr gA, CollisionGeometryPtr gB, Point3d& pA, Point3d& pB, PairwiseDistInfo::NarrowPhaseStats& stats, double threshold)
+{
   FILE_LOG(LOG_COLDET) << "CollisionGeometry::calc_signed_dist() - computing signed distance between " << gA->get_single_body()->body_id << " and " << gB->get_single_body()->body_id << std::endl;
 
-  // now compute the signed distance
-  return primA->calc_signed_dist(primB, pA, pB);
+  // for a thresholded query over convex geometries, first try to certify
+  // separation beyond the threshold with a few support-plane iterations;
+  // most far pairs resolve in one or two supports, skipping the exact query
+  if (threshold < std::numeric_limits<double>::max() &&
+      gA->get_geometry()->is_convex() && gB->get_geometry()->is_convex())
+  {
+    const unsigned CERT_BUDGET = 4;
+    double bound;
+    if (GJK::cull_pair(gA, gB, threshold, CERT_BUDGET, bound))
+    {
+      pA = Point3d(0.0, 0.0, 0.0, gA->get_pose());
+      pB = Point3d(0.0, 0.0, 0.0, gB->get_pose());
+      stats.alg = PairwiseDistInfo::eAlgCulled;
+      return bound;
+    }
+  }
+
+  // start each geometry at the coarsest level of its resolution ladder
+  // (the full-resolution primitive when no ladder was set up)
+  unsigned lodA = gA->select_lod(std::numeric_limits<double>::max());
+  unsigned lodB = gB->select_lod(std::numeric_limits<double>::max());
+
+  while (true)
+  {
+    // get the primitives for the current levels
+    PrimitivePtr primA = gA->get_lod_primitive(lodA);
+    PrimitivePtr primB = gB->get_lod_primitive(lodB);
+
+    // setup poses for the points
+    pA.pose = primA->get_pose(gA);
+    pB.pose = primB->get_pose(gB);
+
+    // try the direct-dispatch table first; it resolves specialized pairs
+    // without running the dynamic_pointer_cast chains in the virtual methods
+    double dist;
+    if (PairwiseDistDispatch::lookup(primA, primB, dist, pA, pB))
+    {
+      stats.alg = PairwiseDistInfo::eAlgKernel;
+      stats.kernel_hits++;
+    }
+    else
+    {
+      // no specialized kernel registered; use the virtual dispatch chain
+      dist = primA->calc_signed_dist(primB, pA, pB);
+      stats.alg = PairwiseDistInfo::eAlgVirtual;
+      stats.kernel_misses++;
+    }
+
+    // coarse levels enclose the full geometry, so their distance
+    // under-estimates the true one; a coarse answer at or beyond the
+    // caller's threshold therefore certifies the true distance is too,
+    // and no refinement is needed
+    if (dist >= threshold)
+      return dist;
+
+    // the distance is trusted when both levels remain selected at the
+    // measured distance; coarse levels enclose the full geometry, so a
+    // "near" coarse answer never hides a truly distant pair- only the
+    // converse- and refinement need only move toward finer levels (which
+    // also guarantees termination)
+    unsigned refA = std::max(lodA, gA->select_lod(dist));
+    unsigned refB = std::max(lodB, gB->select_lod(dist));
+    if (refA == lodA && refB == lodB)
+      return dist;
+
+    // requery at the finer levels
+    lodA = refA;
+    lodB = refB;
+    stats.iterations++;
+  }
 }
 
 /*
@@ -333,6 +465,11 @@ void CollisionGeometry::load_from_xml(shared_ptr<const XMLTree> node, std::map<s
     TR.q = rel_rpy_attr->get_rpy_value();
   set_relative_pose(TR);
 
+  // read the material id, if specified
+  XMLAttrib* material_attrib = node->get_attrib("material-id");
+  if (material_attrib)
+    material_id = material_attrib->get_unsigned_value();
+
   // read the primitive ID, if any
   XMLAttrib* primitive_id_attrib = node->get_attrib("primitive-id");
   if (primitive_id_attrib)
@@ -358,6 +495,36 @@ void CollisionGeometry::load_from_xml(shared_ptr<const XMLTree> node, std::map<s
         id_map[id] = newpc;
     }  
   }
+
+  // read the resolution ladder, if any
+  std::list<shared_ptr<const XMLTree> > lod_nodes = node->find_child_nodes("LOD");
+  for (std::list<shared_ptr<const XMLTree> >::const_iterator i = lod_nodes.begin(); i != lod_nodes.end(); i++)
+  {
+    // both the primitive and its activation distance are required
+    XMLAttrib* lod_prim_attr = (*i)->get_attrib("primitive-id");
+    XMLAttrib* lod_dist_attr = (*i)->get_attrib("min-dist");
+    if (!lod_prim_attr || !lod_dist_attr)
+    {
+      std::cerr << "CollisionGeometry::load_from_xml() - LOD node is missing ";
+      std::cerr << "a primitive-id or min-dist attribute" << std::endl;
+      continue;
+    }
+
+    // search for the primitive
+    const std::string& lod_id = lod_prim_attr->get_string_value();
+    std::map<std::string, BasePtr>::const_iterator lod_iter = id_map.find(lod_id);
+    if (lod_iter == id_map.end())
+    {
+      std::cerr << "CollisionGeometry::load_from_xml() - LOD primitive with ID '";
+      std::cerr << lod_id << "'" << std::endl << "  not found in offending node: ";
+      std::cerr << std::endl << *node;
+      continue;
+    }
+
+    // add the level
+    PrimitivePtr lod_pc = boost::dynamic_pointer_cast<Primitive>(lod_iter->second);
+    add_lod_geometry(lod_pc, lod_dist_attr->get_real_value());
+  }
 }
 
 /// Implements Base::save_to_xml()
@@ -369,15 +536,28 @@ void CollisionGeometry::save_to_xml(XMLTreePtr node, std::list<shared_ptr<const
   // set the node name
   node->name = "CollisionGeometry";
 
-  // add the relative pose 
+  // add the relative pose
   node->attribs.insert(XMLAttrib("relative-origin", _F->x));
   node->attribs.insert(XMLAttrib("relative-quat", _F->q));
 
+  // save the material id
+  node->attribs.insert(XMLAttrib("material-id", material_id));
+
   // save the ID of the primitive and add the primitive to the shared list
   if (_geometry)
   {
     node->attribs.insert(XMLAttrib("primitive-id", _geometry->id));
     shared_objects.push_back(_geometry);
   }
+
+  // save the resolution ladder
+  for (unsigned i=0; i< _lods.size(); i++)
+  {
+    XMLTreePtr lod_node(new XMLTree("LOD"));
+    lod_node->attribs.insert(XMLAttrib("primitive-id", _lods[i].second->id));
+    lod_node->attribs.insert(XMLAttrib("min-dist", _lods[i].first));
+    node->add_child(lod_node);
+    shared_objects.push_back(_lods[i].second);
+  }
 }
 
@@ -16,9 +16,9 @@
 #include <Moby/TessellatedPolyhedron.h>
 #include <Moby/CompGeom.h>
 
-/// Needed for qhull
-#ifdef THREADSAFE
-pthread_mutex_t Moby::CompGeom::_qhull_mutex = PTHREAD_MUTEX_INITIALIZER;
+/// Needed for classic (non-reentrant) qhull
+#if defined(THREADSAFE) && !defined(MOBY_QHULL_REENTRANT)
+pthread_mutex_t Moby::_qhull_mutex = PTHREAD_MUTEX_INITIALIZER;
 #endif
 
 using namespace Ravelin;
@@ -2905,3 +2905,38 @@ void CompGeom::clip_convex_polygon_against_line(const Vector2d& rkN, double fC,
     ri = 0;
 }
 
+
+/// Computes the convex hulls of a batch of independent point sets
+/**
+ * Intended for decomposition-style workloads (many independent pieces from
+ * one model): the sets are processed in parallel when OpenMP is enabled and
+ * concurrent qhull use is safe. Against reentrant qhull
+ * (MOBY_QHULL_REENTRANT) every thread gets its own context and the hulls
+ * are built fully concurrently; against classic qhull the hull extraction
+ * serializes on the qhull mutex (THREADSAFE builds only) and just the
+ * per-piece marshalling and polyhedron construction run concurrently. Sets
+ * that are degenerate or that qhull fails on yield null pointers in the
+ * output.
+ */
+void CompGeom::calc_convex_hulls(const std::vector<std::vector<Point3d> >& point_sets, std::vector<TessellatedPolyhedronPtr>& hulls)
+{
+  // size the output
+  hulls.resize(point_sets.size());
+
+  // compute the hull of each set; only parallelize when concurrent qhull
+  // use cannot race (per-thread contexts or the serializing mutex)
+  #if defined(_OPENMP) && (defined(THREADSAFE) || defined(MOBY_QHULL_REENTRANT))
+  #pragma omp parallel for
+  #endif
+  for (int i=0; i< (int) point_sets.size(); i++)
+  {
+    try
+    {
+      hulls[i] = calc_convex_hull(point_sets[i].begin(), point_sets[i].end());
+    }
+    catch (NumericalException e)
+    {
+      hulls[i] = TessellatedPolyhedronPtr();
+    }
+  }
+}
@@ -17,6 +17,7 @@
 #include <Moby/XMLTree.h>
 #include <Moby/OBB.h>
 #include <Moby/SpherePrimitive.h>
+#include <Moby/PlanePrimitive.h>
 #include <Moby/TriangleMeshPrimitive.h>
 #include <Moby/HeightmapPrimitive.h>
 #include <Moby/GJK.h>
@@ -539,6 +540,11 @@ void ConePrimitive::calc_mass_properties()
 /// Finds the signed distance between the cylinder and another primitive
 double ConePrimitive::calc_signed_dist(shared_ptr<const Primitive> p, Point3d& pthis, Point3d& pp) const
 {
+  // first look for plane primitive (analytic)
+  shared_ptr<const PlanePrimitive> planep = dynamic_pointer_cast<const PlanePrimitive>(p);
+  if (planep)
+    return planep->calc_signed_dist(dynamic_pointer_cast<const ConePrimitive>(shared_from_this()), pp, pthis);
+
   shared_ptr<const HeightmapPrimitive> hmp = dynamic_pointer_cast<const HeightmapPrimitive>(p);
   if (hmp)
     return hmp->calc_signed_dist(dynamic_pointer_cast<const Primitive>(shared_from_this()), pp, pthis);
@@ -714,6 +720,105 @@ bool ConePrimitive::point_inside(const Point3d& p, Vector3d& normal) const
   return true;
 }
 
+/// Casts a ray against the cone (analytic)
+/**
+ * The cone has its apex at y = +height/2 and its base (radius R) at
+ * y = -height/2; the lateral surface satisfies
+ * x^2 + z^2 = k^2 (height/2 - y)^2 with k = R/height.
+ */
+bool ConePrimitive::ray_cast(const Point3d& origin, const Vector3d& dir, double max_dist, double& t, Vector3d& normal) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+  const double INF = std::numeric_limits<double>::max();
+  const double halfheight = _height*0.5;
+  const double k = _radius/_height;
+
+  assert(_poses.find(const_pointer_cast<Pose3d>(origin.pose)) != _poses.end());
+
+  // best intersection found so far
+  double tbest = INF;
+  bool lateral_hit = false;
+
+  // intersect with the (double) cone surface; s = height/2 - y decreases
+  // along +y, so the quadratic is in terms of s0 = height/2 - oy
+  double s0 = halfheight - origin[Y];
+  double A = dir[X]*dir[X] + dir[Z]*dir[Z] - k*k*dir[Y]*dir[Y];
+  double B = 2.0*(origin[X]*dir[X] + origin[Z]*dir[Z] + k*k*s0*dir[Y]);
+  double C = origin[X]*origin[X] + origin[Z]*origin[Z] - k*k*s0*s0;
+  if (std::fabs(A) > NEAR_ZERO)
+  {
+    double disc = B*B - 4.0*A*C;
+    if (disc >= 0.0)
+    {
+      double rt = std::sqrt(disc);
+      for (int i=0; i< 2; i++)
+      {
+        double tc = (i == 0) ? (-B - rt)/(2.0*A) : (-B + rt)/(2.0*A);
+        if (tc >= 0.0 && tc < tbest)
+        {
+          // reject roots on the mirror cone (above the apex) or below base
+          double y = origin[Y] + dir[Y]*tc;
+          if (y >= -halfheight && y <= halfheight)
+          {
+            tbest = tc;
+            lateral_hit = true;
+          }
+        }
+      }
+    }
+  }
+  else if (std::fabs(B) > NEAR_ZERO)
+  {
+    // ray parallel to a generator: the quadratic degenerates to linear
+    double tc = -C/B;
+    if (tc >= 0.0 && tc < tbest)
+    {
+      double y = origin[Y] + dir[Y]*tc;
+      if (y >= -halfheight && y <= halfheight)
+      {
+        tbest = tc;
+        lateral_hit = true;
+      }
+    }
+  }
+
+  // intersect with the base disk at y = -halfheight
+  if (std::fabs(dir[Y]) > NEAR_ZERO)
+  {
+    double tc = (-halfheight - origin[Y])/dir[Y];
+    if (tc >= 0.0 && tc < tbest)
+    {
+      double x = origin[X] + dir[X]*tc;
+      double z = origin[Z] + dir[Z]*tc;
+      if (x*x + z*z <= _radius*_radius)
+      {
+        tbest = tc;
+        lateral_hit = false;
+      }
+    }
+  }
+
+  // see whether the nearest intersection is within range
+  if (tbest > max_dist)
+    return false;
+  t = tbest;
+
+  // compute the outward normal of the hit feature
+  if (lateral_hit)
+  {
+    Point3d p = origin + dir*t;
+    normal = Vector3d::normalize(Vector3d(p[X], k*k*(halfheight - p[Y]), p[Z], origin.pose));
+  }
+  else
+    normal = Vector3d(0.0, -1.0, 0.0, origin.pose);
+
+  // orient the normal against the ray (for rays cast from inside)
+  if (normal.dot(dir) > 0.0)
+    normal = -normal;
+
+  return true;
+}
+
 /// Computes the signed distance from the cylinder
 double ConePrimitive::calc_signed_dist(const Point3d& p) const
 {
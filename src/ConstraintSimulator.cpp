@@ -5,6 +5,8 @@
  ****************************************************************************/
 
 #include <unistd.h>
+#include <sys/time.h>
+#include <fstream>
 #include <boost/tuple/tuple.hpp>
 #include <Moby/XMLTree.h>
 #include <Moby/Dissipation.h>
@@ -19,6 +21,8 @@
 #include <Moby/InvalidStateException.h>
 #include <Moby/InvalidVelocityException.h>
 #include <Moby/ConstraintStabilization.h>
+#include <Moby/SpatialGridCCD.h>
+#include <Moby/GJK.h>
 #include <Moby/ConstraintSimulator.h>
 
 #ifdef USE_OSG
@@ -55,13 +59,358 @@ ConstraintSimulator::ConstraintSimulator()
   // setup contact distance thresholds
   contact_dist_thresh = 1e-6;
 
+  // contact activation hysteresis is off by default
+  contact_hysteresis = 0.0;
+
+  // region-of-interest culling is off by default
+  roi_enabled = false;
+  roi_promotion_dist = 0.0;
+
+  // the material-pair table is empty until materials are defined
+  _num_materials = 0;
+
+  // manifold caching is off by default
+  manifold_reuse_tol = 0.0;
+
+  // manifold reduction is off by default
+  max_manifold_points = 0;
+
+  // batch GJK culling is off by default
+  gjk_batch_culling = false;
+  separating_plane_certificates = false;
+
+  // per-pair narrow-phase statistics are off by default
+  record_narrow_phase_stats = false;
+
+  // replay memoization is off by default
+  replay_cache_enabled = false;
+  _replay_cache_loaded = _replay_cache_dirty = false;
+
+  // the pipelined broad phase is off by default
+  async_broad_phase = false;
+  _bp_thread_running = _bp_job_pending = _bp_job_done = _bp_shutdown = false;
+  _bp_active = false;
+  _bp_dt = 0.0;
+  pthread_mutex_init(&_bp_mutex, NULL);
+  pthread_cond_init(&_bp_cond, NULL);
+
+  // the asynchronous detector is off until one is installed
+  _acd_thread_running = _acd_job_pending = _acd_shutdown = _acd_busy = false;
+  _acd_front = 0;
+  _acd_result_valid = _acd_result_consumed = false;
+  pthread_mutex_init(&_acd_mutex, NULL);
+  pthread_cond_init(&_acd_cond, NULL);
+
   // setup the collision detector
   _coldet = shared_ptr<CollisionDetection>(new CCD);
 }
 
+ConstraintSimulator::~ConstraintSimulator()
+{
+  // persist fresh replay memo entries for subsequent passes
+  if (replay_cache_enabled && _replay_cache_dirty)
+    save_replay_cache();
+
+  // shut down the broad-phase worker, if one was started
+  if (_bp_thread_running)
+  {
+    pthread_mutex_lock(&_bp_mutex);
+    _bp_shutdown = true;
+    pthread_cond_broadcast(&_bp_cond);
+    pthread_mutex_unlock(&_bp_mutex);
+    pthread_join(_bp_thread, NULL);
+  }
+
+  pthread_cond_destroy(&_bp_cond);
+  pthread_mutex_destroy(&_bp_mutex);
+
+  // shut down the asynchronous detector worker, if one was started
+  if (_acd_thread_running)
+  {
+    pthread_mutex_lock(&_acd_mutex);
+    _acd_shutdown = true;
+    pthread_cond_broadcast(&_acd_cond);
+    pthread_mutex_unlock(&_acd_mutex);
+    pthread_join(_acd_thread, NULL);
+  }
+
+  pthread_cond_destroy(&_acd_cond);
+  pthread_mutex_destroy(&_acd_mutex);
+}
+
+/// Worker thread entry point for the pipelined broad phase
+void* ConstraintSimulator::broad_phase_worker(void* arg)
+{
+  ConstraintSimulator* sim = (ConstraintSimulator*) arg;
+
+  pthread_mutex_lock(&sim->_bp_mutex);
+  while (true)
+  {
+    // wait for a job (or for shutdown)
+    while (!sim->_bp_job_pending && !sim->_bp_shutdown)
+      pthread_cond_wait(&sim->_bp_cond, &sim->_bp_mutex);
+    if (sim->_bp_shutdown)
+      break;
+    sim->_bp_job_pending = false;
+
+    // run the broad phase outside the lock; _bp_pairs is touched only by
+    // this thread between job start and completion
+    double dt = sim->_bp_dt;
+    pthread_mutex_unlock(&sim->_bp_mutex);
+    sim->_coldet->broad_phase(dt, sim->_bodies, sim->_bp_pairs);
+    pthread_mutex_lock(&sim->_bp_mutex);
+
+    // signal completion
+    sim->_bp_job_done = true;
+    pthread_cond_broadcast(&sim->_bp_cond);
+  }
+  pthread_mutex_unlock(&sim->_bp_mutex);
+
+  return NULL;
+}
+
+/// Worker thread entry point for the asynchronous detector
+void* ConstraintSimulator::async_detection_worker(void* arg)
+{
+  ConstraintSimulator* sim = (ConstraintSimulator*) arg;
+
+  pthread_mutex_lock(&sim->_acd_mutex);
+  while (true)
+  {
+    // wait for a job (or for shutdown)
+    while (!sim->_acd_job_pending && !sim->_acd_shutdown)
+      pthread_cond_wait(&sim->_acd_cond, &sim->_acd_mutex);
+    if (sim->_acd_shutdown)
+      break;
+    sim->_acd_job_pending = false;
+    sim->_acd_busy = true;
+
+    // run the detector outside the lock against the snapshotted poses; the
+    // back buffer is touched only by this thread until the flip below, and
+    // the snapshot is rewritten only while the worker is idle
+    std::vector<UnilateralConstraint>& contacts = sim->_acd_buffers[1 - sim->_acd_front];
+    pthread_mutex_unlock(&sim->_acd_mutex);
+    contacts.clear();
+    sim->_async_coldet->find_contacts_async(sim->_acd_snapshot, contacts);
+    pthread_mutex_lock(&sim->_acd_mutex);
+
+    // publish: the completed buffer becomes the front buffer
+    sim->_acd_front = 1 - sim->_acd_front;
+    sim->_acd_result_valid = true;
+    sim->_acd_result_consumed = false;
+    sim->_acd_busy = false;
+  }
+  pthread_mutex_unlock(&sim->_acd_mutex);
+
+  return NULL;
+}
+
+/// Installs a collision detector that runs asynchronously to the step loop
+/**
+ * The detector supplements the standard one: each step hands it a snapshot
+ * of the geometry poses (see post_async_detection_job()), its
+ * find_contacts_async() runs on a dedicated worker thread, and the step
+ * loop merges the freshest completed contact set into the rigid constraints
+ * (see consume_async_detection()). Contacts may thus be up to one query
+ * behind the true poses- the intended use is expensive exotic detectors
+ * (e.g., cable geometry) that tolerate a step of staleness but would
+ * otherwise block the step loop.
+ */
+void ConstraintSimulator::set_async_collision_detection(shared_ptr<CollisionDetection> coldet)
+{
+  _async_coldet = coldet;
+  if (coldet)
+  {
+    shared_ptr<ConstraintSimulator> shared_this = dynamic_pointer_cast<ConstraintSimulator>(shared_from_this());
+    coldet->set_simulator(shared_this);
+  }
+}
+
+/// Hands the current poses to the asynchronous detector, if it is idle
+void ConstraintSimulator::post_async_detection_job()
+{
+  if (!_async_coldet)
+    return;
+
+  // start the persistent worker on first use
+  if (!_acd_thread_running)
+  {
+    pthread_create(&_acd_thread, NULL, &async_detection_worker, this);
+    _acd_thread_running = true;
+  }
+
+  pthread_mutex_lock(&_acd_mutex);
+
+  // if a query is still in flight, let it finish; the step loop consumes
+  // the last completed result instead of waiting
+  if (_acd_busy || _acd_job_pending)
+  {
+    pthread_mutex_unlock(&_acd_mutex);
+    return;
+  }
+
+  // snapshot the geometry poses (absolute, in the global frame) so the
+  // worker never reads poses the stepping thread is updating
+  _acd_snapshot.clear();
+  for (unsigned i=0; i< _geometries.size(); i++)
+  {
+    Pose3d P = *_geometries[i]->get_pose();
+    P.update_relative_pose(GLOBAL);
+    _acd_snapshot.push_back(std::make_pair(_geometries[i], P));
+  }
+
+  // post the job
+  _acd_job_pending = true;
+  pthread_cond_broadcast(&_acd_cond);
+  pthread_mutex_unlock(&_acd_mutex);
+}
+
+/// Merges the freshest completed asynchronous contact set, if a new one exists
+void ConstraintSimulator::consume_async_detection()
+{
+  if (!_async_coldet || !_acd_thread_running)
+    return;
+
+  pthread_mutex_lock(&_acd_mutex);
+  if (_acd_result_valid && !_acd_result_consumed)
+  {
+    // merge the front buffer (the worker only writes the other one); each
+    // completed result is applied exactly once, so a detector slower than
+    // several steps does not re-impulse stale contacts
+    const std::vector<UnilateralConstraint>& contacts = _acd_buffers[_acd_front];
+    _rigid_constraints.insert(_rigid_constraints.end(), contacts.begin(), contacts.end());
+    _acd_result_consumed = true;
+  }
+  pthread_mutex_unlock(&_acd_mutex);
+}
+
+/// Hands the next mini-step's broad phase to the worker thread
+/**
+ * Bodies' positions must be final for the next mini-step when this is called;
+ * only velocities may change (by constraint impulses) while the job runs.
+ * \param dt the sweep horizon (an upper bound on the next step size)
+ */
+void ConstraintSimulator::start_broad_phase_async(double dt)
+{
+  // record each body's speed so finish_broad_phase_async() can detect
+  // impulses that invalidated the swept bounding volumes
+  _bp_speeds.resize(_bodies.size());
+  for (unsigned i=0; i< _bodies.size(); i++)
+  {
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+    db->get_generalized_velocity(DynamicBodyd::eSpatial, _workV);
+    _bp_speeds[i] = _workV.norm();
+  }
+
+  // start the persistent worker on first use
+  if (!_bp_thread_running)
+  {
+    pthread_create(&_bp_thread, NULL, &broad_phase_worker, this);
+    _bp_thread_running = true;
+  }
+
+  // post the job
+  pthread_mutex_lock(&_bp_mutex);
+  _bp_dt = dt;
+  _bp_job_pending = true;
+  _bp_job_done = false;
+  pthread_cond_broadcast(&_bp_cond);
+  pthread_mutex_unlock(&_bp_mutex);
+  _bp_active = true;
+}
+
+/// Waits for the prefetched broad phase and installs it, if still valid
+/**
+ * \return true if the prefetched pairs were installed into _pairs_to_check;
+ *         false if no job was outstanding or impulses increased some body's
+ *         speed (the swept volumes may then miss pairs, so the caller must
+ *         run the broad phase synchronously)
+ */
+bool ConstraintSimulator::finish_broad_phase_async()
+{
+  const double SPEED_GROWTH_TOL = 1.05;
+
+  // no job outstanding?
+  if (!_bp_active)
+    return false;
+
+  // wait for the worker to finish
+  pthread_mutex_lock(&_bp_mutex);
+  while (!_bp_job_done)
+    pthread_cond_wait(&_bp_cond, &_bp_mutex);
+  pthread_mutex_unlock(&_bp_mutex);
+  _bp_active = false;
+
+  // the sweep used pre-impact velocities; discard the result if any body
+  // is now moving appreciably faster than when the job was posted
+  if (_bp_speeds.size() != _bodies.size())
+    return false;
+  for (unsigned i=0; i< _bodies.size(); i++)
+  {
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+    db->get_generalized_velocity(DynamicBodyd::eSpatial, _workV);
+    if (_workV.norm() > _bp_speeds[i]*SPEED_GROWTH_TOL + NEAR_ZERO)
+    {
+      FILE_LOG(LOG_COLDET) << "ConstraintSimulator::finish_broad_phase_async() - impulses increased a body's speed; discarding prefetched broad phase" << std::endl;
+      return false;
+    }
+  }
+
+  // install the prefetched pairs
+  _pairs_to_check.swap(_bp_pairs);
+  return true;
+}
+
+/// Waits for any outstanding broad-phase job and discards its result
+/**
+ * Must be called before anything outside the mini-step loop (e.g.,
+ * constraint stabilization) repositions bodies, since the worker reads body
+ * poses while it runs.
+ */
+void ConstraintSimulator::cancel_broad_phase_async()
+{
+  if (!_bp_active)
+    return;
+
+  pthread_mutex_lock(&_bp_mutex);
+  while (!_bp_job_done)
+    pthread_cond_wait(&_bp_cond, &_bp_mutex);
+  pthread_mutex_unlock(&_bp_mutex);
+  _bp_active = false;
+}
+
+/// Sets the contact parameters for a pair of materials
+/**
+ * The table is grown to cover the larger material id and the entry is stored
+ * symmetrically, so lookup order of the two ids does not matter.
+ * \param material1 the material of one geometry (see CollisionGeometry::material_id)
+ * \param material2 the material of the other geometry
+ * \param cp the contact parameters for the pair (NULL clears the entry)
+ */
+void ConstraintSimulator::set_material_params(unsigned material1, unsigned material2, shared_ptr<ContactParameters> cp)
+{
+  // grow the table if a material id exceeds its dimension
+  const unsigned N = std::max(material1, material2)+1;
+  if (N > _num_materials)
+  {
+    std::vector<shared_ptr<ContactParameters> > grown(N*N);
+    for (unsigned i=0; i< _num_materials; i++)
+      for (unsigned j=0; j< _num_materials; j++)
+        grown[i*N + j] = _material_params[i*_num_materials + j];
+    _material_params.swap(grown);
+    _num_materials = N;
+  }
+
+  // store the entry symmetrically
+  _material_params[material1*_num_materials + material2] = cp;
+  _material_params[material2*_num_materials + material1] = cp;
+}
+
 /// Gets the contact data between a pair of geometries (if any)
 /**
- * This method looks for contact data not only between the pair of geometries, but also
+ * This method first consults the material-pair table using the material ids of
+ * the two geometries (a direct index, no search). Failing that, it looks for
+ * contact data not only between the pair of geometries, but also
  * the rigid bodies that the geometries belong to, and any articulated bodies as well.
  * The search proceeds in the following manner: <br />
  * <ol>
@@ -92,9 +441,20 @@ shared_ptr<ContactParameters> ConstraintSimulator::get_contact_parameters(Collis
       return cp;
   }
 
-  // search for the two contact geometries first
-  if ((iter = contact_params.find(make_sorted_pair(geom1, geom2))) != contact_params.end())
-    return iter->second;
+  // exact geometry-pair overrides take precedence over the material table;
+  // scenes resolved purely by material leave the map empty and skip it
+  if (!contact_params.empty())
+    if ((iter = contact_params.find(make_sorted_pair(geom1, geom2))) != contact_params.end())
+      return iter->second;
+
+  // resolve by material pair with direct indexing
+  shared_ptr<ContactParameters> mp = get_material_params(geom1->material_id, geom2->material_id);
+  if (mp)
+    return mp;
+
+  // no table entry; fall back to the hierarchical search of the map
+  if (contact_params.empty())
+    return shared_ptr<ContactParameters>();
 
   // get the geometries as base pointers
   BasePtr g1(geom1);
@@ -301,6 +661,10 @@ void ConstraintSimulator::calc_impacting_unilateral_constraint_forces(double dt)
   if (_rigid_constraints.empty() && implicit_joints.empty())
     return;
 
+  // positions may have changed since the last constraint pass, so cached
+  // inverse inertias are stale
+  UnilateralConstraint::invalidate_inverse_inertias();
+
   // call the callback function, if any
   if (constraint_callback_fn)
     (*constraint_callback_fn)(_rigid_constraints, constraint_callback_data);
@@ -443,28 +807,622 @@ void ConstraintSimulator::determine_geometries()
   _geometries.erase(std::unique(_geometries.begin(), _geometries.end()), _geometries.end());
 }
 
+/// Estimates the simulator's heap memory, per subsystem
+/**
+ * Adds the collision detector's state (including the contact manifold
+ * cache) and the constraint solvers' workspaces to the geometry counted by
+ * Simulator::calc_memory_footprint().
+ */
+void ConstraintSimulator::calc_memory_footprint(MemoryFootprint& fp) const
+{
+  // count the geometry
+  Simulator::calc_memory_footprint(fp);
+
+  // count the collision detector state
+  if (_coldet)
+    fp.collision_detection += _coldet->calc_memory_usage();
+  if (_async_coldet)
+    fp.collision_detection += _async_coldet->calc_memory_usage();
+
+  // count the contact manifold cache
+  for (map<sorted_pair<CollisionGeometryPtr>, ManifoldCacheEntry>::const_iterator i = _manifold_cache.begin(); i != _manifold_cache.end(); i++)
+    fp.collision_detection += sizeof(*i) + i->second.contacts.capacity()*sizeof(UnilateralConstraint);
+
+  // count the constraint solver workspaces
+  fp.solver_workspaces += _impact_constraint_handler.calc_memory_usage();
+  fp.solver_workspaces += cstab.calc_memory_usage();
+}
+
+/// Releases caches that can be rebuilt on demand
+/**
+ * Releases the collision detector's caches, the contact manifold cache, and
+ * the solvers' warm starts; subsequent steps recompute them.
+ */
+void ConstraintSimulator::release_transient_memory()
+{
+  Simulator::release_transient_memory();
+  if (_coldet)
+    _coldet->release_transient_memory();
+  if (_async_coldet)
+    _async_coldet->release_transient_memory();
+  _manifold_cache.clear();
+  _kept_manifold_points.clear();
+  _separation_certs.clear();
+  _impact_constraint_handler.release_transient_memory();
+  cstab.release_transient_memory();
+}
+
+/// Drops per-pair state involving a body's geometries after it is repositioned discontinuously
+/**
+ * Call this after teleporting a body (or restoring its pose from a
+ * checkpoint) so state accumulated over the pair's pose history does not
+ * poison subsequent queries.  Cached manifolds and separating-plane
+ * certificates for pairs involving the body are dropped here, and the
+ * collision detectors drop their own per-pair state (see
+ * CollisionDetection::invalidate_pair_state()); pairs not involving the
+ * body are untouched, so the cost is linear in the body's pairs rather
+ * than a full-scene reset.
+ */
+void ConstraintSimulator::invalidate_pair_state(ControlledBodyPtr body)
+{
+  // collect the body's collision geometries (per link for articulated bodies)
+  set<CollisionGeometryPtr> geoms;
+  shared_ptr<ArticulatedBody> ab = dynamic_pointer_cast<ArticulatedBody>(body);
+  if (ab)
+  {
+    BOOST_FOREACH(shared_ptr<RigidBodyd> link, ab->get_links())
+    {
+      RigidBodyPtr rb = dynamic_pointer_cast<RigidBody>(link);
+      geoms.insert(rb->geometries.begin(), rb->geometries.end());
+    }
+  }
+  else
+  {
+    RigidBodyPtr rb = dynamic_pointer_cast<RigidBody>(body);
+    if (rb)
+      geoms.insert(rb->geometries.begin(), rb->geometries.end());
+  }
+
+  // drop cached manifolds, kept manifold points, and separation certificates
+  // for pairs involving those geometries; the manifold drift check and the
+  // certificate validation both use current poses, but a jump that happens
+  // to preserve a pair's relative pose (e.g., wrapping both bodies across a
+  // periodic boundary) would otherwise let stale contacts be reused
+  for (map<sorted_pair<CollisionGeometryPtr>, ManifoldCacheEntry>::iterator i = _manifold_cache.begin(); i != _manifold_cache.end(); )
+  {
+    if (geoms.find(i->first.first) != geoms.end() || geoms.find(i->first.second) != geoms.end())
+      _manifold_cache.erase(i++);
+    else
+      i++;
+  }
+  for (map<sorted_pair<CollisionGeometryPtr>, std::vector<Point3d> >::iterator i = _kept_manifold_points.begin(); i != _kept_manifold_points.end(); )
+  {
+    if (geoms.find(i->first.first) != geoms.end() || geoms.find(i->first.second) != geoms.end())
+      _kept_manifold_points.erase(i++);
+    else
+      i++;
+  }
+  for (map<sorted_pair<CollisionGeometryPtr>, SeparationCertificate>::iterator i = _separation_certs.begin(); i != _separation_certs.end(); )
+  {
+    if (geoms.find(i->first.first) != geoms.end() || geoms.find(i->first.second) != geoms.end())
+      _separation_certs.erase(i++);
+    else
+      i++;
+  }
+
+  // forget contact hysteresis state for those pairs; a jump should neither
+  // hold a now-distant pair in contact nor carry activation to the new pose
+  for (set<sorted_pair<CollisionGeometryPtr> >::iterator i = _active_pairs.begin(); i != _active_pairs.end(); )
+  {
+    if (geoms.find(i->first) != geoms.end() || geoms.find(i->second) != geoms.end())
+      _active_pairs.erase(i++);
+    else
+      i++;
+  }
+
+  // let the collision detectors drop their own per-pair state
+  if (_coldet)
+    _coldet->invalidate_pair_state(body);
+  if (_async_coldet)
+    _async_coldet->invalidate_pair_state(body);
+}
+
+/// Casts a ray against all collision geometry in the scene
+/**
+ * Each geometry is first pruned with the same bounding sphere the continuous
+ * collision detector uses for its broad phase; only geometries whose sphere
+ * the ray enters (and enters nearer than the best hit found so far) are
+ * queried through their primitive's ray_cast().
+ * \param origin the origin of the ray, in the global frame
+ * \param dir the (unit) direction of the ray, in the global frame
+ * \param max_dist the maximum distance to search along the ray
+ * \param t on return, the distance along the ray to the nearest hit (if any)
+ * \param normal on return, the surface normal at the hit point, in the
+ *        global frame (if any)
+ * \return the geometry hit nearest the origin, or a NULL pointer on a miss
+ */
+CollisionGeometryPtr ConstraintSimulator::ray_cast(const Point3d& origin, const Vector3d& dir, double max_dist, double& t, Vector3d& normal)
+{
+  // make sure the geometry list is current (a cast may precede the first step)
+  if (_geometries.empty())
+    determine_geometries();
+
+  // the nearest hit found so far
+  CollisionGeometryPtr best_geom;
+  t = max_dist;
+
+  BOOST_FOREACH(CollisionGeometryPtr cg, _geometries)
+  {
+    // prune using the broad-phase bounding sphere for this geometry
+    BVPtr bv = CCD::construct_bounding_sphere(cg);
+    double tmin = 0.0;
+    Point3d q;
+    LineSeg3 seg(origin, origin + dir*t);
+    if (!bv->intersects(seg, tmin, 1.0, q))
+      continue;
+
+    // transform the ray into the primitive's pose for this geometry
+    PrimitivePtr primitive = cg->get_geometry();
+    shared_ptr<const Pose3d> P = primitive->get_pose(cg);
+    Point3d op = Pose3d::transform_point(P, origin);
+    Vector3d dp = Pose3d::transform_vector(P, dir);
+
+    // query the primitive, searching no farther than the best hit so far
+    double tg;
+    Vector3d ng;
+    if (primitive->ray_cast(op, dp, t, tg, ng) && tg < t)
+    {
+      t = tg;
+      normal = Pose3d::transform_vector(GLOBAL, ng);
+      best_geom = cg;
+    }
+  }
+
+  return best_geom;
+}
+
+/// Gets the current wall-clock time in seconds (for narrow-phase statistics)
+static double wallclock_time()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double) tv.tv_sec + (double) tv.tv_usec * 1e-6;
+}
+
+/// Orders pair cost records by total narrow-phase time, most expensive first
+static bool pair_cost_greater(const ConstraintSimulator::PairCostRecord& a, const ConstraintSimulator::PairCostRecord& b)
+{
+  return a.total_time > b.total_time;
+}
+
+/// Gets the k most expensive geometry pairs in the current statistics window
+/**
+ * Records are ordered by total narrow-phase time, descending. The window is
+ * the period since construction or the last reset_narrow_phase_stats() call;
+ * record_narrow_phase_stats must be set for records to accumulate.
+ */
+void ConstraintSimulator::get_top_narrow_phase_pairs(unsigned k, std::vector<PairCostRecord>& records) const
+{
+  records.clear();
+  for (std::map<sorted_pair<CollisionGeometryPtr>, PairCostRecord>::const_iterator i = _pair_costs.begin(); i != _pair_costs.end(); i++)
+    records.push_back(i->second);
+
+  // sort by aggregate cost and truncate to the k most expensive
+  std::sort(records.begin(), records.end(), pair_cost_greater);
+  if (records.size() > k)
+    records.resize(k);
+}
+
+/// Clears the narrow-phase statistics window
+void ConstraintSimulator::reset_narrow_phase_stats()
+{
+  _pair_costs.clear();
+}
+
+/// Folds a run of bytes into a 64-bit FNV-1a hash
+static unsigned long long fnv64(const void* data, unsigned len, unsigned long long h)
+{
+  const unsigned char* p = (const unsigned char*) data;
+  for (unsigned i=0; i< len; i++)
+  {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+/// Computes the replay memo key for a geometry pair at its current poses
+/**
+ * The first component hashes the two geometry ids in lexicographic order (so
+ * the key is stable across processes, unlike pointer order); the second
+ * hashes the pair's relative pose, quantized so that float noise below the
+ * quantum cannot split identical replayed configurations into distinct keys.
+ */
+static std::pair<unsigned long long, unsigned long long> replay_cache_key(CollisionGeometryPtr a, CollisionGeometryPtr b)
+{
+  const double QUANT = 1e-9;
+  const unsigned long long FNV_OFFSET = 14695981039346656037ULL;
+
+  // order the pair by id
+  CollisionGeometryPtr ga = a, gb = b;
+  if (gb->id < ga->id)
+    std::swap(ga, gb);
+
+  // hash the ids, separated so concatenation cannot alias
+  unsigned long long idhash = fnv64(ga->id.c_str(), ga->id.size()+1, FNV_OFFSET);
+  idhash = fnv64(gb->id.c_str(), gb->id.size()+1, idhash);
+
+  // get the relative pose and canonicalize the quaternion's double cover
+  Transform3d aTb = Pose3d::calc_relative_pose(gb->get_pose(), ga->get_pose());
+  Quatd q = aTb.q;
+  if (q.w < 0.0)
+  {
+    q.w = -q.w; q.x = -q.x; q.y = -q.y; q.z = -q.z;
+  }
+
+  // hash the quantized pose
+  long long cells[7];
+  cells[0] = (long long) std::floor(aTb.x[0]/QUANT + 0.5);
+  cells[1] = (long long) std::floor(aTb.x[1]/QUANT + 0.5);
+  cells[2] = (long long) std::floor(aTb.x[2]/QUANT + 0.5);
+  cells[3] = (long long) std::floor(q.w/QUANT + 0.5);
+  cells[4] = (long long) std::floor(q.x/QUANT + 0.5);
+  cells[5] = (long long) std::floor(q.y/QUANT + 0.5);
+  cells[6] = (long long) std::floor(q.z/QUANT + 0.5);
+  unsigned long long posehash = fnv64(cells, sizeof(cells), FNV_OFFSET);
+
+  return std::make_pair(idhash, posehash);
+}
+
+/// Loads the replay memo from replay_cache_file, if the file exists
+/**
+ * A missing or unreadable file is not an error: the first pass over a
+ * trajectory starts with an empty memo and persists it on destruction.
+ */
+void ConstraintSimulator::load_replay_cache()
+{
+  const unsigned MAGIC = 0x4d525043;  // 'MRPC'
+
+  // attempt the load only once per simulator
+  _replay_cache_loaded = true;
+
+  if (replay_cache_file.empty())
+    return;
+  std::ifstream in(replay_cache_file.c_str(), std::ios::binary);
+  if (!in)
+    return;
+
+  // verify the header
+  unsigned magic = 0, n = 0;
+  in.read((char*) &magic, sizeof(magic));
+  in.read((char*) &n, sizeof(n));
+  if (!in || magic != MAGIC)
+  {
+    std::cerr << "ConstraintSimulator::load_replay_cache() - '" << replay_cache_file << "' is not a replay cache; ignoring it" << std::endl;
+    return;
+  }
+
+  // read the records
+  for (unsigned i=0; i< n; i++)
+  {
+    std::pair<unsigned long long, unsigned long long> key;
+    ReplayCacheEntry e;
+    in.read((char*) &key.first, sizeof(key.first));
+    in.read((char*) &key.second, sizeof(key.second));
+    in.read((char*) &e.dist, sizeof(e.dist));
+    in.read((char*) &e.pa, sizeof(e.pa));
+    in.read((char*) &e.pb, sizeof(e.pb));
+    if (!in)
+    {
+      std::cerr << "ConstraintSimulator::load_replay_cache() - '" << replay_cache_file << "' is truncated; keeping " << _replay_cache.size() << " entries" << std::endl;
+      return;
+    }
+    _replay_cache[key] = e;
+  }
+
+  FILE_LOG(LOG_COLDET) << "ConstraintSimulator::load_replay_cache() - loaded " << _replay_cache.size() << " entries from " << replay_cache_file << std::endl;
+}
+
+/// Persists the replay memo to replay_cache_file
+void ConstraintSimulator::save_replay_cache()
+{
+  const unsigned MAGIC = 0x4d525043;  // 'MRPC'
+
+  if (replay_cache_file.empty())
+    return;
+  std::ofstream out(replay_cache_file.c_str(), std::ios::binary);
+  if (!out)
+  {
+    std::cerr << "ConstraintSimulator::save_replay_cache() - unable to write '" << replay_cache_file << "'" << std::endl;
+    return;
+  }
+
+  // write the header
+  unsigned magic = MAGIC, n = (unsigned) _replay_cache.size();
+  out.write((const char*) &magic, sizeof(magic));
+  out.write((const char*) &n, sizeof(n));
+
+  // write the records
+  for (std::map<std::pair<unsigned long long, unsigned long long>, ReplayCacheEntry>::const_iterator i = _replay_cache.begin(); i != _replay_cache.end(); i++)
+  {
+    out.write((const char*) &i->first.first, sizeof(i->first.first));
+    out.write((const char*) &i->first.second, sizeof(i->first.second));
+    out.write((const char*) &i->second.dist, sizeof(i->second.dist));
+    out.write((const char*) &i->second.pa, sizeof(i->second.pa));
+    out.write((const char*) &i->second.pb, sizeof(i->second.pb));
+  }
+
+  _replay_cache_dirty = false;
+  FILE_LOG(LOG_COLDET) << "ConstraintSimulator::save_replay_cache() - wrote " << _replay_cache.size() << " entries to " << replay_cache_file << std::endl;
+}
+
 /// Computes pairwise distances of geometries at their current poses, using broad phase results to determine which pairs should be checked
 /**
  * \param pairwise_distances on return, contains the pairwise distances
+ * \param threshold a finite value lets the exact queries exit as soon as they
+ *        can certify the separation meets it; the recorded distance is then a
+ *        lower bound at or beyond the threshold rather than the exact distance
  */
-void ConstraintSimulator::calc_pairwise_distances()
+void ConstraintSimulator::calc_pairwise_distances(double threshold)
 {
-  // clear the vector
-  _pairwise_distances.clear();
+  // the fixed GJK iteration budget for the culling pass
+  const unsigned CULL_BUDGET = 4;
+
+  // resize the vector; each pair writes its own element so the signed
+  // distance queries- which are independent- may run concurrently
+  _pairwise_distances.resize(_pairs_to_check.size());
+
+  // optionally cull far pairs first: most narrow-phase queries end in early
+  // separation, and their consumers only test the distance against the
+  // contact threshold, so a certified "beyond threshold" bound suffices
+  _pair_culled.assign(_pairs_to_check.size(), 0);
+  if (gjk_batch_culling)
+  {
+    // gather the convex-convex pairs that the kernel can certify
+    _cull_gA.clear();
+    _cull_gB.clear();
+    _cull_map.clear();
+    for (unsigned i=0; i< _pairs_to_check.size(); i++)
+      if (_pairs_to_check[i].first->get_geometry()->is_convex() &&
+          _pairs_to_check[i].second->get_geometry()->is_convex())
+      {
+        _cull_gA.push_back(_pairs_to_check[i].first);
+        _cull_gB.push_back(_pairs_to_check[i].second);
+        _cull_map.push_back(i);
+      }
+
+    // run the wide culling kernel and record its certificates
+    GJK::batch_cull(_cull_gA, _cull_gB, contact_dist_thresh, CULL_BUDGET, _culled, _cull_bounds);
+    _pair_bounds.resize(_pairs_to_check.size());
+    for (unsigned k=0; k< _cull_map.size(); k++)
+      if (_culled[k])
+      {
+        _pair_culled[_cull_map[k]] = 1;
+        _pair_bounds[_cull_map[k]] = _cull_bounds[k];
+      }
+  }
 
-  for (unsigned i=0; i< _pairs_to_check.size(); i++)
+  // check the cached separating-plane certificates: a pair whose plane still
+  // certifies separation beyond the contact threshold skips the exact query;
+  // the check costs a handful of flops (the plane rides with the geometry it
+  // is fixed to, so only the other geometry's bounding sphere is tested)
+  _pair_certified.assign(_pairs_to_check.size(), 0);
+  if (separating_plane_certificates)
   {
-    PairwiseDistInfo pdi;
+    _pair_bounds.resize(_pairs_to_check.size());
+    for (unsigned i=0; i< _pairs_to_check.size(); i++)
+    {
+      // pairs already culled have a fresher certificate
+      if (_pair_culled[i])
+        continue;
+
+      // look for a valid certificate on the pair
+      map<sorted_pair<CollisionGeometryPtr>, SeparationCertificate>::iterator ci = _separation_certs.find(make_sorted_pair(_pairs_to_check[i].first, _pairs_to_check[i].second));
+      if (ci == _separation_certs.end() || !ci->second.valid)
+        continue;
+      SeparationCertificate& c = ci->second;
+
+      // get the geometry not fixed to the plane
+      CollisionGeometryPtr gb = (c.ga == _pairs_to_check[i].first) ? _pairs_to_check[i].second : _pairs_to_check[i].first;
+
+      // transform the plane to the global frame at ga's current pose
+      Vector3d n0 = Pose3d::transform_vector(GLOBAL, c.nhat);
+      Point3d p0 = Pose3d::transform_point(GLOBAL, c.point);
+
+      // test the other geometry's bounding sphere against the plane
+      Point3d cb0 = Pose3d::transform_point(GLOBAL, Point3d(0.0, 0.0, 0.0, gb->get_single_body()->get_pose()));
+      double bound = n0.dot(cb0 - p0) - c.other_radius + c.clearance;
+      if (bound >= contact_dist_thresh)
+      {
+        _pair_certified[i] = 1;
+        _pair_bounds[i] = bound;
+      }
+      else
+        c.valid = false;
+    }
+  }
+
+  // in replay memoization mode, compute the memo keys for the pairs that
+  // will reach the exact narrow phase (the memo is loaded on first use)
+  if (replay_cache_enabled)
+  {
+    if (!_replay_cache_loaded)
+      load_replay_cache();
+    _replay_keys.resize(_pairs_to_check.size());
+    for (unsigned i=0; i< _pairs_to_check.size(); i++)
+      if (!_pair_culled[i] && !_pair_certified[i])
+        _replay_keys[i] = replay_cache_key(_pairs_to_check[i].first, _pairs_to_check[i].second);
+  }
+
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (int i=0; i< (int) _pairs_to_check.size(); i++)
+  {
+    PairwiseDistInfo& pdi = _pairwise_distances[i];
     pdi.a = _pairs_to_check[i].first;
     pdi.b = _pairs_to_check[i].second;
-    pdi.dist = _coldet->calc_signed_dist(pdi.a, pdi.b, pdi.pa, pdi.pb);
-    Pose3d poseA(*pdi.a->get_pose());
-    Pose3d poseB(*pdi.b->get_pose());
-    poseA.update_relative_pose(GLOBAL);
-    poseB.update_relative_pose(GLOBAL);
-    FILE_LOG(LOG_SIMULATOR) << "ConstraintSimulator::calc_pairwise_distances() - signed distance between " << pdi.a->get_single_body()->body_id << " and " << pdi.b->get_single_body()->body_id << ": " << pdi.dist << std::endl;
-    _pairwise_distances.push_back(pdi);
+    pdi.stats.reset();
+
+    // culled pairs are certified beyond the contact threshold; report the
+    // certified lower bound and frame origins as (unused) witness points
+    if (_pair_culled[i])
+    {
+      pdi.dist = _pair_bounds[i];
+      pdi.pa = Point3d(0.0, 0.0, 0.0, pdi.a->get_pose());
+      pdi.pb = Point3d(0.0, 0.0, 0.0, pdi.b->get_pose());
+      pdi.stats.alg = PairwiseDistInfo::eAlgCulled;
+      continue;
+    }
+
+    // pairs with a valid separating-plane certificate are likewise certified
+    // beyond the contact threshold
+    if (_pair_certified[i])
+    {
+      pdi.dist = _pair_bounds[i];
+      pdi.pa = Point3d(0.0, 0.0, 0.0, pdi.a->get_pose());
+      pdi.pb = Point3d(0.0, 0.0, 0.0, pdi.b->get_pose());
+      pdi.stats.alg = PairwiseDistInfo::eAlgCertificate;
+      continue;
+    }
+
+    // serve the pair from the replay memo if its exact result was recorded
+    // at this relative pose by an earlier pass (find is read-only, so the
+    // lookup is safe under the concurrent loop)
+    if (replay_cache_enabled)
+    {
+      std::map<std::pair<unsigned long long, unsigned long long>, ReplayCacheEntry>::const_iterator ri = _replay_cache.find(_replay_keys[i]);
+      if (ri != _replay_cache.end())
+      {
+        // entries store the witnesses in id order (see the recording pass),
+        // which need not match the broad phase's pair order in this process
+        pdi.dist = ri->second.dist;
+        if (pdi.a->id <= pdi.b->id)
+        {
+          pdi.pa = Point3d(ri->second.pa, pdi.a->get_pose());
+          pdi.pb = Point3d(ri->second.pb, pdi.b->get_pose());
+        }
+        else
+        {
+          pdi.pa = Point3d(ri->second.pb, pdi.a->get_pose());
+          pdi.pb = Point3d(ri->second.pa, pdi.b->get_pose());
+        }
+        pdi.stats.alg = PairwiseDistInfo::eAlgReplay;
+        continue;
+      }
+    }
+
+    // time the query only when the statistics will be consumed
+    if (record_narrow_phase_stats)
+    {
+      double start = wallclock_time();
+      pdi.dist = _coldet->calc_signed_dist(pdi.a, pdi.b, pdi.pa, pdi.pb, pdi.stats, threshold);
+      pdi.stats.query_time = wallclock_time() - start;
+    }
+    else
+      pdi.dist = _coldet->calc_signed_dist(pdi.a, pdi.b, pdi.pa, pdi.pb, pdi.stats, threshold);
   }
+
+  // record fresh exact results in the replay memo for subsequent passes;
+  // the witness points are stored in their geometries' frames so an entry
+  // can be reattached wherever the pair sits in the world on replay
+  if (replay_cache_enabled)
+    for (unsigned i=0; i< _pairwise_distances.size(); i++)
+    {
+      const PairwiseDistInfo& pdi = _pairwise_distances[i];
+      if (_pair_culled[i] || _pair_certified[i] ||
+          pdi.stats.alg == PairwiseDistInfo::eAlgReplay)
+        continue;
+      ReplayCacheEntry& e = _replay_cache[_replay_keys[i]];
+      e.dist = pdi.dist;
+      if (pdi.a->id <= pdi.b->id)
+      {
+        e.pa = Pose3d::transform_point(pdi.a->get_pose(), pdi.pa).o;
+        e.pb = Pose3d::transform_point(pdi.b->get_pose(), pdi.pb).o;
+      }
+      else
+      {
+        e.pa = Pose3d::transform_point(pdi.b->get_pose(), pdi.pb).o;
+        e.pb = Pose3d::transform_point(pdi.a->get_pose(), pdi.pa).o;
+      }
+      _replay_cache_dirty = true;
+    }
+
+  // refresh the separating-plane certificates from the fresh exact results;
+  // the queries above run concurrently, so the cache is updated serially here
+  if (separating_plane_certificates)
+    for (unsigned i=0; i< _pairwise_distances.size(); i++)
+    {
+      // pairs resolved by a certificate produced no fresh witnesses
+      if (_pair_culled[i] || _pair_certified[i])
+        continue;
+
+      // certificates require the supporting-plane property of convex shapes
+      const PairwiseDistInfo& pdi = _pairwise_distances[i];
+      if (!pdi.a->get_geometry()->is_convex() || !pdi.b->get_geometry()->is_convex())
+        continue;
+
+      // a separated pair with exact witnesses (a distance at the threshold
+      // may be a truncated lower bound with meaningless witnesses) caches
+      // the plane orthogonal to the witness segment at its midpoint
+      if (pdi.dist > contact_dist_thresh && pdi.dist < threshold)
+      {
+        // get the witness points and the plane in the global frame
+        Point3d pa0 = Pose3d::transform_point(GLOBAL, pdi.pa);
+        Point3d pb0 = Pose3d::transform_point(GLOBAL, pdi.pb);
+        Vector3d n0 = pb0 - pa0;
+        double nrm = n0.norm();
+        if (nrm < NEAR_ZERO)
+          continue;
+        n0 /= nrm;
+        Point3d m0 = pa0 + (pb0 - pa0)*0.5;
+
+        // store the plane in the first geometry's frame with the witness
+        // clearance on its side; the other geometry is validated by its
+        // bounding sphere about the body frame
+        SeparationCertificate& c = _separation_certs[make_sorted_pair(pdi.a, pdi.b)];
+        c.valid = true;
+        c.ga = pdi.a;
+        c.nhat = Pose3d::transform_vector(pdi.a->get_pose(), n0);
+        c.point = Pose3d::transform_point(pdi.a->get_pose(), m0);
+        c.clearance = nrm*0.5;
+        c.other_radius = pdi.b->get_farthest_point_distance();
+      }
+      else
+      {
+        // the pair is near contact; drop any stale certificate
+        map<sorted_pair<CollisionGeometryPtr>, SeparationCertificate>::iterator ci = _separation_certs.find(make_sorted_pair(pdi.a, pdi.b));
+        if (ci != _separation_certs.end())
+          ci->second.valid = false;
+      }
+    }
+
+  // fold the per-pair statistics into the aggregation window
+  if (record_narrow_phase_stats)
+    for (unsigned i=0; i< _pairwise_distances.size(); i++)
+    {
+      const PairwiseDistInfo& pdi = _pairwise_distances[i];
+      PairCostRecord& rec = _pair_costs[make_sorted_pair(pdi.a, pdi.b)];
+      rec.a = pdi.a;
+      rec.b = pdi.b;
+      rec.total_time += pdi.stats.query_time;
+      rec.queries++;
+      rec.iterations += pdi.stats.iterations;
+      rec.kernel_hits += pdi.stats.kernel_hits;
+      rec.kernel_misses += pdi.stats.kernel_misses;
+      if (pdi.stats.alg == PairwiseDistInfo::eAlgCulled)
+        rec.culled++;
+      if (pdi.stats.alg == PairwiseDistInfo::eAlgCertificate)
+        rec.certified++;
+    }
+
+  // do logging serially so the output is not interleaved
+  if (LOGGING(LOG_SIMULATOR))
+    for (unsigned i=0; i< _pairwise_distances.size(); i++)
+    {
+      const PairwiseDistInfo& pdi = _pairwise_distances[i];
+      FILE_LOG(LOG_SIMULATOR) << "ConstraintSimulator::calc_pairwise_distances() - signed distance between " << pdi.a->get_single_body()->body_id << " and " << pdi.b->get_single_body()->body_id << ": " << pdi.dist << std::endl;
+    }
 }
 
 /// Does broad phase collision detection, identifying which pairs of geometries may come into contact over time step of dt
@@ -482,6 +1440,410 @@ void ConstraintSimulator::broad_phase(double dt)
     }
     else
       i++;
+
+  // remove pairs in which both bodies sleep; neither body moves, so the
+  // pair cannot generate a new contact (pairs with one awake body remain
+  // checked so that the awake body can wake the sleeping one on contact)
+  if (sleeping_enabled)
+    for (unsigned i=0; i< _pairs_to_check.size(); )
+    {
+      shared_ptr<DynamicBodyd> sba = _pairs_to_check[i].first->get_single_body()->get_super_body();
+      shared_ptr<DynamicBodyd> sbb = _pairs_to_check[i].second->get_single_body()->get_super_body();
+      if (body_is_asleep(sba) && body_is_asleep(sbb))
+      {
+        _pairs_to_check[i] = _pairs_to_check.back();
+        _pairs_to_check.pop_back();
+      }
+      else
+        i++;
+    }
+}
+
+/// Puts every rigid body within a dynamic body to sleep
+static void sleep_dynamic_body(shared_ptr<DynamicBodyd> db)
+{
+  // rigid body case
+  shared_ptr<RigidBody> rb = dynamic_pointer_cast<RigidBody>(db);
+  if (rb)
+  {
+    rb->put_to_sleep();
+    return;
+  }
+
+  // articulated body case: sleep every link
+  shared_ptr<ArticulatedBody> ab = dynamic_pointer_cast<ArticulatedBody>(db);
+  if (ab)
+  {
+    const vector<shared_ptr<RigidBodyd> >& links = ab->get_links();
+    for (unsigned i=0; i< links.size(); i++)
+    {
+      shared_ptr<RigidBody> link = dynamic_pointer_cast<RigidBody>(links[i]);
+      if (link)
+        link->put_to_sleep();
+    }
+  }
+}
+
+/// Gets the global position of a rigid body's frame origin
+static Point3d body_origin(shared_ptr<RigidBodyd> rb)
+{
+  return Pose3d::transform_point(GLOBAL, Point3d(0.0, 0.0, 0.0, rb->get_pose()));
+}
+
+/// Computes the signed distance from a body to the nearest region-of-interest boundary
+/**
+ * Negative inside a region; an articulated body uses its nearest link, so
+ * a long mechanism reaching into a region counts as inside.
+ */
+static double calc_roi_dist(shared_ptr<DynamicBodyd> db, const vector<Point3d>& centers, const vector<double>& radii)
+{
+  double min_dist = std::numeric_limits<double>::max();
+
+  // rigid body case
+  shared_ptr<RigidBodyd> rb = dynamic_pointer_cast<RigidBodyd>(db);
+  if (rb)
+  {
+    const Point3d x = body_origin(rb);
+    for (unsigned i=0; i< centers.size(); i++)
+      min_dist = std::min(min_dist, (x - centers[i]).norm() - radii[i]);
+    return min_dist;
+  }
+
+  // articulated body case
+  shared_ptr<ArticulatedBody> ab = dynamic_pointer_cast<ArticulatedBody>(db);
+  if (ab)
+  {
+    const vector<shared_ptr<RigidBodyd> >& links = ab->get_links();
+    for (unsigned j=0; j< links.size(); j++)
+    {
+      const Point3d x = body_origin(links[j]);
+      for (unsigned i=0; i< centers.size(); i++)
+        min_dist = std::min(min_dist, (x - centers[i]).norm() - radii[i]);
+    }
+  }
+
+  return min_dist;
+}
+
+/// Freezes bodies outside every region of interest; promotes approached ones
+/**
+ * Bodies farther than roi_promotion_dist outside every region are
+ * deactivated through the sleep machinery, and bodies frozen here are woken
+ * once a region comes within that distance again.  Bodies slept by the
+ * velocity-based sleep test are deliberately not woken by an approaching
+ * region- they are at rest inside the fidelity bubble, not culled.  A
+ * contact chain reaching a frozen body wakes it through the usual contact
+ * wake in find_unilateral_constraints(); re-freezing happens only here,
+ * after constraint handling, so such a body is simulated on every step the
+ * chain persists.
+ */
+void ConstraintSimulator::update_roi_states()
+{
+  // region-of-interest culling deactivates bodies through the sleep
+  // machinery, so it requires sleeping to be enabled
+  if (!roi_enabled || !sleeping_enabled || roi_volumes.empty())
+    return;
+
+  // resolve the current region centers (anchored regions follow their bodies)
+  vector<Point3d> centers(roi_volumes.size());
+  vector<double> radii(roi_volumes.size());
+  for (unsigned i=0; i< roi_volumes.size(); i++)
+  {
+    const RegionOfInterest& roi = roi_volumes[i];
+    radii[i] = roi.radius;
+    if (roi.anchor)
+    {
+      shared_ptr<RigidBodyd> rb = dynamic_pointer_cast<RigidBodyd>(roi.anchor);
+      shared_ptr<ArticulatedBody> ab = dynamic_pointer_cast<ArticulatedBody>(roi.anchor);
+      if (ab)
+        rb = ab->get_base_link();
+      centers[i] = body_origin(rb);
+    }
+    else
+      centers[i] = roi.center;
+  }
+
+  BOOST_FOREACH(ControlledBodyPtr cb, _bodies)
+  {
+    // bodies with controllers are active by definition and never freeze
+    if (cb->controller || cb->batch_controller)
+      continue;
+
+    // disabled bodies are not simulated in the first place
+    shared_ptr<RigidBody> rb = dynamic_pointer_cast<RigidBody>(cb);
+    if (rb && !rb->is_enabled())
+      continue;
+
+    // get the signed distance to the nearest region boundary
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(cb);
+    const double dist = calc_roi_dist(db, centers, radii);
+
+    if (dist > roi_promotion_dist)
+    {
+      // far from every region: freeze the body if it is still active (the
+      // velocity it carries is preserved and resumes on promotion)
+      if (!body_is_asleep(db))
+      {
+        sleep_dynamic_body(db);
+        _roi_frozen.insert(db);
+        FILE_LOG(LOG_SIMULATOR) << "ConstraintSimulator::update_roi_states() - froze far-field body " << cb->id << std::endl;
+      }
+    }
+    else if (_roi_frozen.find(db) != _roi_frozen.end())
+    {
+      // a region has approached a body frozen here; promote it back
+      wake_body(db);
+      _roi_frozen.erase(db);
+      FILE_LOG(LOG_SIMULATOR) << "ConstraintSimulator::update_roi_states() - promoted body " << cb->id << " to full simulation" << std::endl;
+    }
+  }
+}
+
+/// Updates per-body sleep timers and puts islands of resting bodies to sleep
+/**
+ * Bodies sleep an island at a time: bodies coupled by contact (pairwise
+ * distance below contact_dist_thresh) or by implicit joints form an island,
+ * and the island is put to sleep only when every body in it has remained
+ * below its velocity thresholds for its sleep time window. Islands put to
+ * sleep here are recorded so that waking any member (e.g., via a new
+ * contact or an applied force) wakes the entire island.
+ *
+ * \param h the length of the step just taken
+ */
+void ConstraintSimulator::update_sleep_states(double h)
+{
+  // update the sleep timer on every awake body, recording sleep readiness;
+  // disabled bodies do not participate (they neither sleep nor couple
+  // islands- otherwise the ground would merge every resting body into one)
+  map<shared_ptr<DynamicBodyd>, bool> ready;
+  for (unsigned i=0; i< _bodies.size(); i++)
+  {
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+
+    // sleeping bodies' timers are frozen; they stay asleep until woken
+    if (body_is_asleep(db))
+      continue;
+
+    // rigid body case
+    shared_ptr<RigidBody> rb = dynamic_pointer_cast<RigidBody>(db);
+    if (rb)
+    {
+      if (!rb->is_enabled())
+        continue;
+      ready[db] = rb->update_sleep_timer(h);
+      continue;
+    }
+
+    // articulated body case: ready only if every link is ready
+    shared_ptr<ArticulatedBody> ab = dynamic_pointer_cast<ArticulatedBody>(db);
+    if (!ab)
+      continue;
+    bool all_ready = true;
+    const vector<shared_ptr<RigidBodyd> >& links = ab->get_links();
+    for (unsigned j=0; j< links.size(); j++)
+    {
+      shared_ptr<RigidBody> link = dynamic_pointer_cast<RigidBody>(links[j]);
+      if (link && !link->update_sleep_timer(h))
+        all_ready = false;
+    }
+    ready[db] = all_ready;
+  }
+
+  // build the contact adjacency between awake bodies
+  multimap<shared_ptr<DynamicBodyd>, shared_ptr<DynamicBodyd> > edges;
+  BOOST_FOREACH(const PairwiseDistInfo& pdi, _pairwise_distances)
+  {
+    // pairs held in contact by hysteresis couple their islands too, so the
+    // island structure tracks the active constraint set (see
+    // find_unilateral_constraints())
+    if (pdi.dist >= contact_dist_thresh &&
+        (contact_hysteresis <= 0.0 ||
+         _active_pairs.find(make_sorted_pair(pdi.a, pdi.b)) == _active_pairs.end()))
+      continue;
+    shared_ptr<DynamicBodyd> sba = pdi.a->get_single_body()->get_super_body();
+    shared_ptr<DynamicBodyd> sbb = pdi.b->get_single_body()->get_super_body();
+    if (ready.find(sba) == ready.end() || ready.find(sbb) == ready.end())
+      continue;
+    edges.insert(make_pair(sba, sbb));
+    edges.insert(make_pair(sbb, sba));
+  }
+
+  // implicit joints couple bodies into a common island too
+  for (unsigned i=0; i< implicit_joints.size(); i++)
+  {
+    shared_ptr<DynamicBodyd> sba = implicit_joints[i]->get_inboard_link()->get_super_body();
+    shared_ptr<DynamicBodyd> sbb = implicit_joints[i]->get_outboard_link()->get_super_body();
+    if (ready.find(sba) == ready.end() || ready.find(sbb) == ready.end())
+      continue;
+    edges.insert(make_pair(sba, sbb));
+    edges.insert(make_pair(sbb, sba));
+  }
+
+  // find the islands among the awake bodies; sleep those uniformly ready
+  set<shared_ptr<DynamicBodyd> > nodes;
+  for (map<shared_ptr<DynamicBodyd>, bool>::const_iterator ri = ready.begin(); ri != ready.end(); ri++)
+    nodes.insert(ri->first);
+  while (!nodes.empty())
+  {
+    // expand an island from an arbitrary remaining node
+    vector<shared_ptr<DynamicBodyd> > island;
+    island.push_back(*nodes.begin());
+    nodes.erase(nodes.begin());
+    for (unsigned i=0; i< island.size(); i++)
+    {
+      typedef multimap<shared_ptr<DynamicBodyd>, shared_ptr<DynamicBodyd> >::const_iterator EdgeIter;
+      pair<EdgeIter, EdgeIter> range = edges.equal_range(island[i]);
+      for (EdgeIter ei = range.first; ei != range.second; ei++)
+        if (nodes.erase(ei->second) > 0)
+          island.push_back(ei->second);
+    }
+
+    // the island sleeps only if every body in it is ready to sleep
+    bool all_ready = true;
+    for (unsigned i=0; i< island.size(); i++)
+      if (!ready[island[i]])
+      {
+        all_ready = false;
+        break;
+      }
+    if (!all_ready)
+      continue;
+
+    // put the island to sleep as a unit and record it for waking
+    for (unsigned i=0; i< island.size(); i++)
+      sleep_dynamic_body(island[i]);
+    _sleeping_islands.push_back(island);
+    FILE_LOG(LOG_SIMULATOR) << "ConstraintSimulator::update_sleep_states() - put an island of " << island.size() << " bodies to sleep" << std::endl;
+  }
+}
+
+/// Computes a combined translational/rotational drift measure between two relative poses
+static double calc_rel_pose_drift(const Transform3d& T0, const Transform3d& T1)
+{
+  // translational component
+  double drift = Origin3d(T1.x - T0.x).norm();
+
+  // rotational component (angle between the two orientations)
+  double dot = T0.q.w*T1.q.w + T0.q.x*T1.q.x + T0.q.y*T1.q.y + T0.q.z*T1.q.z;
+  drift += 2.0*std::acos(std::min(1.0, std::fabs(dot)));
+
+  return drift;
+}
+
+// returns the selection-score multiplier for a candidate contact point:
+// candidates near a point kept on the previous step get a slight boost so
+// the reduced manifold does not churn between steps while a pair rests
+static double persistence_bias(const Point3d& p, const std::vector<Point3d>& prev, double tol)
+{
+  const double PERSIST_BIAS = 1.1;
+
+  for (unsigned i=0; i< prev.size(); i++)
+    if ((Origin3d(p) - Origin3d(prev[i])).norm() < tol)
+      return PERSIST_BIAS;
+  return 1.0;
+}
+
+/// Reduces one pair's freshly computed contact manifold to at most max_manifold_points points
+/**
+ * Keeps the deepest point unconditionally, then greedily adds the point
+ * maximizing the spanned manifold area: the second point maximizes distance
+ * from the first, the third maximizes distance from the line through the
+ * first two (the triangle area), and further points maximize the minimum
+ * distance to the points already kept.  Scores carry a persistence bias
+ * (see persistence_bias()) so near-equivalent candidates resolve to the
+ * previous step's selection.
+ * \param constraints the constraint vector; [first, end) holds this pair's contacts
+ * \param first the index of the pair's first contact in the vector
+ */
+void ConstraintSimulator::reduce_contact_manifold(vector<UnilateralConstraint>& constraints, unsigned first, CollisionGeometryPtr gA, CollisionGeometryPtr gB)
+{
+  const unsigned n = constraints.size() - first;
+  if (max_manifold_points == 0 || n <= max_manifold_points)
+    return;
+
+  // get the points kept for this pair on the previous step
+  std::vector<Point3d>& prev = _kept_manifold_points[make_sorted_pair(gA, gB)];
+
+  // find the deepest point (most negative signed violation); it resolves the
+  // worst interpenetration and is always kept
+  unsigned deepest = 0;
+  for (unsigned i=1; i< n; i++)
+    if (constraints[first+i].signed_violation < constraints[first+deepest].signed_violation)
+      deepest = i;
+
+  // the persistence tolerance scales with the manifold's extent
+  double extent = 0.0;
+  const Origin3d anchor(constraints[first+deepest].contact_point);
+  for (unsigned i=0; i< n; i++)
+    extent = std::max(extent, (Origin3d(constraints[first+i].contact_point) - anchor).norm());
+  const double PERSIST_TOL = 0.1*extent;
+
+  // select greedily
+  std::vector<bool> kept(n, false);
+  std::vector<unsigned> sel;
+  kept[deepest] = true;
+  sel.push_back(deepest);
+  while (sel.size() < max_manifold_points)
+  {
+    unsigned best = std::numeric_limits<unsigned>::max();
+    double best_score = 0.0;
+    for (unsigned i=0; i< n; i++)
+    {
+      if (kept[i])
+        continue;
+      const Origin3d p(constraints[first+i].contact_point);
+
+      // score the candidate by the area it adds
+      double score;
+      if (sel.size() == 1)
+        // second point: distance from the deepest point
+        score = (p - anchor).norm();
+      else if (sel.size() == 2)
+      {
+        // third point: distance from the line through the first two
+        // (proportional to the triangle area)
+        const Origin3d q(constraints[first+sel[0]].contact_point);
+        Origin3d dir = Origin3d(constraints[first+sel[1]].contact_point) - q;
+        double dir_len = dir.norm();
+        if (dir_len > NEAR_ZERO)
+          score = Origin3d::cross(dir/dir_len, p - q).norm();
+        else
+          score = (p - q).norm();
+      }
+      else
+      {
+        // further points: minimum distance to the points already kept
+        score = std::numeric_limits<double>::max();
+        for (unsigned j=0; j< sel.size(); j++)
+          score = std::min(score, (p - Origin3d(constraints[first+sel[j]].contact_point)).norm());
+      }
+
+      // bias toward last step's selection and track the best candidate
+      score *= persistence_bias(constraints[first+i].contact_point, prev, PERSIST_TOL);
+      if (best == std::numeric_limits<unsigned>::max() || score > best_score)
+      {
+        best = i;
+        best_score = score;
+      }
+    }
+    kept[best] = true;
+    sel.push_back(best);
+  }
+
+  // compact the kept constraints into [first, first + max_manifold_points),
+  // preserving their original order
+  std::sort(sel.begin(), sel.end());
+  for (unsigned i=0; i< sel.size(); i++)
+    if (sel[i] != i)
+      constraints[first+i] = constraints[first+sel[i]];
+  constraints.erase(constraints.begin()+first+sel.size(), constraints.end());
+
+  // record the kept points for the next step's persistence bias
+  prev.resize(sel.size());
+  for (unsigned i=0; i< sel.size(); i++)
+    prev[i] = constraints[first+i].contact_point;
+
+  FILE_LOG(LOG_SIMULATOR) << "ConstraintSimulator::reduce_contact_manifold() - reduced " << n << " contacts to " << sel.size() << std::endl;
 }
 
 /// Finds the set of unilateral constraints
@@ -501,23 +1863,111 @@ void ConstraintSimulator::find_unilateral_constraints(double contact_dist_thresh
     if (!ab)
       continue;
 
+    // sleeping bodies' joints are not moving; no limit can become active
+    if (sleeping_enabled && body_is_asleep(ab))
+      continue;
+
+    // skip the scan while the body's conservative time-to-limit bound holds
+    if (!ab->joint_limit_check_due(current_time))
+      continue;
+
      // get limit constraints
+    unsigned nrigid = _rigid_constraints.size();
     ab->find_limit_constraints(std::back_inserter(_rigid_constraints));
+
+    // no DOF is at a limit; bound the time before the next scan is necessary
+    if (_rigid_constraints.size() == nrigid)
+      ab->schedule_next_joint_limit_check(current_time);
   }
 
+  // the threshold handed to the narrow phase; when hysteresis is on, the
+  // band is included so that a held-over pair still yields contact points
+  const double NP_DIST_THRESH = contact_dist_thresh + contact_hysteresis;
+
   // find contact constraints
   BOOST_FOREACH(const PairwiseDistInfo& pdi, _pairwise_distances)
-    if (pdi.dist < contact_dist_thresh)
+  {
+    // a pair becomes active when its distance drops below the contact
+    // threshold, but- with hysteresis enabled- stays active until it
+    // separates past the threshold plus the band; marginal contacts whose
+    // distance oscillates about the threshold otherwise flicker in and out
+    // of the active set, re-forming islands and discarding solver warm
+    // starts on every step
+    bool active = (pdi.dist < contact_dist_thresh);
+    if (contact_hysteresis > 0.0)
+    {
+      const sorted_pair<CollisionGeometryPtr> sp = make_sorted_pair(pdi.a, pdi.b);
+      if (!active && _active_pairs.find(sp) != _active_pairs.end())
+        active = (pdi.dist < NP_DIST_THRESH);
+      if (active)
+        _active_pairs.insert(sp);
+      else
+        _active_pairs.erase(sp);
+    }
+    if (active)
     {
+      // a new contact wakes any sleeping participant (the broad phase
+      // filter guarantees at least one body in the pair is awake)
+      if (sleeping_enabled)
+      {
+        shared_ptr<DynamicBodyd> sba = pdi.a->get_single_body()->get_super_body();
+        shared_ptr<DynamicBodyd> sbb = pdi.b->get_single_body()->get_super_body();
+        if (body_is_asleep(sba))
+          wake_body(sba);
+        if (body_is_asleep(sbb))
+          wake_body(sbb);
+      }
+
       // see whether one of the bodies is compliant
       RigidBodyPtr rba = dynamic_pointer_cast<RigidBody>(pdi.a->get_single_body());
       RigidBodyPtr rbb = dynamic_pointer_cast<RigidBody>(pdi.b->get_single_body());
       if (rba->compliance == RigidBody::eCompliant || 
           rbb->compliance == RigidBody::eCompliant)
         _coldet->find_contacts(pdi.a, pdi.b, _compliant_constraints);
-      else        
-        _coldet->find_contacts(pdi.a, pdi.b, _rigid_constraints, contact_dist_thresh);
+      else
+      {
+        // compute the relative pose of the pair for coherence testing
+        Transform3d aTb = Pose3d::calc_relative_pose(pdi.b->get_pose(), pdi.a->get_pose());
+
+        // see whether a sufficiently fresh manifold is cached for this pair
+        map<sorted_pair<CollisionGeometryPtr>, ManifoldCacheEntry>::iterator mci = _manifold_cache.end();
+        if (manifold_reuse_tol > 0.0)
+          mci = _manifold_cache.find(make_sorted_pair(pdi.a, pdi.b));
+        if (mci != _manifold_cache.end() && calc_rel_pose_drift(mci->second.aTb, aTb) < manifold_reuse_tol)
+        {
+          // the pair has barely moved; reuse the cached contact points,
+          // refreshing only the signed violations
+          for (unsigned j=0; j< mci->second.contacts.size(); j++)
+          {
+            _rigid_constraints.push_back(mci->second.contacts[j]);
+            _rigid_constraints.back().signed_violation = pdi.dist;
+          }
+        }
+        else
+        {
+          // run the narrow phase and capture the manifold for future steps
+          const unsigned FIRST = _rigid_constraints.size();
+          _coldet->find_contacts(pdi.a, pdi.b, _rigid_constraints, NP_DIST_THRESH);
+
+          // reduce the manifold before it reaches the solvers (and before it
+          // is cached, so reuse replays the reduced manifold)
+          if (max_manifold_points > 0)
+            reduce_contact_manifold(_rigid_constraints, FIRST, pdi.a, pdi.b);
+          if (manifold_reuse_tol > 0.0)
+          {
+            ManifoldCacheEntry& entry = _manifold_cache[make_sorted_pair(pdi.a, pdi.b)];
+            entry.aTb = aTb;
+            entry.contacts.assign(_rigid_constraints.begin()+FIRST, _rigid_constraints.end());
+          }
+        }
+      }
     }
+  }
+
+  // merge the freshest completed result from the asynchronous detector, if
+  // one is installed, and hand it the current poses for its next query
+  consume_async_detection();
+  post_async_detection_job();
 
   // set constraints to proper type
   for (unsigned i=0; i< _compliant_constraints.size(); i++)
@@ -571,6 +2021,17 @@ void ConstraintSimulator::load_from_xml(shared_ptr<const XMLTree> node, map<std:
     _coldet->set_simulator(shared_this);
   }
 
+  // read the asynchronous collision detection plugin, if any
+  XMLAttrib* async_coldet_attrib = node->get_attrib("async-collision-detection-plugin");
+  if (async_coldet_attrib)
+  {
+    const std::string async_coldet_id = async_coldet_attrib->get_string_value();
+    shared_ptr<CollisionDetection> async_coldet = dynamic_pointer_cast<CollisionDetection>(id_map[async_coldet_id]);
+    if (!async_coldet)
+      throw std::runtime_error("Unable to load asynchronous collision detection plugin");
+    set_async_collision_detection(async_coldet);
+  }
+
   // read the unilateral constraint stabilization tolerance, if any
   XMLAttrib* unilateral_cstab_tol_attrib = node->get_attrib("unilateral-stabilization-tol");
   if (unilateral_cstab_tol_attrib)
@@ -586,11 +2047,114 @@ void ConstraintSimulator::load_from_xml(shared_ptr<const XMLTree> node, map<std:
   if (cstab_max_iter_attrib)
     cstab.max_iterations = cstab_max_iter_attrib->get_unsigned_value();
 
+  // read the constraint stabilization stagnation tolerance, if any
+  XMLAttrib* cstab_stag_tol_attrib = node->get_attrib("stabilization-stagnation-tol");
+  if (cstab_stag_tol_attrib)
+    cstab.stagnation_tol = cstab_stag_tol_attrib->get_real_value();
+
   // read the contact distance threshold, if any
   XMLAttrib* contact_dist_thresh_attrib = node->get_attrib("contact-dist-thresh");
   if (contact_dist_thresh_attrib)
     contact_dist_thresh = contact_dist_thresh_attrib->get_real_value();
 
+  // read the contact hysteresis band, if any
+  XMLAttrib* contact_hysteresis_attrib = node->get_attrib("contact-hysteresis");
+  if (contact_hysteresis_attrib)
+    contact_hysteresis = contact_hysteresis_attrib->get_real_value();
+
+  // read the manifold reuse tolerance, if any
+  XMLAttrib* manifold_reuse_tol_attrib = node->get_attrib("manifold-reuse-tol");
+  if (manifold_reuse_tol_attrib)
+    manifold_reuse_tol = manifold_reuse_tol_attrib->get_real_value();
+
+  // read the maximum number of contact points kept per pair, if any
+  XMLAttrib* max_manifold_attrib = node->get_attrib("max-manifold-points");
+  if (max_manifold_attrib)
+    max_manifold_points = max_manifold_attrib->get_unsigned_value();
+
+  // see whether far pairs are culled with the batch GJK pass
+  XMLAttrib* gjk_cull_attrib = node->get_attrib("gjk-batch-culling");
+  if (gjk_cull_attrib)
+    gjk_batch_culling = gjk_cull_attrib->get_bool_value();
+
+  // see whether per-pair narrow-phase statistics are recorded
+  XMLAttrib* np_stats_attrib = node->get_attrib("record-narrow-phase-stats");
+  if (np_stats_attrib)
+    record_narrow_phase_stats = np_stats_attrib->get_bool_value();
+
+  // read the replay memoization settings, if provided
+  XMLAttrib* replay_cache_attrib = node->get_attrib("replay-cache-enabled");
+  if (replay_cache_attrib)
+    replay_cache_enabled = replay_cache_attrib->get_bool_value();
+  XMLAttrib* replay_cache_file_attrib = node->get_attrib("replay-cache-file");
+  if (replay_cache_file_attrib)
+    replay_cache_file = replay_cache_file_attrib->get_string_value();
+
+  // see whether the broad phase is pipelined onto a worker thread
+  XMLAttrib* async_bp_attrib = node->get_attrib("async-broad-phase");
+  if (async_bp_attrib)
+    async_broad_phase = async_bp_attrib->get_bool_value();
+
+  // read whether to use the projected Gauss-Seidel impact solver, if specified
+  XMLAttrib* use_pgs_attrib = node->get_attrib("use-pgs-solver");
+  if (use_pgs_attrib)
+    _impact_constraint_handler.use_pgs_solver = use_pgs_attrib->get_bool_value();
+
+  // read the maximum number of projected Gauss-Seidel sweeps, if any
+  XMLAttrib* pgs_max_iter_attrib = node->get_attrib("pgs-max-iterations");
+  if (pgs_max_iter_attrib)
+    _impact_constraint_handler.pgs_max_iterations = pgs_max_iter_attrib->get_unsigned_value();
+
+  // read the projected Gauss-Seidel convergence tolerance, if any
+  XMLAttrib* pgs_tol_attrib = node->get_attrib("pgs-tolerance");
+  if (pgs_tol_attrib)
+    _impact_constraint_handler.pgs_tolerance = pgs_tol_attrib->get_real_value();
+
+  // read whether to use the cone-complementarity impact solver, if specified
+  XMLAttrib* use_ccp_attrib = node->get_attrib("use-ccp-solver");
+  if (use_ccp_attrib)
+    _impact_constraint_handler.use_ccp_solver = use_ccp_attrib->get_bool_value();
+
+  // read the maximum number of cone-complementarity sweeps, if any
+  XMLAttrib* ccp_max_iter_attrib = node->get_attrib("ccp-max-iterations");
+  if (ccp_max_iter_attrib)
+    _impact_constraint_handler.ccp_max_iterations = ccp_max_iter_attrib->get_unsigned_value();
+
+  // read the cone-complementarity convergence tolerance, if any
+  XMLAttrib* ccp_tol_attrib = node->get_attrib("ccp-tolerance");
+  if (ccp_tol_attrib)
+    _impact_constraint_handler.ccp_tolerance = ccp_tol_attrib->get_real_value();
+
+  // get whether the solver is selected per island by problem size
+  XMLAttrib* auto_select_attrib = node->get_attrib("auto-solver-selection");
+  if (auto_select_attrib)
+    _impact_constraint_handler.auto_solver_selection = auto_select_attrib->get_bool_value();
+
+  // get the island size at which automatic selection switches to PGS
+  XMLAttrib* auto_pgs_attrib = node->get_attrib("auto-pgs-contact-threshold");
+  if (auto_pgs_attrib)
+    _impact_constraint_handler.auto_pgs_contact_threshold = auto_pgs_attrib->get_unsigned_value();
+
+  // get whether solver tolerances relax on negligible-energy islands
+  XMLAttrib* adaptive_tol_attrib = node->get_attrib("adaptive-tolerance");
+  if (adaptive_tol_attrib)
+    _impact_constraint_handler.adaptive_tolerance = adaptive_tol_attrib->get_bool_value();
+
+  // get the island kinetic energy below which tolerances relax
+  XMLAttrib* adaptive_ke_attrib = node->get_attrib("adaptive-ke-threshold");
+  if (adaptive_ke_attrib)
+    _impact_constraint_handler.adaptive_ke_threshold = adaptive_ke_attrib->get_real_value();
+
+  // get the constraint speed below which tolerances relax
+  XMLAttrib* adaptive_vel_attrib = node->get_attrib("adaptive-velocity-threshold");
+  if (adaptive_vel_attrib)
+    _impact_constraint_handler.adaptive_velocity_threshold = adaptive_vel_attrib->get_real_value();
+
+  // get the factor applied to tolerances on negligible-energy islands
+  XMLAttrib* adaptive_scale_attrib = node->get_attrib("adaptive-tolerance-scale");
+  if (adaptive_scale_attrib)
+    _impact_constraint_handler.adaptive_tolerance_scale = adaptive_scale_attrib->get_real_value();
+
   // read in any ContactParameters
   child_nodes = node->find_child_nodes("ContactParameters");
   if (!child_nodes.empty())
@@ -602,6 +2166,78 @@ void ConstraintSimulator::load_from_xml(shared_ptr<const XMLTree> node, map<std:
     contact_params[cd->objects] = cd;
   }
 
+  // read in any material pair parameters
+  child_nodes = node->find_child_nodes("MaterialPair");
+  for (list<shared_ptr<const XMLTree> >::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  {
+    // get the two material id attributes
+    XMLAttrib* m1_attrib = (*i)->get_attrib("material1");
+    XMLAttrib* m2_attrib = (*i)->get_attrib("material2");
+
+    // make sure that they were read
+    if (!m1_attrib || !m2_attrib)
+    {
+      std::cerr << "ConstraintSimulator::load_from_xml() - did not find ";
+      std::cerr << "material1 and/or material2" << std::endl;
+      std::cerr << "  in offending node: " << std::endl << *node;
+      continue;
+    }
+
+    // read the coefficients and store the entry in the table
+    boost::shared_ptr<ContactParameters> cp(new ContactParameters);
+    cp->load_coefficients_from_xml(*i);
+    set_material_params(m1_attrib->get_unsigned_value(), m2_attrib->get_unsigned_value(), cp);
+  }
+
+  // read whether region-of-interest culling is enabled, and its promotion distance
+  XMLAttrib* roi_enabled_attrib = node->get_attrib("roi-enabled");
+  if (roi_enabled_attrib)
+    roi_enabled = roi_enabled_attrib->get_bool_value();
+  XMLAttrib* roi_promote_attrib = node->get_attrib("roi-promotion-dist");
+  if (roi_promote_attrib)
+    roi_promotion_dist = roi_promote_attrib->get_real_value();
+
+  // read in any regions of interest
+  child_nodes = node->find_child_nodes("RegionOfInterest");
+  if (!child_nodes.empty())
+    roi_volumes.clear();
+  for (list<shared_ptr<const XMLTree> >::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  {
+    RegionOfInterest roi;
+
+    // every region needs a radius
+    XMLAttrib* radius_attrib = (*i)->get_attrib("radius");
+    if (!radius_attrib)
+    {
+      std::cerr << "ConstraintSimulator::load_from_xml() - did not find ";
+      std::cerr << "radius in offending node: " << std::endl << *node;
+      continue;
+    }
+    roi.radius = radius_attrib->get_real_value();
+
+    // an anchored region follows its body; otherwise a fixed center is used
+    XMLAttrib* anchor_attrib = (*i)->get_attrib("anchor-id");
+    if (anchor_attrib)
+    {
+      const std::string& anchor_id = anchor_attrib->get_string_value();
+      if ((id_iter = id_map.find(anchor_id)) == id_map.end())
+      {
+        std::cerr << "ConstraintSimulator::load_from_xml() - anchor-id '";
+        std::cerr << anchor_id << "' not found in offending node: " << std::endl << *node;
+        continue;
+      }
+      roi.anchor = dynamic_pointer_cast<ControlledBody>(id_iter->second);
+    }
+    else
+    {
+      XMLAttrib* center_attrib = (*i)->get_attrib("center");
+      if (center_attrib)
+        roi.center = Point3d(center_attrib->get_origin_value(), GLOBAL);
+    }
+
+    roi_volumes.push_back(roi);
+  }
+
   // read all disabled pairs
   child_nodes = node->find_child_nodes("DisabledPair");
   for (std::list<shared_ptr<const XMLTree> >::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
@@ -720,6 +2356,7 @@ void ConstraintSimulator::save_to_xml(XMLTreePtr node, list<shared_ptr<const Bas
   node->attribs.insert(XMLAttrib("unilateral-stabilization-tol", cstab.eps));
   node->attribs.insert(XMLAttrib("bilateral-stabilization-tol", cstab.bilateral_eps));
   node->attribs.insert(XMLAttrib("constraint-stabilization-max-iterations", cstab.max_iterations));
+  node->attribs.insert(XMLAttrib("stabilization-stagnation-tol", cstab.stagnation_tol));
 
   // save the dissipation mechanism
   if (_dissipator)
@@ -729,14 +2366,52 @@ void ConstraintSimulator::save_to_xml(XMLTreePtr node, list<shared_ptr<const Bas
   }
 
   // save any collision detection plugins
-  if (!dynamic_pointer_cast<CCD>(_coldet))
+  if (!dynamic_pointer_cast<CCD>(_coldet) || dynamic_pointer_cast<SpatialGridCCD>(_coldet))
   {
     node->attribs.insert(XMLAttrib("collision-detection-plugin", _coldet->id));
     shared_objects.push_back(_coldet);
   }
 
+  // save the asynchronous collision detection plugin, if any
+  if (_async_coldet)
+  {
+    node->attribs.insert(XMLAttrib("async-collision-detection-plugin", _async_coldet->id));
+    shared_objects.push_back(_async_coldet);
+  }
+
   // save the distance thresholds
   node->attribs.insert(XMLAttrib("contact-dist-thesh", contact_dist_thresh));
+  node->attribs.insert(XMLAttrib("contact-hysteresis", contact_hysteresis));
+
+  // save the manifold reuse tolerance
+  node->attribs.insert(XMLAttrib("manifold-reuse-tol", manifold_reuse_tol));
+  node->attribs.insert(XMLAttrib("max-manifold-points", max_manifold_points));
+  node->attribs.insert(XMLAttrib("gjk-batch-culling", gjk_batch_culling));
+  node->attribs.insert(XMLAttrib("record-narrow-phase-stats", record_narrow_phase_stats));
+  node->attribs.insert(XMLAttrib("async-broad-phase", async_broad_phase));
+
+  // save the replay memoization settings
+  node->attribs.insert(XMLAttrib("replay-cache-enabled", replay_cache_enabled));
+  if (!replay_cache_file.empty())
+    node->attribs.insert(XMLAttrib("replay-cache-file", replay_cache_file));
+
+  // save the projected Gauss-Seidel impact solver options
+  node->attribs.insert(XMLAttrib("use-pgs-solver", _impact_constraint_handler.use_pgs_solver));
+  node->attribs.insert(XMLAttrib("pgs-max-iterations", _impact_constraint_handler.pgs_max_iterations));
+  node->attribs.insert(XMLAttrib("pgs-tolerance", _impact_constraint_handler.pgs_tolerance));
+  node->attribs.insert(XMLAttrib("auto-solver-selection", _impact_constraint_handler.auto_solver_selection));
+  node->attribs.insert(XMLAttrib("auto-pgs-contact-threshold", _impact_constraint_handler.auto_pgs_contact_threshold));
+
+  // save the cone-complementarity impact solver options
+  node->attribs.insert(XMLAttrib("use-ccp-solver", _impact_constraint_handler.use_ccp_solver));
+  node->attribs.insert(XMLAttrib("ccp-max-iterations", _impact_constraint_handler.ccp_max_iterations));
+  node->attribs.insert(XMLAttrib("ccp-tolerance", _impact_constraint_handler.ccp_tolerance));
+
+  // save the energy-based tolerance scheduling options
+  node->attribs.insert(XMLAttrib("adaptive-tolerance", _impact_constraint_handler.adaptive_tolerance));
+  node->attribs.insert(XMLAttrib("adaptive-ke-threshold", _impact_constraint_handler.adaptive_ke_threshold));
+  node->attribs.insert(XMLAttrib("adaptive-velocity-threshold", _impact_constraint_handler.adaptive_velocity_threshold));
+  node->attribs.insert(XMLAttrib("adaptive-tolerance-scale", _impact_constraint_handler.adaptive_tolerance_scale));
 
   // save all ContactParameters
   for (map<sorted_pair<BasePtr>, shared_ptr<ContactParameters> >::const_iterator i = contact_params.begin(); i != contact_params.end(); i++)
@@ -746,6 +2421,34 @@ void ConstraintSimulator::save_to_xml(XMLTreePtr node, list<shared_ptr<const Bas
     i->second->save_to_xml(new_node, shared_objects);
   }
 
+  // save all material pair parameters (upper triangle only; table is symmetric)
+  for (unsigned i=0; i< _num_materials; i++)
+    for (unsigned j=i; j< _num_materials; j++)
+    {
+      shared_ptr<ContactParameters> cp = _material_params[i*_num_materials + j];
+      if (!cp)
+        continue;
+      XMLTreePtr child_node(new XMLTree("MaterialPair"));
+      child_node->attribs.insert(XMLAttrib("material1", i));
+      child_node->attribs.insert(XMLAttrib("material2", j));
+      cp->save_coefficients_to_xml(child_node);
+      node->add_child(child_node);
+    }
+
+  // save the region-of-interest settings and regions
+  node->attribs.insert(XMLAttrib("roi-enabled", roi_enabled));
+  node->attribs.insert(XMLAttrib("roi-promotion-dist", roi_promotion_dist));
+  for (unsigned i=0; i< roi_volumes.size(); i++)
+  {
+    XMLTreePtr child_node(new XMLTree("RegionOfInterest"));
+    child_node->attribs.insert(XMLAttrib("radius", roi_volumes[i].radius));
+    if (roi_volumes[i].anchor)
+      child_node->attribs.insert(XMLAttrib("anchor-id", roi_volumes[i].anchor->id));
+    else
+      child_node->attribs.insert(XMLAttrib("center", roi_volumes[i].center));
+    node->add_child(child_node);
+  }
+
   // save all disabled pairs
   for (std::set<sorted_pair<CollisionGeometryPtr> >::const_iterator i = unchecked_pairs.begin(); i != unchecked_pairs.end(); i++)
   {
@@ -27,6 +27,9 @@
  * when (if ever) they come into contact.
  */
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <map>
 #include <algorithm>
 #include <Moby/Types.h>
@@ -60,17 +63,53 @@ ConstraintStabilization::ConstraintStabilization()
 
   // set bilateral tolerance
   bilateral_eps = 1e-6;
+
+  // set the stall detection tolerance
+  stagnation_tol = NEAR_ZERO;
+}
+
+/// Estimates the heap memory held by the stabilization workspaces, in bytes
+/**
+ * Counts the LCP workspace, the per-island warm starts, the saved
+ * velocities, and any per-thread worker instances.  Estimates exclude
+ * allocator overhead (see Primitive::calc_memory_usage()).
+ */
+unsigned long ConstraintStabilization::calc_memory_usage() const
+{
+  unsigned long bytes = 0;
+  bytes += (unsigned long) (_MM.rows()*_MM.columns())*sizeof(double);
+  bytes += (unsigned long) _qq.size()*sizeof(double);
+  for (unsigned i=0; i< _zlast.size(); i++)
+    bytes += (unsigned long) _zlast[i].size()*sizeof(double);
+  for (unsigned i=0; i< _qd_save.size(); i++)
+    bytes += (unsigned long) _qd_save[i].size()*sizeof(double);
+  for (unsigned i=0; i< _workers.size(); i++)
+    bytes += sizeof(ConstraintStabilization) + _workers[i]->calc_memory_usage();
+  return bytes;
+}
+
+/// Releases the warm starts and the per-thread worker instances
+/**
+ * Both are rebuilt on demand: dropping the warm starts only costs extra LCP
+ * pivots on the next stabilization, and workers are re-created the next
+ * time islands are solved in parallel.
+ */
+void ConstraintStabilization::release_transient_memory()
+{
+  _zlast.clear();
+  _workers.clear();
 }
 
 /// Saves the velocities before constraint stabilization
 void ConstraintStabilization::save_velocities(shared_ptr<ConstraintSimulator> sim, vector<VectorNd>& qd)
 {
-  qd.clear();
+  // resize in place (rather than clearing and re-adding) so that persistent
+  // storage passed in is reused without allocation
+  qd.resize(sim->_bodies.size());
   for (unsigned i = 0; i< sim->_bodies.size(); i++)
   {
     shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(sim->_bodies[i]);
-    qd.push_back(VectorNd());
-    db->get_generalized_velocity(DynamicBodyd::eSpatial, qd.back());
+    db->get_generalized_velocity(DynamicBodyd::eSpatial, qd[i]);
   }
 }
 
@@ -84,6 +123,23 @@ void ConstraintStabilization::restore_velocities(shared_ptr<ConstraintSimulator>
   }
 }
 
+/// Per-DOF kernel for the joint limit scan in evaluate_unilateral_constraints()
+struct LimitViolationOp
+{
+  LimitViolationOp(shared_ptr<Joint> joint_, vector<double>& uC_, double& vio_) : uC(uC_), vio(vio_) { joint = joint_; tare = &joint->get_q_tare(); }
+  void operator()(unsigned k)
+  {
+    uC.push_back(joint->hilimit[k] - joint->q[k] - (*tare)[k]);
+    vio = std::min(vio, uC.back());
+    uC.push_back(joint->q[k] + (*tare)[k] - joint->lolimit[k]);
+    vio = std::min(vio, uC.back());
+  }
+  shared_ptr<Joint> joint;
+  const VectorNd* tare;
+  vector<double>& uC;
+  double& vio;
+};
+
 /// Get the maximum amount of unilateral constraint violation
 double ConstraintStabilization::evaluate_unilateral_constraints(shared_ptr<ConstraintSimulator> sim, vector<double>& uC)
 {
@@ -115,14 +171,10 @@ double ConstraintStabilization::evaluate_unilateral_constraints(shared_ptr<Const
       for (unsigned j=0; j< joints.size(); j++)
       {
         shared_ptr<Joint> joint = dynamic_pointer_cast<Joint>(joints[i]);
-        const VectorNd& tare = joint->get_q_tare(); 
-        for (unsigned k=0; k< joint->num_dof(); k++)
-        {
-          uC.push_back(joint->hilimit[k] - joint->q[k] - tare[k]);
-          vio = std::min(vio, uC.back());
-          uC.push_back(joint->q[k] + tare[k] - joint->lolimit[k]);
-          vio = std::min(vio, uC.back());
-        }
+
+        // loop over all DOF, with a compile-time trip count for low-DOF joints
+        LimitViolationOp op(joint, uC, vio);
+        joint->for_each_dof(op);
       }
     }
   }
@@ -146,7 +198,7 @@ double ConstraintStabilization::evaluate_bilateral_constraints(shared_ptr<Constr
   // evaluate all constraints in the simulator
   for (unsigned i=0; i< sim->implicit_joints.size(); i++)
   {
-    sim->implicit_joints[i]->evaluate_constraints(eval);
+    sim->implicit_joints[i]->evaluate_constraints_prepared(eval);
     std::copy(eval, eval+sim->implicit_joints[i]->num_constraint_eqns(), std::back_inserter(C));
   }
 
@@ -163,13 +215,29 @@ double ConstraintStabilization::evaluate_bilateral_constraints(shared_ptr<Constr
   return (std::fabs(*mmelm.first) > std::fabs(*mmelm.second)) ? std::fabs(*mmelm.first) : std::fabs(*mmelm.second);
 }
 
+/// Determines whether an island has any violated unilateral constraint
+/**
+ * The island LCP right-hand side stacks Cn_v and L_v; when every entry is
+ * non-negative, z = 0 solves the island's LCP exactly and the island
+ * contributes no position update, so its solve can be skipped outright.
+ */
+static bool island_violating(const UnilateralConstraintProblemData& pd)
+{
+  for (unsigned i=0; i< pd.N_CONTACTS; i++)
+    if (pd.Cn_v[i] < 0.0)
+      return true;
+  for (unsigned i=0; i< pd.N_LIMITS; i++)
+    if (pd.L_v[i] < 0.0)
+      return true;
+  return false;
+}
+
 /// Stabilizes the constraints in the simulator
 void ConstraintStabilization::stabilize(shared_ptr<ConstraintSimulator> sim)
 {
   FILE_LOG(LOG_SIMULATOR)<< "======constraint stabilization start======"<<std::endl;
   VectorNd dq, q, v;
   std::vector<UnilateralConstraintProblemData> pd;
-  std::vector<VectorNd> qd_save;
   std::vector<double> C, uC;
   std::map<shared_ptr<DynamicBodyd>, unsigned> body_index_map;
 
@@ -178,7 +246,7 @@ void ConstraintStabilization::stabilize(shared_ptr<ConstraintSimulator> sim)
     return;
 
   // save the generalized velocities
-  save_velocities(sim, qd_save);
+  save_velocities(sim, _qd_save);
 
   // get the body configurations and setup the body index map
   get_body_configurations(q, sim);
@@ -193,6 +261,12 @@ void ConstraintStabilization::stabilize(shared_ptr<ConstraintSimulator> sim)
   FILE_LOG(LOG_SIMULATOR) <<"maximum unilateral constraint violation (before stabilization loop): "<< max_uvio <<std::endl;
   FILE_LOG(LOG_SIMULATOR) <<"maximum bilateral constraint violation (before stabilization loop): "<< max_bvio <<std::endl;
 
+  // setup violation tracking for stall detection; the previous iteration's
+  // LCP solutions are discarded (they warm-start solves within one
+  // stabilization, not across calls)
+  double last_uvio = max_uvio, last_bvio = max_bvio;
+  _zlast.clear();
+
   unsigned iterations = 0;
   while (max_uvio < eps || max_bvio > bilateral_eps)
   {
@@ -217,13 +291,55 @@ void ConstraintStabilization::stabilize(shared_ptr<ConstraintSimulator> sim)
       db->set_generalized_velocity(DynamicBodyd::eSpatial, v);
     }
 
-    // compute problem data (get M, N, alpha, etc.) 
+    // compute problem data (get M, N, alpha, etc.)
     compute_problem_data(pd, sim);
 
-    // determine dq's
+    // keep one saved LCP solution per island; islands carried over from the
+    // previous iteration keep their solutions (warm starts), new ones get
+    // empty vectors (cold starts)
+    _zlast.resize(pd.size());
+
+    // determine dq's; islands whose constraints are all satisfied have the
+    // trivial (zero) solution, so only violating islands are solved -- one
+    // deeply-penetrating island no longer forces LCP solves over the
+    // already-stable remainder of the scene
     dq.set_zero(q.size());
+    vector<unsigned> active;
     for (unsigned i=0; i< pd.size(); i++)
-      determine_dq(pd[i], dq, body_index_map);
+      if (island_violating(pd[i]))
+        active.push_back(i);
+
+    #ifdef _OPENMP
+    if (active.size() > 1)
+    {
+      // islands touch disjoint bodies and disjoint segments of dq, so their
+      // solves may run concurrently; each worker thread gets its own
+      // instance so the LCP solver and workspace matrices are not shared
+      const unsigned NTHREADS = (unsigned) omp_get_max_threads();
+      while (_workers.size() < NTHREADS)
+        _workers.push_back(boost::shared_ptr<ConstraintStabilization>(new ConstraintStabilization));
+
+      // exceptions must not escape the parallel region; record and rethrow
+      bool island_failed = false;
+      #pragma omp parallel for schedule(dynamic)
+      for (int i=0; i< (int) active.size(); i++)
+      {
+        try
+        {
+          _workers[omp_get_thread_num()]->determine_dq(pd[active[i]], dq, body_index_map, _zlast[active[i]]);
+        }
+        catch (std::exception& e)
+        {
+          island_failed = true;
+        }
+      }
+      if (island_failed)
+        throw std::runtime_error("ConstraintStabilization::stabilize() - island stabilization solve failed");
+    }
+    else
+    #endif
+    for (unsigned i=0; i< active.size(); i++)
+      determine_dq(pd[active[i]], dq, body_index_map, _zlast[active[i]]);
     FILE_LOG(LOG_SIMULATOR) << "dq: " << dq << std::endl;
 
     // determine s and update q; NOTE: update q computes the pairwise distances 
@@ -239,11 +355,22 @@ void ConstraintStabilization::stabilize(shared_ptr<ConstraintSimulator> sim)
     // update constraint violation
     max_bvio = evaluate_bilateral_constraints(sim, C);
 
+    // stop early when the violations have stalled: if neither measure
+    // improved meaningfully this iteration, further solves of the same
+    // problem will not either
+    if (max_uvio <= last_uvio + stagnation_tol && max_bvio >= last_bvio - stagnation_tol)
+    {
+      FILE_LOG(LOG_SIMULATOR) << " -- constraint violation change stalled; stopping stabilization early" << std::endl;
+      break;
+    }
+    last_uvio = max_uvio;
+    last_bvio = max_bvio;
+
     iterations++;
   }
 
   // restore the generalized velocities
-  restore_velocities(sim, qd_save);
+  restore_velocities(sim, _qd_save);
 
   // after stabilization, velocities may be in an impacting state; correct
 //  sim->find_unilateral_constraints(sim->contact_dist_thresh);
@@ -254,7 +381,7 @@ void ConstraintStabilization::stabilize(shared_ptr<ConstraintSimulator> sim)
 }
 
 /// Adds unilateral constraints for joint limits in an articulated body
-void ConstraintStabilization::add_limit_constraints(const vector<ControlledBodyPtr>& bodies, std::vector<UnilateralConstraint>& constraints)
+void ConstraintStabilization::add_limit_constraints(const vector<ControlledBodyPtr>& bodies, std::vector<UnilateralConstraint>& constraints, shared_ptr<ConstraintSimulator> sim)
 {
   const double INF = std::numeric_limits<double>::max();
 
@@ -264,6 +391,13 @@ void ConstraintStabilization::add_limit_constraints(const vector<ControlledBodyP
     shared_ptr<RCArticulatedBodyd> rcab = dynamic_pointer_cast<RCArticulatedBodyd>(bodies[i]);
     if (rcab)
     {
+      // no joint can be near a limit while the body's conservative
+      // time-to-limit bound holds; skip its DOFs entirely (the bound is
+      // invalidated whenever stabilization updates the configuration)
+      shared_ptr<ArticulatedBody> ab = dynamic_pointer_cast<ArticulatedBody>(bodies[i]);
+      if (ab && !ab->joint_limit_check_due(sim->current_time))
+        continue;
+
       const std::vector<shared_ptr<Jointd> >& joints = rcab->get_joints();
       for (unsigned j=0; j< joints.size(); j++)
       {
@@ -379,7 +513,7 @@ void ConstraintStabilization::compute_problem_data(std::vector<UnilateralConstra
     add_contact_constraints(constraints, to_check.first, to_check.second, sim);
 
   // add limit constraints
-  add_limit_constraints(bodies, constraints);
+  add_limit_constraints(bodies, constraints, sim);
 
   //FILE_LOG(LOG_SIMULATOR) << "constraints added" << std::endl;
   // 2) for each articulated body, add as many UnilateralConstraint objects as
@@ -444,7 +578,7 @@ void ConstraintStabilization::compute_problem_data(std::vector<UnilateralConstra
     tmpv.resize(pd.N_CONSTRAINT_EQNS_IMP);
     for (unsigned i=0, j=0; i< pd.island_ijoints.size(); i++)
     {
-      pd.island_ijoints[i]->evaluate_constraints(C);
+      pd.island_ijoints[i]->evaluate_constraints_prepared(C);
       for (unsigned k=0; k< pd.island_ijoints[i]->num_constraint_eqns(); k++)
         tmpv[j++] = C[k];
     }
@@ -477,7 +611,7 @@ void ConstraintStabilization::compute_problem_data(std::vector<UnilateralConstra
     tmpv.resize(pd.N_CONSTRAINT_EQNS_IMP);
     for (unsigned i=0, j=0; i< pd.island_ijoints.size(); i++)
     {
-      pd.island_ijoints[i]->evaluate_constraints(C);
+      pd.island_ijoints[i]->evaluate_constraints_prepared(C);
       for (unsigned k=0; k< pd.island_ijoints[i]->num_constraint_eqns(); k++)
         tmpv[j++] = C[k];
     }
@@ -663,7 +797,7 @@ void ConstraintStabilization::set_bilateral_only_constraint_data(UnilateralConst
     {
       // add the block to the Jacobian
       q.Jfull.blocks.push_back(MatrixBlock());
-      q.island_ijoints[i]->calc_constraint_jacobian(true, q.Jfull.blocks.back().block);
+      q.island_ijoints[i]->calc_constraint_jacobian_prepared(true, q.Jfull.blocks.back().block);
       q.Jfull.blocks.back().st_row_idx = eq_idx;
       q.Jfull.blocks.back().st_col_idx = gc_map[inboard];
     }
@@ -672,7 +806,7 @@ void ConstraintStabilization::set_bilateral_only_constraint_data(UnilateralConst
     {
       // add the block to the Jacobian
       q.Jfull.blocks.push_back(MatrixBlock());
-      q.island_ijoints[i]->calc_constraint_jacobian(false, q.Jfull.blocks.back().block);
+      q.island_ijoints[i]->calc_constraint_jacobian_prepared(false, q.Jfull.blocks.back().block);
       q.Jfull.blocks.back().st_row_idx = eq_idx;
       q.Jfull.blocks.back().st_col_idx = gc_map[outboard];
     }
@@ -847,7 +981,7 @@ void ConstraintStabilization::set_unilateral_constraint_data(UnilateralConstrain
     {
       // add the block to the Jacobian
       q.Jfull.blocks.push_back(MatrixBlock());
-      q.island_ijoints[i]->calc_constraint_jacobian(true, q.Jfull.blocks.back().block);
+      q.island_ijoints[i]->calc_constraint_jacobian_prepared(true, q.Jfull.blocks.back().block);
       q.Jfull.blocks.back().st_row_idx = eq_idx;
       q.Jfull.blocks.back().st_col_idx = gc_map[inboard];
     }
@@ -856,7 +990,7 @@ void ConstraintStabilization::set_unilateral_constraint_data(UnilateralConstrain
     {
       // add the block to the Jacobian
       q.Jfull.blocks.push_back(MatrixBlock());
-      q.island_ijoints[i]->calc_constraint_jacobian(false, q.Jfull.blocks.back().block);
+      q.island_ijoints[i]->calc_constraint_jacobian_prepared(false, q.Jfull.blocks.back().block);
       q.Jfull.blocks.back().st_row_idx = eq_idx;
       q.Jfull.blocks.back().st_col_idx = gc_map[outboard];
     }
@@ -868,8 +1002,24 @@ void ConstraintStabilization::set_unilateral_constraint_data(UnilateralConstrain
   // determine active set of implicit constraints
   ImpactConstraintHandler::get_full_rank_implicit_constraints(q.Jfull, q.active);
 
-  // compute X
-  ImpactConstraintHandler::compute_X(q, X);
+  // when there are no implicit constraint equations, X is exactly the block
+  // diagonal of the inverse inertias and need not be materialized densely
+  std::vector<MatrixNd> X_diag;
+  const bool X_BLOCK_DIAG = (q.N_CONSTRAINT_EQNS_IMP == 0);
+  if (X_BLOCK_DIAG)
+  {
+    // setup the (empty) reduced implicit constraint Jacobian
+    q.J.blocks.clear();
+    q.J.rows = 0;
+    q.J.cols = q.Jfull.cols;
+    q.iM_JxT.resize(q.N_GC, 0);
+    q.Jx_iM_JxT.resize(0, 0);
+
+    // compute the block diagonal form of X
+    ImpactConstraintHandler::compute_X_diag(q, X_diag);
+  }
+  else
+    ImpactConstraintHandler::compute_X(q, X);
 
   // setup Jacobian for Cn
   SparseJacobian Cn;
@@ -879,18 +1029,30 @@ void ConstraintStabilization::set_unilateral_constraint_data(UnilateralConstrain
 
   // process all contact constraints
   for (unsigned i=0; i< q.contact_constraints.size(); i++)
-    add_contact_to_Jacobian(*q.contact_constraints[i], Cn, gc_map, i); 
+    add_contact_to_Jacobian(*q.contact_constraints[i], Cn, gc_map, i);
 
-  // compute X_CnT
-  Cn.mult(X, tmp);  MatrixNd::transpose(tmp, q.X_CnT);
-  q.J.mult(X, tmp); MatrixNd::transpose(tmp, q.X_JxT);
+  // compute X_CnT and X_JxT, then the limit components (the limit components
+  // must be computed first among the products below)
+  if (X_BLOCK_DIAG)
+  {
+    Cn.mult(X_diag, tmp);  MatrixNd::transpose(tmp, q.X_CnT);
+    q.X_JxT.resize(q.N_GC, 0);
+  }
+  else
+  {
+    Cn.mult(X, tmp);  MatrixNd::transpose(tmp, q.X_CnT);
+    q.J.mult(X, tmp); MatrixNd::transpose(tmp, q.X_JxT);
+  }
 
   // setup X_CsT, X_CtT
   q.X_CsT.resize(q.N_GC, 0);
   q.X_CtT.resize(q.N_GC, 0);
-  
+
   // compute limit components - must do this first
-  ImpactConstraintHandler::compute_limit_components(X, q);
+  if (X_BLOCK_DIAG)
+    ImpactConstraintHandler::compute_limit_components(X_diag, q);
+  else
+    ImpactConstraintHandler::compute_limit_components(X, q);
 
   // compute problem data for Cn rows
   Cn.mult(q.X_CnT, q.Cn_X_CnT); 
@@ -929,30 +1091,42 @@ void ConstraintStabilization::add_contact_to_Jacobian(const UnilateralConstraint
 }
 
 /// Computes deltaq by solving a linear complementarity problem
-void ConstraintStabilization::determine_dq(UnilateralConstraintProblemData& pd, VectorNd& dqm, const std::map<shared_ptr<DynamicBodyd>, unsigned>& body_index_map)
+/**
+ * \param z on entry, the solution from the previous stabilization iteration
+ *        for this island (used to warm-start the pivoting solver when the
+ *        dimensions still match); on return, this iteration's solution
+ */
+void ConstraintStabilization::determine_dq(UnilateralConstraintProblemData& pd, VectorNd& dqm, const std::map<shared_ptr<DynamicBodyd>, unsigned>& body_index_map, VectorNd& z)
 {
-  VectorNd z, dq_sub;
+  VectorNd dq_sub;
 
-  // initialize the LCP matrix and LCP vector
-  MatrixNd MM(pd.N_CONTACTS + pd.N_LIMITS, pd.N_CONTACTS + pd.N_LIMITS);
-  VectorNd qq(pd.N_CONTACTS + pd.N_LIMITS);
+  // initialize the LCP matrix and LCP vector (workspace members: successive
+  // iterations solve problems of the same size, so the storage is reused)
+  _MM.resize(pd.N_CONTACTS + pd.N_LIMITS, pd.N_CONTACTS + pd.N_LIMITS);
+  _qq.resize(pd.N_CONTACTS + pd.N_LIMITS);
 
   // setup the LCP matrix and LCP vector
-  MM.block(0, pd.N_CONTACTS, 0, pd.N_CONTACTS) = pd.Cn_X_CnT;
-  MM.block(0, pd.N_CONTACTS, pd.N_CONTACTS, MM.columns()) = pd.Cn_X_LT;
-  SharedMatrixNd L_X_CnT_block = MM.block(pd.N_CONTACTS, MM.rows(), 0, pd.N_CONTACTS);
+  _MM.block(0, pd.N_CONTACTS, 0, pd.N_CONTACTS) = pd.Cn_X_CnT;
+  _MM.block(0, pd.N_CONTACTS, pd.N_CONTACTS, _MM.columns()) = pd.Cn_X_LT;
+  SharedMatrixNd L_X_CnT_block = _MM.block(pd.N_CONTACTS, _MM.rows(), 0, pd.N_CONTACTS);
   MatrixNd::transpose(pd.Cn_X_LT, L_X_CnT_block);
-  MM.block(pd.N_CONTACTS, MM.rows(), pd.N_CONTACTS, MM.columns()) = pd.L_X_LT;
-  qq.segment(0, pd.N_CONTACTS) = pd.Cn_v;
-  qq.segment(pd.N_CONTACTS, qq.size()) = pd.L_v;
-
-  FILE_LOG(LOG_SIMULATOR) << "# of constraints in determine_dq(): " << qq.size() << std::endl;
-  FILE_LOG(LOG_SIMULATOR) << "MM: " << std::endl << MM;
-  FILE_LOG(LOG_SIMULATOR) << "qq: " << qq << std::endl;
-
-  // solve N*inv(M)*N'*dq = N*alpha for impulses 
-  if (!_lcp.lcp_fast(MM, qq, z))
-    _lcp.lcp_lemke_regularized(MM, qq, z);
+  _MM.block(pd.N_CONTACTS, _MM.rows(), pd.N_CONTACTS, _MM.columns()) = pd.L_X_LT;
+  _qq.segment(0, pd.N_CONTACTS) = pd.Cn_v;
+  _qq.segment(pd.N_CONTACTS, _qq.size()) = pd.L_v;
+
+  FILE_LOG(LOG_SIMULATOR) << "# of constraints in determine_dq(): " << _qq.size() << std::endl;
+  FILE_LOG(LOG_SIMULATOR) << "MM: " << std::endl << _MM;
+  FILE_LOG(LOG_SIMULATOR) << "qq: " << _qq << std::endl;
+
+  // solve N*inv(M)*N'*dq = N*alpha for impulses; lcp_fast() seeds its
+  // initial basis from z when z matches the problem dimension (a cold start
+  // otherwise), which typically pivots to the solution in a step or two on
+  // the nearly-identical problems successive stabilization iterations pose
+  if (!_lcp.lcp_fast(_MM, _qq, z))
+  {
+    z.resize(0);
+    _lcp.lcp_lemke_regularized(_MM, _qq, z);
+  }
   FILE_LOG(LOG_SIMULATOR) << "zz: " << z << std::endl;
 
   // update velocities
@@ -1041,9 +1215,14 @@ void ConstraintStabilization::update_velocities(const UnilateralConstraintProble
     }
   }
 
-  // apply all generalized impacts
+  // apply all generalized impacts, batched so that bodies coupled by
+  // implicit constraints share a single constrained solve
+  if (pd.simulator)
+    pd.simulator->start_impulse_batch();
   for (map<shared_ptr<DynamicBodyd>, VectorNd>::const_iterator i = gj.begin(); i != gj.end(); i++)
     i->first->apply_generalized_impulse(i->second);
+  if (pd.simulator)
+    pd.simulator->flush_impulse_batch();
 }
 
 /// Simple squaring function
@@ -1256,6 +1435,9 @@ void ConstraintStabilization::generate_body_index_map(std::map<shared_ptr<Dynami
 /// Updates the body configurations given q
 void ConstraintStabilization::update_body_configurations(const VectorNd& q, shared_ptr<ConstraintSimulator> sim)
 {
+  // body positions are about to change; cached inverse inertias go stale
+  UnilateralConstraint::invalidate_inverse_inertias();
+
   const std::vector<shared_ptr<ControlledBody> >& bodies = sim->_bodies;
   unsigned last = 0;
   BOOST_FOREACH(shared_ptr<ControlledBody> cb, bodies){
@@ -1264,7 +1446,16 @@ void ConstraintStabilization::update_body_configurations(const VectorNd& q, shar
     Ravelin::SharedConstVectorNd gc_shared = q.segment(last,last+ngc);
     body->set_generalized_coordinates_euler(gc_shared);
     last += ngc;
+
+    // positions changed outside of integration, so any scheduled joint limit
+    // check is stale
+    shared_ptr<ArticulatedBody> ab = dynamic_pointer_cast<ArticulatedBody>(cb);
+    if (ab)
+      ab->reset_joint_limit_check();
   }
+
+  // prepared joint constraint data reflects the old configurations
+  sim->invalidate_joint_step_data();
 }
 
 /// sign function
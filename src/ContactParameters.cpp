@@ -22,6 +22,7 @@ ContactParameters::ContactParameters()
 {
   epsilon = 0.0;
   mu_coulomb = mu_viscous = 0.0;
+  mu_torsional = mu_rolling = 0.0;
   compliance = 0.0;
   NK = 4;
   penalty_Kp = penalty_Kv = 0.0;
@@ -36,6 +37,7 @@ ContactParameters::ContactParameters(BasePtr o1, BasePtr o2)
   objects = make_sorted_pair(o1, o2);
   epsilon = 0.0;
   mu_coulomb = mu_viscous = 0.0;
+  mu_torsional = mu_rolling = 0.0;
   compliance = 0.0;
   NK = 4;
   penalty_Kp = penalty_Kv = 0.0;
@@ -95,6 +97,18 @@ void ContactParameters::load_from_xml(shared_ptr<const XMLTree> node, std::map<s
   // form the sorted pair
   objects = make_sorted_pair(o1, o2);
 
+  // read the coefficients and gains
+  load_coefficients_from_xml(node);
+}
+
+/// Reads the coefficients and gains from an XML node
+/**
+ * Reads only the coefficient attributes, not the object identities, so
+ * nodes keyed other than by object pair (e.g., the simulator's material-pair
+ * table entries) can share the attribute format.
+ */
+void ContactParameters::load_coefficients_from_xml(shared_ptr<const XMLTree> node)
+{
   // get the value for epsilon, if specified
   XMLAttrib* rest_attr = node->get_attrib("epsilon");
   if (rest_attr)
@@ -110,6 +124,16 @@ void ContactParameters::load_from_xml(shared_ptr<const XMLTree> node, std::map<s
   if (fv_attr)
     mu_viscous = fv_attr->get_real_value();
 
+  // get the coefficient of torsional friction
+  XMLAttrib* ft_attr = node->get_attrib("mu-torsional");
+  if (ft_attr)
+    mu_torsional = ft_attr->get_real_value();
+
+  // get the coefficient of rolling friction
+  XMLAttrib* fr_attr = node->get_attrib("mu-rolling");
+  if (fr_attr)
+    mu_rolling = fr_attr->get_real_value();
+
   // get the contact compliance
   XMLAttrib* cc_attr = node->get_attrib("compliance");
   if (cc_attr)
@@ -153,7 +177,14 @@ void ContactParameters::save_to_xml(XMLTreePtr node, std::list<shared_ptr<const
   node->attribs.insert(XMLAttrib("object1-id", objects.first->id));
   node->attribs.insert(XMLAttrib("object2-id", objects.second->id));
 
-  // write the coefficient of epsilon 
+  // write the coefficients and gains
+  save_coefficients_to_xml(node);
+}
+
+/// Writes the coefficients and gains to an XML node (see load_coefficients_from_xml())
+void ContactParameters::save_coefficients_to_xml(XMLTreePtr node) const
+{
+  // write the coefficient of epsilon
   node->attribs.insert(XMLAttrib("epsilon", epsilon));
 
   // write the coefficient of friction for Coulombic friction
@@ -162,6 +193,10 @@ void ContactParameters::save_to_xml(XMLTreePtr node, std::list<shared_ptr<const
   // write the coefficient of friction for Viscous friction
   node->attribs.insert(XMLAttrib("mu-viscous", mu_viscous));
 
+  // write the coefficients of torsional and rolling friction
+  node->attribs.insert(XMLAttrib("mu-torsional", mu_torsional));
+  node->attribs.insert(XMLAttrib("mu-rolling", mu_rolling));
+
   // write the contact compliance
   node->attribs.insert(XMLAttrib("compliance", compliance));
 
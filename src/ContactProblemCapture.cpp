@@ -0,0 +1,278 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <Moby/Log.h>
+#include <Moby/ContactProblemCapture.h>
+
+using namespace Ravelin;
+using namespace Moby;
+
+/// The magic bytes and version identifying the capture format
+static const char MAGIC[4] = { 'M', 'B', 'C', 'P' };
+static const unsigned VERSION = 1;
+
+// static member initializations
+std::string ContactProblemCapture::capture_prefix;
+bool ContactProblemCapture::capture_all = false;
+
+/// Writes an unsigned integer in binary
+static void write_unsigned(unsigned x, std::ostream& out)
+{
+  out.write((const char*) &x, sizeof(x));
+}
+
+/// Writes a floating point value in binary
+static void write_double(double x, std::ostream& out)
+{
+  out.write((const char*) &x, sizeof(x));
+}
+
+/// Writes a matrix in binary (dimensions followed by column-major data)
+static void write_matrix(const MatrixNd& M, std::ostream& out)
+{
+  write_unsigned(M.rows(), out);
+  write_unsigned(M.columns(), out);
+  for (unsigned j=0; j< M.columns(); j++)
+    for (unsigned i=0; i< M.rows(); i++)
+      write_double(M(i,j), out);
+}
+
+/// Writes a vector in binary (dimension followed by data)
+static void write_vector(const VectorNd& v, std::ostream& out)
+{
+  write_unsigned(v.size(), out);
+  for (unsigned i=0; i< v.size(); i++)
+    write_double(v[i], out);
+}
+
+/// Reads an unsigned integer in binary
+static bool read_unsigned(unsigned& x, std::istream& in)
+{
+  in.read((char*) &x, sizeof(x));
+  return !in.fail();
+}
+
+/// Reads a floating point value in binary
+static bool read_double(double& x, std::istream& in)
+{
+  in.read((char*) &x, sizeof(x));
+  return !in.fail();
+}
+
+/// Reads a matrix in binary
+static bool read_matrix(MatrixNd& M, std::istream& in)
+{
+  unsigned rows, cols;
+  if (!read_unsigned(rows, in) || !read_unsigned(cols, in))
+    return false;
+  M.resize(rows, cols);
+  for (unsigned j=0; j< cols; j++)
+    for (unsigned i=0; i< rows; i++)
+      if (!read_double(M(i,j), in))
+        return false;
+  return true;
+}
+
+/// Reads a vector in binary
+static bool read_vector(VectorNd& v, std::istream& in)
+{
+  unsigned n;
+  if (!read_unsigned(n, in))
+    return false;
+  v.resize(n);
+  for (unsigned i=0; i< n; i++)
+    if (!read_double(v[i], in))
+      return false;
+  return true;
+}
+
+/// Writes the numeric core of a constraint problem in binary
+void ContactProblemCapture::write(const UnilateralConstraintProblemData& q, std::ostream& out)
+{
+  // write the magic bytes and version
+  out.write(MAGIC, sizeof(MAGIC));
+  write_unsigned(VERSION, out);
+
+  // write the problem dimensions
+  write_unsigned(q.N_CONTACTS, out);
+  write_unsigned(q.N_LIMITS, out);
+  write_unsigned(q.N_CONSTRAINT_EQNS_IMP, out);
+  write_unsigned(q.N_K_TOTAL, out);
+  write_unsigned(q.N_LIN_CONE, out);
+  write_unsigned(q.N_TRUE_CONE, out);
+  write_unsigned(q.N_GC, out);
+
+  // write the per-contact metadata
+  for (unsigned i=0; i< q.N_CONTACTS; i++)
+  {
+    write_double(q.contact_constraints[i]->contact_mu_coulomb, out);
+    write_double(q.contact_constraints[i]->contact_mu_viscous, out);
+    write_double(q.contact_constraints[i]->contact_epsilon, out);
+    write_unsigned(q.contact_constraints[i]->contact_NK, out);
+  }
+
+  // write the per-limit metadata
+  for (unsigned i=0; i< q.N_LIMITS; i++)
+    write_double(q.limit_constraints[i]->limit_epsilon, out);
+
+  // write the cross-constraint matrices
+  write_matrix(q.Cn_X_CnT, out);
+  write_matrix(q.Cn_X_CsT, out);
+  write_matrix(q.Cn_X_CtT, out);
+  write_matrix(q.Cn_X_LT, out);
+  write_matrix(q.Cn_X_JxT, out);
+  write_matrix(q.Cs_X_CsT, out);
+  write_matrix(q.Cs_X_CtT, out);
+  write_matrix(q.Cs_X_LT, out);
+  write_matrix(q.Cs_X_JxT, out);
+  write_matrix(q.Ct_X_CtT, out);
+  write_matrix(q.Ct_X_LT, out);
+  write_matrix(q.Ct_X_JxT, out);
+  write_matrix(q.L_X_LT, out);
+  write_matrix(q.L_X_JxT, out);
+  write_matrix(q.Jx_X_JxT, out);
+
+  // write the velocity vectors and impulse magnitudes
+  write_vector(q.Cn_v, out);
+  write_vector(q.Cs_v, out);
+  write_vector(q.Ct_v, out);
+  write_vector(q.L_v, out);
+  write_vector(q.Jx_v, out);
+  write_vector(q.cn, out);
+  write_vector(q.cs, out);
+  write_vector(q.ct, out);
+  write_vector(q.l, out);
+  write_vector(q.lambda, out);
+}
+
+/// Reads a captured constraint problem written by write()
+/**
+ * Minimal constraint objects carrying the captured friction and restitution
+ * metadata are constructed in 'constraints' and wired into the problem data,
+ * so solver backends that consult per-contact metadata (e.g., Coulomb
+ * friction bounds) operate on the captured values. 'constraints' must
+ * outlive 'q'.
+ * \return true if the problem was read successfully
+ */
+bool ContactProblemCapture::read(UnilateralConstraintProblemData& q, std::vector<UnilateralConstraint>& constraints, std::istream& in)
+{
+  // verify the magic bytes and version
+  char magic[4];
+  in.read(magic, sizeof(magic));
+  unsigned version;
+  if (in.fail() || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+    return false;
+  if (!read_unsigned(version, in) || version != VERSION)
+    return false;
+
+  // reset the problem data and read the dimensions
+  q.reset();
+  if (!read_unsigned(q.N_CONTACTS, in) || !read_unsigned(q.N_LIMITS, in) ||
+      !read_unsigned(q.N_CONSTRAINT_EQNS_IMP, in) ||
+      !read_unsigned(q.N_K_TOTAL, in) || !read_unsigned(q.N_LIN_CONE, in) ||
+      !read_unsigned(q.N_TRUE_CONE, in) || !read_unsigned(q.N_GC, in))
+    return false;
+  q.N_CONSTRAINTS = q.N_CONTACTS*5 + q.N_LIMITS;
+
+  // construct minimal constraint objects carrying the captured metadata
+  constraints.clear();
+  constraints.resize(q.N_CONTACTS + q.N_LIMITS);
+  for (unsigned i=0; i< q.N_CONTACTS; i++)
+  {
+    UnilateralConstraint& e = constraints[i];
+    e.constraint_type = UnilateralConstraint::eContact;
+    if (!read_double(e.contact_mu_coulomb, in) ||
+        !read_double(e.contact_mu_viscous, in) ||
+        !read_double(e.contact_epsilon, in) ||
+        !read_unsigned(e.contact_NK, in))
+      return false;
+    q.constraints.push_back(&e);
+    q.contact_constraints.push_back(&e);
+  }
+  for (unsigned i=0; i< q.N_LIMITS; i++)
+  {
+    UnilateralConstraint& e = constraints[q.N_CONTACTS + i];
+    e.constraint_type = UnilateralConstraint::eLimit;
+    if (!read_double(e.limit_epsilon, in))
+      return false;
+    q.constraints.push_back(&e);
+    q.limit_constraints.push_back(&e);
+  }
+
+  // read the cross-constraint matrices
+  if (!read_matrix(q.Cn_X_CnT, in) || !read_matrix(q.Cn_X_CsT, in) ||
+      !read_matrix(q.Cn_X_CtT, in) || !read_matrix(q.Cn_X_LT, in) ||
+      !read_matrix(q.Cn_X_JxT, in) || !read_matrix(q.Cs_X_CsT, in) ||
+      !read_matrix(q.Cs_X_CtT, in) || !read_matrix(q.Cs_X_LT, in) ||
+      !read_matrix(q.Cs_X_JxT, in) || !read_matrix(q.Ct_X_CtT, in) ||
+      !read_matrix(q.Ct_X_LT, in) || !read_matrix(q.Ct_X_JxT, in) ||
+      !read_matrix(q.L_X_LT, in) || !read_matrix(q.L_X_JxT, in) ||
+      !read_matrix(q.Jx_X_JxT, in))
+    return false;
+
+  // read the velocity vectors and impulse magnitudes
+  if (!read_vector(q.Cn_v, in) || !read_vector(q.Cs_v, in) ||
+      !read_vector(q.Ct_v, in) || !read_vector(q.L_v, in) ||
+      !read_vector(q.Jx_v, in) || !read_vector(q.cn, in) ||
+      !read_vector(q.cs, in) || !read_vector(q.ct, in) ||
+      !read_vector(q.l, in) || !read_vector(q.lambda, in))
+    return false;
+
+  return true;
+}
+
+/// Captures an assembled problem, if capture of all problems is enabled
+void ContactProblemCapture::capture(const UnilateralConstraintProblemData& q)
+{
+  do_capture(q, false);
+}
+
+/// Captures a problem that a solver backend failed on
+void ContactProblemCapture::capture_failure(const UnilateralConstraintProblemData& q)
+{
+  do_capture(q, true);
+}
+
+/// Writes a problem to the next '<prefix>NNNNNN[.fail].ucp' file
+void ContactProblemCapture::do_capture(const UnilateralConstraintProblemData& q, bool failure)
+{
+  static unsigned counter = 0;
+  static bool checked_env = false;
+
+  // consult the environment once if no prefix has been set programmatically
+  if (capture_prefix.empty() && !checked_env)
+  {
+    checked_env = true;
+    const char* prefix_env = std::getenv("MOBY_CONTACT_CAPTURE_PREFIX");
+    if (prefix_env)
+      capture_prefix = prefix_env;
+    if (std::getenv("MOBY_CONTACT_CAPTURE_ALL"))
+      capture_all = true;
+  }
+
+  // see whether capturing is disabled
+  if (capture_prefix.empty() || (!failure && !capture_all))
+    return;
+
+  // construct the filename
+  std::ostringstream fname;
+  fname << capture_prefix << std::setfill('0') << std::setw(6) << counter++;
+  if (failure)
+    fname << ".fail";
+  fname << ".ucp";
+
+  // write the problem
+  std::ofstream out(fname.str().c_str(), std::ofstream::binary);
+  write(q, out);
+  out.close();
+
+  FILE_LOG(LOG_CONSTRAINT) << "ContactProblemCapture: wrote " << fname.str() << std::endl;
+}
@@ -95,6 +95,11 @@ void ControlledBody::load_from_xml(shared_ptr<const XMLTree> node, std::map<std:
   // load Base data
   Visualizable::load_from_xml(node, id_map);
 
+  // read the control period, if provided
+  XMLAttrib* cp_attr = node->get_attrib("control-period");
+  if (cp_attr)
+    control_period = cp_attr->get_real_value();
+
   // get all recurrent forces used in the simulator -- note: this must be done
   // *after* all bodies have been loaded
   list<shared_ptr<const XMLTree> > child_nodes = node->find_child_nodes("RecurrentForce");
@@ -142,6 +147,9 @@ void ControlledBody::save_to_xml(XMLTreePtr node, list<shared_ptr<const Base> >&
   // rename the node
   node->name = "DynamicBody";
 
+  // save the control period
+  node->attribs.insert(XMLAttrib("control-period", control_period));
+
   // save the IDs of all recurrent forces
   BOOST_FOREACH(RecurrentForcePtr rf, _rfs)
   {
@@ -15,6 +15,7 @@
 #include <Moby/XMLTree.h>
 #include <Moby/SpherePrimitive.h>
 #include <Moby/PlanePrimitive.h>
+#include <Moby/TorusPrimitive.h>
 #include <Moby/OBB.h>
 #include <Moby/CollisionGeometry.h>
 #include <Moby/HeightmapPrimitive.h>
@@ -104,6 +105,17 @@ double CylinderPrimitive::calc_signed_dist(shared_ptr<const Primitive> p, Point3
   if (hmp)
     return hmp->calc_signed_dist(dynamic_pointer_cast<const Primitive>(shared_from_this()), pp, pthis);
 
+  // look for torus (the torus is non-convex, so GJK does not apply)
+  shared_ptr<const TorusPrimitive> torusp = dynamic_pointer_cast<const TorusPrimitive>(p);
+  if (torusp)
+    return torusp->calc_signed_dist(dynamic_pointer_cast<const CylinderPrimitive>(shared_from_this()), pp, pthis);
+
+  // look for cylinder/cylinder (closed-form closest points for the rolling
+  // lateral and parallel-axis configurations)
+  shared_ptr<const CylinderPrimitive> cylp = dynamic_pointer_cast<const CylinderPrimitive>(p);
+  if (cylp)
+    return calc_signed_dist(cylp, pthis, pp);
+
   // if the primitive is convex, can use GJK
   if (p->is_convex())
   {
@@ -335,6 +347,162 @@ double CylinderPrimitive::calc_dist(const SpherePrimitive* s, Point3d& pcyl, Poi
   return dist;
 }
 
+/// Gets the signed distance between this cylinder and another cylinder
+/**
+ * Closest points are computed in closed form from the axis segments for the
+ * configurations that dominate rolling scenes: nonparallel axes closest
+ * along their lateral surfaces, and parallel axes (side-by-side rollers,
+ * or facing caps).  Skew configurations closest at a cap have no closed
+ * form and fall back to GJK.
+ */
+double CylinderPrimitive::calc_signed_dist(shared_ptr<const CylinderPrimitive> c, Point3d& pthis, Point3d& pcyl) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  // get the transform from c's pose to this cylinder's pose
+  Transform3d T = Pose3d::calc_relative_pose(pcyl.pose, pthis.pose);
+
+  // get the cylinder half-heights
+  const double HH1 = _height * 0.5;
+  const double HH2 = c->_height * 0.5;
+
+  // this cylinder's axis is the y-axis; its axis segment starts at the
+  // bottom cap center.  Get c's axis direction and bottom cap center in
+  // this cylinder's frame.
+  Origin3d u = T.q * Origin3d(0.0, 1.0, 0.0);
+  Origin3d P2 = T.q * Origin3d(0.0, -HH2, 0.0) + T.x;
+  Origin3d P1(0.0, -HH1, 0.0);
+
+  // handle parallel axes separately (the common roller-conveyor case);
+  // this configuration is fully closed-form
+  if (std::fabs(std::fabs(u[Y]) - 1.0) < NEAR_ZERO)
+  {
+    // get the radial offset between the axes, in this cylinder's x-z plane
+    Origin3d rad(P2[X], 0.0, P2[Z]);
+    double axial_dist = rad.norm();
+
+    // get c's axial extent along y in this frame
+    double ylo = std::min(P2[Y], P2[Y] + u[Y]*c->_height);
+    double yhi = std::max(P2[Y], P2[Y] + u[Y]*c->_height);
+
+    // see whether the axial extents overlap (side-by-side rollers)
+    double olo = std::max(-HH1, ylo);
+    double ohi = std::min(HH1, yhi);
+    if (olo <= ohi)
+    {
+      // lateral contact, unless the cylinders are coaxial (in which case
+      // the separating direction is undefined and GJK takes over below)
+      if (axial_dist > NEAR_ZERO)
+      {
+        double ym = (olo + ohi) * 0.5;
+        Origin3d nhat = rad/axial_dist;
+        double dist = axial_dist - _radius - c->_radius;
+        Origin3d o1 = nhat*_radius;
+        Origin3d o2 = nhat*(axial_dist - c->_radius);
+        o1[Y] = o2[Y] = ym;
+        pthis = Point3d(o1, pthis.pose);
+        pcyl = T.inverse_transform_point(Point3d(o2, pthis.pose));
+        return dist;
+      }
+    }
+    else
+    {
+      // the caps face each other; get the axial gap and the facing caps
+      double y1f, y2f, gap;
+      if (ylo > HH1)
+      {
+        y1f = HH1;
+        y2f = ylo;
+        gap = ylo - HH1;
+      }
+      else
+      {
+        y1f = -HH1;
+        y2f = yhi;
+        gap = -HH1 - yhi;
+      }
+
+      // radial separation of the cap disks
+      double dr = axial_dist - _radius - c->_radius;
+      if (dr <= 0.0)
+      {
+        // the disks overlap radially: face/face contact along the axis;
+        // place the witness points on the overlapping portion
+        double rc = std::min(axial_dist, _radius);
+        Origin3d nhat = (axial_dist > NEAR_ZERO) ? rad/axial_dist : Origin3d(0.0, 0.0, 0.0);
+        Origin3d o1 = nhat*rc;
+        Origin3d o2 = o1;
+        o1[Y] = y1f;
+        o2[Y] = y2f;
+        pthis = Point3d(o1, pthis.pose);
+        pcyl = T.inverse_transform_point(Point3d(o2, pthis.pose));
+        return gap;
+      }
+      else
+      {
+        // rim/rim contact
+        Origin3d nhat = rad/axial_dist;
+        Origin3d o1 = nhat*_radius;
+        Origin3d o2 = nhat*(axial_dist - c->_radius);
+        o1[Y] = y1f;
+        o2[Y] = y2f;
+        pthis = Point3d(o1, pthis.pose);
+        pcyl = T.inverse_transform_point(Point3d(o2, pthis.pose));
+        return std::sqrt(dr*dr + gap*gap);
+      }
+    }
+  }
+  else
+  {
+    // nonparallel axes: get the closest points between the axis segments
+    // (unit directions, parameters clamped to [0, height])
+    double b = u[Y];
+    double f = u[X]*(P1[X]-P2[X]) + u[Y]*(P1[Y]-P2[Y]) + u[Z]*(P1[Z]-P2[Z]);
+    double cc = P1[Y] - P2[Y];
+    double denom = 1.0 - b*b;
+    double s = (b*f - cc)/denom;
+    if (s < 0.0) s = 0.0; else if (s > _height) s = _height;
+    double t = b*s + f;
+    if (t < 0.0)
+    {
+      t = 0.0;
+      s = -cc;
+      if (s < 0.0) s = 0.0; else if (s > _height) s = _height;
+    }
+    else if (t > c->_height)
+    {
+      t = c->_height;
+      s = b*t - cc;
+      if (s < 0.0) s = 0.0; else if (s > _height) s = _height;
+    }
+
+    // the lateral/lateral closed form applies when neither closest point
+    // sits at a cap
+    if (s > 0.0 && s < _height && t > 0.0 && t < c->_height)
+    {
+      Origin3d a1 = P1;
+      a1[Y] += s;
+      Origin3d a2 = P2 + u*t;
+      Origin3d dvec = a1 - a2;
+      double dn = dvec.norm();
+      if (dn > NEAR_ZERO)
+      {
+        Origin3d nhat = dvec/dn;
+        double dist = dn - _radius - c->_radius;
+        pthis = Point3d(a1 - nhat*_radius, pthis.pose);
+        pcyl = T.inverse_transform_point(Point3d(a2 + nhat*c->_radius, pthis.pose));
+        return dist;
+      }
+    }
+  }
+
+  // no closed form for this configuration; use GJK
+  shared_ptr<const Pose3d> Pthis = pthis.pose;
+  shared_ptr<const Pose3d> Pc = pcyl.pose;
+  shared_ptr<const Primitive> cthis = dynamic_pointer_cast<const Primitive>(shared_from_this());
+  return GJK::do_gjk(cthis, c, Pthis, Pc, pthis, pcyl);
+}
+
 /// Sets the radius for this cylinder
 void CylinderPrimitive::set_radius(double radius)
 {
@@ -682,6 +850,90 @@ bool CylinderPrimitive::point_inside(const Point3d& p, Vector3d& normal) const
   return true;
 }
 
+/// Casts a ray against the cylinder (analytic)
+bool CylinderPrimitive::ray_cast(const Point3d& origin, const Vector3d& dir, double max_dist, double& t, Vector3d& normal) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+  const double INF = std::numeric_limits<double>::max();
+  const double R = _radius;
+  const double halfheight = _height*0.5;
+
+  assert(_poses.find(const_pointer_cast<Pose3d>(origin.pose)) != _poses.end());
+
+  // best intersection found so far
+  double tbest = INF;
+  bool lateral_hit = false;
+  double cap_sign = 0.0;
+
+  // intersect with the (infinite) lateral surface:
+  // (ox + t*dx)^2 + (oz + t*dz)^2 = R^2
+  double A = dir[X]*dir[X] + dir[Z]*dir[Z];
+  if (A > NEAR_ZERO)
+  {
+    double B = 2.0*(origin[X]*dir[X] + origin[Z]*dir[Z]);
+    double C = origin[X]*origin[X] + origin[Z]*origin[Z] - R*R;
+    double disc = B*B - 4.0*A*C;
+    if (disc >= 0.0)
+    {
+      double rt = std::sqrt(disc);
+      for (int i=0; i< 2; i++)
+      {
+        double tc = (i == 0) ? (-B - rt)/(2.0*A) : (-B + rt)/(2.0*A);
+        if (tc >= 0.0 && tc < tbest)
+        {
+          // accept the root only between the endcaps
+          double y = origin[Y] + dir[Y]*tc;
+          if (std::fabs(y) <= halfheight)
+          {
+            tbest = tc;
+            lateral_hit = true;
+          }
+        }
+      }
+    }
+  }
+
+  // intersect with the endcap planes y = +/- halfheight
+  if (std::fabs(dir[Y]) > NEAR_ZERO)
+    for (int i=0; i< 2; i++)
+    {
+      double cap_y = (i == 0) ? halfheight : -halfheight;
+      double tc = (cap_y - origin[Y])/dir[Y];
+      if (tc >= 0.0 && tc < tbest)
+      {
+        // accept the root only within the cap disk
+        double x = origin[X] + dir[X]*tc;
+        double z = origin[Z] + dir[Z]*tc;
+        if (x*x + z*z <= R*R)
+        {
+          tbest = tc;
+          lateral_hit = false;
+          cap_sign = (i == 0) ? 1.0 : -1.0;
+        }
+      }
+    }
+
+  // see whether the nearest intersection is within range
+  if (tbest > max_dist)
+    return false;
+  t = tbest;
+
+  // compute the outward normal of the hit feature
+  if (lateral_hit)
+  {
+    Point3d p = origin + dir*t;
+    normal = Vector3d::normalize(Vector3d(p[X], 0.0, p[Z], origin.pose));
+  }
+  else
+    normal = Vector3d(0.0, cap_sign, 0.0, origin.pose);
+
+  // orient the normal against the ray (for rays cast from inside)
+  if (normal.dot(dir) > 0.0)
+    normal = -normal;
+
+  return true;
+}
+
 /// Computes the signed distance of a point from the cylinder
 double CylinderPrimitive::calc_signed_dist(const Point3d& p) const
 {
@@ -718,12 +970,50 @@ double CylinderPrimitive::calc_signed_dist(const Point3d& p) const
   if (cdist_sq > 0.0)
     return std::sqrt(cdist_sq);
 
-  // point is within cylinder: find minimum point of interpenetration 
+  // point is within cylinder: find minimum point of interpenetration
   double dist = std::min(std::min(-dcaptop, -dcapbot), std::sqrt(-cdist_sq));
 
   return -dist;
 }
 
+/// Computes the signed distances of a batch of points from the cylinder
+/**
+ * All points must be defined in the same pose; the pose is verified once and
+ * the radius and half-height are hoisted out of the distance loop.
+ */
+void CylinderPrimitive::calc_signed_dists(const Point3d* points, unsigned n, double* dists) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+  const double R = _radius;
+  const double halfheight = _height*0.5;
+
+  if (n == 0)
+    return;
+  assert(_poses.find(const_pointer_cast<Pose3d>(points[0].pose)) != _poses.end());
+
+  for (unsigned i=0; i< n; i++)
+  {
+    const Point3d& p = points[i];
+
+    // compute distances from top and bottom of cylinder and main axis
+    double dcaptop = p[Y] - halfheight;
+    double dcapbot = -halfheight - p[Y];
+    double cdist_sq = p[X]*p[X] + p[Z]*p[Z] - R*R;
+
+    // check whether point is above or below endcaps
+    if (dcaptop > 0.0)
+      dists[i] = (cdist_sq > 0.0) ? std::sqrt(dcaptop*dcaptop + cdist_sq) : dcaptop;
+    else if (dcapbot > 0.0)
+      dists[i] = (cdist_sq > 0.0) ? std::sqrt(dcapbot*dcapbot + cdist_sq) : dcapbot;
+    // point is within endcaps; check to see whether it is outside cylinder
+    else if (cdist_sq > 0.0)
+      dists[i] = std::sqrt(cdist_sq);
+    // point is within cylinder: find minimum point of interpenetration
+    else
+      dists[i] = -std::min(std::min(-dcaptop, -dcapbot), std::sqrt(-cdist_sq));
+  }
+}
+
 /// Gets the distance of a point within the cylinder
 /**
  * Returns -INF for points outside the cylinder.
@@ -111,6 +111,21 @@ void DampingForce::add_force(shared_ptr<DynamicBodyd> body)
   }
 }
 
+/// Adds damping to a batch of bodies in one pass
+/**
+ * The damping wrench depends only on the body it acts on (the coefficient
+ * maps are read-only here), so the bodies can be processed in parallel:
+ * each application reads and writes only its own body.
+ */
+void DampingForce::add_force_batch(const std::vector<shared_ptr<DynamicBodyd> >& bodies)
+{
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+  #endif
+  for (int i=0; i< (int) bodies.size(); i++)
+    add_force(bodies[i]);
+}
+
 /// Implements Base::load_from_xml()
 void DampingForce::load_from_xml(shared_ptr<const XMLTree> node, map<std::string, BasePtr>& id_map)
 {
@@ -0,0 +1,308 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <cmath>
+#include <strings.h>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#ifdef USE_OSG
+#include <osg/Group>
+#endif
+#include <Moby/Constants.h>
+#include <Moby/XMLTree.h>
+#include <Moby/TessellatedPolyhedron.h>
+#include <Moby/DistanceFieldPrimitive.h>
+
+using namespace Ravelin;
+using namespace Moby;
+using boost::shared_ptr;
+using boost::const_pointer_cast;
+using boost::dynamic_pointer_cast;
+using std::vector;
+using std::map;
+using std::pair;
+
+/// Constructs an empty distance field primitive
+DistanceFieldPrimitive::DistanceFieldPrimitive()
+{
+  _max_recursion = 6;
+  _epsilon = 1e-3;
+}
+
+/// Bakes a triangle mesh into an adaptive distance field
+void DistanceFieldPrimitive::build_from_mesh(const IndexedTriArray& mesh, unsigned max_recursion, double epsilon)
+{
+  // keep the source mesh (for get_mesh() and vertex queries)
+  _mesh = shared_ptr<const IndexedTriArray>(new IndexedTriArray(mesh));
+
+  // bake the field
+  TessellatedPolyhedron poly(mesh);
+  _field = ADF::build_ADF(poly, max_recursion, epsilon);
+  _max_recursion = max_recursion;
+  _epsilon = epsilon;
+
+  // flatten the octree for querying
+  _flat = shared_ptr<FlatADF>(new FlatADF(_field));
+
+  // invalidate bounding volumes computed from any previous field
+  _obbs.clear();
+}
+
+/// Sets the distance field directly (e.g., one loaded via ADF::load_from_file())
+void DistanceFieldPrimitive::set_distance_field(shared_ptr<ADF> field)
+{
+  _field = field;
+  _flat = shared_ptr<FlatADF>(new FlatADF(_field));
+  _obbs.clear();
+}
+
+/// Queries the field at a point, clamping points outside the field bounds
+/**
+ * \param p the query point, in the frame of the field
+ * \param cp the point clamped to the field bounds is returned here
+ * \return the interpolated signed distance, plus the distance from p to the
+ *         field bounds when p lies outside them
+ */
+double DistanceFieldPrimitive::query_field(const Point3d& p, Vector3d& cp) const
+{
+  assert(_flat);
+
+  // get the field bounds
+  Vector3d lo, hi;
+  _flat->get_bounds(lo, hi);
+
+  // clamp the point to the bounds
+  cp = Vector3d(p[0], p[1], p[2]);
+  double extra_sq = 0.0;
+  for (unsigned i=0; i< 3; i++)
+  {
+    if (cp[i] < lo[i])
+    {
+      extra_sq += (lo[i] - cp[i])*(lo[i] - cp[i]);
+      cp[i] = lo[i];
+    }
+    else if (cp[i] > hi[i])
+    {
+      extra_sq += (cp[i] - hi[i])*(cp[i] - hi[i]);
+      cp[i] = hi[i];
+    }
+  }
+
+  // interpolate, adding the out-of-bounds distance (if any)
+  return _flat->calc_signed_distance(cp) + std::sqrt(extra_sq);
+}
+
+/// Computes the signed distance from the field to a point
+double DistanceFieldPrimitive::calc_signed_dist(const Point3d& p) const
+{
+  Vector3d cp;
+  return query_field(p, cp);
+}
+
+/// Computes the signed distance and normal from the field to a point
+double DistanceFieldPrimitive::calc_dist_and_normal(const Point3d& point, std::vector<Vector3d>& normals) const
+{
+  // compute the distance
+  Vector3d cp;
+  double d = query_field(point, cp);
+
+  // get the field gradient at the (clamped) point
+  Vector3d grad = _flat->determine_normal(cp);
+
+  // setup the normal in the frame of the query point
+  normals.push_back(Vector3d(grad[0], grad[1], grad[2], point.pose));
+
+  return d;
+}
+
+/// Computes the signed distance between this primitive and another
+double DistanceFieldPrimitive::calc_signed_dist(shared_ptr<const Primitive> p, Point3d& pthis, Point3d& pp) const
+{
+  // get p as non-const
+  shared_ptr<Primitive> pnc = const_pointer_cast<Primitive>(p);
+
+  // no specialization: sample the other primitive's vertices against the
+  // field, tracking the minimum interpolated distance
+  vector<Point3d> verts;
+  pnc->get_vertices(pp.pose, verts);
+  double mindist = std::numeric_limits<double>::max();
+  for (unsigned i=0; i< verts.size(); i++)
+  {
+    // query the field at the vertex
+    Point3d pt = Pose3d::transform_point(pthis.pose, verts[i]);
+    Vector3d cp;
+    double d = query_field(pt, cp);
+    if (d < mindist)
+    {
+      mindist = d;
+      pp = verts[i];
+
+      // project the vertex along the field gradient onto the zero level set
+      Vector3d grad = _flat->determine_normal(cp);
+      pthis = pt - Vector3d(grad[0], grad[1], grad[2], pthis.pose)*d;
+    }
+  }
+
+  return mindist;
+}
+
+/// Gets the vertices of the field (the corners of its bounding box)
+void DistanceFieldPrimitive::get_vertices(shared_ptr<const Pose3d> P, std::vector<Point3d>& vertices) const
+{
+  vertices.clear();
+  if (!_flat)
+    return;
+
+  // get the field bounds
+  Vector3d lo, hi;
+  _flat->get_bounds(lo, hi);
+
+  // add the eight corners
+  for (unsigned i=0; i< 8; i++)
+  {
+    const double x = (i & 1) ? hi[0] : lo[0];
+    const double y = (i & 2) ? hi[1] : lo[1];
+    const double z = (i & 4) ? hi[2] : lo[2];
+    vertices.push_back(Point3d(x, y, z, P));
+  }
+}
+
+/// Creates the visualization for this primitive
+osg::Node* DistanceFieldPrimitive::create_visualization()
+{
+  // the field itself has no natural visualization; environment geometry
+  // ordinarily pairs this primitive with a separate visualization node
+  #ifdef USE_OSG
+  return new osg::Group;
+  #else
+  return NULL;
+  #endif
+}
+
+/// Gets the source mesh the field was baked from (if any)
+shared_ptr<const IndexedTriArray> DistanceFieldPrimitive::get_mesh(shared_ptr<const Pose3d> P)
+{
+  return _mesh;
+}
+
+/// Gets the radius of the bounding sphere centered at the field frame origin
+double DistanceFieldPrimitive::get_bounding_radius() const
+{
+  if (!_flat)
+    return 0.0;
+
+  // get the field bounds
+  Vector3d lo, hi;
+  _flat->get_bounds(lo, hi);
+
+  return std::max(lo.norm(), hi.norm());
+}
+
+/// Gets the root bounding volume for this primitive
+BVPtr DistanceFieldPrimitive::get_BVH_root(CollisionGeometryPtr geom)
+{
+  // get the pointer to the bounding volume
+  shared_ptr<OBB>& obb = _obbs[geom];
+
+  // if the OBB hasn't been created, create it and initialize it
+  if (!obb)
+  {
+    // create the OBB
+    obb = shared_ptr<OBB>(new OBB);
+    obb->geom = geom;
+
+    // get the pose for the geometry
+    shared_ptr<const Pose3d> P = get_pose(geom);
+
+    // get the field bounds
+    Vector3d lo(0.0, 0.0, 0.0), hi(0.0, 0.0, 0.0);
+    if (_flat)
+      _flat->get_bounds(lo, hi);
+
+    // setup the OBB from the (axis-aligned) field bounds
+    obb->R.set_identity();
+    obb->center = Point3d((lo[0]+hi[0])*0.5, (lo[1]+hi[1])*0.5, (lo[2]+hi[2])*0.5, P);
+    obb->l = Vector3d((hi[0]-lo[0])*0.5, (hi[1]-lo[1])*0.5, (hi[2]-lo[2])*0.5, P);
+  }
+
+  return obb;
+}
+
+/// Implements Base::load_from_xml() for serialization
+void DistanceFieldPrimitive::load_from_xml(shared_ptr<const XMLTree> node, map<std::string, BasePtr>& id_map)
+{
+  // verify that the node type is DistanceField
+  assert(strcasecmp(node->name.c_str(), "DistanceField") == 0);
+
+  // load the parent data
+  Primitive::load_from_xml(node, id_map);
+
+  // read the bake parameters, if specified
+  XMLAttrib* rec_attr = node->get_attrib("max-recursion");
+  if (rec_attr)
+    _max_recursion = rec_attr->get_unsigned_value();
+  XMLAttrib* eps_attr = node->get_attrib("epsilon");
+  if (eps_attr)
+    _epsilon = eps_attr->get_real_value();
+
+  // read the baked field file name, if specified
+  XMLAttrib* field_attr = node->get_attrib("filename");
+  if (field_attr)
+    _field_fname = field_attr->get_string_value();
+
+  // read the source mesh file name, if specified
+  XMLAttrib* mesh_attr = node->get_attrib("mesh-filename");
+  if (mesh_attr)
+    _mesh_fname = mesh_attr->get_string_value();
+
+  // prefer a previously baked field; bake from the mesh only when the field
+  // file is absent, and save the bake so subsequent loads skip it
+  std::ifstream field_in(_field_fname.c_str());
+  if (!_field_fname.empty() && !field_in.fail())
+  {
+    field_in.close();
+
+    // a flattened bake memory-maps directly; the legacy text format is
+    // parsed into an octree and flattened in core
+    if (FlatADF::is_flat_field_file(_field_fname))
+    {
+      _flat = FlatADF::load_from_file(_field_fname);
+      _field.reset();
+      _obbs.clear();
+    }
+    else
+      set_distance_field(ADF::load_from_file(_field_fname));
+    if (!_mesh_fname.empty())
+      _mesh = shared_ptr<const IndexedTriArray>(new IndexedTriArray(IndexedTriArray::read_from_obj(_mesh_fname)));
+  }
+  else if (!_mesh_fname.empty())
+  {
+    build_from_mesh(IndexedTriArray::read_from_obj(_mesh_fname), _max_recursion, _epsilon);
+    if (!_field_fname.empty())
+      _flat->save_to_file(_field_fname);
+  }
+  else
+    std::cerr << "DistanceFieldPrimitive::load_from_xml() - neither a baked field nor a source mesh was given!" << std::endl;
+}
+
+/// Implements Base::save_to_xml() for serialization
+void DistanceFieldPrimitive::save_to_xml(XMLTreePtr node, std::list<shared_ptr<const Base> >& shared_objects) const
+{
+  // save the parent data
+  Primitive::save_to_xml(node, shared_objects);
+
+  // (re)set the node name
+  node->name = "DistanceField";
+
+  // save the file names and bake parameters
+  if (!_field_fname.empty())
+    node->attribs.insert(XMLAttrib("filename", _field_fname));
+  if (!_mesh_fname.empty())
+    node->attribs.insert(XMLAttrib("mesh-filename", _mesh_fname));
+  node->attribs.insert(XMLAttrib("max-recursion", _max_recursion));
+  node->attribs.insert(XMLAttrib("epsilon", _epsilon));
+}
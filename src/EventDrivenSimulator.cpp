@@ -47,6 +47,14 @@ EventDrivenSimulator::EventDrivenSimulator()
 {
   // setup the standard Euler step
   euler_step = 1e-3;
+
+  // do not cache event-time estimates by default
+  use_event_queue = false;
+
+  // share one contact force history between the impact handler and the
+  // sustained contact handler so that each warm starts from the other's
+  // solutions over persistent contacts
+  _rigid_unilateral_constraint_handler.contact_force_history = _impact_constraint_handler.contact_force_history;
 }
 
 /// Compares two unilateral constraints for purposes of mapping velocity tolerances
@@ -315,6 +323,10 @@ double EventDrivenSimulator::step(double step_size)
   _transient_vdata->removeChildren(0, _transient_vdata->getNumChildren());
   #endif
 
+  // fast-forward over the step if the scene is quiescent
+  if (try_fast_forward(step_size))
+    return step_size;
+
   // setup the time stepped
   double h = 0.0;
 
@@ -374,6 +386,10 @@ double EventDrivenSimulator::step(double step_size)
     find_unilateral_constraints(contact_dist_thresh);
     calc_impacting_unilateral_constraint_forces(-1.0);
 
+    // impulses may have changed trajectories; drop affected event estimates
+    if (use_event_queue)
+      invalidate_event_estimates();
+
 restart_with_new_limits:
 
     // mark velocity estimates as valid
@@ -405,13 +421,22 @@ restart_with_new_limits:
       // if limits were exceeded during integration, compute the conservative
       // advancement step and redo
       if (istat == eVelocityLimitExceeded)
+      {
+        // certificates computed under the old velocity limit estimates are
+        // no longer trustworthy
+        if (use_event_queue)
+          clear_event_estimates();
         goto restart_with_new_limits;
+      }
       else if (istat == eMinStepReached)
       {
         // do Euler step; if we're here, we know euler_step < dt
         step_si_Euler(euler_step);
         h += euler_step;
 
+        // the semi-implicit step applies its own impulses
+        if (use_event_queue)
+          clear_event_estimates();
       }
       else
       {
@@ -682,8 +707,26 @@ double EventDrivenSimulator::calc_CA_step()
     if (!ab)
       continue;
 
+    // use the cached certificate, if one is live; entries for bodies whose
+    // trajectories changed were dropped when the impulses were applied
+    if (use_event_queue)
+    {
+      map<ControlledBodyPtr, double>::const_iterator ji = _joint_event_times.find(db);
+      if (ji != _joint_event_times.end() && ji->second > current_time)
+      {
+        dt = std::min(dt, ji->second - current_time);
+        continue;
+      }
+    }
+
     // compute best dt
-    dt = std::min(dt, ab->calc_CA_time_for_joints());
+    double joint_dt = ab->calc_CA_time_for_joints();
+
+    // cache the certificate as an absolute event-time lower bound
+    if (use_event_queue && joint_dt > 0.0)
+      _joint_event_times[db] = current_time + joint_dt;
+
+    dt = std::min(dt, joint_dt);
     if (dt <= 0.0)
       return dt;
   }
@@ -694,24 +737,101 @@ double EventDrivenSimulator::calc_CA_step()
     // only process if neither of the bodies is compliant
     RigidBodyPtr rba = dynamic_pointer_cast<RigidBody>(pdi.a->get_single_body());
     RigidBodyPtr rbb = dynamic_pointer_cast<RigidBody>(pdi.b->get_single_body());
-    if (rba->compliance == RigidBody::eCompliant || 
+    if (rba->compliance == RigidBody::eCompliant ||
         rbb->compliance == RigidBody::eCompliant)
-      continue; 
+      continue;
 
     // if the distance between the two is zero, two are in contact already
     if (pdi.dist < contact_dist_thresh)
       return 0.0;
 
+    // if the pair holds a live certificate, it cannot generate an event
+    // before the queue front does; its contribution is folded in below
+    Ravelin::sorted_pair<CollisionGeometryPtr> key = Ravelin::make_sorted_pair(pdi.a, pdi.b);
+    if (use_event_queue)
+    {
+      map<Ravelin::sorted_pair<CollisionGeometryPtr>, PairEventQueue::iterator>::iterator qi = _pair_event_queue_pos.find(key);
+      if (qi != _pair_event_queue_pos.end() && qi->second->first > current_time)
+        continue;
+    }
+
     // call conservative advancement method
     double step = _coldet->calc_CA_step(pdi);
+
+    // (re)queue the pair at its new certified event time
+    if (use_event_queue && step > 0.0)
+    {
+      map<Ravelin::sorted_pair<CollisionGeometryPtr>, PairEventQueue::iterator>::iterator qi = _pair_event_queue_pos.find(key);
+      if (qi != _pair_event_queue_pos.end())
+        _pair_event_queue.erase(qi->second);
+      _pair_event_queue_pos[key] = _pair_event_queue.insert(make_pair(current_time + step, key));
+    }
+
     dt = std::min(dt, step);
     if (dt <= 0.0)
       return dt;
   }
 
+  // the queue front bounds the earliest event over all certified pairs
+  if (use_event_queue && !_pair_event_queue.empty())
+    dt = std::min(dt, _pair_event_queue.begin()->first - current_time);
+
   return dt;
 }
 
+/// Removes event-time estimates for bodies whose trajectories just changed
+/**
+ * Called after impulses are applied: a cached conservative-advancement
+ * certificate is only a valid event-time lower bound while the motion it was
+ * computed under persists, so certificates involving any body that received
+ * an impulse are dropped and will be recomputed on the next event-location
+ * pass.  Certificates for undisturbed bodies remain live.
+ */
+void EventDrivenSimulator::invalidate_event_estimates()
+{
+  // collect the super bodies affected by the just-processed constraints
+  set<shared_ptr<DynamicBodyd> > changed;
+  BOOST_FOREACH(const UnilateralConstraint& e, _rigid_constraints)
+    e.get_super_bodies(std::inserter(changed, changed.begin()));
+  BOOST_FOREACH(const UnilateralConstraint& e, _compliant_constraints)
+    e.get_super_bodies(std::inserter(changed, changed.begin()));
+
+  // nothing to drop if no bodies were disturbed
+  if (changed.empty())
+    return;
+
+  // drop joint-limit certificates for changed bodies
+  for (map<ControlledBodyPtr, double>::iterator i = _joint_event_times.begin(); i != _joint_event_times.end(); )
+  {
+    if (changed.find(dynamic_pointer_cast<DynamicBodyd>(i->first)) != changed.end())
+      _joint_event_times.erase(i++);
+    else
+      i++;
+  }
+
+  // drop pair certificates involving changed bodies
+  for (map<Ravelin::sorted_pair<CollisionGeometryPtr>, PairEventQueue::iterator>::iterator i = _pair_event_queue_pos.begin(); i != _pair_event_queue_pos.end(); )
+  {
+    shared_ptr<DynamicBodyd> sb1 = i->first.first->get_single_body()->get_super_body();
+    shared_ptr<DynamicBodyd> sb2 = i->first.second->get_single_body()->get_super_body();
+    if (changed.find(sb1) != changed.end() || changed.find(sb2) != changed.end())
+    {
+      _pair_event_queue.erase(i->second);
+      _pair_event_queue_pos.erase(i++);
+    }
+    else
+      i++;
+  }
+}
+
+/// Removes all cached event-time estimates
+void EventDrivenSimulator::clear_event_estimates()
+{
+  _pair_event_queue.clear();
+  _pair_event_queue_pos.clear();
+  _joint_event_times.clear();
+}
+
 void EventDrivenSimulator::reset_limit_estimates() const
 {
   // now compute the bounds
@@ -738,6 +858,11 @@ void EventDrivenSimulator::load_from_xml(shared_ptr<const XMLTree> node, map<std
   XMLAttrib* Euler_step_attrib = node->get_attrib("Euler-step");
   if (Euler_step_attrib)
     euler_step = Euler_step_attrib->get_real_value();
+
+  // read whether to cache event-time estimates in a predictive queue
+  XMLAttrib* event_queue_attrib = node->get_attrib("use-event-queue");
+  if (event_queue_attrib)
+    use_event_queue = event_queue_attrib->get_bool_value();
 }
 
 /// Implements Base::save_to_xml()
@@ -751,6 +876,9 @@ void EventDrivenSimulator::save_to_xml(XMLTreePtr node, list<shared_ptr<const Ba
 
   // save the maximum Euler step
   node->attribs.insert(XMLAttrib("Euler-step", euler_step));
+
+  // save whether event-time estimates are cached
+  node->attribs.insert(XMLAttrib("use-event-queue", use_event_queue));
 }
 
 
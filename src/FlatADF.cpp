@@ -0,0 +1,395 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <Moby/Constants.h>
+#include <Moby/Log.h>
+#include <Moby/ADF.h>
+#include <Moby/FlatADF.h>
+
+using namespace boost;
+using namespace Ravelin;
+using namespace Moby;
+
+// the number of children/corner distances per cell
+static const unsigned OCT_CHILDREN = 8;
+static const unsigned BOX_VERTICES = 8;
+
+// file format: a 64-byte header (magic, version, cell count, leaf count,
+// then the root lo/hi bounds) followed by the cell array and the packed
+// leaf-distance array; both arrays land eight-byte aligned
+static const unsigned FLAT_ADF_MAGIC = 0x46414446;   // "FADF"
+static const unsigned FLAT_ADF_VERSION = 1;
+
+struct FlatADFHeader
+{
+  unsigned magic;
+  unsigned version;
+  unsigned num_cells;
+  unsigned num_leafs;
+  double lo[3];
+  double hi[3];
+};
+
+/// Constructs an empty flattened ADF
+FlatADF::FlatADF()
+{
+  for (unsigned i=0; i< 3; i++)
+    _lo[i] = _hi[i] = 0.0;
+  _cells = NULL;
+  _dists = NULL;
+  _num_cells = _num_leafs = 0;
+  _mapping = NULL;
+  _mapping_len = 0;
+  _fd = -1;
+}
+
+/// Constructs a flattened ADF from a finished octree
+FlatADF::FlatADF(shared_ptr<const ADF> root)
+{
+  _cells = NULL;
+  _dists = NULL;
+  _num_cells = _num_leafs = 0;
+  _mapping = NULL;
+  _mapping_len = 0;
+  _fd = -1;
+  build(root);
+}
+
+FlatADF::~FlatADF()
+{
+  unload();
+}
+
+/// Releases the file mapping, if any
+void FlatADF::unload()
+{
+  if (_mapping)
+    munmap(_mapping, _mapping_len);
+  if (_fd >= 0)
+    close(_fd);
+  _mapping = NULL;
+  _mapping_len = 0;
+  _fd = -1;
+  _cells = NULL;
+  _dists = NULL;
+  _num_cells = _num_leafs = 0;
+}
+
+/// Flattens a finished ADF octree into the linear layout
+/**
+ * Cells are visited breadth-first so that the eight children of any cell are
+ * contiguous in the array; only the subvolume index need be added to the
+ * parent's first-child index during a descent.  Only leaf cells contribute
+ * corner distances (the octree clears internal distances after subdivision).
+ */
+void FlatADF::build(shared_ptr<const ADF> root)
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  // release any prior contents
+  unload();
+  _cell_storage.clear();
+  _dist_storage.clear();
+
+  // record the root bounds
+  Vector3d lo, hi;
+  root->get_bounds(lo, hi);
+  _lo[X] = lo[X];  _lo[Y] = lo[Y];  _lo[Z] = lo[Z];
+  _hi[X] = hi[X];  _hi[Y] = hi[Y];  _hi[Z] = hi[Z];
+
+  // order the cells breadth-first; children are appended together, so each
+  // cell's eight children are contiguous
+  std::vector<shared_ptr<const ADF> > order;
+  order.push_back(root);
+  for (unsigned idx = 0; idx < order.size(); idx++)
+  {
+    shared_ptr<const ADF> cell = order[idx];
+    FlatCell fc;
+    fc.first_child = 0;
+    fc.dist_ofs = 0;
+    if (cell->is_leaf())
+    {
+      // pack the leaf's corner distances
+      const std::vector<double>& distances = cell->get_distances();
+      assert(distances.size() == BOX_VERTICES);
+      fc.dist_ofs = (unsigned) _dist_storage.size();
+      _dist_storage.insert(_dist_storage.end(), distances.begin(), distances.end());
+      _num_leafs++;
+    }
+    else
+    {
+      // the root is cell zero, so zero can double as the leaf marker
+      fc.first_child = (unsigned) order.size();
+      const std::vector<shared_ptr<ADF> >& children = cell->get_children();
+      for (unsigned i=0; i< OCT_CHILDREN; i++)
+        order.push_back(children[i]);
+    }
+    _cell_storage.push_back(fc);
+  }
+
+  // point the query arrays at the in-core storage
+  _cells = &_cell_storage.front();
+  _dists = &_dist_storage.front();
+  _num_cells = (unsigned) _cell_storage.size();
+
+  FILE_LOG(LOG_ADF) << "FlatADF::build() - flattened " << _num_cells << " cells (" << _num_leafs << " leaves)" << std::endl;
+}
+
+/// Determines whether the given point is within the root bounding box
+bool FlatADF::contains(const Vector3d& point) const
+{
+  const unsigned THREE_D = 3;
+
+  for (unsigned i=0; i< THREE_D; i++)
+    if (point[i] < _lo[i] || point[i] > _hi[i])
+      return false;
+
+  return true;
+}
+
+/// Gets the root bounds of the flattened octree
+void FlatADF::get_bounds(Vector3d& lo, Vector3d& hi) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+  lo = Vector3d(_lo[X], _lo[Y], _lo[Z], GLOBAL);
+  hi = Vector3d(_hi[X], _hi[Y], _hi[Z], GLOBAL);
+}
+
+/// Descends to the leaf containing a point, reconstructing its bounds
+/**
+ * \param lo on return, the lower bounds of the leaf
+ * \param hi on return, the upper bounds of the leaf
+ * \return the index of the leaf cell
+ */
+unsigned FlatADF::find_leaf(const Vector3d& point, double lo[3], double hi[3]) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  // the subvolume index for each (x,y,z) half, matching the octree's
+  // subdivision order:
+  //      6---7
+  //     /|  /|
+  //    3---5 |
+  //    | 2-|-4
+  //    |/  |/
+  //    0---1
+  static const unsigned SUBVOL[2][2][2] = {{{0, 2}, {3, 6}}, {{1, 4}, {5, 7}}};
+
+  // start the descent at the root
+  lo[X] = _lo[X];  lo[Y] = _lo[Y];  lo[Z] = _lo[Z];
+  hi[X] = _hi[X];  hi[Y] = _hi[Y];  hi[Z] = _hi[Z];
+  unsigned idx = 0;
+  while (_cells[idx].first_child != 0)
+  {
+    // determine which half of each axis the point falls in and shrink the
+    // bounds to the corresponding octant
+    const double half_x = 0.5*(lo[X] + hi[X]);
+    const double half_y = 0.5*(lo[Y] + hi[Y]);
+    const double half_z = 0.5*(lo[Z] + hi[Z]);
+    const unsigned hx = (point[X] < half_x) ? 0 : 1;
+    const unsigned hy = (point[Y] < half_y) ? 0 : 1;
+    const unsigned hz = (point[Z] < half_z) ? 0 : 1;
+    if (hx) lo[X] = half_x; else hi[X] = half_x;
+    if (hy) lo[Y] = half_y; else hi[Y] = half_y;
+    if (hz) lo[Z] = half_z; else hi[Z] = half_z;
+
+    // move to the child
+    idx = _cells[idx].first_child + SUBVOL[hx][hy][hz];
+  }
+
+  return idx;
+}
+
+/// Performs trilinear interpolation over a leaf's packed corner distances
+double FlatADF::interp(unsigned leaf, const double lo[3], const double hi[3], double px, double py, double pz) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  // get the leaf's corner distances (vertex order matches ADF)
+  const double* q = _dists + _cells[leaf].dist_ofs;
+
+  // get distance from the bounds of the cube in each direction
+  const double dHIx = hi[X] - px;
+  const double dLOx = px - lo[X];
+  const double dHIy = hi[Y] - py;
+  const double dLOy = py - lo[Y];
+  const double dHIz = hi[Z] - pz;
+  const double dLOz = pz - lo[Z];
+
+  // compute the interpolated value
+  double value = 0.0;
+  value += q[0] * dHIx * dHIy * dHIz;
+  value += q[1] * dLOx * dHIy * dHIz;
+  value += q[2] * dHIx * dHIy * dLOz;
+  value += q[3] * dHIx * dLOy * dHIz;
+  value += q[4] * dLOx * dHIy * dLOz;
+  value += q[5] * dLOx * dLOy * dHIz;
+  value += q[6] * dHIx * dLOy * dLOz;
+  value += q[7] * dLOx * dLOy * dLOz;
+
+  // scale the value by the lengths of the sides
+  value /= (hi[X] - lo[X]) * (hi[Y] - lo[Y]) * (hi[Z] - lo[Z]);
+
+  return value;
+}
+
+/// Computes the signed distance at a point using trilinear interpolation
+double FlatADF::calc_signed_distance(const Vector3d& point) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  // the point must be within the field
+  assert(_cells);
+  assert(contains(point));
+
+  // find the leaf containing the point and interpolate over it
+  double lo[3], hi[3];
+  unsigned leaf = find_leaf(point, lo, hi);
+  return interp(leaf, lo, hi, point[X], point[Y], point[Z]);
+}
+
+/// Determines the normal to the surface at a point
+/**
+ * \note this uses the method defined by Frisken et al. [2000]
+ */
+Vector3d FlatADF::determine_normal(const Vector3d& point) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  // find the leaf cell containing the point
+  double lo[3], hi[3];
+  unsigned leaf = find_leaf(point, lo, hi);
+
+  // calculate the signed distance at the point projected to all six facets
+  // of the cell
+  double left = interp(leaf, lo, hi, lo[X], point[Y], point[Z]);
+  double right = interp(leaf, lo, hi, hi[X], point[Y], point[Z]);
+  double up = interp(leaf, lo, hi, point[X], hi[Y], point[Z]);
+  double down = interp(leaf, lo, hi, point[X], lo[Y], point[Z]);
+  double front = interp(leaf, lo, hi, point[X], point[Y], hi[Z]);
+  double back = interp(leaf, lo, hi, point[X], point[Y], lo[Z]);
+
+  // compute the gradient at this point
+  return Vector3d::normalize(Vector3d(right - left, up - down, front - back));
+}
+
+/// Writes the flattened layout to a binary file
+/**
+ * The file holds the in-memory layout verbatim, so load_from_file() can map
+ * it directly.
+ */
+void FlatADF::save_to_file(const std::string& filename) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  // compose the header
+  FlatADFHeader header;
+  header.magic = FLAT_ADF_MAGIC;
+  header.version = FLAT_ADF_VERSION;
+  header.num_cells = _num_cells;
+  header.num_leafs = _num_leafs;
+  header.lo[X] = _lo[X];  header.lo[Y] = _lo[Y];  header.lo[Z] = _lo[Z];
+  header.hi[X] = _hi[X];  header.hi[Y] = _hi[Y];  header.hi[Z] = _hi[Z];
+
+  // write the header and the two arrays
+  std::ofstream out(filename.c_str(), std::ios::binary);
+  if (!out)
+  {
+    std::cerr << "FlatADF::save_to_file() - unable to open " << filename << std::endl;
+    return;
+  }
+  out.write((const char*) &header, sizeof(header));
+  out.write((const char*) _cells, (std::streamsize) (_num_cells*sizeof(FlatCell)));
+  out.write((const char*) _dists, (std::streamsize) (_num_leafs*BOX_VERTICES*sizeof(double)));
+  out.close();
+
+  FILE_LOG(LOG_ADF) << "FlatADF::save_to_file() - wrote " << _num_cells << " cells to " << filename << std::endl;
+}
+
+/// Determines whether a file holds a flattened ADF (by its magic number)
+bool FlatADF::is_flat_field_file(const std::string& filename)
+{
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  unsigned magic = 0;
+  in.read((char*) &magic, sizeof(magic));
+  return in.good() && magic == FLAT_ADF_MAGIC;
+}
+
+/// Memory-maps a flattened ADF from a binary file
+/**
+ * The cell and distance arrays point directly into the read-only mapping;
+ * pages fault in as queries touch them, so load time is independent of the
+ * field size.
+ * \return the flattened ADF, or a NULL pointer on failure
+ */
+shared_ptr<FlatADF> FlatADF::load_from_file(const std::string& filename)
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  // open the file
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    std::cerr << "FlatADF::load_from_file() - unable to open " << filename << std::endl;
+    return shared_ptr<FlatADF>();
+  }
+
+  // verify that the file holds the header and both arrays
+  struct stat sb;
+  if (fstat(fd, &sb) != 0 || (std::size_t) sb.st_size < sizeof(FlatADFHeader))
+  {
+    std::cerr << "FlatADF::load_from_file() - " << filename << " is truncated" << std::endl;
+    close(fd);
+    return shared_ptr<FlatADF>();
+  }
+
+  // map the file
+  std::size_t mapping_len = (std::size_t) sb.st_size;
+  void* mapping = mmap(NULL, mapping_len, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED)
+  {
+    std::cerr << "FlatADF::load_from_file() - unable to map " << filename << std::endl;
+    close(fd);
+    return shared_ptr<FlatADF>();
+  }
+
+  // validate the header
+  const FlatADFHeader* header = (const FlatADFHeader*) mapping;
+  const std::size_t EXPECTED = sizeof(FlatADFHeader) + (std::size_t) header->num_cells*sizeof(FlatCell) + (std::size_t) header->num_leafs*BOX_VERTICES*sizeof(double);
+  if (header->magic != FLAT_ADF_MAGIC || header->version != FLAT_ADF_VERSION || mapping_len < EXPECTED)
+  {
+    std::cerr << "FlatADF::load_from_file() - " << filename << " is not a flattened ADF" << std::endl;
+    munmap(mapping, mapping_len);
+    close(fd);
+    return shared_ptr<FlatADF>();
+  }
+
+  // point the query arrays into the mapping
+  shared_ptr<FlatADF> adf(new FlatADF);
+  adf->_mapping = mapping;
+  adf->_mapping_len = mapping_len;
+  adf->_fd = fd;
+  adf->_num_cells = header->num_cells;
+  adf->_num_leafs = header->num_leafs;
+  adf->_lo[X] = header->lo[X];  adf->_lo[Y] = header->lo[Y];  adf->_lo[Z] = header->lo[Z];
+  adf->_hi[X] = header->hi[X];  adf->_hi[Y] = header->hi[Y];  adf->_hi[Z] = header->hi[Z];
+  adf->_cells = (const FlatCell*) ((const char*) mapping + sizeof(FlatADFHeader));
+  adf->_dists = (const double*) (adf->_cells + adf->_num_cells);
+
+  FILE_LOG(LOG_ADF) << "FlatADF::load_from_file() - mapped " << adf->_num_cells << " cells from " << filename << std::endl;
+
+  return adf;
+}
@@ -4,8 +4,11 @@
  * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
  ****************************************************************************/
 
-#include <Moby/Tetrahedron.h>
-#include <Moby/Triangle.h>
+#include <cmath>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <pthread.h>
 #include <Moby/CompGeom.h>
 #include <Moby/CollisionGeometry.h>
 #include <Moby/Log.h>
@@ -15,15 +18,6 @@ using boost::shared_ptr;
 using namespace Ravelin;
 using namespace Moby;
 
-std::ostream& GJK::SVertex::output(std::ostream& out) const
-{
-  out << " " << v << std::endl;
-  out << "   A vertex: " << vA << std::endl;
-  out << "   B vertex: " << vB << std::endl;
-
-  return out;
-}
-
 std::ostream& GJK::Simplex::output(std::ostream& out) const
 {
   out << " type: ";
@@ -37,125 +31,245 @@ std::ostream& GJK::Simplex::output(std::ostream& out) const
   }
 
   for (unsigned i=0; i< num_vertices(); i++)
-    get_vertex(i).output(out) << std::endl;
+    out << " " << Vector3d(get_vertex(i), GLOBAL) << std::endl;
 
   return out;
 }
 
-/// Gets the desired vertex
-const GJK::SVertex& GJK::Simplex::get_vertex(unsigned i) const
+/// Finds the closest point to the origin on a segment, with its parameter
+/**
+ * On return \p t parameterizes the closest point as a + (b-a)*t, t in [0,1].
+ */
+Origin3d GJK::Simplex::closest_on_segment(const Origin3d& a, const Origin3d& b, double& t)
 {
-  switch (i)
+  Origin3d ab = b - a;
+  double denom = ab.dot(ab);
+  if (denom < NEAR_ZERO)
   {
-    case 0: return _v1;
-    case 1: return _v2;
-    case 2: return _v3;
-    case 3: return _v4;
-    default: assert(false); return _v1;
+    t = 0.0;
+    return a;
   }
+  t = -a.dot(ab)/denom;
+  t = std::min(std::max(t, 0.0), 1.0);
+  return a + ab*t;
 }
 
-/// Gets the number of vertices in the simplex
-unsigned GJK::Simplex::num_vertices() const
+/// Finds the closest point to the origin on a triangle, with barycentric coordinates
+/**
+ * On return the closest point is s*a + t*b + (1-s-t)*c with s, t >= 0 and
+ * s+t <= 1 (the Voronoi-region walk of [Ericson 2005]).
+ */
+Origin3d GJK::Simplex::closest_on_triangle(const Origin3d& a, const Origin3d& b, const Origin3d& c, double& s, double& t)
 {
-  switch (_type)
+  // check whether the origin is in the vertex region outside a
+  Origin3d ab = b - a;
+  Origin3d ac = c - a;
+  double d1 = -ab.dot(a);
+  double d2 = -ac.dot(a);
+  if (d1 <= 0.0 && d2 <= 0.0)
+  {
+    s = 1.0; t = 0.0;
+    return a;
+  }
+
+  // check whether the origin is in the vertex region outside b
+  double d3 = -ab.dot(b);
+  double d4 = -ac.dot(b);
+  if (d3 >= 0.0 && d4 <= d3)
+  {
+    s = 0.0; t = 1.0;
+    return b;
+  }
+
+  // check whether the origin is in the edge region of ab
+  double vc = d1*d4 - d3*d2;
+  if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+  {
+    double x = d1/(d1 - d3);
+    s = 1.0 - x; t = x;
+    return a + ab*x;
+  }
+
+  // check whether the origin is in the vertex region outside c
+  double d5 = -ab.dot(c);
+  double d6 = -ac.dot(c);
+  if (d6 >= 0.0 && d5 <= d6)
+  {
+    s = 0.0; t = 0.0;
+    return c;
+  }
+
+  // check whether the origin is in the edge region of ac
+  double vb = d5*d2 - d1*d6;
+  if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+  {
+    double x = d2/(d2 - d6);
+    s = 1.0 - x; t = 0.0;
+    return a + ac*x;
+  }
+
+  // check whether the origin is in the edge region of bc
+  double va = d3*d6 - d5*d4;
+  if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+  {
+    double x = (d4 - d3)/((d4 - d3) + (d5 - d6));
+    s = 0.0; t = 1.0 - x;
+    return b + (c - b)*x;
+  }
+
+  // the origin projects inside the face region
+  double denom = 1.0/(va + vb + vc);
+  double x = vb*denom;
+  double y = vc*denom;
+  s = 1.0 - x - y; t = x;
+  return a + ab*x + ac*y;
+}
+
+/// Finds the closest point to the origin on the tetrahedron, with barycentric coordinates
+/**
+ * On return the closest point is u*v1 + v*v2 + w*v3 + (1-u-v-w)*v4; if the
+ * origin is inside the tetrahedron the origin itself is returned.
+ */
+Origin3d GJK::Simplex::closest_on_tetra(double& u, double& v, double& w) const
+{
+  assert(_type == eTetra);
+  const double INF = std::numeric_limits<double>::max();
+
+  // test the origin against each face plane (a face is only considered if
+  // the origin lies on the opposite side from the remaining vertex)
+  Origin3d best(0.0, 0.0, 0.0);
+  double best_sq_dist = INF;
+  bool outside = false;
+  for (unsigned f=0; f< 4; f++)
+  {
+    // face f spans vertices FA/FB/FC and omits vertex OMIT
+    static const unsigned FA[4] = { 0, 0, 0, 1 };
+    static const unsigned FB[4] = { 1, 1, 2, 2 };
+    static const unsigned FC[4] = { 2, 3, 3, 3 };
+    static const unsigned OMIT[4] = { 3, 2, 1, 0 };
+    const Origin3d& a = _v[FA[f]];
+    const Origin3d& b = _v[FB[f]];
+    const Origin3d& c = _v[FC[f]];
+    const Origin3d& d = _v[OMIT[f]];
+
+    // see whether the origin and the omitted vertex straddle the face plane
+    Origin3d n = Origin3d::cross(b - a, c - a);
+    double signp = -a.dot(n);
+    double signd = (d - a).dot(n);
+    if (signp * signd >= 0.0)
+      continue;
+    outside = true;
+
+    // the origin is outside this face; find the closest point on it
+    double s, t;
+    Origin3d cp = closest_on_triangle(a, b, c, s, t);
+    double sq_dist = cp.dot(cp);
+    if (sq_dist < best_sq_dist)
+    {
+      best_sq_dist = sq_dist;
+      best = cp;
+
+      // map the face barycentric coordinates to the tetrahedron's
+      double wts[4] = { 0.0, 0.0, 0.0, 0.0 };
+      wts[FA[f]] = s;
+      wts[FB[f]] = t;
+      wts[FC[f]] = 1.0 - s - t;
+      u = wts[0]; v = wts[1]; w = wts[2];
+    }
+  }
+
+  // if the origin is on the inner side of every face, it is inside the
+  // tetrahedron; its barycentric coordinates come from a 3x3 solve
+  if (!outside)
   {
-    case ePoint:    return 1;
-    case eSegment:  return 2;
-    case eTriangle: return 3;
-    case eTetra:    return 4;
-    default: assert(false); return 0;
+    Origin3d e1 = _v[0] - _v[3];
+    Origin3d e2 = _v[1] - _v[3];
+    Origin3d e3 = _v[2] - _v[3];
+    Origin3d rhs = _v[3]*(-1.0);
+    double det = e1.dot(Origin3d::cross(e2, e3));
+    assert(std::fabs(det) > 0.0);
+    u = rhs.dot(Origin3d::cross(e2, e3))/det;
+    v = e1.dot(Origin3d::cross(rhs, e3))/det;
+    w = e1.dot(Origin3d::cross(e2, rhs))/det;
+    return Origin3d(0.0, 0.0, 0.0);
   }
+
+  return best;
 }
 
 /// Finds the closest point on the simplex (debugging function)
-Point3d GJK::Simplex::find_closest()
+Origin3d GJK::Simplex::find_closest()
 {
   if (_type == ePoint)
-    return _v1.v;
+    return _v[0];
   else if (_type == eSegment)
   {
     double t;
-    Point3d closest;
-    CompGeom::calc_dist(LineSeg3(_v1.v, _v2.v), Point3d(0,0,0,_v1.v.pose), t, closest);
-    if (t < NEAR_ZERO) 
-      return _v1.v;
-    else
-      return closest; 
+    return closest_on_segment(_v[0], _v[1], t);
   }
   else if (_type == eTriangle)
   {
-    Point3d cp;
-    Triangle tri(_v1.v, _v2.v, _v3.v);
-    Triangle::calc_sq_dist(tri, Point3d(0,0,0,_v1.v.pose), cp);
-    return cp;
+    double s, t;
+    return closest_on_triangle(_v[0], _v[1], _v[2], s, t);
   }
-  else 
+  else
   {
-    Point3d cp;
-    Tetrahedron tetra(_v1.v, _v2.v, _v3.v, _v4.v);
-    tetra.calc_signed_dist(Point3d(0,0,0,_v1.v.pose), cp);
     double u, v, w;
-    tetra.determine_barycentric_coords(cp, u, v, w);
-    return cp;
+    return closest_on_tetra(u, v, w);
   }
 }
 
 /// Finds the closest point to the origin and simplifies the simplex (if possible)
-Point3d GJK::Simplex::find_closest_and_simplify()
+Origin3d GJK::Simplex::find_closest_and_simplify()
 {
   FILE_LOG(LOG_COLDET) << "Simplex::find_closest_and_simplify() entered" << std::endl;
 
   if (_type == ePoint)
-    return _v1.v;
+    return _v[0];
   else if (_type == eSegment)
   {
     FILE_LOG(LOG_COLDET) << " -- current simplex is segment" << std::endl;
 
     double t;
-    Point3d closest;
-    CompGeom::calc_dist(LineSeg3(_v1.v, _v2.v), Point3d(0,0,0,_v1.v.pose), t, closest);
-    if (t >= 1.0-NEAR_ZERO) 
+    Origin3d closest = closest_on_segment(_v[0], _v[1], t);
+    if (t >= 1.0-NEAR_ZERO)
     {
       // new point is the closest; remove the old point
-      _v1 = _v2;
+      _v[0] = _v[1];
       _type = ePoint;
-      assert((find_closest()-_v1.v).norm() < NEAR_ZERO);
+      assert((find_closest()-_v[0]).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is v2 (removing v1)" << std::endl;
-      return _v1.v;
+      return _v[0];
     }
     else
     {
       FILE_LOG(LOG_COLDET) << " -- closest point is on line segment" << std::endl;
 
       // setup the closest point
-      return closest; 
+      return closest;
     }
   }
   else if (_type == eTriangle)
   {
     FILE_LOG(LOG_COLDET) << " -- current simplex is on triangle" << std::endl;
-    Point3d cp;
-    Triangle tri(_v1.v, _v2.v, _v3.v);
-    Triangle::calc_sq_dist(tri, Point3d(0,0,0,_v1.v.pose), cp);
     double s, t;
-    tri.determine_barycentric_coords(cp, s, t);
+    Origin3d cp = closest_on_triangle(_v[0], _v[1], _v[2], s, t);
     assert(s >= -NEAR_ZERO && t >= -NEAR_ZERO && s+t <= 1.0+NEAR_ZERO);
     if (s < NEAR_ZERO && t < NEAR_ZERO)
     {
       // new simplex is the newest vertex
-      _v1 = _v3;
+      _v[0] = _v[2];
       _type = ePoint;
-      assert((find_closest()-_v1.v).norm() < NEAR_ZERO);
+      assert((find_closest()-_v[0]).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to newest vertex (v3); reverting to point simplex" << std::endl;
       return cp;
     }
     else if (std::fabs(t-1.0) < NEAR_ZERO)
     {
       // simplex is second point
-      _v1 = _v2;
+      _v[0] = _v[1];
       _type = ePoint;
-      assert((find_closest()-_v1.v).norm() < NEAR_ZERO);
+      assert((find_closest()-_v[0]).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to vertex v2; reverting to point simplex" << std::endl;
       return cp;
     }
@@ -179,8 +293,8 @@ Point3d GJK::Simplex::find_closest_and_simplify()
     {
       // simplex is edge bc
       _type = eSegment;
-      _v1 = _v2;
-      _v2 = _v3;
+      _v[0] = _v[1];
+      _v[1] = _v[2];
       assert((find_closest()-cp).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to edge (v2,v3); reverting to edge simplex" << std::endl;
       return cp;
@@ -189,7 +303,7 @@ Point3d GJK::Simplex::find_closest_and_simplify()
     {
       // simplex is edge ca
       _type = eSegment;
-      _v2 = _v3;
+      _v[1] = _v[2];
       assert((find_closest()-cp).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to edge (v3,v1); reverting to edge simplex" << std::endl;
       return cp;
@@ -204,11 +318,8 @@ Point3d GJK::Simplex::find_closest_and_simplify()
   else if (_type == eTetra)
   {
     FILE_LOG(LOG_COLDET) << " -- current simplex is tetrahedron" << std::endl;
-    Point3d cp;
-    Tetrahedron tetra(_v1.v, _v2.v, _v3.v, _v4.v);
-    tetra.calc_signed_dist(Point3d(0,0,0,_v1.v.pose), cp);
     double u, v, w;
-    tetra.determine_barycentric_coords(cp, u, v, w);
+    Origin3d cp = closest_on_tetra(u, v, w);
     FILE_LOG(LOG_COLDET) << " u: " << u << " v: " << v << " w: " << w << std::endl;
     assert(u >= -NEAR_ZERO && v >= -NEAR_ZERO && w >= -NEAR_ZERO && u+v+w <= 1.0+NEAR_ZERO);
 
@@ -217,7 +328,7 @@ Point3d GJK::Simplex::find_closest_and_simplify()
     {
       // simplex simplified to newest vertex
       _type = ePoint;
-      _v1 = _v4;
+      _v[0] = _v[3];
       assert((find_closest()-cp).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to newest vertex (v4); reverting to point simplex" << std::endl;
       return cp;
@@ -232,7 +343,7 @@ Point3d GJK::Simplex::find_closest_and_simplify()
     else if (std::fabs(v-1.0) < NEAR_ZERO)
     {
       _type = ePoint;
-      _v1 = _v2;
+      _v[0] = _v[1];
       assert((find_closest()-cp).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to vertex (v2)- shouldn't be here?; reverting to point simplex" << std::endl;
       return cp;
@@ -240,7 +351,7 @@ Point3d GJK::Simplex::find_closest_and_simplify()
     else if (std::fabs(w-1.0) < NEAR_ZERO)
     {
       _type = ePoint;
-      _v1 = _v3;
+      _v[0] = _v[2];
       assert((find_closest()-cp).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to vertex (v3)- shouldn't be here?; reverting to point simplex" << std::endl;
       return cp;
@@ -257,8 +368,8 @@ Point3d GJK::Simplex::find_closest_and_simplify()
     {
       // edge bc
       _type = eSegment;
-      _v1 = _v2;
-      _v2 = _v3;
+      _v[0] = _v[1];
+      _v[1] = _v[2];
       assert((find_closest()-cp).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to edge (v2,v3)- shouldn't be here?; reverting to edge simplex" << std::endl;
       return cp;
@@ -267,7 +378,7 @@ Point3d GJK::Simplex::find_closest_and_simplify()
     {
       // edge ac
       _type = eSegment;
-      _v2 = _v3;
+      _v[1] = _v[2];
       assert((find_closest()-cp).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to edge (v1,v3)- shouldn't be here?; reverting to edge simplex" << std::endl;
       return cp;
@@ -276,7 +387,7 @@ Point3d GJK::Simplex::find_closest_and_simplify()
     {
       // edge ad
       _type = eSegment;
-      _v2 = _v4;
+      _v[1] = _v[3];
       assert((find_closest()-cp).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to edge (v1,v4); reverting to edge simplex" << std::endl;
       return cp;
@@ -285,8 +396,8 @@ Point3d GJK::Simplex::find_closest_and_simplify()
     {
       // edge bd
       _type = eSegment;
-      _v1 = _v2;
-      _v2 = _v4;
+      _v[0] = _v[1];
+      _v[1] = _v[3];
       assert((find_closest()-cp).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to edge (v2,v4); reverting to edge simplex" << std::endl;
       return cp;
@@ -295,8 +406,8 @@ Point3d GJK::Simplex::find_closest_and_simplify()
     {
       // edge cd
       _type = eSegment;
-      _v1 = _v3;
-      _v2 = _v4;
+      _v[0] = _v[2];
+      _v[1] = _v[3];
       assert((find_closest()-cp).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to edge (v3,v4); reverting to edge simplex" << std::endl;
       return cp;
@@ -313,7 +424,7 @@ Point3d GJK::Simplex::find_closest_and_simplify()
     {
       // triangle abd
       _type = eTriangle;
-      _v3 = _v4;
+      _v[2] = _v[3];
       assert((find_closest()-cp).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to triangle (v1,v2,v4); reverting to triangle simplex" << std::endl;
       return cp;
@@ -322,9 +433,9 @@ Point3d GJK::Simplex::find_closest_and_simplify()
     {
       // triangle bcd
       _type = eTriangle;
-      _v1 = _v2;
-      _v2 = _v3;
-      _v3 = _v4;
+      _v[0] = _v[1];
+      _v[1] = _v[2];
+      _v[2] = _v[3];
       assert((find_closest()-cp).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to triangle (v2,v3,v4); reverting to triangle simplex" << std::endl;
       return cp;
@@ -333,9 +444,9 @@ Point3d GJK::Simplex::find_closest_and_simplify()
     {
       // triangle cad
       _type = eTriangle;
-      _v2 = _v1;
-      _v1 = _v3;
-      _v3 = _v4;
+      _v[1] = _v[0];
+      _v[0] = _v[2];
+      _v[2] = _v[3];
       assert((find_closest()-cp).norm() < NEAR_ZERO);
       FILE_LOG(LOG_COLDET) << " -- closest point is to triangle (v1,v3,v4); reverting to triangle simplex" << std::endl;
       return cp;
@@ -351,142 +462,132 @@ Point3d GJK::Simplex::find_closest_and_simplify()
   {
     // should never be here...
     assert(false);
-    return Point3d(0,0,0,_v1.v.pose);
+    return Origin3d(0.0, 0.0, 0.0);
   }
 }
 
 /// Adds a vertex to the simplex
-void GJK::Simplex::add(const SVertex& v)
+void GJK::Simplex::add(const Origin3d& p)
 {
   if (_type == ePoint)
   {
     _type = eSegment;
-    _v2 = v;
+    _v[1] = p;
   }
   else if (_type == eSegment)
   {
     _type = eTriangle;
-    _v3 = v;
-    if (std::fabs(Triangle(_v1.v, _v2.v, _v3.v).calc_area()) < NEAR_ZERO)
+    _v[2] = p;
+    double area = 0.5*Origin3d::cross(_v[1] - _v[0], _v[2] - _v[0]).norm();
+    if (area < NEAR_ZERO)
       _type = eSegment;
   }
   else if (_type == eTriangle)
   {
     _type = eTetra;
-    _v4 = v;
-    double vol = Tetrahedron(_v1.v, _v2.v, _v3.v, _v4.v).calc_volume();
+    _v[3] = p;
+    double vol = (_v[3] - _v[0]).dot(Origin3d::cross(_v[1] - _v[0], _v[2] - _v[0]))/6.0;
     if (std::fabs(vol) < NEAR_ZERO)
       _type = eTriangle;
     else if (vol < 0)
     {
-      std::swap(_v2.v, _v3.v);
-      assert(Tetrahedron(_v1.v, _v2.v, _v3.v, _v4.v).calc_volume() > 0.0);
+      std::swap(_v[1], _v[2]);
+      assert((_v[3] - _v[0]).dot(Origin3d::cross(_v[1] - _v[0], _v[2] - _v[0])) > 0.0);
     }
   }
   else if (_type == eTetra)
     assert(false);
 }
 
-// TODO: remove this
-/*
-double GJK::do_gjk(CollisionGeometryPtr A, CollisionGeometryPtr B, Point3d& closestA, Point3d& closestB, unsigned max_iter)
+/// Does GJK using primitives and poses defined in collision geometry frames
+/**
+ * \param threshold when finite, the query may terminate as soon as the
+ *        support plane found in some iteration certifies that the distance
+ *        is at least the threshold; the returned value is then that
+ *        certified lower bound rather than the exact distance
+ */
+double GJK::do_gjk(shared_ptr<const Primitive> A, shared_ptr<const Primitive> B, shared_ptr<const Pose3d> PA, shared_ptr<const Pose3d> PB, Point3d& closestA, Point3d& closestB, unsigned max_iter, double threshold)
 {
   const double INF = std::numeric_limits<double>::max();
 
   // setup a random direction
-  Point3d rdir((double) rand() / RAND_MAX * 2.0 - 1.0,(double) rand() / RAND_MAX * 2.0 - 1.0, (double) rand() / RAND_MAX * 2.0 - 1.0, GLOBAL);
-  Point3d pA = A->get_supporting_point(-rdir);
-  Point3d pB = B->get_supporting_point(rdir); 
+  Vector3d rdir((double) rand() / RAND_MAX * 2.0 - 1.0,(double) rand() / RAND_MAX * 2.0 - 1.0, (double) rand() / RAND_MAX * 2.0 - 1.0, GLOBAL);
+  Point3d pA = A->get_supporting_point(-Pose3d::transform_vector(PA, rdir));
+  Point3d pB = B->get_supporting_point(Pose3d::transform_vector(PB, rdir));
 
-  // setup the initial support (a point)
-  SVertex p(pA, pB);
-  Simplex S = p;
+  // setup the initial support (a point in the Minkowski difference)
+  Simplex S(Origin3d(Pose3d::transform_point(GLOBAL, pA)) -
+            Origin3d(Pose3d::transform_point(GLOBAL, pB)));
   if (LOGGING(LOG_COLDET))
   {
     std::ostringstream oss;
-    S.output(oss); 
+    S.output(oss);
     FILE_LOG(LOG_COLDET) << "GJK::do_gjk() entered" << std::endl;
     FILE_LOG(LOG_COLDET) << " -- initial simplex: " << oss.str() << std::endl;
   }
 
   // setup the minimum dot
-  double min_dot = std::numeric_limits<double>::max();
   double min_dist = std::numeric_limits<double>::max();
 
   // GJK loop
   for (unsigned i=0; i< max_iter; i++)
   {
-    FILE_LOG(LOG_COLDET) << "GJK::do_gjk() iteration: " << i << std::endl;
-
     // find the closest point in the simplex to the origin
-    Point3d p = S.find_closest_and_simplify();
+    Origin3d p = S.find_closest_and_simplify();
     if (LOGGING(LOG_COLDET))
     {
       std::ostringstream oss;
-      S.output(oss); 
-      FILE_LOG(LOG_COLDET) << " -- closest point on simplex to origin: " << p << std::endl;
+      S.output(oss);
+      FILE_LOG(LOG_COLDET) << " -- closest point on simplex to origin: " << Vector3d(p, GLOBAL) << std::endl;
       FILE_LOG(LOG_COLDET) << " -- distance to origin: " << p.norm() << std::endl;
       FILE_LOG(LOG_COLDET) << " -- new simplex: " << oss.str() << std::endl;
     }
 
     // look and see whether the origin is contained in the simplex
     double pnorm = p.norm();
-    if (pnorm < NEAR_ZERO)
+    if (pnorm <= 0.0)
     {
       FILE_LOG(LOG_COLDET) << "GJK::do_gjk() shapes are intersecting"  << std::endl;
 
-      // A and B are intersecting
-      // determine the interpenetration distance
-      // THE CORRECT WAY to compute interpenetration for convex bodies
-      // using GJK is to construct the minkowski difference (NOTE: not sure
-      // if actual construction is necessary); the interpenetration distance
-      // (corresponds to minimum translation necessary to separate the bodies)
-      // will be the minimum l2-norm of a point on the boundary of the
-      // Minkowski difference. Note that there may be several such points with
-      // minimum norm (which would correspond to several points of deepest
-      // interpenetration) 
-      double pen_dist = INF;
-      const unsigned NV = S.num_vertices();
-      for (unsigned i=0; i< NV; i++)
-      {
-        double dA = A->calc_signed_dist(S.get_vertex(i).vB);
-        if (dA < 0.0) 
-          pen_dist = std::min(pen_dist, -dA);
-        double dB = B->calc_signed_dist(S.get_vertex(i).vA);
-        if (dB < 0.0) 
-          pen_dist = std::min(pen_dist, -dB);
-      }
-
-      return -pen_dist;
+      // A and B are intersecting; expand a polytope over the Minkowski
+      // difference to recover the penetration depth and witness points
+      return do_epa(A, B, PA, PB, closestA, closestB);
     }
-
-    // get the new supporting points and determine the new vertex
-    Point3d pA = A->get_supporting_point(-p);
-    Point3d pB = B->get_supporting_point(p); 
-    SVertex V(pA, pB);
-    if (LOGGING(LOG_COLDET))
+    // look for no progress
+    else if (pnorm > min_dist-NEAR_ZERO)
     {
-      std::ostringstream oss;
-      V.output(oss); 
-      FILE_LOG(LOG_COLDET) << " -- new vertex: " << oss.str() << std::endl;
+      FILE_LOG(LOG_COLDET) << "GJK::do_gjk() unable to progress!"  << std::endl;
+      return pnorm;
     }
 
-    // get the minimum distance  
+    // get the new supporting points and determine the new vertex
+    Vector3d pdir(p, GLOBAL);
+    Point3d pA = A->get_supporting_point(-Pose3d::transform_vector(PA, pdir));
+    Point3d pB = B->get_supporting_point(Pose3d::transform_vector(PB, pdir));
+    Origin3d V = Origin3d(Pose3d::transform_point(GLOBAL, pA)) -
+                 Origin3d(Pose3d::transform_point(GLOBAL, pB));
+    FILE_LOG(LOG_COLDET) << " -- new vertex: " << Vector3d(V, GLOBAL) << std::endl;
+
+    // get the minimum distance
     min_dist = std::min(min_dist, pnorm);
 
-    // look to see whether no intersection
-    double vdotd = V.v.dot(-p);
-    FILE_LOG(LOG_COLDET) << " -- <new vertex, direction> : " << vdotd << std::endl;
-    if (vdotd < min_dot)
+    // the support plane certifies dist >= <V, p>/|p|; if that lower bound
+    // reaches the caller's threshold, the exact distance is not needed
+    if (V.dot(p)/pnorm >= threshold)
     {
-      min_dot = vdotd;
+      FILE_LOG(LOG_COLDET) << "GJK::do_gjk() certified dist >= " << threshold << ", exiting" << std::endl;
       closestA = pA;
       closestB = pB;
-      if (vdotd < 0.0)
-      {
-        FILE_LOG(LOG_COLDET) << "GJK::do_gjk() dist=" << min_dist << ", exiting" << std::endl;
-        return min_dist;
-      }
+      return V.dot(p)/pnorm;
+    }
+
+    // look to see whether no intersection
+    double vdotd = -V.dot(p);
+    FILE_LOG(LOG_COLDET) << " -- <new vertex, direction> : " << vdotd << std::endl;
+    if (vdotd < 0.0)
+    {
+      FILE_LOG(LOG_COLDET) << "GJK::do_gjk() dist=" << min_dist << ", exiting" << std::endl;
+      return min_dist;
     }
     else
     {
@@ -496,109 +597,336 @@ double GJK::do_gjk(CollisionGeometryPtr A, CollisionGeometryPtr B, Point3d& clos
       {
         std::ostringstream oss;
         S.output(oss); 
-        FILE_LOG(LOG_COLDET) << "GJK::do_gjk() entered" << std::endl;
-        FILE_LOG(LOG_COLDET) << "added new point to simplex, now: " << oss.str() << std::endl;
+        FILE_LOG(LOG_COLDET) << "GJK::do_gjk() added new point to simplex, now: " << oss.str() << std::endl;
       }
     }
   }
 
-  FILE_LOG(LOG_COLDET) << "GJK::do_gjk() [max iterations exceeded] dist=" << min_dist << ", exiting" << std::endl;
-
+  throw std::runtime_error("maximum GJK iterations exceeded");
   return min_dist;
 }
-*/
 
-/// Does GJK using primitives and poses defined in collision geometry frames
-double GJK::do_gjk(shared_ptr<const Primitive> A, shared_ptr<const Primitive> B, shared_ptr<const Pose3d> PA, shared_ptr<const Pose3d> PB, Point3d& closestA, Point3d& closestB, unsigned max_iter)
+
+// a vertex of the EPA polytope: a Minkowski-difference point together with
+// the supporting points on each shape that produced it (needed to recover
+// the witness points at convergence)
+struct EPAVertex
 {
-  const double INF = std::numeric_limits<double>::max();
+  Origin3d v;
+  Point3d pA, pB;
+};
 
-  // setup a random direction
-  Point3d rdir((double) rand() / RAND_MAX * 2.0 - 1.0,(double) rand() / RAND_MAX * 2.0 - 1.0, (double) rand() / RAND_MAX * 2.0 - 1.0, GLOBAL);
-  Point3d pA = A->get_supporting_point(-Pose3d::transform_vector(PA, rdir));
-  Point3d pB = B->get_supporting_point(Pose3d::transform_vector(PB, rdir)); 
+// a triangular face of the EPA polytope, with its outward unit normal and
+// plane distance from the origin; dead faces were removed by an expansion
+struct EPAFace
+{
+  unsigned a, b, c;
+  Origin3d n;
+  double d;
+  bool alive;
+};
+
+// gathers a Minkowski-difference support vertex along dir (global frame)
+static EPAVertex epa_support(shared_ptr<const Primitive> A, shared_ptr<const Primitive> B, shared_ptr<const Pose3d> PA, shared_ptr<const Pose3d> PB, const Origin3d& dir)
+{
+  Vector3d d(dir, GLOBAL);
+  EPAVertex vx;
+  vx.pA = A->get_supporting_point(Pose3d::transform_vector(PA, d));
+  vx.pB = B->get_supporting_point(-Pose3d::transform_vector(PB, d));
+  vx.v = Origin3d(Pose3d::transform_point(GLOBAL, vx.pA)) -
+         Origin3d(Pose3d::transform_point(GLOBAL, vx.pB));
+  return vx;
+}
 
-  // setup the initial support (a point)
-  SVertex p(pA, pB);
-  Simplex S = p;
-  if (LOGGING(LOG_COLDET))
+// appends the triangle (a,b,c) to the polytope, wound so its normal points
+// away from the (interior) origin; degenerate slivers are dropped
+static void epa_add_face(const std::vector<EPAVertex>& verts, std::vector<EPAFace>& faces, unsigned a, unsigned b, unsigned c)
+{
+  EPAFace f;
+  f.a = a; f.b = b; f.c = c;
+  Origin3d n = Origin3d::cross(verts[b].v - verts[a].v, verts[c].v - verts[a].v);
+  double nrm = n.norm();
+  if (nrm < NEAR_ZERO)
+    return;
+  n /= nrm;
+  double d = n.dot(verts[a].v);
+  if (d < 0.0)
   {
-    std::ostringstream oss;
-    S.output(oss); 
-    FILE_LOG(LOG_COLDET) << "GJK::do_gjk() entered" << std::endl;
-    FILE_LOG(LOG_COLDET) << " -- initial simplex: " << oss.str() << std::endl;
+    std::swap(f.b, f.c);
+    n = -n;
+    d = -d;
   }
+  f.n = n;
+  f.d = d;
+  f.alive = true;
+  faces.push_back(f);
+}
 
-  // setup the minimum dot
-  double min_dist = std::numeric_limits<double>::max();
+/// Computes penetration depth and witnesses by expanding a polytope (EPA)
+/**
+ * Called by do_gjk() once the shapes are known to intersect (the origin lies
+ * in the Minkowski difference).  The polytope is seeded with six difference
+ * supports- along the penetration axis cached for this pair on a previous
+ * step when one exists (persistent penetrations then typically converge
+ * without expanding at all), else along the coordinate axes- and expanded
+ * through the face nearest the origin until a support extends it by less
+ * than the tolerance.  The converged face gives the depth and direction; the
+ * witness points are interpolated from the supporting points its vertices
+ * recorded.
+ *
+ * \return the negated penetration depth (or -1.0 if the polytope
+ *         degenerates, matching the legacy sentinel)
+ */
+double GJK::do_epa(shared_ptr<const Primitive> A, shared_ptr<const Primitive> B, shared_ptr<const Pose3d> PA, shared_ptr<const Pose3d> PB, Point3d& closestA, Point3d& closestB)
+{
+  const unsigned MAX_ITER = 100;
+  const double TOL = NEAR_ZERO;
+  const double INF = std::numeric_limits<double>::max();
 
-  // GJK loop
-  for (unsigned i=0; i< max_iter; i++)
+  // the penetration axes from converged queries, keyed on the pose pair
+  // (pose identity outlives the query and identifies the geometry pair);
+  // narrow-phase queries run concurrently, so the map is guarded
+  static std::map<std::pair<const void*, const void*>, Origin3d> axis_cache;
+  static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+  // look for a warm-start axis from a previous step
+  const std::pair<const void*, const void*> key((const void*) PA.get(), (const void*) PB.get());
+  Origin3d warm(0.0, 0.0, 0.0);
+  bool have_warm = false;
+  pthread_mutex_lock(&cache_mutex);
+  std::map<std::pair<const void*, const void*>, Origin3d>::const_iterator ci = axis_cache.find(key);
+  if (ci != axis_cache.end())
   {
-    // find the closest point in the simplex to the origin
-    Point3d p = S.find_closest_and_simplify();
-    if (LOGGING(LOG_COLDET))
-    {
-      std::ostringstream oss;
-      S.output(oss); 
-      FILE_LOG(LOG_COLDET) << " -- closest point on simplex to origin: " << p << std::endl;
-      FILE_LOG(LOG_COLDET) << " -- distance to origin: " << p.norm() << std::endl;
-      FILE_LOG(LOG_COLDET) << " -- new simplex: " << oss.str() << std::endl;
-    }
-
-    // look and see whether the origin is contained in the simplex
-    double pnorm = p.norm();
-    if (pnorm <= 0.0)
-    {
-      FILE_LOG(LOG_COLDET) << "GJK::do_gjk() shapes are intersecting"  << std::endl;
+    warm = ci->second;
+    have_warm = true;
+  }
+  pthread_mutex_unlock(&cache_mutex);
 
-      // A and B are intersecting, do not attempt to determine interpenetrating
-      // distance
-      return -1.0;
-    }
-    // look for no progress
-    else if (pnorm > min_dist-NEAR_ZERO)
-    {
-      FILE_LOG(LOG_COLDET) << "GJK::do_gjk() unable to progress!"  << std::endl;
-      return pnorm;
-    }
+  // setup the six seed directions: the warm-start axis and an orthonormal
+  // complement, or the coordinate axes
+  Origin3d dirs[3];
+  if (have_warm)
+  {
+    dirs[0] = warm;
+    Origin3d ref = (std::fabs(warm[0]) < 0.5) ? Origin3d(1.0, 0.0, 0.0) : Origin3d(0.0, 1.0, 0.0);
+    dirs[1] = Origin3d::cross(warm, ref);
+    dirs[1] /= dirs[1].norm();
+    dirs[2] = Origin3d::cross(warm, dirs[1]);
+  }
+  else
+  {
+    dirs[0] = Origin3d(1.0, 0.0, 0.0);
+    dirs[1] = Origin3d(0.0, 1.0, 0.0);
+    dirs[2] = Origin3d(0.0, 0.0, 1.0);
+  }
 
-    // get the new supporting points and determine the new vertex
-    Point3d pA = A->get_supporting_point(-Pose3d::transform_vector(PA, p));
-    Point3d pB = B->get_supporting_point(Pose3d::transform_vector(PB, p)); 
-    SVertex V(pA, pB);
-    if (LOGGING(LOG_COLDET))
-    {
-      std::ostringstream oss;
-      V.output(oss); 
-      FILE_LOG(LOG_COLDET) << " -- new vertex: " << oss.str() << std::endl;
-    }
+  // gather the seed supports (vertices 2i, 2i+1 along +/- dirs[i]); with
+  // the shapes overlapping, every support satisfies <v, dir> >= 0, so the
+  // octahedron over the supports contains the origin unless the difference
+  // is degenerately flat
+  std::vector<EPAVertex> verts;
+  std::vector<EPAFace> faces;
+  for (unsigned i=0; i< 3; i++)
+  {
+    verts.push_back(epa_support(A, B, PA, PB, dirs[i]));
+    verts.push_back(epa_support(A, B, PA, PB, -dirs[i]));
+  }
 
-    // get the minimum distance  
-    min_dist = std::min(min_dist, pnorm);
+  // stitch the octahedron
+  epa_add_face(verts, faces, 0, 2, 4);
+  epa_add_face(verts, faces, 0, 4, 3);
+  epa_add_face(verts, faces, 0, 3, 5);
+  epa_add_face(verts, faces, 0, 5, 2);
+  epa_add_face(verts, faces, 1, 4, 2);
+  epa_add_face(verts, faces, 1, 3, 4);
+  epa_add_face(verts, faces, 1, 5, 3);
+  epa_add_face(verts, faces, 1, 2, 5);
+
+  // expansion loop
+  for (unsigned iter=0; iter< MAX_ITER; iter++)
+  {
+    // find the alive face nearest the origin
+    unsigned best = std::numeric_limits<unsigned>::max();
+    double best_d = INF;
+    for (unsigned i=0; i< faces.size(); i++)
+      if (faces[i].alive && faces[i].d < best_d)
+      {
+        best_d = faces[i].d;
+        best = i;
+      }
 
-    // look to see whether no intersection
-    double vdotd = V.v.dot(-p);
-    FILE_LOG(LOG_COLDET) << " -- <new vertex, direction> : " << vdotd << std::endl;
-    if (vdotd < 0.0)
+    // a degenerately flat difference leaves no usable face
+    if (best == std::numeric_limits<unsigned>::max())
     {
-      FILE_LOG(LOG_COLDET) << "GJK::do_gjk() dist=" << min_dist << ", exiting" << std::endl;
-      return min_dist;
+      FILE_LOG(LOG_COLDET) << "GJK::do_epa() polytope degenerated, giving up" << std::endl;
+      return -1.0;
     }
-    else
-    {
-      // add the new vertex to the simplex
-      S.add(V);
-      if (LOGGING(LOG_COLDET))
+
+    // expand through the face
+    const EPAFace f = faces[best];
+    EPAVertex w = epa_support(A, B, PA, PB, f.n);
+    double growth = w.v.dot(f.n) - f.d;
+    if (growth < TOL || iter+1 == MAX_ITER)
+    {
+      // converged: the face plane is (to tolerance) a face of the
+      // difference; interpolate the witnesses at the origin's projection
+      // q = n*d = x*a + y*b + z*c via the face's barycentric coordinates
+      const Origin3d& a = verts[f.a].v;
+      const Origin3d& b = verts[f.b].v;
+      const Origin3d& c = verts[f.c].v;
+      Origin3d q = f.n*f.d;
+      Origin3d ab = b - a, ac = c - a, aq = q - a;
+      double d11 = ab.dot(ab), d12 = ab.dot(ac), d22 = ac.dot(ac);
+      double r1 = ab.dot(aq), r2 = ac.dot(aq);
+      double det = d11*d22 - d12*d12;
+      double y = 0.0, z = 0.0;
+      if (std::fabs(det) > NEAR_ZERO)
       {
-        std::ostringstream oss;
-        S.output(oss); 
-        FILE_LOG(LOG_COLDET) << "GJK::do_gjk() added new point to simplex, now: " << oss.str() << std::endl;
+        y = (d22*r1 - d12*r2)/det;
+        z = (d11*r2 - d12*r1)/det;
+      }
+      double x = 1.0 - y - z;
+      closestA = verts[f.a].pA*x + verts[f.b].pA*y + verts[f.c].pA*z;
+      closestB = verts[f.a].pB*x + verts[f.b].pB*y + verts[f.c].pB*z;
+
+      // record the axis to warm-start this pair while penetration persists
+      pthread_mutex_lock(&cache_mutex);
+      axis_cache[key] = f.n;
+      pthread_mutex_unlock(&cache_mutex);
+
+      FILE_LOG(LOG_COLDET) << "GJK::do_epa() converged, depth=" << f.d << " after " << iter << " expansions" << std::endl;
+      return -f.d;
+    }
+
+    // add the new vertex; remove the faces it sees and collect the horizon
+    // (boundary edges appear once among the visible faces, with their twins
+    // in opposite order, so matched twins cancel)
+    const unsigned wi = verts.size();
+    verts.push_back(w);
+    std::vector<std::pair<unsigned, unsigned> > horizon;
+    for (unsigned i=0; i< faces.size(); i++)
+    {
+      EPAFace& g = faces[i];
+      if (!g.alive || g.n.dot(w.v) <= g.d + NEAR_ZERO)
+        continue;
+      g.alive = false;
+      const std::pair<unsigned, unsigned> e[3] = {
+        std::make_pair(g.a, g.b), std::make_pair(g.b, g.c),
+        std::make_pair(g.c, g.a) };
+      for (unsigned j=0; j< 3; j++)
+      {
+        std::vector<std::pair<unsigned, unsigned> >::iterator twin = std::find(horizon.begin(), horizon.end(), std::make_pair(e[j].second, e[j].first));
+        if (twin != horizon.end())
+          horizon.erase(twin);
+        else
+          horizon.push_back(e[j]);
       }
     }
+
+    // stitch new faces from the horizon to the new vertex
+    for (unsigned i=0; i< horizon.size(); i++)
+      epa_add_face(verts, faces, horizon[i].first, horizon[i].second, wi);
   }
 
-  throw std::runtime_error("maximum GJK iterations exceeded");
-  return min_dist;
+  // not reached (the final iteration returns above)
+  assert(false);
+  return -1.0;
+}
+
+/// Conservatively culls pairs of convex geometries separated beyond a threshold
+/**
+ * A wide culling kernel for broad-phase survivors: runs GJK over flat arrays
+ * of geometry pairs with a fixed iteration budget per pair, looking only for
+ * a certificate that the pair distance exceeds \p thresh (the support plane
+ * found each iteration lower-bounds the distance between the shapes). No
+ * per-pair allocation occurs- the simplex is a fixed-size automatic- and the
+ * loop over pairs is dispatched over threads. Pairs the budget cannot
+ * certify are left unculled and must go to the precise narrow phase; the
+ * kernel never culls a pair within the threshold.
+ *
+ * \param gA the first geometry of each pair (its primitive must be convex)
+ * \param gB the second geometry of each pair (its primitive must be convex)
+ * \param thresh the distance beyond which a pair may be culled
+ * \param budget the maximum number of GJK iterations per pair
+ * \param culled on return, nonzero for each pair certified beyond thresh
+ * \param bounds on return, the largest certified distance lower bound found
+ *        for each pair (zero if no separation certificate was found)
+ */
+void GJK::batch_cull(const std::vector<CollisionGeometryPtr>& gA, const std::vector<CollisionGeometryPtr>& gB, double thresh, unsigned budget, std::vector<char>& culled, std::vector<double>& bounds)
+{
+  assert(gA.size() == gB.size());
+
+  // size the outputs (unculled / no certificate by default)
+  culled.assign(gA.size(), 0);
+  bounds.assign(gA.size(), 0.0);
+
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (int i=0; i< (int) gA.size(); i++)
+    if (cull_pair(gA[i], gB[i], thresh, budget, bounds[i]))
+      culled[i] = 1;
 }
 
+/// Attempts to certify that one pair of convex geometries is beyond a threshold
+/**
+ * The single-pair kernel behind batch_cull(); see that method for the
+ * approach. Also used by CollisionGeometry::calc_signed_dist() to satisfy
+ * thresholded queries without running the exact narrow phase.
+ *
+ * \param bound on return, the largest certified distance lower bound found
+ *        (zero if no separation certificate was found)
+ * \return true if the pair was certified beyond \p thresh
+ */
+bool GJK::cull_pair(CollisionGeometryPtr gA, CollisionGeometryPtr gB, double thresh, unsigned budget, double& bound)
+{
+  // use the offset between the geometry frames as the initial direction-
+  // for far pairs (the common case here) it is near the true separating
+  // direction, so the first support plane usually certifies the cull
+  Point3d oA = Pose3d::transform_point(GLOBAL, Point3d(0.0, 0.0, 0.0, gA->get_pose()));
+  Point3d oB = Pose3d::transform_point(GLOBAL, Point3d(0.0, 0.0, 0.0, gB->get_pose()));
+  Vector3d rdir = oA - oB;
+  if (rdir.norm() < NEAR_ZERO)
+    rdir = Vector3d(1.0, 0.0, 0.0, GLOBAL);
+
+  // setup the initial support (a point in the Minkowski difference)
+  Point3d sA = gA->get_supporting_point(-rdir);
+  Point3d sB = gB->get_supporting_point(rdir);
+  Simplex S(Origin3d(Pose3d::transform_point(GLOBAL, sA)) -
+            Origin3d(Pose3d::transform_point(GLOBAL, sB)));
+  bound = 0.0;
+
+  // budgeted GJK loop
+  for (unsigned j=0; j< budget; j++)
+  {
+    // the closest point on the simplex to the origin upper-bounds the
+    // distance; once it reaches the threshold the pair cannot be culled
+    Origin3d p = S.find_closest_and_simplify();
+    double pnorm = p.norm();
+    if (pnorm <= thresh)
+      break;
+
+    // get the new supporting points and determine the new vertex
+    Vector3d pdir(p, GLOBAL);
+    sA = gA->get_supporting_point(-pdir);
+    sB = gB->get_supporting_point(pdir);
+    Origin3d V = Origin3d(Pose3d::transform_point(GLOBAL, sA)) -
+                 Origin3d(Pose3d::transform_point(GLOBAL, sB));
+
+    // the support plane certifies dist >= <V, p>/|p|
+    double lb = V.dot(p)/pnorm;
+    if (lb > bound)
+      bound = lb;
+    if (lb > thresh)
+      return true;
+
+    // no certificate yet and no more room to refine: give up on this pair
+    if (S.num_vertices() == 4)
+      break;
+
+    // refine the simplex
+    S.add(V);
+  }
+
+  return false;
+}
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <algorithm>
 #include <Moby/Types.h>
 #include <Moby/CompGeom.h>
 #include <Moby/TessellatedPolyhedron.h>
@@ -415,12 +416,65 @@ void GaussianMixture::get_vertices(BVPtr bv, vector<const Point3d*>& vertices)
 }
 */
 
+/// Orders Gaussian indices by descending height
+struct GaussHeightComp
+{
+  GaussHeightComp(const vector<GaussianMixture::Gauss>& gauss_) : gauss(gauss_) {}
+  bool operator()(unsigned i, unsigned j) const { return gauss[i].A > gauss[j].A; }
+  const vector<GaussianMixture::Gauss>& gauss;
+};
+
+/// Precomputes per-Gaussian evaluation constants and the pruned query order
+/**
+ * The height-field evaluation in point_inside() previously recomputed the
+ * rotation trigonometry and quadratic form coefficients of every component
+ * at every query point.  Those terms depend only on the mixture parameters,
+ * so they are computed once here.  The smallest eigenvalue of each quadratic
+ * form also gives a conservative bound on a component's contribution at
+ * distance d from its center (at most A*exp(-lam_min*d^2)), which lets a
+ * query skip components too far away to beat its running maximum; ordering
+ * components tallest-first additionally lets a query stop outright once no
+ * remaining height can win.
+ */
+void GaussianMixture::build_eval_accel()
+{
+  _aux.resize(_gauss.size());
+  for (unsigned i=0; i< _gauss.size(); i++)
+  {
+    const Gauss& g = _gauss[i];
+    GaussAux& aux = _aux[i];
+
+    // compute the quadratic form coefficients exactly as point_inside() did
+    const double CTH = std::cos(g.th);
+    const double STH = std::sin(g.th);
+    const double S2TH = std::sin((double) 2.0 * g.th);
+    aux.a = CTH*CTH/2/g.sigma_x*g.sigma_x + STH*STH/2/g.sigma_y*g.sigma_y;
+    aux.b = -S2TH/4/g.sigma_x*g.sigma_x + S2TH/4/g.sigma_y*g.sigma_y;
+    aux.c = STH*STH/2/g.sigma_x*g.sigma_x + CTH*CTH/2/g.sigma_y*g.sigma_y;
+
+    // the evaluated exponent is a^2*dx^2 + 2*b*dx*dy + c*dy^2; compute the
+    // smallest eigenvalue of that form for the contribution bound
+    const double A2 = aux.a*aux.a;
+    aux.lam_min = (double) 0.5*((A2 + aux.c) - std::sqrt((A2 - aux.c)*(A2 - aux.c) + (double) 4.0*aux.b*aux.b));
+    aux.log_A = (g.A > (double) 0.0) ? std::log(g.A) : -std::numeric_limits<double>::max();
+  }
+
+  // order the components tallest-first
+  _desc_height.resize(_gauss.size());
+  for (unsigned i=0; i< _gauss.size(); i++)
+    _desc_height[i] = i;
+  std::sort(_desc_height.begin(), _desc_height.end(), GaussHeightComp(_gauss));
+}
+
 /// Rebuilds everything from scratch
 void GaussianMixture::rebuild(const vector<Gauss>& gauss)
 {
   // copy the Gaussians
   _gauss = gauss;
 
+  // precompute the evaluation constants and pruning order
+  build_eval_accel();
+
   // construct sets of vertices
   construct_vertices();
 
@@ -597,27 +651,38 @@ bool GaussianMixture::point_inside(BVPtr bv, const Point3d& point, Vector3d& nor
   // convert the point to primitive space
   Point3d p = T.transform_point(point);
 
-  // find max(z) of gaussians
+  // find max(z) of gaussians, visiting components tallest-first (see
+  // build_eval_accel()) so the search stops once no remaining component
+  // can beat the running maximum
   double tempX,tempY,tempZ,tempMax;
   tempX=p[0];
   tempY=p[1];
   tempMax = -std::numeric_limits<double>::max();
   int num = 0;
-  for(int i=0;i<_gauss.size();i++){
-
-    // compute some constants
-    const double CTH = std::cos(_gauss[i].th);
-    const double STH = std::sin(_gauss[i].th); 
-    const double S2TH = std::sin((double) 2.0 * _gauss[i].th); 
+  double log_max = -std::numeric_limits<double>::max();
+  for (unsigned jj=0; jj< _desc_height.size(); jj++)
+  {
+    const unsigned i = _desc_height[jj];
+    const Gauss& g = _gauss[i];
+    const GaussAux& aux = _aux[i];
+
+    // no later component is taller; if this one cannot win, none can
+    if (g.A <= tempMax)
+      break;
+
+    // a component contributes at most A*exp(-lam_min*d^2) at planar
+    // distance d from its center; skip it if even that cannot beat the max
+    const double dx = tempX - g.x0;
+    const double dy = tempY - g.y0;
+    if (aux.lam_min > (double) 0.0 && aux.lam_min*(dx*dx + dy*dy) > aux.log_A - log_max)
+      continue;
 
-    a = CTH*CTH/2/_gauss[i].sigma_x*_gauss[i].sigma_x + STH*STH/2/_gauss[i].sigma_y*_gauss[i].sigma_y;
-    b = -S2TH/4/_gauss[i].sigma_x*_gauss[i].sigma_x + S2TH/4/_gauss[i].sigma_y*_gauss[i].sigma_y;
-    c = STH*STH/2/_gauss[i].sigma_x*_gauss[i].sigma_x + CTH*CTH/2/_gauss[i].sigma_y*_gauss[i].sigma_y;
-    tempZ = _gauss[i].A*std::exp( - (a*(tempX-_gauss[i].x0)*a*(tempX-_gauss[i].x0) + 2*b*(tempX-_gauss[i].x0)*(tempY-_gauss[i].y0) + c*(tempY-_gauss[i].y0)*(tempY-_gauss[i].y0)));
-    //tempZ=_gauss[i].A/std::exp((tempX - _gauss[i].x0)*(tempX - _gauss[i].x0)/(2*_gauss[i].sigma_x) + ((tempY - _gauss[i].y0)*(tempY - _gauss[i].y0))/(2*_gauss[i].sigma_y)); 
+    // evaluate the surviving component with the precomputed constants
+    tempZ = g.A*std::exp(-(aux.a*dx*aux.a*dx + 2*aux.b*dx*dy + aux.c*dy*dy));
     if(tempZ>tempMax){
       tempMax=tempZ;
       num = i;
+      log_max = std::log(tempMax);
     }
   }
 
@@ -37,12 +37,14 @@ using std::make_pair;
 HeightmapPrimitive::HeightmapPrimitive()
 {
   _width = _depth = 0.0;
+  _patch_valid = false;
 }
 
 /// Initializes the heightmap primitive
 HeightmapPrimitive::HeightmapPrimitive(const Ravelin::Pose3d& T) : Primitive(T)
 {
   _width = _depth = 0.0;
+  _patch_valid = false;
 }
 
 /// Gets the supporting point
@@ -86,9 +88,8 @@ BVPtr HeightmapPrimitive::get_BVH_root(CollisionGeometryPtr geom)
     obb->center.set_zero(P);
 
     // get the maximum and minimum height
-    pair<ColumnIteratord, ColumnIteratord> mmax = boost::minmax_element(_heights.column_iterator_begin(), _heights.column_iterator_end());
-    double maxy = *mmax.second;
-    double miny = *mmax.first;
+    double miny, maxy;
+    calc_min_max_heights(miny, maxy);
     obb->center[Y] = (maxy+miny)*0.5;
 
     // setup obb dimensions
@@ -101,6 +102,14 @@ BVPtr HeightmapPrimitive::get_BVH_root(CollisionGeometryPtr geom)
   return obb;
 }
 
+/// Gets the range of height samples in the map
+void HeightmapPrimitive::calc_min_max_heights(double& miny, double& maxy) const
+{
+  pair<ColumnIteratord_const, ColumnIteratord_const> mmax = boost::minmax_element(_heights.column_iterator_begin(), _heights.column_iterator_end());
+  miny = *mmax.first;
+  maxy = *mmax.second;
+}
+
 /// Gets the mesh of the heightmap
 shared_ptr<const IndexedTriArray> HeightmapPrimitive::get_mesh(shared_ptr<const Pose3d> P)
 {
@@ -123,20 +132,20 @@ void HeightmapPrimitive::get_vertices(BVPtr bv, shared_ptr<const Pose3d> P, vect
   Point3d bv_hi = bv->get_lower_bounds();
 
   // get the lower i and j indices
-  unsigned lowi = (unsigned) ((bv_lo[X]+_width*0.5)*(_heights.rows()-1)/_width);
-  unsigned lowj = (unsigned) ((bv_lo[Z]+_depth*0.5)*(_heights.columns()-1)/_depth);
+  unsigned lowi = (unsigned) ((bv_lo[X]+_width*0.5)*(rows()-1)/_width);
+  unsigned lowj = (unsigned) ((bv_lo[Z]+_depth*0.5)*(columns()-1)/_depth);
 
   // get the upper i and j indices
-  unsigned upi = (unsigned) ((bv_hi[X]+_width*0.5)*(_heights.rows()-1)/_width)+1;
-  unsigned upj = (unsigned) ((bv_hi[Z]+_depth*0.5)*(_heights.columns()-1)/_depth)+1;
+  unsigned upi = (unsigned) ((bv_hi[X]+_width*0.5)*(rows()-1)/_width)+1;
+  unsigned upj = (unsigned) ((bv_hi[Z]+_depth*0.5)*(columns()-1)/_depth)+1;
 
   // iterate over all points
   for (unsigned i=lowi; i<= upi; i++)
     for (unsigned j=lowj; j< upj; j++)
     {
-      double x = -_width*0.5+_width*i/(_heights.rows()-1);
-      double z = -_depth*0.5+_depth*j/(_heights.columns()-1);
-      vertices.push_back(Point3d(x, _heights(i,j), z, P));
+      double x = -_width*0.5+_width*i/(rows()-1);
+      double z = -_depth*0.5+_depth*j/(columns()-1);
+      vertices.push_back(Point3d(x, height(i,j), z, P));
     }
 }
 
@@ -149,12 +158,12 @@ void HeightmapPrimitive::get_vertices(shared_ptr<const Pose3d> P, vector<Point3d
   vertices.clear();
 
   // iterate over all points
-  for (unsigned i=0; i< _heights.rows(); i++)
-    for (unsigned j=0; j< _heights.columns(); j++)
+  for (unsigned i=0; i< rows(); i++)
+    for (unsigned j=0; j< columns(); j++)
     {
-      double x = -_width*0.5+_width*i/(_heights.rows()-1);
-      double z = -_depth*0.5+_depth*j/(_heights.columns()-1);
-      vertices.push_back(Point3d(x, _heights(i,j), z, P));
+      double x = -_width*0.5+_width*i/(rows()-1);
+      double z = -_depth*0.5+_depth*j/(columns()-1);
+      vertices.push_back(Point3d(x, height(i,j), z, P));
     }
 }
 
@@ -173,28 +182,97 @@ double HeightmapPrimitive::calc_height(const Point3d& p) const
   const unsigned qz = p[Z];
 
   // determine the indices 
-  unsigned i = constrain_unsigned((qx+_width*0.5)*(_heights.rows()-1)/_width,_heights.rows()-1);
-  unsigned j = constrain_unsigned((qz+_depth*0.5)*(_heights.columns()-1)/_depth,_heights.columns()-1);
+  unsigned i = constrain_unsigned((qx+_width*0.5)*(rows()-1)/_width,rows()-1);
+  unsigned j = constrain_unsigned((qz+_depth*0.5)*(columns()-1)/_depth,columns()-1);
   
   // setup inputs
-  double x0 = -_width*0.5+_width*i/(_heights.rows()-1);
-  double z0 = -_depth*0.5+_depth*j/(_heights.columns()-1);
-  double x1 = -_width*0.5+_width*(i+1)/(_heights.rows()-1);
-  double z1 = -_depth*0.5+_depth*(j+1)/(_heights.columns()-1);
+  double x0 = -_width*0.5+_width*i/(rows()-1);
+  double z0 = -_depth*0.5+_depth*j/(columns()-1);
+  double x1 = -_width*0.5+_width*(i+1)/(rows()-1);
+  double z1 = -_depth*0.5+_depth*(j+1)/(columns()-1);
 
   // compute s and t
   double s = qx/(x1 - x0);
   double t = qz/(z1 - z0); 
 
   // get four height values
-  const double f00 = _heights(i,j);
-  const double f10 = _heights(i+1,j);
-  const double f01 = _heights(i,j+1);
-  const double f11 = _heights(i+1,j+1);
+  const double f00 = height(i,j);
+  const double f10 = height(i+1,j);
+  const double f01 = height(i,j+1);
+  const double f11 = height(i+1,j+1);
 
   return p[Y] - f00*(1.0-s)*(1.0-t) + f10*s*(1.0-t) + f01*(1.0-s)*t + f11*s*t;
 }
 
+/// Evaluates the bilinearly interpolated terrain height at a point in the heightmap frame
+/**
+ * The four corner heights and the extents of the grid cell containing the
+ * query are cached across calls; successive queries falling in the same
+ * cell (the common case when many sample points on one body are queried
+ * against the same terrain) reload nothing from the height matrix.
+ */
+double HeightmapPrimitive::eval_bilinear(double qx, double qz) const
+{
+  // determine the cell indices, clamped so that (i+1, j+1) remains valid
+  const unsigned i = constrain_unsigned((qx+_width*0.5)*(rows()-1)/_width, rows()-2);
+  const unsigned j = constrain_unsigned((qz+_depth*0.5)*(columns()-1)/_depth, columns()-2);
+
+  // reload the patch if the query left the cached cell
+  if (!_patch_valid || i != _patch_i || j != _patch_j)
+  {
+    _patch_i = i;
+    _patch_j = j;
+    _patch_f00 = height(i,j);
+    _patch_f10 = height(i+1,j);
+    _patch_f01 = height(i,j+1);
+    _patch_f11 = height(i+1,j+1);
+    _patch_x0 = -_width*0.5+_width*i/(rows()-1);
+    _patch_z0 = -_depth*0.5+_depth*j/(columns()-1);
+    _patch_inv_dx = (rows()-1)/_width;
+    _patch_inv_dz = (columns()-1)/_depth;
+    _patch_valid = true;
+  }
+
+  // interpolate within the patch
+  const double s = (qx - _patch_x0)*_patch_inv_dx;
+  const double t = (qz - _patch_z0)*_patch_inv_dz;
+  return _patch_f00*(1.0-s)*(1.0-t) + _patch_f10*s*(1.0-t) +
+         _patch_f01*(1.0-s)*t + _patch_f11*s*t;
+}
+
+/// Computes the heights of a batch of sample points above the heightmap
+/**
+ * \param P the heightmap pose that heights are evaluated in
+ * \param points the sample points, all defined in one common pose
+ * \param heights on return, heights[i] is the height of points[i] above the
+ *        terrain surface (negative indicates interpenetration)
+ *
+ * The transformation into the heightmap frame is computed once for the
+ * whole batch and the bilinear patch cache amortizes cell lookups, so this
+ * is considerably faster than calling calc_signed_dist() per point.
+ */
+void HeightmapPrimitive::calc_heights(shared_ptr<const Pose3d> P, const std::vector<Point3d>& points, std::vector<double>& heights) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+  assert(_poses.find(const_pointer_cast<Pose3d>(P)) != _poses.end() || P == get_pose());
+
+  // resize the output
+  heights.resize(points.size());
+  if (points.empty())
+    return;
+
+  // compute the transform into the heightmap frame once for the batch
+  Transform3d T = Pose3d::calc_relative_pose(points.front().pose, P);
+
+  // evaluate every sample point
+  for (unsigned i=0; i< points.size(); i++)
+  {
+    assert(points[i].pose == points.front().pose);
+    Point3d p = T.transform_point(points[i]);
+    heights[i] = p[Y] - eval_bilinear(p[X], p[Z]);
+  }
+}
+
 /// Computes the gradient at a particular point
 void HeightmapPrimitive::calc_gradient(const Point3d& p, double& gx, double& gz) const
 {
@@ -206,24 +284,24 @@ void HeightmapPrimitive::calc_gradient(const Point3d& p, double& gx, double& gz)
   const unsigned qz = p[Z];
 
   // determine the indices 
-  unsigned i = constrain_unsigned(qx*(_heights.rows()-1)/_width + _width*0.5,_heights.rows()-1);
-  unsigned j = constrain_unsigned(qz*(_heights.columns()-1)/_depth + _depth*0.5,_heights.columns()-1);
+  unsigned i = constrain_unsigned(qx*(rows()-1)/_width + _width*0.5,rows()-1);
+  unsigned j = constrain_unsigned(qz*(columns()-1)/_depth + _depth*0.5,columns()-1);
 
   // setup inputs
-  double x0 = -_width*0.5+_width*i/(_heights.rows()-1);
-  double z0 = -_depth*0.5+_depth*j/(_heights.columns()-1);
-  double x1 = -_width*0.5+_width*(i+1)/(_heights.rows()-1);
-  double z1 = -_depth*0.5+_depth*(j+1)/(_heights.columns()-1);
+  double x0 = -_width*0.5+_width*i/(rows()-1);
+  double z0 = -_depth*0.5+_depth*j/(columns()-1);
+  double x1 = -_width*0.5+_width*(i+1)/(rows()-1);
+  double z1 = -_depth*0.5+_depth*(j+1)/(columns()-1);
 
   // compute s and t
   double s = qx/(x1 - x0);
   double t = qz/(z1 - z0); 
 
   // get four height values
-  const double f00 = _heights(i,j);
-  const double f10 = _heights(i+1,j);
-  const double f01 = _heights(i,j+1);
-  const double f11 = _heights(i+1,j+1);
+  const double f00 = height(i,j);
+  const double f10 = height(i+1,j);
+  const double f01 = height(i,j+1);
+  const double f11 = height(i+1,j+1);
 
   // compute the x gradient
   gx = f10*(1.0-t) + f11*t;
@@ -308,9 +386,9 @@ osg::Node* HeightmapPrimitive::create_visualization()
 
   // create the faces - we're going to iterate over every grouping of four
   // points
-  const unsigned COLS = _heights.columns();
-  for (unsigned i=0; i< _heights.rows()-1; i++)
-    for (unsigned j=0; j< _heights.columns()-1; j++)
+  const unsigned COLS = columns();
+  for (unsigned i=0; i< rows()-1; i++)
+    for (unsigned j=0; j< columns()-1; j++)
     {
       // get the four indices
       const unsigned V1 =  i*COLS+j; // i, j
@@ -375,28 +453,28 @@ double HeightmapPrimitive::calc_signed_dist(shared_ptr<const SpherePrimitive> s,
   bv_hi[Z] += s->get_radius();
 
   // get the lower i and j indices
-  unsigned lowi = constrain_unsigned((bv_lo[X]+_width*0.5)*(_heights.rows()-1)/_width,_heights.rows()-1);
-  unsigned lowj = constrain_unsigned((bv_lo[Z]+_depth*0.5)*(_heights.columns()-1)/_depth,_heights.columns()-1);
+  unsigned lowi = constrain_unsigned((bv_lo[X]+_width*0.5)*(rows()-1)/_width,rows()-1);
+  unsigned lowj = constrain_unsigned((bv_lo[Z]+_depth*0.5)*(columns()-1)/_depth,columns()-1);
 
   // get the upper i and j indices
-  unsigned upi = constrain_unsigned(((bv_hi[X]+_width*0.5)*(_heights.rows()-1)/_width)+1,_heights.rows()-1);
-  unsigned upj = constrain_unsigned(((bv_hi[Z]+_depth*0.5)*(_heights.columns()-1)/_depth)+1,_heights.columns()-1);
+  unsigned upi = constrain_unsigned(((bv_hi[X]+_width*0.5)*(rows()-1)/_width)+1,rows()-1);
+  unsigned upj = constrain_unsigned(((bv_hi[Z]+_depth*0.5)*(columns()-1)/_depth)+1,columns()-1);
 
   FILE_LOG(LOG_COLDET) << "i = [" << lowi << ":" << upi << "]" << std::endl;
   FILE_LOG(LOG_COLDET) << "j = [" << lowj << ":" << upj << "]" << std::endl;
   // iterate over all points in the bounding region
   FILE_LOG(LOG_COLDET) << "size = (" << _width << "," << _depth << ")" << std::endl;
-  FILE_LOG(LOG_COLDET) << "sizei = (" << _heights.rows() << "," << _heights.columns() << ")" << std::endl;
+  FILE_LOG(LOG_COLDET) << "sizei = (" << rows() << "," << columns() << ")" << std::endl;
 
-  for (unsigned i=lowi; i<= upi &&  i < _heights.rows(); i++)
-    for (unsigned j=lowj; j<= upj && j < _heights.columns(); j++)
+  for (unsigned i=lowi; i<= upi &&  i < rows(); i++)
+    for (unsigned j=lowj; j<= upj && j < columns(); j++)
     {
       // compute the point on the heightmap
-      double x = -_width*0.5+_width*i/(_heights.rows()-1);
-      double z = -_depth*0.5+_depth*j/(_heights.columns()-1);
-      FILE_LOG(LOG_COLDET) << "p = (" << x << "," << z << "," << _heights(i,j) << ")" << std::endl;
-      FILE_LOG(LOG_COLDET) << "pi = (" << i << "," << j << "," << _heights(i,j) << ")" << std::endl;
-      Point3d p(x, _heights(i,j), z, pthis.pose);
+      double x = -_width*0.5+_width*i/(rows()-1);
+      double z = -_depth*0.5+_depth*j/(columns()-1);
+      FILE_LOG(LOG_COLDET) << "p = (" << x << "," << z << "," << height(i,j) << ")" << std::endl;
+      FILE_LOG(LOG_COLDET) << "pi = (" << i << "," << j << "," << height(i,j) << ")" << std::endl;
+      Point3d p(x, height(i,j), z, pthis.pose);
       Point3d ps_prime = Pose3d::transform_point(ps.pose, p);
 
       // get the distance from the sphere
@@ -441,15 +519,19 @@ double HeightmapPrimitive::calc_signed_dist(shared_ptr<const Primitive> p, Point
   shared_ptr<Primitive> pnc = const_pointer_cast<Primitive>(p);
 
   // still here? no specialization; get all vertices from other primitive
+  // and query them as a batch (the pose transform is computed once and
+  // the bilinear patch cache amortizes the cell lookups)
   vector<Point3d> verts;
   pnc->get_vertices(pp.pose, verts);
+  vector<double> heights;
+  calc_heights(pthis.pose, verts, heights);
   double mindist = std::numeric_limits<double>::max();
   for (unsigned i=0; i< verts.size(); i++)
   {
-     Point3d pt = Pose3d::transform_point(pthis.pose, verts[i]);
-     const double HEIGHT = calc_height(pt);
+     const double HEIGHT = heights[i];
      if (HEIGHT < mindist)
      {
+       Point3d pt = Pose3d::transform_point(pthis.pose, verts[i]);
        mindist = HEIGHT;
        pp = verts[i];
        pthis = pt;
@@ -514,6 +596,9 @@ void HeightmapPrimitive::load_from_xml(shared_ptr<const XMLTree> node, std::map<
       std::cerr << "HeightmapPrimitive::load_from_xml() - unable to read heightmap!" << std::endl;
       _heights.set_zero(1,1);
     }
+
+    // the cached bilinear patch no longer corresponds to the height data
+    _patch_valid = false;
   }
 
   // read in the width, if specified
@@ -4,6 +4,9 @@
  * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
  ****************************************************************************/
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include <iomanip>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/minmax_element.hpp>
@@ -25,6 +28,7 @@
 #include <Moby/ImpactConstraintHandler.h>
 #include <Moby/ConstraintSimulator.h>
 #include <Moby/SignedDistDot.h>
+#include <Moby/ContactProblemCapture.h>
 #ifdef HAVE_IPOPT
 #include <Moby/NQP_IPOPT.h>
 #include <Moby/LCP_IPOPT.h>
@@ -48,6 +52,23 @@ ImpactConstraintHandler::ImpactConstraintHandler()
   ip_max_iterations = 100;
   ip_eps = 1e-6;
   use_ip_solver = false;
+  use_pgs_solver = false;
+  pgs_max_iterations = 50;
+  pgs_tolerance = 1e-8;
+  use_ccp_solver = false;
+  ccp_max_iterations = 100;
+  ccp_tolerance = 1e-8;
+  auto_solver_selection = false;
+  auto_pgs_contact_threshold = 16;
+  force_visc_friction_model = false;
+  adaptive_tolerance = false;
+  adaptive_ke_threshold = 1e-6;
+  adaptive_velocity_threshold = 1e-4;
+  adaptive_tolerance_scale = 100.0;
+
+  // setup the contact force history (a simulator may later point this at a
+  // history shared with other handlers)
+  contact_force_history = boost::shared_ptr<ContactForceHistory>(new ContactForceHistory);
 
   // initialize IPOPT, if present
   #ifdef HAVE_IPOPT
@@ -68,6 +89,79 @@ ImpactConstraintHandler::ImpactConstraintHandler()
   #endif
 }
 
+// counts the bytes held by a matrix workspace
+static unsigned long matrix_bytes(const MatrixNd& M)
+{
+  return (unsigned long) (M.rows()*M.columns())*sizeof(double);
+}
+
+// counts the bytes held by a vector workspace
+static unsigned long vector_bytes(const VectorNd& v)
+{
+  return (unsigned long) v.size()*sizeof(double);
+}
+
+/// Estimates the heap memory held by the handler's workspaces and caches, in bytes
+/**
+ * Counts the solver workspace matrices and vectors (at their current sizes-
+ * they grow to the largest island solved so far), the warm-start cache, and
+ * any per-thread worker handlers.  Estimates exclude allocator overhead
+ * (see Primitive::calc_memory_usage()).
+ */
+unsigned long ImpactConstraintHandler::calc_memory_usage() const
+{
+  const unsigned long MAP_NODE = 3*sizeof(void*) + sizeof(int);
+
+  // count the workspace matrices and vectors
+  unsigned long bytes = 0;
+  bytes += matrix_bytes(_MM) + matrix_bytes(_rJx_iM_JxT) + matrix_bytes(_Y);
+  bytes += matrix_bytes(_Q_X_XT) + matrix_bytes(_workM) + matrix_bytes(_workM2);
+  bytes += matrix_bytes(_A) + matrix_bytes(_RTH);
+  bytes += matrix_bytes(_nqp_null_A) + matrix_bytes(_nqp_null_R);
+  bytes += matrix_bytes(_AU) + matrix_bytes(_AV) + matrix_bytes(_B);
+  bytes += matrix_bytes(_C) + matrix_bytes(_D);
+  bytes += vector_bytes(_zlast) + vector_bytes(_v) + vector_bytes(_workv);
+  bytes += vector_bytes(_new_Cn_v) + vector_bytes(_a) + vector_bytes(_b);
+  bytes += vector_bytes(_z) + vector_bytes(_cs_visc) + vector_bytes(_ct_visc);
+  bytes += vector_bytes(_YXv) + vector_bytes(_Xv) + vector_bytes(_cs_ct_alphax);
+  bytes += vector_bytes(_w) + vector_bytes(_workv2) + vector_bytes(_x);
+  bytes += vector_bytes(_AS) + vector_bytes(_alpha_x) + vector_bytes(_qq);
+  bytes += vector_bytes(_Cn_vplus);
+
+  // count the warm-start cache
+  for (std::map<WarmStartKey, VectorNd>::const_iterator i = _warm_start_cache.begin(); i != _warm_start_cache.end(); i++)
+  {
+    bytes += sizeof(*i) + MAP_NODE;
+    bytes += i->first.first.capacity()*sizeof(Ravelin::sorted_pair<CollisionGeometryPtr>);
+    bytes += i->first.second.capacity()*sizeof(std::pair<JointPtr, unsigned>);
+    bytes += vector_bytes(i->second);
+  }
+
+  // count the per-thread worker handlers
+  for (unsigned i=0; i< _workers.size(); i++)
+    bytes += sizeof(ImpactConstraintHandler) + _workers[i]->calc_memory_usage();
+
+  return bytes;
+}
+
+/// Releases the warm-start cache and the per-thread worker handlers
+/**
+ * Both are rebuilt on demand: dropping the warm-start cache only costs extra
+ * solver iterations on the next step, and workers are re-created the next
+ * time islands are solved in parallel.  The workspace matrices are kept-
+ * they are resized to fit each island anyway.  The active-set solver's
+ * workspaces are released, as they are retained at their high-water mark
+ * otherwise.
+ */
+void ImpactConstraintHandler::release_transient_memory()
+{
+  _warm_start_cache.clear();
+  _workers.clear();
+  #ifdef USE_QLCPD
+  _qp.release_transient_memory();
+  #endif
+}
+
 // Processes impacts
 /**
  * \param constraints the vector of constraints
@@ -110,45 +204,63 @@ void ImpactConstraintHandler::apply_model(const vector<UnilateralConstraint>& co
   // **********************************************************
   // do method for each connected set
   // **********************************************************
-  for (list<pair<list<UnilateralConstraint*>, list<shared_ptr<SingleBodyd> > > >::iterator i = groups.begin(); i != groups.end(); i++)
-  {
-      // copy the lists
-      pair<list<UnilateralConstraint*>, list<shared_ptr<SingleBodyd> > > rconstraints = *i;
 
-      FILE_LOG(LOG_CONSTRAINT) << " -- pre-constraint velocity (all constraints): " << std::endl;
-      for (list<UnilateralConstraint*>::iterator j = i->first.begin(); j != i->first.end(); j++)
-        FILE_LOG(LOG_CONSTRAINT) << "    constraint: " << std::endl << **j;
+  // collect the groups into a vector for indexed iteration
+  vector<pair<list<UnilateralConstraint*>, list<shared_ptr<SingleBodyd> > >*> vgroups;
+  for (list<pair<list<UnilateralConstraint*>, list<shared_ptr<SingleBodyd> > > >::iterator i = groups.begin(); i != groups.end(); i++)
+    vgroups.push_back(&*i);
 
-      // look to see whether all contact constraints have zero or infinite Coulomb friction
-      bool all_inf = true, all_frictionless = true;
-      BOOST_FOREACH(UnilateralConstraint* e, rconstraints.first)
-        if (e->constraint_type == UnilateralConstraint::eContact)
-        {
-          if (e->contact_mu_coulomb < 1e2)
-            all_inf = false;
-          if (e->contact_mu_coulomb > 0.0)
-            all_frictionless = false;
-        }
+  #ifdef _OPENMP
+  if (vgroups.size() > 1)
+  {
+    // groups touch disjoint sets of bodies, so their solves may run
+    // concurrently; each worker thread gets its own handler instance so the
+    // problem data, LCP solver and warm-start caches are not shared
+    const unsigned NTHREADS = (unsigned) omp_get_max_threads();
+    while (_workers.size() < NTHREADS)
+    {
+      shared_ptr<ImpactConstraintHandler> w(new ImpactConstraintHandler);
+      w->use_ip_solver = use_ip_solver;
+      w->ip_max_iterations = ip_max_iterations;
+      w->ip_eps = ip_eps;
+      w->use_pgs_solver = use_pgs_solver;
+      w->pgs_max_iterations = pgs_max_iterations;
+      w->pgs_tolerance = pgs_tolerance;
+      w->use_ccp_solver = use_ccp_solver;
+      w->ccp_max_iterations = ccp_max_iterations;
+      w->ccp_tolerance = ccp_tolerance;
+      w->auto_solver_selection = auto_solver_selection;
+      w->auto_pgs_contact_threshold = auto_pgs_contact_threshold;
+      w->force_visc_friction_model = force_visc_friction_model;
+      w->adaptive_tolerance = adaptive_tolerance;
+      w->adaptive_ke_threshold = adaptive_ke_threshold;
+      w->adaptive_velocity_threshold = adaptive_velocity_threshold;
+      w->adaptive_tolerance_scale = adaptive_tolerance_scale;
+      w->_simulator = _simulator;
+      _workers.push_back(w);
+    }
 
-      // apply model to the reduced contacts
-      if (all_inf)
-        apply_no_slip_model_to_connected_constraints(rconstraints.first, rconstraints.second);
-// TODO: fix viscous model- seems to be a bug in it
-//      else if (all_frictionless)
-//        apply_visc_friction_model_to_connected_constraints(rconstraints);
-  #ifdef USE_AP_MODEL
-      else {
-        apply_ap_model_to_connected_constraints(rconstraints.first, rconstraints.second);
+    // exceptions must not escape the parallel region; record and rethrow
+    bool group_failed = false;
+    #pragma omp parallel for schedule(dynamic)
+    for (int i=0; i< (int) vgroups.size(); i++)
+    {
+      try
+      {
+        _workers[omp_get_thread_num()]->apply_model_to_group(*vgroups[i]);
       }
-  #else
-      else
-        apply_model_to_connected_constraints(rconstraints.first, rconstraints.second);
-  #endif
-
-      FILE_LOG(LOG_CONSTRAINT) << " -- post-constraint velocity (all constraints): " << std::endl;
-      for (list<UnilateralConstraint*>::iterator j = i->first.begin(); j != i->first.end(); j++)
-        FILE_LOG(LOG_CONSTRAINT) << "    constraint: " << std::endl << **j;
+      catch (std::exception& e)
+      {
+        group_failed = true;
+      }
+    }
+    if (group_failed)
+      throw std::runtime_error("ImpactConstraintHandler::apply_model() - constraint group solve failed");
   }
+  else
+  #endif
+  for (unsigned i=0; i< vgroups.size(); i++)
+    apply_model_to_group(*vgroups[i]);
 
   // setup amount of constraint violation
   double max_vio = std::numeric_limits<double>::max();
@@ -167,6 +279,99 @@ void ImpactConstraintHandler::apply_model(const vector<UnilateralConstraint>& co
     throw ImpactToleranceException(impacting, max_vio);
 }
 
+/// Applies the appropriate impact model to one connected constraint group
+void ImpactConstraintHandler::apply_model_to_group(std::pair<std::list<UnilateralConstraint*>, std::list<boost::shared_ptr<Ravelin::SingleBodyd> > >& group)
+{
+  // copy the lists
+  pair<list<UnilateralConstraint*>, list<shared_ptr<SingleBodyd> > > rconstraints = group;
+
+  FILE_LOG(LOG_CONSTRAINT) << " -- pre-constraint velocity (all constraints): " << std::endl;
+  for (list<UnilateralConstraint*>::iterator j = group.first.begin(); j != group.first.end(); j++)
+    FILE_LOG(LOG_CONSTRAINT) << "    constraint: " << std::endl << **j;
+
+  // look to see whether all contact constraints have zero or infinite Coulomb
+  // friction, counting the contacts for per-island solver selection
+  bool all_inf = true, all_frictionless = true;
+  unsigned n_contacts = 0;
+  BOOST_FOREACH(UnilateralConstraint* e, rconstraints.first)
+    if (e->constraint_type == UnilateralConstraint::eContact)
+    {
+      n_contacts++;
+      if (e->contact_mu_coulomb < 1e2)
+        all_inf = false;
+      if (e->contact_mu_coulomb > 0.0)
+        all_frictionless = false;
+    }
+
+  // large islands are handed to the iterative solver when automatic
+  // selection is on: pivoting solvers win at low dimension but their cost
+  // grows far faster than PGS's linear per-sweep cost
+  const bool pgs_island = use_pgs_solver || (auto_solver_selection && n_contacts >= auto_pgs_contact_threshold);
+
+  // schedule the solver tolerances from the island's energy scale: a
+  // micro-jitter island (resting stack drift) does not warrant the same
+  // solver effort as an energetic impact, so its convergence tolerances are
+  // relaxed for the duration of the solve and restored afterward
+  const double saved_pgs_tolerance = pgs_tolerance;
+  const double saved_ccp_tolerance = ccp_tolerance;
+  const double saved_ip_eps = ip_eps;
+  if (adaptive_tolerance)
+  {
+    // compute the island kinetic energy over the (unique) super bodies
+    std::set<shared_ptr<DynamicBodyd> > supers;
+    BOOST_FOREACH(shared_ptr<SingleBodyd> sb, rconstraints.second)
+      supers.insert(get_super_body(sb));
+    double KE = 0.0;
+    for (std::set<shared_ptr<DynamicBodyd> >::const_iterator i = supers.begin(); i != supers.end(); i++)
+      KE += (*i)->calc_kinetic_energy();
+
+    // compute the largest constraint velocity magnitude
+    double vmax = 0.0;
+    BOOST_FOREACH(UnilateralConstraint* e, rconstraints.first)
+      vmax = std::max(vmax, std::fabs(e->calc_constraint_vel()));
+
+    // relax the iterative solver tolerances on a negligible-energy island
+    if (KE < adaptive_ke_threshold && vmax < adaptive_velocity_threshold)
+    {
+      pgs_tolerance *= adaptive_tolerance_scale;
+      ccp_tolerance *= adaptive_tolerance_scale;
+      ip_eps *= adaptive_tolerance_scale;
+      FILE_LOG(LOG_CONSTRAINT) << " -- negligible-energy island (KE=" << KE << ", max |constraint velocity|=" << vmax << "); relaxing solver tolerances by " << adaptive_tolerance_scale << "x" << std::endl;
+    }
+  }
+
+  // apply model to the reduced contacts; a simulator over its real-time
+  // budget forces the cheap viscous model regardless of the island type
+  if (force_visc_friction_model)
+    apply_visc_friction_model_to_connected_constraints(rconstraints.first, rconstraints.second);
+  else if (use_ccp_solver)
+    apply_ccp_model_to_connected_constraints(rconstraints.first, rconstraints.second);
+  else if (pgs_island)
+    apply_pgs_model_to_connected_constraints(rconstraints.first, rconstraints.second);
+  else if (all_inf)
+    apply_no_slip_model_to_connected_constraints(rconstraints.first, rconstraints.second);
+// TODO: fix viscous model- seems to be a bug in it
+//  else if (all_frictionless)
+//    apply_visc_friction_model_to_connected_constraints(rconstraints);
+  #ifdef USE_AP_MODEL
+  else {
+    apply_ap_model_to_connected_constraints(rconstraints.first, rconstraints.second);
+  }
+  #else
+  else
+    apply_model_to_connected_constraints(rconstraints.first, rconstraints.second);
+  #endif
+
+  // restore the configured tolerances
+  pgs_tolerance = saved_pgs_tolerance;
+  ccp_tolerance = saved_ccp_tolerance;
+  ip_eps = saved_ip_eps;
+
+  FILE_LOG(LOG_CONSTRAINT) << " -- post-constraint velocity (all constraints): " << std::endl;
+  for (list<UnilateralConstraint*>::iterator j = group.first.begin(); j != group.first.end(); j++)
+    FILE_LOG(LOG_CONSTRAINT) << "    constraint: " << std::endl << **j;
+}
+
 /**
  * Applies purely viscous friction model to connected constraints
  * \param constraints a set of connected constraints
@@ -673,10 +878,33 @@ void ImpactConstraintHandler::propagate_impulse_data(const UnilateralConstraintP
 }
 
 /// Applies impulses to bodies
+/**
+ * Constraint impulses are scattered into one packed generalized-impulse
+ * slab laid out like the island's stacked velocity (one segment per super
+ * body, in q.super_bodies order).  The body-to-segment table is built once
+ * per call, so each constraint does a table lookup and a contiguous segment
+ * accumulate instead of inserting into a map of per-body vectors; the slab
+ * is then applied with one generalized impulse per touched body.
+ */
 void ImpactConstraintHandler::apply_impulses(const UnilateralConstraintProblemData& q)
 {
-  map<shared_ptr<DynamicBodyd>, VectorNd> gj;
-  map<shared_ptr<DynamicBodyd>, VectorNd>::iterator gj_iter;
+  // build the scatter table for the island: each super body's segment start
+  // within the packed slab, in q.super_bodies order
+  map<shared_ptr<DynamicBodyd>, unsigned> body_index;
+  map<shared_ptr<DynamicBodyd>, unsigned>::const_iterator bi;
+  vector<unsigned> starts(q.super_bodies.size());
+  unsigned ngc = 0;
+  for (unsigned i=0; i< q.super_bodies.size(); i++)
+  {
+    body_index[q.super_bodies[i]] = i;
+    starts[i] = ngc;
+    ngc += q.super_bodies[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
+  }
+
+  // the slab accumulates every constraint's generalized impulse; bodies a
+  // constraint touches are flagged so untouched bodies skip the application
+  _gj.set_zero(ngc);
+  vector<bool> touched(q.super_bodies.size(), false);
 
   // loop over all contact constraints first
   for (unsigned i=0; i< q.contact_constraints.size(); i++)
@@ -693,22 +921,55 @@ void ImpactConstraintHandler::apply_impulses(const UnilateralConstraintProblemDa
     shared_ptr<DynamicBodyd> b1 = dynamic_pointer_cast<DynamicBodyd>(sb1->get_super_body());
     shared_ptr<DynamicBodyd> b2 = dynamic_pointer_cast<DynamicBodyd>(sb2->get_super_body());
 
-    // convert force on first body to generalized forces
-    if ((gj_iter = gj.find(b1)) == gj.end())
-      b1->convert_to_generalized_force(sb1, w, gj[b1]);
-    else
+    // fold torsional and rolling friction into the impulse: these couples
+    // act only on the angular velocities of the pair, so they are applied
+    // directly as equal and opposite couples here rather than as extra rows
+    // in the LCP (a couple is invariant to the point of application, so it
+    // adds straight to the spatial impulse's angular component)
+    if (e.contact_mu_torsional > 0.0 || e.contact_mu_rolling > 0.0)
+    {
+      // get the relative angular velocity in the global frame
+      Vector3d wa = Pose3d::transform(GLOBAL, sb1->get_velocity()).get_angular();
+      Vector3d wb = Pose3d::transform(GLOBAL, sb2->get_velocity()).get_angular();
+      Vector3d wrel = wa - wb;
+
+      // get the normal impulse magnitude that bounds the couples
+      const Vector3d& nhat = e.contact_normal;
+      double cn = std::max(w.get_force().dot(nhat), 0.0);
+
+      // oppose spin about the normal (torsional friction)
+      Vector3d tau(0.0, 0.0, 0.0, GLOBAL);
+      double wn = nhat.dot(wrel);
+      if (e.contact_mu_torsional > 0.0 && std::fabs(wn) > NEAR_ZERO)
+        tau -= nhat * (e.contact_mu_torsional * cn * ((wn > 0.0) ? 1.0 : -1.0));
+
+      // oppose rolling about the tangential axis (rolling friction)
+      Vector3d wt = wrel - nhat*wn;
+      double wt_norm = wt.norm();
+      if (e.contact_mu_rolling > 0.0 && wt_norm > NEAR_ZERO)
+        tau -= wt * (e.contact_mu_rolling * cn / wt_norm);
+
+      // add the couple to the spatial impulse
+      w.set_torque(w.get_torque() + tau);
+    }
+
+    // scatter the generalized force on the first body into its slab segment
+    // (a disabled body has no segment and takes no impulse)
+    if ((bi = body_index.find(b1)) != body_index.end())
     {
       b1->convert_to_generalized_force(sb1, w, _v);
-      gj_iter->second += _v;
+      SharedVectorNd gj_sub = _gj.segment(starts[bi->second], starts[bi->second]+_v.size());
+      gj_sub += _v;
+      touched[bi->second] = true;
     }
 
-    // convert force on second body to generalized forces
-    if ((gj_iter = gj.find(b2)) == gj.end())
-      b2->convert_to_generalized_force(sb2, -w, gj[b2]);
-    else
+    // scatter the generalized force on the second body into its slab segment
+    if ((bi = body_index.find(b2)) != body_index.end())
     {
       b2->convert_to_generalized_force(sb2, -w, _v);
-      gj_iter->second += _v;
+      SharedVectorNd gj_sub = _gj.segment(starts[bi->second], starts[bi->second]+_v.size());
+      gj_sub += _v;
+      touched[bi->second] = true;
     }
   }
 
@@ -718,33 +979,35 @@ void ImpactConstraintHandler::apply_impulses(const UnilateralConstraintProblemDa
     const UnilateralConstraint& e = *q.limit_constraints[i];
     ArticulatedBodyPtr ab = dynamic_pointer_cast<ArticulatedBody>(e.limit_joint->get_articulated_body());
 
-    // get the iterator for the articulated body
-    gj_iter = gj.find(ab);
-
     // cast as an RCArticulatedBody
     shared_ptr<RCArticulatedBody> rcab = dynamic_pointer_cast<RCArticulatedBody>(ab);
 
     // apply limit impulses to bodies in independent coordinates
-    if (rcab)
+    if (rcab && (bi = body_index.find(ab)) != body_index.end())
     {
       // get the index of the joint
       unsigned idx = e.limit_joint->get_coord_index() + e.limit_dof;
 
-      // initialize the vector if necessary
-      if (gj_iter == gj.end())
-      {
-        gj[ab].set_zero(rcab->num_generalized_coordinates(DynamicBodyd::eSpatial));
-        gj_iter = gj.find(ab);
-      }
-
       // set the limit force
-      gj_iter->second[idx] += e.limit_impulse;
+      _gj[starts[bi->second] + idx] += e.limit_impulse;
+      touched[bi->second] = true;
     }
   }
 
-  // apply all generalized impacts
-  for (map<shared_ptr<DynamicBodyd>, VectorNd>::const_iterator i = gj.begin(); i != gj.end(); i++)
-    i->first->apply_generalized_impulse(i->second);
+  // apply all generalized impacts, batched so that bodies coupled by
+  // implicit constraints share a single constrained solve
+  if (q.simulator)
+    q.simulator->start_impulse_batch();
+  for (unsigned i=0; i< q.super_bodies.size(); i++)
+  {
+    if (!touched[i])
+      continue;
+    const unsigned N_GC = q.super_bodies[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
+    SharedVectorNd gj_sub = _gj.segment(starts[i], starts[i]+N_GC);
+    q.super_bodies[i]->apply_generalized_impulse(gj_sub);
+  }
+  if (q.simulator)
+    q.simulator->flush_impulse_batch();
 }
 
 /*
@@ -886,6 +1149,9 @@ void ImpactConstraintHandler::compute_problem_data(UnilateralConstraintProblemDa
         q.Cn_v[i] = *data++;
         q.Cs_v[i] = *data++;
         q.Ct_v[i] = *data;
+
+        // credit the allowed approach speed of speculative contacts
+        q.Cn_v[i] += q.contact_constraints[i]->contact_approach_vel;
       }
       else
       {
@@ -1013,7 +1279,7 @@ void ImpactConstraintHandler::apply_no_slip_model(UnilateralConstraintProblemDat
   const unsigned NLIMITS = q.N_LIMITS;
   const unsigned N_IDX = 0;
   const unsigned L_IDX = N_IDX + NCONTACTS;
-  VectorNd lb, ub, b;
+  VectorNd b;
   MatrixNd A;
   double ke_plus = 0.0, ke_minus = 0.0;
 
@@ -1235,6 +1501,9 @@ void ImpactConstraintHandler::apply_no_slip_model(UnilateralConstraintProblemDat
   // setup remainder of LCP vector
   _qq -= _workv;
 
+  // capture the assembled problem, if capturing is enabled
+  LCP::capture(_MM, _qq);
+
   // attempt to solve the LCP using the fast method
   if (!_lcp.lcp_fast(_MM, _qq, _v))
   {
@@ -1243,19 +1512,19 @@ void ImpactConstraintHandler::apply_no_slip_model(UnilateralConstraintProblemDat
     #if defined(USE_QLCPD) or defined(USE_QPOASES)
     // solve didn't work; attempt to solve using QP solver
     (_workv = _qq) *= 0.5;
-    lb.set_zero(_qq.size());
-    ub.set_one(_qq.size()) *= 1e+29;
+    _lb.set_zero(_qq.size());
+    _ub.set_one(_qq.size()) *= 1e+29;
     A.set_zero(0, _qq.size());
     b.resize(0);
     (_workv2 = _qq).negate();
-    if (!_qp.qp_activeset(_MM, _workv, lb, ub, _MM, _workv2, A, b, _v))
+    if (!_qp.qp_activeset(_MM, _workv, _lb, _ub, _MM, _workv2, A, b, _v))
     {
       FILE_LOG(LOG_CONSTRAINT) << "QP failed to find feasible point; finding closest feasible point" << std::endl;
       FILE_LOG(LOG_CONSTRAINT) << "  old LCP q: " << _qq << std::endl;
 
       // QP solver didn't work; solve LP to find closest feasible solution
       #if defined(USE_QLCPD)
-      if (!_qp.find_closest_feasible(lb, ub, _MM, _workv2, A, b, _v))
+      if (!_qp.find_closest_feasible(_lb, _ub, _MM, _workv2, A, b, _v))
         throw std::runtime_error("Unable to solve constraint LCP!");
 
       #else
@@ -1271,7 +1540,7 @@ void ImpactConstraintHandler::apply_no_slip_model(UnilateralConstraintProblemDat
 
       // now try solving again
       (_workv2 = _qq).negate();
-      if (!_qp.qp_activeset(_MM, _workv, lb, ub, _MM, _workv2, A, b, _v))
+      if (!_qp.qp_activeset(_MM, _workv, _lb, _ub, _MM, _workv2, A, b, _v))
       {
         FILE_LOG(LOG_CONSTRAINT) << "QP failed to find feasible point *twice*" << std::endl;
         throw std::runtime_error("Unable to solve constraint LCP!");
@@ -1509,9 +1778,15 @@ void ImpactConstraintHandler::solve_frictionless_lcp(UnilateralConstraintProblem
   FILE_LOG(LOG_CONSTRAINT) << "  LCP matrix: " << std::endl << _MM;
   FILE_LOG(LOG_CONSTRAINT) << "  LCP vector: " << _qq << std::endl;
 
+  // capture the assembled problem, if capturing is enabled
+  LCP::capture(_MM, _qq);
+
   // solve the LCP
   if (!_lcp.lcp_fast(_MM, _qq, _v) && !_lcp.lcp_lemke_regularized(_MM, _qq, _v))
+  {
+    ContactProblemCapture::capture_failure(q);
     throw std::runtime_error("Unable to solve constraint LCP!");
+  }
 
   // determine the value of kappa
   SharedConstVectorNd cn = _v.segment(0, q.N_CONTACTS);
@@ -1780,6 +2055,79 @@ void ImpactConstraintHandler::compute_limit_components(const MatrixNd& X, Unilat
   }
 }
 
+/// Computes the limit components of the problem data from block-diagonal X
+/**
+ * Block-diagonal analogue of the dense version above: a limit index touches
+ * only the inverse inertia block of its own body, so X_LT columns are sparse
+ * and L_X_LT entries couple only limits within the same body block.
+ */
+void ImpactConstraintHandler::compute_limit_components(const std::vector<Ravelin::MatrixNd>& X_diag, UnilateralConstraintProblemData& q)
+{
+  // compute starting generalized coordinate indices for the blocks
+  vector<unsigned> st(X_diag.size()+1);
+  st[0] = 0;
+  for (unsigned i=0; i< X_diag.size(); i++)
+    st[i+1] = st[i] + X_diag[i].rows();
+
+  // determine the block holding each limit index
+  vector<unsigned> limit_block(q.N_LIMITS);
+  for (unsigned i=0; i< q.N_LIMITS; i++)
+  {
+    unsigned b = 0;
+    while (st[b+1] <= q.limit_indices[i])
+      b++;
+    limit_block[i] = b;
+  }
+
+  // compute X_LT
+  q.X_LT.set_zero(q.N_GC, q.N_LIMITS);
+  for (unsigned i=0; i< q.N_LIMITS; i++)
+  {
+    const unsigned b = limit_block[i];
+    const unsigned r = q.limit_indices[i] - st[b];
+    for (unsigned k=0; k< X_diag[b].columns(); k++)
+      q.X_LT(st[b]+k, i) = X_diag[b](r, k);
+  }
+
+  // compute L_X_LT
+  q.L_X_LT.set_zero(q.N_LIMITS, q.N_LIMITS);
+  for (unsigned i=0; i< q.N_LIMITS; i++)
+    for (unsigned j=i; j< q.N_LIMITS; j++)
+    {
+      if (limit_block[i] != limit_block[j])
+        continue;
+      const unsigned b = limit_block[i];
+      q.L_X_LT(i,j) = X_diag[b](q.limit_indices[i] - st[b], q.limit_indices[j] - st[b]);
+      if (i != j)
+        q.L_X_LT(j,i) = q.L_X_LT(i,j);
+    }
+
+  // compute L_v
+  q.L_v.resize(q.N_LIMITS);
+  for (unsigned i=0; i< q.N_LIMITS; i++)
+  {
+    const UnilateralConstraint& u = *q.limit_constraints[i];
+    q.L_v[i] = u.limit_joint->qd[u.limit_dof];
+    if (u.limit_upper)
+      q.L_v[i] = -q.L_v[i];
+  }
+}
+
+/// Computes the block-diagonal form of X, used when there are no implicit constraint equations
+/**
+ * Without implicit bilateral constraints, X = inv(M) exactly, which is block
+ * diagonal over the bodies in the island.
+ */
+void ImpactConstraintHandler::compute_X_diag(UnilateralConstraintProblemData& q, std::vector<Ravelin::MatrixNd>& X_diag)
+{
+  X_diag.resize(q.super_bodies.size());
+  for (unsigned i=0; i< q.super_bodies.size(); i++)
+  {
+    q.super_bodies[i]->get_generalized_inertia(X_diag[i]);
+    LinAlgd::inverse_SPD(X_diag[i]);
+  }
+}
+
 /// Updates the generalized velocity for all bodies in an island
 void ImpactConstraintHandler::update_generalized_velocities(const UnilateralConstraintProblemData& q, const VectorNd& dv)
 {
@@ -2002,6 +2350,10 @@ void ImpactConstraintHandler::compute_problem_data(UnilateralConstraintProblemDa
     assert(q.contact_constraints[i]->contact_NK == UINF);
   #endif
 
+  // reserve arena capacity so the resizes below reuse the persistent
+  // backing stores rather than reallocating every impact event
+  q.reserve(q.N_CONTACTS, q.N_LIMITS, q.N_CONSTRAINT_EQNS_IMP, q.N_GC);
+
   // initialize the problem matrices / vectors
   q.Cn_X_CnT.set_zero(q.N_CONTACTS, q.N_CONTACTS);
   q.Cn_X_CsT.set_zero(q.N_CONTACTS, q.N_CONTACTS);
@@ -2084,7 +2436,7 @@ void ImpactConstraintHandler::compute_problem_data(UnilateralConstraintProblemDa
       // add the block to the Jacobian
       q.Jfull.blocks.push_back(MatrixBlock());
       MatrixNd& block = q.Jfull.blocks.back().block;
-      q.island_ijoints[i]->calc_constraint_jacobian(true, block);
+      q.island_ijoints[i]->calc_constraint_jacobian_prepared(true, block);
       q.Jfull.blocks.back().st_row_idx = eq_idx;
       q.Jfull.blocks.back().st_col_idx = gc_map[inboard];
     }
@@ -2094,7 +2446,7 @@ void ImpactConstraintHandler::compute_problem_data(UnilateralConstraintProblemDa
       // add the block to the Jacobian
       q.Jfull.blocks.push_back(MatrixBlock());
       MatrixNd& block = q.Jfull.blocks.back().block;
-      q.island_ijoints[i]->calc_constraint_jacobian(false, block);
+      q.island_ijoints[i]->calc_constraint_jacobian_prepared(false, block);
       q.Jfull.blocks.back().st_row_idx = eq_idx;
       q.Jfull.blocks.back().st_col_idx = gc_map[outboard];
     }
@@ -2106,8 +2458,25 @@ void ImpactConstraintHandler::compute_problem_data(UnilateralConstraintProblemDa
   // determine active set of implicit constraints
   get_full_rank_implicit_constraints(q.Jfull, q.active);
 
-  // compute X
-  compute_X(q, X);
+  // when there are no implicit constraint equations, X is exactly the block
+  // diagonal of the inverse inertias, so the dense N_GC x N_GC matrix never
+  // needs to be materialized- important for large granular islands
+  vector<MatrixNd> X_diag;
+  const bool X_BLOCK_DIAG = (q.N_CONSTRAINT_EQNS_IMP == 0);
+  if (X_BLOCK_DIAG)
+  {
+    // setup the (empty) reduced implicit constraint Jacobian
+    q.J.blocks.clear();
+    q.J.rows = 0;
+    q.J.cols = q.Jfull.cols;
+    q.iM_JxT.resize(q.N_GC, 0);
+    q.Jx_iM_JxT.resize(0, 0);
+
+    // compute the block diagonal form of X
+    compute_X_diag(q, X_diag);
+  }
+  else
+    compute_X(q, X);
 
   // setup Jacobians for Cn, Cs, Ct
   SparseJacobian Cn, Cs, Ct;
@@ -2121,14 +2490,24 @@ void ImpactConstraintHandler::compute_problem_data(UnilateralConstraintProblemDa
   for (unsigned i=0; i< q.contact_constraints.size(); i++)
     add_contact_to_Jacobian(*q.contact_constraints[i], Cn, Cs, Ct, gc_map, i); 
 
-  // compute X_CnT, X_CsT, and X_CtT
-  Cn.mult(X, tmp);  MatrixNd::transpose(tmp, q.X_CnT);
-  Cs.mult(X, tmp);  MatrixNd::transpose(tmp, q.X_CsT);
-  Ct.mult(X, tmp);  MatrixNd::transpose(tmp, q.X_CtT);
-  q.J.mult(X, tmp); MatrixNd::transpose(tmp, q.X_JxT);
-  
-  // compute limit components - must do this first
-  compute_limit_components(X, q);
+  // compute X_CnT, X_CsT, and X_CtT, then the limit components (the limit
+  // components must be computed first among the products below)
+  if (X_BLOCK_DIAG)
+  {
+    Cn.mult(X_diag, tmp);  MatrixNd::transpose(tmp, q.X_CnT);
+    Cs.mult(X_diag, tmp);  MatrixNd::transpose(tmp, q.X_CsT);
+    Ct.mult(X_diag, tmp);  MatrixNd::transpose(tmp, q.X_CtT);
+    q.X_JxT.resize(q.N_GC, 0);
+    compute_limit_components(X_diag, q);
+  }
+  else
+  {
+    Cn.mult(X, tmp);  MatrixNd::transpose(tmp, q.X_CnT);
+    Cs.mult(X, tmp);  MatrixNd::transpose(tmp, q.X_CsT);
+    Ct.mult(X, tmp);  MatrixNd::transpose(tmp, q.X_CtT);
+    q.J.mult(X, tmp); MatrixNd::transpose(tmp, q.X_JxT);
+    compute_limit_components(X, q);
+  }
 
   // compute problem data for Cn rows
   Cn.mult(q.X_CnT, q.Cn_X_CnT); 
@@ -2159,9 +2538,16 @@ void ImpactConstraintHandler::compute_problem_data(UnilateralConstraintProblemDa
   Ct.mult(v, q.Ct_v);
   q.J.mult(v, q.Jx_v);
 
+  // credit the allowed approach speed of speculative contacts
+  for (unsigned i=0; i< q.contact_constraints.size(); i++)
+    q.Cn_v[i] += q.contact_constraints[i]->contact_approach_vel;
+
   // compute signed distance Jacobians
   #ifdef USE_SIGNED_DIST_CONSTRAINT
   SignedDistDot::compute_signed_dist_dot_Jacobians(q, q.Cdot_iM_CnT, q.Cdot_iM_CsT, q.Cdot_iM_CtT, q.Cdot_iM_LT, q.Cdot_v);
   #endif
+
+  // capture the assembled problem, if capturing all problems is enabled
+  ContactProblemCapture::capture(q);
 }
 
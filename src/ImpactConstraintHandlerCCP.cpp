@@ -0,0 +1,336 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <iomanip>
+#include <boost/foreach.hpp>
+#include <limits>
+#include <cmath>
+#include <Moby/Constants.h>
+#include <Moby/UnilateralConstraint.h>
+#include <Moby/CollisionGeometry.h>
+#include <Moby/RigidBody.h>
+#include <Moby/Log.h>
+#include <Moby/ImpactToleranceException.h>
+#include <Moby/NumericalException.h>
+#include <Moby/ImpactConstraintHandler.h>
+
+using namespace Ravelin;
+using namespace Moby;
+using std::list;
+using boost::shared_ptr;
+using std::vector;
+using std::map;
+using std::endl;
+using std::pair;
+using boost::dynamic_pointer_cast;
+
+/**
+ * Applies the cone-complementarity model to connected constraints
+ * \param constraints a set of connected constraints
+ */
+void ImpactConstraintHandler::apply_ccp_model_to_connected_constraints(const std::list<UnilateralConstraint*>& constraints, const list<shared_ptr<SingleBodyd> >& single_bodies)
+{
+  FILE_LOG(LOG_CONSTRAINT) << "ImpactConstraintHandler::apply_ccp_model_to_connected_constraints() entered" << endl;
+
+  // reset problem data
+  _epd.reset();
+
+  // save the constraints
+  _epd.constraints = vector<UnilateralConstraint*>(constraints.begin(), constraints.end());
+
+  // determine sets of contact and limit constraints
+  _epd.partition_constraints();
+
+  // compute all constraint cross-terms
+  compute_problem_data(_epd, single_bodies);
+
+  // clear all impulses
+  for (unsigned i=0; i< _epd.N_CONTACTS; i++)
+    _epd.contact_constraints[i]->contact_impulse.set_zero(GLOBAL);
+  for (unsigned i=0; i< _epd.N_LIMITS; i++)
+    _epd.limit_constraints[i]->limit_impulse = 0.0;
+
+  // solve the cone-complementarity problem
+  apply_ccp_model(_epd);
+
+  // determine velocities due to impulse application
+  update_constraint_velocities_from_impulses(_epd);
+
+  // get the constraint violation before applying impulses
+  double minv = calc_min_constraint_velocity(_epd);
+
+  // apply restitution
+  if (apply_restitution(_epd))
+  {
+    // determine velocities due to impulse application
+    update_constraint_velocities_from_impulses(_epd);
+
+    // check to see whether we need to solve another impact problem
+    double minv_plus = calc_min_constraint_velocity(_epd);
+    FILE_LOG(LOG_CONSTRAINT) << "Applying restitution" << std::endl;
+    FILE_LOG(LOG_CONSTRAINT) << "  compression v+ minimum: " << minv << std::endl;
+    FILE_LOG(LOG_CONSTRAINT) << "  restitution v+ minimum: " << minv_plus << std::endl;
+    if (minv_plus < 0.0 && minv_plus < minv - NEAR_ZERO)
+    {
+      // need to solve another impact problem
+      apply_ccp_model(_epd);
+    }
+    else
+      propagate_impulse_data(_epd);
+  }
+
+  // apply impulses
+  apply_impulses(_epd);
+
+  FILE_LOG(LOG_CONSTRAINT) << "ImpactConstraintHandler::apply_ccp_model_to_connected_constraints() exiting" << endl;
+}
+
+/// Solves the impact model as a cone-complementarity problem
+/**
+ * Where the LCP/QP backends linearize each Coulomb cone into 2+NK polyhedral
+ * rows (the NK edges trading cone accuracy for problem size), this backend
+ * keeps the exact second-order cone |(cs,ct)| <= mu cn and works with just
+ * three unknowns per contact: each fixed-point sweep steps a contact's
+ * impulse block against the current constraint velocities and projects it
+ * back onto the cone, so friction is isotropic at any sliding direction
+ * without any edge count to tune. Limit impulses are projected onto l >= 0
+ * as in the projected Gauss-Seidel backend. Impulses are warm started from
+ * the last solution computed for the same constraint set; the cache layout
+ * matches the Gauss-Seidel backend's, so switching backends between steps
+ * still warm starts.
+ */
+void ImpactConstraintHandler::apply_ccp_model(UnilateralConstraintProblemData& q)
+{
+  FILE_LOG(LOG_CONSTRAINT) << "ImpactConstraintHandler::apply_ccp_model() entered" << std::endl;
+
+  const unsigned NC = q.N_CONTACTS;
+  const unsigned NL = q.N_LIMITS;
+
+  // build the identity key for this constraint set (used for warm starting)
+  WarmStartKey key;
+  for (unsigned i=0; i< q.contact_constraints.size(); i++)
+    key.first.push_back(make_sorted_pair(q.contact_constraints[i]->contact_geom1, q.contact_constraints[i]->contact_geom2));
+  for (unsigned i=0; i< q.limit_constraints.size(); i++)
+    key.second.push_back(std::make_pair(q.limit_constraints[i]->limit_joint, q.limit_constraints[i]->limit_dof*2 + (q.limit_constraints[i]->limit_upper ? 1 : 0)));
+
+  // warm start the impulses from the last solution for this constraint set
+  map<WarmStartKey, VectorNd>::const_iterator wsi = _warm_start_cache.find(key);
+  if (wsi != _warm_start_cache.end() && wsi->second.size() == NC*3 + NL)
+  {
+    const VectorNd& z = wsi->second;
+    for (unsigned i=0; i< NC; i++)
+    {
+      q.cn[i] = z[i];
+      q.cs[i] = z[NC+i];
+      q.ct[i] = z[NC*2+i];
+    }
+    for (unsigned i=0; i< NL; i++)
+      q.l[i] = z[NC*3+i];
+  }
+
+  // do the projected fixed-point sweeps
+  solve_ccp(q);
+
+  // cache the solution for the next step; periodically clear the cache so
+  // that stale constraint sets do not accumulate in long-running scenes
+  VectorNd z(NC*3 + NL);
+  for (unsigned i=0; i< NC; i++)
+  {
+    z[i] = q.cn[i];
+    z[NC+i] = q.cs[i];
+    z[NC*2+i] = q.ct[i];
+  }
+  for (unsigned i=0; i< NL; i++)
+    z[NC*3+i] = q.l[i];
+  const unsigned WARM_START_CACHE_MAX = 1024;
+  if (_warm_start_cache.size() >= WARM_START_CACHE_MAX)
+    _warm_start_cache.clear();
+  _warm_start_cache[key] = z;
+
+  // propagate the impulse data
+  propagate_impulse_data(q);
+
+  FILE_LOG(LOG_CONSTRAINT) << "cn " << q.cn << std::endl;
+  FILE_LOG(LOG_CONSTRAINT) << "cs " << q.cs << std::endl;
+  FILE_LOG(LOG_CONSTRAINT) << "ct " << q.ct << std::endl;
+  FILE_LOG(LOG_CONSTRAINT) << "l " << q.l << std::endl;
+
+  FILE_LOG(LOG_CONSTRAINT) << "ImpactConstraintHandler::apply_ccp_model() exited" << std::endl;
+}
+
+// projects an impulse (cn, cs, ct) onto the second-order Coulomb cone
+// |(cs, ct)| <= mu cn, in place
+static void project_to_cone(double mu, double& cn, double& cs, double& ct)
+{
+  const double T = std::sqrt(cs*cs + ct*ct);
+
+  // the impulse lies in the polar cone: the nearest cone point is the apex
+  if (mu*T <= -cn)
+  {
+    cn = cs = ct = 0.0;
+    return;
+  }
+
+  // the impulse already lies inside the cone
+  if (T <= mu*cn)
+    return;
+
+  // project onto the cone surface; T > 0 here (T = 0 falls into one of the
+  // cases above for any cn)
+  cn = (cn + mu*T)/(1.0 + mu*mu);
+  const double SCALE = mu*cn/T;
+  cs *= SCALE;
+  ct *= SCALE;
+}
+
+// performs the cone-complementarity update for contact i's impulse block:
+// a diagonally-scaled step on all three impulse components against the
+// current constraint velocities, followed by projection onto the exact
+// Coulomb cone; returns the largest impulse change
+static double update_contact_cone_block(UnilateralConstraintProblemData& q, unsigned i)
+{
+  const unsigned NC = q.N_CONTACTS;
+  const unsigned NL = q.N_LIMITS;
+
+  // compute the normal velocity at contact i under the current impulses
+  double vn = q.Cn_v[i];
+  for (unsigned k=0; k< NC; k++)
+    vn += q.Cn_X_CnT(i,k)*q.cn[k] + q.Cn_X_CsT(i,k)*q.cs[k] + q.Cn_X_CtT(i,k)*q.ct[k];
+  for (unsigned k=0; k< NL; k++)
+    vn += q.Cn_X_LT(i,k)*q.l[k];
+
+  // compute the first tangent velocity at contact i
+  double vs = q.Cs_v[i];
+  for (unsigned k=0; k< NC; k++)
+    vs += q.Cn_X_CsT(k,i)*q.cn[k] + q.Cs_X_CsT(i,k)*q.cs[k] + q.Cs_X_CtT(i,k)*q.ct[k];
+  for (unsigned k=0; k< NL; k++)
+    vs += q.Cs_X_LT(i,k)*q.l[k];
+
+  // compute the second tangent velocity at contact i
+  double vt = q.Ct_v[i];
+  for (unsigned k=0; k< NC; k++)
+    vt += q.Cn_X_CtT(k,i)*q.cn[k] + q.Cs_X_CtT(k,i)*q.cs[k] + q.Ct_X_CtT(i,k)*q.ct[k];
+  for (unsigned k=0; k< NL; k++)
+    vt += q.Ct_X_LT(i,k)*q.l[k];
+
+  // take the diagonally-scaled step
+  double cn_new = q.cn[i], cs_new = q.cs[i], ct_new = q.ct[i];
+  const double dn = q.Cn_X_CnT(i,i);
+  if (dn > NEAR_ZERO)
+    cn_new -= vn/dn;
+  const double ds = q.Cs_X_CsT(i,i);
+  if (ds > NEAR_ZERO)
+    cs_new -= vs/ds;
+  const double dt = q.Ct_X_CtT(i,i);
+  if (dt > NEAR_ZERO)
+    ct_new -= vt/dt;
+
+  // project the stepped impulse back onto the Coulomb cone
+  const double MU = q.contact_constraints[i]->contact_mu_coulomb;
+  project_to_cone(MU, cn_new, cs_new, ct_new);
+
+  // record the largest impulse change and store the block
+  double max_change = std::fabs(cn_new - q.cn[i]);
+  max_change = std::max(max_change, std::fabs(cs_new - q.cs[i]));
+  max_change = std::max(max_change, std::fabs(ct_new - q.ct[i]));
+  q.cn[i] = cn_new;
+  q.cs[i] = cs_new;
+  q.ct[i] = ct_new;
+
+  return max_change;
+}
+
+// performs the projected update for limit i's impulse; returns the impulse
+// change
+static double update_limit_block(UnilateralConstraintProblemData& q, unsigned i)
+{
+  const unsigned NC = q.N_CONTACTS;
+  const unsigned NL = q.N_LIMITS;
+  double max_change = 0.0;
+
+  // compute the limit velocity under the current impulses
+  double vl = q.L_v[i];
+  for (unsigned k=0; k< NC; k++)
+    vl += q.Cn_X_LT(k,i)*q.cn[k] + q.Cs_X_LT(k,i)*q.cs[k] + q.Ct_X_LT(k,i)*q.ct[k];
+  for (unsigned k=0; k< NL; k++)
+    vl += q.L_X_LT(i,k)*q.l[k];
+
+  // update the limit impulse, projecting onto l >= 0
+  const double dl = q.L_X_LT(i,i);
+  if (dl > NEAR_ZERO)
+  {
+    double l_new = std::max(0.0, q.l[i] - vl/dl);
+    max_change = std::max(max_change, std::fabs(l_new - q.l[i]));
+    q.l[i] = l_new;
+  }
+
+  return max_change;
+}
+
+/// Runs the cone-complementarity sweeps on a constraint problem
+/**
+ * Operates purely on the numeric problem data, starting from the impulses
+ * already in cn/cs/ct/l, so captured problems can be replayed through this
+ * backend offline. Iteration stops when the largest impulse change over a
+ * sweep drops below ccp_tolerance or after ccp_max_iterations sweeps.
+ *
+ * With OpenMP, the constraints are grouped by the same graph coloring the
+ * projected Gauss-Seidel backend uses: constraints in one color share no
+ * dynamic body, so their blocks update concurrently without races.
+ * \return the number of sweeps performed
+ */
+unsigned ImpactConstraintHandler::solve_ccp(UnilateralConstraintProblemData& q)
+{
+  const unsigned NC = q.N_CONTACTS;
+  const unsigned NL = q.N_LIMITS;
+
+  #ifdef _OPENMP
+  // group the constraints into independent colors
+  std::vector<unsigned> colors;
+  const unsigned NCOLORS = color_constraint_graph(q, colors);
+  std::vector<std::vector<unsigned> > color_sets(NCOLORS);
+  for (unsigned i=0; i< colors.size(); i++)
+    color_sets[colors[i]].push_back(i);
+  std::vector<double> change;
+  #endif
+
+  // do the projected fixed-point sweeps
+  unsigned iter;
+  for (iter=0; iter< ccp_max_iterations; iter++)
+  {
+    double max_change = 0.0;
+
+    #ifdef _OPENMP
+    // process the colors in sequence, each color's blocks concurrently
+    for (unsigned c=0; c< NCOLORS; c++)
+    {
+      const std::vector<unsigned>& cset = color_sets[c];
+      change.resize(cset.size());
+      #pragma omp parallel for schedule(dynamic)
+      for (int j=0; j< (int) cset.size(); j++)
+        change[j] = (cset[j] < NC) ? update_contact_cone_block(q, cset[j]) : update_limit_block(q, cset[j] - NC);
+      for (unsigned j=0; j< cset.size(); j++)
+        max_change = std::max(max_change, change[j]);
+    }
+    #else
+    // update the contact impulse blocks
+    for (unsigned i=0; i< NC; i++)
+      max_change = std::max(max_change, update_contact_cone_block(q, i));
+
+    // update the limit impulses
+    for (unsigned i=0; i< NL; i++)
+      max_change = std::max(max_change, update_limit_block(q, i));
+    #endif
+
+    FILE_LOG(LOG_CONSTRAINT) << "  CCP sweep " << iter << " max impulse change: " << max_change << std::endl;
+
+    // see whether the iteration has converged
+    if (max_change < ccp_tolerance)
+      break;
+  }
+
+  return iter;
+}
@@ -5,6 +5,7 @@
 #include <set>
 #include <cmath>
 #include <numeric>
+#include <algorithm>
 #include <Moby/permute.h>
 #include <Moby/RCArticulatedBody.h>
 #include <Moby/Constants.h>
@@ -243,6 +244,11 @@ void ImpactConstraintHandler::apply_ap_model(UnilateralConstraintProblemData& q)
   _UL.set_sub_mat(N_FRICT,NC+NC,L_X_CsT);
   _UL.set_sub_mat(N_FRICT,NC+NC*3,L_X_CtT);
 
+  // cone-edge direction cosines depend only on the edge count, so tabulate
+  // them once per distinct count instead of calling cos/sin per matrix entry
+  // (eight calls per edge per contact otherwise)
+  std::map<unsigned, std::vector<std::pair<double, double> > > cone_dirs;
+
   // lower left & upper right block of matrix
   for(unsigned i=0,j=0,r=0;i<NC;i++)
   {
@@ -250,24 +256,36 @@ void ImpactConstraintHandler::apply_ap_model(UnilateralConstraintProblemData& q)
     if (ci->contact_NK > 4)
     {
       int nk4 = ( ci->contact_NK+4)/4;
+      std::vector<std::pair<double, double> >& dirs = cone_dirs[nk4];
+      if (dirs.empty())
+      {
+        dirs.resize(nk4);
+        for (unsigned k=0; k< nk4; k++)
+        {
+          dirs[k].first = cos((M_PI*k)/(2.0*nk4));
+          dirs[k].second = sin((M_PI*k)/(2.0*nk4));
+        }
+      }
       for(unsigned k=0;k<nk4;k++)
       {
         FILE_LOG(LOG_CONSTRAINT) << "mu_{"<< k<< ","<< i <<"}: " << ci->contact_mu_coulomb << std::endl;
+        const double ck = dirs[k].first;
+        const double sk = dirs[k].second;
 
         // muK
         _LL(r+k,i)         = ci->contact_mu_coulomb;
         // Xe
-        _LL(r+k,NC+j)      = -cos((M_PI*k)/(2.0*nk4));
-        _LL(r+k,NC+NC+j)   = -cos((M_PI*k)/(2.0*nk4));
+        _LL(r+k,NC+j)      = -ck;
+        _LL(r+k,NC+NC+j)   = -ck;
         // Xf
-        _LL(r+k,NC+NC*2+j) = -sin((M_PI*k)/(2.0*nk4));
-        _LL(r+k,NC+NC*3+j) = -sin((M_PI*k)/(2.0*nk4));
+        _LL(r+k,NC+NC*2+j) = -sk;
+        _LL(r+k,NC+NC*3+j) = -sk;
         // XeT
-        _UR(NC+j,r+k)      =  cos((M_PI*k)/(2.0*nk4));
-        _UR(NC+NC+j,r+k)   =  cos((M_PI*k)/(2.0*nk4));
+        _UR(NC+j,r+k)      =  ck;
+        _UR(NC+NC+j,r+k)   =  ck;
         // XfT
-        _UR(NC+NC*2+j,r+k) =  sin((M_PI*k)/(2.0*nk4));
-        _UR(NC+NC*3+j,r+k) =  sin((M_PI*k)/(2.0*nk4));
+        _UR(NC+NC*2+j,r+k) =  sk;
+        _UR(NC+NC*3+j,r+k) =  sk;
       }
       r+=nk4;
       j++;
@@ -328,11 +346,64 @@ void ImpactConstraintHandler::apply_ap_model(UnilateralConstraintProblemData& q)
   q.Cs_v.negate();
   q.Ct_v.negate();
 
-  // solve the LCP
+  // build the identity key for this constraint set so that temporally
+  // coherent problems (e.g., resting stacks) can be warm started from the
+  // last solution computed for the same set of contacts and limits
+  WarmStartKey key;
+  for (unsigned i=0; i< q.contact_constraints.size(); i++)
+    key.first.push_back(make_sorted_pair(q.contact_constraints[i]->contact_geom1, q.contact_constraints[i]->contact_geom2));
+  for (unsigned i=0; i< q.limit_constraints.size(); i++)
+    key.second.push_back(std::make_pair(q.limit_constraints[i]->limit_joint, q.limit_constraints[i]->limit_dof*2 + (q.limit_constraints[i]->limit_upper ? 1 : 0)));
+
+  // capture the assembled problem, if capturing is enabled
+  LCP::capture(_MM, _qq);
+
+  // solve the LCP, attempting the pivoting solver first with the cached
+  // solution- a coherent problem resolves in a handful of pivots- and
+  // falling back to regularized Lemke on a cache miss or solver failure
   VectorNd z;
-  if (!_lcp.lcp_lemke_regularized(_MM, _qq, z, -20, 1, -2))
+  bool solved = false;
+  std::map<WarmStartKey, VectorNd>::const_iterator wsi = _warm_start_cache.find(key);
+  if (wsi != _warm_start_cache.end() && wsi->second.size() == _qq.size())
+  {
+    z = wsi->second;
+    solved = _lcp.lcp_fast(_MM, _qq, z);
+    if (!solved)
+      FILE_LOG(LOG_CONSTRAINT) << "warm-started pivoting solve failed; falling back to Lemke" << std::endl;
+  }
+  else if (contact_force_history)
+  {
+    // no solution is cached for this exact constraint set; seed the
+    // pivoting solver from the per-contact history instead, which persists
+    // across changes in set composition and may have been written by the
+    // sustained contact handler at the acceleration level
+    z.set_zero(_qq.size());
+    bool seeded = false;
+    for (unsigned i=0; i< NC; i++)
+    {
+      ContactForceHistory::Record rec;
+      if (!contact_force_history->lookup(q.contact_constraints[i]->contact_geom1, q.contact_constraints[i]->contact_geom2, rec))
+        continue;
+      seeded = true;
+      z[i] = rec.cn;
+      z[NC+i] = std::max(rec.cs, 0.0);
+      z[NC+NC+i] = std::max(-rec.cs, 0.0);
+      z[NC+NC*2+i] = std::max(rec.ct, 0.0);
+      z[NC+NC*3+i] = std::max(-rec.ct, 0.0);
+    }
+    if (seeded)
+      solved = _lcp.lcp_fast(_MM, _qq, z);
+  }
+  if (!solved && !_lcp.lcp_lemke_regularized(_MM, _qq, z, -20, 1, -2))
     throw std::exception();
 
+  // cache the solution for the next step; periodically clear the cache so
+  // that stale constraint sets do not accumulate in long-running scenes
+  const unsigned WARM_START_CACHE_MAX = 1024;
+  if (_warm_start_cache.size() >= WARM_START_CACHE_MAX)
+    _warm_start_cache.clear();
+  _warm_start_cache[key] = z;
+
   for(unsigned i=0,j=0;i<NC;i++)
   {
     q.cn[i] = z[i];
@@ -343,6 +414,12 @@ void ImpactConstraintHandler::apply_ap_model(UnilateralConstraintProblemData& q)
 
   q.l = z.segment(N_FRICT,N_FRICT+N_LIMIT);
 
+  // record the solved contact impulses in the shared history so that later
+  // solves (by this handler or the sustained contact handler) start warm
+  if (contact_force_history)
+    for (unsigned i=0; i< NC; i++)
+      contact_force_history->update(q.contact_constraints[i]->contact_geom1, q.contact_constraints[i]->contact_geom2, q.cn[i], q.cs[i], q.ct[i]);
+
   // setup a temporary frame
   shared_ptr<Pose3d> P(new Pose3d);
 
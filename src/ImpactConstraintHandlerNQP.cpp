@@ -11,6 +11,7 @@
 #include <limits>
 #include <set>
 #include <cmath>
+#include <algorithm>
 #include <numeric>
 #include <Moby/ArticulatedBody.h>
 #include <Moby/Constants.h>
@@ -142,7 +143,20 @@ void ImpactConstraintHandler::solve_nqp_work(UnilateralConstraintProblemData& q,
     MatrixNd::transpose(q.Cs_iM_JxT, b2);
     MatrixNd::transpose(q.Ct_iM_JxT, b3);
     MatrixNd::transpose(q.L_iM_JxT, b4);
-    _LA.nullspace(_A, R);
+
+    // reuse the nullspace from the last solve when the constraint matrix is
+    // unchanged (sustained contact with an unchanged active set); the
+    // comparison is O(mn) versus the O(n^3) SVD underlying nullspace()
+    if (_A.rows() == _nqp_null_A.rows() && _A.columns() == _nqp_null_A.columns() &&
+        std::equal(_A.data(), _A.data() + _A.rows()*_A.columns(), _nqp_null_A.data()))
+      R = _nqp_null_R;
+    else
+    {
+      // save the matrix before nullspace() destroys it, then cache the result
+      _nqp_null_A = _A;
+      _LA.nullspace(_A, R);
+      _nqp_null_R = R;
+    }
   }
   else
     // clear the nullspace 
@@ -308,11 +322,22 @@ void ImpactConstraintHandler::solve_nqp_work(UnilateralConstraintProblemData& q,
 //  _app.Options()->SetIntegerValue("max_iter", 10000);
 //  _app.Options()->SetStringValue("derivative_test", "second-order");
 
+  // warm start from the previous solution when one is available;
+  // get_starting_point() serves the saved primal/dual iterates (or falls
+  // back to cold-start values if the problem dimensions have changed) and
+  // the push options keep the saved iterates from being perturbed far from
+  // their bounds
+  _app.Options()->SetStringValue("warm_start_init_point", (_ipsolver->_warm_start_ready) ? "yes" : "no");
+  _app.Options()->SetNumericValue("warm_start_bound_push", 1e-9);
+  _app.Options()->SetNumericValue("warm_start_mult_bound_push", 1e-9);
+
   // set the ipsolver tolerance on the Coulomb friction and kappa constraints
   _ipsolver->_tol = 0.0;
 
-  // solve the nonlinear QP using the interior-point algorithm 
-  _app.Initialize();
+  // solve the nonlinear QP using the interior-point algorithm; the
+  // application was initialized at handler construction, so the per-solve
+  // Initialize() (re-reading the options file and rebuilding the journals)
+  // is not repeated here
   Ipopt::ApplicationReturnStatus status = _app.OptimizeTNLP(_ipsolver);
 
   // look for acceptable solve conditions
@@ -0,0 +1,401 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <iomanip>
+#include <boost/foreach.hpp>
+#include <limits>
+#include <cmath>
+#include <Moby/Constants.h>
+#include <Moby/UnilateralConstraint.h>
+#include <Moby/CollisionGeometry.h>
+#include <Moby/RigidBody.h>
+#include <Moby/Log.h>
+#include <Moby/ImpactToleranceException.h>
+#include <Moby/NumericalException.h>
+#include <Moby/ImpactConstraintHandler.h>
+
+using namespace Ravelin;
+using namespace Moby;
+using std::list;
+using boost::shared_ptr;
+using std::vector;
+using std::map;
+using std::endl;
+using std::pair;
+using boost::dynamic_pointer_cast;
+
+/**
+ * Applies the projected Gauss-Seidel model to connected constraints
+ * \param constraints a set of connected constraints
+ */
+void ImpactConstraintHandler::apply_pgs_model_to_connected_constraints(const std::list<UnilateralConstraint*>& constraints, const list<shared_ptr<SingleBodyd> >& single_bodies)
+{
+  FILE_LOG(LOG_CONSTRAINT) << "ImpactConstraintHandler::apply_pgs_model_to_connected_constraints() entered" << endl;
+
+  // reset problem data
+  _epd.reset();
+
+  // save the constraints
+  _epd.constraints = vector<UnilateralConstraint*>(constraints.begin(), constraints.end());
+
+  // determine sets of contact and limit constraints
+  _epd.partition_constraints();
+
+  // compute all constraint cross-terms
+  compute_problem_data(_epd, single_bodies);
+
+  // clear all impulses
+  for (unsigned i=0; i< _epd.N_CONTACTS; i++)
+    _epd.contact_constraints[i]->contact_impulse.set_zero(GLOBAL);
+  for (unsigned i=0; i< _epd.N_LIMITS; i++)
+    _epd.limit_constraints[i]->limit_impulse = 0.0;
+
+  // solve with projected Gauss-Seidel
+  apply_pgs_model(_epd);
+
+  // determine velocities due to impulse application
+  update_constraint_velocities_from_impulses(_epd);
+
+  // get the constraint violation before applying impulses
+  double minv = calc_min_constraint_velocity(_epd);
+
+  // apply restitution
+  if (apply_restitution(_epd))
+  {
+    // determine velocities due to impulse application
+    update_constraint_velocities_from_impulses(_epd);
+
+    // check to see whether we need to solve another impact problem
+    double minv_plus = calc_min_constraint_velocity(_epd);
+    FILE_LOG(LOG_CONSTRAINT) << "Applying restitution" << std::endl;
+    FILE_LOG(LOG_CONSTRAINT) << "  compression v+ minimum: " << minv << std::endl;
+    FILE_LOG(LOG_CONSTRAINT) << "  restitution v+ minimum: " << minv_plus << std::endl;
+    if (minv_plus < 0.0 && minv_plus < minv - NEAR_ZERO)
+    {
+      // need to solve another impact problem
+      apply_pgs_model(_epd);
+    }
+    else
+      propagate_impulse_data(_epd);
+  }
+
+  // apply impulses
+  apply_impulses(_epd);
+
+  FILE_LOG(LOG_CONSTRAINT) << "ImpactConstraintHandler::apply_pgs_model_to_connected_constraints() exiting" << endl;
+}
+
+/// Solves the impact model with projected Gauss-Seidel iteration
+/**
+ * Iterates directly over the contact and limit impulses using the
+ * block cross-terms already present in the problem data, never assembling
+ * the stacked LCP matrix: each sweep updates the normal impulses (projected
+ * onto cn >= 0), the tangent impulses (projected onto the box
+ * |cs|,|ct| <= mu cn) and the limit impulses (projected onto l >= 0).
+ * Iteration stops when the largest impulse change over a sweep drops below
+ * pgs_tolerance or after pgs_max_iterations sweeps, so the per-step cost is
+ * bounded regardless of problem size; the result is approximate where a
+ * direct solver would be exact. Impulses are warm started from the last
+ * solution computed for the same constraint set.
+ */
+void ImpactConstraintHandler::apply_pgs_model(UnilateralConstraintProblemData& q)
+{
+  FILE_LOG(LOG_CONSTRAINT) << "ImpactConstraintHandler::apply_pgs_model() entered" << std::endl;
+
+  const unsigned NC = q.N_CONTACTS;
+  const unsigned NL = q.N_LIMITS;
+
+  // build the identity key for this constraint set (used for warm starting)
+  WarmStartKey key;
+  for (unsigned i=0; i< q.contact_constraints.size(); i++)
+    key.first.push_back(make_sorted_pair(q.contact_constraints[i]->contact_geom1, q.contact_constraints[i]->contact_geom2));
+  for (unsigned i=0; i< q.limit_constraints.size(); i++)
+    key.second.push_back(std::make_pair(q.limit_constraints[i]->limit_joint, q.limit_constraints[i]->limit_dof*2 + (q.limit_constraints[i]->limit_upper ? 1 : 0)));
+
+  // warm start the impulses from the last solution for this constraint set
+  map<WarmStartKey, VectorNd>::const_iterator wsi = _warm_start_cache.find(key);
+  if (wsi != _warm_start_cache.end() && wsi->second.size() == NC*3 + NL)
+  {
+    const VectorNd& z = wsi->second;
+    for (unsigned i=0; i< NC; i++)
+    {
+      q.cn[i] = z[i];
+      q.cs[i] = z[NC+i];
+      q.ct[i] = z[NC*2+i];
+    }
+    for (unsigned i=0; i< NL; i++)
+      q.l[i] = z[NC*3+i];
+  }
+
+  // do the Gauss-Seidel sweeps
+  solve_pgs(q);
+
+  // cache the solution for the next step; periodically clear the cache so
+  // that stale constraint sets do not accumulate in long-running scenes
+  VectorNd z(NC*3 + NL);
+  for (unsigned i=0; i< NC; i++)
+  {
+    z[i] = q.cn[i];
+    z[NC+i] = q.cs[i];
+    z[NC*2+i] = q.ct[i];
+  }
+  for (unsigned i=0; i< NL; i++)
+    z[NC*3+i] = q.l[i];
+  const unsigned WARM_START_CACHE_MAX = 1024;
+  if (_warm_start_cache.size() >= WARM_START_CACHE_MAX)
+    _warm_start_cache.clear();
+  _warm_start_cache[key] = z;
+
+  // propagate the impulse data
+  propagate_impulse_data(q);
+
+  FILE_LOG(LOG_CONSTRAINT) << "cn " << q.cn << std::endl;
+  FILE_LOG(LOG_CONSTRAINT) << "cs " << q.cs << std::endl;
+  FILE_LOG(LOG_CONSTRAINT) << "ct " << q.ct << std::endl;
+  FILE_LOG(LOG_CONSTRAINT) << "l " << q.l << std::endl;
+
+  FILE_LOG(LOG_CONSTRAINT) << "ImpactConstraintHandler::apply_pgs_model() exited" << std::endl;
+}
+
+// performs the projected Gauss-Seidel update for contact i's impulse block
+// (normal and both tangents); returns the largest impulse change
+static double update_contact_block(UnilateralConstraintProblemData& q, unsigned i)
+{
+  const unsigned NC = q.N_CONTACTS;
+  const unsigned NL = q.N_LIMITS;
+  double max_change = 0.0;
+
+  // compute the normal velocity at contact i under the current impulses
+  double vn = q.Cn_v[i];
+  for (unsigned k=0; k< NC; k++)
+    vn += q.Cn_X_CnT(i,k)*q.cn[k] + q.Cn_X_CsT(i,k)*q.cs[k] + q.Cn_X_CtT(i,k)*q.ct[k];
+  for (unsigned k=0; k< NL; k++)
+    vn += q.Cn_X_LT(i,k)*q.l[k];
+
+  // update the normal impulse, projecting onto cn >= 0
+  const double dn = q.Cn_X_CnT(i,i);
+  if (dn > NEAR_ZERO)
+  {
+    double cn_new = std::max(0.0, q.cn[i] - vn/dn);
+    max_change = std::max(max_change, std::fabs(cn_new - q.cn[i]));
+    q.cn[i] = cn_new;
+  }
+
+  // get the friction bound for this contact
+  const double MU = q.contact_constraints[i]->contact_mu_coulomb;
+  const double BOUND = MU*q.cn[i];
+
+  // compute the first tangent velocity at contact i
+  double vs = q.Cs_v[i];
+  for (unsigned k=0; k< NC; k++)
+    vs += q.Cn_X_CsT(k,i)*q.cn[k] + q.Cs_X_CsT(i,k)*q.cs[k] + q.Cs_X_CtT(i,k)*q.ct[k];
+  for (unsigned k=0; k< NL; k++)
+    vs += q.Cs_X_LT(i,k)*q.l[k];
+
+  // update the first tangent impulse, projecting onto the friction box
+  const double ds = q.Cs_X_CsT(i,i);
+  if (ds > NEAR_ZERO)
+  {
+    double cs_new = q.cs[i] - vs/ds;
+    cs_new = std::max(-BOUND, std::min(BOUND, cs_new));
+    max_change = std::max(max_change, std::fabs(cs_new - q.cs[i]));
+    q.cs[i] = cs_new;
+  }
+
+  // compute the second tangent velocity at contact i
+  double vt = q.Ct_v[i];
+  for (unsigned k=0; k< NC; k++)
+    vt += q.Cn_X_CtT(k,i)*q.cn[k] + q.Cs_X_CtT(k,i)*q.cs[k] + q.Ct_X_CtT(i,k)*q.ct[k];
+  for (unsigned k=0; k< NL; k++)
+    vt += q.Ct_X_LT(i,k)*q.l[k];
+
+  // update the second tangent impulse, projecting onto the friction box
+  const double dt = q.Ct_X_CtT(i,i);
+  if (dt > NEAR_ZERO)
+  {
+    double ct_new = q.ct[i] - vt/dt;
+    ct_new = std::max(-BOUND, std::min(BOUND, ct_new));
+    max_change = std::max(max_change, std::fabs(ct_new - q.ct[i]));
+    q.ct[i] = ct_new;
+  }
+
+  return max_change;
+}
+
+// performs the projected Gauss-Seidel update for limit i's impulse;
+// returns the impulse change
+static double update_limit_block(UnilateralConstraintProblemData& q, unsigned i)
+{
+  const unsigned NC = q.N_CONTACTS;
+  const unsigned NL = q.N_LIMITS;
+  double max_change = 0.0;
+
+  // compute the limit velocity under the current impulses
+  double vl = q.L_v[i];
+  for (unsigned k=0; k< NC; k++)
+    vl += q.Cn_X_LT(k,i)*q.cn[k] + q.Cs_X_LT(k,i)*q.cs[k] + q.Ct_X_LT(k,i)*q.ct[k];
+  for (unsigned k=0; k< NL; k++)
+    vl += q.L_X_LT(i,k)*q.l[k];
+
+  // update the limit impulse, projecting onto l >= 0
+  const double dl = q.L_X_LT(i,i);
+  if (dl > NEAR_ZERO)
+  {
+    double l_new = std::max(0.0, q.l[i] - vl/dl);
+    max_change = std::max(max_change, std::fabs(l_new - q.l[i]));
+    q.l[i] = l_new;
+  }
+
+  return max_change;
+}
+
+/// Colors the constraint graph so no color has two constraints on one body
+/**
+ * Constraints (contacts first, then limits) are greedily assigned the
+ * smallest color not used by a constraint sharing one of their dynamic
+ * super bodies. Disabled bodies have no degrees of freedom and induce no
+ * constraint coupling, so contacts against static geometry do not conflict
+ * through it.
+ * \param colors on return, the color of each constraint (contact i at
+ *        index i, limit j at index N_CONTACTS + j)
+ * \return the number of colors used
+ */
+unsigned ImpactConstraintHandler::color_constraint_graph(const UnilateralConstraintProblemData& q, std::vector<unsigned>& colors)
+{
+  const unsigned NC = q.N_CONTACTS;
+  const unsigned NL = q.N_LIMITS;
+  const unsigned N = NC + NL;
+  const unsigned UNCOLORED = std::numeric_limits<unsigned>::max();
+
+  // get the (enabled) super bodies of each constraint and map each body to
+  // the constraints acting on it
+  vector<shared_ptr<DynamicBodyd> > cb1(N), cb2(N);
+  map<shared_ptr<DynamicBodyd>, vector<unsigned> > body_cons;
+  for (unsigned i=0; i< NC; i++)
+  {
+    shared_ptr<DynamicBodyd> b1 = get_super_body(q.contact_constraints[i]->contact_geom1->get_single_body());
+    shared_ptr<DynamicBodyd> b2 = get_super_body(q.contact_constraints[i]->contact_geom2->get_single_body());
+    if (b1->is_enabled())
+    {
+      cb1[i] = b1;
+      body_cons[b1].push_back(i);
+    }
+    if (b2->is_enabled())
+    {
+      cb2[i] = b2;
+      body_cons[b2].push_back(i);
+    }
+  }
+  for (unsigned i=0; i< NL; i++)
+  {
+    shared_ptr<DynamicBodyd> ab = dynamic_pointer_cast<DynamicBodyd>(q.limit_constraints[i]->limit_joint->get_articulated_body());
+    if (ab && ab->is_enabled())
+    {
+      cb1[NC+i] = ab;
+      body_cons[ab].push_back(NC+i);
+    }
+  }
+
+  // greedily assign each constraint the smallest color unused by the
+  // constraints it shares a body with
+  colors.assign(N, UNCOLORED);
+  unsigned num_colors = 0;
+  vector<bool> used;
+  for (unsigned i=0; i< N; i++)
+  {
+    // mark the colors already taken by conflicting constraints
+    used.assign(num_colors+1, false);
+    for (unsigned side=0; side< 2; side++)
+    {
+      shared_ptr<DynamicBodyd> b = (side == 0) ? cb1[i] : cb2[i];
+      if (!b)
+        continue;
+      const vector<unsigned>& cons = body_cons[b];
+      for (unsigned k=0; k< cons.size(); k++)
+        if (colors[cons[k]] != UNCOLORED)
+          used[colors[cons[k]]] = true;
+    }
+
+    // take the smallest free color
+    unsigned c = 0;
+    while (c < used.size() && used[c])
+      c++;
+    colors[i] = c;
+    num_colors = std::max(num_colors, c+1);
+  }
+
+  return num_colors;
+}
+
+/// Runs the projected Gauss-Seidel sweeps on a constraint problem
+/**
+ * Operates purely on the numeric problem data (the cross-constraint
+ * matrices, the velocity vectors and the per-contact Coulomb friction
+ * coefficients), starting from the impulses already in cn/cs/ct/l, so
+ * captured problems can be replayed through this backend offline.
+ *
+ * With OpenMP, the constraints are grouped by graph coloring: constraints
+ * in one color share no dynamic body, so their cross-terms are zero and
+ * their blocks update concurrently without races while preserving
+ * Gauss-Seidel semantics (each block still sees every impulse it couples
+ * to at its latest value). The coloring is rebuilt each solve; its cost
+ * is linear in the constraint graph and is dwarfed by a single sweep.
+ * Results are independent of the thread count, though the color ordering
+ * itself permutes the sweep order relative to the serial path.
+ * \return the number of sweeps performed
+ */
+unsigned ImpactConstraintHandler::solve_pgs(UnilateralConstraintProblemData& q)
+{
+  const unsigned NC = q.N_CONTACTS;
+  const unsigned NL = q.N_LIMITS;
+
+  #ifdef _OPENMP
+  // group the constraints into independent colors
+  std::vector<unsigned> colors;
+  const unsigned NCOLORS = color_constraint_graph(q, colors);
+  std::vector<std::vector<unsigned> > color_sets(NCOLORS);
+  for (unsigned i=0; i< colors.size(); i++)
+    color_sets[colors[i]].push_back(i);
+  std::vector<double> change;
+  #endif
+
+  // do the Gauss-Seidel sweeps
+  unsigned iter;
+  for (iter=0; iter< pgs_max_iterations; iter++)
+  {
+    double max_change = 0.0;
+
+    #ifdef _OPENMP
+    // process the colors in sequence, each color's blocks concurrently
+    for (unsigned c=0; c< NCOLORS; c++)
+    {
+      const std::vector<unsigned>& cset = color_sets[c];
+      change.resize(cset.size());
+      #pragma omp parallel for schedule(dynamic)
+      for (int j=0; j< (int) cset.size(); j++)
+        change[j] = (cset[j] < NC) ? update_contact_block(q, cset[j]) : update_limit_block(q, cset[j] - NC);
+      for (unsigned j=0; j< cset.size(); j++)
+        max_change = std::max(max_change, change[j]);
+    }
+    #else
+    // update the contact impulses
+    for (unsigned i=0; i< NC; i++)
+      max_change = std::max(max_change, update_contact_block(q, i));
+
+    // update the limit impulses
+    for (unsigned i=0; i< NL; i++)
+      max_change = std::max(max_change, update_limit_block(q, i));
+    #endif
+
+    FILE_LOG(LOG_CONSTRAINT) << "  PGS sweep " << iter << " max impulse change: " << max_change << std::endl;
+
+    // see whether the iteration has converged
+    if (max_change < pgs_tolerance)
+      break;
+  }
+
+  return iter;
+}
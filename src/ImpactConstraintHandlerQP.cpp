@@ -22,6 +22,7 @@
 #include <Moby/ImpactToleranceException.h>
 #include <Moby/NumericalException.h>
 #include <Moby/LCPSolverException.h>
+#include <Moby/ContactProblemCapture.h>
 #include <Moby/ImpactConstraintHandler.h>
 
 using namespace Ravelin;
@@ -163,22 +164,24 @@ void ImpactConstraintHandler::solve_qp_work(UnilateralConstraintProblemData& epd
 
   // solve the LCP using Lemke's algorithm
   #if defined(USE_QLCPD) or defined(USE_QPOASES)
-  VectorNd lb(c.size()), ub(c.size());
-  lb.set_zero();
-  ub.set_one() *= 1e+29;
-  if (!_qp.qp_activeset(H, c, lb, ub, M, q, A, b, z))
+  _lb.set_zero(c.size());
+  _ub.set_one(c.size()) *= 1e+29;
+  if (!_qp.qp_activeset(H, c, _lb, _ub, M, q, A, b, z))
   {
     FILE_LOG(LOG_CONSTRAINT) << "QLCPD failed to solve; finding closest feasible point" << std::endl;
 
     #if defined(USE_QLCPD)
     // QP solver not successful by default; attempt to find the closest
     // feasible point
-    if (!_qp.find_closest_feasible(lb, ub, M, q, A, b, z))
+    if (!_qp.find_closest_feasible(_lb, _ub, M, q, A, b, z))
     {
       // QP solver failed completely; use Lemke's Algorithm as backup
       q.negate();
       if (!_lcp.lcp_lemke_regularized(_MM, _qq, z))
+      {
+        ContactProblemCapture::capture_failure(epd);
         throw LCPSolverException();
+      }
     }
     else
     {
@@ -193,12 +196,15 @@ void ImpactConstraintHandler::solve_qp_work(UnilateralConstraintProblemData& epd
       FILE_LOG(LOG_CONSTRAINT) << "            q'=" << q << std::endl;
 
       // now attempt to solve the QP again
-      if (!_qp.qp_activeset(H, c, lb, ub, M, q, A, b, z))
+      if (!_qp.qp_activeset(H, c, _lb, _ub, M, q, A, b, z))
       {
         // QP solver failed on second attempt; use Lemke's Algorithm as backup
         q.negate();
         if (!_lcp.lcp_lemke_regularized(_MM, _qq, z))
+        {
+          ContactProblemCapture::capture_failure(epd);
           throw LCPSolverException();
+        }
       }
     #endif
     #if defined (USE_QLCPD)
@@ -222,7 +228,10 @@ void ImpactConstraintHandler::solve_qp_work(UnilateralConstraintProblemData& epd
     z.set_zero();
 
     if (!_lcp.lcp_lemke_regularized(_MM, _qq, z))
+    {
+      ContactProblemCapture::capture_failure(epd);
       throw LCPSolverException();
+    }
   }
 
   // output reported LCP solution
@@ -453,6 +462,10 @@ void ImpactConstraintHandler::setup_QP(UnilateralConstraintProblemData& epd, Sha
   q.set_sub_vec(row_start, epd.L_v);
   row_start = row_end; row_end += epd.N_CONTACTS;
 
+  // cone-edge direction cosines depend only on the edge count, so tabulate
+  // them once per distinct count instead of calling cos/sin per contact
+  std::map<unsigned, std::vector<std::pair<double, double> > > cone_dirs;
+
   // setup the contact friction constraints
   // mu_c*cn + mu_v*cvel >= beta
   for (unsigned i=0; i< epd.N_CONTACTS; i++)
@@ -460,12 +473,25 @@ void ImpactConstraintHandler::setup_QP(UnilateralConstraintProblemData& epd, Sha
     // initialize the contact velocity
     double vel = std::sqrt(sqr(epd.Cs_v[i]) + sqr(epd.Ct_v[i]));
 
+    // tabulate the edge directions for this contact's cone, if necessary
+    const unsigned NEDGES = epd.contact_constraints[i]->contact_NK/2;
+    std::vector<std::pair<double, double> >& dirs = cone_dirs[NEDGES];
+    if (dirs.empty())
+    {
+      dirs.resize(NEDGES);
+      for (unsigned j=0; j< NEDGES; j++)
+      {
+        double theta = (double) j/(NEDGES-1) * M_PI_2;
+        dirs[j].first = std::cos(theta);
+        dirs[j].second = std::sin(theta);
+      }
+    }
+
     // setup the Coulomb friction inequality constraints for this contact
-    for (unsigned j=0; j< epd.contact_constraints[i]->contact_NK/2; j++)
+    for (unsigned j=0; j< NEDGES; j++)
     {
-      double theta = (double) j/(epd.contact_constraints[i]->contact_NK/2-1) * M_PI_2;
-      const double ct = std::cos(theta);
-      const double st = std::sin(theta);
+      const double ct = dirs[j].first;
+      const double st = dirs[j].second;
       M(row_start, CN_IDX+i) = epd.contact_constraints[i]->contact_mu_coulomb;
       M(row_start, CS_IDX+i) = -ct;
       M(row_start, NCS_IDX+i) = -ct;
@@ -4,11 +4,14 @@
  * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
  ****************************************************************************/
 
+#include <algorithm>
 #include <queue>
+#include <set>
 #include <iostream>
 #include <fstream>
 #include <Moby/Constants.h>
 #include <Moby/CompGeom.h>
+#include <Ravelin/MissizeException.h>
 #include <Moby/InvalidIndexException.h>
 #include <Moby/DegenerateTriangleException.h>
 #include <Moby/IndexedTriArray.h>
@@ -32,12 +35,15 @@ IndexedTriArray::IndexedTriArray(shared_ptr<const vector<Origin3d> > vertices, c
 {
   _vertices = vertices;
 
-  // setup facets 
+  // setup facets
   shared_ptr<vector<IndexedTri> > new_facets(new vector<IndexedTri>(facets));
   _facets = new_facets;
 
-  // validate indices within range 
-  validate();  
+  // validate indices within range
+  validate();
+
+  // reorder the facets for vertex cache and BVH leaf locality
+  optimize_facet_order();
 
   // calculate incident facets and determine coplanar features
   calc_incident_facets();
@@ -51,17 +57,280 @@ IndexedTriArray::IndexedTriArray(shared_ptr<const vector<Origin3d> > vertices, s
   _facets = facets;
 
   // validate indices within range
-  validate();  
+  validate();
+
+  // reorder the facets for vertex cache and BVH leaf locality
+  optimize_facet_order();
 
   // calculate incident facets and determine coplanar features
   calc_incident_facets();
   determine_coplanar_features();
 }
 
+// constants for the Forsyth vertex cache scoring in optimize_facet_order()
+static const unsigned VCACHE_SIZE = 32;
+static const double VCACHE_DECAY_POWER = 1.5;
+static const double VCACHE_LAST_TRI_SCORE = 0.75;
+static const double VCACHE_VALENCE_SCALE = 2.0;
+static const double VCACHE_VALENCE_POWER = 0.5;
+
+/// Computes the Forsyth score of a vertex for optimize_facet_order()
+/**
+ * \param cache_pos the position of the vertex in the simulated cache
+ *        (negative if not resident)
+ * \param active_facets the number of not-yet-emitted facets using the vertex
+ */
+static double calc_vertex_score(int cache_pos, unsigned active_facets)
+{
+  // vertices with no remaining facets never attract another facet
+  if (active_facets == 0)
+    return -1.0;
+
+  double score = 0.0;
+  if (cache_pos >= 0)
+  {
+    if (cache_pos < 3)
+      // the vertices of the last emitted facet get a fixed (lower) score so
+      // that the optimizer does not simply walk a single triangle fan
+      score = VCACHE_LAST_TRI_SCORE;
+    else
+      score = std::pow(1.0 - (double) (cache_pos - 3)/(VCACHE_SIZE - 3), VCACHE_DECAY_POWER);
+  }
+
+  // boost vertices with few remaining facets so that isolated triangles are
+  // emitted near their neighbors rather than stranded at the end
+  score += VCACHE_VALENCE_SCALE * std::pow((double) active_facets, -VCACHE_VALENCE_POWER);
+
+  return score;
+}
+
+/// Spreads the low 10 bits of x apart with two zero bits between each (for 30-bit Morton codes)
+static unsigned spread_bits10(unsigned x)
+{
+  x &= 0x3ff;
+  x = (x | (x << 16)) & 0x030000ff;
+  x = (x | (x << 8))  & 0x0300f00f;
+  x = (x | (x << 4))  & 0x030c30c3;
+  x = (x | (x << 2))  & 0x09249249;
+  return x;
+}
+
+/// Reorders the facet array for vertex cache hit rate and BVH leaf locality
+/**
+ * Applies two load-time permutations to the facet array: the facets are
+ * first sorted along a Morton space-filling curve over their quantized
+ * centroids, so that facets gathered into the same bounding-volume
+ * hierarchy leaf occupy a contiguous run of the array, and the result is
+ * then re-striped with Forsyth's linear-speed vertex cache optimization so
+ * that consecutive facets reuse recently touched vertices.  Only the facet
+ * order changes -- vertex indices and facet/vertex contents are untouched
+ * -- so every downstream query benefits from the improved locality without
+ * any algorithmic change.  Must be called before calc_incident_facets(),
+ * which records facet indices.
+ */
+void IndexedTriArray::optimize_facet_order()
+{
+  const unsigned THREE = 3;
+
+  // get the vertices and facets
+  const vector<Origin3d>& verts = get_vertices();
+  const vector<IndexedTri>& old_facets = get_facets();
+  const unsigned NF = old_facets.size();
+
+  // tiny meshes gain nothing from reordering
+  if (NF < THREE)
+    return;
+
+  // compute the facet centroids and their bounding box
+  vector<Origin3d> centroids(NF);
+  Origin3d lo = verts[old_facets.front().a], hi = lo;
+  for (unsigned i=0; i< NF; i++)
+  {
+    centroids[i] = (verts[old_facets[i].a] + verts[old_facets[i].b] + verts[old_facets[i].c]) * (1.0/3.0);
+    for (unsigned j=0; j< THREE; j++)
+    {
+      lo[j] = std::min(lo[j], centroids[i][j]);
+      hi[j] = std::max(hi[j], centroids[i][j]);
+    }
+  }
+
+  // sort the facets along a Morton curve over the quantized centroids; ties
+  // (and degenerate extents) fall back to the original facet order
+  Origin3d scale;
+  for (unsigned j=0; j< THREE; j++)
+    scale[j] = (hi[j] - lo[j] > NEAR_ZERO) ? 1023.0/(hi[j] - lo[j]) : 0.0;
+  vector<std::pair<unsigned, unsigned> > order(NF);
+  for (unsigned i=0; i< NF; i++)
+  {
+    unsigned q[THREE];
+    for (unsigned j=0; j< THREE; j++)
+      q[j] = (unsigned) std::max(0.0, std::min(1023.0, (centroids[i][j] - lo[j])*scale[j]));
+    order[i].first = spread_bits10(q[0]) | (spread_bits10(q[1]) << 1) | (spread_bits10(q[2]) << 2);
+    order[i].second = i;
+  }
+  std::sort(order.begin(), order.end());
+
+  // build the vertex -> facet adjacency and the per-vertex scores
+  vector<list<unsigned> > vfm = determine_vertex_facet_map();
+  vector<unsigned> valence(verts.size());
+  vector<int> cache_pos(verts.size(), -1);
+  vector<double> vscore(verts.size());
+  for (unsigned i=0; i< verts.size(); i++)
+  {
+    valence[i] = vfm[i].size();
+    vscore[i] = calc_vertex_score(-1, valence[i]);
+  }
+
+  // compute the initial per-facet scores
+  vector<bool> emitted(NF, false);
+  vector<double> fscore(NF);
+  for (unsigned i=0; i< NF; i++)
+    fscore[i] = vscore[old_facets[i].a] + vscore[old_facets[i].b] + vscore[old_facets[i].c];
+
+  // greedily emit the best-scoring facet touching the simulated cache,
+  // restarting from the spatially (Morton) next unemitted facet whenever the
+  // cache runs dry; the output is thus a sequence of cache-coherent runs
+  // that progress along the space-filling curve
+  vector<IndexedTri> new_facets;
+  new_facets.reserve(NF);
+  unsigned cache[VCACHE_SIZE + THREE];
+  unsigned cache_count = 0;
+  unsigned cursor = 0;
+  while (new_facets.size() < NF)
+  {
+    // find the best facet among those using cached vertices
+    int best = -1;
+    double best_score = 0.0;
+    for (unsigned i=0; i< cache_count; i++)
+      for (list<unsigned>::const_iterator j = vfm[cache[i]].begin(); j != vfm[cache[i]].end(); j++)
+        if (!emitted[*j] && (best < 0 || fscore[*j] > best_score))
+        {
+          best = (int) *j;
+          best_score = fscore[*j];
+        }
+
+    // no candidates in the cache: restart from the next facet in Morton order
+    if (best < 0)
+    {
+      while (emitted[order[cursor].second])
+        cursor++;
+      best = (int) order[cursor].second;
+    }
+
+    // emit the facet
+    emitted[best] = true;
+    new_facets.push_back(old_facets[best]);
+    const unsigned vtx[THREE] = { old_facets[best].a, old_facets[best].b, old_facets[best].c };
+
+    // move the emitted facet's vertices to the front of the LRU cache
+    unsigned new_cache[VCACHE_SIZE + THREE];
+    unsigned nc = 0;
+    for (unsigned i=0; i< THREE; i++)
+    {
+      valence[vtx[i]]--;
+      bool placed = false;
+      for (unsigned j=0; j< nc; j++)
+        if (new_cache[j] == vtx[i])
+          placed = true;
+      if (!placed)
+        new_cache[nc++] = vtx[i];
+    }
+    for (unsigned i=0; i< cache_count && nc < VCACHE_SIZE + THREE; i++)
+    {
+      bool placed = false;
+      for (unsigned j=0; j< THREE; j++)
+        if (cache[i] == vtx[j])
+          placed = true;
+      if (!placed)
+        new_cache[nc++] = cache[i];
+    }
+
+    // vertices shifted past the cache size are evicted
+    for (unsigned i=VCACHE_SIZE; i< nc; i++)
+    {
+      cache_pos[new_cache[i]] = -1;
+      vscore[new_cache[i]] = calc_vertex_score(-1, valence[new_cache[i]]);
+    }
+    cache_count = std::min(nc, VCACHE_SIZE);
+    for (unsigned i=0; i< cache_count; i++)
+    {
+      cache[i] = new_cache[i];
+      cache_pos[cache[i]] = (int) i;
+      vscore[cache[i]] = calc_vertex_score((int) i, valence[cache[i]]);
+    }
+
+    // rescore the unemitted facets touching the rescored vertices
+    for (unsigned i=0; i< nc; i++)
+      for (list<unsigned>::const_iterator j = vfm[new_cache[i]].begin(); j != vfm[new_cache[i]].end(); j++)
+        if (!emitted[*j])
+          fscore[*j] = vscore[old_facets[*j].a] + vscore[old_facets[*j].b] + vscore[old_facets[*j].c];
+  }
+
+  // install the re-striped facet array
+  shared_ptr<vector<IndexedTri> > facets_ptr(new vector<IndexedTri>());
+  facets_ptr->swap(new_facets);
+  _facets = facets_ptr;
+}
+
+/// Computes the per-triangle terms of the volume integrals for one facet
+static void calc_tri_volume_terms(const Origin3d& v0, const Origin3d& v1, const Origin3d& v2, double terms[10])
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  // get the cross-product of the edges
+  Vector3d cross = Vector3d::cross(Vector3d(v1 - v0, GLOBAL), Vector3d(v2 - v0, GLOBAL));
+
+  // compute integral terms
+  double tmp0, tmp1, tmp2;
+  double F1x, F2x, F3x, G0x, G1x, G2x;
+  tmp0 = v0[X] + v1[X];
+  F1x = tmp0 + v2[X];
+  tmp1 = v0[X]*v0[X];
+  tmp2 = tmp1 + v1[X]*tmp0;
+  F2x = tmp2 + v2[X]*F1x;
+  F3x = v0[X]*tmp1 + v1[X]*tmp2 + v2[X]*F2x;
+  G0x = F2x + v0[X]*(F1x + v0[X]);
+  G1x = F2x + v1[X]*(F1x + v1[X]);
+  G2x = F2x + v2[X]*(F1x + v2[X]);
+
+  double F1y, F2y, F3y, G0y, G1y, G2y;
+  tmp0 = v0[Y] + v1[Y];
+  F1y = tmp0 + v2[Y];
+  tmp1 = v0[Y]*v0[Y];
+  tmp2 = tmp1 + v1[Y]*tmp0;
+  F2y = tmp2 + v2[Y]*F1y;
+  F3y = v0[Y]*tmp1 + v1[Y]*tmp2 + v2[Y]*F2y;
+  G0y = F2y + v0[Y]*(F1y + v0[Y]);
+  G1y = F2y + v1[Y]*(F1y + v1[Y]);
+  G2y = F2y + v2[Y]*(F1y + v2[Y]);
+
+  double F1z, F2z, F3z, G0z, G1z, G2z;
+  tmp0 = v0[Z] + v1[Z];
+  F1z = tmp0 + v2[Z];
+  tmp1 = v0[Z]*v0[Z];
+  tmp2 = tmp1 + v1[Z]*tmp0;
+  F2z = tmp2 + v2[Z]*F1z;
+  F3z = v0[Z]*tmp1 + v1[Z]*tmp2 + v2[Z]*F2z;
+  G0z = F2z + v0[Z]*(F1z + v0[Z]);
+  G1z = F2z + v1[Z]*(F1z + v1[Z]);
+  G2z = F2z + v2[Z]*(F1z + v2[Z]);
+
+  // store the per-triangle terms
+  terms[0] = cross[X]*F1x;
+  terms[1] = cross[X]*F2x;
+  terms[2] = cross[Y]*F2y;
+  terms[3] = cross[Z]*F2z;
+  terms[4] = cross[X]*F3x;
+  terms[5] = cross[Y]*F3y;
+  terms[6] = cross[Z]*F3z;
+  terms[7] = cross[X]*(v0[Y]*G0x + v1[Y]*G1x + v2[Y]*G2x);
+  terms[8] = cross[Y]*(v0[Z]*G0y + v1[Z]*G1y + v2[Z]*G2y);
+  terms[9] = cross[Z]*(v0[X]*G0z + v1[X]*G1z + v2[X]*G2z);
+}
+
 /// Calculates the volume integrals of this primitive as a triangle mesh
 void IndexedTriArray::calc_volume_ints(double volume_ints[10]) const
 {
-  const unsigned X = 0, Y = 1, Z = 2;
   const double f_1_6th = 1.0/6.0;
   const double f_1_24th = 1.0/24.0;
   const double f_1_60th = 1.0/60.0;
@@ -73,64 +342,72 @@ void IndexedTriArray::calc_volume_ints(double volume_ints[10]) const
   const std::vector<Origin3d>& verts = get_vertices(); 
   const std::vector<IndexedTri>& facets = get_facets(); 
 
-  // process all triangles in the mesh
-  for (unsigned i = 0; i < facets.size(); i++)
-  {
-    // get the three vertices of the triangle
-    const Origin3d& v0 = verts[facets[i].a];
-    const Origin3d& v1 = verts[facets[i].b];
-    const Origin3d& v2 = verts[facets[i].c];
-
-    // get the cross-product of the edges
-    Vector3d cross = Vector3d::cross(Vector3d(v1 - v0, GLOBAL), Vector3d(v2 - v0, GLOBAL));
-
-    // compute integral terms
-    double tmp0, tmp1, tmp2;
-    double F1x, F2x, F3x, G0x, G1x, G2x;
-    tmp0 = v0[X] + v1[X];
-    F1x = tmp0 + v2[X];
-    tmp1 = v0[X]*v0[X];
-    tmp2 = tmp1 + v1[X]*tmp0;
-    F2x = tmp2 + v2[X]*F1x;
-    F3x = v0[X]*tmp1 + v1[X]*tmp2 + v2[X]*F2x;
-    G0x = F2x + v0[X]*(F1x + v0[X]);
-    G1x = F2x + v1[X]*(F1x + v1[X]);
-    G2x = F2x + v2[X]*(F1x + v2[X]);
-
-    double F1y, F2y, F3y, G0y, G1y, G2y;
-    tmp0 = v0[Y] + v1[Y];
-    F1y = tmp0 + v2[Y];
-    tmp1 = v0[Y]*v0[Y];
-    tmp2 = tmp1 + v1[Y]*tmp0;
-    F2y = tmp2 + v2[Y]*F1y;
-    F3y = v0[Y]*tmp1 + v1[Y]*tmp2 + v2[Y]*F2y;
-    G0y = F2y + v0[Y]*(F1y + v0[Y]);
-    G1y = F2y + v1[Y]*(F1y + v1[Y]);
-    G2y = F2y + v2[Y]*(F1y + v2[Y]);
-
-    double F1z, F2z, F3z, G0z, G1z, G2z;
-    tmp0 = v0[Z] + v1[Z];
-    F1z = tmp0 + v2[Z];
-    tmp1 = v0[Z]*v0[Z];
-    tmp2 = tmp1 + v1[Z]*tmp0;
-    F2z = tmp2 + v2[Z]*F1z;
-    F3z = v0[Z]*tmp1 + v1[Z]*tmp2 + v2[Z]*F2z;
-    G0z = F2z + v0[Z]*(F1z + v0[Z]);
-    G1z = F2z + v1[Z]*(F1z + v1[Z]);
-    G2z = F2z + v2[Z]*(F1z + v2[Z]);
-
-    // update integrals
-    volume_ints[0] += cross[X]*F1x;
-    volume_ints[1] += cross[X]*F2x;
-    volume_ints[2] += cross[Y]*F2y;
-    volume_ints[3] += cross[Z]*F2z;
-    volume_ints[4] += cross[X]*F3x;
-    volume_ints[5] += cross[Y]*F3y;
-    volume_ints[6] += cross[Z]*F3z;
-    volume_ints[7] += cross[X]*(v0[Y]*G0x + v1[Y]*G1x + v2[Y]*G2x);
-    volume_ints[8] += cross[Y]*(v0[Z]*G0y + v1[Z]*G1y + v2[Z]*G2y);
-    volume_ints[9] += cross[Z]*(v0[X]*G0z + v1[X]*G1z + v2[X]*G2z);
+  // process all triangles in the mesh; the per-triangle terms are
+  // independent, so the loop is reduced over threads for large meshes
+  double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0, s4 = 0.0;
+  double s5 = 0.0, s6 = 0.0, s7 = 0.0, s8 = 0.0, s9 = 0.0;
+  #if defined(_OPENMP) && defined(MOBY_DETERMINISTIC_PARALLEL)
+  // deterministic mode: partition the facets into a fixed number of chunks
+  // (independent of the thread count), accumulate each chunk's partial sums
+  // serially, and combine the partials in ascending chunk order; the
+  // floating-point summation order is then a function of the chunk count
+  // alone, so the result is bitwise identical for any OMP_NUM_THREADS
+  const unsigned NCHUNKS = 64;
+  const unsigned NFACETS = (unsigned) facets.size();
+  std::vector<double> partials(NCHUNKS*10, 0.0);
+  #pragma omp parallel for
+  for (int c = 0; c < (int) NCHUNKS; c++)
+  {
+    double* p = &partials[c*10];
+    unsigned start = (unsigned) (((unsigned long long) NFACETS * c)/NCHUNKS);
+    unsigned end = (unsigned) (((unsigned long long) NFACETS * (c+1))/NCHUNKS);
+    for (unsigned i = start; i < end; i++)
+    {
+      double terms[10];
+      calc_tri_volume_terms(verts[facets[i].a], verts[facets[i].b], verts[facets[i].c], terms);
+      for (unsigned j=0; j< 10; j++)
+        p[j] += terms[j];
+    }
+  }
+  for (unsigned c=0; c< NCHUNKS; c++)
+  {
+    const double* p = &partials[c*10];
+    s0 += p[0];  s1 += p[1];  s2 += p[2];  s3 += p[3];  s4 += p[4];
+    s5 += p[5];  s6 += p[6];  s7 += p[7];  s8 += p[8];  s9 += p[9];
   }
+  #else
+  #ifdef _OPENMP
+  #pragma omp parallel for reduction(+:s0,s1,s2,s3,s4,s5,s6,s7,s8,s9)
+  #endif
+  for (int i = 0; i < (int) facets.size(); i++)
+  {
+    // compute the per-triangle terms and update the integrals
+    double terms[10];
+    calc_tri_volume_terms(verts[facets[i].a], verts[facets[i].b], verts[facets[i].c], terms);
+    s0 += terms[0];
+    s1 += terms[1];
+    s2 += terms[2];
+    s3 += terms[3];
+    s4 += terms[4];
+    s5 += terms[5];
+    s6 += terms[6];
+    s7 += terms[7];
+    s8 += terms[8];
+    s9 += terms[9];
+  }
+  #endif
+
+  // fold the reduced sums into the output
+  volume_ints[0] += s0;
+  volume_ints[1] += s1;
+  volume_ints[2] += s2;
+  volume_ints[3] += s3;
+  volume_ints[4] += s4;
+  volume_ints[5] += s5;
+  volume_ints[6] += s6;
+  volume_ints[7] += s7;
+  volume_ints[8] += s8;
+  volume_ints[9] += s9;
 
   volume_ints[0] *= f_1_6th;
   volume_ints[1] *= f_1_24th;
@@ -317,6 +594,27 @@ IndexedTriArray IndexedTriArray::transform(const Transform3d& T) const
   return it;
 }
 
+/// Updates the vertex positions of this mesh in place
+/**
+ * Replaces the vertex array while reusing the facets and the incident facet
+ * map, both of which depend only on the (unchanged) topology; only the
+ * coplanar feature sets, which depend on the face planes, are redetermined.
+ * Use this method instead of reconstruction when vertices move but
+ * connectivity does not (e.g., for morphing geometry).
+ */
+void IndexedTriArray::update_vertices(shared_ptr<const vector<Origin3d> > vertices)
+{
+  // the topology is reused, so the vertex count must not change
+  if (!_vertices || vertices->size() != _vertices->size())
+    throw MissizeException();
+
+  // replace the vertex array
+  _vertices = vertices;
+
+  // redetermine the coplanar features
+  determine_coplanar_features();
+}
+
 /// Calculates facets incident to a vertex
 void IndexedTriArray::calc_incident_facets()
 {
@@ -379,6 +677,299 @@ IndexedTriArray IndexedTriArray::compress_vertices() const
   return IndexedTriArray(vertices.begin(), vertices.end(), facets.begin(), facets.end());
 }
 
+/// A symmetric 4x4 error quadric for quadric-error-metric decimation
+struct ErrorQuadric
+{
+  // the upper triangle of the symmetric matrix
+  double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+  ErrorQuadric() { a2 = ab = ac = ad = b2 = bc = bd = c2 = cd = d2 = 0.0; }
+
+  /// Accumulates the quadric of the plane a*x + b*y + c*z + d = 0, weighted by w
+  void add_plane(double a, double b, double c, double d, double w)
+  {
+    a2 += w*a*a; ab += w*a*b; ac += w*a*c; ad += w*a*d;
+    b2 += w*b*b; bc += w*b*c; bd += w*b*d;
+    c2 += w*c*c; cd += w*c*d;
+    d2 += w*d*d;
+  }
+
+  ErrorQuadric& operator+=(const ErrorQuadric& q)
+  {
+    a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+    b2 += q.b2; bc += q.bc; bd += q.bd;
+    c2 += q.c2; cd += q.cd;
+    d2 += q.d2;
+    return *this;
+  }
+
+  /// Evaluates v'*Q*v for the homogeneous point (v, 1)
+  double eval(const Origin3d& v) const
+  {
+    return a2*v[0]*v[0] + b2*v[1]*v[1] + c2*v[2]*v[2] +
+           2.0*(ab*v[0]*v[1] + ac*v[0]*v[2] + bc*v[1]*v[2]) +
+           2.0*(ad*v[0] + bd*v[1] + cd*v[2]) + d2;
+  }
+
+  /// Solves for the point minimizing the quadric; returns false if the system is (near) singular
+  bool minimum(Origin3d& v) const
+  {
+    // the gradient system is [a2 ab ac; ab b2 bc; ac bc c2] v = -(ad, bd, cd)
+    const double R0 = -ad, R1 = -bd, R2 = -cd;
+    const double DET = a2*(b2*c2 - bc*bc) - ab*(ab*c2 - bc*ac) +
+                       ac*(ab*bc - b2*ac);
+    if (std::fabs(DET) < NEAR_ZERO)
+      return false;
+
+    // solve by Cramer's rule
+    const double IDET = 1.0/DET;
+    v[0] = IDET*(R0*(b2*c2 - bc*bc) - ab*(R1*c2 - bc*R2) + ac*(R1*bc - b2*R2));
+    v[1] = IDET*(a2*(R1*c2 - bc*R2) - R0*(ab*c2 - bc*ac) + ac*(ab*R2 - R1*ac));
+    v[2] = IDET*(a2*(b2*R2 - R1*bc) - ab*(ab*R2 - R1*ac) + R0*(ab*bc - b2*ac));
+    return true;
+  }
+};
+
+/// An edge contraction candidate for quadric-error-metric decimation
+struct ContractionCandidate
+{
+  double cost;          // quadric error of contracting to the target point
+  unsigned v1, v2;      // the edge; v2 is merged into v1
+  unsigned stamp1, stamp2; // vertex modification stamps at creation time
+  Origin3d target;      // position for the merged vertex
+
+  // orders the priority queue by minimum cost
+  bool operator<(const ContractionCandidate& c) const { return cost > c.cost; }
+};
+
+/// Builds the contraction candidate for an edge from the endpoint quadrics
+static ContractionCandidate calc_contraction(unsigned v1, unsigned v2, const vector<ErrorQuadric>& Q, const vector<Origin3d>& verts, const vector<unsigned>& stamps)
+{
+  // sum the endpoint quadrics
+  ErrorQuadric q = Q[v1];
+  q += Q[v2];
+
+  // find the optimum point; if the quadric is singular, pick the best of the
+  // endpoints and the midpoint
+  ContractionCandidate c;
+  if (!q.minimum(c.target))
+  {
+    Origin3d mid = (verts[v1] + verts[v2]) * 0.5;
+    c.target = verts[v1];
+    double best = q.eval(verts[v1]);
+    if (q.eval(verts[v2]) < best)
+    {
+      c.target = verts[v2];
+      best = q.eval(verts[v2]);
+    }
+    if (q.eval(mid) < best)
+      c.target = mid;
+  }
+  c.cost = q.eval(c.target);
+  c.v1 = v1;
+  c.v2 = v2;
+  c.stamp1 = stamps[v1];
+  c.stamp2 = stamps[v2];
+  return c;
+}
+
+/// Determines whether moving vertex v to 'target' flips any face incident to v
+/**
+ * Faces slated to collapse (those containing both contracted vertices) are
+ * passed in 'dying' and are not tested.
+ */
+static bool contraction_flips(unsigned v, const Origin3d& target, const std::set<unsigned>& incident, const std::set<unsigned>& dying, const vector<IndexedTri>& faces, const vector<Origin3d>& verts)
+{
+  for (std::set<unsigned>::const_iterator i = incident.begin(); i != incident.end(); i++)
+  {
+    if (dying.find(*i) != dying.end())
+      continue;
+
+    // get the face vertices with v listed first
+    const IndexedTri& f = faces[*i];
+    unsigned j = f.b, k = f.c;
+    if (v == f.b) { j = f.c; k = f.a; }
+    else if (v == f.c) { j = f.a; k = f.b; }
+
+    // compare the face normal before and after the move
+    Origin3d n_before = Origin3d::cross(verts[j] - verts[v], verts[k] - verts[v]);
+    Origin3d n_after = Origin3d::cross(verts[j] - target, verts[k] - target);
+    if (n_before.dot(n_after) <= 0.0)
+      return true;
+  }
+
+  return false;
+}
+
+/// Decimates the mesh to (approximately) the given number of triangles
+/**
+ * Uses the quadric-error-metric edge contraction algorithm of Garland and
+ * Heckbert.  Boundary edges receive a heavy perpendicular constraint plane
+ * and contractions that would flip a face normal are rejected, so open
+ * borders and silhouettes are preserved.  Intended for baking dense
+ * artist meshes down to low-triangle-count collision proxies.
+ * \param target_tris the desired number of triangles in the output mesh
+ * \return the decimated mesh (the original mesh if already at or below the
+ *         target count)
+ */
+IndexedTriArray IndexedTriArray::decimate(unsigned target_tris) const
+{
+  const double BOUNDARY_WEIGHT = 1000.0;
+
+  // if the mesh is already small enough, just return it
+  if (num_tris() <= target_tris)
+    return *this;
+
+  // get mutable copies of the vertices and facets
+  vector<Origin3d> verts = get_vertices();
+  vector<IndexedTri> faces = get_facets();
+
+  // accumulate the area-weighted plane quadric of every facet into its
+  // three vertex quadrics
+  vector<ErrorQuadric> Q(verts.size());
+  for (unsigned i=0; i< faces.size(); i++)
+  {
+    Origin3d n = Origin3d::cross(verts[faces[i].b] - verts[faces[i].a], verts[faces[i].c] - verts[faces[i].a]);
+    double nrm = n.norm();
+    if (nrm < NEAR_ZERO)
+      continue;
+    double area = nrm * 0.5;
+    n /= nrm;
+    double d = -n.dot(verts[faces[i].a]);
+    Q[faces[i].a].add_plane(n[0], n[1], n[2], d, area);
+    Q[faces[i].b].add_plane(n[0], n[1], n[2], d, area);
+    Q[faces[i].c].add_plane(n[0], n[1], n[2], d, area);
+  }
+
+  // find boundary edges (edges with a single incident facet) and add a
+  // heavy constraint plane through the edge, perpendicular to the facet,
+  // so that open borders are preserved
+  map<sorted_pair<unsigned>, list<unsigned> > efm = determine_edge_facet_map();
+  for (map<sorted_pair<unsigned>, list<unsigned> >::const_iterator i = efm.begin(); i != efm.end(); i++)
+  {
+    if (i->second.size() != 1)
+      continue;
+
+    // get the edge direction and the facet normal
+    unsigned va = i->first.first, vb = i->first.second;
+    const IndexedTri& f = faces[i->second.front()];
+    Origin3d edir = verts[vb] - verts[va];
+    Origin3d fn = Origin3d::cross(verts[f.b] - verts[f.a], verts[f.c] - verts[f.a]);
+    Origin3d n = Origin3d::cross(edir, fn);
+    double nrm = n.norm();
+    if (nrm < NEAR_ZERO)
+      continue;
+    n /= nrm;
+    double d = -n.dot(verts[va]);
+    double w = BOUNDARY_WEIGHT * edir.norm_sq();
+    Q[va].add_plane(n[0], n[1], n[2], d, w);
+    Q[vb].add_plane(n[0], n[1], n[2], d, w);
+  }
+
+  // build vertex/vertex and vertex/facet adjacency
+  vector<std::set<unsigned> > vneighbors(verts.size());
+  vector<std::set<unsigned> > vfacets(verts.size());
+  for (unsigned i=0; i< faces.size(); i++)
+  {
+    vneighbors[faces[i].a].insert(faces[i].b); vneighbors[faces[i].a].insert(faces[i].c);
+    vneighbors[faces[i].b].insert(faces[i].a); vneighbors[faces[i].b].insert(faces[i].c);
+    vneighbors[faces[i].c].insert(faces[i].a); vneighbors[faces[i].c].insert(faces[i].b);
+    vfacets[faces[i].a].insert(i);
+    vfacets[faces[i].b].insert(i);
+    vfacets[faces[i].c].insert(i);
+  }
+
+  // seed the priority queue with every edge
+  vector<unsigned> stamps(verts.size(), 0);
+  vector<bool> vertex_alive(verts.size(), true);
+  vector<bool> face_alive(faces.size(), true);
+  std::priority_queue<ContractionCandidate> heap;
+  for (unsigned i=0; i< verts.size(); i++)
+    for (std::set<unsigned>::const_iterator j = vneighbors[i].begin(); j != vneighbors[i].end(); j++)
+      if (i < *j)
+        heap.push(calc_contraction(i, *j, Q, verts, stamps));
+
+  // contract minimum-cost edges until the target triangle count is reached
+  unsigned nfaces = faces.size();
+  while (nfaces > target_tris && !heap.empty())
+  {
+    // get the cheapest candidate, skipping stale ones
+    ContractionCandidate c = heap.top();
+    heap.pop();
+    if (!vertex_alive[c.v1] || !vertex_alive[c.v2])
+      continue;
+    if (c.stamp1 != stamps[c.v1] || c.stamp2 != stamps[c.v2])
+      continue;
+    if (vneighbors[c.v1].find(c.v2) == vneighbors[c.v1].end())
+      continue;
+
+    // determine the facets that the contraction collapses
+    std::set<unsigned> dying;
+    for (std::set<unsigned>::const_iterator i = vfacets[c.v1].begin(); i != vfacets[c.v1].end(); i++)
+      if (vfacets[c.v2].find(*i) != vfacets[c.v2].end())
+        dying.insert(*i);
+
+    // reject contractions that would fold the surface over itself
+    if (contraction_flips(c.v1, c.target, vfacets[c.v1], dying, faces, verts) ||
+        contraction_flips(c.v2, c.target, vfacets[c.v2], dying, faces, verts))
+      continue;
+
+    // contract: move v1 to the target and absorb v2's quadric
+    verts[c.v1] = c.target;
+    Q[c.v1] += Q[c.v2];
+    vertex_alive[c.v2] = false;
+    stamps[c.v1]++;
+    stamps[c.v2]++;
+
+    // kill the collapsed facets
+    for (std::set<unsigned>::const_iterator i = dying.begin(); i != dying.end(); i++)
+    {
+      face_alive[*i] = false;
+      vfacets[faces[*i].a].erase(*i);
+      vfacets[faces[*i].b].erase(*i);
+      vfacets[faces[*i].c].erase(*i);
+      nfaces--;
+    }
+
+    // re-point v2's surviving facets at v1
+    for (std::set<unsigned>::const_iterator i = vfacets[c.v2].begin(); i != vfacets[c.v2].end(); i++)
+    {
+      IndexedTri& f = faces[*i];
+      if (f.a == c.v2) f.a = c.v1;
+      if (f.b == c.v2) f.b = c.v1;
+      if (f.c == c.v2) f.c = c.v1;
+      vfacets[c.v1].insert(*i);
+    }
+    vfacets[c.v2].clear();
+
+    // splice v2's neighbors into v1's adjacency
+    vneighbors[c.v1].erase(c.v2);
+    for (std::set<unsigned>::const_iterator i = vneighbors[c.v2].begin(); i != vneighbors[c.v2].end(); i++)
+    {
+      vneighbors[*i].erase(c.v2);
+      if (*i != c.v1)
+      {
+        vneighbors[*i].insert(c.v1);
+        vneighbors[c.v1].insert(*i);
+      }
+    }
+    vneighbors[c.v2].clear();
+
+    // queue fresh candidates for every edge incident to the merged vertex
+    for (std::set<unsigned>::const_iterator i = vneighbors[c.v1].begin(); i != vneighbors[c.v1].end(); i++)
+      heap.push(calc_contraction(c.v1, *i, Q, verts, stamps));
+  }
+
+  // gather the surviving facets
+  vector<IndexedTri> new_faces;
+  for (unsigned i=0; i< faces.size(); i++)
+    if (face_alive[i])
+      new_faces.push_back(faces[i]);
+
+  // build the result and drop orphaned vertices
+  return IndexedTriArray(verts.begin(), verts.end(), new_faces.begin(), new_faces.end()).compress_vertices();
+}
+
 /// Writes triangle mesh to a Wavefront OBJ file
 void IndexedTriArray::write_to_obj(const IndexedTriArray& mesh, const string& filename)
 {
@@ -409,6 +1000,102 @@ void IndexedTriArray::write_to_obj(const IndexedTriArray& mesh, const string& fi
   out.close();
 }
 
+/// Writes triangle mesh to a compiled binary mesh (.cmsh) file
+/**
+ * The format is a fixed header (magic number, version, vertex and facet
+ * counts) followed by the raw vertex coordinate and facet index arrays, so
+ * that loading is bounded by I/O rather than by text parsing.
+ */
+void IndexedTriArray::write_to_binary(const IndexedTriArray& mesh, const string& filename)
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+  const unsigned CMSH_MAGIC = 0x48534d43;  // 'CMSH', little endian
+  const unsigned CMSH_VERSION = 1;
+
+  // get vertices and facets
+  const vector<Origin3d>& vertices = mesh.get_vertices();
+  const vector<IndexedTri>& facets = mesh.get_facets();
+
+  // flatten the vertex coordinates and facet indices
+  vector<double> coords(vertices.size()*3);
+  for (unsigned i=0; i< vertices.size(); i++)
+  {
+    coords[i*3+0] = vertices[i][X];
+    coords[i*3+1] = vertices[i][Y];
+    coords[i*3+2] = vertices[i][Z];
+  }
+  vector<unsigned> indices(facets.size()*3);
+  for (unsigned i=0; i< facets.size(); i++)
+  {
+    indices[i*3+0] = facets[i].a;
+    indices[i*3+1] = facets[i].b;
+    indices[i*3+2] = facets[i].c;
+  }
+
+  // open the file for writing
+  std::ofstream out(filename.c_str(), std::ios::binary);
+
+  // write the header followed by the raw arrays
+  unsigned header[4] = { CMSH_MAGIC, CMSH_VERSION, (unsigned) vertices.size(), (unsigned) facets.size() };
+  out.write((const char*) header, sizeof(header));
+  if (!coords.empty())
+    out.write((const char*) &coords.front(), coords.size()*sizeof(double));
+  if (!indices.empty())
+    out.write((const char*) &indices.front(), indices.size()*sizeof(unsigned));
+
+  // close the file
+  out.close();
+}
+
+/// Reads triangle mesh from a compiled binary mesh (.cmsh) file
+/**
+ * \throws std::runtime_error if the file cannot be opened or is malformed
+ */
+IndexedTriArray IndexedTriArray::read_from_binary(const string& filename)
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+  const unsigned CMSH_MAGIC = 0x48534d43;  // 'CMSH', little endian
+  const unsigned CMSH_VERSION = 1;
+
+  // open the file
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  if (in.fail())
+    throw std::runtime_error(std::string("IndexedTriArray::read_from_binary() - unable to open ") + filename);
+
+  // read and verify the header
+  unsigned header[4];
+  in.read((char*) header, sizeof(header));
+  if (!in || header[0] != CMSH_MAGIC || header[1] != CMSH_VERSION)
+    throw std::runtime_error(std::string("IndexedTriArray::read_from_binary() - bad magic or version in ") + filename);
+  const unsigned NV = header[2];
+  const unsigned NF = header[3];
+
+  // read the raw arrays in two reads
+  vector<double> coords(NV*3);
+  vector<unsigned> indices(NF*3);
+  if (!coords.empty())
+    in.read((char*) &coords.front(), coords.size()*sizeof(double));
+  if (!indices.empty())
+    in.read((char*) &indices.front(), indices.size()*sizeof(unsigned));
+  if (!in)
+    throw std::runtime_error(std::string("IndexedTriArray::read_from_binary() - truncated file ") + filename);
+
+  // build the vertex and facet arrays
+  vector<Origin3d> vertices(NV);
+  for (unsigned i=0; i< NV; i++)
+    vertices[i] = Origin3d(coords[i*3+X], coords[i*3+Y], coords[i*3+Z]);
+  vector<IndexedTri> facets(NF);
+  for (unsigned i=0; i< NF; i++)
+  {
+    facets[i].a = indices[i*3+0];
+    facets[i].b = indices[i*3+1];
+    facets[i].c = indices[i*3+2];
+  }
+
+  // create the new mesh
+  return IndexedTriArray(vertices.begin(), vertices.end(), facets.begin(), facets.end());
+}
+
 /// Reads triangle mesh from a Wavefront OBJ file
 IndexedTriArray IndexedTriArray::read_from_obj(const string& filename)
 {
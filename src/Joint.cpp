@@ -4,6 +4,7 @@
  * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
  ****************************************************************************/
 
+#include <algorithm>
 #include <iostream>
 #include <limits>
 #include <queue>
@@ -32,6 +33,9 @@ Joint::Joint() : Jointd()
   // initialize restitution coefficient
   limit_restitution = (double) 0.0;
 
+  // no constraint data has been prepared yet
+  _C_cache_valid = _Cq_cache_valid = false;
+
   // mark the indices as invalid initially
   _coord_idx = _joint_idx = _constraint_idx = std::numeric_limits<unsigned>::max();
 
@@ -53,6 +57,9 @@ Joint::Joint(boost::weak_ptr<RigidBody> inboard, boost::weak_ptr<RigidBody> outb
   // initialize restitution coefficient
   limit_restitution = (double) 0.0;
 
+  // no constraint data has been prepared yet
+  _C_cache_valid = _Cq_cache_valid = false;
+
   // set the inboard and outboard links
   _inboard_link = RigidBodyPtr(inboard);
   _outboard_link = RigidBodyPtr(outboard);
@@ -70,6 +77,58 @@ Joint::Joint(boost::weak_ptr<RigidBody> inboard, boost::weak_ptr<RigidBody> outb
   _vF->rpose = _F;
 }  
 
+/// Computes and caches all pose-dependent constraint quantities for this step
+/**
+ * evaluate_constraints() and calc_constraint_jacobian() recompute rotation
+ * matrices and trigonometric terms on every call, and are invoked several
+ * times per joint per step across forward dynamics, impact handling and
+ * constraint stabilization.  This computes them once at the current
+ * configuration so the _prepared accessors reduce to cached loads until
+ * invalidate_step_data() is called.  Calling this eagerly is optional: the
+ * _prepared accessors each prepare their own quantities on first use.
+ */
+void Joint::prepare_step()
+{
+  evaluate_constraints(_C_cache);
+  _C_cache_valid = true;
+  calc_constraint_jacobian(true, _Cq_in_cache);
+  calc_constraint_jacobian(false, _Cq_out_cache);
+  _Cq_cache_valid = true;
+}
+
+/// Marks the cached constraint data stale
+/**
+ * Must be called whenever the configuration of the inboard or outboard link
+ * changes (integration, rollback, stabilization updates, etc.)
+ */
+void Joint::invalidate_step_data()
+{
+  _C_cache_valid = _Cq_cache_valid = false;
+}
+
+/// Evaluates this joint's constraint equations through the per-step cache
+void Joint::evaluate_constraints_prepared(double C[])
+{
+  if (!_C_cache_valid)
+  {
+    evaluate_constraints(_C_cache);
+    _C_cache_valid = true;
+  }
+  std::copy(_C_cache, _C_cache+num_constraint_eqns(), C);
+}
+
+/// Computes this joint's constraint Jacobian through the per-step cache
+void Joint::calc_constraint_jacobian_prepared(bool inboard, MatrixNd& Cq)
+{
+  if (!_Cq_cache_valid)
+  {
+    calc_constraint_jacobian(true, _Cq_in_cache);
+    calc_constraint_jacobian(false, _Cq_out_cache);
+    _Cq_cache_valid = true;
+  }
+  Cq = (inboard) ? _Cq_in_cache : _Cq_out_cache;
+}
+
 /// (Relatively slow) method for determining the joint velocity from current link velocities
 void Joint::determine_q_dot()
 {
@@ -6,10 +6,12 @@
 
 #include <numeric>
 #include <cstring>
+#include <cstdlib>
 #include <cmath>
 #include <cfloat>
 #include <sstream>
 #include <fstream>
+#include <iomanip>
 #include <boost/algorithm/minmax.hpp>
 #include <boost/algorithm/minmax_element.hpp>
 #include <boost/foreach.hpp>
@@ -35,6 +37,211 @@ using boost::shared_ptr;
 // Sole constructor
 LCP::LCP()
 {
+  estimate_conditioning = false;
+  use_mixed_precision = false;
+  mixed_precision_min_size = 200;
+  _nested = false;
+}
+
+/// Applies the single-precision LU factors in _f_A/_f_piv to a right-hand side
+void LCP::substitute_float(unsigned n, std::vector<float>& x) const
+{
+  // forward substitution with the unit lower-triangular factor, applying
+  // the row interchanges as we go
+  for (unsigned k=0; k< n; k++)
+  {
+    std::swap(x[k], x[_f_piv[k]]);
+    const float xk = x[k];
+    if (xk != 0.0f)
+      for (unsigned i=k+1; i< n; i++)
+        x[i] -= _f_A[i*n+k] * xk;
+  }
+
+  // back substitution with the upper-triangular factor
+  for (unsigned k=n; k-- > 0; )
+  {
+    for (unsigned j=k+1; j< n; j++)
+      x[k] -= _f_A[k*n+j] * x[j];
+    x[k] /= _f_A[k*n+k];
+  }
+}
+
+/// Attempts to solve A*x = b in mixed precision (x contains b on input)
+/**
+ * Factors the basis matrix in single precision -- halving the memory
+ * bandwidth of the factorization that dominates lcp_lemke on large
+ * problems -- and recovers double accuracy by iterative refinement with
+ * double-precision residuals. Returns false, leaving x unspecified, when
+ * the problem is too small to benefit, when a pivot shows the basis is too
+ * poorly conditioned for single precision, or when refinement stalls;
+ * callers then fall back to the standard double-precision solve.
+ */
+bool LCP::solve_basis_mixed(const MatrixNd& A, VectorNd& x)
+{
+  const unsigned MAX_REFINEMENTS = 5;
+  const unsigned n = A.rows();
+
+  // small systems are dominated by factorization setup, not bandwidth
+  if (n < mixed_precision_min_size)
+    return false;
+
+  // copy the basis to single precision (row-major)
+  _f_A.resize(n*n);
+  float max_elm = 0.0f;
+  for (unsigned i=0; i< n; i++)
+    for (unsigned j=0; j< n; j++)
+    {
+      const float value = (float) A(i,j);
+      _f_A[i*n+j] = value;
+      max_elm = std::max(max_elm, std::fabs(value));
+    }
+
+  // conditioning trigger: any pivot this small makes the single-precision
+  // factors untrustworthy
+  const float MIN_PIV = max_elm * FLT_EPSILON * n;
+
+  // factor PA = LU in single precision with partial pivoting
+  _f_piv.resize(n);
+  for (unsigned k=0; k< n; k++)
+  {
+    // find the pivot row
+    unsigned p = k;
+    for (unsigned i=k+1; i< n; i++)
+      if (std::fabs(_f_A[i*n+k]) > std::fabs(_f_A[p*n+k]))
+        p = i;
+    if (std::fabs(_f_A[p*n+k]) <= MIN_PIV)
+      return false;
+
+    // swap the pivot row into place
+    _f_piv[k] = p;
+    if (p != k)
+      for (unsigned j=0; j< n; j++)
+        std::swap(_f_A[k*n+j], _f_A[p*n+j]);
+
+    // eliminate below the pivot, storing the multipliers
+    const float pivot = _f_A[k*n+k];
+    for (unsigned i=k+1; i< n; i++)
+    {
+      const float m = _f_A[i*n+k] / pivot;
+      _f_A[i*n+k] = m;
+      if (m != 0.0f)
+        for (unsigned j=k+1; j< n; j++)
+          _f_A[i*n+j] -= m * _f_A[k*n+j];
+    }
+  }
+
+  // save b; the solution accumulates in double precision
+  _mp_b = x;
+  x.set_zero(n);
+  _mp_r = _mp_b;
+  const double A_NORM = A.norm_inf();
+  const double B_NORM = _mp_b.norm_inf();
+  double last_rnorm = std::numeric_limits<double>::max();
+
+  // refine: solve for the correction in single precision, accumulate it
+  // and recompute the residual in double precision
+  _f_x.resize(n);
+  for (unsigned iter=0; iter<= MAX_REFINEMENTS; iter++)
+  {
+    // solve A*dx = r using the single-precision factors
+    for (unsigned i=0; i< n; i++)
+      _f_x[i] = (float) _mp_r[i];
+    substitute_float(n, _f_x);
+
+    // accumulate the correction
+    for (unsigned i=0; i< n; i++)
+      x[i] += (double) _f_x[i];
+
+    // compute the double-precision residual r = b - A*x
+    A.mult(x, _mp_t);
+    _mp_r = _mp_b;
+    _mp_r -= _mp_t;
+    const double rnorm = _mp_r.norm_inf();
+
+    // converged when the residual is at the double-precision noise floor
+    if (rnorm <= (A_NORM * x.norm_inf() + B_NORM) * std::numeric_limits<double>::epsilon() * n)
+      return true;
+
+    // refinement must make progress, or the basis is too ill-conditioned
+    // for the single-precision factors to correct
+    if (rnorm >= last_rnorm * 0.5)
+    {
+      x = _mp_b;
+      return false;
+    }
+    last_rnorm = rnorm;
+  }
+
+  // out of refinement iterations without hitting the noise floor; restore
+  // the right-hand side so the caller can retry in double precision
+  x = _mp_b;
+  return false;
+}
+
+/// Marks a solver as driven from a regularized wrapper for the duration of a scope
+/**
+ * The regularized solvers call the unregularized solvers internally; this
+ * guard keeps those inner solves from recording statistics (the wrapper
+ * records the composite solve itself).
+ */
+namespace {
+struct NestedSolveGuard
+{
+  NestedSolveGuard(bool& flag) : _flag(flag) { _flag = true; }
+  ~NestedSolveGuard() { _flag = false; }
+  bool& _flag;
+};
+} // end anonymous namespace
+
+/// Records telemetry for one completed solve of a dense LCP
+void LCP::record_solve(const MatrixNd& M, const VectorNd& q, const VectorNd& z, bool solved, double lambda)
+{
+  // compute the l-inf complementarity residual, if there is a solution
+  double residual = -1.0;
+  if (solved && q.size() > 0)
+  {
+    M.mult(z, _rw) += q;
+    residual = 0.0;
+    for (unsigned i=0; i< q.size(); i++)
+    {
+      residual = std::max(residual, -z[i]);
+      residual = std::max(residual, -_rw[i]);
+      residual = std::max(residual, std::fabs(z[i]*_rw[i]));
+    }
+  }
+
+  // estimate the condition number of M via its singular values, if desired
+  double cond = -1.0;
+  if (estimate_conditioning && q.size() > 0)
+  {
+    _rM = M;
+    _LA.svd(_rM, _rU, _rS, _rV);
+    const double SMALLEST = _rS[_rS.size()-1];
+    cond = (SMALLEST > 0.0) ? _rS[0]/SMALLEST : std::numeric_limits<double>::max();
+  }
+
+  stats.record(pivots, lambda, residual, cond, solved);
+}
+
+/// Records telemetry for one completed solve of a sparse LCP
+void LCP::record_solve(const SparseMatrixNd& M, const VectorNd& q, const VectorNd& z, bool solved, double lambda)
+{
+  // compute the l-inf complementarity residual, if there is a solution;
+  // no condition estimate is computed for sparse problems
+  double residual = -1.0;
+  if (solved && q.size() > 0)
+  {
+    M.mult(z, _rw) += q;
+    residual = 0.0;
+    for (unsigned i=0; i< q.size(); i++)
+    {
+      residual = std::max(residual, -z[i]);
+      residual = std::max(residual, -_rw[i]);
+      residual = std::max(residual, std::fabs(z[i]*_rw[i]));
+    }
+  }
+
+  stats.record(pivots, lambda, residual, -1.0, solved);
 }
 
 /// Fast pivoting algorithm for denerate, monotone LCPs with few nonzero, nonbasic variables 
@@ -91,6 +298,7 @@ bool LCP::lcp_fast(const MatrixNd& M, const VectorNd& q, VectorNd& z, double zer
     {
       FILE_LOG(LOG_OPT) << "LCP::lcp_fast() - trivial solution found" << std::endl;
       z.set_zero(N);
+      if (!_nested) record_solve(M, q, z, true, 0.0);
       return true;
     }
 
@@ -122,6 +330,7 @@ bool LCP::lcp_fast(const MatrixNd& M, const VectorNd& q, VectorNd& z, double zer
     catch (SingularException e)
     {
       FILE_LOG(LOG_OPT) << "LCP::lcp_fast() - linear system solve failed" << std::endl;
+      if (!_nested) record_solve(M, q, z, false, 0.0);
       return false;
     }
 
@@ -158,6 +367,7 @@ bool LCP::lcp_fast(const MatrixNd& M, const VectorNd& q, VectorNd& z, double zer
           z[_nonbas[j]] = _z[i];
 
         FILE_LOG(LOG_OPT) << "LCP::lcp_fast() - solution found!" << std::endl;
+        if (!_nested) record_solve(M, q, z, true, 0.0);
         return true;
       }
     }
@@ -192,6 +402,7 @@ bool LCP::lcp_fast(const MatrixNd& M, const VectorNd& q, VectorNd& z, double zer
   FILE_LOG(LOG_OPT) << "LCP::lcp_fast() - maximum allowable pivots exceeded" << std::endl;
 
   // if we're here, then the maximum number of pivots has been exceeded
+  if (!_nested) record_solve(M, q, z, false, 0.0);
   return false;
 }
 
@@ -221,6 +432,10 @@ bool LCP::lcp_fast_regularized(const MatrixNd& M, const VectorNd& q, VectorNd& z
     return true;
   }
 
+  // keep the inner solves from recording statistics; this wrapper records
+  // the composite solve itself
+  NestedSolveGuard guard(_nested);
+
   // copy MM
   _MM = M;
 
@@ -252,6 +467,7 @@ bool LCP::lcp_fast_regularized(const MatrixNd& M, const VectorNd& q, VectorNd& z
           FILE_LOG(LOG_OPT) << "  pivots / total pivots: " << pivots << " " << pivots << endl;
           FILE_LOG(LOG_OPT) << "LCP::lcp_fast_regularized() exited" << endl;
 
+          record_solve(M, q, z, true, 0.0);
           return true;
         }
         else
@@ -315,6 +531,7 @@ bool LCP::lcp_fast_regularized(const MatrixNd& M, const VectorNd& q, VectorNd& z
             FILE_LOG(LOG_OPT) << "  pivots / total pivots: " << pivots << " " << total_piv << endl;
             FILE_LOG(LOG_OPT) << "LCP::lcp_fast_regularized() exited" << endl;
             pivots = total_piv;
+            record_solve(M, q, z, true, lambda);
             return true;
           }
           else
@@ -346,6 +563,7 @@ bool LCP::lcp_fast_regularized(const MatrixNd& M, const VectorNd& q, VectorNd& z
   pivots = total_piv;
 
   // still here?  failure...
+  record_solve(M, q, z, false, std::pow((double) 10.0, (double) max_exp));
   return false;
 }
 
@@ -362,6 +580,10 @@ bool LCP::lcp_lemke_regularized(const MatrixNd& M, const VectorNd& q, VectorNd&
     return true;
   }
 
+  // keep the inner solves from recording statistics; this wrapper records
+  // the composite solve itself
+  NestedSolveGuard guard(_nested);
+
   // copy MM
   _MM = M;
 
@@ -392,6 +614,7 @@ bool LCP::lcp_lemke_regularized(const MatrixNd& M, const VectorNd& q, VectorNd&
           FILE_LOG(LOG_OPT) << "  solved with no regularization necessary!" << endl;
           FILE_LOG(LOG_OPT) << "LCP::lcp_lemke_regularized() exited" << endl;
 
+          record_solve(M, q, z, true, 0.0);
           return true;
         }
         else
@@ -452,11 +675,12 @@ bool LCP::lcp_lemke_regularized(const MatrixNd& M, const VectorNd& q, VectorNd&
             FILE_LOG(LOG_OPT) << "  solved with regularization factor: " << lambda << endl;
             FILE_LOG(LOG_OPT) << "LCP::lcp_lemke_regularized() exited" << endl;
             pivots = total_piv;
+            record_solve(M, q, z, true, lambda);
             return true;
           }
           else
           {
-            FILE_LOG(LOG_OPT) << "LCP::lcp_lemke() - '<w, z> not within tolerance(min value: " << *mmax.first << " max value: " << *mmax.second << ")" << std::endl; 
+            FILE_LOG(LOG_OPT) << "LCP::lcp_lemke() - '<w, z> not within tolerance(min value: " << *mmax.first << " max value: " << *mmax.second << ")" << std::endl;
           }
         }
         else
@@ -483,6 +707,7 @@ bool LCP::lcp_lemke_regularized(const MatrixNd& M, const VectorNd& q, VectorNd&
   pivots = total_piv;
 
   // still here?  failure...
+  record_solve(M, q, z, false, std::pow((double) 10.0, (double) max_exp));
   return false;
 }
 
@@ -521,8 +746,26 @@ void LCP::log_failure(const MatrixNd& M, const VectorNd& q)
     fname << rand() % 10;
   fname << ".fail";
 
-  // open the file
+  // open the file and write the problem
   std::ofstream out(fname.str().c_str());
+  write_lcp(M, q, out);
+  out.close();
+}
+
+// the capture prefix (empty by default; capture() also consults the
+// MOBY_LCP_CAPTURE_PREFIX environment variable on its first call)
+std::string LCP::capture_prefix;
+
+/// Writes an LCP (M, q) in the text format used for failure logs and captures
+/**
+ * The format is n rows of n whitespace-separated entries of M followed by one
+ * row holding q -- the same layout log_failure() has always produced, so
+ * existing *.fail files remain readable.
+ */
+void LCP::write_lcp(const MatrixNd& M, const VectorNd& q, std::ostream& out)
+{
+  // use full precision so replayed problems pivot identically
+  out << std::setprecision(17);
 
   // write the matrix
   for (unsigned i=0; i< M.rows(); i++)
@@ -531,9 +774,89 @@ void LCP::log_failure(const MatrixNd& M, const VectorNd& q)
       out << M(i,j) << " ";
     out << std::endl;
   }
+
+  // write the vector
   for (unsigned j=0; j< M.columns(); j++)
     out << q[j] << " ";
   out << std::endl;
+}
+
+/// Reads an LCP (M, q) written by write_lcp()
+/**
+ * The problem dimension is inferred from the number of entries on the first
+ * line.
+ * \return true if a well-formed problem was read
+ */
+bool LCP::read_lcp(MatrixNd& M, VectorNd& q, std::istream& in)
+{
+  // read the first line and infer the dimension
+  std::string line;
+  if (!std::getline(in, line))
+    return false;
+  std::istringstream first(line);
+  std::vector<double> row;
+  double value;
+  while (first >> value)
+    row.push_back(value);
+  const unsigned N = row.size();
+  if (N == 0)
+    return false;
+
+  // populate the first row of the matrix
+  M.resize(N, N);
+  for (unsigned j=0; j< N; j++)
+    M(0, j) = row[j];
+
+  // read the remaining rows
+  for (unsigned i=1; i< N; i++)
+    for (unsigned j=0; j< N; j++)
+      if (!(in >> M(i,j)))
+        return false;
+
+  // read the vector
+  q.resize(N);
+  for (unsigned j=0; j< N; j++)
+    if (!(in >> q[j]))
+      return false;
+
+  return true;
+}
+
+/// Captures an assembled LCP to '<prefix>NNNNNN.Mq', if capturing is enabled
+/**
+ * Call sites in the constraint handlers invoke this just before solving so
+ * that representative problems from live runs can be replayed offline (e.g.,
+ * by moby-bench-lcp). Capture is enabled by setting capture_prefix or the
+ * MOBY_LCP_CAPTURE_PREFIX environment variable.
+ */
+void LCP::capture(const MatrixNd& M, const VectorNd& q)
+{
+  static unsigned counter = 0;
+  static bool checked_env = false;
+
+  // consult the environment once if no prefix has been set programmatically
+  if (!checked_env)
+  {
+    checked_env = true;
+    if (capture_prefix.empty())
+    {
+      const char* env_prefix = getenv("MOBY_LCP_CAPTURE_PREFIX");
+      if (env_prefix)
+        capture_prefix = env_prefix;
+    }
+  }
+
+  // do nothing if capturing is disabled
+  if (capture_prefix.empty())
+    return;
+
+  // generate the filename
+  std::ostringstream fname;
+  fname << capture_prefix << std::setfill('0') << std::setw(6) << counter++ << ".Mq";
+
+  // write the problem
+  std::ofstream out(fname.str().c_str());
+  write_lcp(M, q, out);
   out.close();
 }
 
@@ -580,6 +903,7 @@ bool LCP::lcp_lemke(const MatrixNd& M, const VectorNd& q, VectorNd& z, double pi
     FILE_LOG(LOG_OPT) << " -- trivial solution found" << endl;
     FILE_LOG(LOG_OPT) << "LCP::lcp_lemke() exited" << endl;
     z.set_zero(n);
+    if (!_nested) record_solve(M, q, z, true, 0.0);
     return true;
   }
 
@@ -665,9 +989,12 @@ restart: // solver restarts from here when basis becomes bad
     // solve B*x = -q
     try
     {
-      _Al = _Bl;
       _x = q;
-      _LA.solve_fast(_Al, _x);
+      if (!use_mixed_precision || !solve_basis_mixed(_Bl, _x))
+      {
+        _Al = _Bl;
+        _LA.solve_fast(_Al, _x);
+      }
     }
     catch (SingularException e)
     {
@@ -754,7 +1081,8 @@ restart: // solver restarts from here when basis becomes bad
     }
     FILE_LOG(LOG_OPT) << "LCP::lcp_lemke() exited" << endl;
 
-    return true; 
+    if (!_nested) record_solve(M, q, z, true, 0.0);
+    return true;
   }
 
   // use a new pivot tolerance if necessary
@@ -818,7 +1146,8 @@ restart: // solver restarts from here when basis becomes bad
       }
       FILE_LOG(LOG_OPT) << "LCP::lcp_lemke() exited" << endl;
 
-      return true; 
+      if (!_nested) record_solve(M, q, z, true, 0.0);
+      return true;
     }
     else if (leaving < n)
     {
@@ -834,8 +1163,11 @@ restart: // solver restarts from here when basis becomes bad
     _dl = _Be;
     try
     {
-      _Al = _Bl;
-      _LA.solve_fast(_Al, _dl);
+      if (!use_mixed_precision || !solve_basis_mixed(_Bl, _dl))
+      {
+        _Al = _Bl;
+        _LA.solve_fast(_Al, _dl);
+      }
     }
     catch (SingularException e)
     {
@@ -843,10 +1175,11 @@ restart: // solver restarts from here when basis becomes bad
       FILE_LOG(LOG_OPT) << " -- LCP::lcp_lemke() exiting" << std::endl;
 
       // log failure
-      #ifndef NDEBUG 
+      #ifndef NDEBUG
 //      log_failure(M, q);
-      #endif 
+      #endif
 
+      if (!_nested) record_solve(M, q, z, false, 0.0);
       return false;
 /*
       FILE_LOG(LOG_OPT) << " -- warning: linear system solver failed; restarting with new basis" << std::endl;
@@ -895,10 +1228,11 @@ restart: // solver restarts from here when basis becomes bad
       FILE_LOG(LOG_OPT) << "LCP::lcp_lemke() exiting" << endl;
 
       // log failure
-      #ifndef NDEBUG 
+      #ifndef NDEBUG
 //      log_failure(M, q);
       #endif
 
+      if (!_nested) record_solve(M, q, z, false, 0.0);
       return false;
     }
 
@@ -950,10 +1284,11 @@ restart: // solver restarts from here when basis becomes bad
       z.resize(n, true);
 
       // log failure
-      #ifndef NDEBUG 
+      #ifndef NDEBUG
 //      log_failure(M, q);
       #endif
 
+      if (!_nested) record_solve(M, q, z, false, 0.0);
       return false;
     }
 
@@ -995,10 +1330,11 @@ restart: // solver restarts from here when basis becomes bad
   // max iterations exceeded
   z.resize(n, true);
   // log failure
-  #ifndef NDEBUG 
+  #ifndef NDEBUG
 //  log_failure(M, q);
   #endif
- 
+
+  if (!_nested) record_solve(M, q, z, false, 0.0);
   return false;
 }
 
@@ -1014,6 +1350,10 @@ bool LCP::lcp_lemke_regularized(const SparseMatrixNd& M, const VectorNd& q, Vect
     return true;
   }
 
+  // keep the inner solves from recording statistics; this wrapper records
+  // the composite solve itself
+  NestedSolveGuard guard(_nested);
+
   // copy MM
   _MMs = M;
 
@@ -1038,6 +1378,7 @@ bool LCP::lcp_lemke_regularized(const SparseMatrixNd& M, const VectorNd& q, Vect
         {
           FILE_LOG(LOG_OPT) << "  solved with no regularization necessary!" << endl;
           FILE_LOG(LOG_OPT) << "LCP::lcp_lemke_regularized() exited" << endl;
+          record_solve(M, q, z, true, 0.0);
           return true;
         }
       }
@@ -1078,6 +1419,7 @@ bool LCP::lcp_lemke_regularized(const SparseMatrixNd& M, const VectorNd& q, Vect
             FILE_LOG(LOG_OPT) << "  solved with regularization factor: " << lambda << endl;
             FILE_LOG(LOG_OPT) << "LCP::lcp_lemke_regularized() exited" << endl;
 
+            record_solve(M, q, z, true, lambda);
             return true;
           }
         }
@@ -1092,6 +1434,7 @@ bool LCP::lcp_lemke_regularized(const SparseMatrixNd& M, const VectorNd& q, Vect
   FILE_LOG(LOG_OPT) << "LCP::lcp_lemke_regularized() exited" << endl;
 
   // still here?  failure...
+  record_solve(M, q, z, false, std::pow((double) 10.0, (double) max_exp));
   return false;
 }
 
@@ -1136,6 +1479,7 @@ bool LCP::lcp_lemke(const SparseMatrixNd& M, const VectorNd& q, VectorNd& z, dou
     FILE_LOG(LOG_OPT) << " -- trivial solution found" << endl;
     FILE_LOG(LOG_OPT) << "LCP::lcp_lemke() exited" << endl;
     z.set_zero(n);
+    if (!_nested) record_solve(M, q, z, true, 0.0);
     return true;
   }
 
@@ -1221,7 +1565,8 @@ bool LCP::lcp_lemke(const SparseMatrixNd& M, const VectorNd& q, VectorNd& z, dou
     }
     FILE_LOG(LOG_OPT) << "LCP::lcp_lemke() exited" << endl;
 
-    return true; 
+    if (!_nested) record_solve(M, q, z, true, 0.0);
+    return true;
   }
 
   // determine initial leaving variable
@@ -1271,7 +1616,8 @@ bool LCP::lcp_lemke(const SparseMatrixNd& M, const VectorNd& q, VectorNd& z, dou
       }
       FILE_LOG(LOG_OPT) << "LCP::lcp_lemke() exited" << endl;
 
-      return true; 
+      if (!_nested) record_solve(M, q, z, true, 0.0);
+      return true;
     }
     else if (leaving < n)
     {
@@ -1301,6 +1647,7 @@ bool LCP::lcp_lemke(const SparseMatrixNd& M, const VectorNd& q, VectorNd& z, dou
       FILE_LOG(LOG_OPT) << "LCP::lcp_lemke() exited" << endl;
 
       z.resize(n, true);
+      if (!_nested) record_solve(M, q, z, false, 0.0);
       return false;
     }
 
@@ -1335,6 +1682,7 @@ bool LCP::lcp_lemke(const SparseMatrixNd& M, const VectorNd& q, VectorNd& z, dou
       FILE_LOG(LOG_OPT) << "zero tolerance too low?" << std::endl;
       FILE_LOG(LOG_OPT) << "LCP::lcp_lemke() exited" << std::endl;
       z.resize(n, true);
+      if (!_nested) record_solve(M, q, z, false, 0.0);
       return false;
     }
 
@@ -1376,7 +1724,8 @@ bool LCP::lcp_lemke(const SparseMatrixNd& M, const VectorNd& q, VectorNd& z, dou
 
   // max iterations exceeded
   z.resize(n, true);
-  
+
+  if (!_nested) record_solve(M, q, z, false, 0.0);
   return false;
 }
 
@@ -4,7 +4,10 @@
  * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
  ****************************************************************************/
 
+#include <algorithm>
+#include <cmath>
 #include <numeric>
+#include <Moby/AlignedSlabPool.h>
 #include <Moby/LCP_IPOPT.h>
 
 extern "C"
@@ -49,7 +52,7 @@ bool LCP_IPOPT::get_nlp_info(Index& n, Index& m, Index& nnz_jac_g, Index& nnz_h_
         nnz_h_lag++;
 
   // setup objective component of Hessian and indices
-  _h_obj = shared_array<double>(new double[nnz_h_lag]);
+  _h_obj = AlignedSlabPool::pool("LCP_IPOPT").acquire(nnz_h_lag);
   _h_iRow = shared_array<unsigned>(new unsigned[nnz_h_lag]);  
   _h_jCol = shared_array<unsigned>(new unsigned[nnz_h_lag]);
   for (unsigned i=0, k=0; i< n; i++)
@@ -176,6 +179,24 @@ void LCP_IPOPT::finalize_solution(SolverReturn status, Index n, const Number* x,
   // copy x
   z.resize(n);
   std::copy(x, x+n, z.begin());
+
+  // record solver telemetry: the l-inf complementarity residual of the
+  // final iterate (no pivots or regularization for interior-point solves)
+  const bool solved = (status == Ipopt::SUCCESS || status == Ipopt::STOP_AT_ACCEPTABLE_POINT);
+  double residual = -1.0;
+  if (solved && q.size() > 0)
+  {
+    VectorNd w;
+    M.mult(z, w) += q;
+    residual = 0.0;
+    for (unsigned i=0; i< q.size(); i++)
+    {
+      residual = std::max(residual, -z[i]);
+      residual = std::max(residual, -w[i]);
+      residual = std::max(residual, std::fabs(z[i]*w[i]));
+    }
+  }
+  stats.record(0, 0.0, residual, -1.0, solved);
 }
 
 /// The Hessian
@@ -3,9 +3,25 @@
 using namespace Moby;
 
 std::ofstream OutputToFile::stream;
+std::vector<std::string> OutputToFile::ring;
+unsigned OutputToFile::ring_next = 0;
+bool OutputToFile::ring_wrapped = false;
 
 void OutputToFile::output(const std::string& msg)
 {
+  // with a ring buffer configured, buffer the message instead of writing
+  // (and flushing) the stream inline
+  if (!ring.empty())
+  {
+    ring[ring_next] = msg;
+    if (++ring_next == ring.size())
+    {
+      ring_next = 0;
+      ring_wrapped = true;
+    }
+    return;
+  }
+
   if (!stream.is_open())
   {
     std::ofstream stderr_stream("/dev/stderr", std::ofstream::app);
@@ -15,3 +31,29 @@ void OutputToFile::output(const std::string& msg)
     stream << msg << std::flush;
 }
 
+/// Sets the ring buffer capacity (zero restores inline stream writes)
+void OutputToFile::set_ring_capacity(unsigned n)
+{
+  ring.clear();
+  ring.resize(n);
+  ring_next = 0;
+  ring_wrapped = false;
+}
+
+/// Writes the buffered messages, oldest first, to the log stream
+void OutputToFile::dump_ring()
+{
+  if (ring.empty())
+    return;
+
+  // determine the oldest entry
+  const unsigned N = (ring_wrapped) ? ring.size() : ring_next;
+  const unsigned start = (ring_wrapped) ? ring_next : 0;
+
+  // write the entries through the stream path, bypassing the ring
+  std::vector<std::string> buffered;
+  buffered.swap(ring);
+  for (unsigned i=0; i< N; i++)
+    output(buffered[(start + i) % buffered.size()]);
+  ring.swap(buffered);
+}
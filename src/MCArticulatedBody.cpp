@@ -24,6 +24,7 @@ MCArticulatedBody::MCArticulatedBody()
 {
   b_alpha = (double) 0.8;
   b_beta = (double) 0.9;
+  _block_factor_valid = false;
 }
 
 /// Applies a generalized impulse to the articulated body
@@ -230,23 +231,30 @@ void MCArticulatedBody::precalc()
   // determine the sparse inertias 
   determine_inertias();
 
-  // now form Jx_iM_Jx' and its inverse
+  // now form Jx_iM_Jx' and factor it; try the block-sparse factorization
+  // first-- it couples two joints only when they share a link, so loop-free
+  // mechanisms factor with no fill-in and near-linear cost in the number of
+  // links-- and fall back to the dense factorization if a pivot block is
+  // not positive definite
   _rank_def = false;
   calc_Jx_iM_JyT(_Jx, _Jx, _Jx_iM_JxT);
-  _inv_Jx_iM_JxT = _Jx_iM_JxT;
-  if (!_LA.factor_chol(_inv_Jx_iM_JxT))
-  {  
+  if (!factor_Jx_iM_JxT_sparse())
+  {
     _inv_Jx_iM_JxT = _Jx_iM_JxT;
-    try
-    {
-      LinAlg::pseudo_inverse(_inv_Jx_iM_JxT, LinAlg::svd1);
-    }
-    catch (NumericalException e)
+    if (!_LA.factor_chol(_inv_Jx_iM_JxT))
     {
       _inv_Jx_iM_JxT = _Jx_iM_JxT;
-      LinAlg::pseudo_inverse(_inv_Jx_iM_JxT, LinAlg::svd2);
+      try
+      {
+        LinAlg::pseudo_inverse(_inv_Jx_iM_JxT, LinAlg::svd1);
+      }
+      catch (NumericalException e)
+      {
+        _inv_Jx_iM_JxT = _Jx_iM_JxT;
+        LinAlg::pseudo_inverse(_inv_Jx_iM_JxT, LinAlg::svd2);
+      }
+      _rank_def = true;
     }
-    _rank_def = true;
   }
 
   // determine the generalized velocity; note that this must be
@@ -267,6 +275,65 @@ void MCArticulatedBody::precalc()
 /// Solves J*iM*J'*x = rhs for x
 VectorNd& MCArticulatedBody::solve_Jx_iM_JxT(const VectorNd& rhs, VectorNd& x) const
 {
+  SAFESTATIC VectorNd sub, prod;
+
+  // use the block-sparse factorization when it is available; each phase
+  // visits only the nonzero factor blocks, so the solve is linear in the
+  // number of joints for loop-free mechanisms
+  if (_block_factor_valid)
+  {
+    const unsigned NJ = _joints.size();
+    x = rhs;
+
+    // forward substitution (L*z = rhs) in elimination order
+    for (unsigned m=0; m< NJ; m++)
+    {
+      const unsigned p = _elim_order[m];
+      const unsigned pst = _joints[p]->get_constraint_index();
+      const unsigned pnc = _joints[p]->num_constraint_eqns();
+      x.get_sub_vec(pst, pst+pnc, sub);
+      for (unsigned k=0; k< _factor_nbrs[p].size(); k++)
+      {
+        const unsigned i = _factor_nbrs[p][k];
+        const unsigned ist = _joints[i]->get_constraint_index();
+        const unsigned inc = _joints[i]->num_constraint_eqns();
+        _factor_blocks[p][k].mult(sub, prod);
+        for (unsigned r=0; r< inc; r++)
+          x[ist+r] -= prod[r];
+      }
+    }
+
+    // diagonal solve (D*w = z)
+    for (unsigned p=0; p< NJ; p++)
+    {
+      const unsigned pst = _joints[p]->get_constraint_index();
+      const unsigned pnc = _joints[p]->num_constraint_eqns();
+      x.get_sub_vec(pst, pst+pnc, sub);
+      _pivot_inv[p].mult(sub, prod);
+      x.set_sub_vec(pst, prod);
+    }
+
+    // back substitution (L'*x = w) in reverse elimination order
+    for (unsigned m=NJ; m-- > 0; )
+    {
+      const unsigned p = _elim_order[m];
+      const unsigned pst = _joints[p]->get_constraint_index();
+      const unsigned pnc = _joints[p]->num_constraint_eqns();
+      for (unsigned k=0; k< _factor_nbrs[p].size(); k++)
+      {
+        const unsigned i = _factor_nbrs[p][k];
+        const unsigned ist = _joints[i]->get_constraint_index();
+        const unsigned inc = _joints[i]->num_constraint_eqns();
+        x.get_sub_vec(ist, ist+inc, sub);
+        _factor_blocks[p][k].transpose_mult(sub, prod);
+        for (unsigned r=0; r< pnc; r++)
+          x[pst+r] -= prod[r];
+      }
+    }
+
+    return x;
+  }
+
   if (!_rank_def)
   {
     x = rhs;
@@ -278,6 +345,486 @@ VectorNd& MCArticulatedBody::solve_Jx_iM_JxT(const VectorNd& rhs, VectorNd& x) c
   return x;
 }
 
+/// Builds the joint adjacency of the constraint graph
+/**
+ * Joints are the vertices; two joints are adjacent when they share a link,
+ * which is exactly the block-sparsity pattern of Jx*iM*Jx'.
+ */
+void MCArticulatedBody::build_joint_adjacency(vector<std::set<unsigned> >& adj) const
+{
+  const unsigned NJ = _joints.size();
+
+  // all joints attached to a common link are mutually adjacent
+  adj.assign(NJ, std::set<unsigned>());
+  vector<vector<unsigned> > link_joints(_links.size());
+  for (unsigned i=0; i< NJ; i++)
+  {
+    link_joints[_joints[i]->get_inboard_link()->get_index()].push_back(i);
+    link_joints[_joints[i]->get_outboard_link()->get_index()].push_back(i);
+  }
+  for (unsigned i=0; i< link_joints.size(); i++)
+    for (unsigned j=0; j< link_joints[i].size(); j++)
+      for (unsigned k=j+1; k< link_joints[i].size(); k++)
+      {
+        adj[link_joints[i][j]].insert(link_joints[i][k]);
+        adj[link_joints[i][k]].insert(link_joints[i][j]);
+      }
+}
+
+/// Orders a subset of the joints by greedy minimum degree
+/**
+ * Eliminates chains from their free ends inward and tree mechanisms
+ * leaf-first, producing no fill for either.  Joints outside the subset are
+ * ignored entirely; fill is tracked on the local copy of the adjacency, so
+ * the caller's adjacency is untouched (see add_elimination_fill()).
+ */
+void MCArticulatedBody::min_degree_order(vector<std::set<unsigned> > adj, const vector<bool>& in_subset, vector<unsigned>& order)
+{
+  const unsigned UINF = std::numeric_limits<unsigned>::max();
+  const unsigned NJ = adj.size();
+
+  // joints outside the subset are treated as already gone
+  order.clear();
+  vector<bool> eliminated(NJ);
+  unsigned remaining = 0;
+  for (unsigned i=0; i< NJ; i++)
+  {
+    eliminated[i] = !in_subset[i];
+    if (in_subset[i])
+      remaining++;
+  }
+
+  // greedily eliminate the joint with the fewest uneliminated neighbors,
+  // adding fill edges between its remaining neighbors
+  for (unsigned m=0; m< remaining; m++)
+  {
+    // find the uneliminated joint of minimum degree
+    unsigned best = UINF, best_deg = UINF;
+    for (unsigned i=0; i< NJ; i++)
+    {
+      if (eliminated[i])
+        continue;
+      unsigned deg = 0;
+      for (std::set<unsigned>::const_iterator s = adj[i].begin(); s != adj[i].end(); s++)
+        if (!eliminated[*s])
+          deg++;
+      if (deg < best_deg)
+      {
+        best = i;
+        best_deg = deg;
+      }
+    }
+    assert(best != UINF);
+
+    // eliminate it, connecting its remaining neighbors
+    eliminated[best] = true;
+    order.push_back(best);
+    for (std::set<unsigned>::const_iterator s1 = adj[best].begin(); s1 != adj[best].end(); s1++)
+    {
+      if (eliminated[*s1])
+        continue;
+      std::set<unsigned>::const_iterator s2 = s1;
+      for (s2++; s2 != adj[best].end(); s2++)
+        if (!eliminated[*s2])
+        {
+          adj[*s1].insert(*s2);
+          adj[*s2].insert(*s1);
+        }
+    }
+  }
+}
+
+/// Adds the fill edges induced by eliminating the joints in the given order
+void MCArticulatedBody::add_elimination_fill(vector<std::set<unsigned> >& adj, const vector<unsigned>& order)
+{
+  const unsigned NJ = adj.size();
+
+  // invert the ordering so later-than tests are cheap
+  vector<unsigned> pos(NJ);
+  for (unsigned m=0; m< order.size(); m++)
+    pos[order[m]] = m;
+
+  // eliminating a joint connects all of its not-yet-eliminated neighbors
+  for (unsigned m=0; m< order.size(); m++)
+  {
+    const unsigned p = order[m];
+    for (std::set<unsigned>::const_iterator s1 = adj[p].begin(); s1 != adj[p].end(); s1++)
+    {
+      if (pos[*s1] <= m)
+        continue;
+      std::set<unsigned>::const_iterator s2 = s1;
+      for (s2++; s2 != adj[p].end(); s2++)
+        if (pos[*s2] > m)
+        {
+          adj[*s1].insert(*s2);
+          adj[*s2].insert(*s1);
+        }
+    }
+  }
+}
+
+/// Runs a breadth-first search over the joint adjacency, recording levels
+/**
+ * \return the last joint visited (a farthest joint from the start)
+ */
+static unsigned bfs_levels(const vector<std::set<unsigned> >& adj, unsigned start, vector<int>& level)
+{
+  level.assign(adj.size(), -1);
+  vector<unsigned> queue;
+  queue.push_back(start);
+  level[start] = 0;
+  unsigned last = start;
+  for (unsigned h=0; h< queue.size(); h++)
+  {
+    const unsigned v = queue[h];
+    last = v;
+    for (std::set<unsigned>::const_iterator s = adj[v].begin(); s != adj[v].end(); s++)
+      if (level[*s] < 0)
+      {
+        level[*s] = level[v] + 1;
+        queue.push_back(*s);
+      }
+  }
+  return last;
+}
+
+/// Splits the constraint graph into two independent parts and a separator
+/**
+ * Single-level nested dissection by breadth-first level sets: a BFS is run
+ * from a pseudo-peripheral joint and the level whose removal best balances
+ * the two remaining halves becomes the separator.  The sides then share no
+ * edge, so their pivots can be eliminated concurrently (see
+ * factor_Jx_iM_JxT_sparse()).  Joints outside the start joint's connected
+ * component are assigned to the smaller side (they couple to nothing there).
+ * \return <b>false</b> when the graph yields no usable split (too few BFS
+ *         levels or an empty side), in which case the caller orders the
+ *         whole graph serially
+ */
+bool MCArticulatedBody::partition_joint_graph(const vector<std::set<unsigned> >& adj, vector<bool>& inA, vector<bool>& inB, vector<bool>& inS) const
+{
+  const unsigned NJ = adj.size();
+
+  // find a pseudo-peripheral start: BFS from joint 0, then BFS again from
+  // the farthest joint found
+  vector<int> level;
+  const unsigned far = bfs_levels(adj, 0, level);
+  bfs_levels(adj, far, level);
+
+  // count the joints on each level
+  int nlev = 0;
+  for (unsigned i=0; i< NJ; i++)
+    nlev = std::max(nlev, level[i] + 1);
+  if (nlev < 3)
+    return false;
+  vector<unsigned> count(nlev, 0);
+  unsigned visited = 0;
+  for (unsigned i=0; i< NJ; i++)
+    if (level[i] >= 0)
+    {
+      count[level[i]]++;
+      visited++;
+    }
+
+  // choose the separator level that best balances the two sides
+  int sep_lev = -1;
+  unsigned best_imbalance = std::numeric_limits<unsigned>::max();
+  unsigned below = 0;
+  for (int l=1; l< nlev-1; l++)
+  {
+    below += count[l-1];
+    const unsigned above = visited - below - count[l];
+    const unsigned imbalance = (below > above) ? below - above : above - below;
+    if (below > 0 && above > 0 && imbalance < best_imbalance)
+    {
+      sep_lev = l;
+      best_imbalance = imbalance;
+    }
+  }
+  if (sep_lev < 0)
+    return false;
+
+  // assign the sides; joints in other components go to the smaller side
+  inA.assign(NJ, false);
+  inB.assign(NJ, false);
+  inS.assign(NJ, false);
+  unsigned nA = 0, nB = 0;
+  for (unsigned i=0; i< NJ; i++)
+  {
+    if (level[i] < 0)
+      continue;
+    if (level[i] < sep_lev)
+    {
+      inA[i] = true;
+      nA++;
+    }
+    else if (level[i] == sep_lev)
+      inS[i] = true;
+    else
+    {
+      inB[i] = true;
+      nB++;
+    }
+  }
+  for (unsigned i=0; i< NJ; i++)
+    if (level[i] < 0)
+    {
+      if (nA <= nB)
+      {
+        inA[i] = true;
+        nA++;
+      }
+      else
+      {
+        inB[i] = true;
+        nB++;
+      }
+    }
+
+  return (nA > 0 && nB > 0);
+}
+
+/// Eliminates a contiguous range of pivots of the block LDL' factorization
+/**
+ * Processes pivots _elim_order[m0..m1) on A (see factor_Jx_iM_JxT_sparse()
+ * for the factorization structure).  When Ssum is non-NULL, Schur updates
+ * to blocks whose row and column joints both lie in the separator are
+ * accumulated there (at the compact offsets in sep_ofs) instead of applied
+ * to A; two ranges whose joints share only separator blocks can then run
+ * concurrently and their accumulators be summed afterward.  Local (not
+ * shared) temporaries are used throughout, so concurrent calls are safe.
+ * \return <b>false</b> if a pivot block is not positive definite
+ */
+bool MCArticulatedBody::eliminate_block_pivots(MatrixNd& A, const vector<unsigned>& pos, const vector<std::set<unsigned> >& adj, unsigned m0, unsigned m1, const vector<bool>& in_sep, const vector<unsigned>& sep_ofs, MatrixNd* Ssum)
+{
+  MatrixNd App, Aip, Ajp, sub, upd;
+  LinAlgd LA;
+
+  // process the pivots in elimination order
+  for (unsigned m=m0; m< m1; m++)
+  {
+    const unsigned p = _elim_order[m];
+    const unsigned pst = _joints[p]->get_constraint_index();
+    const unsigned pnc = _joints[p]->num_constraint_eqns();
+
+    // invert the pivot block through its Cholesky factorization; failure
+    // indicates (near) rank deficiency, which the dense path handles
+    A.get_sub_mat(pst, pst+pnc, pst, pst+pnc, App);
+    if (!LA.factor_chol(App))
+    {
+      FILE_LOG(LOG_DYNAMICS) << "MCArticulatedBody::eliminate_block_pivots() - pivot block for joint " << _joints[p]->id << " not positive definite" << endl;
+      return false;
+    }
+    _pivot_inv[p].resize(pnc, pnc);
+    _pivot_inv[p].set_identity();
+    LA.solve_chol_fast(App, _pivot_inv[p]);
+
+    // collect the joints that follow p in the elimination order
+    vector<unsigned>& nbrs = _factor_nbrs[p];
+    nbrs.clear();
+    for (std::set<unsigned>::const_iterator s = adj[p].begin(); s != adj[p].end(); s++)
+      if (pos[*s] > m)
+        nbrs.push_back(*s);
+
+    // compute the factor blocks L(i,p) = A(i,p)*inv(D(p))
+    vector<MatrixNd>& Lp = _factor_blocks[p];
+    Lp.resize(nbrs.size());
+    for (unsigned k=0; k< nbrs.size(); k++)
+    {
+      const unsigned ist = _joints[nbrs[k]]->get_constraint_index();
+      const unsigned inc = _joints[nbrs[k]]->num_constraint_eqns();
+      A.get_sub_mat(ist, ist+inc, pst, pst+pnc, Aip);
+      Aip.mult(_pivot_inv[p], Lp[k]);
+    }
+
+    // apply the Schur complement update A(i,j) -= L(i,p)*A(j,p)' to the
+    // remaining blocks; by symmetry only the lower triangle plus the
+    // diagonal need updating, with the transpose mirrored
+    for (unsigned k=0; k< nbrs.size(); k++)
+    {
+      const unsigned i = nbrs[k];
+      const unsigned ist = _joints[i]->get_constraint_index();
+      const unsigned inc = _joints[i]->num_constraint_eqns();
+      for (unsigned k2=0; k2<= k; k2++)
+      {
+        const unsigned j = nbrs[k2];
+        const unsigned jst = _joints[j]->get_constraint_index();
+        const unsigned jnc = _joints[j]->num_constraint_eqns();
+        A.get_sub_mat(jst, jst+jnc, pst, pst+pnc, Ajp);
+        Lp[k].mult_transpose(Ajp, upd);
+        if (Ssum && in_sep[i] && in_sep[j])
+        {
+          // defer separator-separator updates to the private accumulator
+          const unsigned si = sep_ofs[i];
+          const unsigned sj = sep_ofs[j];
+          Ssum->get_sub_mat(si, si+inc, sj, sj+jnc, sub);
+          sub -= upd;
+          Ssum->set_sub_mat(si, sj, sub);
+          if (k2 != k)
+          {
+            MatrixNd::transpose(sub, upd);
+            Ssum->set_sub_mat(sj, si, upd);
+          }
+        }
+        else
+        {
+          A.get_sub_mat(ist, ist+inc, jst, jst+jnc, sub);
+          sub -= upd;
+          A.set_sub_mat(ist, jst, sub);
+          if (k2 != k)
+          {
+            MatrixNd::transpose(sub, upd);
+            A.set_sub_mat(jst, ist, upd);
+          }
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+/// Attempts a block-sparse LDL' factorization of Jx*iM*Jx'
+/**
+ * Each diagonal block corresponds to one joint's constraint equations and
+ * each off-diagonal block couples two joints that share a link, so the
+ * block structure mirrors the mechanism graph.  With a leaf-first
+ * elimination ordering, loop-free mechanisms factor with no fill-in,
+ * making factorization and solves near-linear in the number of links (the
+ * dense factorization is cubic).
+ *
+ * When OpenMP is available and the mechanism is large enough, the ordering
+ * is produced by one level of nested dissection over the constraint graph:
+ * the two sides of the dissection share no edge (and, because fill cannot
+ * cross an uneliminated separator, no fill edge either), so their pivots
+ * are eliminated concurrently -- parallelism inside a single mechanism,
+ * which island decomposition cannot provide -- followed by a small serial
+ * elimination of the separator.
+ * \return <b>false</b> if a pivot block is not positive definite, in which
+ *         case the caller should fall back to the dense factorization
+ */
+bool MCArticulatedBody::factor_Jx_iM_JxT_sparse()
+{
+  SAFESTATIC MatrixNd A;
+  SAFESTATIC vector<std::set<unsigned> > adj;
+  SAFESTATIC vector<unsigned> pos;
+
+  // assume the factorization will not complete
+  _block_factor_valid = false;
+
+  const unsigned NJ = _joints.size();
+  if (NJ == 0)
+    return false;
+
+  // build the joint adjacency of the constraint graph
+  build_joint_adjacency(adj);
+
+  // try a one-level nested dissection when the mechanism is large enough
+  // for parallel elimination of the two sides to pay off; the ordering is
+  // side A, then side B, then the separator
+  bool dissected = false;
+  unsigned mA_end = 0, mB_end = 0;
+  vector<bool> inS;
+#ifdef _OPENMP
+  const unsigned MIN_DISSECT_JOINTS = 16;
+  if (NJ >= MIN_DISSECT_JOINTS)
+  {
+    vector<bool> inA, inB;
+    if (partition_joint_graph(adj, inA, inB, inS))
+    {
+      vector<unsigned> ordB, ordS;
+      min_degree_order(adj, inA, _elim_order);
+      min_degree_order(adj, inB, ordB);
+      min_degree_order(adj, inS, ordS);
+      mA_end = _elim_order.size();
+      _elim_order.insert(_elim_order.end(), ordB.begin(), ordB.end());
+      mB_end = _elim_order.size();
+      _elim_order.insert(_elim_order.end(), ordS.begin(), ordS.end());
+      dissected = true;
+    }
+  }
+#endif
+
+  // otherwise order the whole graph leaf-first
+  if (!dissected)
+    min_degree_order(adj, vector<bool>(NJ, true), _elim_order);
+
+  // add the fill edges the ordering induces and invert the ordering so
+  // later-than tests are cheap
+  add_elimination_fill(adj, _elim_order);
+  pos.resize(NJ);
+  for (unsigned m=0; m< NJ; m++)
+    pos[_elim_order[m]] = m;
+
+  // eliminate on a copy of Jx*iM*Jx'
+  A = _Jx_iM_JxT;
+
+  // size the factor storage
+  _pivot_inv.resize(NJ);
+  _factor_nbrs.assign(NJ, vector<unsigned>());
+  _factor_blocks.assign(NJ, vector<MatrixNd>());
+
+#ifdef _OPENMP
+  if (dissected)
+  {
+    // compact offsets for the separator joints' constraint equations
+    vector<unsigned> sep_ofs(NJ, 0);
+    unsigned NS = 0;
+    for (unsigned m=mB_end; m< NJ; m++)
+    {
+      const unsigned s = _elim_order[m];
+      sep_ofs[s] = NS;
+      NS += _joints[s]->num_constraint_eqns();
+    }
+
+    // eliminate the two sides concurrently; each side updates only its own
+    // blocks and its couplings to the separator, and accumulates its
+    // updates to separator-separator blocks privately
+    MatrixNd SsumA(NS, NS), SsumB(NS, NS);
+    SsumA.set_zero();
+    SsumB.set_zero();
+    bool okA = true, okB = true;
+    #pragma omp parallel sections
+    {
+      #pragma omp section
+      okA = eliminate_block_pivots(A, pos, adj, 0, mA_end, inS, sep_ofs, &SsumA);
+      #pragma omp section
+      okB = eliminate_block_pivots(A, pos, adj, mA_end, mB_end, inS, sep_ofs, &SsumB);
+    }
+    if (!okA || !okB)
+      return false;
+
+    // fold both sides' accumulated updates into the separator blocks
+    MatrixNd sub, acc;
+    for (unsigned m=mB_end; m< NJ; m++)
+      for (unsigned m2=mB_end; m2< NJ; m2++)
+      {
+        const unsigned i = _elim_order[m];
+        const unsigned j = _elim_order[m2];
+        const unsigned ist = _joints[i]->get_constraint_index();
+        const unsigned inc = _joints[i]->num_constraint_eqns();
+        const unsigned jst = _joints[j]->get_constraint_index();
+        const unsigned jnc = _joints[j]->num_constraint_eqns();
+        A.get_sub_mat(ist, ist+inc, jst, jst+jnc, sub);
+        SsumA.get_sub_mat(sep_ofs[i], sep_ofs[i]+inc, sep_ofs[j], sep_ofs[j]+jnc, acc);
+        sub += acc;
+        SsumB.get_sub_mat(sep_ofs[i], sep_ofs[i]+inc, sep_ofs[j], sep_ofs[j]+jnc, acc);
+        sub += acc;
+        A.set_sub_mat(ist, jst, sub);
+      }
+
+    // finish with the small serial elimination of the separator
+    if (!eliminate_block_pivots(A, pos, adj, mB_end, NJ, inS, sep_ofs, NULL))
+      return false;
+  }
+  else
+#endif
+  if (!eliminate_block_pivots(A, pos, adj, 0, NJ, inS, vector<unsigned>(), NULL))
+    return false;
+
+  _block_factor_valid = true;
+  return true;
+}
+
 /// Gets the velocity state-derivative of this articulated body
 void MCArticulatedBody::integrate(double t, double h, boost::shared_ptr<Integrator<VectorNd> > integrator)
 {
@@ -5,6 +5,7 @@
  ****************************************************************************/
 
 #include <numeric>
+#include <Moby/AlignedSlabPool.h>
 #include <Moby/NQP_IPOPT.h>
 
 extern "C"
@@ -31,6 +32,10 @@ static double sqr(double x) { return x*x; }
 NQP_IPOPT::NQP_IPOPT()
 {
   _ZERO_EPS = NEAR_ZERO;
+  _struct_n = _struct_m = 0;
+  _struct_dense = false;
+  _struct_valid = false;
+  _warm_start_ready = false;
 }
 
 /// User should not call this method (for IPOPT)
@@ -43,7 +48,101 @@ bool NQP_IPOPT::get_nlp_info(Index& n, Index& m, Index& nnz_jac_g, Index& nnz_h_
   m = N_CONTACTS + N_ACT_CONTACTS + N_LIMITS + 1;
   MatrixNd t1, t2;
 
-  // compute nonzeros for objective part of Hessian 
+  // determine whether the problem is dense or not
+  _dense = (R.columns() > 0);
+
+  // if the problem dimensions match those of the previous solve, attempt to
+  // reuse the cached sparsity structures: the pattern depends only on which
+  // bodies the active constraints couple, so over a persistent contact set
+  // only the nonzero values change.  the verification below is O(n^2) like
+  // the full computation, but avoids the index map construction and the
+  // per-call allocations (dense problems always take the full path, as
+  // their structures depend on the nullspace)
+  if (!_dense && _struct_valid && !_struct_dense && (unsigned) n == _struct_n &&
+      (unsigned) m == _struct_m)
+  {
+    bool pattern_ok = true;
+
+    // verify the objective Hessian pattern while refilling its values
+    unsigned k = 0;
+    for (unsigned i=0; i< n && pattern_ok; i++)
+      for (unsigned j=i; j< n; j++)
+      {
+        const bool nz = (std::fabs(H(i,j)) > _ZERO_EPS);
+        const bool cached = (k < _nnz_h_obj && _h_iRow[k] == i && _h_jCol[k] == j);
+        if (nz != cached)
+        {
+          pattern_ok = false;
+          break;
+        }
+        if (nz)
+          _h_obj[k++] = H(i,j);
+      }
+    if (k != _nnz_h_obj)
+      pattern_ok = false;
+
+    // verify the Cn_block part of the constraint Jacobian pattern
+    unsigned nv = 0;
+    for (unsigned i=0; i< Cn_block.rows() && pattern_ok; i++)
+      for (unsigned j=0; j< Cn_block.columns(); j++)
+      {
+        const bool nz = (std::fabs(Cn_block(i,j)) > _ZERO_EPS);
+        const bool cached = (nv < _cJac_constant && _cJac_iRow[nv] == i && _cJac_jCol[nv] == j);
+        if (nz != cached)
+        {
+          pattern_ok = false;
+          break;
+        }
+        if (nz)
+          _cJac[nv++] = Cn_block(i,j);
+      }
+
+    // verify the L_block part of the constraint Jacobian pattern
+    for (unsigned i=0; i< L_block.rows() && pattern_ok; i++)
+      for (unsigned j=0; j< L_block.columns(); j++)
+      {
+        const bool nz = (std::fabs(L_block(i,j)) > _ZERO_EPS);
+        const bool cached = (nv < _cJac_constant && _cJac_iRow[nv] == i + Cn_block.rows() && _cJac_jCol[nv] == j);
+        if (nz != cached)
+        {
+          pattern_ok = false;
+          break;
+        }
+        if (nz)
+          _cJac[nv++] = L_block(i,j);
+      }
+
+    // the -1'*N (kappa) row is structurally dense; refill it unconditionally
+    if (pattern_ok && nv + Cn_block.columns() == _cJac_constant)
+    {
+      for (unsigned i=0; i< Cn_block.columns(); i++)
+      {
+        RowIteratord_const ci = Cn_block.column(i).row_iterator_begin();
+        _cJac[nv++] = -std::accumulate(ci, ci.end(), 0.0);
+      }
+    }
+    else
+      pattern_ok = false;
+
+    if (pattern_ok)
+    {
+      // refresh the Coulomb friction constraint Hessians (mu_c may change)
+      for (unsigned i=0; i< N_ACT_CONTACTS; i++)
+      {
+        _h_con[i][0] = 2.0*mu_c[i];
+        _h_con[i][1] = -2.0;
+        _h_con[i][2] = -2.0;
+      }
+
+      // the counts and index arrays are reused verbatim
+      nnz_h_lag = _nnz_h_obj;
+      nnz_jac_g = _cJac_constant + N_ACT_CONTACTS*3;
+      index_style = TNLP::C_STYLE;
+      return true;
+    }
+  }
+
+  // compute nonzeros for objective part of Hessian
   nnz_h_lag = 0;
   _nnz_h_obj = 0;
   _nnz_h_con.clear();
@@ -56,9 +155,6 @@ bool NQP_IPOPT::get_nlp_info(Index& n, Index& m, Index& nnz_jac_g, Index& nnz_h_
   _h_con.resize(N_ACT_CONTACTS);
   std::map<std::pair<unsigned, unsigned>, unsigned> h_obj_nz_indices;
 
-  // determine whether the problem is dense or not
-  _dense = (R.columns() > 0);
-
   // compute nonzeros for (friction) constraint part of Hessian
   if (!_dense)
   {
@@ -89,14 +185,14 @@ bool NQP_IPOPT::get_nlp_info(Index& n, Index& m, Index& nnz_jac_g, Index& nnz_h_
       _h_con_indices[i][2] = h_obj_nz_indices[std::make_pair(T_IDX,T_IDX)];
 
       // setup values for constraint Hessian
-      _h_con[i] = shared_array<double>(new double[3]);
+      _h_con[i] = AlignedSlabPool::pool("NQP_IPOPT").acquire(3);
       _h_con[i][0] = 2.0*mu_c[i];
       _h_con[i][1] = -2.0;
       _h_con[i][2] = -2.0;
     }
 
     // setup objective component of Hessian and indices
-    _h_obj = shared_array<double>(new double[_nnz_h_obj]);
+    _h_obj = AlignedSlabPool::pool("NQP_IPOPT").acquire(_nnz_h_obj);
     _h_iRow = shared_array<unsigned>(new unsigned[nnz_h_lag]);  
     _h_jCol = shared_array<unsigned>(new unsigned[nnz_h_lag]);
     for (unsigned i=0, k=0; i< n; i++)
@@ -123,7 +219,7 @@ bool NQP_IPOPT::get_nlp_info(Index& n, Index& m, Index& nnz_jac_g, Index& nnz_h_
     // setup objective component of Hessian and indices
     // NOTE we assume that the Hessian is dense
     _nnz_h_obj = n*(n-1);
-    _h_obj = shared_array<double>(new double[_nnz_h_obj]);
+    _h_obj = AlignedSlabPool::pool("NQP_IPOPT").acquire(_nnz_h_obj);
     _h_iRow = shared_array<unsigned>(new unsigned[nnz_h_lag]);  
     _h_jCol = shared_array<unsigned>(new unsigned[nnz_h_lag]);
     for (unsigned i=0, k=0; i< n; i++)
@@ -154,7 +250,7 @@ bool NQP_IPOPT::get_nlp_info(Index& n, Index& m, Index& nnz_jac_g, Index& nnz_h_
       t1 += t2;
 
       // copy the constraint Hessian
-      _h_con[i] = shared_array<double>(new double[n*(n-1)]);
+      _h_con[i] = AlignedSlabPool::pool("NQP_IPOPT").acquire(n*(n-1));
       for (unsigned i=0, k=0; i< t1.rows(); i++)
         for (unsigned j=i; j< t1.columns(); j++, k++)
           _h_con[i][k] = t1(i,j);
@@ -196,7 +292,7 @@ bool NQP_IPOPT::get_nlp_info(Index& n, Index& m, Index& nnz_jac_g, Index& nnz_h_
   nnz_jac_g = _cJac_constant + ((!_dense) ? N_ACT_CONTACTS*3 : N_ACT_CONTACTS*n);
 
   // setup constant Jacobian values
-  _cJac = shared_array<double>(new double[_cJac_constant]);
+  _cJac = AlignedSlabPool::pool("NQP_IPOPT").acquire(_cJac_constant);
   _cJac_iRow = shared_array<unsigned>(new unsigned[nnz_jac_g]);
   _cJac_jCol = shared_array<unsigned>(new unsigned[nnz_jac_g]);
   unsigned nv = 0;
@@ -304,6 +400,12 @@ bool NQP_IPOPT::get_nlp_info(Index& n, Index& m, Index& nnz_jac_g, Index& nnz_h_
   // C-indexing style
   index_style = TNLP::C_STYLE;
 
+  // record the dimensions the structures above were computed for
+  _struct_n = n;
+  _struct_m = m;
+  _struct_dense = _dense;
+  _struct_valid = true;
+
   return true;
 }
 
@@ -343,14 +445,42 @@ bool NQP_IPOPT::get_bounds_info(Index n, Number* x_l, Number* x_u, Index m, Numb
 /// User should not call this method (for IPOPT)
 bool NQP_IPOPT::get_starting_point(Index n, bool init_x, Number* x, bool init_z, Number* z_L, Number* z_U, Index m, bool init_lambda, Number* lam)
 {
+  // serve the iterates saved from the previous solve when they match the
+  // problem dimensions (i.e., the contact set has persisted)
+  const bool WARM = (_warm_start_ready && _x_last.size() == (unsigned) n &&
+                     _lambda_last.size() == (unsigned) m);
+
   if (init_x)
-    std::fill_n(x, n, 0.0);
+  {
+    if (WARM)
+      std::copy(_x_last.begin(), _x_last.end(), x);
+    else
+      std::fill_n(x, n, 0.0);
+  }
 
   if (init_z)
-    return false;
+  {
+    if (WARM)
+    {
+      std::copy(_zL_last.begin(), _zL_last.end(), z_L);
+      std::copy(_zU_last.begin(), _zU_last.end(), z_U);
+    }
+    else
+    {
+      // no saved duals (or stale dimensions): mimic IPOPT's cold start,
+      // which initializes the bound multipliers to bound_mult_init_val
+      std::fill_n(z_L, n, 1.0);
+      std::fill_n(z_U, n, 1.0);
+    }
+  }
 
   if (init_lambda)
-    std::fill_n(lam, m, 0.0);
+  {
+    if (WARM)
+      std::copy(_lambda_last.begin(), _lambda_last.end(), lam);
+    else
+      std::fill_n(lam, m, 0.0);
+  }
 
   return true;
 }
@@ -486,7 +616,7 @@ bool NQP_IPOPT::eval_jac_g(Index n, const Number* x, bool new_x, Index m, Index
 }
 
 // sets the final solution 
-void NQP_IPOPT::finalize_solution(SolverReturn status, Index n, const Number* x, const Number* z_L, const Number* z_U, Index, const Number* g, const Number* lam, Number obj_value, const IpoptData* ip_data, IpoptCalculatedQuantities* ipcq)
+void NQP_IPOPT::finalize_solution(SolverReturn status, Index n, const Number* x, const Number* z_L, const Number* z_U, Index m, const Number* g, const Number* lam, Number obj_value, const IpoptData* ip_data, IpoptCalculatedQuantities* ipcq)
 {
   // copy x
   _x.resize(n);
@@ -500,6 +630,24 @@ void NQP_IPOPT::finalize_solution(SolverReturn status, Index n, const Number* x,
   }
   else
     z = _x;
+
+  // record solver telemetry (no pivots, regularization or condition
+  // estimate for interior-point solves; the residual is unknown here)
+  const bool solved = (status == Ipopt::SUCCESS || status == Ipopt::STOP_AT_ACCEPTABLE_POINT);
+  stats.record(0, 0.0, -1.0, -1.0, solved);
+
+  // save the primal and dual iterates for warm starting the next solve
+  // over the same contact set (see get_starting_point()); iterates from a
+  // failed solve are not trustworthy starting points
+  _x_last.resize(n);
+  std::copy(x, x+n, _x_last.begin());
+  _zL_last.resize(n);
+  std::copy(z_L, z_L+n, _zL_last.begin());
+  _zU_last.resize(n);
+  std::copy(z_U, z_U+n, _zU_last.begin());
+  _lambda_last.resize(m);
+  std::copy(lam, lam+m, _lambda_last.begin());
+  _warm_start_ready = solved;
 }
 
 /// The Hessian
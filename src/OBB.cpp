@@ -378,170 +378,179 @@ double OBB::calc_dist(const OBB& a, const OBB& b, const Transform3d& aTb, Point3
   return calc_dist(a, bcopy, cpa, cpb);
 }
 
-/// Determines whether two OBBs intersect
+/// The separating-axis kernel behind the OBB::intersects() overloads
 /**
- * \param aTb the relative transform from b to a
+ * Code adapted from [Ericson, 2005].  Operates on flat scalar arrays-- the
+ * rotation of b in a's frame, the translation of b's center in a's frame and
+ * the two half-extent triples-- so the working set stays in registers and the
+ * absolute rotation matrix is computed exactly once per test.  Callers are
+ * responsible for composing any traversal transform into R and t.
  */
-bool OBB::intersects(const OBB& a, const OBB& b, const Transform3d& aTb)
-{
-  // copy b
-  OBB bcopy(b);
-
-  // transform the center and orientation of b
-  bcopy.center = aTb.transform_point(b.center);
-  Matrix3d R = aTb.q;
-  bcopy.R = R * b.R;
-
-  // perform the intersection
-  return intersects(a, bcopy);
-}
-
-/// Determines whether two OBBs intersect another
-/**
- * Code adapted from [Ericson, 2005]
- */
-bool OBB::intersects(const OBB& a, const OBB& b)
+static bool obb_sat_test(const double R[3][3], const double t[3], const double la[3], const double lb[3])
 {
   const unsigned THREE_D = 3, X = 0, Y = 1, Z = 2;
-  enum Dims { eDim0 = 0, eDim1 = 1, eDim2 = 2 };
   double ra, rb;
 
-  FILE_LOG(LOG_BV) << "checking OBBs for intersection" << endl;
-  FILE_LOG(LOG_BV) << " OBB 1: " << endl << a;
-  FILE_LOG(LOG_BV) << " OBB 2: " << endl << b;
-
-  // verify that both OBB's are defined relative to the same frame
-  assert(a.get_relative_pose() == b.get_relative_pose());
-  shared_ptr<const Pose3d> P = a.get_relative_pose();
-
-  // transpose of A's matrix will convert to A's coordinate frame
-  // Compute rotation matrix expressing b in a's coordinate frame
-  const Matrix3d Rab = a.R.transpose_mult(b.R);
-  
-  // compute translation vector t in coordinate frame of a
-  Vector3d t(a.R.transpose_mult(Origin3d(b.center - a.center)), P);
-
   // compute common subexpressions; add in an epsilon term to counteract
   // arithmetic errors when two edges are parallel and their cross product
   // is near zero
-  Matrix3d abs_Rab = Rab;
+  double aR[3][3];
   for (unsigned i=0; i< THREE_D; i++)
     for (unsigned j=0; j< THREE_D; j++)
-      abs_Rab(i,j) = std::fabs(Rab(i,j)) + NEAR_ZERO;
+      aR[i][j] = std::fabs(R[i][j]) + NEAR_ZERO;
 
   // test axes L = A0, L = A1, L = A2
   for (unsigned i=0; i< THREE_D; i++)
   {
-    ra = a.l[i];
-    rb = b.l[eDim0] * abs_Rab(i,0) + b.l[eDim1]*abs_Rab(i,1) + b.l[eDim2]*abs_Rab(i,2);
+    ra = la[i];
+    rb = lb[X]*aR[i][X] + lb[Y]*aR[i][Y] + lb[Z]*aR[i][Z];
     if (std::fabs(t[i]) > ra + rb)
-    {
-      FILE_LOG(LOG_BV) << "OBBs do not intersect" << endl;
       return false;
-    }
   }
 
   // test axes L = B0, L = B1, L = B2
-  Vector3d Rab_col(t.pose);
   for (unsigned i=0; i< THREE_D; i++)
   {
-    ra = a.l[eDim0] * abs_Rab(0,i) + a.l[eDim1]*abs_Rab(1,i) + a.l[eDim2]*abs_Rab(2,i);
-    rb = b.l[i];
-    Rab.get_column(i, Rab_col);
-    if (std::fabs(Vector3d::dot(t, Rab_col)) > ra + rb)
-    {
-      FILE_LOG(LOG_BV) << "OBBs do not intersect" << endl;
+    ra = la[X]*aR[X][i] + la[Y]*aR[Y][i] + la[Z]*aR[Z][i];
+    rb = lb[i];
+    if (std::fabs(t[X]*R[X][i] + t[Y]*R[Y][i] + t[Z]*R[Z][i]) > ra + rb)
       return false;
-    }
   }
-  
+
   // test axis L = A0 x B0
-  ra = a.l[eDim1] * abs_Rab(Z,X) + a.l[eDim2] * abs_Rab(Y,X);
-  rb = b.l[eDim1] * abs_Rab(X,Z) + b.l[eDim2] * abs_Rab(X,Y);
-  if (std::fabs(t[Z]*Rab(Y,X) - t[Y]*Rab(Z,X)) > ra + rb)
-  {
-    FILE_LOG(LOG_BV) << "OBBs do not intersect" << endl;
+  ra = la[Y]*aR[Z][X] + la[Z]*aR[Y][X];
+  rb = lb[Y]*aR[X][Z] + lb[Z]*aR[X][Y];
+  if (std::fabs(t[Z]*R[Y][X] - t[Y]*R[Z][X]) > ra + rb)
     return false;
-  }
 
   // test axis L = A0 x B1
-  ra = a.l[eDim1] * abs_Rab(Z,Y) + a.l[eDim2] * abs_Rab(Y,Y);
-  rb = b.l[eDim0] * abs_Rab(X,Z) + b.l[eDim2] * abs_Rab(X,X);
-  if (std::fabs(t[Z]*Rab(Y,Y) - t[Y]*Rab(Z,Y)) > ra + rb)
-  {
-    FILE_LOG(LOG_BV) << "OBBs do not intersect" << endl;
+  ra = la[Y]*aR[Z][Y] + la[Z]*aR[Y][Y];
+  rb = lb[X]*aR[X][Z] + lb[Z]*aR[X][X];
+  if (std::fabs(t[Z]*R[Y][Y] - t[Y]*R[Z][Y]) > ra + rb)
     return false;
-  }
 
   // test axis L = A0 x B2
-  ra = a.l[eDim1] * abs_Rab(Z,Z) + a.l[eDim2] * abs_Rab(Y,Z);
-  rb = b.l[eDim0] * abs_Rab(X,Y) + b.l[eDim1] * abs_Rab(X,X);
-  if (std::fabs(t[Z]*Rab(Y,Z) - t[Y]*Rab(Z,Z)) > ra + rb)
-  {
-    FILE_LOG(LOG_BV) << "OBBs do not intersect" << endl;
+  ra = la[Y]*aR[Z][Z] + la[Z]*aR[Y][Z];
+  rb = lb[X]*aR[X][Y] + lb[Y]*aR[X][X];
+  if (std::fabs(t[Z]*R[Y][Z] - t[Y]*R[Z][Z]) > ra + rb)
     return false;
-  }
 
   // test axis L = A1 x B0
-  ra = a.l[eDim0] * abs_Rab(Z,X) + a.l[eDim2] * abs_Rab(X,X);
-  rb = b.l[eDim1] * abs_Rab(Y,Z) + b.l[eDim2] * abs_Rab(Y,Y);
-  if (std::fabs(t[X]*Rab(Z,X) - t[Z]*Rab(X,X)) > ra + rb)
-  {
-    FILE_LOG(LOG_BV) << "OBBs do not intersect" << endl;
+  ra = la[X]*aR[Z][X] + la[Z]*aR[X][X];
+  rb = lb[Y]*aR[Y][Z] + lb[Z]*aR[Y][Y];
+  if (std::fabs(t[X]*R[Z][X] - t[Z]*R[X][X]) > ra + rb)
     return false;
-  }
 
   // test axis L = A1 x B1
-  ra = a.l[eDim0] * abs_Rab(Z,Y) + a.l[eDim2] * abs_Rab(X,Y);
-  rb = b.l[eDim0] * abs_Rab(Y,Z) + b.l[eDim2] * abs_Rab(Y,X);
-  if (std::fabs(t[X]*Rab(Z,Y) - t[Z]*Rab(X,Y)) > ra + rb)
-  {
-    FILE_LOG(LOG_BV) << "OBBs do not intersect" << endl;
+  ra = la[X]*aR[Z][Y] + la[Z]*aR[X][Y];
+  rb = lb[X]*aR[Y][Z] + lb[Z]*aR[Y][X];
+  if (std::fabs(t[X]*R[Z][Y] - t[Z]*R[X][Y]) > ra + rb)
     return false;
-  }
 
   // test axis L = A1 x B2
-  ra = a.l[eDim0] * abs_Rab(Z,Z) + a.l[eDim2] * abs_Rab(X,Z);
-  rb = b.l[eDim0] * abs_Rab(Y,Y) + b.l[eDim1] * abs_Rab(Y,X);
-  if (std::fabs(t[X]*Rab(Z,Z) - t[Z]*Rab(X,Z)) > ra + rb)
-  {
-    FILE_LOG(LOG_BV) << "OBBs do not intersect" << endl;
+  ra = la[X]*aR[Z][Z] + la[Z]*aR[X][Z];
+  rb = lb[X]*aR[Y][Y] + lb[Y]*aR[Y][X];
+  if (std::fabs(t[X]*R[Z][Z] - t[Z]*R[X][Z]) > ra + rb)
     return false;
-  }
 
   // test axis L = A2 x B0
-  ra = a.l[eDim0] * abs_Rab(Y,X) + a.l[eDim1] * abs_Rab(X,X);
-  rb = b.l[eDim1] * abs_Rab(Z,Z) + b.l[eDim2] * abs_Rab(Z,Y);
-  if (std::fabs(t[Y]*Rab(X,X) - t[X]*Rab(Y,X)) > ra + rb)
-  {
-    FILE_LOG(LOG_BV) << "OBBs do not intersect" << endl;
+  ra = la[X]*aR[Y][X] + la[Y]*aR[X][X];
+  rb = lb[Y]*aR[Z][Z] + lb[Z]*aR[Z][Y];
+  if (std::fabs(t[Y]*R[X][X] - t[X]*R[Y][X]) > ra + rb)
     return false;
-  }
 
   // test axis L = A2 x B1
-  ra = a.l[eDim0] * abs_Rab(Y,Y) + a.l[eDim1] * abs_Rab(X,Y);
-  rb = b.l[eDim0] * abs_Rab(Z,Z) + b.l[eDim2] * abs_Rab(Z,X);
-  if (std::fabs(t[Y]*Rab(X,Y) - t[X]*Rab(Y,Y)) > ra + rb)
-  {
-    FILE_LOG(LOG_BV) << "OBBs do not intersect" << endl;
+  ra = la[X]*aR[Y][Y] + la[Y]*aR[X][Y];
+  rb = lb[X]*aR[Z][Z] + lb[Z]*aR[Z][X];
+  if (std::fabs(t[Y]*R[X][Y] - t[X]*R[Y][Y]) > ra + rb)
     return false;
-  }
 
   // test axis L = A2 x B2
-  ra = a.l[eDim0] * abs_Rab(Y,Z) + a.l[eDim1] * abs_Rab(X,Z);
-  rb = b.l[eDim0] * abs_Rab(Z,Y) + b.l[eDim1] * abs_Rab(Z,X);
-  if (std::fabs(t[Y]*Rab(X,Z) - t[X]*Rab(Y,Z)) > ra + rb)
-  {
-    FILE_LOG(LOG_BV) << "OBBs do not intersect" << endl;
+  ra = la[X]*aR[Y][Z] + la[Y]*aR[X][Z];
+  rb = lb[X]*aR[Z][Y] + lb[Y]*aR[Z][X];
+  if (std::fabs(t[Y]*R[X][Z] - t[X]*R[Y][Z]) > ra + rb)
     return false;
-  }
-
-  FILE_LOG(LOG_BV) << "OBBs intersect" << endl;
 
   // since no separating axis is found, OBBs must be intersecting
   return true;
 }
 
+/// Determines whether two OBBs intersect
+/**
+ * \param aTb the relative transform from b to a
+ *
+ * The traversal transform is folded directly into the kernel inputs rather
+ * than instantiating a transformed copy of b (which would copy the node's
+ * child list on every tree-vs-tree test).
+ */
+bool OBB::intersects(const OBB& a, const OBB& b, const Transform3d& aTb)
+{
+  const unsigned THREE_D = 3;
+
+  // compute the rotation of b in a's frame: a.R' * (aRb * b.R)
+  const Matrix3d aRb = aTb.q;
+  const Matrix3d Rab = a.R.transpose_mult(aRb * b.R);
+
+  // compute the translation of b's center in a's frame
+  const Point3d bc_a = aTb.transform_point(b.center);
+  const Origin3d t = a.R.transpose_mult(Origin3d(bc_a - a.center));
+
+  // pack the kernel inputs
+  double R[3][3], tt[3], la[3], lb[3];
+  for (unsigned i=0; i< THREE_D; i++)
+  {
+    for (unsigned j=0; j< THREE_D; j++)
+      R[i][j] = Rab(i,j);
+    tt[i] = t[i];
+    la[i] = a.l[i];
+    lb[i] = b.l[i];
+  }
+
+  // perform the intersection
+  bool isect = obb_sat_test(R, tt, la, lb);
+  FILE_LOG(LOG_BV) << "OBBs " << (isect ? "intersect" : "do not intersect") << endl;
+  return isect;
+}
+
+/// Determines whether two OBBs intersect another
+/**
+ * Code adapted from [Ericson, 2005]
+ */
+bool OBB::intersects(const OBB& a, const OBB& b)
+{
+  const unsigned THREE_D = 3;
+
+  FILE_LOG(LOG_BV) << "checking OBBs for intersection" << endl;
+  FILE_LOG(LOG_BV) << " OBB 1: " << endl << a;
+  FILE_LOG(LOG_BV) << " OBB 2: " << endl << b;
+
+  // verify that both OBB's are defined relative to the same frame
+  assert(a.get_relative_pose() == b.get_relative_pose());
+
+  // transpose of A's matrix will convert to A's coordinate frame
+  // Compute rotation matrix expressing b in a's coordinate frame
+  const Matrix3d Rab = a.R.transpose_mult(b.R);
+
+  // compute translation vector t in coordinate frame of a
+  const Origin3d t = a.R.transpose_mult(Origin3d(b.center - a.center));
+
+  // pack the kernel inputs
+  double R[3][3], tt[3], la[3], lb[3];
+  for (unsigned i=0; i< THREE_D; i++)
+  {
+    for (unsigned j=0; j< THREE_D; j++)
+      R[i][j] = Rab(i,j);
+    tt[i] = t[i];
+    la[i] = a.l[i];
+    lb[i] = b.l[i];
+  }
+
+  // perform the intersection
+  bool isect = obb_sat_test(R, tt, la, lb);
+  FILE_LOG(LOG_BV) << "OBBs " << (isect ? "intersect" : "do not intersect") << endl;
+  return isect;
+}
+
 /// Outputs the OBB in VRML format to the given stream
 std::ostream& OBB::to_vrml(std::ostream& out, const Pose3d& T) const
 {
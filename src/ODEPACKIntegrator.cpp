@@ -35,7 +35,10 @@ static VectorNd& (*fn_VectorNd)(const VectorNd&, double, double, void*, VectorNd
 
 static void fdouble_VectorNd(int* neq, double* t, double* y, double* ydot)
 {
-  static VectorNd x, xdot;
+  // locals rather than statics: the trampoline itself is then reentrant
+  // (concurrent dlsode_ calls are still excluded by the caller's mutex,
+  // as LSODE keeps its internal state in Fortran COMMON blocks)
+  VectorNd x, xdot;
   x.resize(*neq);
   std::copy(y, y+*neq, x.data());
   (*fn_VectorNd)(x, *t, tnew - *t, fn_data, xdot);
@@ -6,6 +6,7 @@
 
 #include <cstring>
 #include <iostream>
+#include <map>
 #ifdef USE_OSG
 #include <osgDB/ReadFile>
 #include <osgDB/WriteFile>
@@ -28,6 +29,70 @@ OSGGroupWrapper::OSGGroupWrapper()
   #endif
 }
 
+#ifdef USE_OSG
+/// Copies a pose to an OpenSceneGraph Matrixd object
+static void to_osg_matrix(const Pose3d& src, osg::Matrixd& tgt)
+{
+  // get the rotation matrix
+  Matrix3d M = src.q;
+
+  // setup the rotation components of tgt
+  const unsigned X = 0, Y = 1, Z = 2, W = 3;
+  for (unsigned i=X; i<= Z; i++)
+    for (unsigned j=X; j<= Z; j++)
+      tgt(j,i) = M(i,j);
+
+  // setup the translation components of tgt
+  for (unsigned i=X; i<= Z; i++)
+    tgt(W,i) = src.x[i];
+
+  // set constant values of the matrix
+  tgt(X,W) = tgt(Y,W) = tgt(Z,W) = (double) 0.0;
+  tgt(W,W) = (double) 1.0;
+}
+
+// flyweight cache of loaded visualization subtrees, keyed by filename; each
+// wrapper gets its own transform node, but OSG nodes may have multiple
+// parents, so thousands of bodies sharing one model file share a single
+// subtree (one GPU upload) rather than loading a copy apiece
+static std::map<std::string, osg::Node*> _subtree_cache;
+
+/// Reads a node file through the flyweight cache
+static osg::Node* read_node_file_shared(const std::string& fname)
+{
+  std::map<std::string, osg::Node*>::const_iterator i = _subtree_cache.find(fname);
+  if (i != _subtree_cache.end())
+    return i->second;
+
+  // not yet loaded; read it and retain a reference for the process lifetime
+  osg::Node* node = osgDB::readNodeFile(fname);
+  if (node)
+  {
+    node->ref();
+    _subtree_cache[fname] = node;
+  }
+
+  return node;
+}
+#endif
+
+/// Sets the transform of the wrapped group from a pose
+/**
+ * The pose must be defined relative to the global frame. This is the
+ * application half of the double-buffered visualization update: poses
+ * captured on the stepping thread (Visualizable::snapshot_visualization())
+ * are applied to the scene graph here, on the render thread.
+ */
+void OSGGroupWrapper::update_transform(const Ravelin::Pose3d& P)
+{
+  #ifdef USE_OSG
+  assert(!P.rpose);
+  osg::Matrixd m;
+  to_osg_matrix(P, m);
+  ((osg::MatrixTransform*) _group)->setMatrix(m);
+  #endif
+}
+
 OSGGroupWrapper::OSGGroupWrapper(osg::Node* n)
 {
   #ifdef USE_OSG
@@ -37,12 +102,17 @@ OSGGroupWrapper::OSGGroupWrapper(osg::Node* n)
   #endif
 }
 
-/// Creates an OSGGroup wrapper given a filename 
+/// Creates an OSGGroup wrapper given a filename
 OSGGroupWrapper::OSGGroupWrapper(const std::string& fname)
 {
   #ifdef USE_OSG
-  // open the filename and read in the file
-  osg::Node* node = osgDB::readNodeFile(fname);
+  // the loaded subtree may be shared with other wrappers reading the same
+  // file, so this instance's own transform node always sits above it
+  _group = new osg::MatrixTransform;
+  _group->ref();
+
+  // open the filename and read in the file (shared if already loaded)
+  osg::Node* node = read_node_file_shared(fname);
   if (!node)
   {
     std::cerr << "OSGGroupWrapper::OSGGroupWrapper() - unable to read ";
@@ -50,16 +120,8 @@ OSGGroupWrapper::OSGGroupWrapper(const std::string& fname)
     return;
   }
 
-  // process the node 
-  osg::Group* group = dynamic_cast<osg::Group*>(node);
-  if (!group)
-  {
-    _group = new osg::Group;
-    _group->addChild(node);
-  }
-  else
-    _group = group;
-  _group->ref();
+  // add the shared subtree under the transform
+  _group->addChild(node);
   #endif
 }
 
@@ -70,29 +132,6 @@ OSGGroupWrapper::~OSGGroupWrapper()
   #endif
 }
 
-#ifdef USE_OSG
-/// Copies this matrix to an OpenSceneGraph Matrixd object
-static void to_osg_matrix(const Pose3d& src, osg::Matrixd& tgt)
-{
-  // get the rotation matrix
-  Matrix3d M = src.q;
-
-  // setup the rotation components of tgt
-  const unsigned X = 0, Y = 1, Z = 2, W = 3;
-  for (unsigned i=X; i<= Z; i++)
-    for (unsigned j=X; j<= Z; j++)
-      tgt(j,i) = M(i,j);
-
-  // setup the translation components of tgt
-  for (unsigned i=X; i<= Z; i++)
-    tgt(W,i) = src.x[i];
-
-  // set constant values of the matrix
-  tgt(X,W) = tgt(Y,W) = tgt(Z,W) = (double) 0.0;
-  tgt(W,W) = (double) 1.0;
-}
-#endif
-
 /// Implements Base::load_from_xml()
 void OSGGroupWrapper::load_from_xml(shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map)
 {
@@ -110,9 +149,9 @@ void OSGGroupWrapper::load_from_xml(shared_ptr<const XMLTree> node, std::map<std
   // get the filename
   const std::string& fname = viz_fname_attr->get_string_value();
 
-  // open the filename and read in the file
+  // open the filename and read in the file (shared if already loaded)
   #ifdef USE_OSG
-  osg::Node* osgnode = osgDB::readNodeFile(fname);
+  osg::Node* osgnode = read_node_file_shared(fname);
   if (!osgnode)
   {
     std::cerr << "OSGGroupWrapper::load_from_xml() - unable to read from ";
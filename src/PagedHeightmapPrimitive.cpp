@@ -0,0 +1,253 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <algorithm>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <Moby/Constants.h>
+#include <Moby/XMLTree.h>
+#include <Moby/PagedHeightmapPrimitive.h>
+
+using namespace Ravelin;
+using namespace Moby;
+using boost::shared_ptr;
+
+/// Initializes the paged heightmap primitive
+PagedHeightmapPrimitive::PagedHeightmapPrimitive()
+{
+  _fd = -1;
+  _mapping = NULL;
+  _mapping_len = 0;
+  _samples = NULL;
+  _rows = _columns = 0;
+  _min_height = _max_height = 0.0;
+  _tile_size = 256;
+  _tiles_per_row = 0;
+  _max_resident = 64;
+}
+
+/// Initializes the paged heightmap primitive
+PagedHeightmapPrimitive::PagedHeightmapPrimitive(const Ravelin::Pose3d& T) : HeightmapPrimitive(T)
+{
+  _fd = -1;
+  _mapping = NULL;
+  _mapping_len = 0;
+  _samples = NULL;
+  _rows = _columns = 0;
+  _min_height = _max_height = 0.0;
+  _tile_size = 256;
+  _tiles_per_row = 0;
+  _max_resident = 64;
+}
+
+PagedHeightmapPrimitive::~PagedHeightmapPrimitive()
+{
+  close_height_file();
+}
+
+/// Gets one height sample, paging its tile in (and possibly another out)
+double PagedHeightmapPrimitive::height(unsigned i, unsigned j) const
+{
+  assert(_samples && i < _rows && j < _columns);
+  touch_tile(i/_tile_size, j/_tile_size);
+  return _samples[(std::size_t) i*_columns + j];
+}
+
+/// Marks a tile as most recently used, evicting the least recently used tile if the cache is full
+void PagedHeightmapPrimitive::touch_tile(unsigned ti, unsigned tj) const
+{
+  const unsigned tile = ti*_tiles_per_row + tj;
+
+  // if the tile is already resident, move it to the front of the LRU list
+  std::map<unsigned, std::list<unsigned>::iterator>::iterator ri = _resident.find(tile);
+  if (ri != _resident.end())
+  {
+    if (ri->second != _lru.begin())
+    {
+      _lru.erase(ri->second);
+      _lru.push_front(tile);
+      ri->second = _lru.begin();
+    }
+    return;
+  }
+
+  // the tile is not resident; reads through the mapping will fault its
+  // pages in on demand, so only the cache bookkeeping is done here, after
+  // returning least recently used tiles to the OS to respect the limit
+  while (_lru.size() >= _max_resident)
+  {
+    release_tile(_lru.back());
+    _resident.erase(_lru.back());
+    _lru.pop_back();
+  }
+  _lru.push_front(tile);
+  _resident[tile] = _lru.begin();
+}
+
+/// Returns a tile's pages to the operating system
+void PagedHeightmapPrimitive::release_tile(unsigned tile) const
+{
+  const unsigned ti = tile / _tiles_per_row;
+  const unsigned tj = tile % _tiles_per_row;
+  const unsigned i0 = ti*_tile_size;
+  const unsigned i1 = std::min(i0+_tile_size, _rows);
+  const unsigned j0 = tj*_tile_size;
+  const unsigned j1 = std::min(j0+_tile_size, _columns);
+  const std::size_t PAGE = (std::size_t) sysconf(_SC_PAGESIZE);
+
+  // release each row segment of the tile; madvise() requires page
+  // alignment, so each segment is shrunk to whole pages (partial pages are
+  // shared with neighboring tiles and simply stay resident)
+  for (unsigned i=i0; i< i1; i++)
+  {
+    std::size_t lo = (std::size_t) (_samples + (std::size_t) i*_columns + j0);
+    std::size_t hi = (std::size_t) (_samples + (std::size_t) i*_columns + j1);
+    lo = (lo + PAGE-1)/PAGE*PAGE;
+    hi = hi/PAGE*PAGE;
+    if (lo < hi)
+      madvise((void*) lo, hi - lo, MADV_DONTNEED);
+  }
+}
+
+/// Memory-maps the backing height file
+void PagedHeightmapPrimitive::open_height_file(const std::string& fname)
+{
+  // release any currently mapped file
+  close_height_file();
+
+  // open the file
+  _fd = open(fname.c_str(), O_RDONLY);
+  if (_fd < 0)
+  {
+    std::cerr << "PagedHeightmapPrimitive::open_height_file() - unable to open " << fname << std::endl;
+    return;
+  }
+
+  // read the header: rows, columns (32-bit unsigned), min and max height
+  unsigned rc[2];
+  double mm[2];
+  if (read(_fd, rc, sizeof(rc)) != (ssize_t) sizeof(rc) ||
+      read(_fd, mm, sizeof(mm)) != (ssize_t) sizeof(mm))
+  {
+    std::cerr << "PagedHeightmapPrimitive::open_height_file() - unable to read header from " << fname << std::endl;
+    close(_fd);
+    _fd = -1;
+    return;
+  }
+
+  // verify that the file holds the full grid
+  const std::size_t HEADER = sizeof(rc) + sizeof(mm);
+  const std::size_t DATA = (std::size_t) rc[0] * rc[1] * sizeof(double);
+  struct stat sb;
+  if (fstat(_fd, &sb) != 0 || (std::size_t) sb.st_size < HEADER + DATA)
+  {
+    std::cerr << "PagedHeightmapPrimitive::open_height_file() - " << fname << " is truncated" << std::endl;
+    close(_fd);
+    _fd = -1;
+    return;
+  }
+
+  // map the file; pages fault in on first access and are dropped again
+  // when their tile leaves the LRU cache
+  _mapping_len = HEADER + DATA;
+  _mapping = mmap(NULL, _mapping_len, PROT_READ, MAP_PRIVATE, _fd, 0);
+  if (_mapping == MAP_FAILED)
+  {
+    std::cerr << "PagedHeightmapPrimitive::open_height_file() - unable to map " << fname << std::endl;
+    _mapping = NULL;
+    _mapping_len = 0;
+    close(_fd);
+    _fd = -1;
+    return;
+  }
+
+  // setup the grid parameters
+  _fname = fname;
+  _rows = rc[0];
+  _columns = rc[1];
+  _min_height = mm[0];
+  _max_height = mm[1];
+  _samples = (const double*) ((const char*) _mapping + HEADER);
+  _tiles_per_row = (_columns + _tile_size - 1)/_tile_size;
+
+  // advise the OS that access is localized around active bodies
+  madvise(_mapping, _mapping_len, MADV_RANDOM);
+}
+
+/// Unmaps the backing height file
+void PagedHeightmapPrimitive::close_height_file()
+{
+  if (_mapping)
+    munmap(_mapping, _mapping_len);
+  if (_fd >= 0)
+    close(_fd);
+  _fd = -1;
+  _mapping = NULL;
+  _mapping_len = 0;
+  _samples = NULL;
+  _lru.clear();
+  _resident.clear();
+}
+
+/// Implements Base::load_from_xml() for serialization
+void PagedHeightmapPrimitive::load_from_xml(shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map)
+{
+  // verify that the node type is a paged heightmap
+  assert(strcasecmp(node->name.c_str(), "PagedHeightmap") == 0);
+
+  // load the primitive data (the in-core heightmap loader is deliberately
+  // bypassed; the grid stays on disk)
+  Primitive::load_from_xml(node, id_map);
+
+  // read in the tile edge length, if specified
+  XMLAttrib* tile_attr = node->get_attrib("tile-size");
+  if (tile_attr)
+    _tile_size = tile_attr->get_unsigned_value();
+
+  // read in the residency limit, if specified
+  XMLAttrib* resident_attr = node->get_attrib("max-resident-tiles");
+  if (resident_attr)
+    _max_resident = resident_attr->get_unsigned_value();
+
+  // map the height file
+  XMLAttrib* file_attr = node->get_attrib("filename");
+  if (file_attr)
+    open_height_file(file_attr->get_string_value());
+
+  // the cached bilinear patch no longer corresponds to the height data
+  _patch_valid = false;
+
+  // read in the width, if specified
+  XMLAttrib* width_attr = node->get_attrib("width");
+  if (width_attr)
+    _width = width_attr->get_real_value();
+
+  // read in the depth, if specified
+  XMLAttrib* depth_attr = node->get_attrib("depth");
+  if (depth_attr)
+    _depth = depth_attr->get_real_value();
+}
+
+/// Implements Base::save_to_xml() for serialization
+void PagedHeightmapPrimitive::save_to_xml(XMLTreePtr node, std::list<shared_ptr<const Base> >& shared_objects) const
+{
+  // save the primitive data
+  Primitive::save_to_xml(node, shared_objects);
+
+  // (re)set the node name
+  node->name = "PagedHeightmap";
+
+  // save the geometry and paging parameters; the height data itself
+  // already lives in the backing file
+  node->attribs.insert(XMLAttrib("width", _width));
+  node->attribs.insert(XMLAttrib("depth", _depth));
+  node->attribs.insert(XMLAttrib("tile-size", _tile_size));
+  node->attribs.insert(XMLAttrib("max-resident-tiles", _max_resident));
+  node->attribs.insert(XMLAttrib("filename", _fname));
+}
@@ -0,0 +1,252 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <Moby/Primitive.h>
+#include <Moby/BoxPrimitive.h>
+#include <Moby/SpherePrimitive.h>
+#include <Moby/PlanePrimitive.h>
+#include <Moby/CylinderPrimitive.h>
+#include <Moby/CapsulePrimitive.h>
+#include <Moby/PolyhedralPrimitive.h>
+#include <Moby/HeightmapPrimitive.h>
+#include <Moby/TorusPrimitive.h>
+#include <Moby/ConePrimitive.h>
+#include <Moby/PairwiseDistDispatch.h>
+
+using namespace Moby;
+using boost::shared_ptr;
+using boost::static_pointer_cast;
+
+// NOTE on kernel semantics: each kernel below performs exactly the call that
+// the virtual calc_signed_dist() chain of the first primitive type would
+// eventually make for the second type (including the argument swap when the
+// specialized method lives on the second primitive), so table hits and table
+// misses compute identical results.
+
+/// Kernel for sphere/sphere
+static double sphere_sphere_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return static_pointer_cast<const SpherePrimitive>(pA)->calc_signed_dist(static_pointer_cast<const SpherePrimitive>(pB), pa, pb);
+}
+
+/// Kernel for box/sphere
+static double box_sphere_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return static_pointer_cast<const BoxPrimitive>(pA)->calc_signed_dist(static_pointer_cast<const SpherePrimitive>(pB), pa, pb);
+}
+
+/// Kernel for sphere/box
+static double sphere_box_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return box_sphere_dist(pB, pA, pb, pa);
+}
+
+/// Kernel for plane/sphere
+static double plane_sphere_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return static_pointer_cast<const PlanePrimitive>(pA)->calc_signed_dist(static_pointer_cast<const SpherePrimitive>(pB), pa, pb);
+}
+
+/// Kernel for sphere/plane
+static double sphere_plane_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return plane_sphere_dist(pB, pA, pb, pa);
+}
+
+/// Kernel for plane/cylinder
+static double plane_cylinder_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return static_pointer_cast<const PlanePrimitive>(pA)->calc_signed_dist(static_pointer_cast<const CylinderPrimitive>(pB), pa, pb);
+}
+
+/// Kernel for cylinder/plane
+static double cylinder_plane_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return plane_cylinder_dist(pB, pA, pb, pa);
+}
+
+/// Kernel for plane/polyhedron (covers boxes, which are polyhedral)
+static double plane_poly_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return static_pointer_cast<const PlanePrimitive>(pA)->calc_signed_dist(static_pointer_cast<const PolyhedralPrimitive>(pB), pa, pb);
+}
+
+/// Kernel for polyhedron/plane
+static double poly_plane_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return plane_poly_dist(pB, pA, pb, pa);
+}
+
+/// Kernel for heightmap/sphere
+static double heightmap_sphere_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return static_pointer_cast<const HeightmapPrimitive>(pA)->calc_signed_dist(static_pointer_cast<const SpherePrimitive>(pB), pa, pb);
+}
+
+/// Kernel for sphere/heightmap
+static double sphere_heightmap_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return heightmap_sphere_dist(pB, pA, pb, pa);
+}
+
+/// Kernel for torus/plane
+static double torus_plane_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return static_pointer_cast<const TorusPrimitive>(pA)->calc_signed_dist(static_pointer_cast<const PlanePrimitive>(pB), pa, pb);
+}
+
+/// Kernel for plane/torus
+static double plane_torus_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return torus_plane_dist(pB, pA, pb, pa);
+}
+
+/// Kernel for torus/cylinder
+static double torus_cylinder_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return static_pointer_cast<const TorusPrimitive>(pA)->calc_signed_dist(static_pointer_cast<const CylinderPrimitive>(pB), pa, pb);
+}
+
+/// Kernel for cylinder/torus
+static double cylinder_torus_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return torus_cylinder_dist(pB, pA, pb, pa);
+}
+
+/// Kernel for plane/cone
+static double plane_cone_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return static_pointer_cast<const PlanePrimitive>(pA)->calc_signed_dist(static_pointer_cast<const ConePrimitive>(pB), pa, pb);
+}
+
+/// Kernel for cone/plane
+static double cone_plane_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return plane_cone_dist(pB, pA, pb, pa);
+}
+
+/// Kernel for capsule/capsule
+static double capsule_capsule_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return static_pointer_cast<const CapsulePrimitive>(pA)->calc_signed_dist(static_pointer_cast<const CapsulePrimitive>(pB), pa, pb);
+}
+
+/// Kernel for capsule/sphere
+static double capsule_sphere_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return static_pointer_cast<const CapsulePrimitive>(pA)->calc_signed_dist(static_pointer_cast<const SpherePrimitive>(pB), pa, pb);
+}
+
+/// Kernel for sphere/capsule
+static double sphere_capsule_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return capsule_sphere_dist(pB, pA, pb, pa);
+}
+
+/// Kernel for capsule/plane
+static double capsule_plane_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return static_pointer_cast<const CapsulePrimitive>(pA)->calc_signed_dist(static_pointer_cast<const PlanePrimitive>(pB), pa, pb);
+}
+
+/// Kernel for plane/capsule
+static double plane_capsule_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return capsule_plane_dist(pB, pA, pb, pa);
+}
+
+/// Kernel for capsule/box
+static double capsule_box_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return static_pointer_cast<const CapsulePrimitive>(pA)->calc_signed_dist(static_pointer_cast<const BoxPrimitive>(pB), pa, pb);
+}
+
+/// Kernel for box/capsule
+static double box_capsule_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return capsule_box_dist(pB, pA, pb, pa);
+}
+
+/// Orders type pairs using std::type_info::before()
+bool PairwiseDistDispatch::TypePairComp::operator()(const TypePair& a, const TypePair& b) const
+{
+  if (a.first->before(*b.first))
+    return true;
+  if (b.first->before(*a.first))
+    return false;
+  return a.second->before(*b.second);
+}
+
+/// Gets the dispatch table, populating the built-in kernels on first use
+PairwiseDistDispatch::Table& PairwiseDistDispatch::table()
+{
+  static Table tab;
+  static bool built = false;
+
+  if (!built)
+  {
+    built = true;
+
+    // sphere pairs
+    tab[TypePair(&typeid(SpherePrimitive), &typeid(SpherePrimitive))] = &sphere_sphere_dist;
+    tab[TypePair(&typeid(BoxPrimitive), &typeid(SpherePrimitive))] = &box_sphere_dist;
+    tab[TypePair(&typeid(SpherePrimitive), &typeid(BoxPrimitive))] = &sphere_box_dist;
+    tab[TypePair(&typeid(PlanePrimitive), &typeid(SpherePrimitive))] = &plane_sphere_dist;
+    tab[TypePair(&typeid(SpherePrimitive), &typeid(PlanePrimitive))] = &sphere_plane_dist;
+    tab[TypePair(&typeid(HeightmapPrimitive), &typeid(SpherePrimitive))] = &heightmap_sphere_dist;
+    tab[TypePair(&typeid(SpherePrimitive), &typeid(HeightmapPrimitive))] = &sphere_heightmap_dist;
+
+    // plane pairs
+    tab[TypePair(&typeid(PlanePrimitive), &typeid(CylinderPrimitive))] = &plane_cylinder_dist;
+    tab[TypePair(&typeid(CylinderPrimitive), &typeid(PlanePrimitive))] = &cylinder_plane_dist;
+    tab[TypePair(&typeid(PlanePrimitive), &typeid(PolyhedralPrimitive))] = &plane_poly_dist;
+    tab[TypePair(&typeid(PolyhedralPrimitive), &typeid(PlanePrimitive))] = &poly_plane_dist;
+    tab[TypePair(&typeid(PlanePrimitive), &typeid(BoxPrimitive))] = &plane_poly_dist;
+    tab[TypePair(&typeid(BoxPrimitive), &typeid(PlanePrimitive))] = &poly_plane_dist;
+    tab[TypePair(&typeid(TorusPrimitive), &typeid(PlanePrimitive))] = &torus_plane_dist;
+    tab[TypePair(&typeid(PlanePrimitive), &typeid(TorusPrimitive))] = &plane_torus_dist;
+    tab[TypePair(&typeid(PlanePrimitive), &typeid(ConePrimitive))] = &plane_cone_dist;
+    tab[TypePair(&typeid(ConePrimitive), &typeid(PlanePrimitive))] = &cone_plane_dist;
+
+    // torus pairs
+    tab[TypePair(&typeid(TorusPrimitive), &typeid(CylinderPrimitive))] = &torus_cylinder_dist;
+    tab[TypePair(&typeid(CylinderPrimitive), &typeid(TorusPrimitive))] = &cylinder_torus_dist;
+
+    // capsule pairs
+    tab[TypePair(&typeid(CapsulePrimitive), &typeid(CapsulePrimitive))] = &capsule_capsule_dist;
+    tab[TypePair(&typeid(CapsulePrimitive), &typeid(SpherePrimitive))] = &capsule_sphere_dist;
+    tab[TypePair(&typeid(SpherePrimitive), &typeid(CapsulePrimitive))] = &sphere_capsule_dist;
+    tab[TypePair(&typeid(CapsulePrimitive), &typeid(PlanePrimitive))] = &capsule_plane_dist;
+    tab[TypePair(&typeid(PlanePrimitive), &typeid(CapsulePrimitive))] = &plane_capsule_dist;
+    tab[TypePair(&typeid(CapsulePrimitive), &typeid(BoxPrimitive))] = &capsule_box_dist;
+    tab[TypePair(&typeid(BoxPrimitive), &typeid(CapsulePrimitive))] = &box_capsule_dist;
+  }
+
+  return tab;
+}
+
+/// Registers a kernel for a pair of dynamic primitive types
+void PairwiseDistDispatch::register_kernel(const std::type_info& tA, const std::type_info& tB, DistFn fn)
+{
+  table()[TypePair(&tA, &tB)] = fn;
+}
+
+/// Looks up and runs the kernel for a pair of primitives, if one is registered
+/**
+ * \param dist contains the signed distance on a table hit
+ * \return true if a kernel was found and run, false otherwise
+ */
+bool PairwiseDistDispatch::lookup(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, double& dist, Point3d& pa, Point3d& pb)
+{
+  // the table is keyed on the dynamic types of the two primitives
+  const Table& tab = table();
+  Table::const_iterator i = tab.find(TypePair(&typeid(*pA), &typeid(*pB)));
+  if (i == tab.end())
+    return false;
+
+  dist = (*i->second)(pA, pB, pa, pb);
+  return true;
+}
@@ -22,6 +22,7 @@
 #include <Moby/CollisionGeometry.h>
 #include <Moby/SpherePrimitive.h>
 #include <Moby/CylinderPrimitive.h>
+#include <Moby/ConePrimitive.h>
 #include <Moby/PolyhedralPrimitive.h>
 #include <Moby/GJK.h>
 #include <Moby/PlanePrimitive.h>
@@ -218,6 +219,28 @@ osg::Node* PlanePrimitive::create_visualization()
   #endif
 }
 
+/// Casts a ray against the plane y = 0 (analytic)
+bool PlanePrimitive::ray_cast(const Point3d& origin, const Vector3d& dir, double max_dist, double& t, Vector3d& normal) const
+{
+  const unsigned Y = 1;
+
+  assert(_poses.find(const_pointer_cast<Pose3d>(origin.pose)) != _poses.end());
+
+  // a ray parallel to the plane never crosses it
+  if (std::fabs(dir[Y]) < NEAR_ZERO)
+    return false;
+
+  // solve oy + t*dy = 0
+  t = -origin[Y]/dir[Y];
+  if (t < 0.0 || t > max_dist)
+    return false;
+
+  // the normal opposes the ray (the side the ray came from)
+  normal = Vector3d(0.0, (dir[Y] < 0.0) ? 1.0 : -1.0, 0.0, origin.pose);
+
+  return true;
+}
+
 /// Computes the signed distance of the given point from this primitive
 double PlanePrimitive::calc_signed_dist(const Point3d& p) const
 {
@@ -227,6 +250,24 @@ double PlanePrimitive::calc_signed_dist(const Point3d& p) const
   return calc_height(p);
 }
 
+/// Computes the signed distances of a batch of points from this primitive
+/**
+ * All points must be defined in the same pose; the pose is verified once for
+ * the whole batch.
+ */
+void PlanePrimitive::calc_signed_dists(const Point3d* points, unsigned n, double* dists) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  if (n == 0)
+    return;
+  assert(_poses.find(const_pointer_cast<Pose3d>(points[0].pose)) != _poses.end());
+
+  // the signed distance is just the height above the plane
+  for (unsigned i=0; i< n; i++)
+    dists[i] = points[i][Y];
+}
+
 /// Gets the distance from a cylinder primitive
 double PlanePrimitive::calc_signed_dist(shared_ptr<const CylinderPrimitive> pA, Point3d& pthis, Point3d& pcyl) const
 {
@@ -338,6 +379,78 @@ double PlanePrimitive::calc_signed_dist(shared_ptr<const CylinderPrimitive> pA,
   return d;
 }
 
+/// Computes the signed distance from the plane to a cone
+double PlanePrimitive::calc_signed_dist(shared_ptr<const ConePrimitive> c, Point3d& pthis, Point3d& pcone) const
+{
+  const unsigned Y = 1;
+  const double EPS = 1e-8;
+
+  FILE_LOG(LOG_COLDET) << "PlanePrimitive::calc_signed_dist(cone) entered" << std::endl;
+
+  // get the pose for the plane primitive
+  boost::shared_ptr<const Ravelin::Pose3d> Pplane = pthis.pose;
+
+  // get the pose for the cone
+  boost::shared_ptr<const Ravelin::Pose3d> Pcone = pcone.pose;
+
+  const double R = c->get_radius();
+  const double H = c->get_height();
+
+  // cone to plane frame transformation
+  Ravelin::Transform3d pPc = Ravelin::Pose3d::calc_relative_pose(Pcone, Pplane);
+
+  // cone axis (in plane frame) is the y column of the rotation; the apex
+  // lies at +h/2 along the axis and the base circle (radius R) at -h/2
+  Ravelin::Vector3d cN = Ravelin::Vector3d(
+                           Ravelin::Matrix3d(pPc.q).get_column(Y),
+                           Pplane);
+  cN.normalize();
+
+  // plane normal is the y axis in the local frame
+  Ravelin::Vector3d n(0,1,0,Pplane);
+
+  // cone origin w.r.t. plane
+  Point3d c0(pPc.x.data(),Pplane);
+
+  // the lowest point of the cone is either the apex or a point on the base
+  // rim; compute both candidates
+  Point3d apex = c0 + (H*0.5)*cN;
+  Point3d base_c = c0 - (H*0.5)*cN;
+
+  // radial direction on the base rim pointing toward the plane: the
+  // component of -n orthogonal to the cone axis
+  Ravelin::Vector3d radial_dir = -n + n.dot(cN)*cN;
+  if (radial_dir.norm() > EPS)
+    radial_dir.normalize();
+  else
+  {
+    // axis is parallel to the plane normal; the whole rim is equidistant,
+    // so pick an arbitrary direction orthogonal to the axis
+    radial_dir = Ravelin::Vector3d(
+                   Ravelin::Matrix3d(pPc.q).get_column(0),
+                   Pplane);
+    radial_dir.normalize();
+  }
+  Point3d rim = base_c + R*radial_dir;
+
+  // distance above the plane is the smaller of the two candidates
+  double d_apex = apex.dot(n);
+  double d_rim = rim.dot(n);
+  double d = std::min(d_apex, d_rim);
+
+  // setup the closest point on the cone and its projection onto the plane
+  Point3d x = (d_apex < d_rim) ? apex : rim;
+  Point3d pP = x - d*n;
+  pcone = Ravelin::Pose3d::transform_point(Moby::GLOBAL, x);
+  pthis = Ravelin::Pose3d::transform_point(Moby::GLOBAL, pP);
+
+  FILE_LOG(LOG_COLDET) << "Point cone (global frame): " << pcone << std::endl;
+  FILE_LOG(LOG_COLDET) << "Point plane (global frame): " << pthis << std::endl;
+  FILE_LOG(LOG_COLDET) << "distance: " << d << std::endl;
+
+  return d;
+}
+
 /// Gets the distance from a polyhedral primitive
 double PlanePrimitive::calc_signed_dist(shared_ptr<const PolyhedralPrimitive> b, Point3d& pthis, Point3d& pb) const
 {
@@ -420,6 +533,11 @@ double PlanePrimitive::calc_signed_dist(shared_ptr<const Primitive> p, Point3d&
   if (cyl)
     return calc_signed_dist(cyl, pthis, pp);
 
+  // look for cone
+  shared_ptr<const ConePrimitive> cone = dynamic_pointer_cast<const ConePrimitive>(p);
+  if (cone)
+    return calc_signed_dist(cone, pthis, pp);
+
   // look for sphere
   shared_ptr<const SpherePrimitive> sph = dynamic_pointer_cast<const SpherePrimitive>(p);
   if (sph)
@@ -31,6 +31,9 @@ using namespace Moby;
 /// Determines whether the primitive is convex
 bool PolyhedralPrimitive::is_convex() const
 {
+  // build any pending union hull first
+  update_union();
+
   // abuse the const keyword
   Polyhedron* pnc = (Polyhedron*) &_poly;
   return pnc->is_convex();
@@ -38,6 +41,9 @@ bool PolyhedralPrimitive::is_convex() const
 
 double PolyhedralPrimitive::calc_dist_and_normal(const Point3d& p, std::vector<Vector3d>& normals) const
 {
+  // build any pending union hull first
+  update_union();
+
   // verify that the primitive knows about this pose 
   assert(_poses.find(const_pointer_cast<Pose3d>(p.pose)) != _poses.end()); 
 
@@ -110,6 +116,9 @@ double PolyhedralPrimitive::calc_dist_and_normal(const Point3d& p, std::vector<V
 /// creates the visualization for the primitive
 osg::Node* PolyhedralPrimitive::create_visualization()
 {
+  // build any pending union hull first
+  update_union();
+
   #ifdef USE_OSG
   const unsigned X = 0, Y = 1, Z = 2, W = 3;
 
@@ -192,6 +201,9 @@ BVPtr PolyhedralPrimitive::get_BVH_root(CollisionGeometryPtr geom)
 
 void PolyhedralPrimitive::get_vertices(shared_ptr<const Pose3d> P, std::vector<Point3d>& vertices) const
 {
+  // build any pending union hull first
+  update_union();
+
   // clear the set of vertices
   vertices.clear();
 
@@ -204,6 +216,35 @@ void PolyhedralPrimitive::get_vertices(shared_ptr<const Pose3d> P, std::vector<P
     vertices.push_back(Point3d(v[i]->o, P));
 }
 
+/// Gets a supporting point via the polyhedron's Gauss map
+/**
+ * The quantized direction indexes a precomputed cube map for a seed vertex
+ * whose support direction is at most half a cell away, and a short hill
+ * climb over the vertex adjacency makes the result exact (see
+ * Polyhedron::find_extreme_vertex()). The query is O(1) in the vertex
+ * count, independent of any temporal coherence between successive queries.
+ */
+Point3d PolyhedralPrimitive::get_supporting_point(const Vector3d& d) const
+{
+  // build any pending union hull first
+  update_union();
+
+  // verify that the primitive knows about this pose
+  assert(_poses.find(const_pointer_cast<Pose3d>(d.pose)) != _poses.end());
+
+  // get the vertices of the polyhedron
+  const std::vector<shared_ptr<Polyhedron::Vertex> >& verts = _poly.get_vertices();
+  if (verts.empty())
+    return Primitive::get_supporting_point(d);
+
+  // the lazily built Gauss map is derived query data, following the class'
+  // existing convention for logically const deferred updates
+  Polyhedron& poly = const_cast<Polyhedron&>(_poly);
+  unsigned best = poly.find_extreme_vertex(Origin3d(d));
+
+  return Point3d(verts[best]->o, d.pose);
+}
+
 shared_ptr<const IndexedTriArray> PolyhedralPrimitive::get_mesh(boost::shared_ptr<const Pose3d> P)
 {
   throw std::runtime_error("Implement me!");
@@ -213,6 +254,9 @@ shared_ptr<const IndexedTriArray> PolyhedralPrimitive::get_mesh(boost::shared_pt
 /// Sets the pose of this primitive
 void PolyhedralPrimitive::set_pose(const Pose3d& P)
 {
+  // build any pending union hull first, so the transform below acts on it
+  update_union();
+
   // setup P as a pointer so that we can compute a relative pose
   shared_ptr<Pose3d> pP(new Pose3d(P));
 
@@ -226,6 +270,28 @@ void PolyhedralPrimitive::set_pose(const Pose3d& P)
   _poly = _poly.transform(T);
 } 
 
+/// Estimates the heap memory held by this primitive, in bytes
+/**
+ * Counts the polyhedron's winged-edge topology (vertices, edges, faces) and
+ * derived query data.  Estimates exclude allocator overhead and
+ * visualization data (see Primitive::calc_memory_usage()).
+ */
+unsigned long PolyhedralPrimitive::calc_memory_usage() const
+{
+  const Polyhedron& poly = get_polyhedron();
+
+  unsigned long bytes = 0;
+  bytes += poly.get_vertices().size()*sizeof(Polyhedron::Vertex);
+  bytes += poly.get_edges().size()*sizeof(Polyhedron::Edge);
+  bytes += poly.get_faces().size()*sizeof(Polyhedron::Face);
+
+  // derived data: face planes and edge directions mirror faces and edges
+  bytes += poly.get_faces().size()*sizeof(Plane);
+  bytes += poly.get_edges().size()*sizeof(Origin3d);
+
+  return bytes;
+}
+
 /// Sets the polyhedron corresponding to this primitive
 /**
  * Should only be done when the primitive hasn't been transformed.
@@ -240,13 +306,61 @@ void PolyhedralPrimitive::set_polyhedron(const Polyhedron& p)
   if (_F->x.norm() > NEAR_ZERO || std::fabs(trace - 3.0) > NEAR_ZERO)
     throw std::runtime_error("set_polyhedron() should only be called with identity pose");
 
-  // set the polyhedron
+  // set the polyhedron (the polyhedron invalidates its own derived data,
+  // including the Gauss map, on assignment)
   _poly = p;
 
   // calculate mass properties
   calc_mass_properties();
 }
 
+/// Sets this primitive to the union of two existing hulls, deferring construction
+/**
+ * Only the operands and the relative transform are recorded here; the merged
+ * hull is built on the first geometric query (see update_union()), from the
+ * operands' hull vertices alone. Attaching a grasped object to a gripper
+ * mid-step is therefore nearly free at the point of attachment- the qhull
+ * call is moved out of the time-critical path and costs only the operands'
+ * hull complexity, not the size of the meshes they were built from.
+ * Like set_polyhedron(), should only be called before the primitive is
+ * transformed.
+ * \param pA the first operand
+ * \param pB the second operand, brought into A's frame by aTb
+ * \param aTb the transform from B's hull frame to A's hull frame
+ */
+void PolyhedralPrimitive::set_union(shared_ptr<const PolyhedralPrimitive> pA, shared_ptr<const PolyhedralPrimitive> pB, const Transform3d& aTb)
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  // verify no transformation (same contract as set_polyhedron())
+  Matrix3d R = _F->q;
+  double trace = R(X,X) + R(Y,Y) + R(Z,Z);
+  if (_F->x.norm() > NEAR_ZERO || std::fabs(trace - 3.0) > NEAR_ZERO)
+    throw std::runtime_error("set_union() should only be called with identity pose");
+
+  // record the operands; the hull itself is built lazily
+  _union_opA = pA;
+  _union_opB = pB;
+  _union_aTb = aTb;
+  _union_pending = true;
+}
+
+/// Builds the pending union hull, if any (see set_union())
+void PolyhedralPrimitive::update_union() const
+{
+  if (!_union_pending)
+    return;
+
+  // this primitive is logically const to its callers; the lazy build
+  // follows the class' existing convention for deferred updates (cf.
+  // is_convex())
+  PolyhedralPrimitive* pnc = (PolyhedralPrimitive*) this;
+  pnc->_union_pending = false;
+  pnc->_poly = Polyhedron::calc_union(_union_opA->get_polyhedron(), _union_opB->get_polyhedron(), _union_aTb);
+  pnc->_union_opA.reset();
+  pnc->_union_opB.reset();
+}
+
 /// Calculates mass properties for the polyhedron
 void PolyhedralPrimitive::calc_mass_properties()
 {
@@ -435,9 +549,20 @@ void PolyhedralPrimitive::load_from_xml(shared_ptr<const XMLTree> node, std::map
     cerr << "  for attribute 'filename'.  Valid extensions are '.obj' (Wavefront OBJ)" << endl;
   }
 
+  // restore the serialized convexity measure, if present (the convex hull
+  // path above marks the polyhedron convex already; this covers polyhedra
+  // saved from other construction paths)
+  XMLAttrib* cvx_attr = node->get_attrib("convexity");
+  if (cvx_attr)
+    _poly.set_convexity(cvx_attr->get_real_value());
+
+  // precompute all derived per-face/per-edge data (planes, edge directions,
+  // vertex adjacency) now, so runtime queries never derive static geometry
+  _poly.calc_derived_data();
+
   // update the visualization
   update_visualization();
- 
+
   // recompute mass properties
   calc_mass_properties();
 }
@@ -445,6 +570,9 @@ void PolyhedralPrimitive::load_from_xml(shared_ptr<const XMLTree> node, std::map
 /// Implements Base::save_to_xml() for serialization
 void PolyhedralPrimitive::save_to_xml(XMLTreePtr node, std::list<shared_ptr<const Base> >& shared_objects) const
 {
+  // build any pending union hull first
+  update_union();
+
   // save the parent data
   Primitive::save_to_xml(node, shared_objects);
 
@@ -460,6 +588,10 @@ void PolyhedralPrimitive::save_to_xml(XMLTreePtr node, std::list<shared_ptr<cons
   // add the filename as an attribute
   node->attribs.insert(XMLAttrib("filename", filename));
 
+  // save the convexity measure so loads need not re-derive it (the OBJ file
+  // only records topology); computed here if a query has not already done so
+  node->attribs.insert(XMLAttrib("convexity", const_cast<Polyhedron&>(_poly).convexity()));
+
   // do not save the array to the OBJ file if it already exists (which we
   // crudely check for using std::ifstream to avoid OS-specific calls -- note
   // that it is possible that opening a file may fails for other reasons than
@@ -7,6 +7,7 @@
 #include <map>
 #include <Moby/Types.h>
 #include <Moby/Log.h>
+#include <Moby/Validation.h>
 #include <Moby/CompGeom.h>
 #include <Moby/PolyhedralPrimitive.h>
 #include <Moby/Polyhedron.h>
@@ -30,12 +31,12 @@ if ((vei = v_edges.find(std::make_pair(vA, vB))) != v_edges.end()) \
   eAB = vei->second; \
   if (cw) \
   { \
-    assert(!eAB->face1); \
+    MOBY_CHECK_HOT(!eAB->face1); \
     eAB->face1 = f; \
   } \
   else \
   { \
-    assert(!eAB->face2); \
+    MOBY_CHECK_HOT(!eAB->face2); \
     eAB->face2 = f; \
   } \
 } \
@@ -44,18 +45,18 @@ else if ((vei = v_edges.find(std::make_pair(vB, vA))) != v_edges.end()) \
   eAB = vei->second; \
   if (cw) \
   { \
-    assert(!eAB->face2); \
+    MOBY_CHECK_HOT(!eAB->face2); \
     eAB->face2 = f; \
   } \
   else \
   { \
-    assert(!eAB->face1); \
+    MOBY_CHECK_HOT(!eAB->face1); \
     eAB->face1 = f; \
   } \
 } \
 else \
 { \
-  eAB = boost::shared_ptr<Polyhedron::Edge>(new Polyhedron::Edge); \
+  eAB = Polyhedron::create_feature<Polyhedron::Edge>(); \
   v_edges[std::make_pair(vA, vB)] = eAB; \
   if (cw) \
     eAB->face1 = f; \
@@ -69,6 +70,213 @@ else \
 } \
 }
 
+/// Computes all derived per-face/per-edge/per-vertex data in packed arrays
+/**
+ * Face planes, unit edge directions, and vertex adjacency (in compressed
+ * sparse row form, for support point hill climbing) are static facts of the
+ * topology; this computes them once, in feature order, so runtime queries
+ * never re-derive them. The per-feature caches (Face::get_plane(),
+ * Edge::get_direction()) are primed as a side effect, so pointer-based
+ * feature walks benefit as well. Call invalidate_derived_data() if vertex
+ * positions are modified in place.
+ */
+void Polyhedron::calc_derived_data()
+{
+  // compute (and cache) the face planes
+  _face_planes.resize(_faces.size());
+  for (unsigned i=0; i< _faces.size(); i++)
+    _face_planes[i] = _faces[i]->get_plane();
+
+  // compute (and cache) the unit edge directions
+  _edge_dirs.resize(_edges.size());
+  for (unsigned i=0; i< _edges.size(); i++)
+    _edge_dirs[i] = _edges[i]->get_direction();
+
+  // index the vertices for adjacency construction
+  std::map<shared_ptr<Vertex>, unsigned> v_index;
+  for (unsigned i=0; i< _vertices.size(); i++)
+    v_index[_vertices[i]] = i;
+
+  // count the edges coincident to each vertex to size the CSR arrays
+  _vertex_adj_begin.assign(_vertices.size()+1, 0);
+  for (unsigned i=0; i< _vertices.size(); i++)
+    _vertex_adj_begin[i+1] = _vertex_adj_begin[i] + _vertices[i]->e.size();
+
+  // pack the neighboring vertex indices
+  _vertex_adj.resize(_vertex_adj_begin.back());
+  for (unsigned i=0, k=0; i< _vertices.size(); i++)
+    BOOST_FOREACH(weak_ptr<Edge> we, _vertices[i]->e)
+    {
+      shared_ptr<Edge> edge(we);
+      shared_ptr<Vertex> nbr = (edge->v1 == _vertices[i]) ? edge->v2 : edge->v1;
+      _vertex_adj[k++] = v_index[nbr];
+    }
+
+  // indicate that the derived data has been computed (before building the
+  // Gauss map, whose hill climbs read the adjacency through
+  // get_vertex_neighbors())
+  _derived_computed = true;
+
+  // build the Gauss map: each cube map cell stores the vertex supporting
+  // the cell center direction, so a support query can seed its hill climb
+  // from the quantized direction instead of from the previous query (see
+  // find_extreme_vertex()); consecutive cells have nearby supports, so each
+  // climb below is short
+  const unsigned RES = GAUSS_MAP_RES;
+  _gauss_map.clear();
+  if (!_vertices.empty() && !_vertex_adj.empty())
+  {
+    _gauss_map.resize(6*RES*RES);
+    unsigned seed = 0;
+    for (unsigned face=0; face< 6; face++)
+    {
+      // the cube face fixes the dominant axis and its sign
+      const unsigned m = face/2;
+      const unsigned a = (m+1)%3, b = (m+2)%3;
+      const double sign = (face % 2 == 0) ? 1.0 : -1.0;
+      for (unsigned iu=0; iu< RES; iu++)
+        for (unsigned iv=0; iv< RES; iv++)
+        {
+          // the cell center direction (unnormalized; only relative
+          // projections matter for a support query)
+          Origin3d dir;
+          dir[m] = sign;
+          dir[a] = -1.0 + (iu + 0.5)*2.0/RES;
+          dir[b] = -1.0 + (iv + 0.5)*2.0/RES;
+          seed = climb_to_support(seed, dir);
+          _gauss_map[(face*RES + iu)*RES + iv] = seed;
+        }
+    }
+  }
+}
+
+/// Climbs the vertex adjacency to a vertex supporting the given direction
+/**
+ * The climb moves to a neighbor with a strictly greater projection onto the
+ * direction until none exists; the strict improvement requirement guarantees
+ * termination on coplanar vertex plateaus. For a convex polyhedron the
+ * terminal vertex is a global support point.
+ */
+unsigned Polyhedron::climb_to_support(unsigned start, const Origin3d& dir)
+{
+  unsigned best = start;
+  double best_dot = _vertices[best]->o.dot(dir);
+  bool improved = true;
+  while (improved)
+  {
+    improved = false;
+    std::pair<const unsigned*, const unsigned*> nbrs = get_vertex_neighbors(best);
+    for (const unsigned* j = nbrs.first; j != nbrs.second; j++)
+    {
+      double dot = _vertices[*j]->o.dot(dir);
+      if (dot > best_dot + NEAR_ZERO)
+      {
+        best_dot = dot;
+        best = *j;
+        improved = true;
+      }
+    }
+  }
+
+  return best;
+}
+
+/// Maps a direction to its Gauss map cube map cell
+unsigned Polyhedron::gauss_map_cell(const Origin3d& dir)
+{
+  const unsigned RES = GAUSS_MAP_RES;
+
+  // find the dominant axis
+  unsigned m = 0;
+  double am = std::fabs(dir[0]);
+  for (unsigned i=1; i< 3; i++)
+    if (std::fabs(dir[i]) > am)
+    {
+      am = std::fabs(dir[i]);
+      m = i;
+    }
+
+  // a degenerate direction maps to an arbitrary cell; the entry is only a
+  // climbing seed, so any cell yields a correct result
+  if (am < NEAR_ZERO)
+    return 0;
+
+  // project the remaining coordinates onto the cube face and quantize
+  const unsigned face = m*2 + ((dir[m] > 0.0) ? 0 : 1);
+  const unsigned a = (m+1)%3, b = (m+2)%3;
+  unsigned iu = (unsigned) std::min((RES-1.0), (dir[a]/am + 1.0)*0.5*RES);
+  unsigned iv = (unsigned) std::min((RES-1.0), (dir[b]/am + 1.0)*0.5*RES);
+  return (face*RES + iu)*RES + iv;
+}
+
+/// Finds the index of a vertex supporting the given direction
+/**
+ * The direction is quantized into the precomputed Gauss map, whose cell
+ * supplies a seed vertex, and a hill climb over the vertex adjacency makes
+ * the result exact: the seed supports the cell center direction, which is
+ * at most half a cell away from the query, so the climb crosses the few
+ * edges separating the two supports rather than scanning all n vertices.
+ * The result is a true support point only for convex polyhedra (the same
+ * assumption the hill climb itself rests on).
+ */
+unsigned Polyhedron::find_extreme_vertex(const Origin3d& dir)
+{
+  assert(!_vertices.empty());
+
+  if (!_derived_computed)
+    calc_derived_data();
+
+  // degenerate polyhedra (no adjacency to climb) fall back to a scan
+  if (_gauss_map.empty())
+  {
+    unsigned best = 0;
+    double best_dot = _vertices[0]->o.dot(dir);
+    for (unsigned i=1; i< _vertices.size(); i++)
+    {
+      double dot = _vertices[i]->o.dot(dir);
+      if (dot > best_dot)
+      {
+        best_dot = dot;
+        best = i;
+      }
+    }
+    return best;
+  }
+
+  return climb_to_support(_gauss_map[gauss_map_cell(dir)], dir);
+}
+
+/// Gets the indices of the vertices adjacent to vertex vidx
+/**
+ * The range [first, second) indexes into the packed adjacency array; it is
+ * used for support point hill climbing. The range is empty for a vertex
+ * with no incident edges.
+ */
+std::pair<const unsigned*, const unsigned*> Polyhedron::get_vertex_neighbors(unsigned vidx)
+{
+  if (!_derived_computed)
+    calc_derived_data();
+  if (_vertex_adj.empty())
+    return std::pair<const unsigned*, const unsigned*>((const unsigned*) NULL, (const unsigned*) NULL);
+  const unsigned* base = &_vertex_adj.front();
+  return std::make_pair(base + _vertex_adj_begin[vidx], base + _vertex_adj_begin[vidx+1]);
+}
+
+/// Invalidates all cached derived data (e.g., after in-place vertex updates)
+void Polyhedron::invalidate_derived_data()
+{
+  _derived_computed = false;
+  _face_planes.clear();
+  _edge_dirs.clear();
+  _vertex_adj.clear();
+  _vertex_adj_begin.clear();
+  _gauss_map.clear();
+  for (unsigned i=0; i< _faces.size(); i++)
+    _faces[i]->_plane_cached = false;
+  for (unsigned i=0; i< _edges.size(); i++)
+    _edges[i]->_dir_cached = false;
+}
+
 /// Determines whether the polyhedron is convex
 void Polyhedron::determine_convexity()
 {
@@ -94,8 +302,16 @@ void Polyhedron::determine_convexity()
 }
 
 /// Gets the plane containing a face
+/**
+ * The plane is computed on the first call and cached (face geometry is
+ * static once the topology has been built); subsequent calls are a copy.
+ */
 Plane Polyhedron::Face::get_plane() const
 {
+  // use the cached plane, if it is available
+  if (_plane_cached)
+    return _plane;
+
   if (e.size() < 3)
     throw std::runtime_error("Tried to get plane containing face when face has fewer than 3 edges!"); 
 
@@ -108,7 +324,7 @@ Plane Polyhedron::Face::get_plane() const
 
   // need three vertices - get first two arbitrarily
   shared_ptr<Polyhedron::Vertex> v1 = *vfi;
-  assert(vfi.has_next());
+  MOBY_CHECK_HOT(vfi.has_next());
   vfi.advance();
   shared_ptr<Polyhedron::Vertex> v2 = *vfi;
 
@@ -117,7 +333,7 @@ Plane Polyhedron::Face::get_plane() const
   do 
   {
     // make sure that there is another vertex
-    assert(vfi.has_next());
+    MOBY_CHECK_HOT(vfi.has_next());
 
     // get the next vertex
     vfi.advance();
@@ -138,14 +354,38 @@ Plane Polyhedron::Face::get_plane() const
   // compute d
   double d = normal.dot(v1->o);
 
-  return Plane(Vector3d(normal, GLOBAL), d);
+  // cache the plane
+  _plane = Plane(Vector3d(normal, GLOBAL), d);
+  _plane_cached = true;
+
+  return _plane;
+}
+
+/// Gets the unit direction of this edge (from v1 to v2)
+/**
+ * The direction is computed on the first call and cached (edge geometry is
+ * static once the topology has been built).
+ */
+const Origin3d& Polyhedron::Edge::get_direction() const
+{
+  if (!_dir_cached)
+  {
+    _dir = v2->o - v1->o;
+    double nrm = _dir.norm();
+    if (nrm > NEAR_ZERO)
+      _dir /= nrm;
+    _dir_cached = true;
+  }
+
+  return _dir;
 }
 
 /// Creates a minimum polyhedron
 Polyhedron::Polyhedron()
 {
-  // indicate convexity has not been computed
+  // indicate convexity and derived data have not been computed
   _convexity_computed = false;
+  _derived_computed = false;
 }
 
 /// Assignment operator
@@ -157,6 +397,15 @@ Polyhedron& Polyhedron::operator=(const Polyhedron& p)
   _convexity = p._convexity;
   _convexity_computed = p._convexity_computed;
 
+  // the copied features are fresh objects with cold caches; derived data is
+  // recomputed lazily (callers like transform() may move the new vertices)
+  _derived_computed = false;
+  _face_planes.clear();
+  _edge_dirs.clear();
+  _vertex_adj.clear();
+  _vertex_adj_begin.clear();
+  _gauss_map.clear();
+
   // clear vertices, edges, and faces
   _vertices.clear();
   _edges.clear();
@@ -166,7 +415,7 @@ Polyhedron& Polyhedron::operator=(const Polyhedron& p)
   std::map<shared_ptr<Polyhedron::Vertex>, shared_ptr<Polyhedron::Vertex> > v_copy;
   for (unsigned i=0; i< p._vertices.size(); i++)
   {
-    shared_ptr<Polyhedron::Vertex> v(new Polyhedron::Vertex);
+    shared_ptr<Polyhedron::Vertex> v = create_feature<Polyhedron::Vertex>();
     v->o = p._vertices[i]->o;
     v_copy[p._vertices[i]] = v;
     v->data = p._vertices[i]->data;
@@ -177,7 +426,7 @@ Polyhedron& Polyhedron::operator=(const Polyhedron& p)
   std::map<shared_ptr<Polyhedron::Edge>, shared_ptr<Polyhedron::Edge> > e_copy;
   for (unsigned i=0; i< p._edges.size(); i++)
   {
-    shared_ptr<Polyhedron::Edge> e(new Polyhedron::Edge);
+    shared_ptr<Polyhedron::Edge> e = create_feature<Polyhedron::Edge>();
     e->v1 = v_copy[p._edges[i]->v1];
     e->v2 = v_copy[p._edges[i]->v2];
     e_copy[p._edges[i]] = e;
@@ -189,7 +438,7 @@ Polyhedron& Polyhedron::operator=(const Polyhedron& p)
   std::map<shared_ptr<Polyhedron::Face>, shared_ptr<Polyhedron::Face> > f_copy;
   for (unsigned i=0; i< p._faces.size(); i++)
   {
-    shared_ptr<Polyhedron::Face> f(new Polyhedron::Face);
+    shared_ptr<Polyhedron::Face> f = create_feature<Polyhedron::Face>();
     BOOST_FOREACH(weak_ptr<Edge> e, p._faces[i]->e)
       f->e.push_back(e_copy[shared_ptr<Edge>(e)]);
     f->data = p._faces[i]->data;
@@ -224,6 +473,15 @@ Polyhedron Polyhedron::shallow_copy() const
   p._vertices = _vertices;
   p._faces = _faces;
 
+  // the features (and their caches) are shared, so the packed derived data
+  // remains valid for the copy
+  p._derived_computed = _derived_computed;
+  p._face_planes = _face_planes;
+  p._edge_dirs = _edge_dirs;
+  p._vertex_adj = _vertex_adj;
+  p._vertex_adj_begin = _vertex_adj_begin;
+  p._gauss_map = _gauss_map;
+
   return p;
 }
 
@@ -243,7 +501,37 @@ Polyhedron Polyhedron::transform(const Transform3d& T) const
   return p;    
 }
 
-/// Writes the polyhedron to Wavefront OBJ format 
+/// Computes the convex hull of the union of two convex polyhedra
+/**
+ * Only the operands' hull vertices are fed to the hull construction: the
+ * convex hull of a union of convex sets is the hull of their extreme points,
+ * so the meshes or point clouds the operands were originally built from
+ * never need to be rescanned. The cost is thus proportional to the operands'
+ * hull complexity rather than to the size of the underlying geometry.
+ * \param pA the first polyhedron
+ * \param pB the second polyhedron, brought into A's frame by aTb
+ * \param aTb the transform applied to B's vertices
+ * \return the hull of the union, in A's frame
+ */
+Polyhedron Polyhedron::calc_union(const Polyhedron& pA, const Polyhedron& pB, const Transform3d& aTb)
+{
+  // collect A's hull vertices
+  const std::vector<shared_ptr<Vertex> >& vA = pA.get_vertices();
+  const std::vector<shared_ptr<Vertex> >& vB = pB.get_vertices();
+  std::vector<Origin3d> points;
+  points.reserve(vA.size() + vB.size());
+  for (unsigned i=0; i< vA.size(); i++)
+    points.push_back(vA[i]->o);
+
+  // bring B's hull vertices into A's frame
+  for (unsigned i=0; i< vB.size(); i++)
+    points.push_back(Origin3d(aTb.transform_point(Point3d(vB[i]->o, aTb.source))));
+
+  // hull the combined extreme points
+  return calc_convex_hull(points.begin(), points.end());
+}
+
+/// Writes the polyhedron to Wavefront OBJ format
 void Polyhedron::write_to_obj(const std::string& filename) const
 {
   throw std::runtime_error("Implement me!");
@@ -286,7 +574,7 @@ Polyhedron Polyhedron::calc_minkowski_diff(shared_ptr<const PolyhedralPrimitive>
   for (unsigned i=0, k=0; i< vA.size(); i++)
     for (unsigned j=0; j< vB.size(); j++, k++)
     {
-      verts[k] = shared_ptr<Polyhedron::Vertex>(new Polyhedron::Vertex);
+      verts[k] = create_feature<Polyhedron::Vertex>();
       verts[k]->o = Origin3d(vA[i]) - Origin3d(vB[j]); 
       shared_ptr<std::pair<int, int> > intpair(new std::pair<int, int>(i, j));
       verts[k]->data = intpair;
@@ -332,13 +620,20 @@ Polyhedron Polyhedron::calc_minkowski_diff(shared_ptr<const PolyhedralPrimitive>
   } 
 
   // construct the convex hull
-  // execute qhull  
-  exit_code = qh_new_qhull(DIM, N_POINTS, points_begin, IS_MALLOC, flags, outfile, errfile);
+  // acquire a qhull context (the global mutex for classic qhull; a local
+  // context when building against reentrant qhull)
+  QHULL_INIT_CONTEXT(errfile);
+
+  // execute qhull
+  exit_code = QHULL_NEW_QHULL(DIM, N_POINTS, points_begin, IS_MALLOC, flags, outfile, errfile);
   if (exit_code)
   {
     // free qhull memory
-    qh_freeqhull(!qh_ALL);
-    qh_memfreeshort(&curlong, &totlong);
+    QHULL_FREEQHULL();
+    QHULL_MEMFREESHORT(&curlong, &totlong);
+
+    // release the qhull context
+    QHULL_RELEASE_CONTEXT();
 
     // close the error stream, if necessary
     if (!LOGGING(LOG_COMPGEOM))
@@ -362,13 +657,13 @@ Polyhedron Polyhedron::calc_minkowski_diff(shared_ptr<const PolyhedralPrimitive>
   if (LOGGING(LOG_COMPGEOM))
   {
     // triangulation may or may not be disabled...
-    qh_triangulate();
+    QHULL_TRIANGULATE();
     for (unsigned i=0; i< poly._vertices.size(); i++)
       FILE_LOG(LOG_COMPGEOM) << "vertex " << i << ": " << poly._vertices[i]->o << std::endl;
   }
 
   // triangulate
-  qh_triangulate();
+  QHULL_TRIANGULATE();
 
   // need maps for new edges created for simplicial and non-simplicial facets
   std::map<std::pair<vertexT*, vertexT*>, boost::shared_ptr<Polyhedron::Edge> > v_edges;
@@ -378,13 +673,13 @@ Polyhedron Polyhedron::calc_minkowski_diff(shared_ptr<const PolyhedralPrimitive>
   std::map<std::pair<vertexT*, vertexT*>, boost::shared_ptr<Polyhedron::Edge> >::const_iterator vei;
   
   // iterate through facets
-  for (facetT* facet=qh facet_list;facet && facet->next;facet=facet->next)
+  for (facetT* facet=QH(facet_list);facet && facet->next;facet=facet->next)
   {
     if (!facet->vertices)
       continue;
 
     // create a new facet
-    boost::shared_ptr<Polyhedron::Face> f(new Polyhedron::Face);
+    boost::shared_ptr<Polyhedron::Face> f = create_feature<Polyhedron::Face>();
 
     // see whether the facet is simplicial- it changes how we must process
     // edges
@@ -420,7 +715,7 @@ Polyhedron Polyhedron::calc_minkowski_diff(shared_ptr<const PolyhedralPrimitive>
         f->e.push_back(e31);
         f->e.push_back(e23);
       }
-      assert(e12 != e23 && e12 != e31 && e23 != e31);
+      MOBY_CHECK_HOT(e12 != e23 && e12 != e31 && e23 != e31);
     }
     else
     {
@@ -443,7 +738,7 @@ Polyhedron Polyhedron::calc_minkowski_diff(shared_ptr<const PolyhedralPrimitive>
         if (new_edge_iter == r_edges.end())
         {
           // create an edge and add it to the map
-          e = boost::shared_ptr<Polyhedron::Edge>(new Polyhedron::Edge);
+          e = create_feature<Polyhedron::Edge>();
           poly._edges.push_back(e);
           r_edges[ridge] = e;
 
@@ -456,7 +751,7 @@ Polyhedron Polyhedron::calc_minkowski_diff(shared_ptr<const PolyhedralPrimitive>
           // setup the vertices
           e->v1 = vertex_map[v1->point];
           e->v2 = vertex_map[v2->point];
-          assert(e->v1 != e->v2);
+          MOBY_CHECK_HOT(e->v1 != e->v2);
 
           // add edge to the vertices
           e->v1->e.push_back(e);
@@ -566,8 +861,11 @@ Polyhedron Polyhedron::calc_minkowski_diff(shared_ptr<const PolyhedralPrimitive>
   }
 
   // free qhull memory
-  qh_freeqhull(!qh_ALL);
-  qh_memfreeshort(&curlong, &totlong);
+  QHULL_FREEQHULL();
+  QHULL_MEMFREESHORT(&curlong, &totlong);
+
+  // release the qhull context
+  QHULL_RELEASE_CONTEXT();
 
   // close the error stream, if necessary
   if (!LOGGING(LOG_COMPGEOM))
@@ -662,7 +960,7 @@ double Polyhedron::find_closest_features(const Origin3d& p, std::list<shared_ptr
     do 
     {
       // get the next vertex
-      assert(vfi.has_next());
+      MOBY_CHECK_HOT(vfi.has_next());
       vfi.advance();
       shared_ptr<Polyhedron::Vertex> vj = *vfi;
 
@@ -2235,7 +2533,7 @@ double Polyhedron::calc_dist(FeatureType fA, FeatureType fB, boost::shared_ptr<c
   }
   else 
   {
-    assert(fA == eFace && fB == eFace);
+    MOBY_CHECK_HOT(fA == eFace && fB == eFace);
 
     // cast pointers
     boost::shared_ptr<const Polyhedron::Face> faceA_const = boost::static_pointer_cast<const Polyhedron::Face>(closestA);
@@ -9,6 +9,7 @@
 #include <osg/Material>
 #include <osg/Matrixd>
 #endif
+#include <algorithm>
 #include <queue>
 #include <stdexcept>
 #include <Moby/Constants.h>
@@ -128,6 +129,102 @@ double Primitive::calc_signed_dist(const Point3d& p) const
   return 0.0; 
 }
 
+/// Calculates the signed distance from this primitive to a batch of points
+/**
+ * All points in the batch must be defined in the same pose. The default
+ * implementation calls calc_signed_dist() once per point; primitives with
+ * cheap closed-form distance functions override this with a tight loop so
+ * that virtual dispatch and pose verification are amortized over the batch
+ * (and so the compiler can vectorize the arithmetic).
+ */
+void Primitive::calc_signed_dists(const Point3d* points, unsigned n, double* dists) const
+{
+  for (unsigned i=0; i< n; i++)
+    dists[i] = calc_signed_dist(points[i]);
+}
+
+/// Casts a ray against this primitive
+/**
+ * The ray is defined in one of this primitive's poses.  The default
+ * implementation marches along the ray using the signed distance function
+ * (sphere tracing), which works for any primitive with a Euclidean signed
+ * distance; primitives with closed-form surfaces override this with an
+ * analytic intersection.
+ * \param origin the origin of the ray
+ * \param dir the (unit) direction of the ray
+ * \param max_dist the maximum distance to search along the ray
+ * \param t on return, the distance along the ray to the surface (if the ray
+ *        hits)
+ * \param normal on return, the surface normal at the hit point, oriented
+ *        against the ray (if the ray hits)
+ * \return <b>true</b> if the ray hits the primitive within max_dist
+ */
+bool Primitive::ray_cast(const Point3d& origin, const Vector3d& dir, double max_dist, double& t, Vector3d& normal) const
+{
+  const unsigned MAX_STEPS = 256;
+
+  assert(_poses.find(const_pointer_cast<Pose3d>(origin.pose)) != _poses.end());
+
+  // march along the ray; the signed distance bounds how far the ray can
+  // advance without crossing the surface
+  double s = 0.0;
+  for (unsigned i=0; i< MAX_STEPS; i++)
+  {
+    // evaluate the signed distance at the current point on the ray
+    Point3d p = origin + dir*s;
+    double d = calc_signed_dist(p);
+
+    // see whether the surface has been reached (or the ray started inside)
+    if (d < NEAR_ZERO)
+    {
+      t = s;
+
+      // get the normal at the hit point, oriented against the ray
+      std::vector<Vector3d> normals;
+      calc_dist_and_normal(p, normals);
+      assert(!normals.empty());
+      normal = normals.front();
+      if (normal.dot(dir) > 0.0)
+        normal = -normal;
+      return true;
+    }
+
+    // advance the ray by the certified free distance
+    s += d;
+    if (s > max_dist)
+      return false;
+  }
+
+  return false;
+}
+
+/// Casts a batch of rays against this primitive
+/**
+ * All rays must be defined in the same pose and share one maximum distance.
+ * On return, t[i] holds the hit distance for ray i, or a negative value if
+ * ray i misses; normals[i] is set only for hits.  The default implementation
+ * casts the rays one at a time; TriangleMeshPrimitive overrides this to
+ * traverse its bounding-volume hierarchy with the whole packet at once.
+ */
+void Primitive::ray_cast(const Point3d* origins, const Vector3d* dirs, unsigned n, double max_dist, double* t, Vector3d* normals) const
+{
+  for (unsigned i=0; i< n; i++)
+    if (!ray_cast(origins[i], dirs[i], max_dist, t[i], normals[i]))
+      t[i] = -1.0;
+}
+
+/// Estimates the heap memory held by this primitive, in bytes
+/**
+ * Counts heap payloads owned by the primitive beyond the object itself
+ * (meshes, hierarchies, topology); the default is an object with no such
+ * payloads.  Estimates cover the major owners only -- allocator overhead
+ * and visualization (OSG) data are not counted.
+ */
+unsigned long Primitive::calc_memory_usage() const
+{
+  return 0;
+}
+
 /// Gets a supporting point from a primitive
 Point3d Primitive::get_supporting_point(const Vector3d& dir) const
 {
@@ -236,6 +333,63 @@ void Primitive::set_density(double density)
   calc_mass_properties();
 }
 
+// static members for mass-property batching
+bool Primitive::_mass_props_batch_active = false;
+std::vector<Primitive*> Primitive::_mass_props_batch;
+
+/// Begins batching expensive mass-property computations
+/**
+ * Between this call and end_calc_mass_properties_batch(), primitives with
+ * expensive inertial integrals (e.g., triangle meshes) defer
+ * calc_mass_properties() and register themselves instead; the end call then
+ * computes all deferred properties in one parallel pass.  XMLReader batches
+ * across all primitives in a scene so that loads with many meshes do not
+ * serialize this embarrassingly parallel work.
+ */
+void Primitive::begin_calc_mass_properties_batch()
+{
+  _mass_props_batch_active = true;
+  _mass_props_batch.clear();
+}
+
+/// Computes all deferred mass properties and ends batching
+void Primitive::end_calc_mass_properties_batch()
+{
+  // subsequent calc_mass_properties() calls are carried out immediately
+  _mass_props_batch_active = false;
+
+  // compute the deferred properties; meshes that convexify for inertial
+  // calculation call into qhull, so the loop is only dispatched over threads
+  // when concurrent qhull use cannot race (see CompGeom::calc_convex_hulls())
+  #if defined(_OPENMP) && (defined(THREADSAFE) || defined(MOBY_QHULL_REENTRANT))
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (int i=0; i< (int) _mass_props_batch.size(); i++)
+    _mass_props_batch[i]->calc_mass_properties();
+
+  // the batch has been processed
+  _mass_props_batch.clear();
+}
+
+/// Defers this primitive's mass-property computation if batching is active
+/**
+ * Expensive calc_mass_properties() overrides call this on entry and return
+ * immediately when it returns true.
+ * \return true if the computation was deferred
+ */
+bool Primitive::defer_calc_mass_properties()
+{
+  if (!_mass_props_batch_active)
+    return false;
+
+  // register this primitive, unless it was already deferred (properties may
+  // be invalidated several times while a primitive loads)
+  if (std::find(_mass_props_batch.begin(), _mass_props_batch.end(), this) == _mass_props_batch.end())
+    _mass_props_batch.push_back(this);
+
+  return true;
+}
+
 /// Implements Base::load_from_xml() for serialization
 void Primitive::load_from_xml(shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map)
 {
@@ -357,6 +511,9 @@ void Primitive::set_pose(const Pose3d& F)
     p->q = F.q;
   }
 
+  // pose-derived caches must revalidate
+  bump_generation();
+
   #ifdef USE_OSG
   if (_vtransform)
   {
@@ -86,6 +86,74 @@ QLCPD::QLCPD()
 {
 }
 
+// grows a workspace array geometrically so that solves with fluctuating
+// problem dimensions do not free and reallocate on every call
+template <class T>
+static void grow(std::vector<T>& v, unsigned sz)
+{
+  if (sz > v.capacity())
+    v.reserve(std::max((std::size_t) sz, v.capacity()*2));
+  if (v.size() < sz)
+    v.resize(sz);
+}
+
+/// Sizes the solver workspaces for a problem with nm = n+m constraints
+/**
+ * set_values() must have been called first (it computes the Fortran
+ * workspace sizes).  All arrays are retained at their high-water mark and
+ * grown geometrically, so once the largest problem in a simulation has been
+ * seen, repeated solves- including the feasibility-restoration retries made
+ * by the constraint handlers- perform no heap allocation.  Call
+ * release_transient_memory() to return the retained storage.
+ */
+void QLCPD::setup_workspaces(int nm, int mlp, int maxg)
+{
+  // real and integer Fortran workspaces (the real workspace holds the
+  // scaled problem and dominates the footprint)
+  grow(_ws, _mxws);
+  grow(_lws, _mxlws);
+
+  // active constraint set and degeneracy recursion stack
+  grow(_ls, nm);
+  grow(_lp, mlp);
+
+  // residual/steplength temporaries (Ravelin vectors retain their capacity
+  // across downward resizes, so these do not reallocate in steady state)
+  _r.resize(nm);
+  _w.resize(nm);
+  _e.resize(nm);
+  _alp.resize(nm);
+  _v.resize(maxg);
+}
+
+/// Releases the retained solver workspaces
+/**
+ * The workspaces are kept at their high-water mark across solves (see
+ * setup_workspaces()), so a single unusually large contact problem inflates
+ * the footprint until this is called.  Everything released here is rebuilt
+ * on the next solve.
+ */
+void QLCPD::release_transient_memory()
+{
+  // the swap trick actually frees the storage (C++03 vectors have no
+  // shrink-to-fit)
+  std::vector<double>().swap(_ws);
+  std::vector<int>().swap(_lws);
+  std::vector<int>().swap(_ls);
+  std::vector<int>().swap(_lp);
+
+  // release the excess capacity held by the Ravelin temporaries
+  _lb.resize(0);    _lb.compress();
+  _ub.resize(0);    _ub.compress();
+  _r.resize(0);     _r.compress();
+  _e.resize(0);     _e.compress();
+  _w.resize(0);     _w.compress();
+  _v.resize(0);     _v.compress();
+  _alp.resize(0);   _alp.compress();
+  _g.resize(0);     _g.compress();
+  _X.resize(0,0);   _X.compress();
+}
+
 /// Calls qlcpd
 void QLCPD::qlcpd(int* n, int* m, int* k, int* kmax, int* maxg,
              double* a, int* la, double* x, double* bl, double* bu,
@@ -6,8 +6,12 @@
 
 #include <stack>
 #include <queue>
+#include <algorithm>
+#include <boost/foreach.hpp>
+#include <Ravelin/LinAlgd.h>
 #include <Moby/Log.h>
 #include <Moby/Joint.h>
+#include <Moby/RecurrentForce.h>
 #include <Moby/RigidBody.h>
 #include <Moby/XMLTree.h>
 #include <Moby/NumericalException.h>
@@ -32,6 +36,218 @@ using namespace Moby;
  */
 RCArticulatedBody::RCArticulatedBody()
 {
+  jsim_staleness_tol = 0.0;
+  joint_friction_dt = 0.0;
+  _jsim_valid = false;
+  _jsim_chol_valid = false;
+}
+
+/// Checks whether the cached joint-space inertia matrix matches the configuration
+/**
+ * The check compares the current generalized coordinates against those at
+ * which the cache was built, so the coordinate setters need no invalidation
+ * hook: setting new coordinates stales the cache implicitly.  With the
+ * default zero staleness tolerance the cache is reused only at a bit-exact
+ * configuration match (repeated queries within a mini-step); a positive
+ * tolerance extends reuse across mini-steps.
+ */
+bool RCArticulatedBody::jsim_cache_fresh()
+{
+  if (!_jsim_valid)
+    return false;
+
+  get_generalized_coordinates_euler(_jsim_qwork);
+  if (_jsim_qwork.size() != _jsim_q.size())
+    return false;
+  for (unsigned i=0; i< _jsim_q.size(); i++)
+    if (std::fabs(_jsim_qwork[i] - _jsim_q[i]) > jsim_staleness_tol)
+      return false;
+
+  return true;
+}
+
+/// Explicitly invalidates the cached joint-space inertia matrix
+/**
+ * Necessary only when the mass distribution changes (e.g., link inertia
+ * edits); configuration changes are detected automatically.
+ */
+void RCArticulatedBody::invalidate_jsim_cache()
+{
+  _jsim_valid = false;
+  _jsim_chol_valid = false;
+}
+
+/// Gets the generalized inertia, reusing the cache while the configuration holds
+/**
+ * Assembling the joint-space inertia matrix is expensive and it is requested
+ * several times per step (forward dynamics, the impact handler, constraint
+ * stabilization) at an unchanged -- or, across mini-steps, nearly unchanged
+ * -- configuration; see jsim_staleness_tol.
+ */
+MatrixNd& RCArticulatedBody::get_generalized_inertia(MatrixNd& M)
+{
+  if (!jsim_cache_fresh())
+  {
+    RCArticulatedBodyd::get_generalized_inertia(_jsim);
+    get_generalized_coordinates_euler(_jsim_q);
+    _jsim_valid = true;
+    _jsim_chol_valid = false;
+  }
+
+  return M = _jsim;
+}
+
+/// Refreshes the cached joint-space inertia matrix factorization
+/**
+ * \return <b>false</b> if the matrix is not factorizable (the caller then
+ *         falls back to the uncached solve)
+ */
+bool RCArticulatedBody::update_jsim_factorization()
+{
+  if (!jsim_cache_fresh())
+  {
+    RCArticulatedBodyd::get_generalized_inertia(_jsim);
+    get_generalized_coordinates_euler(_jsim_q);
+    _jsim_valid = true;
+    _jsim_chol_valid = false;
+  }
+
+  if (!_jsim_chol_valid)
+  {
+    _jsim_chol = _jsim;
+    if (!LinAlgd::factor_chol(_jsim_chol))
+      return false;
+    _jsim_chol_valid = true;
+  }
+
+  return true;
+}
+
+/// Solves using the generalized inertia matrix, reusing its factorization
+VectorNd& RCArticulatedBody::solve_generalized_inertia(const VectorNd& b, VectorNd& x)
+{
+  if (!update_jsim_factorization())
+    return RCArticulatedBodyd::solve_generalized_inertia(b, x);
+
+  x = b;
+  LinAlgd::solve_chol_fast(_jsim_chol, x);
+  return x;
+}
+
+/// Solves using the generalized inertia matrix, reusing its factorization
+MatrixNd& RCArticulatedBody::solve_generalized_inertia(const MatrixNd& B, MatrixNd& X)
+{
+  if (!update_jsim_factorization())
+    return RCArticulatedBodyd::solve_generalized_inertia(B, X);
+
+  X = B;
+  LinAlgd::solve_chol_fast(_jsim_chol, X);
+  return X;
+}
+
+/// Computes forward dynamics, treating joint friction and damping implicitly
+/**
+ * Per-joint viscous damping and Coulomb friction (see Joint::mu_fv and
+ * Joint::mu_fc) applied as explicit generalized forces destabilize large
+ * steps: the damping torque computed at the old velocity overshoots and the
+ * integrator must shrink dt to compensate.  This override instead folds the
+ * coefficients into the acceleration solve.  The viscous term is integrated
+ * backward-Euler by solving (M + h*D)*a = M*a0 - D*v -- unconditionally
+ * stable in the step size h -- and the Coulomb torque is clamped per-DOF
+ * (diagonal approximation) so that friction can bring a joint to rest within
+ * the step but never drive it backward; at rest it resists the applied
+ * torque up to mu_fc.  Implicit (loop-closure) joints are handled as
+ * bilateral constraints and carry no friction here.  Bodies whose joints
+ * have no friction or damping, or dynamics computed outside a simulator
+ * step (joint_friction_dt = 0), fall through to the standard solve.
+ */
+void RCArticulatedBody::calc_fwd_dyn()
+{
+  const double h = joint_friction_dt;
+
+  // see whether any explicit joint carries damping or friction
+  bool frictional = false;
+  const vector<shared_ptr<Jointd> >& ejoints = get_explicit_joints();
+  for (unsigned i=0; i< ejoints.size() && !frictional; i++)
+  {
+    shared_ptr<Joint> joint = dynamic_pointer_cast<Joint>(ejoints[i]);
+    if (joint && (joint->mu_fv > 0.0 || joint->mu_fc > 0.0))
+      frictional = true;
+  }
+
+  // without friction or a step size there is nothing to treat implicitly
+  if (!frictional || h <= 0.0)
+  {
+    RCArticulatedBodyd::calc_fwd_dyn();
+    return;
+  }
+
+  // compute the frictionless acceleration a0 = M^{-1}*f
+  RCArticulatedBodyd::calc_fwd_dyn();
+  get_generalized_acceleration(_fric_a0);
+  get_generalized_velocity(DynamicBodyd::eSpatial, _fric_v);
+
+  // assemble the per-DOF damping diagonal over the joint coordinates; the
+  // floating-base coordinates (the trailing six) are never damped
+  const unsigned NGC = num_generalized_coordinates(DynamicBodyd::eSpatial);
+  _fric_D.set_zero(NGC);
+  for (unsigned i=0; i< ejoints.size(); i++)
+  {
+    shared_ptr<Joint> joint = dynamic_pointer_cast<Joint>(ejoints[i]);
+    if (!joint)
+      continue;
+    for (unsigned j=0; j< joint->num_dof(); j++)
+      _fric_D[joint->get_coord_index()+j] = joint->mu_fv;
+  }
+
+  // setup A = M + h*D and the frictionless generalized force M*a0, less the
+  // damping torque at the current velocity; the h*D term in A supplies the
+  // remainder of the backward-Euler damping torque
+  get_generalized_inertia(_fric_M);
+  _fric_M.mult(_fric_a0, _fric_rhs);
+  _fric_A = _fric_M;
+  for (unsigned i=0; i< NGC; i++)
+  {
+    _fric_A(i,i) += h*_fric_D[i];
+    _fric_rhs[i] -= _fric_D[i]*_fric_v[i];
+  }
+
+  // apply the clamped Coulomb torque: the torque that would stop a moving
+  // DOF within the step (under the diagonal approximation) bounds the
+  // kinetic torque, and a resting DOF resists the applied torque up to mu_fc
+  for (unsigned i=0; i< ejoints.size(); i++)
+  {
+    shared_ptr<Joint> joint = dynamic_pointer_cast<Joint>(ejoints[i]);
+    if (!joint || joint->mu_fc <= 0.0)
+      continue;
+    for (unsigned j=0; j< joint->num_dof(); j++)
+    {
+      const unsigned k = joint->get_coord_index()+j;
+      if (_fric_v[k] > NEAR_ZERO)
+      {
+        const double tau_stop = _fric_rhs[k] + _fric_v[k]*_fric_A(k,k)/h;
+        _fric_rhs[k] -= std::min(joint->mu_fc, std::max(0.0, tau_stop));
+      }
+      else if (_fric_v[k] < -NEAR_ZERO)
+      {
+        const double tau_stop = _fric_rhs[k] + _fric_v[k]*_fric_A(k,k)/h;
+        _fric_rhs[k] -= std::max(-joint->mu_fc, std::min(0.0, tau_stop));
+      }
+      else
+        _fric_rhs[k] -= std::max(-joint->mu_fc, std::min(joint->mu_fc, _fric_rhs[k]));
+    }
+  }
+
+  // solve (M + h*D)*a = rhs; A is symmetric positive definite since D >= 0
+  if (!LinAlgd::factor_chol(_fric_A))
+  {
+    // should not happen for a valid inertia matrix; the frictionless
+    // acceleration computed above remains set
+    FILE_LOG(LOG_DYNAMICS) << "RCArticulatedBody::calc_fwd_dyn() - damped inertia matrix not factorizable; friction not applied" << std::endl;
+    return;
+  }
+  LinAlgd::solve_chol_fast(_fric_A, _fric_rhs);
+  set_generalized_acceleration(_fric_rhs);
 }
 
 /// Applies a generalized impulse to the rigid body (calls the simulator)
@@ -41,8 +257,77 @@ void RCArticulatedBody::apply_generalized_impulse(const SharedVectorNd& gj)
   s->apply_impulse(RCArticulatedBodyd::get_this(), gj);
 }
 
+/// Computes inverse dynamics over a batch of configurations
+/**
+ * Computes, for each configuration, the generalized actuator forces that
+ * realize the desired generalized accelerations under the body's recurrent
+ * forces (gravity): tau = M(q)*(qdd - a0), where a0 is the acceleration the
+ * body would undergo with no actuator forces applied.  Controller-side
+ * trajectory evaluation (e.g., model-predictive control) calls this once per
+ * control cycle instead of once per trajectory point: the body state is
+ * saved and restored once for the whole batch, and the inertia, acceleration,
+ * and force workspaces are reused across the points rather than reallocated
+ * per call.  The body's controller is not invoked.
+ * \param q the generalized coordinates (Euler parameterization), per point
+ * \param qd the generalized velocities (spatial parameterization), per point
+ * \param qdd the desired generalized accelerations, per point
+ * \param tau on return, the generalized actuator forces, per point
+ */
+void RCArticulatedBody::calc_inv_dyn_batch(const vector<VectorNd>& q, const vector<VectorNd>& qd, const vector<VectorNd>& qdd, vector<VectorNd>& tau)
+{
+  MatrixNd M;
+  VectorNd a0, workv, gc_save, gv_save;
+
+  assert(q.size() == qd.size() && q.size() == qdd.size());
+
+  // resize the output in place so persistent storage passed in is reused
+  tau.resize(q.size());
+
+  // save the body's state once for the whole batch
+  get_generalized_coordinates_euler(gc_save);
+  get_generalized_velocity(DynamicBodyd::eSpatial, gv_save);
+
+  // disable the implicit joint friction treatment for the batch -- the
+  // queried relationship is tau = M*(qdd - a0) with a frictionless a0
+  const double jfdt_save = joint_friction_dt;
+  joint_friction_dt = 0.0;
+
+  // get the shared pointer to this for applying recurrent forces
+  ArticulatedBodyPtr shared_this = dynamic_pointer_cast<ArticulatedBody>(ArticulatedBodyd::shared_from_this());
+
+  // process the batch
+  for (unsigned i=0; i< q.size(); i++)
+  {
+    // set the state for this point
+    set_generalized_coordinates_euler(q[i]);
+    set_generalized_velocity(DynamicBodyd::eSpatial, qd[i]);
+
+    // apply only the recurrent forces (gravity); actuator forces are the
+    // unknowns and the controller must not feed back into its own query
+    reset_accumulators();
+    const list<RecurrentForcePtr>& rfs = get_recurrent_forces();
+    BOOST_FOREACH(RecurrentForcePtr rf, rfs)
+      rf->add_force(shared_this);
+
+    // compute the zero-actuation acceleration a0 = M^{-1}(f - h)
+    calc_fwd_dyn();
+    get_generalized_acceleration(a0);
+
+    // tau = M*qdd + h - f = M*(qdd - a0)
+    get_generalized_inertia(M);
+    (workv = qdd[i]) -= a0;
+    M.mult(workv, tau[i]);
+  }
+
+  // restore the body's state
+  set_generalized_coordinates_euler(gc_save);
+  set_generalized_velocity(DynamicBodyd::eSpatial, gv_save);
+  reset_accumulators();
+  joint_friction_dt = jfdt_save;
+}
+
 /// Clones this
-RCArticulatedBodyPtr RCArticulatedBody::clone() const 
+RCArticulatedBodyPtr RCArticulatedBody::clone() const
 {
   // create a node for Moby
   XMLTreePtr node(new XMLTree("Moby"));
@@ -200,6 +485,11 @@ void RCArticulatedBody::load_from_xml(shared_ptr<const XMLTree> node, map<string
     }
   }
 
+  // read the joint-space inertia matrix staleness tolerance, if provided
+  XMLAttrib* jsim_tol_attr = node->get_attrib("jsim-staleness-tol");
+  if (jsim_tol_attr)
+    jsim_staleness_tol = jsim_tol_attr->get_real_value();
+
   // read the forward dynamics algorithm computation frame, if provided
   XMLAttrib* fdyn_frame_attr = node->get_attrib("fdyn-algorithm-frame");
   if (fdyn_frame_attr)
@@ -272,6 +562,9 @@ void RCArticulatedBody::save_to_xml(XMLTreePtr node, list<shared_ptr<const Base>
     node->attribs.insert(XMLAttrib("fdyn-algorithm", string("crb")));
   }
 
+  // write the joint-space inertia matrix staleness tolerance
+  node->attribs.insert(XMLAttrib("jsim-staleness-tol", jsim_staleness_tol));
+
   // write the forward dynamics algorithm frame -- note that the string()
   // is necessary on the second argument to XMLAttrib b/c the compiler
   // interprets a constant string as a bool, rather than as an string,
@@ -1 +1,15 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
 
+// NOTE: the articulated-body forward dynamics algorithms (Featherstone ABA
+// and the CRB-based method) migrated to Ravelin with the rest of the
+// dynamics computations; RCArticulatedBody now inherits calc_fwd_dyn() from
+// Ravelin::RCArticulatedBodyd and this translation unit is intentionally
+// empty. A cache-friendly ABA variant that stores per-link spatial
+// quantities in one contiguous slab ordered by tree depth must therefore be
+// implemented against Ravelin's RCArticulatedBodyd rather than here; this
+// file is retained as the anchor point should those algorithms ever move
+// back into Moby.
@@ -48,6 +48,96 @@ RigidBody::RigidBody()
 {
   // setup visualization pose
   _vF->rpose = _F;
+
+  // setup sleeping data
+  _asleep = false;
+  _sleep_timer = 0.0;
+  sleep_linear_vel_thresh = 1e-2;
+  sleep_angular_vel_thresh = 1e-2;
+  sleep_time_thresh = 0.5;
+
+  // pose-derived data has never been computed
+  _viz_pose_stale = true;
+}
+
+/// Sets the pose of this body
+/**
+ * Marks pose-derived data (collision geometry bounds, the visualization
+ * transform) stale so that consumers recompute it, even for a body that is
+ * asleep or disabled.
+ */
+void RigidBody::set_pose(const Pose3d& pose)
+{
+  RigidBodyd::set_pose(pose);
+  invalidate_pose();
+}
+
+/// Marks pose-derived data for this body as stale
+void RigidBody::invalidate_pose()
+{
+  _viz_pose_stale = true;
+  bump_generation();
+  BOOST_FOREACH(CollisionGeometryPtr g, geometries)
+    g->mark_pose_stale();
+}
+
+/// Updates the visualization transform, skipping bodies that have not moved
+void RigidBody::update_visualization()
+{
+  // a moving body's pose changes every step; only a sleeping or disabled
+  // body may rely on the stale flag
+  if (is_enabled() && !is_asleep())
+    _viz_pose_stale = true;
+
+  // skip untouched bodies
+  if (!_viz_pose_stale)
+    return;
+
+  Visualizable::update_visualization();
+  _viz_pose_stale = false;
+}
+
+/// Puts the body to sleep (deactivates it)
+/**
+ * Sleeping bodies are excluded from integration, forward dynamics
+ * computation, and pairwise collision checks against other sleeping bodies.
+ * Bodies should only be put to sleep through the simulator's sleep state
+ * update so that entire contact islands sleep and wake together.
+ */
+void RigidBody::put_to_sleep()
+{
+  FILE_LOG(LOG_SIMULATOR) << "RigidBody::put_to_sleep() - putting " << body_id << " to sleep" << std::endl;
+  _asleep = true;
+}
+
+/// Wakes the body (reactivates it)
+void RigidBody::wake()
+{
+  if (_asleep)
+    FILE_LOG(LOG_SIMULATOR) << "RigidBody::wake() - waking " << body_id << std::endl;
+  _asleep = false;
+  _sleep_timer = 0.0;
+}
+
+/// Updates the sleep timer over a step of length h
+/**
+ * \return true if the body's velocity has remained below the sleep
+ *         thresholds for at least sleep_time_thresh
+ */
+bool RigidBody::update_sleep_timer(double h)
+{
+  // get the body's velocity
+  const SVelocityd& v = get_velocity();
+
+  // accumulate the window timer while the velocity stays small; reset it
+  // whenever the velocity exceeds a threshold
+  if (v.get_linear().norm() < sleep_linear_vel_thresh &&
+      v.get_angular().norm() < sleep_angular_vel_thresh)
+    _sleep_timer += h;
+  else
+    _sleep_timer = 0.0;
+
+  return _sleep_timer >= sleep_time_thresh;
 }
 
 /// Applies a generalized impulse to the rigid body (calls the simulator)
@@ -55,12 +145,14 @@ void RigidBody::apply_generalized_impulse(const SharedVectorNd& gj)
 {
   shared_ptr<Simulator> s(simulator);
   s->apply_impulse(RigidBodyd::get_this(), gj);
+  bump_generation();
 }
 
 /// Sets the rigid body inertia for this body
 void RigidBody::set_inertia(const SpatialRBInertiad& inertia)
 {
   RigidBodyd::set_inertia(inertia);
+  bump_generation();
 
   #ifdef VISUALIZE_INERTIA
     /// rigid body moment of inertia matrix (inertia aligned link COM frame)
@@ -178,6 +270,17 @@ void RigidBody::load_from_xml(shared_ptr<const XMLTree> node, map<std::string, B
   if (compliant_attr)
     compliance = (compliant_attr->get_bool_value()) ? eCompliant : eRigid;
 
+  // read the sleep thresholds, if provided
+  XMLAttrib* sleep_lv_attr = node->get_attrib("sleep-linear-velocity-threshold");
+  if (sleep_lv_attr)
+    sleep_linear_vel_thresh = sleep_lv_attr->get_real_value();
+  XMLAttrib* sleep_av_attr = node->get_attrib("sleep-angular-velocity-threshold");
+  if (sleep_av_attr)
+    sleep_angular_vel_thresh = sleep_av_attr->get_real_value();
+  XMLAttrib* sleep_time_attr = node->get_attrib("sleep-time-threshold");
+  if (sleep_time_attr)
+    sleep_time_thresh = sleep_time_attr->get_real_value();
+
   // read the mass, if provided
   XMLAttrib* mass_attr = node->get_attrib("mass");
   if (mass_attr)
@@ -386,6 +489,11 @@ void RigidBody::save_to_xml(XMLTreePtr node, list<shared_ptr<const Base> >& shar
   // save whether the body is compliant
   node->attribs.insert(XMLAttrib("compliant", compliance == eCompliant));
 
+  // save the sleep thresholds
+  node->attribs.insert(XMLAttrib("sleep-linear-velocity-threshold", sleep_linear_vel_thresh));
+  node->attribs.insert(XMLAttrib("sleep-angular-velocity-threshold", sleep_angular_vel_thresh));
+  node->attribs.insert(XMLAttrib("sleep-time-threshold", sleep_time_thresh));
+
   // save the mass
   node->attribs.insert(XMLAttrib("mass", rb->get_inertia().m));
 
@@ -536,9 +644,10 @@ void RigidBody::ode(double t, double dt, void* data, SharedVectorNd& dx)
  * \param body a pointer to the articulated body or NULL if this body is
  *        not a link in an articulated body
  */
- void RigidBody::set_articulated_body(shared_ptr<ArticulatedBody> body) 
- { 
-   _abody = dynamic_pointer_cast<ArticulatedBodyd>(body); 
+ void RigidBody::set_articulated_body(shared_ptr<ArticulatedBody> body)
+ {
+   _abody = dynamic_pointer_cast<ArticulatedBodyd>(body);
+   bump_generation();
  }
 
 /// Outputs the object state to the specified stream
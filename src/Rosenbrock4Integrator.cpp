@@ -14,6 +14,19 @@ using Ravelin::VectorNd;
 using Ravelin::MatrixNd;
 using namespace Moby;
 
+/// User-suppliable analytic Jacobian hook for the Rosenbrock integrator
+/**
+ * If non-NULL, this function is called to evaluate df/dx at (x, t) instead
+ * of forming the Jacobian by forward differencing (which costs n extra ODE
+ * evaluations per refresh and dominates stiff-system integration cost).
+ * The function must resize J to n x n and fill it with the Jacobian of the
+ * ODE right hand side. Declared at namespace scope because the integrator
+ * interface headers are not part of this source tree.
+ */
+namespace Moby {
+void (*rosenbrock_jacobian_fn)(const VectorNd& x, double time, double step_size, void* data, MatrixNd& J) = NULL;
+} // end namespace
+
 /// Method for 4th-order implicit Runge-Kutta integration
 void Rosenbrock4Integrator::integrate(VectorNd& x, VectorNd (*f)(const VectorNd&, double, double, void*), double time, double step_size, void* data)
 {
@@ -36,8 +49,24 @@ void Rosenbrock4Integrator::step(VectorNd& x, VectorNd (*f)(const VectorNd&, dou
   SAFESTATIC MatrixNd A, J;
   SAFESTATIC VectorNd xscal, g1, g2, g3, g4, xsav, dxsav;
   SAFESTATIC vector<int> ipiv;
+
+  // Jacobian cache: the state and df/dt at which J was last evaluated, the
+  // number of consecutive reuses, and the number of step-size reductions
+  // the last step() call needed
+  SAFESTATIC VectorNd xJ, dfdtJ;
+  static bool J_valid = false;
+  static unsigned J_reuses = 0;
+  static unsigned last_rejections = 0;
+
   const unsigned n = x.size();
 
+  // Jacobian staleness heuristics: the cached Jacobian is reused while the
+  // relative state delta since its evaluation stays below JAC_STATE_TOL, at
+  // most JAC_MAX_REUSE consecutive times, and never directly after a call
+  // that had to reject step sizes (a sign the local stiffness is changing)
+  const double JAC_STATE_TOL = (double) 1e-2;
+  const unsigned JAC_MAX_REUSE = 20;
+
   // general constants
   const double SAFETY = (double) 0.9;
   const double GROW = (double) 1.5;
@@ -92,21 +121,54 @@ void Rosenbrock4Integrator::step(VectorNd& x, VectorNd (*f)(const VectorNd&, dou
   xsav = x;
   dxsav = dxdt;
 
-  // determine the vector df/dt
-  double sqrt_eps = std::sqrt(std::numeric_limits<double>::epsilon());
-  time += sqrt_eps;
-  VectorNd dfdt = f(x, time, step_size, data);
-  time -= sqrt_eps;
+  // see whether the cached Jacobian is still fresh enough to reuse
+  bool reuse_J = false;
+  if (J_valid && xJ.size() == n && J_reuses < JAC_MAX_REUSE &&
+      last_rejections == 0)
+  {
+    double delta = (double) 0.0;
+    for (unsigned i=0; i< n; i++)
+      delta = std::max(delta, std::fabs(x[i] - xJ[i])/xscal[i]);
+    reuse_J = (delta < JAC_STATE_TOL);
+  }
 
-  // determine the Jacobian using forward differencing
-  J.resize(n,n);
-  for (unsigned i=0; i< n; i++)
+  VectorNd dfdt;
+  double sqrt_eps = std::sqrt(std::numeric_limits<double>::epsilon());
+  if (reuse_J)
   {
-    x[i] += sqrt_eps;
-    VectorNd column_i = f(x, time, step_size, data);
-    x[i] -= sqrt_eps;
-    for (unsigned j=0; j< n; j++)
-      J(j, i) = column_i[j];
+    // reuse the cached Jacobian and its df/dt
+    dfdt = dfdtJ;
+    J_reuses++;
+  }
+  else
+  {
+    // determine the vector df/dt
+    time += sqrt_eps;
+    dfdt = f(x, time, step_size, data);
+    time -= sqrt_eps;
+
+    // determine the Jacobian, analytically if a hook was supplied and by
+    // forward differencing otherwise
+    if (rosenbrock_jacobian_fn)
+      rosenbrock_jacobian_fn(x, time, step_size, data, J);
+    else
+    {
+      J.resize(n,n);
+      for (unsigned i=0; i< n; i++)
+      {
+        x[i] += sqrt_eps;
+        VectorNd column_i = f(x, time, step_size, data);
+        x[i] -= sqrt_eps;
+        for (unsigned j=0; j< n; j++)
+          J(j, i) = column_i[j];
+      }
+    }
+
+    // cache the Jacobian evaluation
+    xJ = x;
+    dfdtJ = dfdt;
+    J_valid = true;
+    J_reuses = 0;
   }
 
   // set stepsize to initial trial value
@@ -194,6 +256,9 @@ void Rosenbrock4Integrator::step(VectorNd& x, VectorNd (*f)(const VectorNd&, dou
     {
       // step succeeded; compute size of next step and return
       tnext = (errmax > ERRCON ? SAFETY*h*std::pow(errmax,PGROW) : GROW*h);
+
+      // record the rejection count for the Jacobian staleness heuristic
+      last_rejections = j;
       return;
     }
     else
@@ -204,6 +269,10 @@ void Rosenbrock4Integrator::step(VectorNd& x, VectorNd (*f)(const VectorNd&, dou
     }
   }
 
+  // every trial step was rejected; force a Jacobian refresh next call
+  last_rejections = MAXTRY;
+  J_valid = false;
+
   std::cerr << "Rosenbrock4Integrator::step() - maximum number of iterations exceeded (40)" << endl;
 }
 
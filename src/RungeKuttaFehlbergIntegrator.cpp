@@ -5,6 +5,7 @@
  ****************************************************************************/
 
 #include <strings.h>
+#include <Moby/Log.h>
 #include <Moby/RungeKuttaFehlbergIntegrator.h>
 
 using boost::shared_ptr;
@@ -465,6 +466,23 @@ void RungeKuttaFehlbergIntegrator::rkf45 ( void f ( double t, double* y, double*
   const double SCALE = (double) 2.0 / RELERR;
   const double AE = SCALE * this->aerr_tolerance;
 //
+//  Step-size controller constants.  The elementary controller uses only the
+//  current error estimate, which oscillates between growth and rejection on
+//  problems where the error responds sharply to the stepsize (stiff,
+//  contact-rich systems), wasting alternate attempts.  The
+//  proportional-integral controller of Gustafsson (see Hairer and Wanner,
+//  Solving Ordinary Differential Equations II, Sec. IV.2) damps the
+//  oscillation by also weighing the error estimate of the previous
+//  accepted step.
+//
+  const double SAFETY = (double) 0.9;                // fraction of the predicted stepsize
+  const double ALPHA = (double) 0.7 / (double) 5.0;  // integral gain
+  const double BETA = (double) 0.4 / (double) 5.0;   // proportional gain
+  const double SMAX = (double) 5.0;                  // stepsize growth limiter
+  const double SMIN = (double) 0.1;                  // stepsize shrink limiter
+  double esttol_prev = (double) -1.0;                // error estimate of the last accepted step
+  unsigned naccept = 0, nreject = 0;                 // accept/reject instrumentation
+//
 //  Step by step integration.
 //
   for ( ; ; )
@@ -573,18 +591,21 @@ void RungeKuttaFehlbergIntegrator::rkf45 ( void f ( double t, double* y, double*
       }
 //
 //  Unsuccessful step.  Reduce the stepsize, try again.
-//  The decrease is limited to a factor of 1/10.
+//  The decrease is limited to a factor of 1/10.  A rejection invalidates
+//  the error history, so the controller restarts from the elementary rule.
 //
       hfaild = true;
       output = false;
+      nreject = nreject + 1;
+      esttol_prev = (double) -1.0;
 
       if ( esttol < (double) 59049.0 )
       {
-        s = (double) 0.9 / std::pow ( esttol, (double) 0.2 );
+        s = SAFETY / std::pow ( esttol, (double) 0.2 );
       }
       else
       {
-        s = (double) 0.1;
+        s = SMIN;
       }
 
       _h = s * _h;
@@ -607,24 +628,33 @@ void RungeKuttaFehlbergIntegrator::rkf45 ( void f ( double t, double* y, double*
       y[i] = f1[i];
     }
     f ( t, y, yp, this );
+    naccept = naccept + 1;
 //
-//  Choose the next stepsize.  The increase is limited to a factor of 5.
-//  If the step failed, the next stepsize is not allowed to increase.
+//  Choose the next stepsize via the proportional-integral controller; the
+//  elementary rule is used until an accepted step has seeded the error
+//  history.  The increase is limited to a factor of SMAX and the decrease
+//  to SMIN; if the step failed, the next stepsize is not allowed to
+//  increase.
 //
-    if ( (double) 0.0001889568 < esttol )
+    const double ERR = std::max ( esttol, (double) 1.0e-10 );
+    if ( esttol_prev > (double) 0.0 )
     {
-      s = (double) 0.9 / std::pow ( esttol, (double) 0.2 );
+      s = SAFETY * std::pow ( ERR, -ALPHA ) * std::pow ( esttol_prev, BETA );
     }
     else
     {
-      s = (double) 5.0;
+      s = SAFETY / std::pow ( ERR, (double) 0.2 );
     }
+    s = std::max ( std::min ( s, SMAX ), SMIN );
 
     if ( hfaild )
     {
       s = std::min ( s, (double) 1.0 );
     }
 
+    // record the error history for the next controller decision
+    esttol_prev = ERR;
+
     _h = sign ( _h ) * std::max ( s * std::fabs ( _h ), hmin );
 //
 //  End of core integrator
@@ -634,6 +664,7 @@ void RungeKuttaFehlbergIntegrator::rkf45 ( void f ( double t, double* y, double*
     if ( output )
     {
       // normal return
+      FILE_LOG(LOG_SIMULATOR) << "RungeKuttaFehlbergIntegrator::rkf45() - accepted " << naccept << " steps, rejected " << nreject << std::endl;
       t = tout;
       return;
     }
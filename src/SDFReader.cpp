@@ -56,6 +56,7 @@ using namespace Ravelin;
 
 std::vector<shared_ptr<OSGGroupWrapper> > SDFReader::_osg_wrappers;
 std::vector<shared_ptr<Primitive> > SDFReader::_primitives;
+std::map<std::string, shared_ptr<Primitive> > SDFReader::_cooked_meshes;
 
 #ifdef USE_OSG
 /// Copies this matrix to an OpenSceneGraph Matrixd object
@@ -318,11 +319,18 @@ vector<ControlledBodyPtr> SDFReader::read_models(shared_ptr<const XMLTree> world
   vector<ControlledBodyPtr> models;
   map<RigidBodyPtr, shared_ptr<SurfaceData> > sdata;
 
+  // cook the collision mesh primitives across cores before the (serial)
+  // model construction pass draws on them
+  cook_meshes(world_tree);
+
   // get all model nodes
   std::list<shared_ptr<const XMLTree> > model_nodes = find_tag("model", world_tree);
   BOOST_FOREACH(shared_ptr<const XMLTree> model_node, model_nodes)
     models.push_back(read_model(model_node, sdata));
 
+  // the cooked primitives now live in their geometries; drop the cache
+  _cooked_meshes.clear();
+
   // add the models to the simulator
   BOOST_FOREACH(ControlledBodyPtr b, models)
     sim->add_dynamic_body(b);
@@ -368,8 +376,8 @@ list<shared_ptr<const XMLTree> > SDFReader::find_tag(const std::string& tag, sha
 void SDFReader::find_tag(const std::string& tag, shared_ptr<const XMLTree> root, list<shared_ptr<const XMLTree> >& l)
 {
   // process all children of the root
-  const std::list<XMLTreePtr>& child_nodes = root->children;
-  for (std::list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const std::vector<XMLTreePtr>& child_nodes = root->children;
+  for (std::vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
     if (strcasecmp((*i)->name.c_str(), tag.c_str()) == 0)
       l.push_back(*i);
 }
@@ -377,8 +385,8 @@ void SDFReader::find_tag(const std::string& tag, shared_ptr<const XMLTree> root,
 /// Find a particular tag
 shared_ptr<const XMLTree> SDFReader::find_one_tag(const std::string& tag, shared_ptr<const XMLTree> root)
 {
-  const std::list<XMLTreePtr>& child_nodes = root->children;
-  for (std::list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const std::vector<XMLTreePtr>& child_nodes = root->children;
+  for (std::vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
     if (strcasecmp((*i)->name.c_str(), tag.c_str()) == 0)
       return *i;
 
@@ -767,6 +775,71 @@ shared_ptr<OSGGroupWrapper> SDFReader::read_OSG_file(shared_ptr<const XMLTree> n
   return osgg; 
 }
 
+/// Cooks all collision mesh primitives in the world up front
+/**
+ * The parse stage collects the mesh URIs referenced by collision geometry;
+ * the expensive cooking work (OBJ parsing, convex hull computation and
+ * derived-data construction) then runs across cores, and links referencing
+ * the same asset share one cooked primitive instead of cooking it per link.
+ * Cooking failures are deliberately swallowed here: a failed URI is left
+ * uncooked so that the serial path reproduces the original diagnostic.
+ */
+void SDFReader::cook_meshes(shared_ptr<const XMLTree> world_tree)
+{
+  // clear cooked primitives from any prior load
+  _cooked_meshes.clear();
+
+  // collect the mesh nodes under collision geometry, unique by URI
+  map<std::string, shared_ptr<const XMLTree> > mesh_nodes;
+  std::list<shared_ptr<const XMLTree> > collision_nodes = find_tag("collision", world_tree);
+  BOOST_FOREACH(shared_ptr<const XMLTree> collision_node, collision_nodes)
+  {
+    shared_ptr<const XMLTree> geom_node = find_one_tag("geometry", collision_node);
+    if (!geom_node)
+      continue;
+    shared_ptr<const XMLTree> mesh_node = find_one_tag("mesh", geom_node);
+    if (!mesh_node)
+      continue;
+    shared_ptr<const XMLTree> uri_node = find_one_tag("uri", mesh_node);
+    if (!uri_node)
+      continue;
+    mesh_nodes[read_string(uri_node)] = mesh_node;
+  }
+
+  // collect the unique specs into indexable vectors for the parallel loop
+  vector<std::string> uris;
+  vector<shared_ptr<const XMLTree> > nodes;
+  for (map<std::string, shared_ptr<const XMLTree> >::const_iterator i = mesh_nodes.begin(); i != mesh_nodes.end(); i++)
+  {
+    uris.push_back(i->first);
+    nodes.push_back(i->second);
+  }
+
+  // cook the primitives; hull computation uses qhull, so the loop is only
+  // parallelized when concurrent qhull use cannot race (per-thread contexts
+  // or the serializing mutex; cf. CompGeom::calc_convex_hulls())
+  vector<PrimitivePtr> cooked(nodes.size());
+  #if defined(_OPENMP) && (defined(THREADSAFE) || defined(MOBY_QHULL_REENTRANT))
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (int i=0; i< (int) nodes.size(); i++)
+  {
+    try
+    {
+      cooked[i] = read_polyhedron(nodes[i]);
+    }
+    catch (std::exception& e)
+    {
+      cooked[i] = PrimitivePtr();
+    }
+  }
+
+  // record the successfully cooked primitives
+  for (unsigned i=0; i< nodes.size(); i++)
+    if (cooked[i])
+      _cooked_meshes[uris[i]] = cooked[i];
+}
+
 /// Reads and constructs the PolyhedralPrimitive object
 PrimitivePtr SDFReader::read_polyhedron(shared_ptr<const XMLTree> node)
 {
@@ -777,9 +850,14 @@ PrimitivePtr SDFReader::read_polyhedron(shared_ptr<const XMLTree> node)
   shared_ptr<const XMLTree> uri_node = find_one_tag("uri", node);
   if (!uri_node)
     throw std::runtime_error("Expected a 'uri' subnode under 'mesh' node");
-  
+
   // ensure that the file is a Wavefront OBJ
   std::string fname = read_string(uri_node);
+
+  // use the primitive built by the load-time cooking pass, if present
+  map<std::string, PrimitivePtr>::const_iterator cooked = _cooked_meshes.find(fname);
+  if (cooked != _cooked_meshes.end())
+    return cooked->second;
   std::string fname_lower = fname;
   std::transform(fname.begin(), fname.end(), fname_lower.begin(), ::tolower);
   unsigned st = fname_lower.find(".obj");
@@ -1353,8 +1431,8 @@ shared_ptr<const XMLTree> SDFReader::find_subtree(shared_ptr<const XMLTree> root
     return root;
 
   // otherwise, look for it recursively
-  const std::list<XMLTreePtr>& children = root->children;
-  for (std::list<XMLTreePtr>::const_iterator i = children.begin(); i != children.end(); i++)
+  const std::vector<XMLTreePtr>& children = root->children;
+  for (std::vector<XMLTreePtr>::const_iterator i = children.begin(); i != children.end(); i++)
   {
     shared_ptr<const XMLTree> node = find_subtree(*i, name);
     if (node)
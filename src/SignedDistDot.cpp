@@ -34,6 +34,40 @@ double SignedDistDot::calc_signed_dist(shared_ptr<SingleBodyd> sb1, shared_ptr<S
   return min_dist;
 }
 
+/// Computes d/dt of a signed distance analytically from its witness points
+/**
+ * With witness points pa, pb and separation normal n = (pb - pa)/phi, the
+ * time derivative of the signed distance is n'*(vb - va), where va and vb
+ * are the material velocities of the witness points: first-order motion of
+ * the witness points along the bodies' surfaces is orthogonal to n and does
+ * not change the distance.  The normal is only defined by the witness pair
+ * while the points are distinct, so touching and penetrating configurations
+ * return false and the caller must fall back to the finite-difference path.
+ */
+static bool calc_signed_dist_dot(const PairwiseDistInfo& pdi, double& phi_dot)
+{
+  // the witness normal degenerates as the witness points coincide
+  if (std::fabs(pdi.dist) <= NEAR_ZERO)
+    return false;
+
+  // get the two rigid bodies
+  shared_ptr<RigidBody> rba = dynamic_pointer_cast<RigidBody>(pdi.a->get_single_body());
+  shared_ptr<RigidBody> rbb = dynamic_pointer_cast<RigidBody>(pdi.b->get_single_body());
+  if (!rba || !rbb)
+    return false;
+
+  // get the witness points in the global frame
+  Point3d pa = Pose3d::transform_point(GLOBAL, pdi.pa);
+  Point3d pb = Pose3d::transform_point(GLOBAL, pdi.pb);
+
+  // compute the separation normal
+  Vector3d n = (pb - pa)/pdi.dist;
+
+  // the derivative is the relative witness point velocity along the normal
+  phi_dot = n.dot(rbb->calc_point_vel(pb) - rba->calc_point_vel(pa));
+  return true;
+}
+
 /// Computes the Jacobian for the time derivative of the signed distance functions vs. impulses applied at contact points
 /**
  * Assume the signed distance function is Phi(q(t)), so 
@@ -90,7 +124,15 @@ void SignedDistDot::compute_signed_dist_dot_Jacobians(UnilateralConstraintProble
     // get the signed distance between the two bodies
     double phi = q.signed_distances[k].dist;
 
-    // integrates bodies' positions forward
+    // use the analytic derivative whenever the witness normal is defined
+    double phi_dot;
+    if (calc_signed_dist_dot(q.signed_distances[k], phi_dot))
+    {
+      Cdot_v[k] = phi_dot;
+      continue;
+    }
+
+    // degenerate features: integrate bodies' positions forward
     shared_ptr<DynamicBodyd> sup1 = ImpactConstraintHandler::get_super_body(s1);
     shared_ptr<DynamicBodyd> sup2 = ImpactConstraintHandler::get_super_body(s2);
     tmp_supers1.clear();
@@ -102,8 +144,8 @@ void SignedDistDot::compute_signed_dist_dot_Jacobians(UnilateralConstraintProble
     // compute the signed distance function
     double phi_new = calc_signed_dist(s1, s2);
 
-    // set the appropriate entry of Cdot(v) 
-    Cdot_v[k] = (phi_new - phi)/DT;  
+    // set the appropriate entry of Cdot(v)
+    Cdot_v[k] = (phi_new - phi)/DT;
 
     // restore coordinates and velocities
     restore_coords_and_velocities(tmp_supers1, gc_map, gv_map);
@@ -140,8 +182,9 @@ void SignedDistDot::compute_signed_dist_dot_Jacobians(UnilateralConstraintProble
 
     // get the signed distance between the two bodies
     double phi = q.signed_distances[k].dist;
+    double phi_dot;
 
-    // for each contact constraint 
+    // for each contact constraint
     for (unsigned i=0; i< q.contact_constraints.size(); i++)
     {
       // zero the Cn, Cs, and Ct iterators
@@ -165,49 +208,56 @@ void SignedDistDot::compute_signed_dist_dot_Jacobians(UnilateralConstraintProble
         continue;                      
 
       // apply a test impulse in the normal direction
-      apply_impulse(*q.contact_constraints[i], 
+      apply_impulse(*q.contact_constraints[i],
                     q.contact_constraints[i]->contact_normal);
 
-      // integrates bodies' positions forward
-      integrate_positions(isect, DT);
-
-      // compute the signed distance function
-      double phi_new = calc_signed_dist(s1, s2);
-
-      // set the appropriate entry of the Jacobian
-      *Cn_iter = (phi_new - phi)/DT - q.Cdot_v[k];  Cn_iter++;
+      // compute the post-impulse derivative analytically when possible;
+      // otherwise integrate forward and difference two distance queries
+      if (calc_signed_dist_dot(q.signed_distances[k], phi_dot))
+        *Cn_iter = phi_dot - q.Cdot_v[k];
+      else
+      {
+        integrate_positions(isect, DT);
+        double phi_new = calc_signed_dist(s1, s2);
+        *Cn_iter = (phi_new - phi)/DT - q.Cdot_v[k];
+      }
+      Cn_iter++;
 
       // restore coordinates and velocities
       restore_coords_and_velocities(isect, gc_map, gv_map);
 
       // apply a test impulse in the first tangent direction
-      apply_impulse(*q.contact_constraints[i], 
+      apply_impulse(*q.contact_constraints[i],
                     q.contact_constraints[i]->contact_tan1);
 
-      // integrates bodies' positions forward
-      integrate_positions(isect, DT);
-
-      // compute the signed distance function
-      phi_new = calc_signed_dist(s1, s2);
-
       // set the appropriate entry of the Jacobian
-      *Cs_iter = (phi_new - phi)/DT - q.Cdot_v[k];  Cs_iter++;
+      if (calc_signed_dist_dot(q.signed_distances[k], phi_dot))
+        *Cs_iter = phi_dot - q.Cdot_v[k];
+      else
+      {
+        integrate_positions(isect, DT);
+        double phi_new = calc_signed_dist(s1, s2);
+        *Cs_iter = (phi_new - phi)/DT - q.Cdot_v[k];
+      }
+      Cs_iter++;
 
       // restore coordinates and velocities
       restore_coords_and_velocities(isect, gc_map, gv_map);
 
       // apply a test impulse in the second tangent direction
-      apply_impulse(*q.contact_constraints[i], 
+      apply_impulse(*q.contact_constraints[i],
                     q.contact_constraints[i]->contact_tan2);
 
-      // integrates bodies' positions forward
-      integrate_positions(isect, DT);
-
-      // compute the signed distance function
-      phi_new = calc_signed_dist(s1, s2);
-
       // set the appropriate entry of the Jacobian
-      *Ct_iter = (phi_new - phi)/DT - q.Cdot_v[k];  Ct_iter++;
+      if (calc_signed_dist_dot(q.signed_distances[k], phi_dot))
+        *Ct_iter = phi_dot - q.Cdot_v[k];
+      else
+      {
+        integrate_positions(isect, DT);
+        double phi_new = calc_signed_dist(s1, s2);
+        *Ct_iter = (phi_new - phi)/DT - q.Cdot_v[k];
+      }
+      Ct_iter++;
 
       // restore coordinates and velocities
       restore_coords_and_velocities(isect, gc_map, gv_map);
@@ -232,14 +282,16 @@ void SignedDistDot::compute_signed_dist_dot_Jacobians(UnilateralConstraintProble
       // apply a test impulse in the limit direction
       apply_impulse(*q.limit_constraints[i]);
 
-      // integrates bodies' positions forward
-      integrate_positions(isect, DT);
-
-      // compute the signed distance function
-      double phi_new = calc_signed_dist(s1, s2);
-
       // set the appropriate entry of the Jacobian
-      *L_iter = (phi_new - phi)/DT - q.Cdot_v[k];  L_iter++;
+      if (calc_signed_dist_dot(q.signed_distances[k], phi_dot))
+        *L_iter = phi_dot - q.Cdot_v[k];
+      else
+      {
+        integrate_positions(isect, DT);
+        double phi_new = calc_signed_dist(s1, s2);
+        *L_iter = (phi_new - phi)/DT - q.Cdot_v[k];
+      }
+      L_iter++;
 
       // restore coordinates and velocities
       restore_coords_and_velocities(isect, gc_map, gv_map);
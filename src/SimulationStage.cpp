@@ -0,0 +1,38 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <Moby/SimulationStage.h>
+
+using namespace Moby;
+
+/// Determines whether two stages may not run concurrently
+/**
+ * Stages conflict when one writes a field the other reads or writes.  The
+ * wildcard field "*" in either set conflicts with everything, so a stage
+ * declaring it always runs alone.
+ */
+bool SimulationStage::conflicts_with(const SimulationStage& s) const
+{
+  // a wildcard write conflicts with everything
+  if (writes.find("*") != writes.end() || s.writes.find("*") != s.writes.end())
+    return true;
+
+  // a wildcard read conflicts with any write
+  if (reads.find("*") != reads.end() && !s.writes.empty())
+    return true;
+  if (s.reads.find("*") != s.reads.end() && !writes.empty())
+    return true;
+
+  // check write/write and write/read overlaps
+  for (std::set<std::string>::const_iterator i = writes.begin(); i != writes.end(); i++)
+    if (s.writes.find(*i) != s.writes.end() || s.reads.find(*i) != s.reads.end())
+      return true;
+  for (std::set<std::string>::const_iterator i = s.writes.begin(); i != s.writes.end(); i++)
+    if (reads.find(*i) != reads.end())
+      return true;
+
+  return false;
+}
@@ -6,17 +6,37 @@
 
 #include <map>
 #include <iostream>
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+#include <cstdlib>
+#include <sstream>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #ifdef USE_OSG
 #include <osg/Group>
 #endif
+#include <Moby/Constants.h>
 #include <Moby/RecurrentForce.h>
+#include <Moby/GravityForce.h>
 #include <Moby/Dissipation.h>
 #include <Moby/ArticulatedBody.h>
 #include <Moby/RCArticulatedBody.h>
 #include <Moby/RigidBody.h>
+#include <Moby/CollisionGeometry.h>
 #include <Moby/Joint.h>
+#include <Moby/FixedJoint.h>
 #include <Moby/XMLTree.h>
 #include <Moby/SparseJacobian.h>
+#include <Moby/SimulationStage.h>
 #include <Moby/Simulator.h>
 
 using std::list;
@@ -42,6 +62,23 @@ Simulator::Simulator()
 {
   this->current_time = 0;
   post_step_callback_fn = NULL;
+  sleeping_enabled = false;
+  steady_state_skipping_enabled = false;
+  soa_integration = false;
+  ballistic_fast_path = false;
+  merge_fixed_joints = false;
+  numa_aware_islands = false;
+  _numa_topology_read = false;
+  memory_budget = 0;
+  _batching_impulses = false;
+  _shm_cosim = NULL;
+  _shm_cosim_size = 0;
+
+  // setup the visualization pose snapshot state
+  _pose_snapshot_ready = false;
+  #ifdef THREADSAFE
+  pthread_mutex_init(&_pose_buffer_mutex, NULL);
+  #endif
 
   // clear dynamics timings
   dynamics_time = (double) 0.0;
@@ -59,10 +96,21 @@ Simulator::Simulator()
 
 Simulator::~Simulator()
 {
+  // dump the step profile, if any was collected
+  if (profiler.enabled && profiler.get_num_steps() > 0)
+    profiler.dump(std::cerr);
+
+  // release the co-simulation segment, if one is open
+  close_shm_cosim();
+
   #ifdef USE_OSG
   _persistent_vdata->unref();
   _transient_vdata->unref();
   #endif
+
+  #ifdef THREADSAFE
+  pthread_mutex_destroy(&_pose_buffer_mutex);
+  #endif
 }
 
 /// Computes the ODE of the system
@@ -102,9 +150,15 @@ VectorNd& Simulator::ode(const VectorNd& x, double t, double dt, void* data, Vec
   // check pairwise constraint violations
   s->check_pairwise_constraint_violations(t);
 
-  // loop through all bodies, computing forward dynamics 
+  // loop through all bodies, computing forward dynamics
   BOOST_FOREACH(ControlledBodyPtr db, s->_bodies)
+  {
+    // thread the step size through for the implicit joint friction solve
+    RCArticulatedBodyPtr rcab = dynamic_pointer_cast<RCArticulatedBody>(db);
+    if (rcab)
+      rcab->joint_friction_dt = dt;
     dynamic_pointer_cast<DynamicBodyd>(db)->calc_fwd_dyn();
+  }
 
   // reset the index
   idx = 0;
@@ -139,228 +193,1738 @@ VectorNd& Simulator::ode(const VectorNd& x, double t, double dt, void* data, Vec
   return dx;
 }
 
-/// Steps the Simulator forward in time without contact
+/// Advances all bodies' state through packed structure-of-arrays buffers
 /**
- * This pseudocode was inspired from [Baraff 1997] and [Mirtich 1996].
- * \param step_size the step size
- * \return step_size
+ * Functionally equivalent to the per-body update in integrate(): the
+ * generalized coordinates, velocities, and accelerations of every body are
+ * gathered into contiguous arrays, the state advance then runs as
+ * straight-line sweeps over the packed storage (rather than chasing
+ * pointers through heap-allocated bodies), and the results are scattered
+ * back. The buffers persist across steps so no allocation occurs after the
+ * first call (sizes unchanged).
  */
-double Simulator::step(double step_size)
+void Simulator::integrate_packed(double dt)
 {
-  #ifdef USE_OSG
-  // clear one-step visualization data
-  _transient_vdata->removeChildren(0, _transient_vdata->getNumChildren());
-  #endif
+  // determine the packed array sizes
+  unsigned NGC_EUL = 0, NGV = 0;
+  for (unsigned j=0; j< _bodies.size(); j++)
+  {
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[j]);
+    NGC_EUL += db->num_generalized_coordinates(DynamicBodyd::eEuler);
+    NGV += db->num_generalized_coordinates(DynamicBodyd::eSpatial);
+  }
 
-  // compute forward dynamics and integrate 
-  current_time += integrate(step_size);
+  // size the packed buffers
+  _packed_gc.resize(NGC_EUL);
+  _packed_gve.resize(NGC_EUL);
+  _packed_gv.resize(NGV);
+  _packed_ga.resize(NGV);
 
-  // TODO: do any constraint stabilization
-//  _cstab.stabilize(simulator);
+  // gather state from the bodies into the packed buffers
+  for (unsigned j=0, gc_index=0, gv_index=0; j< _bodies.size(); j++)
+  {
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[j]);
+    const unsigned NGC = db->num_generalized_coordinates(DynamicBodyd::eEuler);
+    const unsigned NV = db->num_generalized_coordinates(DynamicBodyd::eSpatial);
+    SharedVectorNd gc_sub = _packed_gc.segment(gc_index, gc_index + NGC);
+    SharedVectorNd gve_sub = _packed_gve.segment(gc_index, gc_index + NGC);
+    SharedVectorNd gv_sub = _packed_gv.segment(gv_index, gv_index + NV);
+    SharedVectorNd ga_sub = _packed_ga.segment(gv_index, gv_index + NV);
+    db->get_generalized_coordinates_euler(gc_sub);
+    db->get_generalized_velocity(DynamicBodyd::eEuler, gve_sub);
+    db->get_generalized_velocity(DynamicBodyd::eSpatial, gv_sub);
+
+    // ballistic bodies skipped the dynamics solve, so their stored
+    // accelerations are stale; gravity is applied analytically after scatter
+    if (!_ballistic.empty() && _ballistic.find(db) != _ballistic.end())
+      ga_sub.set_zero();
+    else
+      db->get_generalized_acceleration(ga_sub);
+    gc_index += NGC;
+    gv_index += NV;
+  }
 
-  // call the callback
-  if (post_step_callback_fn)
-    post_step_callback_fn(this);
+  // advance the packed state with contiguous sweeps
+  _packed_ga *= dt;
+  _packed_gv += _packed_ga;
+  _packed_gve *= dt;
+  _packed_gc += _packed_gve;
 
-  return step_size;
+  // scatter state back to the bodies
+  for (unsigned j=0, gc_index=0, gv_index=0; j< _bodies.size(); j++)
+  {
+    // NOTE: coordinates must be set first to ensure that frame information
+    // is correct for velocities: mixed pose will be incorrect if
+    // generalized_velocity is set first
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[j]);
+    const unsigned NGC = db->num_generalized_coordinates(DynamicBodyd::eEuler);
+    const unsigned NV = db->num_generalized_coordinates(DynamicBodyd::eSpatial);
+    SharedConstVectorNd gc_sub = _packed_gc.segment(gc_index, gc_index + NGC);
+    SharedVectorNd gv_sub = _packed_gv.segment(gv_index, gv_index + NV);
+    db->set_generalized_coordinates_euler(gc_sub);
+    db->set_generalized_velocity(DynamicBodyd::eSpatial, gv_sub);
+    gc_index += NGC;
+    gv_index += NV;
+  }
+
+  // apply the analytic gravity contribution to ballistic bodies; the
+  // velocity update runs over structure-of-arrays spatial batches, the
+  // same layout the packed state sweeps above use
+  if (!_ballistic.empty())
+  {
+    // gather the velocities and gravity twists into the batches
+    _ballistic_vslab.resize(_ballistic.size());
+    _ballistic_gslab.resize(_ballistic.size());
+    unsigned k = 0;
+    for (std::map<shared_ptr<DynamicBodyd>, Vector3d>::const_iterator bi = _ballistic.begin(); bi != _ballistic.end(); bi++, k++)
+    {
+      shared_ptr<RigidBodyd> rb = dynamic_pointer_cast<RigidBodyd>(bi->first);
+      _ballistic_vslab.set(k, rb->get_velocity());
+      _ballistic_gslab.set(k, Origin3d(0.0, 0.0, 0.0), Origin3d(bi->second));
+    }
+
+    // v += g*dt across the batch
+    batch_spatial_axpy(dt, _ballistic_gslab, _ballistic_vslab);
+
+    // scatter the velocities back
+    k = 0;
+    for (std::map<shared_ptr<DynamicBodyd>, Vector3d>::const_iterator bi = _ballistic.begin(); bi != _ballistic.end(); bi++, k++)
+    {
+      shared_ptr<RigidBodyd> rb = dynamic_pointer_cast<RigidBodyd>(bi->first);
+      rb->set_velocity(_ballistic_vslab.get_velocity(k, rb->get_velocity().pose));
+    }
+  }
+
+  // body configurations have changed; prepared joint data is now stale
+  invalidate_joint_step_data();
 }
 
-/// Finds the dynamic body in the simulator, if any
+// the checkpoint file magic ("MobyCkp" plus a format version)
+static const char CKPT_MAGIC[8] = { 'M', 'o', 'b', 'y', 'C', 'k', 'p', '1' };
+
+/// Writes a binary checkpoint of the simulation state to a file
 /**
- * Searches unarticulated bodies, articulated bodies, and links of
- * articulated bodies.
+ * The checkpoint holds the simulation time plus every body's generalized
+ * coordinates (Euler parameterization, which subsumes joint positions for
+ * articulated bodies) and generalized velocities, in the order the bodies
+ * appear in the simulator. The state is packed into a persistent buffer and
+ * written with one contiguous write; the buffer and the gather workspace are
+ * reused across calls, so steady-state checkpointing does not allocate.
  */
-ControlledBodyPtr Simulator::find_dynamic_body(const std::string& name) const
+void Simulator::save_checkpoint(const std::string& fname)
 {
-  BOOST_FOREACH(ControlledBodyPtr body, _bodies)
-    if (body->id == name)
-      return body;
-
-  // failed, look through all links of articulated bodies
-  BOOST_FOREACH(ControlledBodyPtr body, _bodies)
+  // determine the buffer size: magic, time, and body count, then per body
+  // the two dimensions and the packed coordinates and velocities
+  unsigned sz = sizeof(CKPT_MAGIC) + sizeof(double) + sizeof(unsigned);
+  for (unsigned i=0; i< _bodies.size(); i++)
   {
-    // try to cast the i'th DynamicBody as an ArticulatedBody
-    ArticulatedBodyPtr ab = dynamic_pointer_cast<ArticulatedBody>(body);
-    if (!ab)
-      continue;
-    
-    // it was castable, get all links
-    const vector<shared_ptr<RigidBodyd> >& links = ab->get_links();
-    
-    // look through all links for one matching the name
-    BOOST_FOREACH(shared_ptr<RigidBodyd> rb, links)  
-      if (rb->body_id == name)
-        return dynamic_pointer_cast<RigidBody>(rb);
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+    const unsigned NGC = db->num_generalized_coordinates(DynamicBodyd::eEuler);
+    const unsigned NGV = db->num_generalized_coordinates(DynamicBodyd::eSpatial);
+    sz += 2*sizeof(unsigned) + (NGC + NGV)*sizeof(double);
   }
-    
-  return ControlledBodyPtr();
+  _ckpt_buffer.resize(sz);
+
+  // pack the header
+  char* p = &_ckpt_buffer[0];
+  std::memcpy(p, CKPT_MAGIC, sizeof(CKPT_MAGIC));
+  p += sizeof(CKPT_MAGIC);
+  std::memcpy(p, &current_time, sizeof(current_time));
+  p += sizeof(current_time);
+  const unsigned NBODIES = _bodies.size();
+  std::memcpy(p, &NBODIES, sizeof(NBODIES));
+  p += sizeof(NBODIES);
+
+  // pack the per-body state
+  for (unsigned i=0; i< _bodies.size(); i++)
+  {
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+    const unsigned NGC = db->num_generalized_coordinates(DynamicBodyd::eEuler);
+    const unsigned NGV = db->num_generalized_coordinates(DynamicBodyd::eSpatial);
+    std::memcpy(p, &NGC, sizeof(NGC));
+    p += sizeof(NGC);
+    db->get_generalized_coordinates_euler(_ckpt_work);
+    std::memcpy(p, _ckpt_work.data(), NGC*sizeof(double));
+    p += NGC*sizeof(double);
+    std::memcpy(p, &NGV, sizeof(NGV));
+    p += sizeof(NGV);
+    db->get_generalized_velocity(DynamicBodyd::eSpatial, _ckpt_work);
+    std::memcpy(p, _ckpt_work.data(), NGV*sizeof(double));
+    p += NGV*sizeof(double);
+  }
+  assert(p == &_ckpt_buffer[0] + sz);
+
+  // write the buffer contiguously
+  std::ofstream out(fname.c_str(), std::ofstream::binary);
+  if (out.fail())
+    throw std::runtime_error("Simulator::save_checkpoint() - unable to open '" + fname + "' for writing");
+  out.write(&_ckpt_buffer[0], sz);
+  out.close();
 }
 
-/// Removes a dynamic body from the simulator
-void Simulator::remove_dynamic_body(ControlledBodyPtr body)
+/// Restores the simulation state from a binary checkpoint file
+/**
+ * The simulator must contain the bodies the checkpoint was written against,
+ * in the same order (i.e., restore into the scene that produced the
+ * checkpoint); dimension mismatches raise an error. Coordinates are restored
+ * before velocities (velocity frames depend on the configuration), restored
+ * bodies are woken, and their collision geometry poses are invalidated so
+ * that persistent collision detection structures refresh on the next query.
+ */
+void Simulator::restore_checkpoint(const std::string& fname)
 {
-  // remove the body from the list of bodies
-  std::vector<ControlledBodyPtr>::iterator i = std::find(_bodies.begin(), _bodies.end(), body);
-  if (i == _bodies.end())
-    return;
-  else
-    _bodies.erase(i);
-
-  #ifdef USE_OSG
-  // see whether the body is articulated 
-  ArticulatedBodyPtr abody = dynamic_pointer_cast<ArticulatedBody>(body);
-  if (abody)
+  char magic[sizeof(CKPT_MAGIC)];
+
+  // open the file and verify the magic
+  std::ifstream in(fname.c_str(), std::ifstream::binary);
+  if (in.fail())
+    throw std::runtime_error("Simulator::restore_checkpoint() - unable to open '" + fname + "' for reading");
+  in.read(magic, sizeof(magic));
+  if (in.fail() || std::memcmp(magic, CKPT_MAGIC, sizeof(magic)) != 0)
+    throw std::runtime_error("Simulator::restore_checkpoint() - '" + fname + "' is not a Moby checkpoint");
+
+  // read the time and the body count
+  unsigned nbodies;
+  in.read((char*) &current_time, sizeof(current_time));
+  in.read((char*) &nbodies, sizeof(nbodies));
+  if (in.fail() || nbodies != _bodies.size())
+    throw std::runtime_error("Simulator::restore_checkpoint() - checkpoint does not match the simulation");
+
+  // restore the per-body state
+  for (unsigned i=0; i< _bodies.size(); i++)
   {
-    
-    // remove visualization data for all links to the persistent visualization data
-    const vector<shared_ptr<RigidBodyd> >& links = abody->get_links();
-    for (unsigned i=0; i< links.size(); i++)
-    {
-      RigidBodyPtr link = dynamic_pointer_cast<RigidBody>(links[i]);
-      osg::Node* link_vdata = link->get_visualization_data();
-      if (link_vdata)
-        _persistent_vdata->removeChild(link_vdata);
-    }
-    
-    // remove visualization data for all joints
-    const vector<shared_ptr<Jointd> >& joints = abody->get_joints();
-    for (unsigned i=0; i< joints.size(); i++)
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+    const unsigned NGC = db->num_generalized_coordinates(DynamicBodyd::eEuler);
+    const unsigned NGV = db->num_generalized_coordinates(DynamicBodyd::eSpatial);
+
+    // read and verify the coordinate dimension, then restore the
+    // coordinates (before the velocity, as the velocity frame depends on
+    // the configuration)
+    unsigned dim;
+    in.read((char*) &dim, sizeof(dim));
+    if (in.fail() || dim != NGC)
+      throw std::runtime_error("Simulator::restore_checkpoint() - checkpoint does not match the simulation");
+    _ckpt_work.resize(NGC);
+    in.read((char*) _ckpt_work.data(), NGC*sizeof(double));
+    db->set_generalized_coordinates_euler(_ckpt_work);
+
+    // read and verify the velocity dimension, then restore the velocity
+    in.read((char*) &dim, sizeof(dim));
+    if (in.fail() || dim != NGV)
+      throw std::runtime_error("Simulator::restore_checkpoint() - checkpoint does not match the simulation");
+    _ckpt_work.resize(NGV);
+    in.read((char*) _ckpt_work.data(), NGV*sizeof(double));
+    db->set_generalized_velocity(DynamicBodyd::eSpatial, _ckpt_work);
+    if (in.fail())
+      throw std::runtime_error("Simulator::restore_checkpoint() - checkpoint truncated");
+
+    // wake the body (its checkpointed state may not be at rest)
+    if (sleeping_enabled && body_is_asleep(db))
+      wake_body(db);
+
+    // invalidate collision geometry poses so that persistent collision
+    // detection structures refresh even for disabled or sleeping bodies
+    shared_ptr<RigidBody> rb = dynamic_pointer_cast<RigidBody>(_bodies[i]);
+    if (rb)
+      rb->invalidate_pose();
+    else
     {
-      JointPtr joint = dynamic_pointer_cast<Joint>(joints[i]);
-      osg::Node* joint_vdata = joint->get_visualization_data();
-      if (joint_vdata)
-        _persistent_vdata->removeChild(joint_vdata);
+      ArticulatedBodyPtr ab = dynamic_pointer_cast<ArticulatedBody>(_bodies[i]);
+      if (ab)
+      {
+        BOOST_FOREACH(shared_ptr<RigidBodyd> link, ab->get_links())
+          dynamic_pointer_cast<RigidBody>(link)->invalidate_pose();
+
+        // the restored state invalidates any scheduled joint limit check
+        ab->reset_joint_limit_check();
+      }
     }
   }
+
+  in.close();
+
+  // body configurations have changed; prepared joint data is now stale
+  invalidate_joint_step_data();
+}
+
+/// Pushes an in-memory snapshot of all bodies' positions and velocities
+/**
+ * Snapshots nest: each push adds a frame to a stack and each pop removes the
+ * innermost frame, so rollback loops can checkpoint inside an outer
+ * checkpoint (e.g., the speculative mini-step loop inside a larger step).
+ * Frames are recycled through a pool and their slabs keep their capacity, so
+ * steady-state pushes perform no allocation.  Sleeping bodies are skipped at
+ * capture -- their state cannot change while they sleep -- and are recorded
+ * lazily by wake_body() if woken while frames are live, so snapshot and
+ * restore cost scales with the bodies that actually move.
+ */
+void Simulator::push_state_snapshot()
+{
+  // get a frame from the pool, if one is available
+  shared_ptr<StateSnapshot> ss;
+  if (!_snapshot_pool.empty())
+  {
+    ss = _snapshot_pool.back();
+    _snapshot_pool.pop_back();
+  }
   else
+    ss = shared_ptr<StateSnapshot>(new StateSnapshot);
+
+  // prepare the frame
+  ss->time = current_time;
+  ss->slab.clear();
+  ss->offsets.assign(_bodies.size(), -1);
+  ss->ngc.assign(_bodies.size(), 0);
+  ss->ngv.assign(_bodies.size(), 0);
+
+  // capture every body that can move
+  for (unsigned i=0; i< _bodies.size(); i++)
   {
-    // try rigid body
-    RigidBodyPtr rigidbody = dynamic_pointer_cast<RigidBody>(body);
-    assert(rigidbody);
-    osg::Node* rb_vdata = rigidbody->get_visualization_data();
-    if (rb_vdata)
-      _persistent_vdata->removeChild(rb_vdata);
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+    if (sleeping_enabled && body_is_asleep(db))
+      continue;
+    capture_body_state(i, *ss);
   }
-  #endif
+
+  _snapshot_stack.push_back(ss);
 }
 
-/// Adds a dynamic body to the simulator
+/// Captures the i'th body's state into a snapshot frame
+void Simulator::capture_body_state(unsigned i, StateSnapshot& ss)
+{
+  shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+  const unsigned NGC = db->num_generalized_coordinates(DynamicBodyd::eEuler);
+  const unsigned NGV = db->num_generalized_coordinates(DynamicBodyd::eSpatial);
+
+  // append the packed coordinates and velocities to the slab
+  ss.offsets[i] = (int) ss.slab.size();
+  ss.ngc[i] = NGC;
+  ss.ngv[i] = NGV;
+  ss.slab.resize(ss.slab.size() + NGC + NGV);
+  double* p = &ss.slab[0] + ss.offsets[i];
+  db->get_generalized_coordinates_euler(_ckpt_work);
+  std::memcpy(p, _ckpt_work.data(), NGC*sizeof(double));
+  db->get_generalized_velocity(DynamicBodyd::eSpatial, _ckpt_work);
+  std::memcpy(p+NGC, _ckpt_work.data(), NGV*sizeof(double));
+}
+
+/// Captures a newly woken body into any live snapshot frames
 /**
- * \pre list of bodies is sorted
+ * A sleeping body is skipped when a snapshot is pushed; since it cannot have
+ * moved while asleep, its state at wake time is also its state at every live
+ * capture, so it is recorded lazily here.
  */
-void Simulator::add_dynamic_body(ControlledBodyPtr body) 
+void Simulator::capture_woken_body(shared_ptr<DynamicBodyd> db)
 {
-  // if the body is already present in the simulator, skip it
-  if (std::find(_bodies.begin(), _bodies.end(), body) != _bodies.end())
+  if (_snapshot_stack.empty())
     return;
 
-  // set the simulator pointer to the body
-  body->simulator = dynamic_pointer_cast<Simulator>(shared_from_this());
-
-  #ifdef USE_OSG
-  // see whether the body is articulated 
-  ArticulatedBodyPtr abody = dynamic_pointer_cast<ArticulatedBody>(body);
-  if (abody)
-  {
-    // add visualization data for all links to the persistent visualization data
-    const vector<shared_ptr<RigidBodyd> >& links = abody->get_links();
-    for (unsigned i=0; i< links.size(); i++)
-    {
-      RigidBodyPtr link = dynamic_pointer_cast<RigidBody>(links[i]);
-      osg::Node* link_vdata = link->get_visualization_data();
-      if (link_vdata)
-        _persistent_vdata->addChild(link_vdata);
-    }
-    
-    // get visualization data for all joints
-    const vector<shared_ptr<Jointd> >& joints = abody->get_joints();
-    for (unsigned i=0; i< joints.size(); i++)
+  for (unsigned i=0; i< _bodies.size(); i++)
+    if (dynamic_pointer_cast<DynamicBodyd>(_bodies[i]) == db)
     {
-      JointPtr joint = dynamic_pointer_cast<Joint>(joints[i]);
-      osg::Node* joint_vdata = joint->get_visualization_data();
-      if (joint_vdata)
-        _persistent_vdata->addChild(joint_vdata);
+      for (unsigned j=0; j< _snapshot_stack.size(); j++)
+        if (_snapshot_stack[j]->offsets[i] < 0)
+          capture_body_state(i, *_snapshot_stack[j]);
+      return;
     }
-  }
-  else
+}
+
+/// Restores the innermost state snapshot without popping it
+/**
+ * Only bodies captured in the frame are touched.  Coordinates are restored
+ * before velocities (velocity frames depend on the configuration).  The
+ * caller is responsible for recomputing any derived quantities (e.g.,
+ * pairwise distances) at the restored configuration.
+ */
+void Simulator::restore_state_snapshot()
+{
+  assert(!_snapshot_stack.empty());
+  const StateSnapshot& ss = *_snapshot_stack.back();
+
+  for (unsigned i=0; i< _bodies.size(); i++)
   {
-    // it must be a rigid body
-    RigidBodyPtr rigidbody = dynamic_pointer_cast<RigidBody>(body);
-    assert(rigidbody);
+    // skip bodies that were not captured (asleep for the frame's lifetime)
+    if (ss.offsets[i] < 0)
+      continue;
 
-    // get the visualization data and add it to the simulator
-    osg::Node* rb_vdata = rigidbody->get_visualization_data();
-    if (rb_vdata)
-      _persistent_vdata->addChild(rb_vdata);
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+    const double* p = &ss.slab[0] + ss.offsets[i];
+    _ckpt_work.resize(ss.ngc[i]);
+    std::memcpy(_ckpt_work.data(), p, ss.ngc[i]*sizeof(double));
+    db->set_generalized_coordinates_euler(_ckpt_work);
+    _ckpt_work.resize(ss.ngv[i]);
+    std::memcpy(_ckpt_work.data(), p+ss.ngc[i], ss.ngv[i]*sizeof(double));
+    db->set_generalized_velocity(DynamicBodyd::eSpatial, _ckpt_work);
   }
-  #endif
-  
-  // add the body to the list of bodies and sort the list of bodies
-  _bodies.push_back(body); 
-  std::sort(_bodies.begin(), _bodies.end());
-}
 
-/// Updates all visualization under the simulator
-void Simulator::update_visualization()
-{
-  BOOST_FOREACH(ControlledBodyPtr body, _bodies)
-    body->update_visualization();
+  // restore the capture-time simulation time
+  current_time = ss.time;
+
+  // body configurations have changed; prepared joint data is now stale
+  invalidate_joint_step_data();
 }
 
-/// Adds transient visualization data to the simulator
-void Simulator::add_transient_vdata(osg::Node* vdata)
+/// Pops the innermost state snapshot, optionally restoring it first
+void Simulator::pop_state_snapshot(bool restore)
 {
-  #ifdef USE_OSG
-  _transient_vdata->addChild(vdata);
-  #endif
+  assert(!_snapshot_stack.empty());
+  if (restore)
+    restore_state_snapshot();
+
+  // recycle the frame (its slab keeps its capacity)
+  _snapshot_pool.push_back(_snapshot_stack.back());
+  _snapshot_stack.pop_back();
 }
 
-/// Prepares to calculate forward dynamics for bodies
-void Simulator::precalc_fwd_dyn()
+/// Gathers every body's generalized state into one stacked vector
+/**
+ * The layout is the checkpoint layout: per body, in simulator order, the
+ * Euler generalized coordinates followed by the spatial generalized
+ * velocities.
+ */
+void Simulator::gather_sim_state(VectorNd& x)
 {
-  VectorNd tmp;
-
-  // clear force accumulators, then add all recurrent and compliant
-  // constraint forces
-  BOOST_FOREACH(ControlledBodyPtr db, _bodies)
+  // determine the stacked dimension
+  unsigned m = 0;
+  for (unsigned i=0; i< _bodies.size(); i++)
   {
-    // get the body as a Ravelin dynamic body
-    shared_ptr<DynamicBodyd> rdb = dynamic_pointer_cast<DynamicBodyd>(db);
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+    m += db->num_generalized_coordinates(DynamicBodyd::eEuler) + db->num_generalized_coordinates(DynamicBodyd::eSpatial);
+  }
+  x.resize(m);
 
-    // clear the force accumulators on the body
-    rdb->reset_accumulators();
+  // pack the per-body state
+  unsigned ofs = 0;
+  for (unsigned i=0; i< _bodies.size(); i++)
+  {
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+    db->get_generalized_coordinates_euler(_ckpt_work);
+    x.set_sub_vec(ofs, _ckpt_work);
+    ofs += _ckpt_work.size();
+    db->get_generalized_velocity(DynamicBodyd::eSpatial, _ckpt_work);
+    x.set_sub_vec(ofs, _ckpt_work);
+    ofs += _ckpt_work.size();
+  }
+}
 
-    // add all recurrent forces on the body
-    const list<RecurrentForcePtr>& rfs = db->get_recurrent_forces();
-    BOOST_FOREACH(RecurrentForcePtr rf, rfs)
-      rf->add_force(rdb);
-    
-    // call the body's controller
-    if (db->controller)
+/// Scatters a stacked state vector (see gather_sim_state()) onto the bodies
+/**
+ * Coordinates are applied before velocities (velocity frames depend on the
+ * configuration); touched bodies are woken and their collision geometry
+ * poses invalidated, as in restore_checkpoint().
+ */
+void Simulator::scatter_sim_state(const VectorNd& x)
+{
+  unsigned ofs = 0;
+  for (unsigned i=0; i< _bodies.size(); i++)
+  {
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+    const unsigned NGC = db->num_generalized_coordinates(DynamicBodyd::eEuler);
+    const unsigned NGV = db->num_generalized_coordinates(DynamicBodyd::eSpatial);
+
+    // apply the coordinates, then the velocities
+    x.get_sub_vec(ofs, ofs+NGC, _ckpt_work);
+    db->set_generalized_coordinates_euler(_ckpt_work);
+    ofs += NGC;
+    x.get_sub_vec(ofs, ofs+NGV, _ckpt_work);
+    db->set_generalized_velocity(DynamicBodyd::eSpatial, _ckpt_work);
+    ofs += NGV;
+
+    // wake the body (the applied state may not be at rest)
+    if (sleeping_enabled && body_is_asleep(db))
+      wake_body(db);
+
+    // invalidate collision geometry poses so that persistent collision
+    // detection structures refresh even for disabled or sleeping bodies
+    shared_ptr<RigidBody> rb = dynamic_pointer_cast<RigidBody>(_bodies[i]);
+    if (rb)
+      rb->invalidate_pose();
+    else
     {
-      // get the generalized forces
-      (*db->controller)(db, tmp, current_time, db->controller_arg);
-
-      FILE_LOG(LOG_DYNAMICS) << "Computing controller forces for " << db->id << std::endl;
-
-      // apply the generalized forces
-      rdb->add_generalized_force(tmp);
+      ArticulatedBodyPtr ab = dynamic_pointer_cast<ArticulatedBody>(_bodies[i]);
+      if (ab)
+      {
+        BOOST_FOREACH(shared_ptr<RigidBodyd> link, ab->get_links())
+          dynamic_pointer_cast<RigidBody>(link)->invalidate_pose();
+        ab->reset_joint_limit_check();
+      }
     }
   }
+
+  // body configurations have changed; prepared joint data is now stale
+  invalidate_joint_step_data();
 }
 
-/// Applies a generalized impulse to a dynamic body
+/// Steps the simulation while computing the Jacobian of the step map
 /**
- * This function takes implicit constraints into account.
+ * Takes one nominal step of step_size and additionally computes the
+ * Jacobian of the post-step stacked state with respect to the pre-step
+ * stacked state (the layout of gather_sim_state(): per body, Euler
+ * generalized coordinates then spatial generalized velocities),
+ * retrievable afterward via get_step_jacobian().  Each column is obtained
+ * by re-stepping the simulator from the saved pre-step state with one
+ * coordinate perturbed, so one instrumented step costs m+1 ordinary steps
+ * for m state dimensions -- replacing finite differences over whole
+ * rollouts with per-step Jacobians chained by the caller.  Bodies that do
+ * not interact during the step produce bit-identical re-step results, so
+ * their cross blocks vanish and the Jacobian is stored sparsely; entries
+ * below NEAR_ZERO (the differencing noise floor) are dropped.
+ *
+ * Controllers run inside every re-step -- the linearization is of the
+ * closed-loop step map, and force sensitivities follow by perturbing
+ * controller inputs in the same instrumented rollout -- but the post-step
+ * callback fires only once, at the nominal post-step state.  Constraint
+ * callbacks, if installed, fire in every re-step.
  */
-void Simulator::apply_impulse(shared_ptr<DynamicBodyd> db, const SharedVectorNd& gj)
+double Simulator::step_with_jacobian(double step_size)
 {
-  VectorNd f, v, dv, lambda;
-  vector<shared_ptr<DynamicBodyd> > island;
-  vector<shared_ptr<Joint> > island_ijoints;
+  typedef std::map<std::pair<unsigned, unsigned>, double> ValueMap;
 
-  // determine any implicit constraints connected to this body, adding it to
-  // an island
+  // save the pre-step state and time
+  push_state_snapshot();
+  gather_sim_state(_jac_x0);
+  const unsigned m = _jac_x0.size();
+
+  // suppress the post-step callback during the nominal and perturbed
+  // steps; it fires once at the end, at the nominal post-step state
+  void (*saved_cb)(Simulator*) = post_step_callback_fn;
+  post_step_callback_fn = NULL;
+
+  // take the nominal step
+  const double rc = step(step_size);
+  gather_sim_state(_jac_xnom);
+  const double tnom = current_time;
+
+  // re-step from the pre-step state with each coordinate perturbed
+  ValueMap values;
+  for (unsigned j=0; j< m; j++)
+  {
+    // restore the pre-step state and apply the perturbation
+    restore_state_snapshot();
+    const double H = std::sqrt(std::numeric_limits<double>::epsilon()) * (1.0 + std::fabs(_jac_x0[j]));
+    _jac_xpert = _jac_x0;
+    _jac_xpert[j] += H;
+    scatter_sim_state(_jac_xpert);
+
+    // step and difference against the nominal post-step state
+    step(step_size);
+    gather_sim_state(_jac_xpert);
+    for (unsigned i=0; i< m; i++)
+    {
+      const double deriv = (_jac_xpert[i] - _jac_xnom[i])/H;
+      if (std::fabs(deriv) > NEAR_ZERO)
+        values[std::make_pair(i, j)] = deriv;
+    }
+  }
+
+  // assemble the sparse Jacobian
+  _step_jacobian = SparseMatrixNd(SparseMatrixNd::eCSC, m, m, values);
+
+  // discard the snapshot and leave the simulator at the nominal post-step
+  // state
+  pop_state_snapshot(false);
+  scatter_sim_state(_jac_xnom);
+  current_time = tnom;
+
+  // fire the user's post-step callback at the nominal state
+  post_step_callback_fn = saved_cb;
+  if (post_step_callback_fn)
+    post_step_callback_fn(this);
+
+  return rc;
+}
+
+/// Magic number identifying a Moby co-simulation segment ("MoCS")
+static const unsigned SHM_COSIM_MAGIC = 0x4d6f4353;
+
+/// Opens a shared-memory co-simulation segment under the given name
+/**
+ * The segment holds a ShmCoSimHeader followed by one ShmCoSimRecord per
+ * rigid body in the simulation, in simulator order (links of articulated
+ * bodies follow their body's link order). After every step, the bodies'
+ * poses and velocities are published into the records under the state
+ * seqlock: the sequence number is odd while a write is in progress, so a
+ * peer reads a consistent snapshot by rereading until it observes the same
+ * even sequence before and after its copy -- no syscall and no blocking on
+ * either side. Symmetrically, the peer may publish external wrenches into
+ * the records under the wrench seqlock (setting wrench_enabled once), and
+ * they are read and applied before each forward dynamics computation.
+ *
+ * Call after the simulation's bodies are in place; bodies added or removed
+ * later are not reflected until the segment is reopened.
+ * \return true if the segment was successfully created and mapped
+ */
+bool Simulator::open_shm_cosim(const std::string& name)
+{
+  // release any segment already open
+  close_shm_cosim();
+
+  // collect the rigid bodies published, in simulator order
+  _shm_cosim_bodies.clear();
+  for (unsigned i=0; i< _bodies.size(); i++)
+  {
+    shared_ptr<RigidBodyd> rb = dynamic_pointer_cast<RigidBodyd>(_bodies[i]);
+    if (rb)
+      _shm_cosim_bodies.push_back(rb);
+    else
+    {
+      ArticulatedBodyPtr ab = dynamic_pointer_cast<ArticulatedBody>(_bodies[i]);
+      if (ab)
+        _shm_cosim_bodies.insert(_shm_cosim_bodies.end(), ab->get_links().begin(), ab->get_links().end());
+    }
+  }
+
+  // create and size the segment
+  const unsigned N = _shm_cosim_bodies.size();
+  const unsigned SZ = sizeof(ShmCoSimHeader) + N*sizeof(ShmCoSimRecord);
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0666);
+  if (fd < 0)
+  {
+    std::cerr << "Simulator::open_shm_cosim() - unable to create shared memory segment '" << name << "'" << std::endl;
+    return false;
+  }
+  if (ftruncate(fd, SZ) < 0)
+  {
+    std::cerr << "Simulator::open_shm_cosim() - unable to size shared memory segment '" << name << "'" << std::endl;
+    ::close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  // map the segment; the descriptor is no longer needed afterward
+  void* mem = mmap(NULL, SZ, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED)
+  {
+    std::cerr << "Simulator::open_shm_cosim() - unable to map shared memory segment '" << name << "'" << std::endl;
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  // initialize the header
+  ShmCoSimHeader* hdr = (ShmCoSimHeader*) mem;
+  std::memset(mem, 0, SZ);
+  hdr->magic = SHM_COSIM_MAGIC;
+  hdr->nbodies = N;
+  _shm_cosim = mem;
+  _shm_cosim_size = SZ;
+  _shm_cosim_name = name;
+
+  // publish the initial state
+  publish_shm_cosim();
+
+  return true;
+}
+
+/// Closes the co-simulation segment, if one is open
+/**
+ * The segment is unmapped and its name unlinked; peers still holding a
+ * mapping keep it until they unmap, but can no longer reattach.
+ */
+void Simulator::close_shm_cosim()
+{
+  if (!_shm_cosim)
+    return;
+  munmap(_shm_cosim, _shm_cosim_size);
+  shm_unlink(_shm_cosim_name.c_str());
+  _shm_cosim = NULL;
+  _shm_cosim_size = 0;
+  _shm_cosim_name.clear();
+  _shm_cosim_bodies.clear();
+}
+
+/// Publishes the bodies' poses and velocities into the co-simulation segment
+void Simulator::publish_shm_cosim()
+{
+  if (!_shm_cosim)
+    return;
+  ShmCoSimHeader* hdr = (ShmCoSimHeader*) _shm_cosim;
+  ShmCoSimRecord* recs = (ShmCoSimRecord*) (hdr + 1);
+
+  // an odd sequence number marks the write in progress; readers retry
+  hdr->state_seq++;
+  __sync_synchronize();
+
+  hdr->time = current_time;
+  for (unsigned i=0; i< _shm_cosim_bodies.size(); i++)
+  {
+    shared_ptr<RigidBodyd> rb = _shm_cosim_bodies[i];
+
+    // publish the pose in the global frame
+    Pose3d P = *rb->get_pose();
+    P.update_relative_pose(GLOBAL);
+    recs[i].pose[0] = P.x[0];
+    recs[i].pose[1] = P.x[1];
+    recs[i].pose[2] = P.x[2];
+    recs[i].pose[3] = P.q.x;
+    recs[i].pose[4] = P.q.y;
+    recs[i].pose[5] = P.q.z;
+    recs[i].pose[6] = P.q.w;
+
+    // publish the spatial velocity in the global frame
+    SVelocityd v = Pose3d::transform(GLOBAL, rb->get_velocity());
+    Vector3d ang = v.get_angular();
+    Vector3d lin = v.get_linear();
+    for (unsigned j=0; j< 3; j++)
+    {
+      recs[i].velocity[j] = ang[j];
+      recs[i].velocity[j+3] = lin[j];
+    }
+  }
+
+  __sync_synchronize();
+  hdr->state_seq++;
+}
+
+/// Applies the peer's external wrench inputs from the co-simulation segment
+/**
+ * The wrenches are copied out under the wrench seqlock; the read is retried
+ * a bounded number of times, so a peer dying mid-write cannot hang the
+ * step (the previous step's inputs simply remain in effect).
+ */
+void Simulator::apply_shm_cosim_wrenches()
+{
+  if (!_shm_cosim)
+    return;
+  ShmCoSimHeader* hdr = (ShmCoSimHeader*) _shm_cosim;
+  if (!hdr->wrench_enabled)
+    return;
+  const ShmCoSimRecord* recs = (const ShmCoSimRecord*) (hdr + 1);
+  const unsigned N = _shm_cosim_bodies.size();
+
+  // copy a consistent snapshot of the wrench inputs
+  _shm_cosim_scratch.resize(N*6);
+  const unsigned MAX_TRIES = 16;
+  for (unsigned tries = 0; ; tries++)
+  {
+    if (tries == MAX_TRIES)
+      return;
+    unsigned seq = hdr->wrench_seq;
+    if (seq & 1)
+      continue;
+    __sync_synchronize();
+    for (unsigned i=0; i< N; i++)
+      for (unsigned j=0; j< 6; j++)
+        _shm_cosim_scratch[i*6+j] = recs[i].wrench[j];
+    __sync_synchronize();
+    if (hdr->wrench_seq == seq)
+      break;
+  }
+
+  // apply the wrenches in a global-aligned frame at each body's origin
+  // (the same convention GravityForce::add_force() uses)
+  for (unsigned i=0; i< N; i++)
+  {
+    const double* f = &_shm_cosim_scratch[i*6];
+    if (f[0] == 0.0 && f[1] == 0.0 && f[2] == 0.0 &&
+        f[3] == 0.0 && f[4] == 0.0 && f[5] == 0.0)
+      continue;
+    shared_ptr<RigidBodyd> rb = _shm_cosim_bodies[i];
+    if (!rb->is_enabled())
+      continue;
+
+    // an externally forced body must not sleep
+    shared_ptr<DynamicBodyd> super = dynamic_pointer_cast<DynamicBodyd>(rb->get_super_body());
+    if (sleeping_enabled && body_is_asleep(super))
+      wake_body(super);
+
+    shared_ptr<Pose3d> P(new Pose3d(*rb->get_pose()));
+    P->update_relative_pose(GLOBAL);
+    P->q.set_identity();
+    SForced w(boost::const_pointer_cast<const Pose3d>(P));
+    w.set_force(Vector3d(f[0], f[1], f[2]));
+    w.set_torque(Vector3d(f[3], f[4], f[5]));
+    rb->add_force(w);
+  }
+}
+
+/// Writes the footprint estimate, one subsystem per line
+void Simulator::MemoryFootprint::dump(std::ostream& out) const
+{
+  out << "memory footprint (bytes):" << std::endl;
+  out << "  geometry:            " << geometry << std::endl;
+  out << "  collision detection: " << collision_detection << std::endl;
+  out << "  solver workspaces:   " << solver_workspaces << std::endl;
+  out << "  total:               " << total() << std::endl;
+}
+
+/// Estimates the simulator's heap memory, per subsystem
+/**
+ * The base implementation counts the geometry: each distinct primitive
+ * (including level-of-detail stand-ins) is counted once, however many
+ * geometries share it.  ConstraintSimulator adds the collision detector
+ * and the constraint solvers.  Estimates exclude allocator overhead and
+ * visualization (OSG) data.
+ * \param fp the footprint to fill in (cleared first)
+ */
+void Simulator::calc_memory_footprint(MemoryFootprint& fp) const
+{
+  // clear the footprint
+  fp = MemoryFootprint();
+
+  // collect the distinct primitives; interning and level-of-detail setups
+  // share primitives between geometries, and shared primitives must only be
+  // counted once
+  set<PrimitivePtr> primitives;
+  BOOST_FOREACH(ControlledBodyPtr db, _bodies)
+  {
+    // get all rigid bodies from db
+    vector<shared_ptr<RigidBodyd> > links;
+    shared_ptr<RigidBodyd> rb = dynamic_pointer_cast<RigidBodyd>(db);
+    if (rb)
+      links.push_back(rb);
+    else
+    {
+      shared_ptr<ArticulatedBodyd> ab = dynamic_pointer_cast<ArticulatedBodyd>(db);
+      links.insert(links.end(), ab->get_links().begin(), ab->get_links().end());
+    }
+
+    // get the primitives from each body's geometries
+    BOOST_FOREACH(shared_ptr<RigidBodyd> link, links)
+    {
+      RigidBodyPtr rbm = dynamic_pointer_cast<RigidBody>(link);
+      if (!rbm)
+        continue;
+      BOOST_FOREACH(CollisionGeometryPtr cg, rbm->geometries)
+      {
+        primitives.insert(cg->get_geometry());
+        for (unsigned i=0; i< cg->get_lod_geometries().size(); i++)
+          primitives.insert(cg->get_lod_geometries()[i].second);
+      }
+    }
+  }
+
+  // sum the primitives' usage
+  BOOST_FOREACH(PrimitivePtr primitive, primitives)
+    fp.geometry += primitive->calc_memory_usage();
+}
+
+/// Releases caches that can be rebuilt on demand
+/**
+ * The base simulator holds no such caches; ConstraintSimulator releases the
+ * collision detector's and the constraint solvers' caches.
+ */
+void Simulator::release_transient_memory()
+{
+  // drop the memoized island decomposition; the next find_islands() call
+  // rebuilds it
+  _cached_islands.clear();
+  _island_key_bodies.clear();
+  _island_key_joints.clear();
+}
+
+/// Releases transient memory if the footprint estimate exceeds the budget
+/**
+ * Called at the end of each step when memory_budget is nonzero.
+ */
+void Simulator::enforce_memory_budget()
+{
+  if (memory_budget == 0)
+    return;
+
+  // estimate the footprint
+  MemoryFootprint fp;
+  calc_memory_footprint(fp);
+  if (fp.total() <= memory_budget)
+    return;
+
+  FILE_LOG(LOG_SIMULATOR) << "Simulator::enforce_memory_budget() - footprint " << fp.total() << " bytes exceeds budget " << memory_budget << "; releasing transient memory" << std::endl;
+  release_transient_memory();
+}
+
+/// Populates the pipeline with the built-in stepping phases
+/**
+ * Called lazily by step() when the pipeline is empty.  Subclasses override
+ * this method to contribute their own built-in stages; user stages are
+ * spliced around the built-ins with insert_stage_before() /
+ * insert_stage_after().
+ */
+void Simulator::build_default_pipeline()
+{
+  // forward dynamics and integration
+  shared_ptr<MemberFnStage<Simulator> > integration(new MemberFnStage<Simulator>("integration", this, &Simulator::run_integration_stage));
+  integration->reads.insert("force");
+  integration->writes.insert("pose");
+  integration->writes.insert("velocity");
+  pipeline.push_back(integration);
+}
+
+/// Runs forward dynamics and integration as a pipeline stage
+void Simulator::run_integration_stage(double dt)
+{
+  StepProfiler::ScopedTimer timer(profiler, StepProfiler::eIntegration);
+  current_time += integrate(dt);
+}
+
+/// Inserts a stage into the pipeline before the named stage
+/**
+ * Builds the default pipeline first, if necessary.
+ * \return true if the named stage was found and the stage inserted
+ */
+bool Simulator::insert_stage_before(shared_ptr<SimulationStage> stage, const std::string& name)
+{
+  if (pipeline.empty())
+    build_default_pipeline();
+  for (unsigned i=0; i< pipeline.size(); i++)
+    if (pipeline[i]->name == name)
+    {
+      pipeline.insert(pipeline.begin()+i, stage);
+      return true;
+    }
+
+  return false;
+}
+
+/// Inserts a stage into the pipeline after the named stage
+/**
+ * Builds the default pipeline first, if necessary.
+ * \return true if the named stage was found and the stage inserted
+ */
+bool Simulator::insert_stage_after(shared_ptr<SimulationStage> stage, const std::string& name)
+{
+  if (pipeline.empty())
+    build_default_pipeline();
+  for (unsigned i=0; i< pipeline.size(); i++)
+    if (pipeline[i]->name == name)
+    {
+      pipeline.insert(pipeline.begin()+i+1, stage);
+      return true;
+    }
+
+  return false;
+}
+
+/// One stage execution job for the wave scheduler
+struct StageJob
+{
+  SimulationStage* stage;
+  Simulator* sim;
+  double dt;
+};
+
+/// Worker for Simulator::run_pipeline(); executes one stage
+static void* stage_worker(void* arg)
+{
+  StageJob* job = (StageJob*) arg;
+  job->stage->execute(job->sim, job->dt);
+  return NULL;
+}
+
+/// Executes the stage pipeline for one step
+/**
+ * Stages run in pipeline order, except that a run of consecutive stages
+ * whose declared read/write sets are mutually non-conflicting forms a wave
+ * that executes concurrently (one thread per stage when built THREADSAFE;
+ * serially otherwise).  The scheduler never reorders stages past a
+ * conflict: the first conflicting stage closes the current wave, so the
+ * declared-order semantics are preserved.
+ */
+void Simulator::run_pipeline(double dt)
+{
+  for (unsigned i=0; i< pipeline.size(); )
+  {
+    // grow the wave while consecutive stages are mutually non-conflicting
+    unsigned j = i+1;
+    while (j < pipeline.size())
+    {
+      bool conflict = false;
+      for (unsigned k=i; k< j && !conflict; k++)
+        conflict = pipeline[j]->conflicts_with(*pipeline[k]);
+      if (conflict)
+        break;
+      j++;
+    }
+
+    // a singleton wave runs on the calling thread
+    if (j == i+1)
+      pipeline[i]->execute(this, dt);
+    else
+    {
+      // setup the stage jobs
+      std::vector<StageJob> jobs(j-i);
+      for (unsigned k=i; k< j; k++)
+      {
+        jobs[k-i].stage = pipeline[k].get();
+        jobs[k-i].sim = this;
+        jobs[k-i].dt = dt;
+      }
+
+      #ifdef THREADSAFE
+      // run each stage of the wave on its own thread
+      std::vector<pthread_t> threads(jobs.size());
+      for (unsigned k=0; k< jobs.size(); k++)
+        pthread_create(&threads[k], NULL, &stage_worker, &jobs[k]);
+      for (unsigned k=0; k< jobs.size(); k++)
+        pthread_join(threads[k], NULL);
+      #else
+      // Moby's globals are unguarded without THREADSAFE; run the wave
+      // serially
+      for (unsigned k=0; k< jobs.size(); k++)
+        stage_worker(&jobs[k]);
+      #endif
+    }
+
+    i = j;
+  }
+}
+
+/// Steps the Simulator forward in time without contact
+/**
+ * This pseudocode was inspired from [Baraff 1997] and [Mirtich 1996].
+ * \param step_size the step size
+ * \return step_size
+ */
+double Simulator::step(double step_size)
+{
+  #ifdef USE_OSG
+  // clear one-step visualization data
+  _transient_vdata->removeChildren(0, _transient_vdata->getNumChildren());
+  #endif
+
+  // fast-forward over the step if the scene is quiescent
+  if (try_fast_forward(step_size))
+    return step_size;
+
+  // build the built-in stage pipeline on first use
+  if (pipeline.empty())
+    build_default_pipeline();
+
+  // run the stage pipeline (forward dynamics and integration, plus any
+  // user-inserted stages)
+  profiler.start_step();
+  run_pipeline(step_size);
+  profiler.end_step();
+
+  // TODO: do any constraint stabilization
+//  _cstab.stabilize(simulator);
+
+  // release transient memory if over the memory budget
+  enforce_memory_budget();
+
+  // call the callback
+  if (post_step_callback_fn)
+    post_step_callback_fn(this);
+
+  // publish the post-step state to the co-simulation peer, if any
+  publish_shm_cosim();
+
+  return step_size;
+}
+
+/// One ensemble rollout: a simulator copy and how far to advance it
+struct EnsembleJob
+{
+  Simulator* sim;
+  double step_size;
+  unsigned nsteps;
+};
+
+/// Worker for Simulator::step_ensemble(); advances one rollout to completion
+static void* ensemble_worker(void* arg)
+{
+  EnsembleJob* job = (EnsembleJob*) arg;
+  for (unsigned i=0; i< job->nsteps; i++)
+    job->sim->step(job->step_size);
+  return NULL;
+}
+
+/// Advances many independent simulator copies in parallel
+/**
+ * Intended for Monte Carlo rollouts: load one simulator copy per rollout
+ * (e.g., via repeated XMLReader::read() calls- interned primitives shared
+ * between the copies are immutable, so sharing them is safe), perturb each
+ * copy's state, then advance the whole ensemble. Each rollout runs on its
+ * own thread when Moby is built THREADSAFE; otherwise the rollouts are
+ * advanced serially. The copies must be fully independent (separate bodies,
+ * geometries, and constraint handlers), so each thread touches only its own
+ * copy's state. The one shared resource is non-reentrant wrapped Fortran
+ * (e.g., ODEPACK's LSODE keeps its state in COMMON blocks); such wrappers
+ * serialize themselves internally, and everything else runs concurrently.
+ * \param sims the independent simulator copies to advance
+ * \param step_size the step size passed to each step() call
+ * \param nsteps the number of steps to advance each copy
+ */
+void Simulator::step_ensemble(const std::vector<boost::shared_ptr<Simulator> >& sims, double step_size, unsigned nsteps)
+{
+  if (sims.empty())
+    return;
+
+  // setup the rollout jobs
+  std::vector<EnsembleJob> jobs(sims.size());
+  for (unsigned i=0; i< sims.size(); i++)
+  {
+    jobs[i].sim = sims[i].get();
+    jobs[i].step_size = step_size;
+    jobs[i].nsteps = nsteps;
+  }
+
+  #ifdef THREADSAFE
+  // run each rollout on its own thread
+  std::vector<pthread_t> threads(sims.size());
+  for (unsigned i=0; i< sims.size(); i++)
+    pthread_create(&threads[i], NULL, &ensemble_worker, &jobs[i]);
+  for (unsigned i=0; i< sims.size(); i++)
+    pthread_join(threads[i], NULL);
+  #else
+  // Moby's globals are unguarded without THREADSAFE; run the rollouts
+  // serially
+  for (unsigned i=0; i< sims.size(); i++)
+    ensemble_worker(&jobs[i]);
+  #endif
+}
+
+/// Finds the dynamic body in the simulator, if any
+/**
+ * Searches unarticulated bodies, articulated bodies, and links of
+ * articulated bodies.
+ */
+ControlledBodyPtr Simulator::find_dynamic_body(const std::string& name) const
+{
+  BOOST_FOREACH(ControlledBodyPtr body, _bodies)
+    if (body->id == name)
+      return body;
+
+  // failed, look through all links of articulated bodies
+  BOOST_FOREACH(ControlledBodyPtr body, _bodies)
+  {
+    // try to cast the i'th DynamicBody as an ArticulatedBody
+    ArticulatedBodyPtr ab = dynamic_pointer_cast<ArticulatedBody>(body);
+    if (!ab)
+      continue;
+    
+    // it was castable, get all links
+    const vector<shared_ptr<RigidBodyd> >& links = ab->get_links();
+    
+    // look through all links for one matching the name
+    BOOST_FOREACH(shared_ptr<RigidBodyd> rb, links)  
+      if (rb->body_id == name)
+        return dynamic_pointer_cast<RigidBody>(rb);
+  }
+    
+  return ControlledBodyPtr();
+}
+
+/// Removes a dynamic body from the simulator
+void Simulator::remove_dynamic_body(ControlledBodyPtr body)
+{
+  // remove the body from the list of bodies
+  std::vector<ControlledBodyPtr>::iterator i = std::find(_bodies.begin(), _bodies.end(), body);
+  if (i == _bodies.end())
+    return;
+  else
+    _bodies.erase(i);
+
+  #ifdef USE_OSG
+  // see whether the body is articulated 
+  ArticulatedBodyPtr abody = dynamic_pointer_cast<ArticulatedBody>(body);
+  if (abody)
+  {
+    
+    // remove visualization data for all links to the persistent visualization data
+    const vector<shared_ptr<RigidBodyd> >& links = abody->get_links();
+    for (unsigned i=0; i< links.size(); i++)
+    {
+      RigidBodyPtr link = dynamic_pointer_cast<RigidBody>(links[i]);
+      osg::Node* link_vdata = link->get_visualization_data();
+      if (link_vdata)
+        _persistent_vdata->removeChild(link_vdata);
+    }
+    
+    // remove visualization data for all joints
+    const vector<shared_ptr<Jointd> >& joints = abody->get_joints();
+    for (unsigned i=0; i< joints.size(); i++)
+    {
+      JointPtr joint = dynamic_pointer_cast<Joint>(joints[i]);
+      osg::Node* joint_vdata = joint->get_visualization_data();
+      if (joint_vdata)
+        _persistent_vdata->removeChild(joint_vdata);
+    }
+  }
+  else
+  {
+    // try rigid body
+    RigidBodyPtr rigidbody = dynamic_pointer_cast<RigidBody>(body);
+    assert(rigidbody);
+    osg::Node* rb_vdata = rigidbody->get_visualization_data();
+    if (rb_vdata)
+      _persistent_vdata->removeChild(rb_vdata);
+  }
+  #endif
+}
+
+/// Adds a dynamic body to the simulator
+/**
+ * \pre list of bodies is sorted
+ */
+void Simulator::add_dynamic_body(ControlledBodyPtr body) 
+{
+  // if the body is already present in the simulator, skip it
+  if (std::find(_bodies.begin(), _bodies.end(), body) != _bodies.end())
+    return;
+
+  // set the simulator pointer to the body
+  body->simulator = dynamic_pointer_cast<Simulator>(shared_from_this());
+
+  #ifdef USE_OSG
+  // see whether the body is articulated 
+  ArticulatedBodyPtr abody = dynamic_pointer_cast<ArticulatedBody>(body);
+  if (abody)
+  {
+    // add visualization data for all links to the persistent visualization data
+    const vector<shared_ptr<RigidBodyd> >& links = abody->get_links();
+    for (unsigned i=0; i< links.size(); i++)
+    {
+      RigidBodyPtr link = dynamic_pointer_cast<RigidBody>(links[i]);
+      osg::Node* link_vdata = link->get_visualization_data();
+      if (link_vdata)
+        _persistent_vdata->addChild(link_vdata);
+    }
+    
+    // get visualization data for all joints
+    const vector<shared_ptr<Jointd> >& joints = abody->get_joints();
+    for (unsigned i=0; i< joints.size(); i++)
+    {
+      JointPtr joint = dynamic_pointer_cast<Joint>(joints[i]);
+      osg::Node* joint_vdata = joint->get_visualization_data();
+      if (joint_vdata)
+        _persistent_vdata->addChild(joint_vdata);
+    }
+  }
+  else
+  {
+    // it must be a rigid body
+    RigidBodyPtr rigidbody = dynamic_pointer_cast<RigidBody>(body);
+    assert(rigidbody);
+
+    // get the visualization data and add it to the simulator
+    osg::Node* rb_vdata = rigidbody->get_visualization_data();
+    if (rb_vdata)
+      _persistent_vdata->addChild(rb_vdata);
+  }
+  #endif
+  
+  // add the body to the list of bodies and sort the list of bodies
+  _bodies.push_back(body); 
+  std::sort(_bodies.begin(), _bodies.end());
+}
+
+/// Updates all visualization under the simulator
+void Simulator::update_visualization()
+{
+  BOOST_FOREACH(ControlledBodyPtr body, _bodies)
+    body->update_visualization();
+}
+
+/// Captures body poses for visualization without touching the scene graph
+/**
+ * To be called from the stepping thread. Poses are recorded into the back
+ * buffer with no synchronization and then published to the front buffer
+ * with an O(1) swap, so the stepping thread never blocks while the render
+ * thread walks the scene graph.
+ * \sa apply_visualization_snapshot()
+ */
+void Simulator::snapshot_visualization()
+{
+  #ifdef USE_OSG
+  // record poses into the back buffer (only this thread touches it)
+  _pose_back_buffer.clear();
+  BOOST_FOREACH(ControlledBodyPtr body, _bodies)
+    body->snapshot_visualization(_pose_back_buffer);
+
+  // publish the snapshot with an O(1) swap
+  #ifdef THREADSAFE
+  pthread_mutex_lock(&_pose_buffer_mutex);
+  #endif
+  _pose_back_buffer.swap(_pose_front_buffer);
+  _pose_snapshot_ready = true;
+  #ifdef THREADSAFE
+  pthread_mutex_unlock(&_pose_buffer_mutex);
+  #endif
+  #endif
+}
+
+/// Applies the most recently captured pose snapshot to the scene graph
+/**
+ * To be called from the render thread. Does nothing if no new snapshot has
+ * been published since the last call. The scene graph updates happen
+ * outside the critical section, so the stepping thread is never blocked
+ * while transforms are set.
+ * \sa snapshot_visualization()
+ */
+void Simulator::apply_visualization_snapshot()
+{
+  #ifdef USE_OSG
+  // claim the front buffer with an O(1) swap, if a new snapshot exists
+  #ifdef THREADSAFE
+  pthread_mutex_lock(&_pose_buffer_mutex);
+  #endif
+  if (!_pose_snapshot_ready)
+  {
+    #ifdef THREADSAFE
+    pthread_mutex_unlock(&_pose_buffer_mutex);
+    #endif
+    return;
+  }
+  _pose_front_buffer.swap(_pose_render_buffer);
+  _pose_snapshot_ready = false;
+  #ifdef THREADSAFE
+  pthread_mutex_unlock(&_pose_buffer_mutex);
+  #endif
+
+  // apply the captured poses to the scene graph
+  for (unsigned i=0; i< _pose_render_buffer.size(); i++)
+    _pose_render_buffer[i].first->update_transform(_pose_render_buffer[i].second);
+  #endif
+}
+
+/// Adds transient visualization data to the simulator
+void Simulator::add_transient_vdata(osg::Node* vdata)
+{
+  #ifdef USE_OSG
+  _transient_vdata->addChild(vdata);
+  #endif
+}
+
+/// Wakes every rigid body within a dynamic body
+static void wake_dynamic_body(shared_ptr<DynamicBodyd> db)
+{
+  // rigid body case
+  shared_ptr<RigidBody> rb = dynamic_pointer_cast<RigidBody>(db);
+  if (rb)
+  {
+    rb->wake();
+    return;
+  }
+
+  // articulated body case: wake every link
+  shared_ptr<ArticulatedBody> ab = dynamic_pointer_cast<ArticulatedBody>(db);
+  if (ab)
+  {
+    const vector<shared_ptr<RigidBodyd> >& links = ab->get_links();
+    for (unsigned i=0; i< links.size(); i++)
+    {
+      shared_ptr<RigidBody> link = dynamic_pointer_cast<RigidBody>(links[i]);
+      if (link)
+        link->wake();
+    }
+  }
+}
+
+/// Determines whether a dynamic body is asleep
+/**
+ * An articulated body is asleep only if every one of its links is asleep.
+ */
+bool Simulator::body_is_asleep(shared_ptr<DynamicBodyd> db)
+{
+  // rigid body case
+  shared_ptr<RigidBody> rb = dynamic_pointer_cast<RigidBody>(db);
+  if (rb)
+    return rb->is_asleep();
+
+  // articulated body case
+  shared_ptr<ArticulatedBody> ab = dynamic_pointer_cast<ArticulatedBody>(db);
+  if (ab)
+  {
+    const vector<shared_ptr<RigidBodyd> >& links = ab->get_links();
+    for (unsigned i=0; i< links.size(); i++)
+    {
+      shared_ptr<RigidBody> link = dynamic_pointer_cast<RigidBody>(links[i]);
+      if (!link || !link->is_asleep())
+        return false;
+    }
+    return !links.empty();
+  }
+
+  return false;
+}
+
+/// Determines whether nothing in the scene can move without external input
+/**
+ * The scene is quiescent when sleeping is enabled, every enabled body is
+ * asleep, and no body has a controller. Controllers run every step and may
+ * inject forces at a time of their choosing, so their mere presence
+ * disqualifies the scene; constant recurrent forces (gravity and its kin)
+ * on sleeping bodies are already balanced by whatever contact or joint
+ * arrangement let the sleep test pass, so they cannot restart motion. Any
+ * external input- an applied force or impulse, or waking a body directly-
+ * ends quiescence through wake_body().
+ */
+bool Simulator::scene_is_quiescent() const
+{
+  // the sleep machinery supplies the sustained below-threshold velocity
+  // evidence; without it there is none
+  if (!sleeping_enabled)
+    return false;
+
+  BOOST_FOREACH(ControlledBodyPtr cb, _bodies)
+  {
+    // a controller may act on any step
+    if (cb->controller || cb->batch_controller)
+      return false;
+
+    // disabled bodies cannot move (and cannot sleep; see RigidBody)
+    shared_ptr<RigidBody> rb = dynamic_pointer_cast<RigidBody>(cb);
+    if (rb && !rb->is_enabled())
+      continue;
+
+    // everything else must be asleep
+    if (!body_is_asleep(dynamic_pointer_cast<DynamicBodyd>(cb)))
+      return false;
+  }
+
+  return true;
+}
+
+/// Fast-forwards over a quiescent step, bypassing simulation (see steady_state_skipping_enabled)
+/**
+ * When the scene is quiescent nothing can change over the step, so the step
+ * reduces to advancing the clock: collision detection, forward dynamics and
+ * integration are all skipped. The post-step callback and the
+ * co-simulation publish still run, so scripted logic watching the clock can
+ * wake the scene (any force or impulse it applies wakes the affected
+ * island, and the next step simulates normally).
+ * \return true if the step was fast-forwarded
+ */
+bool Simulator::try_fast_forward(double step_size)
+{
+  if (!steady_state_skipping_enabled || !scene_is_quiescent())
+    return false;
+
+  FILE_LOG(LOG_SIMULATOR) << "Simulator::try_fast_forward() - scene is quiescent; advancing clock to " << (current_time + step_size) << std::endl;
+
+  // the scene is frozen; just advance the clock
+  current_time += step_size;
+
+  // call the callback
+  if (post_step_callback_fn)
+    post_step_callback_fn(this);
+
+  // publish the post-step state to the co-simulation peer, if any
+  publish_shm_cosim();
+
+  return true;
+}
+
+/// Wakes a body and- if the body was slept as part of an island- its island
+void Simulator::wake_body(shared_ptr<DynamicBodyd> db)
+{
+  // see whether the body was put to sleep as part of an island; if so, wake
+  // the entire island (bodies resting on the woken body must wake with it)
+  for (unsigned i=0; i< _sleeping_islands.size(); i++)
+  {
+    vector<shared_ptr<DynamicBodyd> >& island = _sleeping_islands[i];
+    if (std::find(island.begin(), island.end(), db) == island.end())
+      continue;
+
+    // wake every body in the island and remove the island from the record;
+    // record each into any live state snapshots (skipped at capture while
+    // asleep)
+    for (unsigned j=0; j< island.size(); j++)
+    {
+      capture_woken_body(island[j]);
+      wake_dynamic_body(island[j]);
+    }
+    _sleeping_islands[i] = _sleeping_islands.back();
+    _sleeping_islands.pop_back();
+    return;
+  }
+
+  // the body was not slept as part of a recorded island; wake it alone
+  capture_woken_body(db);
+  wake_dynamic_body(db);
+}
+
+/// Prepares to calculate forward dynamics for bodies
+void Simulator::precalc_fwd_dyn()
+{
+  // controller forces are written into a persistent workspace, so the
+  // vector's storage is allocated once and reused across bodies and steps
+  VectorNd& tmp = _gf_work;
+
+  // bodies sharing a batched controller (and argument), invoked as a group
+  typedef std::pair<ControlledBody::BatchControllerCallback, void*> BatchKey;
+  map<BatchKey, vector<ControlledBodyPtr> > batches;
+
+  // bodies sharing a recurrent force, applied as a batch below
+  map<RecurrentForcePtr, vector<shared_ptr<DynamicBodyd> > > force_batches;
+
+  // clear force accumulators, then add all recurrent and compliant
+  // constraint forces
+  BOOST_FOREACH(ControlledBodyPtr db, _bodies)
+  {
+    // get the body as a Ravelin dynamic body
+    shared_ptr<DynamicBodyd> rdb = dynamic_pointer_cast<DynamicBodyd>(db);
+
+    // clear the force accumulators on the body
+    rdb->reset_accumulators();
+
+    // ballistic bodies take the analytic fast path: gravity is applied in
+    // closed form at integration, so nothing need be accumulated here (and
+    // such bodies have no controllers, by definition)
+    if (!_ballistic.empty() && _ballistic.find(rdb) != _ballistic.end())
+      continue;
+
+    // group the body with all bodies sharing each of its recurrent forces;
+    // each force is applied once over its whole batch, below
+    const list<RecurrentForcePtr>& rfs = db->get_recurrent_forces();
+    BOOST_FOREACH(RecurrentForcePtr rf, rfs)
+      force_batches[rf].push_back(rdb);
+
+    // a body with a batched controller is grouped with all bodies sharing
+    // that controller and dispatched once, below
+    if (db->batch_controller)
+    {
+      // an actively controlled body must not sleep
+      if (sleeping_enabled && body_is_asleep(rdb))
+        wake_body(rdb);
+
+      // a multi-rate body joins the batch only on steps where its control
+      // period has elapsed; between firings its last output is held
+      if (db->control_period > 0.0 &&
+          current_time + NEAR_ZERO < db->_next_control_time)
+      {
+        if (db->_held_gf_valid)
+          rdb->add_generalized_force(db->_held_gf);
+        continue;
+      }
+
+      batches[std::make_pair(db->batch_controller, db->batch_controller_arg)].push_back(db);
+      continue;
+    }
+
+    // call the body's controller
+    if (db->controller)
+    {
+      // an actively controlled body must not sleep
+      if (sleeping_enabled && body_is_asleep(rdb))
+        wake_body(rdb);
+
+      // between firings of a multi-rate controller, re-apply the output
+      // recorded at the last firing (zero-order hold)
+      if (db->control_period > 0.0 &&
+          current_time + NEAR_ZERO < db->_next_control_time)
+      {
+        if (db->_held_gf_valid)
+          rdb->add_generalized_force(db->_held_gf);
+        continue;
+      }
+
+      // get the generalized forces
+      (*db->controller)(db, tmp, current_time, db->controller_arg);
+
+      FILE_LOG(LOG_DYNAMICS) << "Computing controller forces for " << db->id << std::endl;
+
+      // apply the generalized forces
+      rdb->add_generalized_force(tmp);
+
+      // record the output and schedule the next firing
+      if (db->control_period > 0.0)
+      {
+        db->_held_gf = tmp;
+        db->_held_gf_valid = true;
+        db->_next_control_time = current_time + db->control_period;
+      }
+    }
+  }
+
+  // apply external wrench inputs from the co-simulation peer, if any
+  apply_shm_cosim_wrenches();
+
+  // apply each recurrent force once over every body it acts on (force
+  // accumulation commutes, so grouping by force does not change the result)
+  for (map<RecurrentForcePtr, vector<shared_ptr<DynamicBodyd> > >::const_iterator fi = force_batches.begin(); fi != force_batches.end(); fi++)
+    fi->first->add_force_batch(fi->second);
+
+  // invoke each batched controller once with every body that shares it
+  for (map<BatchKey, vector<ControlledBodyPtr> >::const_iterator bi = batches.begin(); bi != batches.end(); bi++)
+  {
+    const vector<ControlledBodyPtr>& group = bi->second;
+
+    // get the generalized forces for the whole group; the slab is a
+    // persistent workspace, so each body's force vector keeps its storage
+    // from step to step
+    vector<VectorNd>& gf = _batch_gf_work;
+    (*bi->first.first)(group, gf, current_time, bi->first.second);
+    assert(gf.size() == group.size());
+
+    FILE_LOG(LOG_DYNAMICS) << "Computing batched controller forces for " << group.size() << " bodies" << std::endl;
+
+    // apply the generalized forces, recording and scheduling multi-rate
+    // bodies as in the unbatched path
+    for (unsigned i=0; i< group.size(); i++)
+    {
+      dynamic_pointer_cast<DynamicBodyd>(group[i])->add_generalized_force(gf[i]);
+      if (group[i]->control_period > 0.0)
+      {
+        group[i]->_held_gf = gf[i];
+        group[i]->_held_gf_valid = true;
+        group[i]->_next_control_time = current_time + group[i]->control_period;
+      }
+    }
+  }
+}
+
+/// Identifies bodies that can take the ballistic fast path this step
+/**
+ * A body qualifies when it is an enabled rigid body outside any articulated
+ * body, it has no controllers, and every recurrent force on it is a
+ * GravityForce. Such a body needs no dynamics solve: its acceleration is
+ * exactly the summed gravity (with zero angular acceleration- the gyroscopic
+ * term vanishes for the particle-like bodies this path is meant for), so
+ * integrate() advances it in closed form and the virtual ODE machinery is
+ * bypassed for it entirely.
+ */
+void Simulator::find_ballistic_bodies()
+{
+  _ballistic.clear();
+
+  BOOST_FOREACH(ControlledBodyPtr db, _bodies)
+  {
+    // only enabled rigid bodies outside of articulated bodies qualify
+    shared_ptr<RigidBody> rb = dynamic_pointer_cast<RigidBody>(db);
+    if (!rb || !rb->is_enabled() || rb->get_articulated_body())
+      continue;
+
+    // controlled bodies must go through the standard dynamics path, as must
+    // sleeping bodies (so the fast path does not push them out of rest)
+    if (db->controller || db->batch_controller)
+      continue;
+    if (sleeping_enabled && rb->is_asleep())
+      continue;
+
+    // every recurrent force must be gravity; sum the gravity vectors
+    Vector3d g(0.0, 0.0, 0.0);
+    bool ballistic = true;
+    const list<RecurrentForcePtr>& rfs = db->get_recurrent_forces();
+    BOOST_FOREACH(RecurrentForcePtr rf, rfs)
+    {
+      shared_ptr<GravityForce> gf = dynamic_pointer_cast<GravityForce>(rf);
+      if (!gf)
+      {
+        ballistic = false;
+        break;
+      }
+      for (unsigned i=0; i< 3; i++)
+        g[i] += gf->gravity[i];
+    }
+    if (!ballistic)
+      continue;
+
+    _ballistic[dynamic_pointer_cast<DynamicBodyd>(db)] = g;
+  }
+}
+
+/// Advances a ballistic body analytically, if it is on the fast path
+/**
+ * The generalized position is advanced using the current velocity (exactly
+ * as in integrate()), and the velocity update is then applied in closed
+ * form: the linear velocity gains g*dt and the angular velocity is
+ * unchanged. The velocity is expressed in the body's mixed frame, which is
+ * aligned with the global frame, so the gravity delta adds componentwise
+ * (the same convention GravityForce::add_force() uses).
+ * \return true if the body was on the fast path (and was advanced)
+ */
+bool Simulator::advance_ballistic(shared_ptr<DynamicBodyd> db, double dt)
+{
+  VectorNd gc, gve;
+
+  // look for the body among the ballistic set
+  map<shared_ptr<DynamicBodyd>, Vector3d>::const_iterator bi = _ballistic.find(db);
+  if (bi == _ballistic.end())
+    return false;
+
+  // integrate the generalized position forward using the current velocity
+  db->get_generalized_velocity(DynamicBodyd::eEuler, gve);
+  gve *= dt;
+  db->get_generalized_coordinates_euler(gc);
+  gc += gve;
+  db->set_generalized_coordinates_euler(gc);
+
+  // add g*dt to the linear velocity
+  shared_ptr<RigidBodyd> rb = dynamic_pointer_cast<RigidBodyd>(db);
+  SVelocityd xd = rb->get_velocity();
+  Vector3d xdl = xd.get_linear();
+  for (unsigned i=0; i< 3; i++)
+    xdl[i] += bi->second[i]*dt;
+  xd.set_linear(xdl);
+  rb->set_velocity(xd);
+
+  return true;
+}
+
+/// Applies a generalized impulse to a dynamic body
+/**
+ * This function takes implicit constraints into account.
+ */
+void Simulator::apply_impulse(shared_ptr<DynamicBodyd> db, const SharedVectorNd& gj)
+{
+  VectorNd f;
+  vector<shared_ptr<DynamicBodyd> > island;
+  vector<shared_ptr<Joint> > island_ijoints;
+
+  // an applied impulse wakes the body (and anything slept with it)
+  if (sleeping_enabled && body_is_asleep(db))
+    wake_body(db);
+
+  // while batching, accumulate the impulse instead of applying it;
+  // flush_impulse_batch() applies one combined impulse per body
+  if (_batching_impulses)
+  {
+    map<shared_ptr<DynamicBodyd>, VectorNd>::iterator bi = _impulse_batch.find(db);
+    if (bi == _impulse_batch.end())
+      _impulse_batch[db] = gj;
+    else
+      bi->second += gj;
+    return;
+  }
+
+  // determine the implicit constraint island containing this body
+  get_impulse_island(db, island, island_ijoints);
+
+  // if there are no implicit joints, call the unconstrained function
+  if (island_ijoints.empty())
+  {
+    // try to cast to a rigid body
+    shared_ptr<RigidBodyd> rb = dynamic_pointer_cast<RigidBodyd>(db);
+    if (rb)
+      rb->RigidBodyd::apply_generalized_impulse(gj);
+    else
+    {
+      shared_ptr<RCArticulatedBodyd> rcab = dynamic_pointer_cast<RCArticulatedBodyd>(db);
+      if (rcab)
+        rcab->RCArticulatedBodyd::apply_generalized_impulse(gj);
+    }
+
+    return;
+  }
+
+  // get the total number of generalized coordinates for the body and the island
+  const unsigned NGC = db->num_generalized_coordinates(DynamicBodyd::eSpatial);
+  const unsigned NGC_TOTAL = num_generalized_coordinates(island);
+
+  // get the gc index for db 
+  unsigned gc_index = 0;
+  for (unsigned i=0; i< island.size(); i++)
+  {
+    if (db == island[i])
+      break;
+    else
+      gc_index += island[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
+  }
+
+  // setup f
+  f.set_zero(NGC_TOTAL);
+  f.segment(gc_index, gc_index + NGC) = gj;
+
+  // solve for and apply the velocity change over the island
+  apply_island_impulse(island, island_ijoints, f);
+}
+
+/// Finds the island of bodies coupled to a body through implicit constraints
+void Simulator::get_impulse_island(shared_ptr<DynamicBodyd> db, vector<shared_ptr<DynamicBodyd> >& island, vector<JointPtr>& island_ijoints) const
+{
+  // determine any implicit constraints connected to this body, adding it to
+  // an island
   island.push_back(db);
   for (unsigned i=0; i< implicit_joints.size(); i++)
   {
@@ -405,198 +1969,458 @@ void Simulator::apply_impulse(shared_ptr<DynamicBodyd> db, const SharedVectorNd&
     for (unsigned k=0; k< ijoints.size(); k++)
       island_ijoints.push_back(dynamic_pointer_cast<Joint>(ijoints[k]));
   }
+}
 
-  // get number of implicit constraints
-  const unsigned N_IMPLICIT = island_ijoints.size();
- 
-  // if there are no implicit joints, call the unconstrained function
-  if (N_IMPLICIT == 0)
+/// Solves for and applies the velocity change from generalized impulses over an island
+void Simulator::apply_island_impulse(const vector<shared_ptr<DynamicBodyd> >& island, const vector<JointPtr>& island_ijoints, const VectorNd& f)
+{
+  VectorNd v, dv, lambda;
+
+  // get current velocities 
+  v.resize(f.size());
+  for (unsigned i=0, gc_index = 0; i< island.size(); i++)
   {
-    // try to cast to a rigid body
-    shared_ptr<RigidBodyd> rb = dynamic_pointer_cast<RigidBodyd>(db);
-    if (rb)
-      rb->RigidBodyd::apply_generalized_impulse(gj);
-    else
+    const unsigned NGC = island[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
+    SharedVectorNd v_sub = v.segment(gc_index, gc_index + NGC);
+    island[i]->get_generalized_velocity(DynamicBodyd::eSpatial, v_sub);
+    gc_index += NGC;
+  }
+
+  // compute change in velocity and constraint forces
+  solve(island, island_ijoints, v, f, 1.0, dv, lambda);
+
+  // update velocities 
+  for (unsigned i=0, gc_index = 0; i< island.size(); i++)
+  {
+    const unsigned NGC = island[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
+    SharedVectorNd v_sub = v.segment(gc_index, gc_index + NGC);
+    SharedConstVectorNd dv_sub = dv.segment(gc_index, gc_index + NGC);
+    v_sub += dv_sub;
+    island[i]->set_generalized_velocity(DynamicBodyd::eSpatial, v_sub);
+    gc_index += NGC;
+  }
+
+  // populate constraint forces
+  for (unsigned i=0, c_index = 0; i< island_ijoints.size(); i++)
+  {
+    const unsigned NEQ = island_ijoints[i]->num_constraint_eqns();
+    SharedConstVectorNd lambda_sub = lambda.segment(c_index, c_index + NEQ);
+    island_ijoints[i]->lambda = lambda_sub;
+    c_index += NEQ;
+  }
+}
+
+/// Begins batching generalized impulse applications
+/**
+ * Between this call and flush_impulse_batch(), apply_impulse() accumulates
+ * impulses per dynamic body instead of applying them immediately, so a step
+ * generating hundreds of impact events performs one generalized operation
+ * per body -- and one island construction and solve per implicit constraint
+ * island -- rather than one per constraint.
+ */
+void Simulator::start_impulse_batch()
+{
+  _batching_impulses = true;
+}
+
+/// Applies all batched generalized impulses
+/**
+ * Impulses accumulated for bodies in the same implicit constraint island
+ * are applied with a single constrained solve over that island.
+ * \sa start_impulse_batch()
+ */
+void Simulator::flush_impulse_batch()
+{
+  VectorNd f;
+  vector<shared_ptr<DynamicBodyd> > island;
+  vector<shared_ptr<Joint> > island_ijoints;
+
+  // stop batching; applications below take the immediate path
+  _batching_impulses = false;
+
+  // process the buffer, consuming whole islands at a time
+  while (!_impulse_batch.empty())
+  {
+    // get the first remaining body and its implicit constraint island
+    shared_ptr<DynamicBodyd> db = _impulse_batch.begin()->first;
+    island.clear();
+    island_ijoints.clear();
+    get_impulse_island(db, island, island_ijoints);
+
+    // if the body is unconstrained, apply its accumulated impulse directly
+    if (island_ijoints.empty())
     {
-      shared_ptr<RCArticulatedBodyd> rcab = dynamic_pointer_cast<RCArticulatedBodyd>(db);
-      if (rcab)
-        rcab->RCArticulatedBodyd::apply_generalized_impulse(gj);
+      VectorNd& gj_acc = _impulse_batch.begin()->second;
+      SharedVectorNd gj = gj_acc.segment(0, gj_acc.size());
+      apply_impulse(db, gj);
+      _impulse_batch.erase(_impulse_batch.begin());
+      continue;
     }
 
-    return;
-  }
+    // assemble the combined impulse over the island, consuming the buffer
+    // entries of every island member
+    const unsigned NGC_TOTAL = num_generalized_coordinates(island);
+    f.set_zero(NGC_TOTAL);
+    for (unsigned i=0, gc_index = 0; i< island.size(); i++)
+    {
+      const unsigned NGC = island[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
+      map<shared_ptr<DynamicBodyd>, VectorNd>::iterator bi = _impulse_batch.find(island[i]);
+      if (bi != _impulse_batch.end())
+      {
+        f.segment(gc_index, gc_index + NGC) = bi->second;
+        _impulse_batch.erase(bi);
+      }
+      gc_index += NGC;
+    }
 
-  // get the total number of generalized coordinates for the body and the island
-  const unsigned NGC = db->num_generalized_coordinates(DynamicBodyd::eSpatial);
-  const unsigned NGC_TOTAL = num_generalized_coordinates(island);
+    // solve for and apply the velocity change over the island
+    apply_island_impulse(island, island_ijoints, f);
+  }
+}
 
-  // get the gc index for db 
-  unsigned gc_index = 0;
-  for (unsigned i=0; i< island.size(); i++)
+#ifdef __linux__
+/// Reads the CPU lists of the host's NUMA nodes from sysfs
+static void read_numa_topology(vector<vector<int> >& node_cpus)
+{
+  node_cpus.clear();
+  for (unsigned n=0; ; n++)
   {
-    if (db == island[i])
+    std::ostringstream path;
+    path << "/sys/devices/system/node/node" << n << "/cpulist";
+    std::ifstream in(path.str().c_str());
+    if (!in)
       break;
-    else
-      gc_index += island[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
+    std::string list;
+    std::getline(in, list);
+
+    // the list is comma-separated CPU ranges, e.g. "0-7,16-23"
+    node_cpus.push_back(vector<int>());
+    for (std::string::size_type i=0; i< list.size(); )
+    {
+      int lo = std::atoi(&list[i]);
+      while (i < list.size() && list[i] != ',' && list[i] != '-')
+        i++;
+      int hi = lo;
+      if (i < list.size() && list[i] == '-')
+      {
+        hi = std::atoi(&list[++i]);
+        while (i < list.size() && list[i] != ',')
+          i++;
+      }
+      for (int c=lo; c<= hi; c++)
+        node_cpus.back().push_back(c);
+      if (i < list.size())
+        i++;
+    }
   }
+}
 
-  // setup f
-  f.set_zero(NGC_TOTAL);
-  f.segment(gc_index, gc_index + NGC) = gj;
+/// Pins the calling thread to the given CPUs
+static void pin_caller_to_cpus(const vector<int>& cpus)
+{
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  for (unsigned i=0; i< cpus.size(); i++)
+    CPU_SET(cpus[i], &cpuset);
+  pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+}
+#endif
 
-  // get current velocities 
-  v.resize(NGC_TOTAL);
-  for (unsigned i=0, gc_index = 0; i< island.size(); i++)
+/// Assigns each constraint island to a NUMA node
+/**
+ * Called by calc_fwd_dyn() when numa_aware_islands is set.  An island that
+ * was assigned on an earlier step keeps its node -- the pages its solves have
+ * already faulted in live there -- and islands seen for the first time go to
+ * the node with the least assigned load (generalized coordinate count).
+ * Assignments are keyed by the island's representative body (its
+ * lowest-addressed member, which find_islands() places first), so islands
+ * whose membership survives a rebuild of the decomposition keep their node
+ * and only the islands the rebuild actually changed migrate.
+ */
+void Simulator::update_numa_island_domains(const vector<vector<shared_ptr<DynamicBodyd> > >& islands)
+{
+  const unsigned UNASSIGNED = std::numeric_limits<unsigned>::max();
+
+  // read the topology on first use
+  if (!_numa_topology_read)
   {
-    const unsigned NGC = island[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
-    SharedVectorNd v_sub = v.segment(gc_index, gc_index + NGC);
-    island[i]->get_generalized_velocity(DynamicBodyd::eSpatial, v_sub);
-    gc_index += NGC;
+    _numa_topology_read = true;
+    #ifdef __linux__
+    read_numa_topology(_numa_node_cpus);
+    #endif
+    FILE_LOG(LOG_SIMULATOR) << "Simulator::update_numa_island_domains() - found " << _numa_node_cpus.size() << " NUMA node(s)" << std::endl;
   }
 
-  // compute change in velocity and constraint forces
-  solve(island, island_ijoints, v, f, 1.0, dv, lambda);
+  // a single node leaves nothing to place
+  const unsigned NDOM = (unsigned) _numa_node_cpus.size();
+  _numa_island_domain.resize(islands.size());
+  if (NDOM < 2)
+  {
+    std::fill(_numa_island_domain.begin(), _numa_island_domain.end(), 0u);
+    return;
+  }
 
-  // update velocities 
-  for (unsigned i=0, gc_index = 0; i< island.size(); i++)
+  // carry over the sticky assignments and tally the per-node load
+  vector<double> load(NDOM, 0.0);
+  for (unsigned i=0; i< islands.size(); i++)
   {
-    const unsigned NGC = island[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
-    SharedVectorNd v_sub = v.segment(gc_index, gc_index + NGC);
-    SharedConstVectorNd dv_sub = dv.segment(gc_index, gc_index + NGC);
-    v_sub += dv_sub;
-    island[i]->set_generalized_velocity(DynamicBodyd::eSpatial, v_sub);
-    gc_index += NGC;
+    map<shared_ptr<DynamicBodyd>, unsigned>::const_iterator di = _numa_domain_of.find(islands[i].front());
+    if (di != _numa_domain_of.end() && di->second < NDOM)
+    {
+      _numa_island_domain[i] = di->second;
+      load[di->second] += (double) num_generalized_coordinates(islands[i]);
+    }
+    else
+      _numa_island_domain[i] = UNASSIGNED;
   }
 
-  // populate constraint forces
-  for (unsigned i=0, c_index = 0; i< island_ijoints.size(); i++)
+  // place new islands on the least-loaded node
+  for (unsigned i=0; i< islands.size(); i++)
   {
-    const unsigned NEQ = island_ijoints[i]->num_constraint_eqns();
-    SharedConstVectorNd lambda_sub = lambda.segment(c_index, c_index + NEQ);
-    island_ijoints[i]->lambda = lambda_sub;
-    c_index += NEQ;
+    if (_numa_island_domain[i] != UNASSIGNED)
+      continue;
+    unsigned argmin = 0;
+    for (unsigned d=1; d< NDOM; d++)
+      if (load[d] < load[argmin])
+        argmin = d;
+    _numa_island_domain[i] = argmin;
+    load[argmin] += (double) num_generalized_coordinates(islands[i]);
   }
+
+  // rebuild the sticky map from the current decomposition, dropping the
+  // entries of islands that no longer exist
+  map<shared_ptr<DynamicBodyd>, unsigned> next;
+  for (unsigned i=0; i< islands.size(); i++)
+    next[islands[i].front()] = _numa_island_domain[i];
+  _numa_domain_of.swap(next);
 }
 
 /// Calculates forward dynamics for bodies (does not consider unilateral constraints)
 void Simulator::calc_fwd_dyn(double dt)
 {
-  VectorNd v, a, lambda, f;
-  MatrixNd M;
-  vector<JointPtr> island_ijoints; 
-
-  // get the simulator pointer
-  shared_ptr<Simulator> shared_this = dynamic_pointer_cast<Simulator>(shared_from_this());
+  // thread the step size through to the reduced-coordinate bodies so that
+  // their implicit joint friction solve can integrate over it
+  BOOST_FOREACH(ControlledBodyPtr cb, _bodies)
+  {
+    RCArticulatedBodyPtr rcab = dynamic_pointer_cast<RCArticulatedBody>(cb);
+    if (rcab)
+      rcab->joint_friction_dt = dt;
+  }
 
   // find islands
-  vector<vector<shared_ptr<DynamicBodyd> > > islands; 
+  vector<vector<shared_ptr<DynamicBodyd> > > islands;
   find_islands(islands);
 
-  // calculate forward dynamics for each island 
+  // collect the islands that actually need a solve
+  vector<unsigned> active;
+  active.reserve(islands.size());
   for (unsigned i=0; i< islands.size(); i++)
   {
-    // get the i'th island
-    vector<shared_ptr<DynamicBodyd> >& island = islands[i];
+    // ballistic bodies are integrated analytically; skip their solve
+    if (!_ballistic.empty() && islands[i].size() == 1 &&
+        _ballistic.find(islands[i].front()) != _ballistic.end())
+      continue;
 
-    // sort the island so that we can search it
-    std::sort(island.begin(), island.end());
+    // skip islands in which every body sleeps
+    if (sleeping_enabled)
+    {
+      bool all_asleep = true;
+      for (unsigned j=0; j< islands[i].size(); j++)
+        if (!body_is_asleep(islands[i][j]))
+        {
+          all_asleep = false;
+          break;
+        }
+      if (all_asleep)
+        continue;
+    }
 
-    // clear the set of implicit joints 
-    island_ijoints.clear();
+    active.push_back(i);
+  }
 
-    // get the implicit joints in the island
-    for (unsigned j=0; j< implicit_joints.size(); j++)
+  #if defined(_OPENMP) && defined(__linux__)
+  // NUMA-aware dispatch: solve each node's islands on threads pinned to
+  // that node, so the scratch a solve allocates is first-touched -- and the
+  // sticky assignment keeps it re-touched -- on the socket that owns it
+  if (numa_aware_islands)
+  {
+    update_numa_island_domains(islands);
+    const unsigned NDOM = (unsigned) _numa_node_cpus.size();
+    if (NDOM >= 2 && (unsigned) omp_get_max_threads() >= NDOM)
     {
-      // get the inboard and outboard links for the joint
-      shared_ptr<RigidBodyd> ib = implicit_joints[j]->get_inboard_link();
-      shared_ptr<RigidBodyd> ob = implicit_joints[j]->get_outboard_link();
+      if (_numa_thread_node.size() < (unsigned) omp_get_max_threads())
+        _numa_thread_node.resize(omp_get_max_threads(), -1);
 
-      // get the super bodies 
-      shared_ptr<DynamicBodyd> ib_super = ib->get_super_body(); 
-      shared_ptr<DynamicBodyd> ob_super = ob->get_super_body(); 
-
-      if (std::binary_search(island.begin(), island.end(), ib_super) ||
-          std::binary_search(island.begin(), island.end(), ob_super))
-        island_ijoints.push_back(implicit_joints[j]);
+      #pragma omp parallel
+      {
+        const unsigned NTHREADS = (unsigned) omp_get_num_threads();
+        const unsigned TID = (unsigned) omp_get_thread_num();
+
+        if (NTHREADS < NDOM)
+        {
+          // degenerate team (dynamic thread adjustment shrank it below the
+          // node count); solve round-robin with no placement
+          for (unsigned i=TID; i< active.size(); i+= NTHREADS)
+            calc_fwd_dyn_island(islands[active[i]], dt);
+        }
+        else
+        {
+          // contiguous blocks of the team serve consecutive nodes
+          const unsigned NODE = TID*NDOM/NTHREADS;
+
+          // pin on the first visit; the binding persists across steps
+          if (_numa_thread_node[TID] != (int) NODE)
+          {
+            pin_caller_to_cpus(_numa_node_cpus[NODE]);
+            _numa_thread_node[TID] = (int) NODE;
+          }
+
+          // determine this thread's lane among the node's threads
+          unsigned lane = 0, nlanes = 0;
+          for (unsigned t=0; t< NTHREADS; t++)
+            if (t*NDOM/NTHREADS == NODE)
+            {
+              if (t == TID)
+                lane = nlanes;
+              nlanes++;
+            }
+
+          // round-robin the node's islands over its lanes
+          unsigned seen = 0;
+          for (unsigned i=0; i< active.size(); i++)
+          {
+            if (_numa_island_domain[active[i]] != NODE)
+              continue;
+            if (seen++ % nlanes == lane)
+              calc_fwd_dyn_island(islands[active[i]], dt);
+          }
+        }
+      }
+      return;
     }
+  }
+  #endif
 
-    // get all implicit joints from articulated bodies in the island
-    for (unsigned j=0; j< island.size(); j++)
-    {
-      // see whether the body is articulated
-      shared_ptr<ArticulatedBodyd> ab = dynamic_pointer_cast<ArticulatedBodyd>(island[j]);
-      if (!ab)
-        continue;
+  // calculate forward dynamics for each island; islands share no simulation
+  // state, so the loop is dispatched over threads (dynamic scheduling load
+  // balances islands of disparate size) with per-island scratch storage
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic)
+  #endif
+  for (int i=0; i< (int) active.size(); i++)
+    calc_fwd_dyn_island(islands[active[i]], dt);
+}
 
-      // get the implicit joints for this body
-      const vector<shared_ptr<Jointd> >& ijoints = ab->get_implicit_joints();
+/// Calculates forward dynamics for a single island (does not consider unilateral constraints)
+void Simulator::calc_fwd_dyn_island(vector<shared_ptr<DynamicBodyd> >& island, double dt)
+{
+  VectorNd v, a, lambda, f;
+  vector<JointPtr> island_ijoints;
 
-      // add the joints
-      for (unsigned k=0; k< ijoints.size(); k++)
-        island_ijoints.push_back(dynamic_pointer_cast<Joint>(ijoints[k]));
-    }
+  // fast path: a lone non-articulated body with no simulator implicit
+  // joints cannot be subject to implicit constraints; skip the joint scans
+  if (island.size() == 1 && implicit_joints.empty() &&
+      !dynamic_pointer_cast<ArticulatedBodyd>(island.front()))
+  {
+    island.front()->calc_fwd_dyn();
+    return;
+  }
 
-    // get number of implicit constraints
-    const unsigned N_IMPLICIT = island_ijoints.size();
-  
-    // if there are no implicit constraints, just call calc_fwd_dyn(.) on
-    // each body
-    if (N_IMPLICIT == 0)
+  // sort the island so that we can search it
+  std::sort(island.begin(), island.end());
+
+  // get the implicit joints in the island
+  for (unsigned j=0; j< implicit_joints.size(); j++)
+  {
+    // get the inboard and outboard links for the joint
+    shared_ptr<RigidBodyd> ib = implicit_joints[j]->get_inboard_link();
+    shared_ptr<RigidBodyd> ob = implicit_joints[j]->get_outboard_link();
+
+    // get the super bodies 
+    shared_ptr<DynamicBodyd> ib_super = ib->get_super_body(); 
+    shared_ptr<DynamicBodyd> ob_super = ob->get_super_body(); 
+
+    if (std::binary_search(island.begin(), island.end(), ib_super) ||
+        std::binary_search(island.begin(), island.end(), ob_super))
+      island_ijoints.push_back(implicit_joints[j]);
+  }
+
+  // get all implicit joints from articulated bodies in the island
+  for (unsigned j=0; j< island.size(); j++)
+  {
+    // see whether the body is articulated
+    shared_ptr<ArticulatedBodyd> ab = dynamic_pointer_cast<ArticulatedBodyd>(island[j]);
+    if (!ab)
+      continue;
+
+    // get the implicit joints for this body
+    const vector<shared_ptr<Jointd> >& ijoints = ab->get_implicit_joints();
+
+    // add the joints
+    for (unsigned k=0; k< ijoints.size(); k++)
+      island_ijoints.push_back(dynamic_pointer_cast<Joint>(ijoints[k]));
+  }
+
+  // get number of implicit constraints
+  const unsigned N_IMPLICIT = island_ijoints.size();
+
+  // if there are no implicit constraints, just call calc_fwd_dyn(.) on
+  // each body
+  if (N_IMPLICIT == 0)
+  {
+    for (unsigned j=0; j< island.size(); j++)
     {
-      for (unsigned j=0; j< island.size(); j++)
-      {
-        // get the body
-        shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(island[j]); 
+      // get the body
+      shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(island[j]); 
 
-        // no implicit constraints? just calculate forward dynamics for the body
-        db->calc_fwd_dyn();
-      }
+      // no implicit constraints? just calculate forward dynamics for the body
+      db->calc_fwd_dyn();
     }
-    else // there are implicit constraints - must go through the solve process
-    {
-      // get the total number of generalized coordinates for the island
-      const unsigned NGC_TOTAL = num_generalized_coordinates(island);
+  }
+  else // there are implicit constraints - must go through the solve process
+  {
+    // get the total number of generalized coordinates for the island
+    const unsigned NGC_TOTAL = num_generalized_coordinates(island);
 
-      // setup f
-      f.resize(NGC_TOTAL);
-      for (unsigned i=0, gc_index = 0; i< island.size(); i++)
-      {
-        const unsigned NGC = island[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
-        SharedVectorNd f_sub = f.segment(gc_index, gc_index + NGC);
-        island[i]->get_generalized_forces(f_sub);
-        gc_index += NGC;
-      }
+    // setup f
+    f.resize(NGC_TOTAL);
+    for (unsigned i=0, gc_index = 0; i< island.size(); i++)
+    {
+      const unsigned NGC = island[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
+      SharedVectorNd f_sub = f.segment(gc_index, gc_index + NGC);
+      island[i]->get_generalized_forces(f_sub);
+      gc_index += NGC;
+    }
 
-      // get current velocities 
-      v.resize(NGC_TOTAL);
-      for (unsigned i=0, gc_index = 0; i< island.size(); i++)
-      {
-        const unsigned NGC = island[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
-        SharedVectorNd v_sub = v.segment(gc_index, gc_index + NGC);
-        island[i]->get_generalized_velocity(DynamicBodyd::eSpatial, v_sub);
-        gc_index += NGC;
-      }
+    // get current velocities 
+    v.resize(NGC_TOTAL);
+    for (unsigned i=0, gc_index = 0; i< island.size(); i++)
+    {
+      const unsigned NGC = island[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
+      SharedVectorNd v_sub = v.segment(gc_index, gc_index + NGC);
+      island[i]->get_generalized_velocity(DynamicBodyd::eSpatial, v_sub);
+      gc_index += NGC;
+    }
 
-      // compute acceleration and constraint forces
-      solve(island, island_ijoints, v, f, dt, a, lambda);
+    // compute acceleration and constraint forces
+    solve(island, island_ijoints, v, f, dt, a, lambda);
 
-      // set accelerations
-      for (unsigned i=0, gc_index = 0; i< island.size(); i++)
-      {
-        const unsigned NGC = island[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
-        SharedConstVectorNd a_sub = a.segment(gc_index, gc_index + NGC);
-        island[i]->set_generalized_acceleration(a_sub);
-        gc_index += NGC;
-      }
+    // set accelerations
+    for (unsigned i=0, gc_index = 0; i< island.size(); i++)
+    {
+      const unsigned NGC = island[i]->num_generalized_coordinates(DynamicBodyd::eSpatial);
+      SharedConstVectorNd a_sub = a.segment(gc_index, gc_index + NGC);
+      island[i]->set_generalized_acceleration(a_sub);
+      gc_index += NGC;
+    }
 
-      // populate constraint forces
-      for (unsigned i=0, c_index = 0; i< island_ijoints.size(); i++)
-      {
-        const unsigned NEQ = island_ijoints[i]->num_constraint_eqns();
-        SharedConstVectorNd lambda_sub = lambda.segment(c_index, c_index + NEQ);
-        island_ijoints[i]->lambda = lambda_sub;
-        c_index += NEQ;
-      }
+    // populate constraint forces
+    for (unsigned i=0, c_index = 0; i< island_ijoints.size(); i++)
+    {
+      const unsigned NEQ = island_ijoints[i]->num_constraint_eqns();
+      SharedConstVectorNd lambda_sub = lambda.segment(c_index, c_index + NEQ);
+      island_ijoints[i]->lambda = lambda_sub;
+      c_index += NEQ;
     }
   }
 }
@@ -607,11 +2431,7 @@ void Simulator::calc_fwd_dyn(double dt)
 // J*inv(M)*J'*lambda = J*v + J*inv(M)*f*dt
 void Simulator::solve(const vector<shared_ptr<DynamicBodyd> >& island, const vector<JointPtr>& island_ijoints, const VectorNd& v, const VectorNd& f, double dt, VectorNd& a, VectorNd& lambda) const
 {
-  MatrixNd JiMJT_frr, JiM, iMJT, iMJT_frr, JiMJT, Jm, tmp;
-  VectorNd JiMf_frr, JiMf, iMf, Jv, Jv_frr, lambda_sub; 
   const unsigned N_SPATIAL = 6;
-  map<shared_ptr<DynamicBodyd>, unsigned> gc_map;
-  std::vector<MatrixBlock> inv_inertias;
 
   // get dynamic bodies in the island and total number of generalized coords
   unsigned NGC_TOTAL = num_generalized_coordinates(island);
@@ -621,6 +2441,29 @@ void Simulator::solve(const vector<shared_ptr<DynamicBodyd> >& island, const vec
   for (unsigned i=0; i< island_ijoints.size(); i++)
     n_implicit_eqns += island_ijoints[i]->num_constraint_eqns();
 
+  // fast path: a single free rigid body with no implicit constraints- the
+  // overwhelmingly common island in debris-type scenes- needs no island
+  // assembly at all; the body's generalized inertia solve runs on Ravelin's
+  // closed-form, fixed-size spatial arithmetic
+  if (n_implicit_eqns == 0 && island.size() == 1 && NGC_TOTAL == N_SPATIAL)
+  {
+    shared_ptr<RigidBodyd> rb = dynamic_pointer_cast<RigidBodyd>(island.front());
+    if (rb)
+    {
+      lambda.resize(0);
+      a.resize(N_SPATIAL);
+      SharedConstVectorNd f_sub = f.segment(0, N_SPATIAL);
+      SharedVectorNd a_sub = a.segment(0, N_SPATIAL);
+      rb->solve_generalized_inertia(f_sub, a_sub);
+      return;
+    }
+  }
+
+  MatrixNd JiMJT_frr, JiM, iMJT, iMJT_frr, JiMJT, Jm, tmp;
+  VectorNd JiMf_frr, JiMf, iMf, Jv, Jv_frr, lambda_sub;
+  map<shared_ptr<DynamicBodyd>, unsigned> gc_map;
+  std::vector<MatrixBlock> inv_inertias;
+
   // if there are no implicit equations, just solve with generalized inertia
   // matrices
   if (n_implicit_eqns == 0)
@@ -698,7 +2541,7 @@ void Simulator::solve(const vector<shared_ptr<DynamicBodyd> >& island, const vec
     if (inboard->is_enabled())
     {
       J.blocks.push_back(MatrixBlock());
-      island_ijoints[i]->calc_constraint_jacobian(true, J.blocks.back().block);
+      island_ijoints[i]->calc_constraint_jacobian_prepared(true, J.blocks.back().block);
       J.blocks.back().st_row_idx = eq_idx;
       J.blocks.back().st_col_idx = gc_map[inboard];
     }
@@ -707,7 +2550,7 @@ void Simulator::solve(const vector<shared_ptr<DynamicBodyd> >& island, const vec
     if (outboard->is_enabled())
     {
       J.blocks.push_back(MatrixBlock());
-      island_ijoints[i]->calc_constraint_jacobian(false, J.blocks.back().block);
+      island_ijoints[i]->calc_constraint_jacobian_prepared(false, J.blocks.back().block);
       J.blocks.back().st_row_idx = eq_idx;
       J.blocks.back().st_col_idx = gc_map[outboard];
     }
@@ -826,11 +2669,56 @@ void Simulator::load_from_xml(shared_ptr<const XMLTree> node, std::map<std::stri
   // don't verify that the node is correct, b/c Simulator can be subclassed
   // ***********************************************************************
   
-  // get the current time 
+  // get the current time
   XMLAttrib* time_attr = node->get_attrib("current-time");
   if (time_attr)
     this->current_time = time_attr->get_real_value();
 
+  // see whether to collect per-phase step timings
+  XMLAttrib* profiling_attr = node->get_attrib("step-profiling");
+  if (profiling_attr)
+    profiler.enabled = profiling_attr->get_bool_value();
+
+  // get the window size for the step profiler, if specified
+  XMLAttrib* profiling_window_attr = node->get_attrib("step-profiling-window");
+  if (profiling_window_attr)
+    profiler.set_window_size(profiling_window_attr->get_unsigned_value());
+
+  // see whether bodies at rest may be put to sleep
+  XMLAttrib* sleeping_attr = node->get_attrib("sleeping-enabled");
+  if (sleeping_attr)
+    sleeping_enabled = sleeping_attr->get_bool_value();
+
+  // see whether quiescent steps are fast-forwarded
+  XMLAttrib* sss_attr = node->get_attrib("steady-state-skipping-enabled");
+  if (sss_attr)
+    steady_state_skipping_enabled = sss_attr->get_bool_value();
+
+  // see whether to integrate through packed structure-of-arrays buffers
+  XMLAttrib* soa_attr = node->get_attrib("soa-integration");
+  if (soa_attr)
+    soa_integration = soa_attr->get_bool_value();
+
+  // see whether gravity-only free bodies are integrated analytically
+  XMLAttrib* ballistic_attr = node->get_attrib("ballistic-fast-path");
+  if (ballistic_attr)
+    ballistic_fast_path = ballistic_attr->get_bool_value();
+
+  // see whether fixed implicit joints are merged into compound bodies
+  XMLAttrib* merge_fixed_attr = node->get_attrib("merge-fixed-joints");
+  if (merge_fixed_attr)
+    merge_fixed_joints = merge_fixed_attr->get_bool_value();
+
+  // see whether island dynamics are placed NUMA-aware
+  XMLAttrib* numa_attr = node->get_attrib("numa-aware-islands");
+  if (numa_attr)
+    numa_aware_islands = numa_attr->get_bool_value();
+
+  // get the memory budget, if specified (may exceed the range of unsigned)
+  XMLAttrib* memory_budget_attr = node->get_attrib("memory-budget");
+  if (memory_budget_attr)
+    memory_budget = (unsigned long) memory_budget_attr->get_real_value();
+
   // get the dissipator, if any
   XMLAttrib* diss_attr = node->get_attrib("dissipator-id");
   if (diss_attr)
@@ -916,6 +2804,11 @@ void Simulator::load_from_xml(shared_ptr<const XMLTree> node, std::map<std::stri
     }
   }
 
+  // merge fixed implicit joints into compound bodies, if requested; this
+  // must precede recurrent force setup so that removed bodies get none
+  if (merge_fixed_joints)
+    merge_fixed_implicit_joints();
+
   // get all recurrent forces used in the simulator -- note: this must be done
   // *after* all bodies have been loaded
   child_nodes = node->find_child_nodes("RecurrentForce");
@@ -950,6 +2843,124 @@ void Simulator::load_from_xml(shared_ptr<const XMLTree> node, std::map<std::stri
       }
     }
   }
+
+  // open the co-simulation segment, if requested -- this must come last so
+  // that every body is in place when the records are laid out
+  XMLAttrib* shm_attr = node->get_attrib("shm-cosim-name");
+  if (shm_attr)
+    open_shm_cosim(shm_attr->get_string_value());
+}
+
+/// Merges fixed implicit joints into compound rigid bodies
+/**
+ * Every fixed implicit joint between two free rigid bodies couples them into
+ * one island and adds six constraint rows to every solve over that island.
+ * When merge_fixed_joints is set, such joints are instead eliminated at
+ * load: the outboard body's inertia is folded into the inboard body, its
+ * collision geometries are reattached to the inboard body at the same
+ * absolute pose, and the outboard body and the joint are removed from the
+ * simulation. Joints into articulated bodies are skipped (their links cannot
+ * be removed from the body), as are outboard bodies with controllers or
+ * visualization data, whose callbacks and scene nodes the merge cannot
+ * preserve.
+ */
+void Simulator::merge_fixed_implicit_joints()
+{
+  for (unsigned i=0; i< implicit_joints.size(); )
+  {
+    // only fixed joints are candidates
+    shared_ptr<FixedJoint> fj = dynamic_pointer_cast<FixedJoint>(implicit_joints[i]);
+    if (!fj)
+    {
+      i++;
+      continue;
+    }
+
+    // only joints between free rigid bodies can be merged
+    shared_ptr<RigidBody> inboard = dynamic_pointer_cast<RigidBody>(implicit_joints[i]->get_inboard_link());
+    shared_ptr<RigidBody> outboard = dynamic_pointer_cast<RigidBody>(implicit_joints[i]->get_outboard_link());
+    if (!inboard || !outboard || inboard->get_articulated_body() ||
+        outboard->get_articulated_body())
+    {
+      i++;
+      continue;
+    }
+
+    // the merge cannot preserve the outboard body's control callbacks or
+    // its visualization subtree
+    if (outboard->controller || outboard->batch_controller ||
+        outboard->get_visualization_data())
+    {
+      i++;
+      continue;
+    }
+
+    FILE_LOG(LOG_SIMULATOR) << "Simulator::merge_fixed_implicit_joints() - merging " << outboard->id << " into " << inboard->id << std::endl;
+
+    // fold the outboard body's inertia into the inboard body, expressed at
+    // the inboard link frame (a body fixed to a disabled anchor is itself
+    // effectively static, and a disabled body's inertia is ignored, so the
+    // fold is harmless there)
+    SpatialRBInertiad J = Pose3d::transform(inboard->get_pose(), inboard->get_inertia());
+    J += Pose3d::transform(inboard->get_pose(), outboard->get_inertia());
+    inboard->set_inertia(J);
+
+    // reattach the outboard body's collision geometries to the inboard
+    // body, preserving their absolute poses
+    BOOST_FOREACH(CollisionGeometryPtr cg, outboard->geometries)
+    {
+      Pose3d P = *cg->get_pose();
+      P.update_relative_pose(inboard->get_pose());
+      cg->set_single_body(inboard);
+      cg->set_relative_pose(P);
+      inboard->geometries.push_back(cg);
+    }
+    outboard->geometries.clear();
+
+    // rebase any other implicit joints attached to the merged body so that
+    // fixed-joint chains collapse into a single compound body
+    for (unsigned j=0; j< implicit_joints.size(); j++)
+    {
+      if (j == i)
+        continue;
+      if (implicit_joints[j]->get_inboard_link() == outboard)
+        implicit_joints[j]->set_inboard_link(inboard, true);
+      if (implicit_joints[j]->get_outboard_link() == outboard)
+        implicit_joints[j]->set_outboard_link(inboard, true);
+    }
+
+    // remove the merged body and the joint from the simulation
+    remove_dynamic_body(outboard);
+    implicit_joints.erase(implicit_joints.begin()+i);
+  }
+}
+
+/// Marks every joint's cached per-step constraint data stale
+/**
+ * Called after any operation that changes body configurations (integration,
+ * checkpoint/snapshot restoration, stabilization updates) so that the
+ * prepared constraint evaluations and Jacobians are recomputed on next use.
+ */
+void Simulator::invalidate_joint_step_data()
+{
+  // invalidate the simulator's implicit joints
+  for (unsigned i=0; i< implicit_joints.size(); i++)
+    implicit_joints[i]->invalidate_step_data();
+
+  // invalidate joints belonging to articulated bodies
+  for (unsigned i=0; i< _bodies.size(); i++)
+  {
+    shared_ptr<ArticulatedBodyd> ab = dynamic_pointer_cast<ArticulatedBodyd>(_bodies[i]);
+    if (!ab)
+      continue;
+    const vector<shared_ptr<Jointd> >& joints = ab->get_joints();
+    for (unsigned j=0; j< joints.size(); j++)
+    {
+      JointPtr joint = dynamic_pointer_cast<Joint>(joints[j]);
+      if (joint)
+        joint->invalidate_step_data();
+    }
+  }
 }
 
 /// Finds islands
@@ -958,6 +2969,29 @@ void Simulator::find_islands(vector<vector<shared_ptr<DynamicBodyd> > >& islands
   // clear the islands
   islands.clear();
 
+  // gather the enabled dynamic bodies; the islands depend only on these and
+  // on the implicit joints, so this vector doubles as the cache key
+  vector<shared_ptr<DynamicBodyd> > enabled;
+  enabled.reserve(_bodies.size());
+  for (unsigned i=0; i< _bodies.size(); i++)
+  {
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+    shared_ptr<RigidBodyd> rb = dynamic_pointer_cast<RigidBodyd>(db);
+    if (rb && !rb->is_enabled())
+      continue;
+    enabled.push_back(db);
+  }
+
+  // reuse the memoized decomposition when its inputs are unchanged: bodies
+  // and joints change rarely, and the flat pointer comparison is far cheaper
+  // than rebuilding the node set and edge multimap and re-traversing them
+  if (!_island_key_bodies.empty() && enabled == _island_key_bodies &&
+      implicit_joints == _island_key_joints)
+  {
+    islands = _cached_islands;
+    return;
+  }
+
   // The way that we'll determine the constraint islands is to treat each rigid
   // body present in the constraints as a node in a graph; nodes will be connected
   // to other nodes if (a) they are both present in constraint or (b) they are
@@ -968,14 +3002,7 @@ void Simulator::find_islands(vector<vector<shared_ptr<DynamicBodyd> > >& islands
   typedef multimap<shared_ptr<DynamicBodyd>, shared_ptr<DynamicBodyd> >::const_iterator EdgeIter;
 
   // first, add all nodes
-  for (unsigned i=0; i< _bodies.size(); i++)
-  {
-    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
-    shared_ptr<RigidBodyd> rb = dynamic_pointer_cast<RigidBodyd>(db);
-    if (rb && !rb->is_enabled())
-      continue;
-    nodes.insert(db);
-  }
+  nodes.insert(enabled.begin(), enabled.end());
 
   // loop through all implicit joints in the simulator
   for (unsigned i=0; i< implicit_joints.size(); i++)
@@ -1042,6 +3069,151 @@ void Simulator::find_islands(vector<vector<shared_ptr<DynamicBodyd> > >& islands
       islands.back().push_back(node);
     }
   }
+
+  // memoize the decomposition for the next call
+  _island_key_bodies.swap(enabled);
+  _island_key_joints = implicit_joints;
+  _cached_islands = islands;
+}
+
+/// Record used by partition_islands(): one island, its centroid, and its load
+struct IslandPartitionRecord
+{
+  unsigned island;              // index into the islands vector
+  Origin3d centroid;            // island centroid in the global frame
+  double load;                  // estimated solve cost for the island
+};
+
+/// Orders island records along a single coordinate axis
+struct IslandPartitionAxisComp
+{
+  IslandPartitionAxisComp(unsigned axis_) { axis = axis_; }
+  bool operator()(const IslandPartitionRecord& a, const IslandPartitionRecord& b) const { return a.centroid[axis] < b.centroid[axis]; }
+  unsigned axis;
+};
+
+/// Recursively bisects the records in [begin, end) into ndomains spatial slabs
+static void bisect_islands(vector<IslandPartitionRecord>& recs, unsigned begin, unsigned end, unsigned first_domain, unsigned ndomains, vector<unsigned>& domain_of_island)
+{
+  const unsigned THREE_D = 3;
+
+  // base case: a single domain receives every island in the range
+  if (ndomains == 1 || end - begin <= 1)
+  {
+    for (unsigned i=begin; i< end; i++)
+      domain_of_island[recs[i].island] = first_domain;
+    return;
+  }
+
+  // find the axis along which the centroids in this range spread the most
+  Origin3d lo = recs[begin].centroid, hi = recs[begin].centroid;
+  for (unsigned i=begin+1; i< end; i++)
+    for (unsigned j=0; j< THREE_D; j++)
+    {
+      lo[j] = std::min(lo[j], recs[i].centroid[j]);
+      hi[j] = std::max(hi[j], recs[i].centroid[j]);
+    }
+  unsigned axis = 0;
+  for (unsigned j=1; j< THREE_D; j++)
+    if (hi[j] - lo[j] > hi[axis] - lo[axis])
+      axis = j;
+
+  // order the range along that axis
+  std::sort(recs.begin()+begin, recs.begin()+end, IslandPartitionAxisComp(axis));
+
+  // split the load in proportion to the domain counts on each side
+  const unsigned NLEFT = ndomains/2;
+  double total = 0.0;
+  for (unsigned i=begin; i< end; i++)
+    total += recs[i].load;
+  const double TARGET = total * NLEFT / ndomains;
+  double accum = 0.0;
+  unsigned split = begin;
+  while (split < end-1 && accum + recs[split].load <= TARGET)
+    accum += recs[split++].load;
+  if (split == begin)
+    split++;
+
+  // recurse on the two sides
+  bisect_islands(recs, begin, split, first_domain, NLEFT, domain_of_island);
+  bisect_islands(recs, split, end, first_domain+NLEFT, ndomains-NLEFT, domain_of_island);
+}
+
+/// Partitions the simulation into load-balanced spatial domains
+/**
+ * Assigns every active body to one of \a ndomains spatial regions using
+ * recursive coordinate bisection over the constraint islands.  Islands are
+ * the unit of assignment- splitting one across domains would split a coupled
+ * solve- so each island is placed whole, weighted by its generalized
+ * coordinate count, and each bisection divides the longest spatial axis at
+ * the point that balances load between the two sides.  Each domain's islands
+ * can then be solved with no reference to any other domain's bodies, which
+ * makes the result directly usable as the ownership map of a distributed
+ * decomposition (with the bodies of adjacent slabs forming the ghost
+ * regions).  The partition is cheap to compute, so callers can simply
+ * recompute it whenever body motion skews the per-domain load.  Disabled
+ * bodies belong to no island and are not assigned.
+ */
+void Simulator::partition_islands(unsigned ndomains, vector<vector<shared_ptr<DynamicBodyd> > >& domains)
+{
+  // setup the (possibly empty) domains
+  domains.clear();
+  domains.resize(ndomains);
+  if (ndomains == 0)
+    return;
+
+  // get the islands
+  vector<vector<shared_ptr<DynamicBodyd> > > islands;
+  find_islands(islands);
+
+  // build one record per island: global-frame centroid and solve load
+  vector<IslandPartitionRecord> recs(islands.size());
+  for (unsigned i=0; i< islands.size(); i++)
+  {
+    recs[i].island = i;
+    recs[i].load = (double) num_generalized_coordinates(islands[i]);
+
+    // average over all links so that an articulated body contributes the
+    // center of its extent rather than just its base position
+    Origin3d centroid(0.0, 0.0, 0.0);
+    unsigned nlinks = 0;
+    for (unsigned j=0; j< islands[i].size(); j++)
+    {
+      shared_ptr<ArticulatedBodyd> ab = dynamic_pointer_cast<ArticulatedBodyd>(islands[i][j]);
+      if (ab)
+      {
+        BOOST_FOREACH(shared_ptr<RigidBodyd> link, ab->get_links())
+        {
+          Pose3d P = *link->get_pose();
+          P.update_relative_pose(GLOBAL);
+          centroid += P.x;
+          nlinks++;
+        }
+      }
+      else
+      {
+        shared_ptr<RigidBodyd> rb = dynamic_pointer_cast<RigidBodyd>(islands[i][j]);
+        Pose3d P = *rb->get_pose();
+        P.update_relative_pose(GLOBAL);
+        centroid += P.x;
+        nlinks++;
+      }
+    }
+    if (nlinks > 0)
+      centroid /= (double) nlinks;
+    recs[i].centroid = centroid;
+  }
+
+  // recursively bisect the records into spatial slabs
+  vector<unsigned> domain_of_island(islands.size());
+  bisect_islands(recs, 0, recs.size(), 0, ndomains, domain_of_island);
+
+  // gather each domain's bodies
+  for (unsigned i=0; i< islands.size(); i++)
+  {
+    vector<shared_ptr<DynamicBodyd> >& domain = domains[domain_of_island[i]];
+    domain.insert(domain.end(), islands[i].begin(), islands[i].end());
+  }
 }
 
 /// Implements Base::save_to_xml()
@@ -1056,6 +3228,25 @@ void Simulator::save_to_xml(XMLTreePtr node, std::list<shared_ptr<const Base> >&
   // save the current time 
   node->attribs.insert(XMLAttrib("current-time", this->current_time));
 
+  // save whether per-phase step timings are collected
+  node->attribs.insert(XMLAttrib("step-profiling", profiler.enabled));
+
+  // save whether bodies at rest may be put to sleep
+  node->attribs.insert(XMLAttrib("sleeping-enabled", sleeping_enabled));
+
+  // save whether quiescent steps are fast-forwarded
+  node->attribs.insert(XMLAttrib("steady-state-skipping-enabled", steady_state_skipping_enabled));
+
+  // save whether integration uses packed structure-of-arrays buffers
+  node->attribs.insert(XMLAttrib("soa-integration", soa_integration));
+  node->attribs.insert(XMLAttrib("ballistic-fast-path", ballistic_fast_path));
+  node->attribs.insert(XMLAttrib("merge-fixed-joints", merge_fixed_joints));
+  node->attribs.insert(XMLAttrib("numa-aware-islands", numa_aware_islands));
+  if (memory_budget > 0)
+    node->attribs.insert(XMLAttrib("memory-budget", (long) memory_budget));
+  if (_shm_cosim)
+    node->attribs.insert(XMLAttrib("shm-cosim-name", _shm_cosim_name));
+
   // save the ID of the dissipator
   if (dissipator)
   {
@@ -0,0 +1,187 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <cmath>
+#include <set>
+#include <algorithm>
+#include <Moby/Constants.h>
+#include <Moby/RigidBody.h>
+#include <Moby/ArticulatedBody.h>
+#include <Moby/CollisionGeometry.h>
+#include <Moby/XMLTree.h>
+#include <Moby/BoundingSphere.h>
+#include <Moby/SpatialGridCCD.h>
+
+using boost::dynamic_pointer_cast;
+using boost::shared_ptr;
+using std::set;
+using std::map;
+using std::list;
+using std::vector;
+using std::pair;
+using std::make_pair;
+using namespace Ravelin;
+using namespace Moby;
+
+/// Constructs the spatial grid collision detector with automatic cell sizing
+SpatialGridCCD::SpatialGridCCD()
+{
+  cell_size = 0.0;
+}
+
+/// Does broad phase collision detection using a uniform spatial hash grid
+void SpatialGridCCD::broad_phase(double dt, const vector<ControlledBodyPtr>& bodies, vector<pair<CollisionGeometryPtr, CollisionGeometryPtr> >& to_check)
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  FILE_LOG(LOG_COLDET) << "SpatialGridCCD::broad_phase() entered" << std::endl;
+
+  // clear the vector of pairs to check
+  to_check.clear();
+
+  // get the set of rigid bodies
+  vector<RigidBodyPtr> rbs;
+  for (unsigned i=0; i< bodies.size(); i++)
+  {
+    ArticulatedBodyPtr ab = dynamic_pointer_cast<ArticulatedBody>(bodies[i]);
+    if (ab)
+    {
+      BOOST_FOREACH(shared_ptr<RigidBodyd> rb, ab->get_links())
+        rbs.push_back(dynamic_pointer_cast<RigidBody>(rb));
+    }
+    else
+      rbs.push_back(dynamic_pointer_cast<RigidBody>(bodies[i]));
+  }
+
+  // compute a conservative swept AABB for every geometry from its bounding
+  // sphere, expanded by the distance the body can travel over the step
+  vector<GeomBounds> gbounds;
+  double radius_sum = 0.0;
+  for (unsigned i=0; i< rbs.size(); i++)
+    BOOST_FOREACH(CollisionGeometryPtr cg, rbs[i]->geometries)
+    {
+      // bounding spheres are in the global frame at the current pose and so
+      // must be rebuilt every step for moving bodies
+      map<CollisionGeometryPtr, BVPtr>::iterator bsi = _bounding_spheres.find(cg);
+      if (bsi == _bounding_spheres.end() || rbs[i]->is_enabled())
+        bsi = _bounding_spheres.insert(make_pair(cg, construct_bounding_sphere(cg))).first;
+      shared_ptr<BoundingSphere> bs = dynamic_pointer_cast<BoundingSphere>(bsi->second);
+
+      // expand the sphere by the distance traveled over the step
+      const SVelocityd& v = Pose3d::transform(GLOBAL, rbs[i]->get_velocity());
+      double exp = v.get_linear().norm() * dt;
+      double r = bs->radius + exp;
+      radius_sum += bs->radius;
+
+      GeomBounds gb;
+      gb.geom = cg;
+      gb.lo = bs->center - Vector3d(r, r, r, GLOBAL);
+      gb.hi = bs->center + Vector3d(r, r, r, GLOBAL);
+      gbounds.push_back(gb);
+    }
+
+  // if there are no geometries, there is nothing to do
+  if (gbounds.empty())
+    return;
+
+  // determine the cell edge length; when unset, use twice the mean bounding
+  // radius so a typical object touches only a few cells
+  double edge = cell_size;
+  if (edge <= 0.0)
+    edge = std::max(2.0 * radius_sum / gbounds.size(), NEAR_ZERO);
+
+  // bin each geometry into every cell its swept AABB touches
+  _cells.clear();
+  for (unsigned i=0; i< gbounds.size(); i++)
+  {
+    CellKey lo, hi;
+    lo.x = (int) std::floor(gbounds[i].lo[X] / edge);
+    lo.y = (int) std::floor(gbounds[i].lo[Y] / edge);
+    lo.z = (int) std::floor(gbounds[i].lo[Z] / edge);
+    hi.x = (int) std::floor(gbounds[i].hi[X] / edge);
+    hi.y = (int) std::floor(gbounds[i].hi[Y] / edge);
+    hi.z = (int) std::floor(gbounds[i].hi[Z] / edge);
+    CellKey k;
+    for (k.x = lo.x; k.x <= hi.x; k.x++)
+      for (k.y = lo.y; k.y <= hi.y; k.y++)
+        for (k.z = lo.z; k.z <= hi.z; k.z++)
+          _cells[k].push_back(i);
+  }
+
+  // test geometries sharing a cell for AABB overlap; a pair spanning several
+  // cells is generated in each, so dedupe through a set
+  set<sorted_pair<CollisionGeometryPtr> > overlaps;
+  for (map<CellKey, vector<unsigned> >::const_iterator ci = _cells.begin(); ci != _cells.end(); ci++)
+  {
+    const vector<unsigned>& cell = ci->second;
+    for (unsigned i=0; i< cell.size(); i++)
+      for (unsigned j=i+1; j< cell.size(); j++)
+      {
+        const GeomBounds& a = gbounds[cell[i]];
+        const GeomBounds& b = gbounds[cell[j]];
+        if (a.lo[X] > b.hi[X] || b.lo[X] > a.hi[X] ||
+            a.lo[Y] > b.hi[Y] || b.lo[Y] > a.hi[Y] ||
+            a.lo[Z] > b.hi[Z] || b.lo[Z] > a.hi[Z])
+          continue;
+        overlaps.insert(make_sorted_pair(a.geom, b.geom));
+      }
+  }
+
+  // now setup pairs to check
+  for (set<sorted_pair<CollisionGeometryPtr> >::const_iterator i = overlaps.begin(); i != overlaps.end(); i++)
+  {
+    FILE_LOG(LOG_COLDET) << "overlap between " << i->first << " (" << i->first->get_single_body()->body_id << ") and " << i->second << " (" << i->second->get_single_body()->body_id << ")" << std::endl;
+
+    // if the pair is disabled, continue looping
+    if (this->disabled_pairs.find(*i) != this->disabled_pairs.end())
+      continue;
+
+    // get the rigid bodies corresponding to the geometries
+    RigidBodyPtr rb1 = dynamic_pointer_cast<RigidBody>(i->first->get_single_body());
+    RigidBodyPtr rb2 = dynamic_pointer_cast<RigidBody>(i->second->get_single_body());
+
+    // don't check pairs from the same rigid body
+    if (rb1 == rb2)
+      continue;
+
+    // if both rigid bodies are disabled, don't check
+    if (!rb1->is_enabled() && !rb2->is_enabled())
+      continue;
+
+    // if we're here, we have a candidate for the narrow phase
+    to_check.push_back(make_pair(i->first, i->second));
+    FILE_LOG(LOG_COLDET) << "  ... checking pair" << std::endl;
+  }
+
+  FILE_LOG(LOG_COLDET) << "SpatialGridCCD::broad_phase() exited" << std::endl;
+}
+
+/// Implements Base::load_from_xml()
+void SpatialGridCCD::load_from_xml(shared_ptr<const XMLTree> node, map<std::string, BasePtr>& id_map)
+{
+  assert(strcasecmp(node->name.c_str(), "SpatialGridCCD") == 0);
+
+  // call parent
+  CCD::load_from_xml(node, id_map);
+
+  // read the cell size, if given
+  XMLAttrib* cell_size_attrib = node->get_attrib("cell-size");
+  if (cell_size_attrib)
+    cell_size = cell_size_attrib->get_real_value();
+}
+
+/// Implements Base::save_to_xml()
+void SpatialGridCCD::save_to_xml(XMLTreePtr node, list<shared_ptr<const Base> >& shared_objects) const
+{
+  // call the parent method
+  CCD::save_to_xml(node, shared_objects);
+
+  // (re)set the node name
+  node->name = "SpatialGridCCD";
+
+  // save the cell size
+  node->attribs.insert(XMLAttrib("cell-size", cell_size));
+}
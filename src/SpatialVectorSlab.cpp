@@ -0,0 +1,226 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <cassert>
+#include <Moby/AlignedSlabPool.h>
+#include <Moby/SpatialVectorSlab.h>
+
+using boost::shared_ptr;
+using namespace Ravelin;
+using namespace Moby;
+
+/// Sizes the batch, reusing the lane storage whenever it suffices
+void SpatialVectorSlab::resize(unsigned n)
+{
+  if (n > _capacity)
+  {
+    for (unsigned i=0; i< 6; i++)
+      _lanes[i] = AlignedSlabPool::pool("spatial-slab").acquire(n);
+    _capacity = n;
+  }
+  _n = n;
+}
+
+/// Sets batch element i from raw upper and lower component triples
+void SpatialVectorSlab::set(unsigned i, const Origin3d& upper, const Origin3d& lower)
+{
+  assert(i < _n);
+  for (unsigned j=0; j< 3; j++)
+  {
+    _lanes[j][i] = upper[j];
+    _lanes[j+3][i] = lower[j];
+  }
+}
+
+/// Gets batch element i as raw upper and lower component triples
+void SpatialVectorSlab::get(unsigned i, Origin3d& upper, Origin3d& lower) const
+{
+  assert(i < _n);
+  for (unsigned j=0; j< 3; j++)
+  {
+    upper[j] = _lanes[j][i];
+    lower[j] = _lanes[j+3][i];
+  }
+}
+
+/// Sets batch element i from a spatial velocity (angular upper, linear lower)
+void SpatialVectorSlab::set(unsigned i, const SVelocityd& v)
+{
+  set(i, Origin3d(v.get_angular()), Origin3d(v.get_linear()));
+}
+
+/// Sets batch element i from a spatial force (torque upper, force lower)
+void SpatialVectorSlab::set(unsigned i, const SForced& f)
+{
+  set(i, Origin3d(f.get_torque()), Origin3d(f.get_force()));
+}
+
+/// Gets batch element i as a spatial velocity in the given pose
+SVelocityd SpatialVectorSlab::get_velocity(unsigned i, shared_ptr<const Pose3d> pose) const
+{
+  Origin3d ang, lin;
+  get(i, ang, lin);
+  return SVelocityd(Vector3d(ang, pose), Vector3d(lin, pose), pose);
+}
+
+/// Gets batch element i as a spatial force in the given pose
+SForced SpatialVectorSlab::get_force(unsigned i, shared_ptr<const Pose3d> pose) const
+{
+  Origin3d trq, frc;
+  get(i, trq, frc);
+  return SForced(Vector3d(frc, pose), Vector3d(trq, pose), pose);
+}
+
+namespace Moby {
+
+/// Computes y += a*x over a batch of spatial vectors
+void batch_spatial_axpy(double a, const SpatialVectorSlab& x, SpatialVectorSlab& y)
+{
+  assert(x.size() == y.size());
+  const unsigned N = x.size();
+
+  for (unsigned j=0; j< 6; j++)
+  {
+    const double* xj = x.lane(j);
+    double* yj = y.lane(j);
+    for (unsigned k=0; k< N; k++)
+      yj[k] += a*xj[k];
+  }
+}
+
+// emits one unit-stride sweep of a cross-product component:
+// out = p*q - r*s, elementwise over the batch
+static void cross_component(const double* p, const double* q, const double* r, const double* s, double* out, unsigned n)
+{
+  for (unsigned k=0; k< n; k++)
+    out[k] = p[k]*q[k] - r[k]*s[k];
+}
+
+// as cross_component(), but accumulating into out
+static void cross_component_add(const double* p, const double* q, const double* r, const double* s, double* out, unsigned n)
+{
+  for (unsigned k=0; k< n; k++)
+    out[k] += p[k]*q[k] - r[k]*s[k];
+}
+
+/// Computes the spatial cross product of two batches of motion vectors
+/**
+ * For each batch element, with v = (a; l) and w = (a'; l') (angular; linear):
+ * out = (a x a'; a x l' + l x a').  out may not alias either operand.
+ */
+void batch_spatial_cross(const SpatialVectorSlab& v, const SpatialVectorSlab& w, SpatialVectorSlab& out)
+{
+  assert(v.size() == w.size());
+  const unsigned N = v.size();
+  out.resize(N);
+
+  // angular part: a x a'
+  for (unsigned j=0; j< 3; j++)
+    cross_component(v.lane((j+1)%3), w.lane((j+2)%3), v.lane((j+2)%3), w.lane((j+1)%3), out.lane(j), N);
+
+  // linear part: a x l' + l x a'
+  for (unsigned j=0; j< 3; j++)
+  {
+    cross_component(v.lane((j+1)%3), w.lane(3+(j+2)%3), v.lane((j+2)%3), w.lane(3+(j+1)%3), out.lane(j+3), N);
+    cross_component_add(v.lane(3+(j+1)%3), w.lane((j+2)%3), v.lane(3+(j+2)%3), w.lane((j+1)%3), out.lane(j+3), N);
+  }
+}
+
+/// Computes the spatial cross product of a motion batch with a force batch
+/**
+ * For each batch element, with v = (a; l) and f = (n; g) (torque; force):
+ * out = (a x n + l x g; a x g).  out may not alias either operand.
+ */
+void batch_spatial_cross_star(const SpatialVectorSlab& v, const SpatialVectorSlab& f, SpatialVectorSlab& out)
+{
+  assert(v.size() == f.size());
+  const unsigned N = v.size();
+  out.resize(N);
+
+  // torque part: a x n + l x g
+  for (unsigned j=0; j< 3; j++)
+  {
+    cross_component(v.lane((j+1)%3), f.lane((j+2)%3), v.lane((j+2)%3), f.lane((j+1)%3), out.lane(j), N);
+    cross_component_add(v.lane(3+(j+1)%3), f.lane(3+(j+2)%3), v.lane(3+(j+2)%3), f.lane(3+(j+1)%3), out.lane(j), N);
+  }
+
+  // force part: a x g
+  for (unsigned j=0; j< 3; j++)
+    cross_component(v.lane((j+1)%3), f.lane(3+(j+2)%3), v.lane((j+2)%3), f.lane(3+(j+1)%3), out.lane(j+3), N);
+}
+
+/// Computes per-element spatial dots (power pairings) of two batches
+/**
+ * For each batch element, out[k] is the pairing of the upper lanes of one
+ * operand with the lower lanes of the other (e.g., velocity-force power:
+ * angular . torque + linear . force); out must hold size() doubles.
+ */
+void batch_spatial_dot(const SpatialVectorSlab& v, const SpatialVectorSlab& f, double* out)
+{
+  assert(v.size() == f.size());
+  const unsigned N = v.size();
+
+  for (unsigned k=0; k< N; k++)
+    out[k] = 0.0;
+  for (unsigned j=0; j< 6; j++)
+  {
+    const double* vj = v.lane(j);
+    const double* fj = f.lane(j);
+    for (unsigned k=0; k< N; k++)
+      out[k] += vj[k]*fj[k];
+  }
+}
+
+/// Transforms a batch of motion vectors between frames
+/**
+ * For each batch element, with m = (a; l) expressed in the source frame,
+ * R the source-to-target rotation and x the source origin in the target
+ * frame: out = (R a; R l + x cross R a).  out may not alias m.
+ */
+void batch_spatial_transform(const Transform3d& T, const SpatialVectorSlab& m, SpatialVectorSlab& out)
+{
+  const unsigned N = m.size();
+  out.resize(N);
+
+  // expand the rotation once; the sweeps then touch only scalars and lanes
+  Matrix3d R = T.q;
+
+  // rotate the upper and lower triples
+  for (unsigned i=0; i< 3; i++)
+  {
+    const double r0 = R(i,0), r1 = R(i,1), r2 = R(i,2);
+    const double* a0 = m.lane(0);
+    const double* a1 = m.lane(1);
+    const double* a2 = m.lane(2);
+    const double* l0 = m.lane(3);
+    const double* l1 = m.lane(4);
+    const double* l2 = m.lane(5);
+    double* oa = out.lane(i);
+    double* ol = out.lane(i+3);
+    for (unsigned k=0; k< N; k++)
+    {
+      oa[k] = r0*a0[k] + r1*a1[k] + r2*a2[k];
+      ol[k] = r0*l0[k] + r1*l1[k] + r2*l2[k];
+    }
+  }
+
+  // add the moment term x cross (R a) to the lower triple
+  const double x0 = T.x[0], x1 = T.x[1], x2 = T.x[2];
+  const double* oa0 = out.lane(0);
+  const double* oa1 = out.lane(1);
+  const double* oa2 = out.lane(2);
+  double* ol0 = out.lane(3);
+  double* ol1 = out.lane(4);
+  double* ol2 = out.lane(5);
+  for (unsigned k=0; k< N; k++)
+  {
+    ol0[k] += x1*oa2[k] - x2*oa1[k];
+    ol1[k] += x2*oa0[k] - x0*oa2[k];
+    ol2[k] += x0*oa1[k] - x1*oa0[k];
+  }
+}
+
+} // end namespace
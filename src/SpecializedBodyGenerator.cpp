@@ -0,0 +1,295 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <Moby/Joint.h>
+#include <Moby/SpecializedBodyGenerator.h>
+
+using namespace Ravelin;
+using namespace Moby;
+using std::string;
+using std::vector;
+using boost::shared_ptr;
+
+/// Determines whether a string is usable as a C++ identifier
+static bool valid_class_name(const string& s)
+{
+  if (s.empty() || (!std::isalpha(s[0]) && s[0] != '_'))
+    return false;
+  for (unsigned i=1; i< s.size(); i++)
+    if (!std::isalnum(s[i]) && s[i] != '_')
+      return false;
+  return true;
+}
+
+/// Emits the name of factor entry L(i,j) of the generated Cholesky
+static string lname(unsigned i, unsigned j)
+{
+  std::ostringstream oss;
+  oss << "l" << i << "_" << j;
+  return oss.str();
+}
+
+/// Writes the specialized plugin source for a body to a stream
+/**
+ * \param body the fully loaded body whose topology is baked into the code
+ * \param class_name the name of the emitted class (must be a C++ identifier)
+ * \param out the stream receiving the translation unit
+ * \return true on success; failures are reported on stderr
+ */
+bool SpecializedBodyGenerator::generate(shared_ptr<RCArticulatedBody> body, const string& class_name, std::ostream& out)
+{
+  const unsigned SPATIAL_DIM = 6;
+
+  // validate the inputs
+  if (!body)
+  {
+    std::cerr << "SpecializedBodyGenerator::generate() - no body given!" << std::endl;
+    return false;
+  }
+  if (!valid_class_name(class_name))
+  {
+    std::cerr << "SpecializedBodyGenerator::generate() - '" << class_name << "' is not a usable class name" << std::endl;
+    return false;
+  }
+  const unsigned NGC = body->num_generalized_coordinates(DynamicBodyd::eSpatial);
+  if (NGC == 0)
+  {
+    std::cerr << "SpecializedBodyGenerator::generate() - body has no generalized coordinates" << std::endl;
+    return false;
+  }
+
+  // joint coordinates lead the generalized vector; a floating base
+  // contributes the trailing six
+  const unsigned NJDOF = body->is_floating_base() ? NGC - SPATIAL_DIM : NGC;
+
+  // map every joint coordinate to its explicit joint
+  const vector<shared_ptr<Jointd> >& ejoints = body->get_explicit_joints();
+  vector<int> coord_joint(NJDOF, -1);
+  for (unsigned i=0; i< ejoints.size(); i++)
+    for (unsigned j=0; j< ejoints[i]->num_dof(); j++)
+    {
+      const unsigned k = ejoints[i]->get_coord_index() + j;
+      if (k < NJDOF)
+        coord_joint[k] = (int) i;
+    }
+
+  // determine the ancestor relation over the explicit joints by walking
+  // each joint's inboard chain to the base
+  shared_ptr<RigidBodyd> base = body->get_base_link();
+  vector<vector<bool> > anc(ejoints.size(), vector<bool>(ejoints.size(), false));
+  for (unsigned i=0; i< ejoints.size(); i++)
+  {
+    shared_ptr<RigidBodyd> rb = ejoints[i]->get_inboard_link();
+    while (rb && rb != base)
+    {
+      shared_ptr<Jointd> inner = rb->get_inner_joint_explicit();
+      if (!inner)
+        break;
+      for (unsigned j=0; j< ejoints.size(); j++)
+        if (ejoints[j] == inner)
+          anc[i][j] = true;
+      rb = inner->get_inboard_link();
+    }
+  }
+
+  // mark the structural nonzeros of the joint-space inertia: coordinates
+  // couple only when their joints lie on a common root-to-leaf path, and
+  // floating base coordinates couple with everything (unmapped coordinates
+  // are conservatively treated like base coordinates)
+  vector<vector<bool> > nz(NGC, vector<bool>(NGC, false));
+  for (unsigned i=0; i< NGC; i++)
+    for (unsigned j=0; j<= i; j++)
+    {
+      if (i >= NJDOF || j >= NJDOF)
+      {
+        nz[i][j] = true;
+        continue;
+      }
+      const int ji = coord_joint[i], jj = coord_joint[j];
+      nz[i][j] = (ji < 0 || jj < 0 || ji == jj || anc[ji][jj] || anc[jj][ji]);
+    }
+
+  // symbolic Cholesky factorization: column k of the factor fills column
+  // j > k of row i wherever L(j,k) and L(i,k) are both nonzero
+  for (unsigned j=0; j< NGC; j++)
+    for (unsigned k=0; k< j; k++)
+    {
+      if (!nz[j][k])
+        continue;
+      for (unsigned i=j+1; i< NGC; i++)
+        if (nz[i][k])
+          nz[i][j] = true;
+    }
+
+  // count the pruned entries for the emitted header comment
+  unsigned n_pruned = 0;
+  for (unsigned i=0; i< NGC; i++)
+    for (unsigned j=0; j< i; j++)
+      if (!nz[i][j])
+        n_pruned++;
+  const unsigned N_SUBDIAG = NGC*(NGC-1)/2;
+
+  // emit the file header
+  out << "/****************************************************************************" << std::endl;
+  out << " * Specialized forward dynamics plugin generated by Moby's" << std::endl;
+  out << " * SpecializedBodyGenerator from body '" << body->id << "': " << body->get_links().size() << " links, " << ejoints.size() << " explicit joints, " << NGC << std::endl;
+  out << " * generalized coordinates (" << (body->is_floating_base() ? "floating" : "fixed") << " base).  " << n_pruned << " of " << N_SUBDIAG << " subdiagonal inertia" << std::endl;
+  out << " * entries are structurally zero and pruned from the unrolled factorization." << std::endl;
+  out << " *" << std::endl;
+  out << " * Compile with optimization into a shared library linked against Moby and" << std::endl;
+  out << " * load it with:" << std::endl;
+  out << " *   <RCArticulatedBodySymbolicPlugin plugin=\"lib" << class_name << ".so\" ...>" << std::endl;
+  out << " * in place of the RCArticulatedBody tag.  Regenerate this file whenever the" << std::endl;
+  out << " * model's links or joints change; a stale plugin falls back to the generic" << std::endl;
+  out << " * solve at runtime rather than computing wrong dynamics." << std::endl;
+  out << " ****************************************************************************/" << std::endl;
+  out << std::endl;
+  out << "#include <cmath>" << std::endl;
+  out << "#include <iostream>" << std::endl;
+  out << "#include <vector>" << std::endl;
+  out << "#include <boost/shared_ptr.hpp>" << std::endl;
+  out << "#include <Moby/Joint.h>" << std::endl;
+  out << "#include <Moby/RCArticulatedBody.h>" << std::endl;
+  out << std::endl;
+
+  // emit the class
+  out << "/// Forward dynamics for '" << body->id << "', specialized at generation time" << std::endl;
+  out << "class " << class_name << " : public Moby::RCArticulatedBody" << std::endl;
+  out << "{" << std::endl;
+  out << "  public:" << std::endl;
+  out << "    virtual void calc_fwd_dyn();" << std::endl;
+  out << std::endl;
+  out << "  private:" << std::endl;
+  out << "    Ravelin::MatrixNd _spec_M;" << std::endl;
+  out << "    Ravelin::VectorNd _spec_f;" << std::endl;
+  out << "};" << std::endl;
+  out << std::endl;
+
+  // emit the specialized solve
+  out << "/// Computes forward dynamics through an unrolled, sparsity-pruned solve" << std::endl;
+  out << "void " << class_name << "::calc_fwd_dyn()" << std::endl;
+  out << "{" << std::endl;
+  out << "  const unsigned NGC = " << NGC << ";" << std::endl;
+  out << std::endl;
+  out << "  // a stale plugin must degrade to the generic path, not to wrong dynamics" << std::endl;
+  out << "  if (num_generalized_coordinates(Ravelin::DynamicBodyd::eSpatial) != NGC)" << std::endl;
+  out << "  {" << std::endl;
+  out << "    std::cerr << \"" << class_name << "::calc_fwd_dyn() - coordinate count differs from the generated topology; using the generic solve\" << std::endl;" << std::endl;
+  out << "    Moby::RCArticulatedBody::calc_fwd_dyn();" << std::endl;
+  out << "    return;" << std::endl;
+  out << "  }" << std::endl;
+  out << std::endl;
+  out << "  // implicit joint friction runs through the generic solve" << std::endl;
+  out << "  if (joint_friction_dt > 0.0)" << std::endl;
+  out << "  {" << std::endl;
+  out << "    const std::vector<boost::shared_ptr<Ravelin::Jointd> >& ejoints = get_explicit_joints();" << std::endl;
+  out << "    for (unsigned i=0; i< ejoints.size(); i++)" << std::endl;
+  out << "    {" << std::endl;
+  out << "      boost::shared_ptr<Moby::Joint> joint = boost::dynamic_pointer_cast<Moby::Joint>(ejoints[i]);" << std::endl;
+  out << "      if (joint && (joint->mu_fc > 0.0 || joint->mu_fv > 0.0))" << std::endl;
+  out << "      {" << std::endl;
+  out << "        Moby::RCArticulatedBody::calc_fwd_dyn();" << std::endl;
+  out << "        return;" << std::endl;
+  out << "      }" << std::endl;
+  out << "    }" << std::endl;
+  out << "  }" << std::endl;
+  out << std::endl;
+  out << "  // gather the inertia and the bias-corrected applied forces" << std::endl;
+  out << "  get_generalized_inertia(_spec_M);" << std::endl;
+  out << "  get_generalized_forces(_spec_f);" << std::endl;
+  out << std::endl;
+  out << "  // unrolled Cholesky factorization M = L*L'" << std::endl;
+
+  // factor, column by column
+  for (unsigned j=0; j< NGC; j++)
+  {
+    // the diagonal entry, guarded against loss of positive definiteness
+    out << "  double d" << j << " = _spec_M(" << j << "," << j << ")";
+    for (unsigned k=0; k< j; k++)
+      if (nz[j][k])
+        out << " - " << lname(j,k) << "*" << lname(j,k);
+    out << ";" << std::endl;
+    out << "  if (d" << j << " <= 0.0)" << std::endl;
+    out << "  {" << std::endl;
+    out << "    std::cerr << \"" << class_name << "::calc_fwd_dyn() - inertia not positive definite; using the generic solve\" << std::endl;" << std::endl;
+    out << "    Moby::RCArticulatedBody::calc_fwd_dyn();" << std::endl;
+    out << "    return;" << std::endl;
+    out << "  }" << std::endl;
+    out << "  const double " << lname(j,j) << " = std::sqrt(d" << j << ");" << std::endl;
+    out << "  const double invl" << j << " = 1.0/" << lname(j,j) << ";" << std::endl;
+
+    // the subdiagonal entries of this column
+    for (unsigned i=j+1; i< NGC; i++)
+    {
+      if (!nz[i][j])
+        continue;
+      out << "  const double " << lname(i,j) << " = (_spec_M(" << i << "," << j << ")";
+      for (unsigned k=0; k< j; k++)
+        if (nz[i][k] && nz[j][k])
+          out << " - " << lname(i,k) << "*" << lname(j,k);
+      out << ")*invl" << j << ";" << std::endl;
+    }
+  }
+
+  // forward substitution
+  out << std::endl;
+  out << "  // unrolled forward substitution L*y = f" << std::endl;
+  for (unsigned i=0; i< NGC; i++)
+  {
+    out << "  const double y" << i << " = (_spec_f[" << i << "]";
+    for (unsigned k=0; k< i; k++)
+      if (nz[i][k])
+        out << " - " << lname(i,k) << "*y" << k;
+    out << ")*invl" << i << ";" << std::endl;
+  }
+
+  // back substitution
+  out << std::endl;
+  out << "  // unrolled back substitution L'*a = y" << std::endl;
+  for (unsigned i=NGC; i-- > 0; )
+  {
+    out << "  const double a" << i << " = (y" << i;
+    for (unsigned k=i+1; k< NGC; k++)
+      if (nz[k][i])
+        out << " - " << lname(k,i) << "*a" << k;
+    out << ")*invl" << i << ";" << std::endl;
+  }
+
+  // scatter the accelerations
+  out << std::endl;
+  out << "  // scatter the accelerations" << std::endl;
+  for (unsigned i=0; i< NGC; i++)
+    out << "  _spec_f[" << i << "] = a" << i << ";" << std::endl;
+  out << "  set_generalized_acceleration(_spec_f);" << std::endl;
+  out << "}" << std::endl;
+  out << std::endl;
+
+  // emit the plugin entry point
+  out << "// plugin entry point; the 'extern \"C\"' statement is necessary so that" << std::endl;
+  out << "// dlopen() can find the symbol (see XMLReader::read_rc_abody_symbolic())" << std::endl;
+  out << "extern \"C\" boost::shared_ptr<Moby::RCArticulatedBody> factory()" << std::endl;
+  out << "{" << std::endl;
+  out << "  return boost::shared_ptr<Moby::RCArticulatedBody>(new " << class_name << ");" << std::endl;
+  out << "}" << std::endl;
+
+  return out.good();
+}
+
+/// Writes the specialized plugin source for a body to a file
+bool SpecializedBodyGenerator::generate(shared_ptr<RCArticulatedBody> body, const string& class_name, const string& filename)
+{
+  std::ofstream out(filename.c_str());
+  if (!out)
+  {
+    std::cerr << "SpecializedBodyGenerator::generate() - unable to open '" << filename << "' for writing" << std::endl;
+    return false;
+  }
+  return generate(body, class_name, out);
+}
@@ -100,6 +100,57 @@ double SpherePrimitive::calc_signed_dist(const Point3d& p) const
   return p.norm() - _radius;
 }
 
+/// Computes the signed distances of a batch of points from this primitive
+/**
+ * All points must be defined in the same pose; the pose is verified once for
+ * the whole batch and the distance loop is free of virtual dispatch.
+ */
+void SpherePrimitive::calc_signed_dists(const Point3d* points, unsigned n, double* dists) const
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  if (n == 0)
+    return;
+  assert(_poses.find(const_pointer_cast<Pose3d>(points[0].pose)) != _poses.end());
+
+  const double R = _radius;
+  for (unsigned i=0; i< n; i++)
+  {
+    const double x = points[i][X], y = points[i][Y], z = points[i][Z];
+    dists[i] = std::sqrt(x*x + y*y + z*z) - R;
+  }
+}
+
+/// Casts a ray against the sphere (analytic)
+bool SpherePrimitive::ray_cast(const Point3d& origin, const Vector3d& dir, double max_dist, double& t, Vector3d& normal) const
+{
+  assert(_poses.find(const_pointer_cast<Pose3d>(origin.pose)) != _poses.end());
+
+  // solve ||origin + dir*t|| = r for t
+  double A = dir.dot(dir);
+  double B = 2.0 * origin.dot(dir);
+  double C = origin.dot(origin) - _radius*_radius;
+  double disc = B*B - 4.0*A*C;
+  if (disc < 0.0)
+    return false;
+
+  // take the nearest non-negative root (the far root covers rays cast from
+  // inside the sphere)
+  double rt = std::sqrt(disc);
+  t = (-B - rt)/(2.0*A);
+  if (t < 0.0)
+    t = (-B + rt)/(2.0*A);
+  if (t < 0.0 || t > max_dist)
+    return false;
+
+  // the normal points radially outward; orient it against the ray
+  normal = Vector3d::normalize(origin + dir*t);
+  if (normal.dot(dir) > 0.0)
+    normal = -normal;
+
+  return true;
+}
+
 /// Computes the distance from another sphere primitive
 double SpherePrimitive::calc_signed_dist(shared_ptr<const SpherePrimitive> s, Point3d& pthis, Point3d& ps) const
 {
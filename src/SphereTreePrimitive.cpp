@@ -0,0 +1,613 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <cmath>
+#include <strings.h>
+#include <iostream>
+#include <limits>
+#include <algorithm>
+#ifdef USE_OSG
+#include <osg/Group>
+#endif
+#include <Moby/Constants.h>
+#include <Moby/Log.h>
+#include <Moby/XMLTree.h>
+#include <Moby/CollisionGeometry.h>
+#include <Moby/BoundingSphere.h>
+#include <Moby/PairwiseDistDispatch.h>
+#include <Moby/SpherePrimitive.h>
+#include <Moby/BoxPrimitive.h>
+#include <Moby/PlanePrimitive.h>
+#include <Moby/CylinderPrimitive.h>
+#include <Moby/ConePrimitive.h>
+#include <Moby/TorusPrimitive.h>
+#include <Moby/PolyhedralPrimitive.h>
+#include <Moby/HeightmapPrimitive.h>
+#include <Moby/TriangleMeshPrimitive.h>
+#include <Moby/DistanceFieldPrimitive.h>
+#include <Moby/SphereTreePrimitive.h>
+
+using namespace Ravelin;
+using namespace Moby;
+using boost::shared_ptr;
+using boost::const_pointer_cast;
+using boost::dynamic_pointer_cast;
+using boost::static_pointer_cast;
+using std::vector;
+using std::map;
+using std::pair;
+using std::make_pair;
+
+/// Orders spheres by center coordinate along one axis (for median splits)
+namespace {
+struct AxisComp
+{
+  AxisComp(unsigned a) { axis = a; }
+  bool operator()(const pair<Origin3d, double>& x, const pair<Origin3d, double>& y) const { return x.first[axis] < y.first[axis]; }
+  unsigned axis;
+};
+} // end anonymous namespace
+
+/// Dispatch kernel for sphere tree/any (routes to the tree's generic query)
+static double tree_other_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return static_pointer_cast<const SphereTreePrimitive>(pA)->calc_signed_dist(pB, pa, pb);
+}
+
+/// Dispatch kernel for any/sphere tree
+static double other_tree_dist(shared_ptr<const Primitive> pA, shared_ptr<const Primitive> pB, Point3d& pa, Point3d& pb)
+{
+  return tree_other_dist(pB, pA, pb, pa);
+}
+
+/// Constructs an empty sphere tree primitive
+SphereTreePrimitive::SphereTreePrimitive()
+{
+  _nleaves = 0;
+  _max_spheres = 16;
+  _nsamples = 256;
+
+  // the virtual calc_signed_dist() chains of the other primitive types do
+  // not know this type, so partner-initiated queries are routed here through
+  // the dispatch table (the extension point provided for new primitive
+  // types); the tree's generic query handles any partner
+  static bool registered = false;
+  if (!registered)
+  {
+    registered = true;
+    const std::type_info* partners[] = { &typeid(SpherePrimitive), &typeid(BoxPrimitive), &typeid(PlanePrimitive), &typeid(CylinderPrimitive), &typeid(ConePrimitive), &typeid(TorusPrimitive), &typeid(PolyhedralPrimitive), &typeid(HeightmapPrimitive), &typeid(TriangleMeshPrimitive), &typeid(DistanceFieldPrimitive), &typeid(SphereTreePrimitive) };
+    const unsigned N = sizeof(partners)/sizeof(partners[0]);
+    for (unsigned i=0; i< N; i++)
+    {
+      PairwiseDistDispatch::register_kernel(typeid(SphereTreePrimitive), *partners[i], &tree_other_dist);
+      PairwiseDistDispatch::register_kernel(*partners[i], typeid(SphereTreePrimitive), &other_tree_dist);
+    }
+  }
+}
+
+/// Sets the primitive to approximate, (re)building the sphere tree
+void SphereTreePrimitive::set_source(PrimitivePtr source)
+{
+  _source = source;
+  _nodes.clear();
+  _nleaves = 0;
+  _bsphs.clear();
+  if (_source)
+    build();
+
+  // mass properties follow the source
+  calc_mass_properties();
+}
+
+/// Sets the maximum number of leaf spheres, rebuilding the tree
+void SphereTreePrimitive::set_max_spheres(unsigned max_spheres)
+{
+  _max_spheres = max_spheres;
+  if (_source)
+    build();
+}
+
+/// Sets the number of surface samples drawn from the source, rebuilding the tree
+void SphereTreePrimitive::set_num_samples(unsigned nsamples)
+{
+  _nsamples = nsamples;
+  if (_source)
+    build();
+}
+
+/// Builds the sphere tree from the source primitive
+/**
+ * Surface points are sampled along rays from an interior seed through a
+ * Fibonacci spiral of directions; the largest interior sphere tangent at
+ * each sample is grown by bisection on the source's signed distance; the
+ * spheres that greedily cover the samples (to within five percent of the
+ * bounding radius, or until the sphere budget is exhausted) become the
+ * leaves of a median-split binary tree.
+ */
+void SphereTreePrimitive::build()
+{
+  const unsigned UMAX = std::numeric_limits<unsigned>::max();
+
+  // clear any previous tree
+  _nodes.clear();
+  _nleaves = 0;
+  _bsphs.clear();
+
+  // register a scratch geometry on the source so that its query methods
+  // (which operate in per-geometry frames) can be used during the build
+  if (!_scratch)
+    _scratch = CollisionGeometryPtr(new CollisionGeometry);
+  _source->add_collision_geometry(_scratch);
+  shared_ptr<const Pose3d> P = _source->get_pose(_scratch);
+
+  // a degenerate source has no surface to sample
+  const double R = _source->get_bounding_radius();
+  if (R <= 0.0)
+    return;
+
+  // find an interior seed for the surface sampler: the centroid of the
+  // supporting points along the six axis directions, falling back on the
+  // frame origin
+  Origin3d seed(0.0, 0.0, 0.0);
+  for (unsigned i=0; i< 3; i++)
+    for (double s = -1.0; s <= 1.0; s += 2.0)
+    {
+      Vector3d dir(0.0, 0.0, 0.0, P);
+      dir[i] = s;
+      seed += Origin3d(_source->get_supporting_point(dir));
+    }
+  seed /= 6.0;
+  if (_source->calc_signed_dist(Point3d(seed, P)) >= 0.0)
+    seed = Origin3d(0.0, 0.0, 0.0);
+
+  // sample the surface and grow the medial sphere at each sample
+  vector<Origin3d> samples;
+  vector<pair<Origin3d, double> > cands;
+  const double EPS = R * 1e-3;
+  if (_source->calc_signed_dist(Point3d(seed, P)) < 0.0)
+  {
+    const double INC = M_PI * (3.0 - std::sqrt(5.0));
+    const double OFF = 2.0 / _nsamples;
+    const double seed_norm = seed.norm();
+    for (unsigned k=0; k< _nsamples; k++)
+    {
+      // the sampling direction (Fibonacci spiral)
+      const double Y = k * OFF - 1.0 + OFF * 0.5;
+      const double RR = std::sqrt(std::max(0.0, 1.0 - Y*Y));
+      const double PHI = k * INC;
+      Origin3d u(std::cos(PHI)*RR, Y, std::sin(PHI)*RR);
+
+      // bracket the surface along the ray from the seed (the far end lies
+      // outside the bounding sphere, so the distance there is positive)
+      double tlo = 0.0, thi = seed_norm + R*1.01;
+      for (unsigned i=0; i< 30; i++)
+      {
+        double t = (tlo + thi)*0.5;
+        if (_source->calc_signed_dist(Point3d(seed + u*t, P)) < 0.0)
+          tlo = t;
+        else
+          thi = t;
+      }
+      Origin3d sp = seed + u*tlo;
+
+      // grow the largest interior sphere tangent at the sample; the center
+      // recedes along the sampling direction (a stand-in for the inward
+      // normal- the test rejects any radius whose sphere pokes outside)
+      double rlo = 0.0, rhi = R;
+      for (unsigned i=0; i< 20; i++)
+      {
+        double r = (rlo + rhi)*0.5;
+        if (_source->calc_signed_dist(Point3d(sp - u*r, P)) <= -r + EPS)
+          rlo = r;
+        else
+          rhi = r;
+      }
+
+      // reject degenerate spheres (e.g., from samples on thin features)
+      if (rlo <= EPS)
+        continue;
+      samples.push_back(sp);
+      cands.push_back(make_pair(sp - u*rlo, rlo));
+    }
+  }
+
+  // greedily keep the spheres that cover the most still-uncovered samples;
+  // a sample is covered when it lies within a kept sphere inflated by the
+  // cover tolerance
+  const double COVER_TOL = R * 0.05;
+  vector<bool> covered(samples.size(), false);
+  vector<pair<Origin3d, double> > kept;
+  while (kept.size() < _max_spheres)
+  {
+    unsigned best_count = 0, best_i = UMAX;
+    for (unsigned i=0; i< cands.size(); i++)
+    {
+      unsigned count = 0;
+      for (unsigned j=0; j< samples.size(); j++)
+        if (!covered[j] && (samples[j] - cands[i].first).norm() - cands[i].second <= COVER_TOL)
+          count++;
+      if (count > best_count)
+      {
+        best_count = count;
+        best_i = i;
+      }
+    }
+
+    // stop when no sphere covers anything new
+    if (best_i == UMAX)
+      break;
+
+    // keep the sphere and mark the samples it covers
+    kept.push_back(cands[best_i]);
+    for (unsigned j=0; j< samples.size(); j++)
+      if ((samples[j] - cands[best_i].first).norm() - cands[best_i].second <= COVER_TOL)
+        covered[j] = true;
+  }
+
+  // with no usable medial spheres (no interior seed was found or every
+  // candidate was degenerate), fall back on the source's bounding sphere
+  if (kept.empty())
+  {
+    std::cerr << "SphereTreePrimitive::build() - no medial spheres could be grown; approximating the source with its bounding sphere" << std::endl;
+    kept.push_back(make_pair(Origin3d(0.0, 0.0, 0.0), R));
+  }
+
+  // assemble the survivors into the tree
+  _nleaves = (unsigned) kept.size();
+  build_node(kept, 0, _nleaves);
+
+  FILE_LOG(LOG_COLDET) << "SphereTreePrimitive::build() - approximated source with " << _nleaves << " spheres (" << samples.size() << " samples)" << std::endl;
+}
+
+/// Builds the subtree over spheres [lo, hi), returning its root node index
+unsigned SphereTreePrimitive::build_node(vector<pair<Origin3d, double> >& spheres, unsigned lo, unsigned hi)
+{
+  const unsigned UMAX = std::numeric_limits<unsigned>::max();
+
+  // allocate the node (children are appended after it, so the root is 0)
+  const unsigned idx = (unsigned) _nodes.size();
+  _nodes.push_back(SphereNode());
+
+  // a single sphere is a leaf
+  if (hi - lo == 1)
+  {
+    _nodes[idx].center = spheres[lo].first;
+    _nodes[idx].radius = spheres[lo].second;
+    _nodes[idx].kids[0] = _nodes[idx].kids[1] = UMAX;
+    return idx;
+  }
+
+  // bound the subtree's spheres about their centers' centroid
+  Origin3d c(0.0, 0.0, 0.0);
+  for (unsigned i=lo; i< hi; i++)
+    c += spheres[i].first;
+  c /= (double) (hi - lo);
+  double radius = 0.0;
+  Origin3d mn = spheres[lo].first, mx = spheres[lo].first;
+  for (unsigned i=lo; i< hi; i++)
+  {
+    radius = std::max(radius, (spheres[i].first - c).norm() + spheres[i].second);
+    for (unsigned j=0; j< 3; j++)
+    {
+      mn[j] = std::min(mn[j], spheres[i].first[j]);
+      mx[j] = std::max(mx[j], spheres[i].first[j]);
+    }
+  }
+
+  // split at the median along the axis the centers spread widest on
+  unsigned axis = 0;
+  for (unsigned j=1; j< 3; j++)
+    if (mx[j] - mn[j] > mx[axis] - mn[axis])
+      axis = j;
+  const unsigned mid = (lo + hi)/2;
+  std::nth_element(spheres.begin()+lo, spheres.begin()+mid, spheres.begin()+hi, AxisComp(axis));
+
+  // recurse (the node vector may grow, so children are stored by index)
+  const unsigned left = build_node(spheres, lo, mid);
+  const unsigned right = build_node(spheres, mid, hi);
+  _nodes[idx].center = c;
+  _nodes[idx].radius = radius;
+  _nodes[idx].kids[0] = left;
+  _nodes[idx].kids[1] = right;
+  return idx;
+}
+
+/// Finds the leaf sphere nearest a point, pruning with the node spheres
+/**
+ * \param best the best distance found so far (pass infinity initially)
+ * \param best_leaf the index of the nearest leaf is returned here
+ * \return the minimum signed distance from the point to any leaf sphere
+ */
+double SphereTreePrimitive::query_point(unsigned idx, const Origin3d& p, double best, unsigned& best_leaf) const
+{
+  const SphereNode& n = _nodes[idx];
+
+  // the node sphere bounds every leaf below it from below
+  double d = (p - n.center).norm() - n.radius;
+  if (n.kids[0] == std::numeric_limits<unsigned>::max())
+  {
+    if (d < best)
+    {
+      best = d;
+      best_leaf = idx;
+    }
+    return best;
+  }
+  if (d >= best)
+    return best;
+
+  best = query_point(n.kids[0], p, best, best_leaf);
+  best = query_point(n.kids[1], p, best, best_leaf);
+  return best;
+}
+
+/// Computes the signed distance from the sphere tree to a point
+double SphereTreePrimitive::calc_signed_dist(const Point3d& p) const
+{
+  assert(_poses.find(const_pointer_cast<Pose3d>(p.pose)) != _poses.end());
+
+  if (_nodes.empty())
+    return std::numeric_limits<double>::max();
+
+  unsigned best_leaf = std::numeric_limits<unsigned>::max();
+  return query_point(0, Origin3d(p), std::numeric_limits<double>::max(), best_leaf);
+}
+
+/// Computes the signed distance and normal from the sphere tree to a point
+double SphereTreePrimitive::calc_dist_and_normal(const Point3d& point, std::vector<Vector3d>& normals) const
+{
+  assert(!_nodes.empty());
+
+  // find the nearest leaf sphere
+  unsigned best_leaf = std::numeric_limits<unsigned>::max();
+  double d = query_point(0, Origin3d(point), std::numeric_limits<double>::max(), best_leaf);
+
+  // the normal points from the leaf center through the query point
+  const SphereNode& n = _nodes[best_leaf];
+  Vector3d normal(Origin3d(point) - n.center, point.pose);
+  double nrm = normal.norm();
+  if (nrm > NEAR_ZERO)
+    normal /= nrm;
+  else
+    normal = Vector3d(0.0, 0.0, 1.0, point.pose);
+  normals.push_back(normal);
+
+  return d;
+}
+
+/// Descends the tree, evaluating the other primitive at sphere centers
+/**
+ * Internal node evaluations bound their whole subtree (the node sphere
+ * encloses every leaf below it), so subtrees that cannot beat the best leaf
+ * found so far are pruned without visiting them.
+ */
+void SphereTreePrimitive::query_primitive(unsigned idx, shared_ptr<const Primitive> p, const Transform3d& oTt, shared_ptr<const Pose3d> tpose, vector<Vector3d>& normals, double& best, Point3d& best_pthis, Point3d& best_pother) const
+{
+  const SphereNode& n = _nodes[idx];
+
+  // evaluate the other primitive at the node's center
+  Point3d c(n.center, tpose);
+  Point3d co = oTt.transform_point(c);
+  normals.clear();
+  double d = p->calc_dist_and_normal(co, normals);
+
+  // prune subtrees that cannot beat the best leaf found so far
+  if (d - n.radius >= best)
+    return;
+
+  // at a leaf, record the analytic sphere witness points
+  if (n.kids[0] == std::numeric_limits<unsigned>::max())
+  {
+    best = d - n.radius;
+    const Vector3d& nrm = normals.front();
+    best_pother = co - nrm*d;
+    best_pthis = c - Pose3d::transform_vector(tpose, nrm)*n.radius;
+    return;
+  }
+
+  query_primitive(n.kids[0], p, oTt, tpose, normals, best, best_pthis, best_pother);
+  query_primitive(n.kids[1], p, oTt, tpose, normals, best, best_pthis, best_pother);
+}
+
+/// Computes the signed distance between the sphere tree and another primitive
+double SphereTreePrimitive::calc_signed_dist(shared_ptr<const Primitive> p, Point3d& pthis, Point3d& pp) const
+{
+  assert(_poses.find(const_pointer_cast<Pose3d>(pthis.pose)) != _poses.end());
+
+  // an unbuilt tree cannot answer
+  if (_nodes.empty())
+    return std::numeric_limits<double>::max();
+
+  // all sphere centers transform into the other primitive's frame
+  Transform3d oTt = Pose3d::calc_relative_pose(pthis.pose, pp.pose);
+
+  // descend the tree, resolving against leaf spheres analytically
+  vector<Vector3d> normals;
+  double best = std::numeric_limits<double>::max();
+  query_primitive(0, p, oTt, pthis.pose, normals, best, pthis, pp);
+  return best;
+}
+
+/// Gets a supporting point of the sphere tree along a direction
+Point3d SphereTreePrimitive::get_supporting_point(const Vector3d& d) const
+{
+  assert(_poses.find(const_pointer_cast<Pose3d>(d.pose)) != _poses.end());
+  assert(!_nodes.empty());
+
+  // the support comes from the leaf sphere extending farthest along d
+  Vector3d dn = Vector3d::normalize(d);
+  double best_v = -std::numeric_limits<double>::max();
+  Point3d best_p(0.0, 0.0, 0.0, d.pose);
+  for (unsigned i=0; i< _nodes.size(); i++)
+  {
+    if (_nodes[i].kids[0] != std::numeric_limits<unsigned>::max())
+      continue;
+    Point3d c(_nodes[i].center, d.pose);
+    double v = c.dot(dn) + _nodes[i].radius;
+    if (v > best_v)
+    {
+      best_v = v;
+      best_p = c + dn*_nodes[i].radius;
+    }
+  }
+
+  return best_p;
+}
+
+/// Gets the vertices of the sphere tree (the leaf spheres' axis extremes)
+void SphereTreePrimitive::get_vertices(shared_ptr<const Pose3d> P, std::vector<Point3d>& vertices) const
+{
+  vertices.clear();
+  for (unsigned i=0; i< _nodes.size(); i++)
+  {
+    if (_nodes[i].kids[0] != std::numeric_limits<unsigned>::max())
+      continue;
+    const Origin3d& c = _nodes[i].center;
+    const double r = _nodes[i].radius;
+    vertices.push_back(Point3d(c[0]+r, c[1], c[2], P));
+    vertices.push_back(Point3d(c[0]-r, c[1], c[2], P));
+    vertices.push_back(Point3d(c[0], c[1]+r, c[2], P));
+    vertices.push_back(Point3d(c[0], c[1]-r, c[2], P));
+    vertices.push_back(Point3d(c[0], c[1], c[2]+r, P));
+    vertices.push_back(Point3d(c[0], c[1], c[2]-r, P));
+  }
+}
+
+/// Creates the visualization for this primitive
+osg::Node* SphereTreePrimitive::create_visualization()
+{
+  // the spheres are collision-only; draw the true shape
+  if (_source)
+    return _source->create_visualization();
+  #ifdef USE_OSG
+  return new osg::Group;
+  #else
+  return NULL;
+  #endif
+}
+
+/// Gets the source primitive's mesh (if a source is set)
+shared_ptr<const IndexedTriArray> SphereTreePrimitive::get_mesh(shared_ptr<const Pose3d> P)
+{
+  return (_source) ? _source->get_mesh(P) : shared_ptr<const IndexedTriArray>();
+}
+
+/// Computes mass properties (taken from the source primitive)
+void SphereTreePrimitive::calc_mass_properties()
+{
+  if (defer_calc_mass_properties())
+    return;
+
+  // the approximation changes collision geometry only
+  if (_source)
+    _J = _source->get_inertia();
+  else
+    _J.set_zero();
+}
+
+/// Gets the radius of the bounding sphere centered at the primitive frame origin
+double SphereTreePrimitive::get_bounding_radius() const
+{
+  return (_nodes.empty()) ? 0.0 : _nodes.front().center.norm() + _nodes.front().radius;
+}
+
+/// Gets the root bounding volume for this primitive
+BVPtr SphereTreePrimitive::get_BVH_root(CollisionGeometryPtr geom)
+{
+  // get the pointer to the bounding sphere
+  shared_ptr<BoundingSphere>& bsph = _bsphs[geom];
+
+  // if the bounding sphere hasn't been created, create it and initialize it
+  if (!bsph)
+  {
+    // create the sphere
+    bsph = shared_ptr<BoundingSphere>(new BoundingSphere);
+    bsph->geom = geom;
+
+    // get the pose for the geometry
+    shared_ptr<const Pose3d> P = get_pose(geom);
+
+    // the tree's root sphere bounds every leaf
+    if (!_nodes.empty())
+    {
+      bsph->center = Point3d(_nodes.front().center, P);
+      bsph->radius = _nodes.front().radius;
+    }
+    else
+    {
+      bsph->center = Point3d(0.0, 0.0, 0.0, P);
+      bsph->radius = 0.0;
+    }
+  }
+
+  return bsph;
+}
+
+/// Gets the bytes of heap memory used by the sphere tree
+unsigned long SphereTreePrimitive::calc_memory_usage() const
+{
+  unsigned long bytes = _nodes.capacity()*sizeof(SphereNode);
+  bytes += _bsphs.size()*(sizeof(pair<CollisionGeometryPtr, shared_ptr<BoundingSphere> >) + sizeof(BoundingSphere));
+  return bytes;
+}
+
+/// Implements Base::load_from_xml() for serialization
+void SphereTreePrimitive::load_from_xml(shared_ptr<const XMLTree> node, map<std::string, BasePtr>& id_map)
+{
+  // verify that the node type is SphereTree
+  assert(strcasecmp(node->name.c_str(), "SphereTree") == 0);
+
+  // load the parent data
+  Primitive::load_from_xml(node, id_map);
+
+  // read the builder parameters, if specified
+  XMLAttrib* max_attr = node->get_attrib("max-spheres");
+  if (max_attr)
+    _max_spheres = max_attr->get_unsigned_value();
+  XMLAttrib* samples_attr = node->get_attrib("samples");
+  if (samples_attr)
+    _nsamples = samples_attr->get_unsigned_value();
+
+  // read and set the source primitive (primitive tags are processed before
+  // SphereTree tags, so the source has already been read)
+  XMLAttrib* source_attr = node->get_attrib("primitive-id");
+  if (!source_attr)
+  {
+    std::cerr << "SphereTreePrimitive::load_from_xml() - no primitive-id attribute!" << std::endl;
+    return;
+  }
+  const std::string& source_id = source_attr->get_string_value();
+  std::map<std::string, BasePtr>::const_iterator source_iter = id_map.find(source_id);
+  if (source_iter == id_map.end())
+  {
+    std::cerr << "SphereTreePrimitive::load_from_xml() - source primitive with ID '";
+    std::cerr << source_id << "'" << std::endl << "  not found in offending node: ";
+    std::cerr << std::endl << *node;
+    return;
+  }
+  set_source(dynamic_pointer_cast<Primitive>(source_iter->second));
+}
+
+/// Implements Base::save_to_xml() for serialization
+void SphereTreePrimitive::save_to_xml(XMLTreePtr node, std::list<shared_ptr<const Base> >& shared_objects) const
+{
+  // save the parent data
+  Primitive::save_to_xml(node, shared_objects);
+
+  // (re)set the node name
+  node->name = "SphereTree";
+
+  // save the builder parameters
+  node->attribs.insert(XMLAttrib("max-spheres", _max_spheres));
+  node->attribs.insert(XMLAttrib("samples", _nsamples));
+
+  // save the source primitive
+  if (_source)
+  {
+    node->attribs.insert(XMLAttrib("primitive-id", _source->id));
+    shared_objects.push_back(_source);
+  }
+}
@@ -0,0 +1,168 @@
+/****************************************************************************
+ * Copyright 2015 Evan Drumwright
+ * This library is distributed under the terms of the Apache V2.0
+ * License (obtainable from http://www.apache.org/licenses/LICENSE-2.0).
+ ****************************************************************************/
+
+#include <sys/time.h>
+#include <iomanip>
+#include <algorithm>
+#include <Moby/StepProfiler.h>
+
+using namespace Moby;
+
+/// Constructs a disabled profiler with a 100-step window
+StepProfiler::StepProfiler()
+{
+  enabled = false;
+  _window_size = 100;
+  reset();
+}
+
+/// Gets the current wall-clock time in seconds
+double StepProfiler::now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double) tv.tv_sec + (double) tv.tv_usec * 1e-6;
+}
+
+/// Clears all accumulated statistics
+void StepProfiler::reset()
+{
+  for (unsigned i=0; i< N_PHASES; i++)
+  {
+    _last[i] = 0.0;
+    _total[i] = 0.0;
+    _max[i] = 0.0;
+    _window[i].clear();
+  }
+  _steps = 0;
+}
+
+/// Sets the number of recent steps over which windowed statistics are kept
+void StepProfiler::set_window_size(unsigned n)
+{
+  _window_size = std::max(n, 1u);
+  for (unsigned i=0; i< N_PHASES; i++)
+    while (_window[i].size() > _window_size)
+      _window[i].pop_front();
+}
+
+/// Gets the human-readable name of a phase
+const char* StepProfiler::phase_name(Phase p)
+{
+  switch (p)
+  {
+    case eBroadPhase:      return "broad phase";
+    case eNarrowPhase:     return "narrow phase";
+    case eForwardDynamics: return "forward dynamics";
+    case eImpactHandling:  return "impact handling";
+    case eStabilization:   return "stabilization";
+    case eIntegration:     return "integration";
+    default:               return "unknown";
+  }
+}
+
+/// Begins accumulating phase times for a new step
+void StepProfiler::start_step()
+{
+  if (!enabled)
+    return;
+
+  for (unsigned i=0; i< N_PHASES; i++)
+    _last[i] = 0.0;
+}
+
+/// Folds the phase times of the completed step into the statistics
+void StepProfiler::end_step()
+{
+  if (!enabled)
+    return;
+
+  for (unsigned i=0; i< N_PHASES; i++)
+  {
+    _total[i] += _last[i];
+    _max[i] = std::max(_max[i], _last[i]);
+    _window[i].push_back(_last[i]);
+    while (_window[i].size() > _window_size)
+      _window[i].pop_front();
+  }
+  _steps++;
+}
+
+/// Charges elapsed time to a phase of the step in progress
+void StepProfiler::add(Phase p, double elapsed)
+{
+  _last[p] += elapsed;
+}
+
+/// Gets the time spent in a phase during the last step
+double StepProfiler::get_last(Phase p) const
+{
+  return _last[p];
+}
+
+/// Gets the lifetime accumulated time spent in a phase
+double StepProfiler::get_total(Phase p) const
+{
+  return _total[p];
+}
+
+/// Gets the largest per-step time observed for a phase
+double StepProfiler::get_max(Phase p) const
+{
+  return _max[p];
+}
+
+/// Gets the mean per-step time of a phase over the window
+double StepProfiler::get_window_mean(Phase p) const
+{
+  const std::deque<double>& w = _window[p];
+  if (w.empty())
+    return 0.0;
+
+  double sum = 0.0;
+  for (unsigned i=0; i< w.size(); i++)
+    sum += w[i];
+  return sum / w.size();
+}
+
+/// Gets the largest per-step time of a phase over the window
+double StepProfiler::get_window_max(Phase p) const
+{
+  const std::deque<double>& w = _window[p];
+  double mx = 0.0;
+  for (unsigned i=0; i< w.size(); i++)
+    mx = std::max(mx, w[i]);
+  return mx;
+}
+
+/// Writes the accumulated statistics in a human-readable table
+std::ostream& StepProfiler::dump(std::ostream& out) const
+{
+  out << "step profile over " << _steps << " steps (times in seconds):" << std::endl;
+  for (unsigned i=0; i< N_PHASES; i++)
+  {
+    Phase p = (Phase) i;
+    out << "  " << std::setw(18) << std::left << phase_name(p)
+        << " total: " << std::setw(12) << get_total(p)
+        << " max: " << std::setw(12) << get_max(p)
+        << " window mean: " << std::setw(12) << get_window_mean(p)
+        << " window max: " << get_window_max(p) << std::endl;
+  }
+  return out;
+}
+
+/// Starts timing a phase
+StepProfiler::ScopedTimer::ScopedTimer(StepProfiler& profiler, Phase p) : _profiler(profiler), _phase(p)
+{
+  _start = (profiler.enabled) ? now() : 0.0;
+}
+
+/// Stops timing and charges the elapsed time to the phase
+StepProfiler::ScopedTimer::~ScopedTimer()
+{
+  if (_profiler.enabled)
+    _profiler.add(_phase, now() - _start);
+}
@@ -64,6 +64,21 @@ void StokesDragForce::add_force(shared_ptr<DynamicBodyd> body)
   }
 }
 
+/// Adds drag to a batch of bodies in one pass
+/**
+ * The drag wrench depends only on the body it acts on, so the bodies can
+ * be processed in parallel: each application reads and writes only its
+ * own body.
+ */
+void StokesDragForce::add_force_batch(const std::vector<shared_ptr<DynamicBodyd> >& bodies)
+{
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(static)
+  #endif
+  for (int i=0; i< (int) bodies.size(); i++)
+    add_force(bodies[i]);
+}
+
 /// Implements Base::load_from_xml()
 void StokesDragForce::load_from_xml(shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map)
 {
@@ -5,6 +5,7 @@
 #include <set>
 #include <cmath>
 #include <numeric>
+#include <algorithm>
 
 #include <Ravelin/LinAlgd.h>
 #include <Ravelin/MatrixNd.h>
@@ -38,7 +39,15 @@ using boost::shared_ptr;
 using boost::dynamic_pointer_cast;
 
 /// Sets up the default parameters for the sustained unilateral handler
-SustainedUnilateralConstraintHandler::SustainedUnilateralConstraintHandler(){}
+SustainedUnilateralConstraintHandler::SustainedUnilateralConstraintHandler()
+{
+  active_set_vel_tol = 1e-2;
+  active_set_accel_tol = 1e-2;
+
+  // setup the contact force history (a simulator may later point this at a
+  // history shared with the impact handler)
+  contact_force_history = boost::shared_ptr<ContactForceHistory>(new ContactForceHistory);
+}
 
 // Processes sustained unilateral constraints
 void SustainedUnilateralConstraintHandler::process_constraints(const vector<UnilateralConstraint>& constraints)
@@ -104,13 +113,129 @@ void SustainedUnilateralConstraintHandler::apply_model(const vector<UnilateralCo
   }
 }
 
+/// Predicts the active constraint set for a group of connected constraints
+/**
+ * Contacts that are separating (or accelerating apart) faster than the
+ * active-set tolerances almost never generate force this step, so the
+ * acceleration-level problem can be constructed over the remainder alone.
+ * Limit constraints are always kept: they are few and contribute little to
+ * the problem dimension.
+ */
+void SustainedUnilateralConstraintHandler::predict_active_set(const list<UnilateralConstraint*>& constraints, list<UnilateralConstraint*>& predicted, list<UnilateralConstraint*>& excluded) const
+{
+  BOOST_FOREACH(UnilateralConstraint* e, constraints)
+  {
+    // only contacts are candidates for exclusion
+    if (e->constraint_type == UnilateralConstraint::eContact)
+    {
+      // get the normal relative velocity and acceleration of the contact
+      double vn = e->calc_contact_vel(e->contact_normal);
+      double an = e->calc_contact_accel(e->contact_normal, e->contact_normal_dot);
+
+      // exclude the contact if it is separating, or if it is not approaching
+      // and is accelerating apart
+      if (vn > active_set_vel_tol ||
+          (vn > -active_set_vel_tol && an > active_set_accel_tol))
+      {
+        excluded.push_back(e);
+        continue;
+      }
+    }
+
+    predicted.push_back(e);
+  }
+}
+
+/// Removes the generalized forces recorded since the last clear of _applied_gj
+void SustainedUnilateralConstraintHandler::undo_applied_forces()
+{
+  for (map<ControlledBodyPtr, VectorNd>::iterator i = _applied_gj.begin(); i != _applied_gj.end(); i++)
+  {
+    // remove the force and restore the body's dynamics
+    i->second.negate();
+    i->first->add_generalized_force(i->second);
+    i->first->calc_fwd_dyn();
+  }
+
+  _applied_gj.clear();
+}
+
 /// Applies the Coulomb / viscous model to a set of connected constraints
 /**
+ * Constructs and solves the acceleration-level problem over the predicted
+ * active set, then verifies that the contacts excluded by the prediction do
+ * not accelerate into violation under the computed forces; the full problem
+ * is only constructed and solved when the verification (or the reduced
+ * solve itself) fails.
+ *
  * \param constraints a set of connected constraints
  */
 void SustainedUnilateralConstraintHandler::apply_model_to_connected_constraints(const list<UnilateralConstraint*>& constraints)
 {
-  FILE_LOG(LOG_CONSTRAINT) << "SustainedUnilateralConstraintHandler::apply_model_to_connected_constraints() entered" << endl;
+  // predict the active constraint set
+  list<UnilateralConstraint*> predicted, excluded;
+  predict_active_set(constraints, predicted, excluded);
+
+  // solve the full problem directly if the prediction excluded nothing
+  if (excluded.empty())
+  {
+    solve_connected_constraints(constraints);
+    return;
+  }
+
+  FILE_LOG(LOG_CONSTRAINT) << "active-set prediction excluded " << excluded.size() << " of " << constraints.size() << " constraints" << endl;
+
+  // excluded contacts receive no force this step (unless we fall back)
+  BOOST_FOREACH(UnilateralConstraint* e, excluded)
+    e->contact_impulse.set_zero(GLOBAL);
+
+  // begin recording applied forces in case the prediction must be undone
+  _applied_gj.clear();
+
+  // attempt to solve the reduced problem
+  bool reduced_ok = true;
+  if (!predicted.empty())
+  {
+    try
+    {
+      solve_connected_constraints(predicted);
+    }
+    catch (SustainedUnilateralConstraintSolveFailException e)
+    {
+      reduced_ok = false;
+    }
+  }
+
+  // verify that the excluded contacts do not accelerate into violation
+  // (solve_connected_constraints() leaves the dynamics recomputed under the
+  // applied forces)
+  if (reduced_ok)
+    BOOST_FOREACH(UnilateralConstraint* e, excluded)
+      if (e->calc_contact_accel(e->contact_normal, e->contact_normal_dot) < -NEAR_ZERO)
+      {
+        FILE_LOG(LOG_CONSTRAINT) << "excluded contact accelerates into violation; prediction rejected" << endl;
+        reduced_ok = false;
+        break;
+      }
+
+  // the reduced solution stands
+  if (reduced_ok)
+    return;
+
+  // prediction failed: remove any forces applied by the reduced solve and
+  // solve the full problem
+  FILE_LOG(LOG_CONSTRAINT) << "active-set prediction violated; solving the full problem" << endl;
+  undo_applied_forces();
+  solve_connected_constraints(constraints);
+}
+
+/// Solves the Coulomb / viscous model problem for a set of connected constraints
+/**
+ * \param constraints a set of connected constraints
+ */
+void SustainedUnilateralConstraintHandler::solve_connected_constraints(const list<UnilateralConstraint*>& constraints)
+{
+  FILE_LOG(LOG_CONSTRAINT) << "SustainedUnilateralConstraintHandler::solve_connected_constraints() entered" << endl;
 
   // reset problem data
   _epd.reset();
@@ -213,9 +338,9 @@ void SustainedUnilateralConstraintHandler::apply_model_to_connected_constraints(
   FILE_LOG(LOG_CONSTRAINT) << "Cn * a: " << _epd.Cn_a << std::endl;
   FILE_LOG(LOG_CONSTRAINT) << "Cs * a: " << _epd.Cs_a << std::endl;
   FILE_LOG(LOG_CONSTRAINT) << "Ct * a: " << _epd.Ct_a << std::endl;
-  FILE_LOG(LOG_CONSTRAINT) << "L * a: "  << _epd.L_a << std::endl; 
+  FILE_LOG(LOG_CONSTRAINT) << "L * a: "  << _epd.L_a << std::endl;
 
-  FILE_LOG(LOG_CONSTRAINT) << "SustainedUnilateralConstraintHandler::apply_model_to_connected_constraints() exiting" << endl;
+  FILE_LOG(LOG_CONSTRAINT) << "SustainedUnilateralConstraintHandler::solve_connected_constraints() exiting" << endl;
 }
 
 /// Applies the purely viscous model to a set of connected constraints
@@ -400,6 +525,12 @@ void SustainedUnilateralConstraintHandler::apply_forces(const SustainedUnilatera
   {
     // apply the force
     i->first->add_generalized_force(i->second);
+
+    // record the applied force so that an active-set fallback can remove it
+    if ((gj_iter = _applied_gj.find(i->first)) == _applied_gj.end())
+      _applied_gj[i->first] = i->second;
+    else
+      gj_iter->second += i->second;
   }
 }
 
@@ -1212,8 +1343,41 @@ bool SustainedUnilateralConstraintHandler::solve_coulomb_lcp(SustainedUnilateral
   FILE_LOG(LOG_CONSTRAINT) << " LCP matrix: " << std::endl << _MM;
   FILE_LOG(LOG_CONSTRAINT) << " LCP vector: " << _qq << std::endl;
 
-  // solve the LCP
-  if (!_lcp.lcp_lemke_regularized(_MM, _qq, z, -20, 1, -8))
+  // solve the LCP, first attempting the pivoting solver seeded from the
+  // shared per-contact force history; persistent contacts that alternate
+  // between this handler and the impact handler then start from the last
+  // solved active set instead of from scratch
+  bool solved = false;
+  if (contact_force_history)
+  {
+    z.set_zero(_qq.size());
+    bool seeded = false;
+    for (unsigned i=0, j=0; i< q.N_CONTACTS; i++)
+    {
+      const UnilateralConstraint* ci = q.contact_constraints[i];
+      ContactForceHistory::Record rec;
+      bool found = contact_force_history->lookup(ci->contact_geom1, ci->contact_geom2, rec);
+      if (found)
+      {
+        z[i] = rec.cn;
+        seeded = true;
+      }
+      if (ci->get_friction_type() == UnilateralConstraint::eSticking)
+      {
+        if (found)
+        {
+          z[q.N_CONTACTS+j] = std::max(rec.cs, 0.0);
+          z[q.N_CONTACTS+q.N_STICKING+j] = std::max(-rec.cs, 0.0);
+          z[q.N_CONTACTS+q.N_STICKING*2+j] = std::max(rec.ct, 0.0);
+          z[q.N_CONTACTS+q.N_STICKING*3+j] = std::max(-rec.ct, 0.0);
+        }
+        j++;
+      }
+    }
+    if (seeded)
+      solved = _lcp.lcp_fast(_MM, _qq, z);
+  }
+  if (!solved && !_lcp.lcp_lemke_regularized(_MM, _qq, z, -20, 1, -8))
     return false;
 
   for(unsigned i=0,j=0;i<q.N_CONTACTS;i++)
@@ -1235,6 +1399,12 @@ bool SustainedUnilateralConstraintHandler::solve_coulomb_lcp(SustainedUnilateral
 
   q.l = z.segment(N_FRICT,N_FRICT+N_LIMIT);
 
+  // record the solved contact forces in the shared history so that later
+  // solves (by this handler or the impact handler) start warm
+  if (contact_force_history)
+    for (unsigned i=0; i< q.N_CONTACTS; i++)
+      contact_force_history->update(q.contact_constraints[i]->contact_geom1, q.contact_constraints[i]->contact_geom2, q.cn[i], q.cs[i], q.ct[i]);
+
   // setup a temporary frame
   shared_ptr<Pose3d> P(new Pose3d);
 
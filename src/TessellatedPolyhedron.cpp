@@ -209,7 +209,7 @@ void TessellatedPolyhedron::to_polyhedron(Polyhedron& p) const
   std::vector<shared_ptr<Polyhedron::Vertex> > vertices(_mesh.get_vertices().size());
   for (unsigned i=0; i< vertices.size(); i++)
   {
-    vertices[i] = shared_ptr<Polyhedron::Vertex>(new Polyhedron::Vertex);
+    vertices[i] = Polyhedron::create_feature<Polyhedron::Vertex>();
     vertices[i]->o = _mesh.get_vertices()[i];
   }
 
@@ -274,7 +274,7 @@ void TessellatedPolyhedron::to_polyhedron(Polyhedron& p) const
     }
 
     // create a single face
-    faces.push_back(shared_ptr<Polyhedron::Face>(new Polyhedron::Face));
+    faces.push_back(Polyhedron::create_feature<Polyhedron::Face>());
 
     // setup the set of edges in the face
     std::map<std::pair<unsigned, unsigned>, unsigned> edge_set;
@@ -312,7 +312,7 @@ void TessellatedPolyhedron::to_polyhedron(Polyhedron& p) const
       std::map<std::pair<unsigned, unsigned>, shared_ptr<Polyhedron::Edge> >::const_iterator em_iter;
       if ((em_iter = edge_map.find(iter->first)) == edge_map.end())
       {
-        shared_ptr<Polyhedron::Edge> e(new Polyhedron::Edge);
+        shared_ptr<Polyhedron::Edge> e = Polyhedron::create_feature<Polyhedron::Edge>();
         edges.push_back(e);
         edge_map[iter->first] = e;
 
@@ -467,6 +467,9 @@ void TessellatedPolyhedron::to_polyhedron(Polyhedron& p) const
   p._bb_max = _bb_max;
   p._convexity = _convexity;
   p._convexity_computed = _convexity_computed;
+
+  // the topology was rebuilt, so any packed derived data is stale
+  p.invalidate_derived_data();
 }
 
 /// Computes the Minkowski sum of two convex polyhedra
@@ -734,6 +737,29 @@ void TessellatedPolyhedron::transform(const Transform3d& T)
   calc_bounding_box();
 }
 
+/// Updates the vertex positions of this polyhedron in place
+/**
+ * Recomputes only position-dependent quantities in a single linear pass,
+ * reusing the mesh topology: the underlying mesh's vertex array and coplanar
+ * feature sets and the bounding box are refreshed, and the cached convexity
+ * is marked stale (it- like the face planes and volume integrals- is
+ * computed on demand). The number of positions must match the number of
+ * vertices in the mesh.
+ * \note intended for morphing geometry whose connectivity is fixed
+ */
+void TessellatedPolyhedron::update_vertices(const std::vector<Origin3d>& positions)
+{
+  // update the mesh, reusing its topology
+  shared_ptr<vector<Origin3d> > new_vertices(new vector<Origin3d>(positions));
+  _mesh.update_vertices(new_vertices);
+
+  // recompute the bounding box
+  calc_bounding_box();
+
+  // convexity depends on vertex positions; recompute it lazily
+  _convexity_computed = false;
+}
+
 /// Calculates the bounding box
 void TessellatedPolyhedron::calc_bounding_box()
 {
@@ -18,6 +18,7 @@
 #include <Moby/SustainedUnilateralConstraintSolveFailException.h>
 #include <Moby/InvalidStateException.h>
 #include <Moby/InvalidVelocityException.h>
+#include <Moby/SimulationStage.h>
 #include <Moby/TimeSteppingSimulator.h>
 
 #ifdef USE_OSG
@@ -46,6 +47,142 @@ using namespace Moby;
 TimeSteppingSimulator::TimeSteppingSimulator()
 {
   min_step_size = NEAR_ZERO;
+  optimistic_stepping = false;
+  two_level_stepping = false;
+  speculative_contacts = false;
+  rt_step_budget = 0.0;
+  rt_pgs_max_iterations = 10;
+  rt_degraded = false;
+  _rt_deadline = 0.0;
+  _rt_saved_pgs_max = 0;
+}
+
+/// Degrades constraint handling once the step exceeds its wall-clock budget
+/**
+ * Called at the start of every mini-step.  The first mini-step beginning
+ * past the deadline clamps the PGS sweep cap to rt_pgs_max_iterations and
+ * forces the viscous friction model on all impact islands for the rest of
+ * the step; step() restores the handler settings when it completes.
+ */
+void TimeSteppingSimulator::check_rt_budget()
+{
+  if (rt_step_budget <= 0.0 || rt_degraded)
+    return;
+  if (StepProfiler::now() < _rt_deadline)
+    return;
+
+  // over budget: cap solver iterations and fall back to the cheap model
+  rt_degraded = true;
+  _rt_saved_pgs_max = _impact_constraint_handler.pgs_max_iterations;
+  _impact_constraint_handler.pgs_max_iterations = std::min(_impact_constraint_handler.pgs_max_iterations, rt_pgs_max_iterations);
+  _impact_constraint_handler.force_visc_friction_model = true;
+  FILE_LOG(LOG_SIMULATOR) << "TimeSteppingSimulator: over real-time budget; degrading constraint handling" << std::endl;
+}
+
+/// Determines whether any joint limit of an articulated body is reachable within dt at current joint velocities
+static bool joint_limit_reachable(ArticulatedBodyPtr ab, double dt)
+{
+  const vector<shared_ptr<Jointd> >& joints = ab->get_joints();
+  for (unsigned i=0; i< joints.size(); i++)
+  {
+    JointPtr joint = dynamic_pointer_cast<Joint>(joints[i]);
+    for (unsigned j=0; j< joint->num_dof(); j++)
+    {
+      if (joint->qd[j] > 0.0 && joint->q[j] + joint->qd[j]*dt >= joint->hilimit[j])
+        return true;
+      if (joint->qd[j] < 0.0 && joint->q[j] + joint->qd[j]*dt <= joint->lolimit[j])
+        return true;
+    }
+  }
+
+  return false;
+}
+
+/// Populates the pipeline with the built-in time stepping phases
+/**
+ * The built-in stages run strictly in order (each one's read set overlaps
+ * the previous one's write set); the declared-dependency machinery pays off
+ * for user stages, which run concurrently with any built-in stage they do
+ * not conflict with.  The Euler step, the post-step callback, and
+ * stabilization declare the wildcard field, since they may touch (or
+ * observe) any simulation state.
+ */
+void TimeSteppingSimulator::build_default_pipeline()
+{
+  // broad phase collision detection (must be done before any Euler steps)
+  shared_ptr<MemberFnStage<TimeSteppingSimulator> > bp(new MemberFnStage<TimeSteppingSimulator>("broad-phase", this, &TimeSteppingSimulator::run_broad_phase_stage));
+  bp->reads.insert("pose");
+  bp->writes.insert("contact-candidates");
+  pipeline.push_back(bp);
+
+  // pairwise distances at the current configuration
+  shared_ptr<MemberFnStage<TimeSteppingSimulator> > np(new MemberFnStage<TimeSteppingSimulator>("narrow-phase", this, &TimeSteppingSimulator::run_narrow_phase_stage));
+  np->reads.insert("pose");
+  np->reads.insert("contact-candidates");
+  np->writes.insert("distances");
+  pipeline.push_back(np);
+
+  // the semi-implicit Euler step (integration, impacts, mini-stepping)
+  shared_ptr<MemberFnStage<TimeSteppingSimulator> > euler(new MemberFnStage<TimeSteppingSimulator>("euler-step", this, &TimeSteppingSimulator::run_euler_stage));
+  euler->reads.insert("*");
+  euler->writes.insert("*");
+  pipeline.push_back(euler);
+
+  // the user post-step callback (may observe or modify anything)
+  shared_ptr<MemberFnStage<TimeSteppingSimulator> > cb(new MemberFnStage<TimeSteppingSimulator>("post-step-callback", this, &TimeSteppingSimulator::run_callback_stage));
+  cb->reads.insert("*");
+  cb->writes.insert("*");
+  pipeline.push_back(cb);
+
+  // constraint stabilization
+  shared_ptr<MemberFnStage<TimeSteppingSimulator> > stab(new MemberFnStage<TimeSteppingSimulator>("stabilization", this, &TimeSteppingSimulator::run_stabilization_stage));
+  stab->reads.insert("*");
+  stab->writes.insert("*");
+  pipeline.push_back(stab);
+}
+
+/// Runs broad phase collision detection as a pipeline stage
+void TimeSteppingSimulator::run_broad_phase_stage(double dt)
+{
+  StepProfiler::ScopedTimer timer(profiler, StepProfiler::eBroadPhase);
+  broad_phase(dt);
+}
+
+/// Computes pairwise distances as a pipeline stage
+void TimeSteppingSimulator::run_narrow_phase_stage(double dt)
+{
+  StepProfiler::ScopedTimer timer(profiler, StepProfiler::eNarrowPhase);
+  calc_pairwise_distances();
+}
+
+/// Runs the semi-implicit Euler step as a pipeline stage
+void TimeSteppingSimulator::run_euler_stage(double dt)
+{
+  step_si_Euler(dt);
+}
+
+/// Invokes the user post-step callback as a pipeline stage
+void TimeSteppingSimulator::run_callback_stage(double dt)
+{
+  if (post_step_callback_fn)
+    post_step_callback_fn(this);
+}
+
+/// Runs constraint stabilization as a pipeline stage
+void TimeSteppingSimulator::run_stabilization_stage(double dt)
+{
+  // the last mini-step may have left a broad-phase job outstanding; wait for
+  // it and discard the result, since stabilization is about to move bodies
+  cancel_broad_phase_async();
+
+  // do constraint stabilization
+  shared_ptr<ConstraintSimulator> simulator = dynamic_pointer_cast<ConstraintSimulator>(shared_from_this());
+  FILE_LOG(LOG_SIMULATOR) << "stabilization started" << std::endl;
+  {
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eStabilization);
+    cstab.stabilize(simulator);
+  }
+  FILE_LOG(LOG_SIMULATOR) << "stabilization done" << std::endl;
 }
 
 /// Steps the simulator forward by the given step size
@@ -61,6 +198,10 @@ double TimeSteppingSimulator::step(double step_size)
   _transient_vdata->removeChildren(0, _transient_vdata->getNumChildren());
   #endif
 
+  // fast-forward over the step if the scene is quiescent
+  if (try_fast_forward(step_size))
+    return step_size;
+
   // clear stored derivatives
   _current_dx.resize(0);
 
@@ -78,24 +219,25 @@ double TimeSteppingSimulator::step(double step_size)
     }
   }
 
-  // do broad phase collision detection (must be done before any Euler steps)
-  broad_phase(step_size);
+  // build the built-in stage pipeline on first use
+  if (pipeline.empty())
+    build_default_pipeline();
 
-  // compute pairwise distances at the current configuration
-  calc_pairwise_distances();
+  // begin accumulating phase timings for this step
+  profiler.start_step();
 
-  // do the Euler step
-  step_si_Euler(step_size);
+  // arm the real-time budget for this step
+  rt_degraded = false;
+  if (rt_step_budget > 0.0)
+    _rt_deadline = StepProfiler::now() + rt_step_budget;
 
-  // call the callback
-  if (post_step_callback_fn)
-    post_step_callback_fn(this);
+  // run the stage pipeline: broad phase, narrow phase, the semi-implicit
+  // Euler step, the post-step callback, and stabilization, plus any
+  // user-inserted stages
+  run_pipeline(step_size);
 
-  // do constraint stabilization
-  shared_ptr<ConstraintSimulator> simulator = dynamic_pointer_cast<ConstraintSimulator>(shared_from_this());
-  FILE_LOG(LOG_SIMULATOR) << "stabilization started" << std::endl;
-  cstab.stabilize(simulator);
-  FILE_LOG(LOG_SIMULATOR) << "stabilization done" << std::endl;
+  // fold the phase timings into the profiler statistics
+  profiler.end_step();
 
   // write out constraint violation
   #ifndef NDEBUG
@@ -107,6 +249,19 @@ double TimeSteppingSimulator::step(double step_size)
   cvio.close();
   #endif
 
+  // restore constraint handling settings changed by budget degradation
+  if (rt_degraded)
+  {
+    _impact_constraint_handler.pgs_max_iterations = _rt_saved_pgs_max;
+    _impact_constraint_handler.force_visc_friction_model = false;
+  }
+
+  // release transient memory if over the memory budget
+  enforce_memory_budget();
+
+  // publish the post-step state to the co-simulation peer, if any
+  publish_shm_cosim();
+
   return step_size;
 }
 
@@ -114,6 +269,9 @@ double TimeSteppingSimulator::step(double step_size)
 double TimeSteppingSimulator::do_mini_step(double dt)
 {
   VectorNd q, qd, qdd;
+
+  // degrade constraint handling if the step is over its wall-clock budget
+  check_rt_budget();
   std::vector<VectorNd> qsave;
 
   // init qsave to proper size
@@ -129,17 +287,34 @@ double TimeSteppingSimulator::do_mini_step(double dt)
   // set the amount stepped
   double h = 0.0;
 
+  // a broad phase prefetched during the previous mini-step's impact handling
+  // can stand in for the first broad phase of this one
+  bool bp_prefetched = async_broad_phase && finish_broad_phase_async();
+
   // integrate positions until a new event is detected
   while (h < dt)
   {
-    // do broad phase collision detection
-    broad_phase(dt-h);
+    // do broad phase collision detection (unless a prefetched result covers
+    // this iteration)
+    if (!bp_prefetched)
+    {
+      StepProfiler::ScopedTimer timer(profiler, StepProfiler::eBroadPhase);
+      broad_phase(dt-h);
+    }
+    bp_prefetched = false;
 
     // compute pairwise distances
-    calc_pairwise_distances();
-
-    // get the conservative step 
-    double CA_step = calc_next_CA_Euler_step(contact_dist_thresh);
+    double CA_step;
+    {
+      StepProfiler::ScopedTimer timer(profiler, StepProfiler::eNarrowPhase);
+      calc_pairwise_distances();
+
+      // get the conservative step; with speculative contacts the previous
+      // constraint solve clamped every pair's approach speed to its gap/dt,
+      // so the full remaining interval is safe
+      CA_step = (speculative_contacts) ? dt-h :
+                calc_next_CA_Euler_step(contact_dist_thresh);
+    }
 
     // look for impact
     if (CA_step <= 0.0)
@@ -150,17 +325,23 @@ double TimeSteppingSimulator::do_mini_step(double dt)
     FILE_LOG(LOG_SIMULATOR) << "Conservative advancement step: " << tc << std::endl;
 
     // don't take too large a step
-    tc = std::min(dt-h, tc); 
+    tc = std::min(dt-h, tc);
 
     // integrate the bodies' positions by h + conservative advancement step
-    for (unsigned i=0; i< _bodies.size(); i++)
     {
-      shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
-      db->set_generalized_coordinates_euler(qsave[i]);
-      db->get_generalized_velocity(DynamicBodyd::eEuler, q);
-      q *= (h + tc);
-      q += qsave[i];
-      db->set_generalized_coordinates_euler(q);
+      StepProfiler::ScopedTimer timer(profiler, StepProfiler::eIntegration);
+      for (unsigned i=0; i< _bodies.size(); i++)
+      {
+        shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+        if (sleeping_enabled && body_is_asleep(db))
+          continue;
+        db->set_generalized_coordinates_euler(qsave[i]);
+        db->get_generalized_velocity(DynamicBodyd::eEuler, q);
+        q *= (h + tc);
+        q += qsave[i];
+        db->set_generalized_coordinates_euler(q);
+      }
+      invalidate_joint_step_data();
     }
 
     // update h
@@ -169,47 +350,290 @@ double TimeSteppingSimulator::do_mini_step(double dt)
 
   FILE_LOG(LOG_SIMULATOR) << "Position integration ended w/h = " << h << std::endl;
 
-  // prepare to calculate forward dynamics
-  precalc_fwd_dyn();
+  {
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eForwardDynamics);
 
-  // apply compliant unilateral constraint forces
-  calc_compliant_unilateral_constraint_forces();
+    // prepare to calculate forward dynamics
+    precalc_fwd_dyn();
 
-  // compute forward dynamics
-  calc_fwd_dyn(h);
+    // apply compliant unilateral constraint forces
+    calc_compliant_unilateral_constraint_forces();
+
+    // compute forward dynamics
+    calc_fwd_dyn(h);
+  }
 
   // integrate the bodies' velocities forward by h
-  for (unsigned i=0; i< _bodies.size(); i++)
   {
-    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
-    db->get_generalized_acceleration(qdd);
-    qdd *= h;
-    db->get_generalized_velocity(DynamicBodyd::eSpatial, qd);
-    FILE_LOG(LOG_DYNAMICS) << "old velocity: " << qd << std::endl; 
-    qd += qdd;
-    db->set_generalized_velocity(DynamicBodyd::eSpatial, qd);
-    FILE_LOG(LOG_DYNAMICS) << "new velocity: " << qd << std::endl; 
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eIntegration);
+    for (unsigned i=0; i< _bodies.size(); i++)
+    {
+      shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+      if (sleeping_enabled && body_is_asleep(db))
+        continue;
+      db->get_generalized_acceleration(qdd);
+      qdd *= h;
+      db->get_generalized_velocity(DynamicBodyd::eSpatial, qd);
+      FILE_LOG(LOG_DYNAMICS) << "old velocity: " << qd << std::endl;
+      qd += qdd;
+      db->set_generalized_velocity(DynamicBodyd::eSpatial, qd);
+      FILE_LOG(LOG_DYNAMICS) << "new velocity: " << qd << std::endl;
+    }
+
+    // dissipate some energy
+    if (_dissipator)
+    {
+      vector<shared_ptr<DynamicBodyd> > bodies;
+      BOOST_FOREACH(ControlledBodyPtr cb, _bodies)
+        bodies.push_back(dynamic_pointer_cast<DynamicBodyd>(cb));
+      _dissipator->apply(bodies);
+    }
   }
 
-  // dissipate some energy
-  if (_dissipator)
+  FILE_LOG(LOG_SIMULATOR) << "Integrated velocity by " << h << std::endl;
+
+  // recompute pairwise distances and find unilateral constraints
   {
-    vector<shared_ptr<DynamicBodyd> > bodies;
-    BOOST_FOREACH(ControlledBodyPtr cb, _bodies)
-      bodies.push_back(dynamic_pointer_cast<DynamicBodyd>(cb));
-    _dissipator->apply(bodies);
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eNarrowPhase);
+    calc_pairwise_distances();
+    find_unilateral_constraints(contact_dist_thresh);
+
+    // add speculative contacts for pairs whose time of impact falls inside
+    // the next step, keeping full-size steps safe for thin geometry
+    if (speculative_contacts)
+      find_speculative_contacts(dt);
   }
 
-  FILE_LOG(LOG_SIMULATOR) << "Integrated velocity by " << h << std::endl;
+  // positions are final for the next mini-step, so its broad phase can run
+  // on the worker overlapped with impact handling (dt bounds the next step)
+  if (async_broad_phase)
+    start_broad_phase_async(dt);
 
-  // recompute pairwise distances
-  calc_pairwise_distances();
+  // handle any impacts
+  {
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eImpactHandling);
+    calc_impacting_unilateral_constraint_forces(-1.0);
+  }
 
-  // find unilateral constraints
-  find_unilateral_constraints(contact_dist_thresh);
+  // update per-body sleep states now that impacts have been resolved
+  if (sleeping_enabled)
+    update_sleep_states(h);
+
+  // freeze or promote far-field bodies relative to the regions of interest
+  if (roi_enabled)
+    update_roi_states();
+
+  // update the time
+  current_time += h;
+
+  // do a mini-step callback
+  if (post_mini_step_callback_fn)
+    post_mini_step_callback_fn((ConstraintSimulator*) this);
+
+  return h;
+}
+
+/// Does a full integration cycle using optimistic stepping with rollback
+/**
+ * Rather than subdividing the step using conservative advancement bounds --
+ * which are extremely pessimistic for fast-moving but non-colliding bodies --
+ * this version speculatively integrates positions by the full remaining step,
+ * checks the post-step pairwise distances, and rolls back to the saved
+ * coordinates and halves the step only when penetration appears or worsens.
+ * The conservative advancement bound is consulted only after the candidate
+ * step has been halved down to min_step_size.
+ */
+double TimeSteppingSimulator::do_mini_step_optimistic(double dt)
+{
+  VectorNd q, q0, qd, qdd;
+
+  // degrade constraint handling if the step is over its wall-clock budget
+  check_rt_budget();
+
+  // snapshot the pre-step state of all awake bodies for rollback
+  push_state_snapshot();
+
+  // do broad phase collision detection over the full candidate step so the
+  // swept bounding volumes cover every speculative configuration
+  {
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eBroadPhase);
+    broad_phase(dt);
+  }
+
+  // compute pairwise distances at the pre-step configuration; the violation
+  // check and constraint determination only compare distances against the
+  // contact threshold, so queries may stop at a certified bound beyond it
+  {
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eNarrowPhase);
+    calc_pairwise_distances(contact_dist_thresh);
+  }
+
+  // save the pre-step distances for the rollback check
+  std::vector<PairwiseDistInfo> pre_step_distances = _pairwise_distances;
+
+  // speculatively step by the full remaining interval, halving on violation
+  double h = dt;
+  while (true)
+  {
+    // integrate the bodies' positions by h from the snapshotted coordinates
+    {
+      StepProfiler::ScopedTimer timer(profiler, StepProfiler::eIntegration);
+      restore_state_snapshot();
+      for (unsigned i=0; i< _bodies.size(); i++)
+      {
+        shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+        if (sleeping_enabled && body_is_asleep(db))
+          continue;
+        db->get_generalized_coordinates_euler(q0);
+        db->get_generalized_velocity(DynamicBodyd::eEuler, q);
+        q *= h;
+        q += q0;
+        db->set_generalized_coordinates_euler(q);
+      }
+      invalidate_joint_step_data();
+    }
+
+    // compute pairwise distances at the post-step configuration
+    {
+      StepProfiler::ScopedTimer timer(profiler, StepProfiler::eNarrowPhase);
+      calc_pairwise_distances(contact_dist_thresh);
+    }
+
+    // look for new or worsened penetration
+    bool violation = false;
+    for (unsigned i=0; i< _pairwise_distances.size(); i++)
+    {
+      const PairwiseDistInfo& pdi = _pairwise_distances[i];
+      if (pdi.dist < 0.0 && pdi.dist < pre_step_distances[i].dist - NEAR_ZERO)
+      {
+        // ignore the violation if one of the bodies is compliant
+        RigidBodyPtr rba = dynamic_pointer_cast<RigidBody>(pdi.a->get_single_body());
+        RigidBodyPtr rbb = dynamic_pointer_cast<RigidBody>(pdi.b->get_single_body());
+        if (rba->compliance == RigidBody::eCompliant ||
+            rbb->compliance == RigidBody::eCompliant)
+          continue;
+
+        FILE_LOG(LOG_SIMULATOR) << "Optimistic step of " << h << " violated; signed distance between " << rba->id << " and " << rbb->id << ": " << pdi.dist << std::endl;
+
+        violation = true;
+        break;
+      }
+    }
+
+    // accept the speculative step if no violation occurred
+    if (!violation)
+      break;
+
+    // roll back to the snapshotted state and halve the step
+    restore_state_snapshot();
+    h *= 0.5;
+
+    // if the step has become tiny, fall back to conservative advancement
+    if (h < min_step_size)
+    {
+      // recompute distances at the (restored) pre-step configuration
+      double CA_step;
+      {
+        StepProfiler::ScopedTimer timer(profiler, StepProfiler::eNarrowPhase);
+        calc_pairwise_distances();
+        CA_step = calc_next_CA_Euler_step(contact_dist_thresh);
+      }
+
+      // take the conservative advancement step, but never less than the
+      // minimum step nor more than the remaining interval
+      h = std::max(min_step_size, CA_step);
+      h = std::min(h, dt);
+      FILE_LOG(LOG_SIMULATOR) << "Optimistic stepping fell back to conservative advancement step: " << h << std::endl;
+
+      // integrate the bodies' positions by h from the restored coordinates
+      // and accept
+      {
+        StepProfiler::ScopedTimer timer(profiler, StepProfiler::eIntegration);
+        for (unsigned i=0; i< _bodies.size(); i++)
+        {
+          shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+          if (sleeping_enabled && body_is_asleep(db))
+            continue;
+          db->get_generalized_coordinates_euler(q0);
+          db->get_generalized_velocity(DynamicBodyd::eEuler, q);
+          q *= h;
+          q += q0;
+          db->set_generalized_coordinates_euler(q);
+        }
+        invalidate_joint_step_data();
+      }
+
+      break;
+    }
+  }
+
+  // the step is accepted; discard the snapshot (its frame is recycled)
+  pop_state_snapshot(false);
+
+  FILE_LOG(LOG_SIMULATOR) << "Position integration ended w/h = " << h << std::endl;
+
+  {
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eForwardDynamics);
+
+    // prepare to calculate forward dynamics
+    precalc_fwd_dyn();
+
+    // apply compliant unilateral constraint forces
+    calc_compliant_unilateral_constraint_forces();
+
+    // compute forward dynamics
+    calc_fwd_dyn(h);
+  }
+
+  // integrate the bodies' velocities forward by h
+  {
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eIntegration);
+    for (unsigned i=0; i< _bodies.size(); i++)
+    {
+      shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+      if (sleeping_enabled && body_is_asleep(db))
+        continue;
+      db->get_generalized_acceleration(qdd);
+      qdd *= h;
+      db->get_generalized_velocity(DynamicBodyd::eSpatial, qd);
+      FILE_LOG(LOG_DYNAMICS) << "old velocity: " << qd << std::endl;
+      qd += qdd;
+      db->set_generalized_velocity(DynamicBodyd::eSpatial, qd);
+      FILE_LOG(LOG_DYNAMICS) << "new velocity: " << qd << std::endl;
+    }
+
+    // dissipate some energy
+    if (_dissipator)
+    {
+      vector<shared_ptr<DynamicBodyd> > bodies;
+      BOOST_FOREACH(ControlledBodyPtr cb, _bodies)
+        bodies.push_back(dynamic_pointer_cast<DynamicBodyd>(cb));
+      _dissipator->apply(bodies);
+    }
+  }
+
+  FILE_LOG(LOG_SIMULATOR) << "Integrated velocity by " << h << std::endl;
+
+  // recompute pairwise distances and find unilateral constraints
+  {
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eNarrowPhase);
+    calc_pairwise_distances();
+    find_unilateral_constraints(contact_dist_thresh);
+  }
 
   // handle any impacts
-  calc_impacting_unilateral_constraint_forces(-1.0);
+  {
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eImpactHandling);
+    calc_impacting_unilateral_constraint_forces(-1.0);
+  }
+
+  // update per-body sleep states now that impacts have been resolved
+  if (sleeping_enabled)
+    update_sleep_states(h);
+
+  // freeze or promote far-field bodies relative to the regions of interest
+  if (roi_enabled)
+    update_roi_states();
 
   // update the time
   current_time += h;
@@ -221,6 +645,68 @@ double TimeSteppingSimulator::do_mini_step(double dt)
   return h;
 }
 
+/// Adds speculative contact constraints for pairs that could tunnel within dt
+/**
+ * A pair separated by more than the contact threshold generates no regular
+ * contact, but if its conservative time of impact lies inside the coming
+ * step, the velocity-level solver must see it now: a constraint is built at
+ * the pair's current closest features and credited with an approach speed of
+ * gap/dt, so the solver removes only the normal velocity in excess of what
+ * closes the gap exactly over the step.  This is what lets do_mini_step()
+ * integrate positions by the full interval without conservative advancement
+ * subdivision -- no pair can pass through unresolved geometry, because its
+ * approach speed was clamped as soon as its time of impact fell inside a
+ * step.  The horizon is the current target step; abrupt growth of the step
+ * size between calls is not covered.
+ */
+void TimeSteppingSimulator::find_speculative_contacts(double dt)
+{
+  BOOST_FOREACH(const PairwiseDistInfo& pdi, _pairwise_distances)
+  {
+    // pairs within the contact threshold already generated regular contacts
+    if (pdi.dist < contact_dist_thresh)
+      continue;
+
+    // compliant pairs are handled with penalty forces; tunneling prevention
+    // at the velocity level does not apply to them
+    RigidBodyPtr rba = dynamic_pointer_cast<RigidBody>(pdi.a->get_single_body());
+    RigidBodyPtr rbb = dynamic_pointer_cast<RigidBody>(pdi.b->get_single_body());
+    if (rba->compliance == RigidBody::eCompliant ||
+        rbb->compliance == RigidBody::eCompliant)
+      continue;
+
+    // check the conservative time of impact against the step
+    double toi = _coldet->calc_CA_Euler_step(pdi);
+    if (toi >= dt)
+      continue;
+
+    FILE_LOG(LOG_SIMULATOR) << "speculative contact between " << rba->id << " and " << rbb->id << "; gap: " << pdi.dist << ", conservative TOI: " << toi << std::endl;
+
+    // an impending contact wakes any sleeping participant
+    if (sleeping_enabled)
+    {
+      shared_ptr<DynamicBodyd> sba = rba->get_super_body();
+      shared_ptr<DynamicBodyd> sbb = rbb->get_super_body();
+      if (body_is_asleep(sba))
+        wake_body(sba);
+      if (body_is_asleep(sbb))
+        wake_body(sbb);
+    }
+
+    // build the contact at the pair's current closest features
+    const unsigned FIRST = _rigid_constraints.size();
+    _coldet->find_contacts(pdi.a, pdi.b, _rigid_constraints, pdi.dist + NEAR_ZERO);
+
+    // credit the approach speed that closes the gap exactly over the step
+    for (unsigned i=FIRST; i< _rigid_constraints.size(); i++)
+    {
+      _rigid_constraints[i].compliance = UnilateralConstraint::eRigid;
+      _rigid_constraints[i].signed_violation = pdi.dist;
+      _rigid_constraints[i].contact_approach_vel = pdi.dist/dt;
+    }
+  }
+}
+
 /// Checks to see whether all constraints are met
 bool TimeSteppingSimulator::constraints_met(const std::vector<PairwiseDistInfo>& current_pairwise_distances)
 {
@@ -366,6 +852,7 @@ void TimeSteppingSimulator::step_si_Euler(double dt)
     q += qsave[i];
     db->set_generalized_coordinates_euler(q);
   }
+  invalidate_joint_step_data();
 
   // prepare to calculate forward dynamics
   precalc_fwd_dyn();
@@ -436,9 +923,14 @@ void TimeSteppingSimulator::step_si_Euler(double dt)
   const double INF = std::numeric_limits<double>::max();
 
   // do a number of mini-steps until integrated forward fully
-  double h = 0.0;
-  while (h < dt)
-    h += do_mini_step(dt-h);
+  if (two_level_stepping)
+    step_two_level(dt);
+  else
+  {
+    double h = 0.0;
+    while (h < dt)
+      h += (optimistic_stepping) ? do_mini_step_optimistic(dt-h) : do_mini_step(dt-h);
+  }
 
   if (LOGGING(LOG_SIMULATOR))
   {
@@ -454,6 +946,158 @@ void TimeSteppingSimulator::step_si_Euler(double dt)
   FILE_LOG(LOG_SIMULATOR) << "-- semi-implicit Euler step completed" << std::endl;
 }
 
+/// Does a two-level semi-implicit step
+/**
+ * Bodies certified contact-free for the whole interval integrate once by
+ * the full step while the islands near contact subdivide via do_mini_step().
+ * The certificate comes from the broad phase already run by step() over the
+ * full interval: its bounding volumes are swept by the step, so a body with
+ * no geometry in any candidate pair cannot contact anything before t + dt.
+ * An island body deflected toward a free body by an impact can escape its
+ * swept bound; such a pair is picked up by the next step's broad phase and
+ * resolved then, one step late at worst.
+ */
+void TimeSteppingSimulator::step_two_level(double dt)
+{
+  VectorNd q, qd, qdd;
+
+  // determine the super bodies that the broad phase deemed near contact
+  // (_pairs_to_check was computed by step() over the full interval)
+  std::set<shared_ptr<DynamicBodyd> > near_contact;
+  for (unsigned i=0; i< _pairs_to_check.size(); i++)
+  {
+    near_contact.insert(dynamic_pointer_cast<DynamicBodyd>(_pairs_to_check[i].first->get_single_body()->get_super_body()));
+    near_contact.insert(dynamic_pointer_cast<DynamicBodyd>(_pairs_to_check[i].second->get_single_body()->get_super_body()));
+  }
+
+  // partition the bodies into free-flight bodies and contact islands
+  vector<ControlledBodyPtr> free_bodies, island_bodies;
+  for (unsigned i=0; i< _bodies.size(); i++)
+  {
+    shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(_bodies[i]);
+
+    // bodies near contact must mini-step
+    if (near_contact.find(db) != near_contact.end())
+    {
+      island_bodies.push_back(_bodies[i]);
+      continue;
+    }
+
+    // articulated bodies that can reach a joint limit within dt must also
+    // mini-step so the limit event is located precisely
+    ArticulatedBodyPtr ab = dynamic_pointer_cast<ArticulatedBody>(_bodies[i]);
+    if (ab && joint_limit_reachable(ab, dt))
+    {
+      island_bodies.push_back(_bodies[i]);
+      continue;
+    }
+
+    free_bodies.push_back(_bodies[i]);
+  }
+
+  FILE_LOG(LOG_SIMULATOR) << "two-level step: " << free_bodies.size() << " free bodies, " << island_bodies.size() << " island bodies" << std::endl;
+
+  // if nothing is free, step normally
+  if (free_bodies.empty())
+  {
+    double h = 0.0;
+    while (h < dt)
+      h += (optimistic_stepping) ? do_mini_step_optimistic(dt-h) : do_mini_step(dt-h);
+    return;
+  }
+
+  // integrate the free bodies' positions by the full step
+  std::vector<VectorNd> qsave(free_bodies.size());
+  {
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eIntegration);
+    for (unsigned i=0; i< free_bodies.size(); i++)
+    {
+      shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(free_bodies[i]);
+      db->get_generalized_coordinates_euler(qsave[i]);
+      if (sleeping_enabled && body_is_asleep(db))
+        continue;
+      db->get_generalized_velocity(DynamicBodyd::eEuler, q);
+      q *= dt;
+      q += qsave[i];
+      db->set_generalized_coordinates_euler(q);
+    }
+    invalidate_joint_step_data();
+  }
+
+  // compute forward dynamics (free bodies have no compliant contacts, so
+  // unlike do_mini_step no compliant constraint forces are applied)
+  {
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eForwardDynamics);
+    precalc_fwd_dyn();
+    calc_fwd_dyn(dt);
+  }
+
+  // integrate the free bodies' velocities forward by the full step
+  {
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eIntegration);
+    for (unsigned i=0; i< free_bodies.size(); i++)
+    {
+      shared_ptr<DynamicBodyd> db = dynamic_pointer_cast<DynamicBodyd>(free_bodies[i]);
+      if (sleeping_enabled && body_is_asleep(db))
+        continue;
+      db->get_generalized_acceleration(qdd);
+      qdd *= dt;
+      db->get_generalized_velocity(DynamicBodyd::eSpatial, qd);
+      qd += qdd;
+      db->set_generalized_velocity(DynamicBodyd::eSpatial, qd);
+    }
+
+    // dissipate some energy from the free bodies (the mini-step loop below
+    // only dissipates from the islands)
+    if (_dissipator)
+    {
+      vector<shared_ptr<DynamicBodyd> > bodies;
+      BOOST_FOREACH(ControlledBodyPtr cb, free_bodies)
+        bodies.push_back(dynamic_pointer_cast<DynamicBodyd>(cb));
+      _dissipator->apply(bodies);
+    }
+  }
+
+  // mini-step only the islands: restrict the simulator's body set so that
+  // the per-ministep broad phase, narrow phase, and constraint handling
+  // never touch the free bodies
+  vector<ControlledBodyPtr> all_bodies = _bodies;
+  _bodies = island_bodies;
+  determine_geometries();
+  try
+  {
+    // do a number of mini-steps until integrated forward fully; with no
+    // islands at all, a single mini-step covers the interval (it finds no
+    // pairwise distances and thus no conservative advancement restriction)
+    double h = 0.0;
+    while (h < dt)
+      h += (optimistic_stepping) ? do_mini_step_optimistic(dt-h) : do_mini_step(dt-h);
+  }
+  catch (...)
+  {
+    // restore the full body set before propagating the exception (waiting
+    // for any broad-phase worker still reading the restricted set)
+    cancel_broad_phase_async();
+    _bodies = all_bodies;
+    determine_geometries();
+    throw;
+  }
+
+  // restore the full body set (waiting for any broad-phase worker still
+  // reading the restricted set)
+  cancel_broad_phase_async();
+  _bodies = all_bodies;
+  determine_geometries();
+
+  // recompute pairwise distances over all geometries so callers (and the
+  // stabilization that follows in step()) see the merged configuration
+  {
+    StepProfiler::ScopedTimer timer(profiler, StepProfiler::eNarrowPhase);
+    broad_phase(0.0);
+    calc_pairwise_distances();
+  }
+}
+
 /// Implements Base::load_from_xml()
 void TimeSteppingSimulator::load_from_xml(shared_ptr<const XMLTree> node, map<std::string, BasePtr>& id_map)
 {
@@ -470,6 +1114,31 @@ void TimeSteppingSimulator::load_from_xml(shared_ptr<const XMLTree> node, map<st
   XMLAttrib* min_step_attrib = node->get_attrib("min-step-size");
   if (min_step_attrib)
     min_step_size = min_step_attrib->get_real_value();
+
+  // read whether to step optimistically with rollback
+  XMLAttrib* optimistic_attrib = node->get_attrib("optimistic-stepping");
+  if (optimistic_attrib)
+    optimistic_stepping = optimistic_attrib->get_bool_value();
+
+  // read whether to step hierarchically (full step for contact-free bodies)
+  XMLAttrib* two_level_attrib = node->get_attrib("two-level-stepping");
+  if (two_level_attrib)
+    two_level_stepping = two_level_attrib->get_bool_value();
+
+  // read whether to generate speculative contacts
+  XMLAttrib* speculative_attrib = node->get_attrib("speculative-contacts");
+  if (speculative_attrib)
+    speculative_contacts = speculative_attrib->get_bool_value();
+
+  // read the wall-clock budget per step, if given
+  XMLAttrib* rt_budget_attrib = node->get_attrib("rt-step-budget");
+  if (rt_budget_attrib)
+    rt_step_budget = rt_budget_attrib->get_real_value();
+
+  // read the degraded-mode PGS sweep cap, if given
+  XMLAttrib* rt_pgs_attrib = node->get_attrib("rt-pgs-max-iterations");
+  if (rt_pgs_attrib)
+    rt_pgs_max_iterations = rt_pgs_attrib->get_unsigned_value();
 }
 
 /// Implements Base::save_to_xml()
@@ -483,6 +1152,19 @@ void TimeSteppingSimulator::save_to_xml(XMLTreePtr node, list<shared_ptr<const B
 
   // save the minimum step size
   node->attribs.insert(XMLAttrib("min-step-size", min_step_size));
+
+  // save whether to step optimistically with rollback
+  node->attribs.insert(XMLAttrib("optimistic-stepping", optimistic_stepping));
+
+  // save whether to step hierarchically
+  node->attribs.insert(XMLAttrib("two-level-stepping", two_level_stepping));
+
+  // save whether to generate speculative contacts
+  node->attribs.insert(XMLAttrib("speculative-contacts", speculative_contacts));
+
+  // save the real-time budget settings
+  node->attribs.insert(XMLAttrib("rt-step-budget", rt_step_budget));
+  node->attribs.insert(XMLAttrib("rt-pgs-max-iterations", rt_pgs_max_iterations));
 }
 
 
@@ -18,6 +18,7 @@
 #include <Moby/HeightmapPrimitive.h>
 #include <Moby/TorusPrimitive.h>
 #include <Moby/PlanePrimitive.h>
+#include <Moby/CylinderPrimitive.h>
 
 using boost::shared_ptr;
 using boost::const_pointer_cast;
@@ -203,7 +204,12 @@ double TorusPrimitive::calc_signed_dist(shared_ptr<const Primitive> p, Point3d&
   if (planep)
     return calc_signed_dist(planep, pthis, pp);
 
-  throw std::runtime_error("Unsupported geometric pair"); 
+  // attempt torus/cylinder
+  shared_ptr<const CylinderPrimitive> cylp = dynamic_pointer_cast<const CylinderPrimitive>(p);
+  if (cylp)
+    return calc_signed_dist(cylp, pthis, pp);
+
+  throw std::runtime_error("Unsupported geometric pair");
 }
 
 /// Get random variable
@@ -351,6 +357,166 @@ double TorusPrimitive::calc_signed_dist(shared_ptr<const PlanePrimitive> p, Poin
   return d;
 }
 
+/// Computes the signed distance and closest point between a point and a cylinder, both given in the cylinder's frame
+/**
+ * The cylinder has radius rc and half-height hh and is aligned with its
+ * frame's y axis.
+ */
+static double calc_point_cylinder_dist(const Point3d& p, double rc, double hh, Point3d& cp)
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+
+  // radial distance of the point from the cylinder axis
+  double rd = std::sqrt(p[X]*p[X] + p[Z]*p[Z]);
+
+  // handle a point inside the cylinder: the closest surface feature is the
+  // lateral surface or one of the caps, whichever is nearer
+  if (rd <= rc && std::fabs(p[Y]) <= hh)
+  {
+    double d_lat = rc - rd;
+    double d_cap = hh - std::fabs(p[Y]);
+    cp = p;
+    if (d_lat < d_cap)
+    {
+      // project onto the lateral surface (x direction if on the axis)
+      if (rd > NEAR_ZERO)
+      {
+        cp[X] = p[X]*rc/rd;
+        cp[Z] = p[Z]*rc/rd;
+      }
+      else
+        cp[X] = rc;
+      return -d_lat;
+    }
+    cp[Y] = (p[Y] >= 0.0) ? hh : -hh;
+    return -d_cap;
+  }
+
+  // the point is outside: clamp it to the cylinder
+  cp = p;
+  if (rd > rc)
+  {
+    cp[X] = p[X]*rc/rd;
+    cp[Z] = p[Z]*rc/rd;
+  }
+  if (p[Y] > hh)
+    cp[Y] = hh;
+  else if (p[Y] < -hh)
+    cp[Y] = -hh;
+
+  return (p - cp).norm();
+}
+
+/// Evaluates the distance from a point on the torus center circle to the cylinder
+static double eval_circle_cylinder_dist(const Point3d& o, const Vector3d& u, const Vector3d& v, double R, double theta, double rc, double hh, Point3d& q, Point3d& cp)
+{
+  q = o + u*(R*std::cos(theta)) + v*(R*std::sin(theta));
+  return calc_point_cylinder_dist(q, rc, hh, cp);
+}
+
+/// Computes the signed distance from the torus to a cylinder
+/**
+ * The solid torus is the Minkowski sum of its center circle (major radius R,
+ * in the torus xy-plane) and a ball of minor radius r, so its signed distance
+ * to the cylinder is the distance from the center circle to the cylinder less
+ * r.  The circle-to-cylinder distance is a one-dimensional function of the
+ * circle parameter; it is minimized by coarse sampling followed by
+ * golden-section refinement of the bracketing interval, which costs a fixed
+ * number of closed-form point/cylinder queries (no GJK iteration, meshing,
+ * or dependence on the relative pose of the pair).
+ */
+double TorusPrimitive::calc_signed_dist(shared_ptr<const CylinderPrimitive> p, Point3d& pthis, Point3d& pp) const
+{
+  const unsigned SAMPLES = 36;
+  const unsigned REFINE_ITER = 32;
+  const double GOLDEN = 0.3819660112501051;   // 2 - golden ratio
+
+  FILE_LOG(LOG_COLDET) << ">> start calc_signed_dist_torus_cylinder(.)" << std::endl;
+
+  const double R = _major_radius;
+  const double r = _minor_radius;
+  const double rc = p->get_radius();
+  const double hh = p->get_height() * 0.5;
+
+  // get the pose for the torus and the cylinder
+  shared_ptr<const Pose3d> Ptorus = pthis.pose;
+  shared_ptr<const Pose3d> Pcyl = pp.pose;
+
+  // get the transformation from the torus's space to the cylinder's space
+  Transform3d cTt = Pose3d::calc_relative_pose(Ptorus, Pcyl);
+
+  // the torus center circle in the cylinder frame: center o with orthonormal
+  // in-plane directions u (torus x axis) and v (torus y axis)
+  Matrix3d Rm(cTt.q);
+  Vector3d u(Rm.get_column(0), Pcyl);
+  Vector3d v(Rm.get_column(1), Pcyl);
+  Point3d o(cTt.x, Pcyl);
+
+  // coarsely sample the circle parameter to bracket the global minimum
+  Point3d q(Pcyl), cp(Pcyl), best_q(Pcyl), best_cp(Pcyl);
+  double best_theta = 0.0, best_d = std::numeric_limits<double>::max();
+  for (unsigned i=0; i< SAMPLES; i++)
+  {
+    double theta = (M_PI * 2.0) * i / SAMPLES;
+    double d = eval_circle_cylinder_dist(o, u, v, R, theta, rc, hh, q, cp);
+    if (d < best_d)
+    {
+      best_d = d;
+      best_theta = theta;
+      best_q = q;
+      best_cp = cp;
+    }
+  }
+
+  // refine within the bracketing interval using golden-section search
+  double a = best_theta - (M_PI * 2.0) / SAMPLES;
+  double b = best_theta + (M_PI * 2.0) / SAMPLES;
+  double x1 = a + GOLDEN*(b-a), x2 = b - GOLDEN*(b-a);
+  double f1 = eval_circle_cylinder_dist(o, u, v, R, x1, rc, hh, q, cp);
+  double f2 = eval_circle_cylinder_dist(o, u, v, R, x2, rc, hh, q, cp);
+  for (unsigned i=0; i< REFINE_ITER; i++)
+  {
+    if (f1 < f2)
+    {
+      b = x2;  x2 = x1;  f2 = f1;
+      x1 = a + GOLDEN*(b-a);
+      f1 = eval_circle_cylinder_dist(o, u, v, R, x1, rc, hh, q, cp);
+    }
+    else
+    {
+      a = x1;  x1 = x2;  f1 = f2;
+      x2 = b - GOLDEN*(b-a);
+      f2 = eval_circle_cylinder_dist(o, u, v, R, x2, rc, hh, q, cp);
+    }
+  }
+  double theta = (f1 < f2) ? x1 : x2;
+  double d = eval_circle_cylinder_dist(o, u, v, R, theta, rc, hh, q, cp);
+  if (d < best_d)
+  {
+    best_d = d;
+    best_q = q;
+    best_cp = cp;
+  }
+
+  // the closest point on the torus surface lies at minor radius r from the
+  // center circle toward the cylinder
+  Vector3d w = best_cp - best_q;
+  if (w.norm() > NEAR_ZERO)
+    w.normalize();
+  else
+    w = Vector3d::normalize(o - best_q);
+  Point3d tsurf = best_q + w*r;
+
+  // setup the closest points in the primitives' frames
+  pthis = Pose3d::transform_point(Ptorus, tsurf);
+  pp = best_cp;
+
+  FILE_LOG(LOG_COLDET) << "distance: " << (best_d - r) << std::endl;
+  FILE_LOG(LOG_COLDET) << "<< end calc_signed_dist_torus_cylinder(.)" << std::endl;
+
+  return best_d - r;
+}
+
 /// Implements Base::load_from_xml() for serialization
 void TorusPrimitive::load_from_xml(shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map)
 {
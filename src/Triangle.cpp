@@ -5,6 +5,8 @@
  ****************************************************************************/
 
 #include <cmath>
+#include <algorithm>
+#include <vector>
 #include <Moby/Plane.h>
 #include <Moby/InvalidIndexException.h>
 #include <Moby/Constants.h>
@@ -690,11 +692,30 @@ double Triangle::calc_sq_dist(const Triangle& tri, const Point3d& point, double&
   Vector3d E1 = tri.c - tri.a;
   double A00 = E0.norm_sq();
   double A01 = Vector3d::dot(E0, E1);
-  double A11 = E1.norm_sq(); 
+  double A11 = E1.norm_sq();
   double B0 = Vector3d::dot(k_diff, E0);
   double B1 = Vector3d::dot(k_diff, E1);
   double C = k_diff.norm_sq();
   double det = std::fabs(A00*A11-A01*A01);
+
+  // classify the Voronoi region and compute the squared distance
+  return calc_sq_dist_from_coeffs(A00, A01, A11, B0, B1, C, det, s, t);
+}
+
+/// Classifies the Voronoi region for a point/triangle query from the quadratic coefficients and computes the squared distance
+/**
+ * The coefficients are those of the quadratic q(s,t) = A00*s^2 + 2*A01*s*t +
+ * A11*t^2 + 2*B0*s + 2*B1*t + C that gives the squared distance over the
+ * triangle's parameter space. Separating the (branch-free) coefficient setup
+ * from this (branchy) classification lets batched queries stage coefficients
+ * for many triangles in a vectorizable pass before classifying.
+ * \param s the Barycentric coordinate s is returned here
+ * \param t the Barycentric coordinate t is returned here
+ * \return the squared Euclidean distance between the triangle and the point
+ * \note code adapted from www.geometrictools.com
+ */
+double Triangle::calc_sq_dist_from_coeffs(double A00, double A01, double A11, double B0, double B1, double C, double det, double& s, double& t)
+{
   s = A01*B1-A11*B0;
   t = A01*B0-A00*B1;
   double sqr_dist;
@@ -907,7 +928,7 @@ double Triangle::calc_sq_dist(const Triangle& tri, const Point3d& point, double&
     }
   }
 
-  // convert to standard notation 
+  // convert to standard notation
   const double SPRIME = 1-s-t;
   const double TPRIME = s;
   s = SPRIME;
@@ -915,6 +936,72 @@ double Triangle::calc_sq_dist(const Triangle& tri, const Point3d& point, double&
   return sqr_dist;
 }
 
+/// Determines the squared distances between a contiguous batch of triangles and a given point
+/**
+ * The batch is processed in fixed-size bundles: the quadratic setup
+ * coefficients for a bundle are computed in a branch-free pass laid out as a
+ * structure-of-arrays (amenable to compiler vectorization) before the branchy
+ * Voronoi-region classification runs on the cached coefficients. BV-tree leaf
+ * visitors should feed whole leaf triangle lists through this interface
+ * rather than querying triangles one at a time.
+ * \param tris a contiguous array of triangles
+ * \param n the number of triangles in the batch
+ * \param point the query point
+ * \param sq_dists the squared Euclidean distance to each triangle is returned here (must have space for n entries)
+ * \param closest_points the closest point on each triangle is returned here (may be NULL; must otherwise have space for n entries)
+ */
+void Triangle::calc_sq_dists(const Triangle* tris, unsigned n, const Point3d& point, double* sq_dists, Point3d* closest_points)
+{
+  const unsigned BUNDLE = 8;
+  double A00[BUNDLE], A01[BUNDLE], A11[BUNDLE], B0[BUNDLE], B1[BUNDLE], C[BUNDLE], det[BUNDLE];
+
+  // process the batch a bundle at a time
+  for (unsigned start=0; start < n; start += BUNDLE)
+  {
+    const unsigned m = std::min(BUNDLE, n - start);
+
+    // setup pass: pure arithmetic with no control flow
+    for (unsigned k=0; k< m; k++)
+    {
+      const Triangle& tri = tris[start+k];
+      Vector3d k_diff = tri.a - point;
+      Vector3d E0 = tri.b - tri.a;
+      Vector3d E1 = tri.c - tri.a;
+      A00[k] = E0.norm_sq();
+      A01[k] = Vector3d::dot(E0, E1);
+      A11[k] = E1.norm_sq();
+      B0[k] = Vector3d::dot(k_diff, E0);
+      B1[k] = Vector3d::dot(k_diff, E1);
+      C[k] = k_diff.norm_sq();
+      det[k] = std::fabs(A00[k]*A11[k]-A01[k]*A01[k]);
+    }
+
+    // classification pass on the cached coefficients
+    for (unsigned k=0; k< m; k++)
+    {
+      double s, t;
+      sq_dists[start+k] = calc_sq_dist_from_coeffs(A00[k], A01[k], A11[k], B0[k], B1[k], C[k], det[k], s, t);
+      if (closest_points)
+        closest_points[start+k] = tris[start+k].calc_point(s, t);
+    }
+  }
+}
+
+/// Determines the squared distances between a batch of triangles and a given point
+/**
+ * \param tris the batch of triangles
+ * \param point the query point
+ * \param sq_dists the squared Euclidean distance to each triangle is returned here
+ * \param closest_points the closest point on each triangle is returned here
+ */
+void Triangle::calc_sq_dists(const std::vector<Triangle>& tris, const Point3d& point, std::vector<double>& sq_dists, std::vector<Point3d>& closest_points)
+{
+  sq_dists.resize(tris.size());
+  closest_points.resize(tris.size());
+  if (!tris.empty())
+    calc_sq_dists(&tris.front(), tris.size(), point, &sq_dists.front(), &closest_points.front());
+}
+
 /// Determines the signed distance between this triangle and a given point
 /**
  * \param point the query point
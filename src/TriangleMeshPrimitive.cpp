@@ -21,6 +21,8 @@
 #include <Moby/Constants.h>
 #include <Moby/XMLTree.h>
 #include <Moby/OBB.h>
+#include <Moby/SSR.h>
+#include <Moby/SSL.h>
 #include <Moby/BoundingSphere.h>
 #include <Moby/CollisionGeometry.h>
 #include <Moby/GJK.h>
@@ -44,11 +46,40 @@ using boost::const_pointer_cast;
 
 // TODO: determine whether the mesh makes a polyhedron
 
+/// Loads a mesh from an OBJ file, maintaining a compiled binary cache alongside it
+/**
+ * If a sibling '<filename>.cmsh' file exists and is readable, the mesh is
+ * loaded from it with a few bulk reads; otherwise the OBJ text is parsed and
+ * the binary cache is (best effort) written for subsequent startups.
+ */
+static IndexedTriArray load_obj_with_binary_cache(const string& filename)
+{
+  const string cache_fname = filename + ".cmsh";
+
+  // try the compiled binary cache first
+  try
+  {
+    return IndexedTriArray::read_from_binary(cache_fname);
+  }
+  catch (std::runtime_error& e)
+  {
+    // cache missing or stale format; fall through to the OBJ parser
+  }
+
+  // parse the OBJ text and write the cache for the next startup
+  IndexedTriArray mesh = IndexedTriArray::read_from_obj(filename);
+  IndexedTriArray::write_to_binary(mesh, cache_fname);
+  return mesh;
+}
+
 /// Creates the triangle mesh primitive
 TriangleMeshPrimitive::TriangleMeshPrimitive()
 {
   _convexify_inertia = false;
   _edge_sample_length = std::numeric_limits<double>::max();
+  _refit_enabled = false;
+  _refit_fatness_tol = 1.5;
+  _bv_tree_type = eOBBTree;
 }
 
 /// Creates the triangle mesh from a geometry file and optionally centers it
@@ -60,9 +91,18 @@ TriangleMeshPrimitive::TriangleMeshPrimitive(const string& filename, bool center
   // do not sample edges by default
   _edge_sample_length = std::numeric_limits<double>::max();
 
+  // rebuild (rather than refit) bounding volume hierarchies by default
+  _refit_enabled = false;
+  _refit_fatness_tol = 1.5;
+
+  // build OBB hierarchies by default
+  _bv_tree_type = eOBBTree;
+
   // construct a new triangle mesh from the filename
-  if (filename.find(".obj") == filename.size() - 4)
-    set_mesh(shared_ptr<IndexedTriArray>(new IndexedTriArray(IndexedTriArray::read_from_obj(filename))));
+  if (filename.find(".cmsh") == filename.size() - 5)
+    set_mesh(shared_ptr<IndexedTriArray>(new IndexedTriArray(IndexedTriArray::read_from_binary(filename))));
+  else if (filename.find(".obj") == filename.size() - 4)
+    set_mesh(shared_ptr<IndexedTriArray>(new IndexedTriArray(load_obj_with_binary_cache(filename))));
   else
     throw std::runtime_error("TriangleMeshPrimitive (constructor): unknown mesh file type!");
 
@@ -83,9 +123,18 @@ TriangleMeshPrimitive::TriangleMeshPrimitive(const string& filename, const Pose3
   // do not sample edges by default
   _edge_sample_length = std::numeric_limits<double>::max();
 
+  // rebuild (rather than refit) bounding volume hierarchies by default
+  _refit_enabled = false;
+  _refit_fatness_tol = 1.5;
+
+  // build OBB hierarchies by default
+  _bv_tree_type = eOBBTree;
+
   // construct a new triangle mesh from the filename
-  if (filename.find("obj") == filename.size() - 4)
-    set_mesh(shared_ptr<IndexedTriArray>(new IndexedTriArray(IndexedTriArray::read_from_obj(filename))));
+  if (filename.find(".cmsh") == filename.size() - 5)
+    set_mesh(shared_ptr<IndexedTriArray>(new IndexedTriArray(IndexedTriArray::read_from_binary(filename))));
+  else if (filename.find("obj") == filename.size() - 4)
+    set_mesh(shared_ptr<IndexedTriArray>(new IndexedTriArray(load_obj_with_binary_cache(filename))));
   else
     throw std::runtime_error("TriangleMeshPrimitive (constructor): unknown mesh file type!");
 
@@ -107,6 +156,41 @@ void TriangleMeshPrimitive::set_edge_sample_length(double len)
   _mesh_vertices.clear();
 }
 
+/// Sets whether pose updates refit the existing BV hierarchies rather than rebuilding them
+void TriangleMeshPrimitive::set_refit_enabled(bool enabled)
+{
+  _refit_enabled = enabled;
+}
+
+/// Sets the root volume growth ratio above which a refitted hierarchy is lazily rebuilt
+void TriangleMeshPrimitive::set_refit_fatness_tol(double tol)
+{
+  assert(tol >= 1.0);
+  _refit_fatness_tol = tol;
+}
+
+/// Sets the bounding volume type used for this primitive's hierarchies
+/**
+ * OBB trees (the default) fit general meshes well; SSR and SSL trees bound
+ * elongated geometry more tightly under swept-volume queries, which can
+ * substantially reduce the number of node tests in conservative advancement.
+ * Existing hierarchies are discarded and rebuilt with the new type on the
+ * next call to get_BVH_root().
+ */
+void TriangleMeshPrimitive::set_BV_tree_type(BVTreeType type)
+{
+  // nothing to do if the type is unchanged
+  if (type == _bv_tree_type)
+    return;
+  _bv_tree_type = type;
+
+  // existing hierarchies use the old volume type
+  _mesh_vertices.clear();
+  _roots.clear();
+  _build_volumes.clear();
+  _needs_rebuild.clear();
+}
+
 /// Creates the visualization for this primitive
 osg::Node* TriangleMeshPrimitive::create_visualization()
 {
@@ -208,6 +292,35 @@ void TriangleMeshPrimitive::load_from_xml(shared_ptr<const XMLTree> node, map<st
   if (esl_attr)
     set_edge_sample_length(esl_attr->get_real_value());
 
+  // determine whether pose updates refit the BV hierarchies
+  XMLAttrib* refit_attr = node->get_attrib("refit-bvh");
+  if (refit_attr)
+    set_refit_enabled(refit_attr->get_bool_value());
+
+  // read in the refit fatness tolerance
+  XMLAttrib* refit_tol_attr = node->get_attrib("refit-fatness-tol");
+  if (refit_tol_attr)
+    set_refit_fatness_tol(refit_tol_attr->get_real_value());
+
+  // read in the bounding volume type, if specified
+  XMLAttrib* bv_type_attr = node->get_attrib("bv-type");
+  if (bv_type_attr)
+  {
+    const string& bv_type = bv_type_attr->get_string_value();
+    if (strcasecmp(bv_type.c_str(), "OBB") == 0)
+      set_BV_tree_type(eOBBTree);
+    else if (strcasecmp(bv_type.c_str(), "SSR") == 0)
+      set_BV_tree_type(eSSRTree);
+    else if (strcasecmp(bv_type.c_str(), "SSL") == 0)
+      set_BV_tree_type(eSSLTree);
+    else
+    {
+      cerr << "TriangleMeshPrimitive::load_from_xml() - unrecognized bounding" << endl;
+      cerr << "  volume type '" << bv_type << "' (valid types are 'OBB'," << endl;
+      cerr << "  'SSR' and 'SSL'); using OBB" << endl;
+    }
+  }
+
   // make sure that this Triangle array has a filename specified
   XMLAttrib* fname_attr = node->get_attrib("filename");
   if (!fname_attr)
@@ -220,6 +333,7 @@ void TriangleMeshPrimitive::load_from_xml(shared_ptr<const XMLTree> node, map<st
 
   // setup the file extensions
   const char* OBJ_EXT = ".obj";
+  const char* CMSH_EXT = ".cmsh";
 
   // get the filename
   string fname(fname_attr->get_string_value());
@@ -229,12 +343,15 @@ void TriangleMeshPrimitive::load_from_xml(shared_ptr<const XMLTree> node, map<st
   std::transform(fname_lower.begin(), fname_lower.end(), fname_lower.begin(), (int(*)(int)) std::tolower);
 
   // get the type of file and construct the triangle mesh appropriately
-  if (fname_lower.find(string(OBJ_EXT)) == fname_lower.size() - strlen(OBJ_EXT))
-    set_mesh(shared_ptr<IndexedTriArray>(new IndexedTriArray(IndexedTriArray::read_from_obj(fname))));
+  if (fname_lower.find(string(CMSH_EXT)) == fname_lower.size() - strlen(CMSH_EXT))
+    set_mesh(shared_ptr<IndexedTriArray>(new IndexedTriArray(IndexedTriArray::read_from_binary(fname))));
+  else if (fname_lower.find(string(OBJ_EXT)) == fname_lower.size() - strlen(OBJ_EXT))
+    set_mesh(shared_ptr<IndexedTriArray>(new IndexedTriArray(load_obj_with_binary_cache(fname))));
   else
   {
     cerr << "TriangleMeshPrimitive::load_from_xml() - unrecognized filename extension" << endl;
     cerr << "  for attribute 'filename'.  Valid extensions are '.obj' (Wavefront OBJ)" << endl;
+    cerr << "  and '.cmsh' (compiled binary mesh)" << endl;
   }
   
   // see whether to center the mesh
@@ -264,6 +381,18 @@ void TriangleMeshPrimitive::save_to_xml(XMLTreePtr node, list<shared_ptr<const B
   // save convexification for inertial calculation
   node->attribs.insert(XMLAttrib("convexify-inertia", _convexify_inertia));
 
+  // save the refit mode and its fatness tolerance
+  node->attribs.insert(XMLAttrib("refit-bvh", _refit_enabled));
+  node->attribs.insert(XMLAttrib("refit-fatness-tol", _refit_fatness_tol));
+
+  // save the bounding volume type
+  if (_bv_tree_type == eSSRTree)
+    node->attribs.insert(XMLAttrib("bv-type", string("SSR")));
+  else if (_bv_tree_type == eSSLTree)
+    node->attribs.insert(XMLAttrib("bv-type", string("SSL")));
+  else
+    node->attribs.insert(XMLAttrib("bv-type", string("OBB")));
+
   // make a filename using "this"
   const unsigned MAX_DIGITS = 28;
   char buffer[MAX_DIGITS+1];
@@ -311,7 +440,9 @@ void TriangleMeshPrimitive::set_mesh(boost::shared_ptr<const IndexedTriArray> me
   // vertices and bounding volumes are no longer valid
   _vertices.clear();
   _mesh_vertices.clear();
-  _roots.clear();;
+  _roots.clear();
+  _build_volumes.clear();
+  _needs_rebuild.clear();
 
   // update visualization
   update_visualization();
@@ -326,6 +457,11 @@ void TriangleMeshPrimitive::calc_mass_properties()
   const unsigned X = 0, Y = 1, Z = 2;
   double volume_ints[10];
 
+  // defer the computation if mass properties are being batched (XMLReader
+  // computes all deferred properties in one parallel pass after load)
+  if (defer_calc_mass_properties())
+    return;
+
   // if there is no mesh, set things to some defaults
   if (!_mesh)
   {
@@ -399,14 +535,170 @@ void TriangleMeshPrimitive::calc_mass_properties()
 /// Gets the pointer to the root bounding box
 BVPtr TriangleMeshPrimitive::get_BVH_root(CollisionGeometryPtr geom)
 {
-  // build the bounding box if necessary
-  BVPtr& root = _roots[geom]; 
-  if (!root)
+  // build the bounding box if necessary or if its fit has degraded
+  BVPtr& root = _roots[geom];
+  if (!root || _needs_rebuild.erase(geom) > 0)
     build_BB_tree(geom);
 
   return root; 
 }
 
+/// Allocates a fresh copy of a bounding volume node (children links excluded)
+static BVPtr clone_BV_node(BVPtr bv)
+{
+  shared_ptr<OBB> obb = dynamic_pointer_cast<OBB>(bv);
+  if (obb)
+    return BVPtr(new OBB(*obb));
+  shared_ptr<SSR> ssr = dynamic_pointer_cast<SSR>(bv);
+  if (ssr)
+    return BVPtr(new SSR(*ssr));
+  shared_ptr<SSL> ssl = dynamic_pointer_cast<SSL>(bv);
+  if (ssl)
+    return BVPtr(new SSL(*ssl));
+  shared_ptr<BoundingSphere> bs = dynamic_pointer_cast<BoundingSphere>(bv);
+  if (bs)
+    return BVPtr(new BoundingSphere(*bs));
+
+  // unknown bounding volume type; reuse the node in place
+  return bv;
+}
+
+/// Orders bounding volumes by recorded traversal visits, hottest first
+static bool bv_hotter(BVPtr a, BVPtr b)
+{
+  return a->visits > b->visits;
+}
+
+/// Rewrites a geometry's BV hierarchy in traversal-frequency order
+/**
+ * ray_cast() records a visit count on every node it enters.  This pass
+ * reallocates the hierarchy depth-first with the most-visited child of each
+ * node expanded first, so the nodes a typical query touches are allocated
+ * back-to-back (and the hottest subtree of each node is tested first during
+ * traversal).  A pure layout optimization: the volumes and triangle
+ * assignments are unchanged.  Call it after a representative run; the visit
+ * counters are reset so the next profile starts fresh.
+ */
+void TriangleMeshPrimitive::optimize_BVH_layout(CollisionGeometryPtr geom)
+{
+  // look for an existing hierarchy (nothing to reorder otherwise)
+  map<CollisionGeometryPtr, BVPtr>::iterator root_iter = _roots.find(geom);
+  if (root_iter == _roots.end())
+    return;
+
+  // pre-order traversal with the hottest child popped first: replacement
+  // nodes are then allocated in exactly the order a descending query
+  // visits them, putting hot subtrees contiguous in memory
+  stack<pair<BVPtr, BVPtr> > S;
+  BVPtr new_root;
+  S.push(make_pair(root_iter->second, BVPtr()));
+  while (!S.empty())
+  {
+    BVPtr node = S.top().first;
+    BVPtr parent = S.top().second;
+    S.pop();
+
+    // order the children hottest first before the node is (possibly) reused
+    vector<BVPtr> children(node->children.begin(), node->children.end());
+    std::sort(children.begin(), children.end(), bv_hotter);
+
+    // allocate the node's replacement and link it under its new parent
+    BVPtr repl = clone_BV_node(node);
+    repl->children.clear();
+    repl->visits = 0;
+    repl->init_cull_sphere();
+    if (parent)
+      parent->children.push_back(repl);
+    else
+      new_root = repl;
+
+    // move the per-node triangle and vertex records to the new key
+    if (repl != node)
+    {
+      map<BVPtr, list<unsigned> >::iterator mt = _mesh_tris.find(node);
+      if (mt != _mesh_tris.end())
+      {
+        _mesh_tris[repl].swap(mt->second);
+        _mesh_tris.erase(mt);
+      }
+      map<BVPtr, list<unsigned> >::iterator mv = _mesh_vertices.find(node);
+      if (mv != _mesh_vertices.end())
+      {
+        _mesh_vertices[repl].swap(mv->second);
+        _mesh_vertices.erase(mv);
+      }
+      map<BVPtr, list<shared_ptr<AThickTri> > >::iterator tt = _tris.find(node);
+      if (tt != _tris.end())
+      {
+        _tris[repl].swap(tt->second);
+        _tris.erase(tt);
+      }
+    }
+
+    // push the children coldest first so the hottest is expanded first
+    for (vector<BVPtr>::reverse_iterator ci = children.rbegin(); ci != children.rend(); ci++)
+      S.push(make_pair(*ci, repl));
+  }
+
+  // install the reordered hierarchy
+  root_iter->second = new_root;
+}
+
+/// Estimates the heap memory held by this primitive, in bytes
+/**
+ * Counts the mesh, the per-geometry BV hierarchies, and the per-node
+ * triangle/vertex records.  Estimates exclude allocator overhead and
+ * visualization data (see Primitive::calc_memory_usage()).
+ */
+unsigned long TriangleMeshPrimitive::calc_memory_usage() const
+{
+  // approximate per-element cost of a std::list node (payload plus links)
+  const unsigned long LIST_LINKS = 2*sizeof(void*);
+
+  unsigned long bytes = 0;
+
+  // mesh vertices and facets
+  if (_mesh)
+    bytes += _mesh->get_vertices().size()*sizeof(Origin3d) + _mesh->get_facets().size()*sizeof(IndexedTri);
+
+  // vertices with transform and subsampling applied
+  bytes += _vertices.size()*sizeof(Point3d);
+
+  // the BV hierarchies (one per geometry)
+  for (map<CollisionGeometryPtr, BVPtr>::const_iterator i = _roots.begin(); i != _roots.end(); i++)
+  {
+    stack<BVPtr> S;
+    S.push(i->second);
+    while (!S.empty())
+    {
+      BVPtr bv = S.top();
+      S.pop();
+      if (dynamic_pointer_cast<OBB>(bv))
+        bytes += sizeof(OBB);
+      else if (dynamic_pointer_cast<SSR>(bv))
+        bytes += sizeof(SSR);
+      else if (dynamic_pointer_cast<SSL>(bv))
+        bytes += sizeof(SSL);
+      else
+        bytes += sizeof(BoundingSphere);
+      BOOST_FOREACH(BVPtr child, bv->children)
+        S.push(child);
+    }
+  }
+
+  // per-node triangle and vertex index lists
+  for (map<BVPtr, list<unsigned> >::const_iterator i = _mesh_tris.begin(); i != _mesh_tris.end(); i++)
+    bytes += sizeof(*i) + i->second.size()*(sizeof(unsigned) + LIST_LINKS);
+  for (map<BVPtr, list<unsigned> >::const_iterator i = _mesh_vertices.begin(); i != _mesh_vertices.end(); i++)
+    bytes += sizeof(*i) + i->second.size()*(sizeof(unsigned) + LIST_LINKS);
+
+  // per-leaf thick triangles
+  for (map<BVPtr, list<shared_ptr<AThickTri> > >::const_iterator i = _tris.begin(); i != _tris.end(); i++)
+    bytes += sizeof(*i) + i->second.size()*(sizeof(AThickTri) + LIST_LINKS);
+
+  return bytes;
+}
+
 /// Returns whether the mesh is convex (currently mesh must be convex)
 bool TriangleMeshPrimitive::is_convex() const
 {
@@ -451,7 +743,176 @@ double TriangleMeshPrimitive::calc_signed_dist(const Point3d& p) const
   }
 }
 
-/// Computes the distance and normal from a point on the mesh 
+/// Computes the first intersection of a ray with a triangle (Moller-Trumbore)
+/**
+ * \param t on return, the distance along the ray to the triangle (if hit);
+ *        only intersections in [0, tmax] are reported
+ */
+static bool intersect_ray_tri(const Point3d& origin, const Vector3d& dir, const Triangle& tri, double tmax, double& t)
+{
+  Vector3d e1 = tri.b - tri.a;
+  Vector3d e2 = tri.c - tri.a;
+  Vector3d pv = Vector3d::cross(dir, e2);
+  double det = e1.dot(pv);
+
+  // a near-zero determinant indicates a ray parallel to the triangle plane
+  if (std::fabs(det) < NEAR_ZERO)
+    return false;
+  double inv_det = 1.0/det;
+
+  // compute and test the barycentric coordinates of the intersection
+  Vector3d tv = origin - tri.a;
+  double u = tv.dot(pv)*inv_det;
+  if (u < 0.0 || u > 1.0)
+    return false;
+  Vector3d qv = Vector3d::cross(tv, e1);
+  double v = dir.dot(qv)*inv_det;
+  if (v < 0.0 || u + v > 1.0)
+    return false;
+
+  // compute and test the ray parameter
+  double tcand = e2.dot(qv)*inv_det;
+  if (tcand < 0.0 || tcand > tmax)
+    return false;
+
+  t = tcand;
+  return true;
+}
+
+/// Casts a ray against the mesh using the bounding-volume hierarchy
+bool TriangleMeshPrimitive::ray_cast(const Point3d& origin, const Vector3d& dir, double max_dist, double& t, Vector3d& normal) const
+{
+  // cast through the packet entry point (packet of one)
+  ray_cast(&origin, &dir, 1, max_dist, &t, &normal);
+  return (t >= 0.0);
+}
+
+/// Casts a batch of rays against the mesh using packet BVH traversal
+/**
+ * Rays are traced through the bounding-volume hierarchy in packets of eight:
+ * each node of the hierarchy is fetched once per packet and pruned only when
+ * no ray in the packet can still reach it, which amortizes the tree walk
+ * over the packet (the common case for sensor simulation, where many nearly
+ * parallel rays traverse the same nodes).  All rays must be defined in the
+ * same pose; on return, t[i] holds the hit distance for ray i or a negative
+ * value on a miss.
+ */
+void TriangleMeshPrimitive::ray_cast(const Point3d* origins, const Vector3d* dirs, unsigned n, double max_dist, double* t, Vector3d* normals) const
+{
+  const unsigned PACKET_SIZE = 8;
+  const unsigned UINF = std::numeric_limits<unsigned>::max();
+
+  if (n == 0)
+    return;
+  assert(_poses.find(const_pointer_cast<Pose3d>(origins[0].pose)) != _poses.end());
+
+  // get the hierarchy for a geometry using this pose; the per-geometry
+  // hierarchies store identical mesh coordinates, so any matching root works
+  BVPtr root;
+  for (map<boost::weak_ptr<CollisionGeometry>, shared_ptr<Pose3d> >::const_iterator i = _cg_poses.begin(); i != _cg_poses.end(); i++)
+    if (!i->first.expired() && i->second == origins[0].pose)
+    {
+      root = ((TriangleMeshPrimitive*) this)->get_BVH_root(CollisionGeometryPtr(i->first));
+      break;
+    }
+
+  // without a hierarchy, fall back to casting rays individually
+  if (!root)
+  {
+    Primitive::ray_cast(origins, dirs, n, max_dist, t, normals);
+    return;
+  }
+
+  // the hierarchy stores mesh coordinates tagged with its own relative pose
+  shared_ptr<const Pose3d> bv_pose = root->get_relative_pose();
+
+  // process the rays in packets
+  for (unsigned start=0; start< n; start+= PACKET_SIZE)
+  {
+    const unsigned m = std::min(PACKET_SIZE, n - start);
+
+    // re-tag the packet rays into the hierarchy frame and init best hits
+    Point3d o[PACKET_SIZE];
+    Vector3d d[PACKET_SIZE];
+    double best[PACKET_SIZE];
+    unsigned best_tri[PACKET_SIZE];
+    for (unsigned i=0; i< m; i++)
+    {
+      o[i] = Point3d(Origin3d(origins[start+i]), bv_pose);
+      d[i] = Vector3d(Origin3d(dirs[start+i]), bv_pose);
+      best[i] = max_dist;
+      best_tri[i] = UINF;
+    }
+
+    // traverse the hierarchy with the whole packet at once
+    stack<BVPtr> S;
+    S.push(root);
+    while (!S.empty())
+    {
+      BVPtr bv = S.top();
+      S.pop();
+
+      // enter the node only if some ray in the packet can still hit it
+      bool enter = false;
+      for (unsigned i=0; i< m && !enter; i++)
+      {
+        double tmin = 0.0;
+        Point3d q;
+        LineSeg3 seg(o[i], o[i] + d[i]*best[i]);
+        if (bv->intersects(seg, tmin, 1.0, q))
+          enter = true;
+      }
+      if (!enter)
+        continue;
+
+      // record the visit for profile-guided layout optimization
+      bv->visits++;
+
+      // descend into internal nodes
+      if (!bv->is_leaf())
+      {
+        BOOST_FOREACH(BVPtr child, bv->children)
+          S.push(child);
+        continue;
+      }
+
+      // test the whole packet against each leaf triangle
+      const list<unsigned>& tris = _mesh_tris.find(bv)->second;
+      BOOST_FOREACH(unsigned tri_idx, tris)
+      {
+        Triangle tri = _mesh->get_triangle(tri_idx, bv_pose);
+        for (unsigned i=0; i< m; i++)
+        {
+          double tcand;
+          if (intersect_ray_tri(o[i], d[i], tri, best[i], tcand))
+          {
+            best[i] = tcand;
+            best_tri[i] = tri_idx;
+          }
+        }
+      }
+    }
+
+    // record the packet results
+    for (unsigned i=0; i< m; i++)
+    {
+      if (best_tri[i] == UINF)
+      {
+        t[start+i] = -1.0;
+        continue;
+      }
+      t[start+i] = best[i];
+
+      // get the hit triangle's normal, oriented against the ray
+      Vector3d nrm = _mesh->get_triangle(best_tri[i], origins[0].pose).calc_normal();
+      if (nrm.dot(dirs[start+i]) > 0.0)
+        nrm = -nrm;
+      normals[start+i] = nrm;
+    }
+  }
+}
+
+/// Computes the distance and normal from a point on the mesh
 double TriangleMeshPrimitive::calc_dist_and_normal(const Point3d& p, std::vector<Vector3d>& normals) const
 {
   // setup the normal
@@ -759,28 +1220,208 @@ void TriangleMeshPrimitive::set_pose(const Pose3d& p)
   // go ahead and set the new transform
   Primitive::set_pose(p);
 
-  // reset mesh, vertices, and bounding volumes 
+  // if refitting is enabled and hierarchies exist, rigidly transform the mesh
+  // and refit the existing trees in place rather than rebuilding them
+  if (_refit_enabled && _mesh && !_roots.empty())
+  {
+    // transform the mesh
+    _mesh = shared_ptr<const IndexedTriArray>(new IndexedTriArray(_mesh->transform(T)));
+
+    // transformed vertices are stale
+    _vertices.clear();
+
+    // refit each geometry's hierarchy
+    for (map<CollisionGeometryPtr, BVPtr>::const_iterator i = _roots.begin(); i != _roots.end(); i++)
+      refit_BB_tree(i->first, T);
+
+    // recalculate the mass properties
+    calc_mass_properties();
+    return;
+  }
+
+  // reset mesh, vertices, and bounding volumes
   _mesh.reset();
   _vertices.clear();
   _mesh_vertices.clear();
   _roots.clear();
+  _build_volumes.clear();
+  _needs_rebuild.clear();
 
   // recalculate the mass properties
   calc_mass_properties();
 }
 
+/// Refits an existing bounding volume hierarchy after a rigid transformation
+/**
+ * Transforms every node of the hierarchy in place and regenerates the thick
+ * triangles cached at the leaves -- a single linear pass over the tree,
+ * rather than re-running the top-down splitting in build_BB_tree(). The
+ * refit is exact for rigid motion; as a guard against fit degradation from
+ * accumulated incremental transforms (or future non-rigid updates), the root
+ * volume is compared against the volume recorded when the tree was built,
+ * and if it has grown past the fatness tolerance the geometry is marked for
+ * a lazy rebuild on the next call to get_BVH_root().
+ */
+void TriangleMeshPrimitive::refit_BB_tree(CollisionGeometryPtr geom, const Transform3d& T)
+{
+  // look for nothing to refit
+  BVPtr root = _roots[geom];
+  if (!root)
+    return;
+
+  // process every node in the hierarchy
+  queue<BVPtr> Q;
+  Q.push(root);
+  while (!Q.empty())
+  {
+    // get the node off of the front of the queue
+    BVPtr bv = Q.front();
+    Q.pop();
+
+    // transform the node in place, copying the result back through the
+    // node's dynamic type
+    if (OBBPtr obb = dynamic_pointer_cast<OBB>(bv))
+    {
+      OBB xformed;
+      obb->transform(T, &xformed);
+      obb->center = xformed.center;
+      obb->R = xformed.R;
+      obb->l = xformed.l;
+    }
+    else if (shared_ptr<SSR> ssr = dynamic_pointer_cast<SSR>(bv))
+    {
+      SSR xformed;
+      ssr->transform(T, &xformed);
+      ssr->center = xformed.center;
+      ssr->R = xformed.R;
+      ssr->l = xformed.l;
+      ssr->radius = xformed.radius;
+    }
+    else
+    {
+      shared_ptr<SSL> ssl = dynamic_pointer_cast<SSL>(bv);
+      assert(ssl);
+      SSL xformed;
+      ssl->transform(T, &xformed);
+      ssl->p1 = xformed.p1;
+      ssl->p2 = xformed.p2;
+      ssl->radius = xformed.radius;
+    }
+
+    // the node moved; refresh its single-precision culling mirror
+    bv->init_cull_sphere();
+
+    // regenerate the thick triangles cached at the leaves
+    map<BVPtr, list<shared_ptr<AThickTri> > >::iterator ti = _tris.find(bv);
+    if (ti != _tris.end())
+    {
+      assert(_mesh_tris.find(bv) != _mesh_tris.end());
+      const list<unsigned>& tlist = _mesh_tris.find(bv)->second;
+      ti->second.clear();
+      BOOST_FOREACH(unsigned idx, tlist)
+      {
+        try
+        {
+          ti->second.push_back(shared_ptr<AThickTri>(new AThickTri(_mesh->get_triangle(idx, get_pose()), 0.0)));
+          ti->second.back()->mesh = _mesh;
+          ti->second.back()->tri_idx = idx;
+        }
+        catch (NumericalException e)
+        {
+          // we won't do anything...  we just won't add the triangle
+        }
+      }
+    }
+
+    // add children of the node to the queue
+    BOOST_FOREACH(BVPtr child, bv->children)
+      Q.push(child);
+  }
+
+  // if the fit has degraded past the tolerance, mark the geometry so that
+  // get_BVH_root() rebuilds the hierarchy on its next query
+  map<CollisionGeometryPtr, double>::const_iterator vi = _build_volumes.find(geom);
+  if (vi != _build_volumes.end() && root->calc_volume() > vi->second * _refit_fatness_tol)
+    _needs_rebuild.insert(geom);
+}
+
 /****************************************************************************
  Methods for building bounding box trees begin 
 ****************************************************************************/
 
-/// Builds an bounding volume tree (OBB or BoundingSphere) from an indexed triangle mesh using a top-down approach 
+/// Fits a bounding volume of the selected type around a set of points
+BVPtr TriangleMeshPrimitive::fit_BV(const vector<Point3d>& points) const
+{
+  switch (_bv_tree_type)
+  {
+    case eSSRTree:
+      return BVPtr(new SSR(points.begin(), points.end()));
+
+    case eSSLTree:
+    {
+      // there is no direct SSL fitting routine, so derive the segment from
+      // an OBB fit: the line runs along the longest box axis and the radius
+      // covers the box cross-section
+      OBB obb(points.begin(), points.end());
+      unsigned imax = 0;
+      if (obb.l[1] > obb.l[imax]) imax = 1;
+      if (obb.l[2] > obb.l[imax]) imax = 2;
+      unsigned imid = (imax+1)%3, imin = (imax+2)%3;
+      Vector3d axis(obb.center.pose);
+      obb.R.get_column(imax, axis);
+      double radius = std::sqrt(obb.l[imid]*obb.l[imid] + obb.l[imin]*obb.l[imin]);
+      return BVPtr(new SSL(obb.center - axis*obb.l[imax], obb.center + axis*obb.l[imax], radius));
+    }
+
+    default:
+      assert(_bv_tree_type == eOBBTree);
+      return BVPtr(new OBB(points.begin(), points.end()));
+  }
+}
+
+/// Gets candidate splitting axes from a bounding volume of the selected type
+void TriangleMeshPrimitive::get_split_axes(BVPtr bv, Vector3d axes[3]) const
+{
+  // the oriented types provide their frame directly
+  if (OBBPtr obb = dynamic_pointer_cast<OBB>(bv))
+  {
+    for (unsigned i=0; i< 3; i++)
+    {
+      axes[i] = Vector3d(bv->get_relative_pose());
+      obb->R.get_column(i, axes[i]);
+    }
+    return;
+  }
+  if (shared_ptr<SSR> ssr = dynamic_pointer_cast<SSR>(bv))
+  {
+    for (unsigned i=0; i< 3; i++)
+    {
+      axes[i] = Vector3d(bv->get_relative_pose());
+      ssr->R.get_column(i, axes[i]);
+    }
+    return;
+  }
+
+  // for a SSL, split along the segment direction first, then along any two
+  // perpendicular directions
+  shared_ptr<SSL> ssl = dynamic_pointer_cast<SSL>(bv);
+  assert(ssl);
+  Vector3d dir = ssl->p2 - ssl->p1;
+  double dir_len = dir.norm();
+  if (dir_len > NEAR_ZERO)
+    axes[0] = dir/dir_len;
+  else
+    axes[0] = Vector3d(1.0, 0.0, 0.0, ssl->p1.pose);
+  Vector3d::determine_orthonormal_basis(axes[0], axes[1], axes[2]);
+}
+
+/// Builds an bounding volume tree (OBB, SSR, or SSL) from an indexed triangle mesh using a top-down approach
 /*
  * \return the root of the bounding box tree
  */
 void TriangleMeshPrimitive::build_BB_tree(CollisionGeometryPtr geom)
 {
   const unsigned THREE_D = 3;
-  BVPtr child1, child2;
 
   FILE_LOG(LOG_BV) << "TriangleMeshPrimitive::build_BB_tree() entered" << endl;
 
@@ -815,8 +1456,8 @@ void TriangleMeshPrimitive::build_BB_tree(CollisionGeometryPtr geom)
   for (unsigned i=0; i< verts.size(); i++)
     vertices[i] = Point3d(verts[i], GLOBAL);
 
-  // build an BV around all vertices 
-  BVPtr root = BVPtr(new OBB(vertices.begin(), vertices.end()));
+  // build an BV of the selected type around all vertices
+  BVPtr root = fit_BV(vertices);
 
   // point the root to the geometry
   root->geom = geom;
@@ -831,95 +1472,113 @@ void TriangleMeshPrimitive::build_BB_tree(CollisionGeometryPtr geom)
 
   FILE_LOG(LOG_BV) << "  -- created root: " << root << endl;
 
-  // add the root to a splitting queue
-  queue<BVPtr> Q;
-  Q.push(root);
-
-  // split until we can't split further
-  while (!Q.empty())
+  // split until we can't split further, one tree level at a time: splits of
+  // distinct nodes are independent, so each level's frontier is dispatched
+  // over threads (dynamic scheduling load balances lopsided splits) with
+  // per-node result slots, and the shared BV-to-mesh maps are updated
+  // serially between levels. OBB fitting runs qhull, so the loop is only
+  // parallelized when concurrent qhull use cannot race (per-thread contexts
+  // or the serializing mutex; cf. CompGeom::calc_convex_hulls())
+  vector<BVPtr> frontier;
+  frontier.push_back(root);
+  while (!frontier.empty())
   {
-    // get the bounding box off of the top of the queue
-    BVPtr bb = Q.front();
-    Q.pop();
-
-    FILE_LOG(LOG_BV) << "  -- splitting BV: " << bb << endl;
-
-    // split the bounding box across each of the three axes
-    for (unsigned i=0; i< 3; i++)
+    // per-node split results, filled by the (possibly parallel) loop
+    const unsigned NF = frontier.size();
+    vector<BVPtr> c1(NF), c2(NF);
+    vector<list<unsigned> > c1tris(NF), c2tris(NF);
+    vector<list<shared_ptr<AThickTri> > > c1ttris(NF), c2ttris(NF);
+
+    #if defined(_OPENMP) && (defined(THREADSAFE) || defined(MOBY_QHULL_REENTRANT))
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (int k=0; k< (int) NF; k++)
     {
-      Vector3d axis(GLOBAL);
-
-      // get the i'th column of R
-      OBBPtr obb = dynamic_pointer_cast<OBB>(bb);
-      assert(obb);
-      obb->R.get_column(i, axis);
-
-      // split the bounding box across the axis
-      if (split(_mesh, bb, child1, child2, axis))
-        break;
-    }
-
-    // make sure that this BV was divisible
-    if (!child1)
-      continue;
-
-    // child was divisible; remove thick triangles
-    _tris.erase(bb);
+      BVPtr bb = frontier[k];
 
-    // setup child pointers
-    bb->children.push_back(child1);
-    bb->children.push_back(child2);
+      // get the triangles covered by this node (read-only: the maps are
+      // only modified in the serial merge below)
+      assert(_mesh_tris.find(bb) != _mesh_tris.end());
+      const list<unsigned>& btris = _mesh_tris.find(bb)->second;
 
-    // get lists of triangles for children
-    assert(_mesh_tris.find(child1) != _mesh_tris.end());
-    assert(_mesh_tris.find(child2) != _mesh_tris.end());
-    const std::list<unsigned>& c1tris = _mesh_tris.find(child1)->second;
-    const std::list<unsigned>& c2tris = _mesh_tris.find(child2)->second;
+      // get candidate splitting axes from the node's volume
+      Vector3d axes[3];
+      get_split_axes(bb, axes);
 
-    // create thick triangles for child1
-    list<shared_ptr<AThickTri> >& ttris1 = _tris[child1];
-    BOOST_FOREACH(unsigned idx, c1tris)
-    {
-      try
+      // split the bounding box across each of the three axes
+      BVPtr child1, child2;
+      for (unsigned i=0; i< 3; i++)
       {
-        ttris1.push_back(shared_ptr<AThickTri>(new AThickTri(_mesh->get_triangle(idx, get_pose()), 0.0)));
-        ttris1.back()->mesh = _mesh;
-        ttris1.back()->tri_idx = idx;
+        // split the bounding box across the axis
+        if (split(_mesh, bb, btris, child1, child2, c1tris[k], c2tris[k], axes[i]))
+          break;
       }
-      catch (NumericalException e)
+
+      // make sure that this BV was divisible
+      if (!child1)
+        continue;
+      c1[k] = child1;
+      c2[k] = child2;
+
+      // create thick triangles for both children
+      for (unsigned m=0; m< 2; m++)
       {
-        // we won't do anything...  we just won't add the triangle
+        const list<unsigned>& ctris = (m == 0) ? c1tris[k] : c2tris[k];
+        list<shared_ptr<AThickTri> >& ttris = (m == 0) ? c1ttris[k] : c2ttris[k];
+        BOOST_FOREACH(unsigned idx, ctris)
+        {
+          try
+          {
+            ttris.push_back(shared_ptr<AThickTri>(new AThickTri(_mesh->get_triangle(idx, get_pose()), 0.0)));
+            ttris.back()->mesh = _mesh;
+            ttris.back()->tri_idx = idx;
+          }
+          catch (NumericalException e)
+          {
+            // we won't do anything...  we just won't add the triangle
+          }
+        }
       }
     }
-    
-    // create thick triangles for child2
-    list<shared_ptr<AThickTri> >& ttris2 = _tris[child2];
-    BOOST_FOREACH(unsigned idx, c2tris)
+
+    // merge the results into the shared maps and build the next frontier
+    vector<BVPtr> next;
+    for (unsigned k=0; k< NF; k++)
     {
-      try
-      {
-        ttris2.push_back(shared_ptr<AThickTri>(new AThickTri(_mesh->get_triangle(idx, get_pose()), 0.0)));
-        ttris2.back()->mesh = _mesh;
-        ttris2.back()->tri_idx = idx;
-      }
-      catch (NumericalException e)
-      {
-        // we won't do anything...  we just won't add the triangle
-      }
+      // skip indivisible nodes
+      if (!c1[k])
+        continue;
+      BVPtr bb = frontier[k];
+
+      // node was divisible; remove its thick triangles
+      _tris.erase(bb);
+
+      // setup child pointers
+      bb->children.push_back(c1[k]);
+      bb->children.push_back(c2[k]);
+
+      // record the children's triangle and thick-triangle lists (swaps, to
+      // avoid copying the per-node results)
+      _mesh_tris[c1[k]].swap(c1tris[k]);
+      _mesh_tris[c2[k]].swap(c2tris[k]);
+      _tris[c1[k]].swap(c1ttris[k]);
+      _tris[c2[k]].swap(c2ttris[k]);
+
+      // add children to the next frontier if they have more than one tri
+      if (_mesh_tris[c1[k]].size() > 1)
+        next.push_back(c1[k]);
+      if (_mesh_tris[c2[k]].size() > 1)
+        next.push_back(c2[k]);
+
+      FILE_LOG(LOG_BV) << "  -- built children " << c1[k] << ", " << c2[k] << " from " << bb << endl;
+      FILE_LOG(LOG_BV) << "  -- ID: " << c1[k] << endl;
+      FILE_LOG(LOG_BV) << "  -- ID: " << c2[k] << endl;
     }
-
-    // add children to the queue for processing if they have more than one tri
-    if (c1tris.size() > 1)
-      Q.push(child1);
-    if (c2tris.size() > 1)
-      Q.push(child2);
-
-    FILE_LOG(LOG_BV) << "  -- built children " << child1 << ", " << child2 << " from " << bb << endl;
-    FILE_LOG(LOG_BV) << "  -- ID: " << child1 << endl;
-    FILE_LOG(LOG_BV) << "  -- ID: " << child2 << endl;
+    frontier.swap(next);
   }
 
   // now, collapse the tree
+  queue<BVPtr> Q;
   Q.push(root);
   while (!Q.empty())
   {
@@ -959,11 +1618,6 @@ void TriangleMeshPrimitive::build_BB_tree(CollisionGeometryPtr geom)
     BVPtr bb = Q.front();
     Q.pop();
 
-    // fatten the bounding volume
-    // cast it to an OBB
-    OBBPtr obb = dynamic_pointer_cast<OBB>(bb);
-    assert(obb);
-
     // add all children to the queue
     if (!bb->is_leaf())
     {
@@ -971,12 +1625,15 @@ void TriangleMeshPrimitive::build_BB_tree(CollisionGeometryPtr geom)
         Q.push(child);
     }
 
-    // wipe out userdata
+    // wipe out userdata and setup the single-precision culling mirror --
+    // the hierarchy is fixed from here on (a refit rebuilds it wholesale)
     bb->userdata = shared_ptr<void>();
+    bb->init_cull_sphere();
   }
 
-  // save the root
+  // save the root and its as-built volume (for the refit fatness test)
   geom_root = root;
+  _build_volumes[geom] = root->calc_volume();
 
   // output how many triangles are in each bounding box
   if (LOGGING(LOG_BV))
@@ -1116,30 +1773,31 @@ void TriangleMeshPrimitive::split_tris(const Point3d& point, const Vector3d& nor
 }
 
 /// Splits a bounding box  along a given axis into two new bounding boxes; returns true if split successful
-bool TriangleMeshPrimitive::split(shared_ptr<const IndexedTriArray> mesh, shared_ptr<BV> source, shared_ptr<BV>& tgt1, shared_ptr<BV>& tgt2, const Vector3d& axis) 
+/**
+ * Pure with respect to the shared BV-to-mesh maps: the source's triangle
+ * list is passed in and the children's lists are returned through \p ptris
+ * and \p ntris, so concurrent splits of independent nodes (see
+ * build_BB_tree()) do not race on this primitive's state.
+ */
+bool TriangleMeshPrimitive::split(shared_ptr<const IndexedTriArray> mesh, shared_ptr<BV> source, const list<unsigned>& stris, shared_ptr<BV>& tgt1, shared_ptr<BV>& tgt2, list<unsigned>& ptris, list<unsigned>& ntris, const Vector3d& axis) const
 {
-  // setup two lists of triangles
-  list<unsigned> ptris, ntris;
-
-  // clear both targets
+  // clear both targets and triangle lists
   tgt1 = shared_ptr<BV>();
   tgt2 = shared_ptr<BV>();
-
-  // get the mesh and the list of triangles
-  assert(_mesh_tris.find(source) != _mesh_tris.end());
-  const list<unsigned>& tris = _mesh_tris.find(source)->second;
+  ptris.clear();
+  ntris.clear();
 
   // make sure that not trying to split a single triangle
-  assert(tris.size() > 1); 
+  assert(stris.size() > 1);
 
   // determine the centroid of this set of triangles
   list<Triangle> t_tris;
-  BOOST_FOREACH(unsigned idx, tris)
-    t_tris.push_back(mesh->get_triangle(idx, source->get_relative_pose())); 
+  BOOST_FOREACH(unsigned idx, stris)
+    t_tris.push_back(mesh->get_triangle(idx, source->get_relative_pose()));
   Point3d centroid = CompGeom::calc_centroid_3D(t_tris.begin(), t_tris.end());
 
   // get the side of the splitting plane of the triangles
-  split_tris(centroid, axis, *mesh, tris, ptris, ntris);
+  split_tris(centroid, axis, *mesh, stris, ptris, ntris);
   if (ptris.empty() || ntris.empty())
     return false;
 
@@ -1148,18 +1806,14 @@ bool TriangleMeshPrimitive::split(shared_ptr<const IndexedTriArray> mesh, shared
   get_vertices(*mesh, ptris.begin(), ptris.end(), std::back_inserter(pverts), centroid.pose);
   get_vertices(*mesh, ntris.begin(), ntris.end(), std::back_inserter(nverts), centroid.pose);
 
-  // create two new BVs 
-  tgt1 = OBBPtr(new OBB(pverts.begin(), pverts.end()));
-  tgt2 = OBBPtr(new OBB(nverts.begin(), nverts.end()));
+  // create two new BVs of the selected type
+  tgt1 = fit_BV(pverts);
+  tgt2 = fit_BV(nverts);
 
   // setup geometry pointers
   tgt1->geom = source->geom;
   tgt2->geom = source->geom;
 
-  // setup mesh data for the BVs
-  _mesh_tris[tgt1] = ptris;
-  _mesh_tris[tgt2] = ntris;
-
   return true;
 }
 
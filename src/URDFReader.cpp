@@ -8,6 +8,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <stack>
@@ -26,6 +27,7 @@
 #include <Moby/ConePrimitive.h>
 */
 #include <Moby/CylinderPrimitive.h>
+#include <Moby/CapsulePrimitive.h>
 #include <Ravelin/AAngled.h>
 #include <Moby/Primitive.h>
 #include <Moby/IndexedTetraArray.h>
@@ -150,6 +152,7 @@ bool URDFReader::read_robot(shared_ptr<const XMLTree> node, URDFData& data, stri
     name = name_attrib->get_string_value();
     read_links(node, data, links);
     read_joints(node, data, links, joints);
+    compile_model(data, links, joints);
   }
   else
   {
@@ -163,16 +166,16 @@ bool URDFReader::read_robot(shared_ptr<const XMLTree> node, URDFData& data, stri
 /// Reads robot links
 void URDFReader::read_links(shared_ptr<const XMLTree> node, URDFData& data, vector<RigidBodyPtr>& links)
 {
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
     read_link(*i, data, links);
 }
 
 /// Reads robot joints 
 void URDFReader::read_joints(shared_ptr<const XMLTree> node, URDFData& data, const vector<RigidBodyPtr>& links, vector<JointPtr>& joints)
 {
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
     read_joint(*i, data, links, joints);
 }
 
@@ -295,6 +298,151 @@ void URDFReader::output_data(const URDFData& data, RigidBodyPtr link)
   #endif
 }
 
+/// Gets the block index a joint sorts into when joints are packed by type
+unsigned URDFReader::joint_type_block(JointPtr joint)
+{
+  if (dynamic_pointer_cast<RevoluteJoint>(joint))
+    return 0;
+  if (dynamic_pointer_cast<PrismaticJoint>(joint))
+    return 1;
+  if (dynamic_pointer_cast<SphericalJoint>(joint))
+    return 2;
+  if (dynamic_pointer_cast<UniversalJoint>(joint))
+    return 3;
+  if (dynamic_pointer_cast<FixedJoint>(joint))
+    return 4;
+  return 5;
+}
+
+/// Compiles the loaded model into a dynamics-friendly layout
+/**
+ * URDF files list links and joints in authoring order, which generally bears
+ * no relation to the order the dynamics sweeps visit them. This pass
+ * (1) merges fixed-joint children into their parent links where the merge is
+ * lossless, removing the extra links from the recursive sweeps entirely,
+ * (2) renumbers the remaining links depth-first from the base so that
+ * consecutively processed links were allocated and are indexed near each
+ * other, and (3) packs the joints contiguous by concrete type so the sweeps
+ * dispatch each joint type in runs rather than interleaved. The model is
+ * unchanged mechanically; if the link/joint graph is not a rooted tree
+ * (multiple bases, disconnected links), the authoring order is kept.
+ */
+void URDFReader::compile_model(URDFData& data, vector<RigidBodyPtr>& links, vector<JointPtr>& joints)
+{
+  // merge fixed-joint children into their parents
+  for (unsigned i=0; i< joints.size(); )
+  {
+    shared_ptr<FixedJoint> fj = dynamic_pointer_cast<FixedJoint>(joints[i]);
+    if (!fj)
+    {
+      i++;
+      continue;
+    }
+    RigidBodyPtr parent = data.joint_parent.find(joints[i])->second;
+    RigidBodyPtr child = data.joint_child.find(joints[i])->second;
+
+    // the merge reattaches the child's collision geometry but not its
+    // visualization subtree; keep children with visuals as separate links
+    // rather than lose their visuals
+    if (data.visual_transform_nodes.find(child) != data.visual_transform_nodes.end())
+    {
+      i++;
+      continue;
+    }
+
+    // fold the child's inertia into the parent, expressed at the parent's
+    // link frame (children disabled for bad inertial data contribute none)
+    if (child->is_enabled())
+    {
+      SpatialRBInertiad J = Pose3d::transform(parent->get_pose(), parent->get_inertia());
+      J += Pose3d::transform(parent->get_pose(), child->get_inertia());
+      parent->set_inertia(J);
+    }
+
+    // reattach the child's collision geometries to the parent, preserving
+    // their absolute poses
+    for (list<CollisionGeometryPtr>::const_iterator g = child->geometries.begin(); g != child->geometries.end(); g++)
+    {
+      Pose3d P = *(*g)->get_pose();
+      P.update_relative_pose(parent->get_pose());
+      (*g)->set_single_body(parent);
+      (*g)->set_relative_pose(P);
+      parent->geometries.push_back(*g);
+    }
+
+    // rebase joints hanging off the child onto the parent
+    for (map<JointPtr, RigidBodyPtr>::iterator j = data.joint_parent.begin(); j != data.joint_parent.end(); j++)
+      if (j->second == child && j->first != joints[i])
+      {
+        j->first->set_inboard_link(parent, true);
+        j->second = parent;
+      }
+
+    // remove the fixed joint and the merged child from the model
+    data.joint_parent.erase(joints[i]);
+    data.joint_child.erase(joints[i]);
+    links.erase(std::find(links.begin(), links.end(), child));
+    joints.erase(joints.begin()+i);
+  }
+
+  // find the base: the one link that is not the child of any joint
+  RigidBodyPtr base;
+  for (unsigned i=0; i< links.size(); i++)
+  {
+    bool is_child = false;
+    for (map<JointPtr, RigidBodyPtr>::const_iterator j = data.joint_child.begin(); j != data.joint_child.end(); j++)
+      if (j->second == links[i])
+      {
+        is_child = true;
+        break;
+      }
+    if (!is_child)
+    {
+      if (base)
+        return;
+      base = links[i];
+    }
+  }
+  if (!base)
+    return;
+
+  // renumber the links depth-first from the base, collecting each link's
+  // inner joint in discovery order
+  vector<RigidBodyPtr> dfs_links;
+  vector<JointPtr> dfs_joints;
+  map<RigidBodyPtr, RigidBodyPtr> parents;
+  std::stack<RigidBodyPtr> s;
+  s.push(base);
+  while (!s.empty())
+  {
+    RigidBodyPtr link = s.top();
+    s.pop();
+    dfs_links.push_back(link);
+    JointPtr inner = find_joint(data, link);
+    if (inner)
+      dfs_joints.push_back(inner);
+    vector<pair<JointPtr, RigidBodyPtr> > outboards;
+    find_outboards(data, link, outboards, parents);
+    for (unsigned i=outboards.size(); i> 0; i--)
+      s.push(outboards[i-1].second);
+  }
+
+  // a link visited twice or never indicates a graph the sweeps cannot
+  // traverse as a tree; keep the authoring order
+  if (dfs_links.size() != links.size() || dfs_joints.size() != joints.size())
+    return;
+  links = dfs_links;
+
+  // pack the joints contiguous by concrete type (revolute, prismatic,
+  // spherical, universal, fixed, then everything else), keeping the
+  // depth-first order within each block
+  joints.clear();
+  for (unsigned block = 0; block <= 5; block++)
+    for (unsigned i=0; i< dfs_joints.size(); i++)
+      if (joint_type_block(dfs_joints[i]) == block)
+        joints.push_back(dfs_joints[i]);
+}
+
 /// Attempts to read a robot joint from the given node
 void URDFReader::read_joint(shared_ptr<const XMLTree> node, URDFData& data, const vector<RigidBodyPtr>& links, vector<JointPtr>& joints)
 {
@@ -406,8 +554,8 @@ void URDFReader::read_joint(shared_ptr<const XMLTree> node, URDFData& data, cons
 RigidBodyPtr URDFReader::read_parent(shared_ptr<const XMLTree> node, URDFData& data, const vector<RigidBodyPtr>& links)
 {
   // look for the tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "parent") == 0)
     {
@@ -431,8 +579,8 @@ RigidBodyPtr URDFReader::read_parent(shared_ptr<const XMLTree> node, URDFData& d
 RigidBodyPtr URDFReader::read_child(shared_ptr<const XMLTree> node, URDFData& data, const vector<RigidBodyPtr>& links)
 {
   // look for the tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "child") == 0)
     {
@@ -459,8 +607,8 @@ void URDFReader::read_axis(shared_ptr<const XMLTree> node, URDFData& data, Joint
   bool axis_specified = false;
 
   // look for the axis tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "axis") == 0)
     {
@@ -499,8 +647,8 @@ void URDFReader::read_axis(shared_ptr<const XMLTree> node, URDFData& data, Joint
 void URDFReader::read_dynamics(shared_ptr<const XMLTree> node, URDFData& data, JointPtr joint)
 {
   // look for the dynamics tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "dynamics") == 0)
     {
@@ -532,8 +680,8 @@ void URDFReader::read_dynamics(shared_ptr<const XMLTree> node, URDFData& data, J
 void URDFReader::read_limits(shared_ptr<const XMLTree> node, URDFData& data, JointPtr joint)
 {
   // look for the limit tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "limit") == 0)
     {
@@ -569,8 +717,8 @@ void URDFReader::read_limits(shared_ptr<const XMLTree> node, URDFData& data, Joi
 void URDFReader::read_calibration(shared_ptr<const XMLTree> node, URDFData& data, JointPtr joint)
 {
   // look for the safety_controller tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "calibration") == 0)
     {
@@ -584,8 +732,8 @@ void URDFReader::read_calibration(shared_ptr<const XMLTree> node, URDFData& data
 void URDFReader::read_safety_controller(shared_ptr<const XMLTree> node, URDFData& data, JointPtr joint)
 {
   // look for the safety_controller tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "safety_controller") == 0)
     {
@@ -602,8 +750,8 @@ void URDFReader::read_inertial(shared_ptr<const XMLTree> node, URDFData& data, R
   LinAlgd LA;
 
   // look for the inertial tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "inertial") == 0)
     {
@@ -637,8 +785,8 @@ void URDFReader::read_inertial(shared_ptr<const XMLTree> node, URDFData& data, R
 /// Attempts to read an RGBA color
 bool URDFReader::read_color(shared_ptr<const XMLTree> node, URDFData& data, VectorNd& color)
 {
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "color") == 0)
     {
@@ -661,8 +809,8 @@ bool URDFReader::read_color(shared_ptr<const XMLTree> node, URDFData& data, Vect
 /// Attempts to read a texture filename
 bool URDFReader::read_texture(shared_ptr<const XMLTree> node, URDFData& data, string& texture_fname)
 {
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "texture") == 0)
     {
@@ -687,8 +835,8 @@ void URDFReader::read_material(shared_ptr<const XMLTree> node, URDFData& data, v
   #ifdef USE_OSG
   osg::Node* n = (osg::Node*) osg_node;
 
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "material") == 0)
     {
@@ -744,8 +892,8 @@ void URDFReader::read_visual(shared_ptr<const XMLTree> node, URDFData& data, Rig
   string texture_fname;
 
   // look for the visual tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "visual") == 0)
     {
@@ -781,8 +929,8 @@ void URDFReader::read_visual(shared_ptr<const XMLTree> node, URDFData& data, Rig
 void URDFReader::read_collision(shared_ptr<const XMLTree> node, URDFData& data, RigidBodyPtr link)
 {
   // look for the collision tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "collision") == 0)
     {
@@ -815,14 +963,16 @@ PrimitivePtr URDFReader::read_primitive(shared_ptr<const XMLTree> node, URDFData
   PrimitivePtr primitive;
 
   // look for the geometry tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "geometry") == 0)
     {
-      // read geometry 
+      // read geometry
       if ((primitive = read_box(*i, data)))
         return primitive;
+      else if ((primitive = read_capsule(*i, data)))
+        return primitive;
       else if ((primitive = read_cylinder(*i, data)))
         return primitive;
       else if ((primitive = read_sphere(*i, data)))
@@ -841,8 +991,8 @@ shared_ptr<BoxPrimitive> URDFReader::read_box(shared_ptr<const XMLTree> node, UR
   const unsigned X = 0, Y = 1, Z = 2;
 
   // look for the geometry tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "box") == 0)
     {
@@ -865,8 +1015,8 @@ shared_ptr<BoxPrimitive> URDFReader::read_box(shared_ptr<const XMLTree> node, UR
 shared_ptr<TriangleMeshPrimitive> URDFReader::read_trimesh(shared_ptr<const XMLTree> node, URDFData& data)
 {
   // look for the geometry tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "mesh") == 0)
     {
@@ -892,8 +1042,8 @@ shared_ptr<TriangleMeshPrimitive> URDFReader::read_trimesh(shared_ptr<const XMLT
 shared_ptr<CylinderPrimitive> URDFReader::read_cylinder(shared_ptr<const XMLTree> node, URDFData& data)
 {
   // look for the geometry tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "cylinder") == 0)
     {
@@ -916,12 +1066,40 @@ shared_ptr<CylinderPrimitive> URDFReader::read_cylinder(shared_ptr<const XMLTree
   return shared_ptr<CylinderPrimitive>();
 }
 
+/// Reads a capsule primitive
+shared_ptr<CapsulePrimitive> URDFReader::read_capsule(shared_ptr<const XMLTree> node, URDFData& data)
+{
+  // look for the geometry tag
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  {
+    if (strcasecmp((*i)->name.c_str(), "capsule") == 0)
+    {
+      XMLAttrib* radius_attrib = (*i)->get_attrib("radius");
+      XMLAttrib* length_attrib = (*i)->get_attrib("length");
+      if (!radius_attrib || !length_attrib)
+        continue;
+
+      // capsule must be rotated around x axis
+      Matrix3d rx90 = Matrix3d::rot_X(M_PI_2);
+      Pose3d T(rx90, Origin3d::zero());
+
+      // construct the capsule
+      double radius = radius_attrib->get_real_value();
+      double length = length_attrib->get_real_value();
+      return shared_ptr<CapsulePrimitive>(new CapsulePrimitive(radius, length, T));
+    }
+  }
+
+  return shared_ptr<CapsulePrimitive>();
+}
+
 /// Reads a sphere primitive
 shared_ptr<SpherePrimitive> URDFReader::read_sphere(shared_ptr<const XMLTree> node, URDFData& data)
 {
   // look for the geometry tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "sphere") == 0)
     {
@@ -946,8 +1124,8 @@ Pose3d URDFReader::read_origin(shared_ptr<const XMLTree> node, URDFData& data)
   Vector3d rpy;
 
   // look for the tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "origin") == 0)
     {
@@ -975,8 +1153,8 @@ Pose3d URDFReader::read_origin(shared_ptr<const XMLTree> node, URDFData& data)
 double URDFReader::read_mass(shared_ptr<const XMLTree> node, URDFData& data)
 {
   // look for the tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "mass") == 0)
     {
@@ -1002,8 +1180,8 @@ Matrix3d URDFReader::read_inertia(shared_ptr<const XMLTree> node, URDFData& data
   Matrix3d J = Matrix3d::zero();
 
   // look for the tag
-  const list<XMLTreePtr>& child_nodes = node->children;
-  for (list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+  const vector<XMLTreePtr>& child_nodes = node->children;
+  for (vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
   {
     if (strcasecmp((*i)->name.c_str(), "inertia") == 0)
     {
@@ -21,11 +21,13 @@
 #endif
 
 #include <Moby/Constants.h>
+#include <Moby/Validation.h>
 #include <Moby/CompGeom.h>
 #include <Moby/RigidBody.h>
 #include <Moby/RCArticulatedBody.h>
 #include <Moby/CollisionGeometry.h>
 #include <Moby/Log.h>
+#include <Ravelin/LinAlgd.h>
 #include <Moby/UnilateralConstraint.h>
 
 using namespace Ravelin;
@@ -44,15 +46,74 @@ using boost::dynamic_pointer_cast;
 MatrixNd UnilateralConstraint::J1, UnilateralConstraint::J2, UnilateralConstraint::workM1, UnilateralConstraint::workM2;
 MatrixNd UnilateralConstraint::JJ, UnilateralConstraint::J, UnilateralConstraint::Jx, UnilateralConstraint::Jy, UnilateralConstraint::dJ1, UnilateralConstraint::dJ2;
 VectorNd UnilateralConstraint::v, UnilateralConstraint::workv, UnilateralConstraint::workv2; 
+map<shared_ptr<DynamicBodyd>, MatrixNd> UnilateralConstraint::_inv_inertias;
 
-/// Creates an empty constraint 
+/// Gets the cached generalized inverse inertia for a super body
+/**
+ * Articulated bodies pay a dense factorization for every generalized
+ * inertia solve; with many simultaneous contacts on one body the same solve
+ * is repeated for every contact and every contact pair. The inverse is
+ * computed once per body and reused until invalidate_inverse_inertias() is
+ * called (whenever generalized positions change).
+ */
+const MatrixNd& UnilateralConstraint::get_inverse_inertia(shared_ptr<DynamicBodyd> su)
+{
+  // look for a cached inverse
+  map<shared_ptr<DynamicBodyd>, MatrixNd>::iterator iter = _inv_inertias.find(su);
+  if (iter != _inv_inertias.end())
+    return iter->second;
+
+  // not cached; compute and store the inverse
+  MatrixNd& iM = _inv_inertias[su];
+  su->get_generalized_inertia(iM);
+  LinAlgd::inverse_SPD(iM);
+  return iM;
+}
+
+/// Invalidates all cached inverse inertias; call whenever positions change
+void UnilateralConstraint::invalidate_inverse_inertias()
+{
+  _inv_inertias.clear();
+}
+
+/// The free list of recycled contact frames
+std::vector<shared_ptr<Pose3d> > UnilateralConstraint::_frame_pool;
+
+/// Gets a contact frame, recycling one from the free list when possible
+shared_ptr<Pose3d> UnilateralConstraint::acquire_contact_frame()
+{
+  // no recycled frame available? allocate one
+  if (_frame_pool.empty())
+    return shared_ptr<Pose3d>(new Pose3d);
+
+  // pop a recycled frame and restore it to the freshly constructed state
+  shared_ptr<Pose3d> frame = _frame_pool.back();
+  _frame_pool.pop_back();
+  frame->q.set_identity();
+  frame->x.set_zero();
+  frame->rpose = GLOBAL;
+  return frame;
+}
+
+/// Returns a contact frame to the free list
+void UnilateralConstraint::release_contact_frame(shared_ptr<Pose3d>& frame)
+{
+  // recycle the frame only if nothing else references it (vectors computed
+  // in the frame can retain it through their pose pointers)
+  if (frame && frame.unique())
+    _frame_pool.push_back(frame);
+  frame.reset();
+}
+
+/// Creates an empty constraint
 UnilateralConstraint::UnilateralConstraint()
 {
-  _contact_frame = shared_ptr<Pose3d>(new Pose3d);
+  _contact_frame = acquire_contact_frame();
   tol = NEAR_ZERO;              // default collision tolerance
   compliance = eRigid;
   constraint_type = eNone;
   signed_violation = 0.0;
+  contact_approach_vel = 0.0;
   limit_dof = std::numeric_limits<unsigned>::max();
   limit_epsilon = (double) 0.0;
   limit_upper = false;
@@ -62,6 +123,8 @@ UnilateralConstraint::UnilateralConstraint()
   contact_point.set_zero(GLOBAL);
   contact_mu_coulomb = (double) 0.0;
   contact_mu_viscous = (double) 0.0;
+  contact_mu_torsional = (double) 0.0;
+  contact_mu_rolling = (double) 0.0;
   contact_penalty_Kp = (double) 0.0;
   contact_penalty_Kv = (double) 0.0;
   contact_epsilon = (double) 0.0;
@@ -73,6 +136,7 @@ UnilateralConstraint& UnilateralConstraint::operator=(const UnilateralConstraint
 {
   tol = e.tol;
   signed_violation = e.signed_violation;
+  contact_approach_vel = e.contact_approach_vel;
   constraint_type = e.constraint_type;
   compliance = e.compliance;
   limit_epsilon = e.limit_epsilon;
@@ -87,6 +151,8 @@ UnilateralConstraint& UnilateralConstraint::operator=(const UnilateralConstraint
   contact_impulse = e.contact_impulse;
   contact_mu_coulomb = e.contact_mu_coulomb;
   contact_mu_viscous = e.contact_mu_viscous;
+  contact_mu_torsional = e.contact_mu_torsional;
+  contact_mu_rolling = e.contact_mu_rolling;
   contact_penalty_Kp = e.contact_penalty_Kp;
   contact_penalty_Kv = e.contact_penalty_Kv;
   contact_epsilon = e.contact_epsilon;
@@ -97,6 +163,38 @@ UnilateralConstraint& UnilateralConstraint::operator=(const UnilateralConstraint
   return *this;
 }
 
+/// Swaps the contents of this constraint with another without copying or allocating
+void UnilateralConstraint::swap(UnilateralConstraint& e)
+{
+  std::swap(tol, e.tol);
+  std::swap(signed_violation, e.signed_violation);
+  std::swap(contact_approach_vel, e.contact_approach_vel);
+  std::swap(constraint_type, e.constraint_type);
+  std::swap(compliance, e.compliance);
+  std::swap(limit_epsilon, e.limit_epsilon);
+  std::swap(limit_dof, e.limit_dof);
+  std::swap(limit_upper, e.limit_upper);
+  std::swap(limit_impulse, e.limit_impulse);
+  limit_joint.swap(e.limit_joint);
+  std::swap(contact_normal, e.contact_normal);
+  contact_geom1.swap(e.contact_geom1);
+  contact_geom2.swap(e.contact_geom2);
+  std::swap(contact_point, e.contact_point);
+  std::swap(contact_impulse, e.contact_impulse);
+  std::swap(contact_mu_coulomb, e.contact_mu_coulomb);
+  std::swap(contact_mu_viscous, e.contact_mu_viscous);
+  std::swap(contact_mu_torsional, e.contact_mu_torsional);
+  std::swap(contact_mu_rolling, e.contact_mu_rolling);
+  std::swap(contact_penalty_Kp, e.contact_penalty_Kp);
+  std::swap(contact_penalty_Kv, e.contact_penalty_Kv);
+  std::swap(contact_epsilon, e.contact_epsilon);
+  std::swap(contact_NK, e.contact_NK);
+  std::swap(contact_compliance, e.contact_compliance);
+  std::swap(contact_tan1, e.contact_tan1);
+  std::swap(contact_tan2, e.contact_tan2);
+  _contact_frame.swap(e._contact_frame);
+}
+
 /// Computes the constraint data
 void UnilateralConstraint::compute_constraint_data(MatrixNd& M, VectorNd& q) const
 {
@@ -114,10 +212,10 @@ void UnilateralConstraint::compute_constraint_data(MatrixNd& M, VectorNd& q) con
     shared_ptr<DynamicBodyd> su2 = dynamic_pointer_cast<DynamicBodyd>(sb2->get_super_body());
 
     // verify the contact point, normal, and tangents are in the global frame
-    assert(contact_point.pose == GLOBAL);
-    assert(contact_normal.pose == GLOBAL);
-    assert(contact_tan1.pose == GLOBAL);
-    assert(contact_tan2.pose == GLOBAL);
+    MOBY_CHECK_HOT(contact_point.pose == GLOBAL);
+    MOBY_CHECK_HOT(contact_normal.pose == GLOBAL);
+    MOBY_CHECK_HOT(contact_tan1.pose == GLOBAL);
+    MOBY_CHECK_HOT(contact_tan2.pose == GLOBAL);
 
     // setup the contact frame
     _contact_frame->q.set_identity();
@@ -152,13 +250,14 @@ void UnilateralConstraint::compute_constraint_data(MatrixNd& M, VectorNd& q) con
     SharedConstMatrixNd Jlin2 = JJ.block(0, THREE_D, 0, JJ.columns());
     (-R).transpose_mult(Jlin2, J2);
 
-    // compute the constraint inertia matrix for the first body
-    su1->transpose_solve_generalized_inertia(J1, workM1);
-    J1.mult(workM1, M);
+    // compute the constraint inertia matrix for the first body using the
+    // cached inverse inertia
+    J1.mult(get_inverse_inertia(su1), workM1);
+    workM1.mult_transpose(J1, M);
 
     // compute the constraint inertia matrix for the second body
-    su2->transpose_solve_generalized_inertia(J2, workM1);
-    J2.mult(workM1, workM2);
+    J2.mult(get_inverse_inertia(su2), workM1);
+    workM1.mult_transpose(J2, workM2);
     M += workM2;
 
     // compute the constraint velocity
@@ -181,14 +280,10 @@ void UnilateralConstraint::compute_constraint_data(MatrixNd& M, VectorNd& q) con
       // determine the joint limit index
       unsigned idx = limit_joint->get_coord_index() + limit_dof;
 
-      // setup a vector to solve
-      v.set_zero(su->num_generalized_coordinates(DynamicBodyd::eSpatial));
-      v[idx] = 1.0;
-
-      // solve
-      su->solve_generalized_inertia(v, workv); 
+      // the limit inertia is a diagonal entry of the cached inverse inertia
+      const MatrixNd& iM = get_inverse_inertia(su);
       M.resize(1,1);
-      M(0,0) = workv[idx];
+      M(0,0) = iM(idx,idx);
     }
     else
     {
@@ -455,9 +550,9 @@ void UnilateralConstraint::compute_cross_contact_contact_constraint_data(const U
     SharedConstMatrixNd Jlin = JJ.block(0, THREE_D, 0, JJ.columns());
     R.transpose_mult(Jlin, Jx);
 
-    // now update M 
-    su->transpose_solve_generalized_inertia(Jx, workM1);
-    M += J.mult(workM1, workM2);
+    // now update M using the cached inverse inertia
+    J.mult(get_inverse_inertia(su), workM1);
+    M += workM1.mult_transpose(Jx, workM2);
   }
   if (sub2 == su)
   {
@@ -465,9 +560,9 @@ void UnilateralConstraint::compute_cross_contact_contact_constraint_data(const U
     SharedConstMatrixNd Jlin = JJ.block(0, THREE_D, 0, JJ.columns());
     (-R).transpose_mult(Jlin, Jx);
 
-    // now update M
-    su->transpose_solve_generalized_inertia(Jx, workM1);
-    M += J.mult(workM1, workM2);
+    // now update M using the cached inverse inertia
+    J.mult(get_inverse_inertia(su), workM1);
+    M += workM1.mult_transpose(Jx, workM2);
   }
 }
 
@@ -524,8 +619,10 @@ void UnilateralConstraint::compute_cross_contact_limit_constraint_data(const Uni
     SharedConstMatrixNd Jlin = JJ.block(0, THREE_D, 0, JJ.columns());
     R.transpose_mult(Jlin, J1);
 
-    // compute the constraint inertia matrix for the first body
-    su1->transpose_solve_generalized_inertia(J1, workM1);
+    // compute the constraint inertia matrix for the first body using the
+    // cached inverse inertia
+    MatrixNd::transpose(J1, workM2);
+    get_inverse_inertia(su1).mult(workM2, workM1);
 
     // get the appropriate row of workM
     if (M.columns() == 3)
@@ -552,8 +649,10 @@ void UnilateralConstraint::compute_cross_contact_limit_constraint_data(const Uni
     SharedConstMatrixNd Jlin = JJ.block(0, THREE_D, 0, JJ.columns());
     (-R).transpose_mult(Jlin, J1);
 
-    // compute the constraint inertia matrix for the first body
-    su2->transpose_solve_generalized_inertia(J1, workM1);
+    // compute the constraint inertia matrix for the first body using the
+    // cached inverse inertia
+    MatrixNd::transpose(J1, workM2);
+    get_inverse_inertia(su2).mult(workM2, workM1);
 
     // get the appropriate row of workM
     if (M.columns() == 3)
@@ -591,15 +690,11 @@ void UnilateralConstraint::compute_cross_limit_limit_constraint_data(const Unila
   // case 1: reduced-coordinate articulated body
   if (su)
   {
-    // setup a vector to solve
-    workv.set_zero(su->num_generalized_coordinates(DynamicBodyd::eSpatial));
-    workv[idx1] = 1.0;
-
-    // solve
-    su->solve_generalized_inertia(workv, workv2); 
+    // the cross limit inertia is an entry of the cached inverse inertia
+    const MatrixNd& iM = get_inverse_inertia(su);
 
     // determine whether to negate
-    double value = workv2[idx2];
+    double value = iM(idx1,idx2);
     if ((limit_upper && !e.limit_upper) ||
         (!limit_upper && e.limit_upper))
       value = -value;
@@ -631,6 +726,8 @@ void UnilateralConstraint::set_contact_parameters(const ContactParameters& cpara
 {
   contact_mu_coulomb = cparams.mu_coulomb;
   contact_mu_viscous = cparams.mu_viscous;
+  contact_mu_torsional = cparams.mu_torsional;
+  contact_mu_rolling = cparams.mu_rolling;
   contact_penalty_Kp = cparams.penalty_Kp;
   contact_penalty_Kv = cparams.penalty_Kv;
   contact_epsilon = cparams.epsilon;
@@ -696,14 +793,14 @@ double UnilateralConstraint::calc_constraint_vel() const
 {
   if (constraint_type == eContact)
   {
-    assert(contact_geom1 && contact_geom2);
+    MOBY_CHECK_HOT(contact_geom1 && contact_geom2);
     shared_ptr<SingleBodyd> sba = contact_geom1->get_single_body();
     shared_ptr<SingleBodyd> sbb = contact_geom2->get_single_body();
-    assert(sba && sbb);
+    MOBY_CHECK_HOT(sba && sbb);
 
-    // get the vels 
-    const SVelocityd& va = sba->get_velocity(); 
-    const SVelocityd& vb = sbb->get_velocity(); 
+    // get the vels
+    const SVelocityd& va = sba->get_velocity();
+    const SVelocityd& vb = sbb->get_velocity();
 
     // setup the constraint frame
     _contact_frame->x = contact_point;
@@ -1357,11 +1454,11 @@ void UnilateralConstraint::write_vrml(const std::string& fname, double sphere_ra
 double UnilateralConstraint::calc_contact_vel(const Vector3d& v) const
 {
   // verify that this is a contact
-  assert(constraint_type == eContact);
+  MOBY_CHECK_HOT(constraint_type == eContact);
 
   shared_ptr<SingleBodyd> sba = contact_geom1->get_single_body();
   shared_ptr<SingleBodyd> sbb = contact_geom2->get_single_body();
-  assert(sba && sbb);
+  MOBY_CHECK_HOT(sba && sbb);
 
   // get the vels 
   const SVelocityd& va = sba->get_velocity();
@@ -1383,50 +1480,70 @@ double UnilateralConstraint::calc_contact_vel(const Vector3d& v) const
   return vx.dot(ta.get_linear() - tb.get_linear());
 }
 
+/// Computes two tangents orthogonal to a unit normal without branching
+/**
+ * Branch-free orthonormal basis construction (Duff et al.): both tangents
+ * follow from the normal with a handful of multiplies, no normalization and
+ * no special case for normals near a coordinate axis, so a large batch of
+ * contacts runs through it without branch mispredictions or square roots.
+ */
+static void calc_tangent_basis(const Vector3d& n, Vector3d& t1, Vector3d& t2)
+{
+  const unsigned X = 0, Y = 1, Z = 2;
+  const double s = (n[Z] >= 0.0) ? 1.0 : -1.0;
+  const double a = -1.0/(s + n[Z]);
+  const double b = n[X]*n[Y]*a;
+  t1 = Vector3d(1.0 + s*n[X]*n[X]*a, s*b, -s*n[X], n.pose);
+  t2 = Vector3d(b, s + n[Y]*n[Y]*a, -n[Y], n.pose);
+}
+
 /// Determines the set of contact tangents
 void UnilateralConstraint::determine_contact_tangents()
 {
   // get the two bodies of the contact
-  assert(constraint_type == UnilateralConstraint::eContact);
-  assert(contact_geom1 && contact_geom2);
+  MOBY_CHECK_HOT(constraint_type == UnilateralConstraint::eContact);
+  MOBY_CHECK_HOT(contact_geom1 && contact_geom2);
   shared_ptr<SingleBodyd> sba = contact_geom1->get_single_body();
   shared_ptr<SingleBodyd> sbb = contact_geom2->get_single_body();
-  assert(sba && sbb);
+  MOBY_CHECK_HOT(sba && sbb);
 
   // verify the contact point, normal, and tangents are in the global frame
-  assert(contact_point.pose == GLOBAL);
-  assert(contact_normal.pose == GLOBAL);
-  assert(contact_tan1.pose == GLOBAL);
-  assert(contact_tan2.pose == GLOBAL);
-
-  // setup the contact frame
-  _contact_frame->q.set_identity();
-  _contact_frame->x = contact_point;
+  MOBY_CHECK_HOT(contact_point.pose == GLOBAL);
+  MOBY_CHECK_HOT(contact_normal.pose == GLOBAL);
+  MOBY_CHECK_HOT(contact_tan1.pose == GLOBAL);
+  MOBY_CHECK_HOT(contact_tan2.pose == GLOBAL);
+
+  // the relative velocity at the contact is only reported, never used:
+  // computing it takes two spatial transforms per contact, so do so only
+  // when the log is consumed
+  if (LOGGING(LOG_CONSTRAINT))
+  {
+    // setup the contact frame
+    _contact_frame->q.set_identity();
+    _contact_frame->x = contact_point;
 
-  // get the velocities at the point of contat
-  const SVelocityd& va = sba->get_velocity(); 
-  const SVelocityd& vb = sbb->get_velocity();
-  shared_ptr<const Pose3d> const_contact_frame = boost::const_pointer_cast<const Pose3d>(_contact_frame);
-  SVelocityd ta = Pose3d::transform(const_contact_frame, va);
-  SVelocityd tb = Pose3d::transform(const_contact_frame, vb);
-  Vector3d rvel = ta.get_linear() - tb.get_linear();
+    // get the velocities at the point of contact
+    const SVelocityd& va = sba->get_velocity();
+    const SVelocityd& vb = sbb->get_velocity();
+    shared_ptr<const Pose3d> const_contact_frame = boost::const_pointer_cast<const Pose3d>(_contact_frame);
+    SVelocityd ta = Pose3d::transform(const_contact_frame, va);
+    SVelocityd tb = Pose3d::transform(const_contact_frame, vb);
+    Vector3d rvel = ta.get_linear() - tb.get_linear();
 
-  // get the normal in the same frame
-  Vector3d normal_cp = Pose3d::transform_vector(_contact_frame, contact_normal);
+    // get the normal in the same frame
+    Vector3d normal_cp = Pose3d::transform_vector(_contact_frame, contact_normal);
 
-  // now remove the normal components from this relative velocity
-  double dot = normal_cp.dot(rvel);
-  rvel -= (normal_cp * dot);
+    // now remove the normal components from this relative velocity
+    double dot = normal_cp.dot(rvel);
+    rvel -= (normal_cp * dot);
 
-  // see whether we can use this vector as a contact tangent and set the
-  // friction type 
-  double tan_norm = rvel.norm();
-  FILE_LOG(LOG_CONSTRAINT) << "UnilateralConstraint::determine_contact_tangents() - tangent velocity magnitude: " << tan_norm << std::endl;
+    FILE_LOG(LOG_CONSTRAINT) << "UnilateralConstraint::determine_contact_tangents() - tangent velocity magnitude: " << rvel.norm() << std::endl;
+  }
 
   // determine an orthonormal basis using the two contact tangents
-  Vector3d::determine_orthonormal_basis(contact_normal, contact_tan1, contact_tan2);
-  assert(!std::isnan(contact_tan1.norm()));
-  assert(!std::isnan(contact_tan2.norm()));
+  calc_tangent_basis(contact_normal, contact_tan1, contact_tan2);
+  MOBY_CHECK_HOT(!std::isnan(contact_tan1.norm()));
+  MOBY_CHECK_HOT(!std::isnan(contact_tan2.norm()));
 }
 
 /// Determines the type of constraint 
@@ -1454,14 +1571,14 @@ double UnilateralConstraint::calc_constraint_tol() const
 {
   if (constraint_type == eContact)
   {
-    assert(contact_geom1 && contact_geom2);
+    MOBY_CHECK_HOT(contact_geom1 && contact_geom2);
     shared_ptr<SingleBodyd> sba = contact_geom1->get_single_body();
     shared_ptr<SingleBodyd> sbb = contact_geom2->get_single_body();
-    assert(sba && sbb);
+    MOBY_CHECK_HOT(sba && sbb);
 
-    // get the vels 
-    const SVelocityd& va = sba->get_velocity(); 
-    const SVelocityd& vb = sbb->get_velocity(); 
+    // get the vels
+    const SVelocityd& va = sba->get_velocity();
+    const SVelocityd& vb = sbb->get_velocity();
 
     // setup the constraint frame
     _contact_frame->x = contact_point;
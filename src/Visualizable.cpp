@@ -112,9 +112,36 @@ void Visualizable::update_visualization()
   T0.update_relative_pose(GLOBAL);
 
   // update the transform
-  osg::Matrixd m;
-  to_osg_matrix(T0, m);
-  ((osg::MatrixTransform*) _vizdata->get_group())->setMatrix(m);
+  _vizdata->update_transform(T0);
+  #endif
+}
+
+/// Captures the current visualization pose without touching the scene graph
+/**
+ * The other half of the double-buffered visualization update: the stepping
+ * thread records (visualization data, global pose) pairs here and the
+ * render thread applies them later via OSGGroupWrapper::update_transform(),
+ * so stepping never stalls on the renderer holding the scene graph.
+ * \sa Simulator::snapshot_visualization()
+ */
+void Visualizable::snapshot_visualization(std::vector<std::pair<OSGGroupWrapperPtr, Pose3d> >& poses)
+{
+  #ifdef USE_OSG
+  // if there is no visualization data, quit now
+  if (!_vizdata)
+    return;
+
+  // get the transform; if there is none, quit now
+  shared_ptr<const Pose3d> T = get_visualization_pose();
+  if (!T)
+    return;
+
+  // convert the pose to reference the global frame
+  Pose3d T0 = *T;
+  T0.update_relative_pose(GLOBAL);
+
+  // record the pose for deferred application
+  poses.push_back(std::make_pair(_vizdata, T0));
   #endif
 }
 
@@ -17,9 +17,13 @@
 #include <Moby/OSGGroupWrapper.h>
 #endif
 
+#include <Moby/Log.h>
 #include <Moby/HeightmapPrimitive.h>
+#include <Moby/PagedHeightmapPrimitive.h>
+#include <Moby/DistanceFieldPrimitive.h>
 #include <Moby/PlanePrimitive.h>
 #include <Moby/CylinderPrimitive.h>
+#include <Moby/CapsulePrimitive.h>
 #include <Moby/ConePrimitive.h>
 #include <Moby/IndexedTetraArray.h>
 #include <Moby/Constants.h>
@@ -30,6 +34,7 @@
 #include <Moby/BoxPrimitive.h>
 #include <Moby/TorusPrimitive.h>
 #include <Moby/SpherePrimitive.h>
+#include <Moby/SphereTreePrimitive.h>
 #include <Moby/FixedJoint.h>
 #include <Moby/PlanarJoint.h>
 //#include <Moby/MCArticulatedBody.h>
@@ -44,6 +49,7 @@
 #include <Moby/Dissipation.h>
 #include <Moby/DampingForce.h>
 #include <Moby/XMLTree.h>
+#include <Moby/SpatialGridCCD.h>
 #include <Moby/SDFReader.h>
 #include <Moby/XMLReader.h>
 
@@ -53,6 +59,28 @@ using boost::dynamic_pointer_cast;
 using namespace Ravelin;
 using namespace Moby;
 
+// the flyweight table of shared primitives, keyed on primitive parameters
+std::map<std::string, BasePtr> XMLReader::_interned_primitives;
+
+// whether the flyweight table persists across read() calls
+bool XMLReader::_retain_interned = false;
+
+/// Sets whether interned primitives persist across read() calls
+/**
+ * By default the flyweight table is released after each read.  Enabling
+ * retention lets consecutive reads of the same (or a similar) scene share
+ * their immutable primitives, so a batch of simulator instances stores a
+ * single copy of the heavyweight geometry.  Disabling retention releases
+ * the table; interned primitives stay alive through the objects that
+ * reference them.
+ */
+void XMLReader::retain_interned_primitives(bool flag)
+{
+  _retain_interned = flag;
+  if (!flag)
+    _interned_primitives.clear();
+}
+
 /// Reads an XML file and constructs all read objects
 /**
  * \return a map of IDs to read objects
@@ -125,6 +153,12 @@ std::map<std::string, BasePtr> XMLReader::read(const std::string& fname)
   // construct the ID map
   id_map = construct_ID_map(moby_tree);
 
+  // release the flyweight table (unless retention is on); interned
+  // primitives stay alive through the id_map and the bodies that
+  // reference them
+  if (!_retain_interned)
+    _interned_primitives.clear();
+
   // change back to the initial working directory
   chdir(cwd.get());
 
@@ -136,6 +170,10 @@ std::map<std::string, BasePtr> XMLReader::construct_ID_map(shared_ptr<XMLTree> m
 {
   std::map<std::string, BasePtr> id_map;
 
+  // start with a fresh flyweight table (unless retention is on)
+  if (!_retain_interned)
+    _interned_primitives.clear();
+
   // mark moby tree as processed
   moby_tree->processed = true;
 
@@ -147,21 +185,33 @@ std::map<std::string, BasePtr> XMLReader::construct_ID_map(shared_ptr<XMLTree> m
   // provide this processing themselves (see RCArticulatedBody for an example)
   // ********************************************************************
 
-  // read and construct all primitives
+  // read and construct all primitives; mass-property computations with
+  // expensive volume integrals (e.g., triangle meshes) are deferred while
+  // the primitives load and then computed in one parallel pass below
+  Primitive::begin_calc_mass_properties_batch();
   process_tag("Box", moby_tree, &read_box, id_map);
   process_tag("Torus", moby_tree, &read_torus, id_map);
   process_tag("Sphere", moby_tree, &read_sphere, id_map);
   process_tag("Cylinder", moby_tree, &read_cylinder, id_map);
+  process_tag("Capsule", moby_tree, &read_capsule, id_map);
   process_tag("Cone", moby_tree, &read_cone, id_map);
   process_tag("Heightmap", moby_tree, &read_heightmap, id_map);
+  process_tag("PagedHeightmap", moby_tree, &read_paged_heightmap, id_map);
+  process_tag("DistanceField", moby_tree, &read_distance_field, id_map);
   process_tag("Plane", moby_tree, &read_plane, id_map);
   process_tag("Polyhedron", moby_tree, &read_polyhedron, id_map);
+  // sphere trees reference other primitives, so their tag is processed last
+  process_tag("SphereTree", moby_tree, &read_sphere_tree, id_map);
 /*
   process_tag("TetraMesh", moby_tree, &read_tetramesh, id_map);
   process_tag("PrimitivePlugin", moby_tree, &read_primitive_plugin, id_map);
   process_tag("CSG", moby_tree, &read_CSG, id_map);
 */
 
+  // compute all deferred mass properties (bodies read primitive inertias
+  // below, so the batch must complete first)
+  Primitive::end_calc_mass_properties_batch();
+
   // read and construct all recurrent forces (except damping)
   process_tag("GravityForce", moby_tree, &read_gravity_force, id_map);
   process_tag("StokesDragForce", moby_tree, &read_stokes_drag_force, id_map);
@@ -193,7 +243,10 @@ std::map<std::string, BasePtr> XMLReader::construct_ID_map(shared_ptr<XMLTree> m
   process_tag("RCArticulatedBodySymbolicPlugin", moby_tree, &read_rc_abody_symbolic, id_map);
 
   // read and construct plugin collision detectors, if any
-  process_tag("CollisionDetectionPlugin", moby_tree, &read_coldet_plugin, id_map);  
+  process_tag("CollisionDetectionPlugin", moby_tree, &read_coldet_plugin, id_map);
+
+  // read and construct alternative broad phase collision detectors, if any
+  process_tag("SpatialGridCCD", moby_tree, &read_spatial_grid_ccd, id_map);
 
   // damping forces and dissipation must be constructed after bodies
   process_tag("DampingForce", moby_tree, &read_damping_force, id_map);
@@ -243,8 +296,8 @@ void XMLReader::process_tag(const std::string& tag, shared_ptr<const XMLTree> ro
     fn(root, id_map);
   else
   {
-    const std::list<XMLTreePtr>& child_nodes = root->children;
-    for (std::list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+    const std::vector<XMLTreePtr>& child_nodes = root->children;
+    for (std::vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
     {
       (*i)->processed = true;
       process_tag(tag, *i, fn, id_map);
@@ -252,6 +305,48 @@ void XMLReader::process_tag(const std::string& tag, shared_ptr<const XMLTree> ro
   }
 }
 
+/// Shares structurally identical primitives across XML nodes
+/**
+ * Generated scenes frequently declare hundreds of primitive nodes with
+ * identical parameters (e.g., one Box node per crate).  Constructing a
+ * fresh Primitive for each duplicates the BV hierarchies and visualization
+ * geometry.  This method interns primitives by their tag and attributes:
+ * when a node matches one already read, its ID is rebound in the ID map to
+ * the first instance and the fresh copy is discarded.  Only leaf nodes are
+ * interned; primitives with child nodes (e.g., inline visualization) are
+ * conservatively left unshared.
+ */
+void XMLReader::intern_primitive(shared_ptr<const XMLTree> node, BasePtr primitive, std::map<std::string, BasePtr>& id_map)
+{
+  // don't intern primitives with child nodes
+  if (!node->children.empty())
+    return;
+
+  // build the key from the tag and the attributes (sans the unique ID);
+  // the attribute set is ordered by name, so the key is canonical
+  std::string key = node->name;
+  BOOST_FOREACH(const XMLAttrib& a, node->attribs)
+  {
+    if (strcasecmp(a.name.c_str(), "id") == 0)
+      continue;
+    key += "|" + a.name + "=" + a.value;
+  }
+
+  // see whether an identical primitive has already been read
+  std::map<std::string, BasePtr>::const_iterator iter = _interned_primitives.find(key);
+  if (iter == _interned_primitives.end())
+  {
+    // first occurrence; remember it
+    _interned_primitives[key] = primitive;
+    return;
+  }
+
+  // rebind the node's ID to the shared instance; the fresh primitive (and
+  // its BV hierarchy and visualization geometry) is discarded
+  FILE_LOG(LOG_SIMULATOR) << "XMLReader::intern_primitive() - sharing primitive '" << iter->second->id << "' for node with id '" << primitive->id << "'" << std::endl;
+  id_map[primitive->id] = iter->second;
+}
+
 /// Reads and constructs a dissipation object
 void XMLReader::read_dissipation(shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map)
 {
@@ -327,9 +422,25 @@ void XMLReader::read_primitive_plugin(shared_ptr<const XMLTree> node, std::map<s
   primitive_plugin->load_from_xml(node, id_map);
 }
 
+/// Reads and constructs a SpatialGridCCD collision detector
+/**
+ * \pre node is named SpatialGridCCD
+ */
+void XMLReader::read_spatial_grid_ccd(shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map)
+{
+  // sanity check
+  assert(strcasecmp(node->name.c_str(), "SpatialGridCCD") == 0);
+
+  // create a new SpatialGridCCD object
+  boost::shared_ptr<Base> b(new SpatialGridCCD());
+
+  // populate the object
+  b->load_from_xml(node, id_map);
+}
+
 /// Reads and constructs a plugin CollisionDetection object
 /**
- * \pre node is named CollisionDetectionPlugin 
+ * \pre node is named CollisionDetectionPlugin
  */
 void XMLReader::read_coldet_plugin(shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map)
 {
@@ -410,9 +521,28 @@ void XMLReader::read_sphere(shared_ptr<const XMLTree> node, std::map<std::string
 
   // create a new Base object
   boost::shared_ptr<Base> b(new SpherePrimitive());
-  
+
   // populate the object
   b->load_from_xml(node, id_map);
+
+  // share with any structurally identical primitive already read
+  intern_primitive(node, b, id_map);
+}
+
+/// Reads and constructs the SphereTreePrimitive object
+void XMLReader::read_sphere_tree(shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map)
+{
+  // sanity check
+  assert(strcasecmp(node->name.c_str(), "SphereTree") == 0);
+
+  // create a new Base object
+  boost::shared_ptr<Base> b(new SphereTreePrimitive());
+
+  // populate the object
+  b->load_from_xml(node, id_map);
+
+  // share with any structurally identical primitive already read
+  intern_primitive(node, b, id_map);
 }
 
 /// Reads and constructs the ConePrimitive object
@@ -426,6 +556,9 @@ void XMLReader::read_cone(shared_ptr<const XMLTree> node, std::map<std::string,
   
   // populate the object
   b->load_from_xml(node, id_map);
+
+  // share with any structurally identical primitive already read
+  intern_primitive(node, b, id_map);
 }
 
 /// Reads and constructs the CylinderPrimitive object
@@ -439,6 +572,25 @@ void XMLReader::read_cylinder(shared_ptr<const XMLTree> node, std::map<std::stri
   
   // populate the object
   b->load_from_xml(node, id_map);
+
+  // share with any structurally identical primitive already read
+  intern_primitive(node, b, id_map);
+}
+
+/// Reads and constructs a CapsulePrimitive object
+void XMLReader::read_capsule(shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map)
+{
+  // sanity check
+  assert(strcasecmp(node->name.c_str(), "Capsule") == 0);
+
+  // create a new CapsulePrimitive object
+  boost::shared_ptr<Base> b(new CapsulePrimitive());
+
+  // populate the object
+  b->load_from_xml(node, id_map);
+
+  // share with any structurally identical primitive already read
+  intern_primitive(node, b, id_map);
 }
 
 /// Reads and constructs a CSG object
@@ -478,6 +630,9 @@ void XMLReader::read_polyhedron(shared_ptr<const XMLTree> node, std::map<std::st
   
   // populate the object
   b->load_from_xml(node, id_map);
+
+  // share with any structurally identical primitive already read
+  intern_primitive(node, b, id_map);
 }
 
 /// Reads and constructs a plane object
@@ -491,6 +646,9 @@ void XMLReader::read_plane(shared_ptr<const XMLTree> node, std::map<std::string,
   
   // populate the object
   b->load_from_xml(node, id_map);
+
+  // share with any structurally identical primitive already read
+  intern_primitive(node, b, id_map);
 }
 
 /// Reads and constructs a heightmap object
@@ -504,6 +662,41 @@ void XMLReader::read_heightmap(shared_ptr<const XMLTree> node, std::map<std::str
   
   // populate the object
   b->load_from_xml(node, id_map);
+
+  // share with any structurally identical primitive already read
+  intern_primitive(node, b, id_map);
+}
+
+/// Reads and constructs a paged heightmap object
+void XMLReader::read_paged_heightmap(shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map)
+{
+  // sanity check
+  assert(strcasecmp(node->name.c_str(), "PagedHeightmap") == 0);
+
+  // create a new PagedHeightmap object
+  boost::shared_ptr<Base> b(new PagedHeightmapPrimitive());
+
+  // populate the object
+  b->load_from_xml(node, id_map);
+
+  // share with any structurally identical primitive already read
+  intern_primitive(node, b, id_map);
+}
+
+/// Reads and constructs a distance field object
+void XMLReader::read_distance_field(shared_ptr<const XMLTree> node, std::map<std::string, BasePtr>& id_map)
+{
+  // sanity check
+  assert(strcasecmp(node->name.c_str(), "DistanceField") == 0);
+
+  // create a new DistanceFieldPrimitive object
+  boost::shared_ptr<Base> b(new DistanceFieldPrimitive());
+
+  // populate the object
+  b->load_from_xml(node, id_map);
+
+  // share with any structurally identical primitive already read
+  intern_primitive(node, b, id_map);
 }
 
 /// Reads and constructs the TorusPrimitive object
@@ -517,6 +710,9 @@ void XMLReader::read_torus(shared_ptr<const XMLTree> node, std::map<std::string,
   
   // populate the object
   b->load_from_xml(node, id_map);
+
+  // share with any structurally identical primitive already read
+  intern_primitive(node, b, id_map);
 }
 
 /// Reads and constructs the BoxPrimitive object
@@ -530,6 +726,9 @@ void XMLReader::read_box(shared_ptr<const XMLTree> node, std::map<std::string, B
   
   // populate the object
   b->load_from_xml(node, id_map);
+
+  // share with any structurally identical primitive already read
+  intern_primitive(node, b, id_map);
 }
 
 /// Reads and constructs the TimeSteppingSimulator object
@@ -947,8 +1146,8 @@ shared_ptr<const XMLTree> XMLReader::find_subtree(shared_ptr<const XMLTree> root
     return root;
 
   // otherwise, look for it recursively
-  const std::list<XMLTreePtr>& children = root->children;
-  for (std::list<XMLTreePtr>::const_iterator i = children.begin(); i != children.end(); i++)
+  const std::vector<XMLTreePtr>& children = root->children;
+  for (std::vector<XMLTreePtr>::const_iterator i = children.begin(); i != children.end(); i++)
   {
     shared_ptr<const XMLTree> node = find_subtree(*i, name);
     if (node)
@@ -6,11 +6,16 @@
 
 #include <string.h>
 #include <cctype>
+#include <cstdlib>
+#include <map>
+#include <vector>
 #include <algorithm>
 #include <iostream>
+#include <fstream>
 #include <limits>
 #include <cmath>
 #include <sstream>
+#include <sys/stat.h>
 #include <Ravelin/MatrixNd.h>
 #include <Moby/MissizeException.h>
 #include <Moby/XMLTree.h>
@@ -23,6 +28,7 @@ using namespace Ravelin;
 XMLAttrib::XMLAttrib(const std::string& name, const std::string& string_value)
 {
   this->name = name;
+  this->name_id = intern(name);
   this->value = string_value;
   this->processed = false;
 }
@@ -31,6 +37,7 @@ XMLAttrib::XMLAttrib(const std::string& name, const std::string& string_value)
 XMLAttrib::XMLAttrib(const std::string& name, double real_value)
 {
   this->name = name;
+  this->name_id = intern(name);
   this->value = str(real_value);
   this->processed = false;
 }
@@ -39,6 +46,7 @@ XMLAttrib::XMLAttrib(const std::string& name, double real_value)
 XMLAttrib::XMLAttrib(const std::string& name, int int_value)
 {
   this->name = name;
+  this->name_id = intern(name);
   std::ostringstream oss;
   oss << int_value;
   this->value = oss.str();
@@ -49,6 +57,7 @@ XMLAttrib::XMLAttrib(const std::string& name, int int_value)
 XMLAttrib::XMLAttrib(const std::string& name, unsigned unsigned_value)
 {
   this->name = name;
+  this->name_id = intern(name);
   std::ostringstream oss;
   oss << unsigned_value;
   this->value = oss.str();
@@ -59,6 +68,7 @@ XMLAttrib::XMLAttrib(const std::string& name, unsigned unsigned_value)
 XMLAttrib::XMLAttrib(const std::string& name, const Origin3d& o)
 {
   this->name = name;
+  this->name_id = intern(name);
   std::ostringstream oss;
   oss << o[0] << " " << o[1] << " " << o[2];
   this->value = oss.str();
@@ -69,6 +79,7 @@ XMLAttrib::XMLAttrib(const std::string& name, const Origin3d& o)
 XMLAttrib::XMLAttrib(const std::string& name, const Vector2d& v)
 {
   this->name = name;
+  this->name_id = intern(name);
   std::ostringstream oss;
   oss << v[0] << " " << v[1];
   this->value = oss.str();
@@ -79,6 +90,7 @@ XMLAttrib::XMLAttrib(const std::string& name, const Vector2d& v)
 XMLAttrib::XMLAttrib(const std::string& name, const Vector3d& v)
 {
   this->name = name;
+  this->name_id = intern(name);
   std::ostringstream oss;
   oss << v[0] << " " << v[1] << " " << v[2];
   this->value = oss.str();
@@ -89,6 +101,7 @@ XMLAttrib::XMLAttrib(const std::string& name, const Vector3d& v)
 XMLAttrib::XMLAttrib(const std::string& name, const Quatd& q)
 {
   this->name = name;
+  this->name_id = intern(name);
   std::ostringstream oss;
   oss << q.w << " " << q.x << " " << q.y << " " << q.z;
   this->value = oss.str();
@@ -100,6 +113,7 @@ XMLAttrib::XMLAttrib(const std::string& name, const VectorNd& vector_value)
 {
   this->processed = false;
   this->name = name;
+  this->name_id = intern(name);
   std::ostringstream oss;
 
   // if the vector is empty, return prematurely
@@ -125,6 +139,7 @@ XMLAttrib::XMLAttrib(const std::string& name, const SVector6d& vector_value)
 {
   this->processed = false;
   this->name = name;
+  this->name_id = intern(name);
   std::ostringstream oss;
 
   // set the first value of the vector
@@ -143,6 +158,7 @@ XMLAttrib::XMLAttrib(const std::string& name, const MatrixNd& matrix_value)
 {  
   this->processed = false;
   this->name = name;
+  this->name_id = intern(name);
   std::ostringstream oss;
 
   // if the matrix is empty, return prematurely
@@ -178,6 +194,7 @@ XMLAttrib::XMLAttrib(const std::string& name, const Matrix3d& matrix_value)
 {  
   this->processed = false;
   this->name = name;
+  this->name_id = intern(name);
   std::ostringstream oss;
 
   // set the first value of the matrix
@@ -206,6 +223,7 @@ XMLAttrib::XMLAttrib(const std::string& name, bool bool_value)
 {
   this->processed = false;
   this->name = name;
+  this->name_id = intern(name);
   this->value = (bool_value) ? "true" : "false";  
 }
 
@@ -214,11 +232,60 @@ XMLAttrib::XMLAttrib(const std::string& name, long long_value)
 {
   this->processed = false;
   this->name = name;
+  this->name_id = intern(name);
   std::ostringstream oss;
   oss << long_value;
   this->value = oss.str();
 }
 
+/// Interns an attribute name, assigning equal ids to equal names
+/**
+ * Scene files draw attribute names from a small fixed vocabulary repeated
+ * across thousands of nodes; interning maps each name to a small integer
+ * once, so attribute lookups order and compare on the id instead of
+ * re-comparing strings.  Ids are assigned in first-seen order and are
+ * stable for the life of the process.
+ */
+unsigned XMLAttrib::intern(const std::string& name)
+{
+  static std::map<std::string, unsigned> ids;
+  std::map<std::string, unsigned>::const_iterator i = ids.find(name);
+  if (i != ids.end())
+    return i->second;
+  unsigned id = (unsigned) ids.size();
+  ids.insert(std::make_pair(name, id));
+  return id;
+}
+
+/// Parses whitespace- and/or comma-delimited reals directly with strtod
+/**
+ * Replaces stringstream- and substring-based tokenization on the load path;
+ * the scan walks the character data once without allocating.  strtod accepts
+ * "inf" and "-inf" (case-insensitively), so infinite values need no special
+ * casing.
+ */
+static void parse_reals(const char* p, std::vector<double>& vals)
+{
+  vals.clear();
+  while (*p)
+  {
+    // skip delimiters
+    if (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ',')
+    {
+      p++;
+      continue;
+    }
+
+    // parse one real; stop on malformed input
+    char* end;
+    double d = std::strtod(p, &end);
+    if (end == p)
+      break;
+    vals.push_back(d);
+    p = end;
+  }
+}
+
 /// Gets a real value as a string
 std::string XMLAttrib::str(double value)
 {
@@ -240,12 +307,8 @@ double XMLAttrib::get_real_value()
   // indicate this attribute has been processed
   processed = true;
 
-  if (strcasecmp(this->value.c_str(), "inf") == 0)
-    return std::numeric_limits<double>::infinity();
-  else if (strcasecmp(this->value.c_str(), "-inf") == 0)
-    return -std::numeric_limits<double>::infinity();
-  else
-    return (double) std::atof(this->value.c_str());
+  // strtod accepts "inf" and "-inf" (case-insensitively) directly
+  return std::strtod(this->value.c_str(), NULL);
 }
 
 /// Gets a Boolean value from the underlying string representation
@@ -274,10 +337,158 @@ bool XMLAttrib::get_bool_value()
   }
 }
 
+// magic string identifying (and versioning) binary XMLTree snapshots; bump
+// the digit whenever the snapshot format changes
+static const char BINARY_XML_MAGIC[] = "MobyXML1";
+
+/// Writes a string to a binary snapshot stream
+static void write_binary_string(std::ostream& out, const std::string& s)
+{
+  unsigned len = (unsigned) s.size();
+  out.write((const char*) &len, sizeof(len));
+  out.write(s.data(), len);
+}
+
+/// Reads a string from a binary snapshot stream
+static bool read_binary_string(std::istream& in, std::string& s)
+{
+  unsigned len;
+  in.read((char*) &len, sizeof(len));
+  if (!in)
+    return false;
+  s.resize(len);
+  if (len > 0)
+    in.read(&s[0], len);
+  return !in.fail();
+}
+
+/// Writes a node (and, recursively, its subtree) to a binary snapshot stream
+static void write_binary_node(std::ostream& out, shared_ptr<const XMLTree> node)
+{
+  // write the node strings
+  write_binary_string(out, node->name);
+  write_binary_string(out, node->id);
+  write_binary_string(out, node->content);
+
+  // write the attributes
+  unsigned n = (unsigned) node->attribs.size();
+  out.write((const char*) &n, sizeof(n));
+  for (std::set<XMLAttrib>::const_iterator i = node->attribs.begin(); i != node->attribs.end(); i++)
+  {
+    write_binary_string(out, i->name);
+    write_binary_string(out, i->value);
+  }
+
+  // write the children
+  n = (unsigned) node->children.size();
+  out.write((const char*) &n, sizeof(n));
+  for (std::vector<XMLTreePtr>::const_iterator i = node->children.begin(); i != node->children.end(); i++)
+    write_binary_node(out, *i);
+}
+
+/// Reads a node (and, recursively, its subtree) from a binary snapshot stream
+static XMLTreePtr read_binary_node(std::istream& in)
+{
+  // read the node strings
+  std::string name, id, content;
+  if (!read_binary_string(in, name) || !read_binary_string(in, id) ||
+      !read_binary_string(in, content))
+    return XMLTreePtr();
+
+  // construct the node
+  XMLTreePtr node(new XMLTree(name));
+  node->id = id;
+  node->content = content;
+
+  // read the attributes
+  unsigned n;
+  in.read((char*) &n, sizeof(n));
+  if (!in)
+    return XMLTreePtr();
+  for (unsigned i=0; i< n; i++)
+  {
+    std::string aname, avalue;
+    if (!read_binary_string(in, aname) || !read_binary_string(in, avalue))
+      return XMLTreePtr();
+    node->attribs.insert(XMLAttrib(aname, avalue));
+  }
+
+  // read the children
+  in.read((char*) &n, sizeof(n));
+  if (!in)
+    return XMLTreePtr();
+  for (unsigned i=0; i< n; i++)
+  {
+    XMLTreePtr child = read_binary_node(in);
+    if (!child)
+      return XMLTreePtr();
+    node->add_child(child);
+  }
+
+  return node;
+}
+
+/// Reads a binary snapshot of a parsed XML tree
+/**
+ * 
+eturn the tree, or a NULL pointer if the snapshot is missing, truncated,
+ *         or was written by a different snapshot format version
+ */
+shared_ptr<const XMLTree> XMLTree::read_from_binary(const std::string& fname)
+{
+  // open the snapshot
+  std::ifstream in(fname.c_str(), std::ios::in | std::ios::binary);
+  if (!in)
+    return shared_ptr<const XMLTree>();
+
+  // verify the magic / format version
+  char magic[sizeof(BINARY_XML_MAGIC)];
+  in.read(magic, sizeof(BINARY_XML_MAGIC));
+  if (!in || memcmp(magic, BINARY_XML_MAGIC, sizeof(BINARY_XML_MAGIC)) != 0)
+    return shared_ptr<const XMLTree>();
+
+  // read the tree
+  return read_binary_node(in);
+}
+
+/// Writes a binary snapshot of a parsed XML tree
+bool XMLTree::write_to_binary(const std::string& fname, shared_ptr<const XMLTree> tree)
+{
+  // open the snapshot
+  std::ofstream out(fname.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!out)
+    return false;
+
+  // write the magic / format version, then the tree
+  out.write(BINARY_XML_MAGIC, sizeof(BINARY_XML_MAGIC));
+  write_binary_node(out, tree);
+  return !out.fail();
+}
+
 shared_ptr<const XMLTree> XMLTree::read_from_xml(const std::string& fname)
 {
   xmlDoc* doc;
 
+  // when snapshot caching is enabled (MOBY_XML_CACHE set in the
+  // environment), a binary snapshot of the parsed tree is kept alongside the
+  // source file and loaded in place of the XML parse when it is at least as
+  // recent as the source; repeated runs on an unchanged scene then skip
+  // parsing entirely
+  const bool use_cache = (std::getenv("MOBY_XML_CACHE") != NULL);
+  const std::string snapshot_fname = fname + ".bin";
+  if (use_cache)
+  {
+    struct stat xml_stat, bin_stat;
+    if (stat(fname.c_str(), &xml_stat) == 0 &&
+        stat(snapshot_fname.c_str(), &bin_stat) == 0 &&
+        bin_stat.st_mtime >= xml_stat.st_mtime)
+    {
+      shared_ptr<const XMLTree> cached = read_from_binary(snapshot_fname);
+      if (cached)
+        return cached;
+    }
+  }
+
   // *************************************************************
   // going to remove any path from the argument and change to that
   // path; this is done so that all files referenced from the
@@ -304,6 +515,10 @@ shared_ptr<const XMLTree> XMLTree::read_from_xml(const std::string& fname)
   // free the XML document
   xmlFreeDoc(doc);
 
+  // refresh the snapshot for subsequent runs
+  if (use_cache)
+    write_to_binary(snapshot_fname, node);
+
   return node;
 }
 
@@ -384,22 +599,27 @@ void XMLAttrib::get_vector_value(VectorNd& v)
   // indicate this attribute has been processed
   processed = true;
 
-  v = VectorNd::parse(value);
+  std::vector<double> vals;
+  parse_reals(value.c_str(), vals);
+  v.resize(vals.size());
+  for (unsigned i=0; i< vals.size(); i++)
+    v[i] = vals[i];
 }
 
 /// Returns an Origin3d value from the attribute
-Origin3d XMLAttrib::get_origin_value() 
+Origin3d XMLAttrib::get_origin_value()
 {
   // indicate this attribute has been processed
   processed = true;
 
-  VectorNd v = VectorNd::parse(value);
-  if (v.size() != 3)
+  std::vector<double> vals;
+  parse_reals(value.c_str(), vals);
+  if (vals.size() != 3)
     throw std::runtime_error("Unable to parse origin from vector!");
   Origin3d o;
-  o.x() = v[0];
-  o.y() = v[1];
-  o.z() = v[2];
+  o.x() = vals[0];
+  o.y() = vals[1];
+  o.z() = vals[2];
   return o;
 }
 
@@ -409,14 +629,15 @@ Quatd XMLAttrib::get_quat_value()
   // indicate this attribute has been processed
   processed = true;
 
-  VectorNd v = VectorNd::parse(value);
-  if (v.size() != 4)
+  std::vector<double> vals;
+  parse_reals(value.c_str(), vals);
+  if (vals.size() != 4)
     throw std::runtime_error("Unable to parse quaternion from vector!");
   Quatd q;
-  q.w = v[0];
-  q.x = v[1];
-  q.y = v[2];
-  q.z = v[3];
+  q.w = vals[0];
+  q.x = vals[1];
+  q.y = vals[2];
+  q.z = vals[3];
   return q;
 }
 
@@ -426,10 +647,11 @@ Quatd XMLAttrib::get_rpy_value()
   // indicate this attribute has been processed
   processed = true;
 
-  VectorNd v = VectorNd::parse(value);
-  if (v.size() != 3)
+  std::vector<double> vals;
+  parse_reals(value.c_str(), vals);
+  if (vals.size() != 3)
     throw std::runtime_error("Unable to parse roll-pitch-yaw from vector!");
-  return Quatd::rpy(v[0], v[1], v[2]);
+  return Quatd::rpy(vals[0], vals[1], vals[2]);
 }
 
 /// Gets a list of space-delimited and/or comma-delimited vectors from the underlying string value
@@ -438,11 +660,12 @@ void XMLAttrib::get_vector_value(Vector2d& v)
   // indicate this attribute has been processed
   processed = true;
 
-  VectorNd w = VectorNd::parse(value);
-  if (w.size() != v.size())
+  std::vector<double> vals;
+  parse_reals(value.c_str(), vals);
+  if (vals.size() != v.size())
     throw MissizeException();
-  v = Vector2d(w[0], w[1]);
-}  
+  v = Vector2d(vals[0], vals[1]);
+}
 
 /// Gets a list of space-delimited and/or comma-delimited vectors from the underlying string value
 void XMLAttrib::get_vector_value(Vector3d& v)
@@ -450,11 +673,12 @@ void XMLAttrib::get_vector_value(Vector3d& v)
   // indicate this attribute has been processed
   processed = true;
 
-  VectorNd w = VectorNd::parse(value);
-  if (w.size() != v.size())
+  std::vector<double> vals;
+  parse_reals(value.c_str(), vals);
+  if (vals.size() != v.size())
     throw MissizeException();
-  v = Vector3d(w[0], w[1], w[2]);
-}  
+  v = Vector3d(vals[0], vals[1], vals[2]);
+}
 
 /// Gets a list of space-delimited and/or comma-delimited vectors from the underlying string value
 void XMLAttrib::get_vector_value(SVector6d& v)
@@ -462,11 +686,12 @@ void XMLAttrib::get_vector_value(SVector6d& v)
   // indicate this attribute has been processed
   processed = true;
 
-  VectorNd w = VectorNd::parse(value);
-  if (w.size() != v.size())
+  std::vector<double> vals;
+  parse_reals(value.c_str(), vals);
+  if (vals.size() != v.size())
     throw MissizeException();
-  v = SVector6d(w[0], w[1], w[2], w[3], w[4], w[5]);
-}  
+  v = SVector6d(vals[0], vals[1], vals[2], vals[3], vals[4], vals[5]);
+}
 
 /// Gets a list of space-delimited and/or comma-delimited strings from the underlying string value
 void XMLAttrib::get_matrix_value(Matrix3d& m)
@@ -487,93 +712,54 @@ void XMLAttrib::get_matrix_value(MatrixNd& m)
   // indicate this attribute has been processed
   processed = true;
 
-  // construct the list of properties
-  std::list<std::list<std::string> > plist;
-  std::list<std::string> clist;
-
-  // extract all space-delimited, comma-delimited, and semi-colon-delimited substrings
-  std::string copy = this->value;
-  while (true)
+  // scan the character data once with strtod, recording where each
+  // semicolon-delimited row ends
+  std::vector<double> vals;
+  std::vector<unsigned> row_ends;
+  const char* p = this->value.c_str();
+  while (*p)
   {
-    // get the portion of the string before the delimiter
-    size_t space_idx = copy.find_first_of("  \t");
-    size_t comma_idx = copy.find(',');
-    size_t semicolon_idx = copy.find(';');
-        
-    // case 1: no delimiter found
-    if (space_idx == std::string::npos && comma_idx == std::string::npos && semicolon_idx == std::string::npos)
+    // skip delimiters, closing the current row at each semicolon
+    if (*p == ';')
     {
-      clist.push_back(copy);
-      plist.push_back(clist);
-      break;
+      row_ends.push_back((unsigned) vals.size());
+      p++;
+      continue;
     }
-        
-    // convert not founds to maximums for sorting
-    if (space_idx == std::string::npos)
-      space_idx = std::numeric_limits<int>::max();
-    if (comma_idx == std::string::npos)
-      comma_idx = std::numeric_limits<int>::max();
-    if (semicolon_idx == std::string::npos)
-      semicolon_idx = std::numeric_limits<int>::max();
-        
-    // case 2: semicolon delimiter found first
-    if (semicolon_idx < space_idx && semicolon_idx <  comma_idx)
-    {
-      clist.push_back(copy.substr(0,semicolon_idx));
-      plist.push_back(clist);
-      clist = std::list<std::string>();
-      copy = copy.substr(semicolon_idx);
-    }    
-    // case 3: space delimiter found first
-    else if (space_idx < semicolon_idx && space_idx < comma_idx)
+    if (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ',')
     {
-      clist.push_back(copy.substr(0,space_idx));
-      copy = copy.substr(space_idx);
+      p++;
+      continue;
     }
-    // case 4: comma delimiter found first
-    else if (comma_idx < semicolon_idx && space_idx > comma_idx)
-    {
-      clist.push_back(copy.substr(0,comma_idx));
-      copy = copy.substr(comma_idx);
-    }
-        
-    // get the new string
-    size_t firstidx = copy.find_first_not_of(" ,;");
-    if (firstidx == std::string::npos)
+
+    // parse one real; stop on malformed input
+    char* end;
+    double d = std::strtod(p, &end);
+    if (end == p)
       break;
-    else
-      copy = copy.substr(firstidx);        
+    vals.push_back(d);
+    p = end;
   }
 
-  // convert the lists to a Matrix
-  // first, verify that all vectors are the same length
-  unsigned len = plist.front().size();
-  for (std::list<std::list<std::string> >::const_iterator i = plist.begin(); i != plist.end(); i++)
-    if (i->size() != len)
+  // close the last row, if it was not semicolon-terminated
+  if (row_ends.empty() || row_ends.back() != vals.size())
+    row_ends.push_back((unsigned) vals.size());
+
+  // verify that all rows are the same length
+  unsigned len = row_ends.front();
+  for (unsigned i=1; i< row_ends.size(); i++)
+    if (row_ends[i] - row_ends[i-1] != len)
     {
       std::cerr << "XMLAttrib::get_matrix_value() - rows are not of the same size!" << std::endl << "  offending string: " << value << std::endl;
       m.resize(0,0);
       return;
     }
-      
-  // resize the matrix
-  m.resize(plist.size(), plist.front().size());
-  unsigned r = 0;
-  for (std::list<std::list<std::string> >::const_iterator i = plist.begin(); i != plist.end(); i++)
-  {
-    unsigned s = 0;
-    for (std::list<std::string>::const_iterator j = i->begin(); j != i->end(); j++)
-    {
-      if (strcasecmp(j->c_str(), "inf") == 0)
-        m(r,s) = std::numeric_limits<double>::infinity();
-      else if (strcasecmp(j->c_str(), "-inf") == 0)
-        m(r,s) = -std::numeric_limits<double>::infinity();
-      else
-        m(r,s) = (double) atof(j->c_str());
-      s++;
-    }
-    r++;
-  }
+
+  // fill the matrix
+  m.resize(row_ends.size(), len);
+  for (unsigned r=0, k=0; r< row_ends.size(); r++)
+    for (unsigned s=0; s< len; s++)
+      m(r,s) = vals[k++];
 }
 
 /// Sends the specified XMLAttrib to the given stream
@@ -638,7 +824,7 @@ std::list<shared_ptr<const XMLTree> > XMLTree::find_child_nodes(const std::list<
 
   // now, look over all nodes, transforming node names to lowercase, and 
   // checking for a match
-  for (std::list<XMLTreePtr>::const_iterator i = this->children.begin(); i != this->children.end(); i++)
+  for (std::vector<XMLTreePtr>::const_iterator i = this->children.begin(); i != this->children.end(); i++)
   {
     // get the name of the node, lowercased
     std::string node_name = (*i)->name;
@@ -662,7 +848,7 @@ std::list<shared_ptr<const XMLTree> > XMLTree::find_child_nodes(const std::strin
   std::transform(name_lower.begin(), name_lower.end(), name_lower.begin(), (int(*)(int)) std::tolower);
 
   // search for a match
-  for (std::list<XMLTreePtr>::const_iterator i = this->children.begin(); i != this->children.end(); i++)
+  for (std::vector<XMLTreePtr>::const_iterator i = this->children.begin(); i != this->children.end(); i++)
   {
     // convert the node name to lowercase
     std::string node_name = (*i)->name;
@@ -680,7 +866,7 @@ std::list<shared_ptr<const XMLTree> > XMLTree::find_child_nodes(const std::strin
 std::ostream& Moby::operator<<(std::ostream& out, const XMLTree& node)
 {
   // get the list of child nodes
-  const std::list<XMLTreePtr>& child_nodes = node.children; 
+  const std::vector<XMLTreePtr>& child_nodes = node.children; 
   
   // get the set of attributes for this node
   const std::set<XMLAttrib>& attribs = node.attribs;
@@ -699,7 +885,7 @@ std::ostream& Moby::operator<<(std::ostream& out, const XMLTree& node)
     out << ">" << std::endl;
     
     // write all child nodes, in forward order
-    for (std::list<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
+    for (std::vector<XMLTreePtr>::const_iterator i = child_nodes.begin(); i != child_nodes.end(); i++)
       out << **i;
 
     // close this tag
@@ -7,6 +7,7 @@
 #include <errno.h>
 #include <iostream>
 #include <fstream>
+#include <set>
 #include <Moby/Base.h>
 #include <Moby/XMLTree.h>
 #include <Moby/XMLWriter.h>
@@ -14,6 +15,180 @@
 using boost::shared_ptr;
 using namespace Moby;
 
+/// Default constructor
+XMLWriter::XMLWriter()
+{
+  _thread_running = _busy = _shutdown = false;
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_cond, NULL);
+}
+
+XMLWriter::~XMLWriter()
+{
+  // shut down the writer thread, if one was started; dumps still queued are
+  // flushed to disk before the thread exits
+  if (_thread_running)
+  {
+    pthread_mutex_lock(&_mutex);
+    _shutdown = true;
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_mutex);
+    pthread_join(_thread, NULL);
+  }
+
+  pthread_cond_destroy(&_cond);
+  pthread_mutex_destroy(&_mutex);
+}
+
+/// Worker thread entry point for the background writer
+void* XMLWriter::write_worker(void* arg)
+{
+  XMLWriter* writer = (XMLWriter*) arg;
+
+  pthread_mutex_lock(&writer->_mutex);
+  while (true)
+  {
+    // wait for a job (or for shutdown); shutdown completes only after the
+    // queue has drained so no dump is lost
+    while (writer->_queue.empty() && !writer->_shutdown)
+      pthread_cond_wait(&writer->_cond, &writer->_mutex);
+    if (writer->_queue.empty() && writer->_shutdown)
+      break;
+
+    // take the oldest job
+    std::pair<std::string, XMLTreePtr> job = writer->_queue.front();
+    writer->_queue.pop_front();
+    writer->_busy = true;
+
+    // render and write outside the lock; the document is immutable once
+    // enqueued (a changed object gets a fresh subtree on the next dump)
+    pthread_mutex_unlock(&writer->_mutex);
+    std::ofstream out(job.first.c_str());
+    out << *job.second << std::endl;
+    out.close();
+    pthread_mutex_lock(&writer->_mutex);
+
+    // signal wait_for_pending_writes()
+    writer->_busy = false;
+    pthread_cond_broadcast(&writer->_cond);
+  }
+  pthread_mutex_unlock(&writer->_mutex);
+
+  return NULL;
+}
+
+/// Serializes the given objects to XML, reusing unchanged subtrees, and writes the file on a background thread
+/**
+ * Objects whose modification stamps (see Base::get_generation()) have not
+ * moved since this instance's last dump are emitted from cached subtrees
+ * without calling save_to_xml(); only changed objects are re-serialized.
+ * The assembled document is then queued for a background thread that
+ * renders it and performs the disk I/O, so a periodic state dump costs the
+ * caller the diff rather than a full save plus the write.  Unlike the
+ * static serialize_to_xml() methods, the filename is opened as given (at
+ * write time) rather than via a change of working directory, since the
+ * working directory is process-wide state the writer thread must not
+ * touch.  Note that a dump is faithful only insofar as mutations bump the
+ * stamps; external code writing through a back door should call
+ * Base::bump_generation() (the same contract all stamp-validated caches
+ * rely on).
+ */
+void XMLWriter::serialize_incremental(const std::string& fname, const std::list<shared_ptr<const Base> >& objects)
+{
+  // create the document scaffolding (fresh on every dump; only the
+  // per-object subtrees are cached)
+  XMLTreePtr topnode(new XMLTree("XML"));
+  XMLTreePtr node(new XMLTree("Moby"));
+  topnode->add_child(node);
+
+  // setup a list of shared objects to be equal to the list of objects
+  std::list<shared_ptr<const Base> > shared_objects = objects;
+
+  // init a set of serialized objects
+  std::set<shared_ptr<const Base> > serialized;
+
+  // develop the XML tree until there is nothing more to serialize
+  while (!shared_objects.empty())
+  {
+    // get the object off of the front of the queue
+    shared_ptr<const Base> obj = shared_objects.front();
+    assert(obj);
+    shared_objects.pop_front();
+
+    // if this object has already been serialized, skip it
+    if (serialized.find(obj) != serialized.end())
+      continue;
+    serialized.insert(obj);
+
+    // an object whose stamp has not moved since the last dump is emitted
+    // from the cache; its recorded references keep dependency discovery
+    // complete without re-running save_to_xml()
+    std::map<shared_ptr<const Base>, CacheEntry>::iterator ci = _cache.find(obj);
+    if (ci != _cache.end() && ci->second.generation == obj->get_generation())
+    {
+      node->add_child(ci->second.node);
+      shared_objects.insert(shared_objects.end(), ci->second.deps.begin(), ci->second.deps.end());
+      continue;
+    }
+
+    // serialize to a fresh node, capturing the references it emits
+    XMLTreePtr new_node(new XMLTree(""));
+    node->add_child(new_node);
+    std::list<shared_ptr<const Base> > deps;
+    obj->save_to_xml(new_node, deps);
+    shared_objects.insert(shared_objects.end(), deps.begin(), deps.end());
+
+    // cache the subtree for the next dump
+    CacheEntry& entry = _cache[obj];
+    entry.generation = obj->get_generation();
+    entry.node = new_node;
+    entry.deps = deps;
+  }
+
+  // drop cache entries for objects the graph no longer reaches, so removed
+  // bodies do not pin their serializations (and themselves) forever
+  for (std::map<shared_ptr<const Base>, CacheEntry>::iterator i = _cache.begin(); i != _cache.end(); )
+  {
+    if (serialized.find(i->first) == serialized.end())
+      _cache.erase(i++);
+    else
+      i++;
+  }
+
+  // start the persistent writer on first use
+  if (!_thread_running)
+  {
+    pthread_create(&_thread, NULL, &write_worker, this);
+    _thread_running = true;
+  }
+
+  // post the job
+  pthread_mutex_lock(&_mutex);
+  _queue.push_back(std::make_pair(fname, topnode));
+  pthread_cond_broadcast(&_cond);
+  pthread_mutex_unlock(&_mutex);
+}
+
+/// Serializes the given object (and all of its dependencies) incrementally
+void XMLWriter::serialize_incremental(const std::string& fname, shared_ptr<const Base> object)
+{
+  std::list<shared_ptr<const Base> > objects;
+  objects.push_back(object);
+  serialize_incremental(fname, objects);
+}
+
+/// Blocks until every queued dump has been written to disk
+void XMLWriter::wait_for_pending_writes()
+{
+  if (!_thread_running)
+    return;
+
+  pthread_mutex_lock(&_mutex);
+  while (!_queue.empty() || _busy)
+    pthread_cond_wait(&_cond, &_mutex);
+  pthread_mutex_unlock(&_mutex);
+}
+
 /// Serializes the given objects (and all dependencies) to XML
 void XMLWriter::serialize_to_xml(const std::string& fname, const std::list<shared_ptr<const Base> >& objects)
 {